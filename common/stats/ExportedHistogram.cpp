@@ -0,0 +1,84 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ExportedHistogram.h"
+
+#include <folly/Conv.h>
+#include <folly/stats/TimeseriesHistogram-defs.h>
+
+using std::chrono::seconds;
+
+namespace folly {
+template class TimeseriesHistogram<int64_t>;
+}
+
+namespace facebook { namespace stats {
+
+const int ExportedHistogramMap::kDefaultPercentiles[] = { 50, 95, 99 };
+
+ExportedHistogramMap::LockAndHistogram
+ExportedHistogramMap::getOrCreateUnlocked(folly::StringPiece name,
+                                          const ExportedHistogram* copyMe,
+                                          bool* createdPtr) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& entry = histograms_[name.str()];
+  bool created = !entry.item.second;
+  if (created) {
+    entry.item.first = std::make_shared<SpinLock>();
+    entry.item.second = std::make_shared<ExportedHistogram>(*copyMe);
+    entry.percentiles.insert(std::begin(kDefaultPercentiles),
+                             std::end(kDefaultPercentiles));
+  }
+  if (createdPtr) {
+    *createdPtr = created;
+  }
+  return entry.item;
+}
+
+ExportedHistogramMap::LockAndHistogram
+ExportedHistogramMap::getLockAndHistogram(folly::StringPiece name) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = histograms_.find(name.str());
+  if (it == histograms_.end()) {
+    return LockAndHistogram();
+  }
+  return it->second.item;
+}
+
+void ExportedHistogramMap::exportPercentile(folly::StringPiece name,
+                                            int percentile) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = histograms_.find(name.str());
+  if (it != histograms_.end()) {
+    it->second.percentiles.insert(percentile);
+  }
+}
+
+void ExportedHistogramMap::getCounters(
+    seconds now, std::map<std::string, int64_t>* counters) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (const auto& histPair : histograms_) {
+    const auto& entry = histPair.second;
+    SpinLockHolder histGuard(entry.item.first.get());
+    auto hist = entry.item.second.get();
+    hist->update(now);
+    for (int level = 0; level < hist->getNumLevels(); ++level) {
+      auto duration = ExportedStat::kLevelDurations[level];
+      (*counters)[getCounterName(histPair.first, "avg", duration)] =
+        hist->avg<int64_t>(level);
+      for (auto pct : entry.percentiles) {
+        auto suffix = folly::to<std::string>("p", pct);
+        (*counters)[getCounterName(histPair.first, suffix, duration)] =
+          hist->getPercentileEstimate(pct, level);
+      }
+    }
+  }
+}
+
+}}
@@ -11,28 +11,75 @@
 
 #include "common/stats/ExportedTimeseries.h"
 
+#include <folly/stats/TimeseriesHistogram.h>
+
+#include <set>
+
 namespace facebook { namespace stats {
 
-class ExportedHistogram {
-public:
-  ExportedHistogram(int, int, size_t) {}
-  void addValue(std::chrono::seconds, int, int64_t) {}
-  int numLevels() {return 1;}
-  int sum(int numLevels) {return 0;}
+/*
+ * A histogram of the values added over the same levels as ExportedStat.
+ *
+ * Values are counted in buckets of bucketSize between min and max, plus one
+ * bucket for the values below min and one for those above max.
+ */
+class ExportedHistogram : public folly::TimeseriesHistogram<int64_t> {
+ public:
+  ExportedHistogram(int64_t bucketSize, int64_t min, int64_t max)
+    : folly::TimeseriesHistogram<int64_t>(bucketSize, min, max,
+                                          ExportedStat()) {}
+
+  int numLevels() const {
+    return getNumLevels();
+  }
 };
 
+/*
+ * ExportedHistogramMap holds the named histograms of a process, and which
+ * percentiles of each of them are exported as counters.
+ */
 class ExportedHistogramMap {
-public:
+ public:
   struct LockAndHistogram {
     std::shared_ptr<SpinLock> first;
     std::shared_ptr<ExportedHistogram> second;
   };
-  LockAndHistogram getOrCreateUnlocked(folly::StringPiece,
-                                       const ExportedHistogram*,
-                                       bool* createdPtr = nullptr) {
-    if (createdPtr) *createdPtr = true;
-    return LockAndHistogram();
-  }
+
+  // Percentiles exported for each histogram unless told otherwise
+  static const int kDefaultPercentiles[3];
+
+  ExportedHistogramMap() {}
+
+  /*
+   * Return the histogram called name.  If it doesn't exist yet, it is
+   * created as a copy of copyMe, exporting its average and the default
+   * percentiles.  The histogram lock isn't held on return.
+   */
+  LockAndHistogram getOrCreateUnlocked(folly::StringPiece name,
+                                       const ExportedHistogram* copyMe,
+                                       bool* createdPtr = nullptr);
+
+  // Return the histogram called name, or null pointers if there is none
+  LockAndHistogram getLockAndHistogram(folly::StringPiece name);
+
+  // Export the given percentile of an existing histogram
+  void exportPercentile(folly::StringPiece name, int percentile);
+
+  // Add the values of all exported percentiles to counters
+  void getCounters(std::chrono::seconds now,
+                   std::map<std::string, int64_t>* counters);
+
+ private:
+  ExportedHistogramMap(const ExportedHistogramMap&) = delete;
+  ExportedHistogramMap& operator=(const ExportedHistogramMap&) = delete;
+
+  struct Entry {
+    LockAndHistogram item;
+    std::set<int> percentiles;
+  };
+
+  std::mutex mutex_;
+  std::map<std::string, Entry> histograms_;
 };
 
 }}
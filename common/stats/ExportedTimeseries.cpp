@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ExportedTimeseries.h"
+
+#include <folly/Conv.h>
+
+using std::chrono::seconds;
+
+namespace facebook { namespace stats {
+
+const seconds ExportedStat::kLevelDurations[] = {
+  seconds(60), seconds(600), seconds(3600), seconds(0),
+};
+
+folly::StringPiece exportTypeName(ExportType type) {
+  switch (type) {
+    case SUM:
+      return "sum";
+    case COUNT:
+      return "count";
+    case AVG:
+      return "avg";
+    case RATE:
+      return "rate";
+    case PERCENT:
+      return "pct";
+    case NUM_TYPES:
+      break;
+  }
+  return "unknown";
+}
+
+std::string getCounterName(folly::StringPiece name, folly::StringPiece suffix,
+                           seconds duration) {
+  if (duration.count() == 0) {
+    return folly::to<std::string>(name, ".", suffix);
+  }
+  return folly::to<std::string>(name, ".", suffix, ".", duration.count());
+}
+
+seconds currentTime() {
+  // The stats are exported with wall clock times, like everywhere else
+  return std::chrono::duration_cast<seconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+}
+
+ExportedStatMap::LockAndStatItem ExportedStatMap::getLockAndStatItem(
+    folly::StringPiece name, const ExportType* type) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& entry = stats_[name.str()];
+  if (!entry.item.second) {
+    entry.item.first = std::make_shared<SpinLock>();
+    entry.item.second = std::make_shared<ExportedStat>();
+  }
+  if (type && *type < NUM_TYPES) {
+    entry.exported[*type] = true;
+  }
+  return entry.item;
+}
+
+void ExportedStatMap::getCounters(seconds now,
+                                  std::map<std::string, int64_t>* counters) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (const auto& statPair : stats_) {
+    const auto& entry = statPair.second;
+    SpinLockHolder statGuard(entry.item.first.get());
+    auto stat = entry.item.second.get();
+    // Expire the data that has fallen out of each level
+    stat->update(now);
+    for (size_t level = 0; level < stat->numLevels(); ++level) {
+      auto duration = ExportedStat::kLevelDurations[level];
+      for (int type = 0; type < NUM_TYPES; ++type) {
+        if (!entry.exported[type]) {
+          continue;
+        }
+        int64_t value = 0;
+        switch (type) {
+          case SUM:
+            value = stat->sum(level);
+            break;
+          case COUNT:
+            value = stat->count(level);
+            break;
+          case AVG:
+            value = stat->avg<int64_t>(level);
+            break;
+          case RATE:
+            value = stat->rate<int64_t>(level);
+            break;
+          case PERCENT:
+            value = stat->avg<double>(level) * 100;
+            break;
+        }
+        auto counterName = getCounterName(
+            statPair.first, exportTypeName(ExportType(type)), duration);
+        (*counters)[counterName] = value;
+      }
+    }
+  }
+}
+
+}}
@@ -10,16 +10,45 @@
 #pragma once
 
 #include <folly/Range.h>
+#include <folly/SpinLock.h>
+#include <folly/stats/MultiLevelTimeSeries.h>
+
+#include <array>
 #include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 
 namespace facebook {
 
 class SpinLock {
+ public:
+  void lock() {
+    lock_.lock();
+  }
+  void unlock() {
+    lock_.unlock();
+  }
+
+ private:
+  folly::SpinLock lock_;
 };
 
 class SpinLockHolder {
-public:
-  explicit SpinLockHolder(SpinLock*) {}
+ public:
+  explicit SpinLockHolder(SpinLock* lock) : lock_(lock) {
+    lock_->lock();
+  }
+  ~SpinLockHolder() {
+    lock_->unlock();
+  }
+
+ private:
+  SpinLockHolder(const SpinLockHolder&) = delete;
+  SpinLockHolder& operator=(const SpinLockHolder&) = delete;
+
+  SpinLock* lock_;
 };
 
 namespace stats {
@@ -33,31 +62,85 @@ enum ExportType {
   NUM_TYPES,
 };
 
-struct ExportedStat {
-  void addValue(std::chrono::seconds, int64_t) {}
-  int numLevels() {return 1;}
-  int getSum(int level) {return 0;}
-  int sum(int level) {return 0;}
+// The name used for an export type in counter names, e.g. "sum" for SUM
+folly::StringPiece exportTypeName(ExportType type);
+
+/*
+ * Return the name of the counter exporting a statistic over one level of its
+ * timeseries: "<name>.<suffix>.<seconds>", or just "<name>.<suffix>" for the
+ * all-time level.
+ */
+std::string getCounterName(folly::StringPiece name, folly::StringPiece suffix,
+                           std::chrono::seconds duration);
+
+// The current time, as expected by all the stats objects
+std::chrono::seconds currentTime();
+
+/*
+ * An ExportedStat keeps the sum and count of the values added to it over
+ * the last minute, 10 minutes, hour and since it was created.
+ */
+class ExportedStat : public folly::MultiLevelTimeSeries<int64_t> {
+ public:
+  enum : size_t {
+    kNumBuckets = 60,
+    kNumLevels = 4,
+  };
+  // Duration of each level, 0 being all-time
+  static const std::chrono::seconds kLevelDurations[kNumLevels];
+
+  ExportedStat()
+    : folly::MultiLevelTimeSeries<int64_t>(kNumBuckets, kNumLevels,
+                                           kLevelDurations) {}
 };
 
+/*
+ * ExportedStatMap holds the named ExportedStats of a process, and which
+ * statistics (sum, rate, ...) of each of them are exported as counters.
+ *
+ * The stats are shared with their users, each of them protected by its own
+ * SpinLock.  The map itself is only locked to create or look up a stat.
+ */
 class ExportedStatMap {
-public:
+ public:
   class LockAndStatItem {
-  public:
+   public:
     std::shared_ptr<SpinLock> first;
     std::shared_ptr<ExportedStat> second;
   };
-  LockAndStatItem getLockAndStatItem(folly::StringPiece,
-                                     const ExportType* = nullptr) {
-    static LockAndStatItem it = {
-      std::make_shared<SpinLock>(), std::make_shared<ExportedStat>()
-    };
-    return it;
-  }
+
+  ExportedStatMap() {}
+
+  /*
+   * Return the stat called name, creating it if it doesn't exist yet.
+   * If type is non-null, also export the given statistic of the stat.
+   */
+  LockAndStatItem getLockAndStatItem(folly::StringPiece name,
+                                     const ExportType* type = nullptr);
 
   std::shared_ptr<ExportedStat> getStatPtr(folly::StringPiece name) {
-      return std::make_shared<ExportedStat>();
+    return getLockAndStatItem(name).second;
   }
+
+  void exportStat(folly::StringPiece name, ExportType type) {
+    getLockAndStatItem(name, &type);
+  }
+
+  // Add the values of all exported statistics to counters
+  void getCounters(std::chrono::seconds now,
+                   std::map<std::string, int64_t>* counters);
+
+ private:
+  ExportedStatMap(const ExportedStatMap&) = delete;
+  ExportedStatMap& operator=(const ExportedStatMap&) = delete;
+
+  struct Entry {
+    LockAndStatItem item;
+    std::array<bool, NUM_TYPES> exported{{}};
+  };
+
+  std::mutex mutex_;
+  std::map<std::string, Entry> stats_;
 };
 
 }}
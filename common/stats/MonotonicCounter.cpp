@@ -0,0 +1,36 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/MonotonicCounter.h"
+
+#include "common/stats/ServiceData.h"
+
+namespace facebook { namespace stats {
+
+MonotonicCounter::MonotonicCounter(folly::StringPiece name, ExportType type1,
+                                   ExportType type2)
+  : name_(name.str()) {
+  auto statMap = fbData->getStatMap();
+  stat_ = statMap->getLockAndStatItem(name, &type1);
+  statMap->exportStat(name, type2);
+}
+
+void MonotonicCounter::updateValue(std::chrono::seconds now, int64_t value) {
+  if (!initialized_) {
+    initialized_ = true;
+    prev_ = value;
+    return;
+  }
+  auto delta = value >= prev_ ? value - prev_ : value;
+  prev_ = value;
+  SpinLockHolder guard(stat_.first.get());
+  stat_.second->addValue(now, delta);
+}
+
+}}
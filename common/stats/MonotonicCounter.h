@@ -14,10 +14,31 @@
 
 namespace facebook { namespace stats {
 
+/*
+ * MonotonicCounter tracks a counter maintained elsewhere (e.g. in hardware)
+ * which only goes up, by adding the difference between successive values to
+ * an ExportedStat in fbData.
+ *
+ * The first value only sets the starting point, so the stat counts what
+ * happened since this process started.  If the counter goes backwards it is
+ * assumed to have been reset to 0.
+ */
 class MonotonicCounter {
-public:
-  MonotonicCounter(folly::StringPiece, ExportType, ExportType) {}
-  void updateValue(std::chrono::seconds, int64_t) {}
+ public:
+  MonotonicCounter(folly::StringPiece name, ExportType type1,
+                   ExportType type2);
+
+  void updateValue(std::chrono::seconds now, int64_t value);
+
+  const std::string& getName() const {
+    return name_;
+  }
+
+ private:
+  std::string name_;
+  ExportedStatMap::LockAndStatItem stat_;
+  bool initialized_{false};
+  int64_t prev_{0};
 };
 
 }}
@@ -13,4 +13,45 @@ static facebook::stats::ServiceData payload;
 
 namespace facebook {
 facebook::stats::ServiceData* fbData = &payload;
+
+namespace stats {
+
+void ServiceData::getCounters(std::map<std::string, int64_t>& counters) {
+  auto now = currentTime();
+  statMap_.getCounters(now, &counters);
+  histogramMap_.getCounters(now, &counters);
+
+  std::lock_guard<std::mutex> guard(countersMutex_);
+  for (const auto& counter : counters_) {
+    counters[counter.first] = counter.second;
+  }
+}
+
+int64_t ServiceData::getCounter(folly::StringPiece key) const {
+  std::lock_guard<std::mutex> guard(countersMutex_);
+  auto it = counters_.find(key.str());
+  return it == counters_.end() ? 0 : it->second;
+}
+
+int64_t ServiceData::clearCounter(folly::StringPiece key) {
+  std::lock_guard<std::mutex> guard(countersMutex_);
+  auto it = counters_.find(key.str());
+  if (it == counters_.end()) {
+    return 0;
+  }
+  auto value = it->second;
+  counters_.erase(it);
+  return value;
+}
+
+void ServiceData::setCounter(folly::StringPiece key, int64_t value) {
+  std::lock_guard<std::mutex> guard(countersMutex_);
+  counters_[key.str()] = value;
 }
+
+int64_t ServiceData::incrementCounter(folly::StringPiece key, int64_t amount) {
+  std::lock_guard<std::mutex> guard(countersMutex_);
+  return counters_[key.str()] += amount;
+}
+
+}} // facebook::stats
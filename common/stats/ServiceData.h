@@ -15,21 +15,41 @@
 
 namespace facebook { namespace stats {
 
+/*
+ * ServiceData holds all the counters exported by a process over fb303:
+ * simple counters set directly, and the statistics exported from the stats
+ * and histograms in its maps.
+ */
 class ServiceData {
-public:
+ public:
   ExportedStatMap* getStatMap() {
-    static ExportedStatMap it;
-    return &it;
+    return &statMap_;
   }
   ExportedHistogramMap* getHistogramMap() {
-    static ExportedHistogramMap it;
-    return &it;
+    return &histogramMap_;
+  }
+
+  // Fill counters with the current value of every exported counter
+  void getCounters(std::map<std::string, int64_t>& counters);
+
+  // Return the value of a counter set with setCounter(), or 0
+  int64_t getCounter(folly::StringPiece key) const;
+  // Remove a counter set with setCounter(), returning its last value
+  int64_t clearCounter(folly::StringPiece key);
+  void setCounter(folly::StringPiece key, int64_t value);
+  int64_t incrementCounter(folly::StringPiece key, int64_t amount = 1);
+
+  void setUseOptionsAsFlags(bool useOptionsAsFlags) {
+    useOptionsAsFlags_ = useOptionsAsFlags;
   }
-  void getCounters(std::map<std::string, int64_t>&) {}
-  long getCounter(std::string) {return 0;};
-  long clearCounter(std::string) {return 0;};
-  void setUseOptionsAsFlags(bool) {}
-  void setCounter(folly::StringPiece, uint32_t) {}
+
+ private:
+  ExportedStatMap statMap_;
+  ExportedHistogramMap histogramMap_;
+
+  mutable std::mutex countersMutex_;
+  std::map<std::string, int64_t> counters_;
+  bool useOptionsAsFlags_{false};
 };
 
 }
@@ -0,0 +1,108 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ThreadCachedServiceData.h"
+
+#include "common/stats/ServiceData.h"
+
+using std::chrono::seconds;
+
+namespace facebook { namespace stats {
+
+ThreadCachedServiceData* ThreadCachedServiceData::get() {
+  static ThreadCachedServiceData it(fbData);
+  return &it;
+}
+
+void ThreadCachedServiceData::publishStats() {
+  auto now = currentTime();
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto stat : stats_) {
+    stat->publish(now);
+  }
+}
+
+void ThreadCachedServiceData::TLStatBase::link(ThreadLocalStatsMap* map) {
+  parent_ = map->getParent();
+  std::lock_guard<std::mutex> guard(parent_->mutex_);
+  parent_->stats_.insert(this);
+}
+
+void ThreadCachedServiceData::TLStatBase::unlink() {
+  std::lock_guard<std::mutex> guard(parent_->mutex_);
+  // Don't lose the values added since the last publishStats()
+  publish(currentTime());
+  parent_->stats_.erase(this);
+}
+
+ThreadCachedServiceData::TLTimeseries::TLTimeseries(
+    ThreadLocalStatsMap* map, folly::StringPiece name,
+    ExportType type1, ExportType type2) {
+  auto statMap = map->getParent()->getServiceData()->getStatMap();
+  stat_ = statMap->getLockAndStatItem(name, &type1);
+  statMap->exportStat(name, type2);
+  link(map);
+}
+
+ThreadCachedServiceData::TLTimeseries::~TLTimeseries() {
+  unlink();
+}
+
+void ThreadCachedServiceData::TLTimeseries::publish(seconds now) {
+  auto count = count_.load(std::memory_order_relaxed);
+  auto sum = sum_.load(std::memory_order_relaxed);
+  if (count == publishedCount_) {
+    return;
+  }
+  SpinLockHolder guard(stat_.first.get());
+  stat_.second->addValueAggregated(now, sum - publishedSum_,
+                                   count - publishedCount_);
+  publishedCount_ = count;
+  publishedSum_ = sum;
+}
+
+ThreadCachedServiceData::TLHistogram::TLHistogram(
+    ThreadLocalStatsMap* map, folly::StringPiece name,
+    int64_t bucketSize, int64_t min, int64_t max)
+  : bucketSize_(bucketSize),
+    min_(min),
+    max_(max) {
+  // The global histogram is created from a template with the same buckets
+  ExportedHistogram templateHist(bucketSize, min, max);
+  numBuckets_ = templateHist.getNumBuckets();
+  buckets_.reset(new Bucket[numBuckets_]);
+  auto histMap = map->getParent()->getServiceData()->getHistogramMap();
+  histogram_ = histMap->getOrCreateUnlocked(name, &templateHist);
+  link(map);
+}
+
+ThreadCachedServiceData::TLHistogram::~TLHistogram() {
+  unlink();
+}
+
+void ThreadCachedServiceData::TLHistogram::publish(seconds now) {
+  SpinLockHolder guard(histogram_.first.get());
+  for (size_t idx = 0; idx < numBuckets_; ++idx) {
+    auto& bucket = buckets_[idx];
+    auto count = bucket.count.load(std::memory_order_relaxed);
+    auto sum = bucket.sum.load(std::memory_order_relaxed);
+    if (count == bucket.publishedCount) {
+      continue;
+    }
+    // Only the total per bucket is known, so add its average value.  It
+    // falls in the same bucket of the global histogram.
+    auto nsamples = count - bucket.publishedCount;
+    auto avg = (sum - bucket.publishedSum) / nsamples;
+    histogram_.second->addValue(now, avg, nsamples);
+    bucket.publishedCount = count;
+    bucket.publishedSum = sum;
+  }
+}
+
+}}
@@ -9,44 +9,192 @@
  */
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
 #include <folly/Range.h>
+#include <folly/ThreadLocal.h>
 #include "common/stats/ExportedTimeseries.h"
+#include "common/stats/ExportedHistogram.h"
 
 namespace facebook { namespace stats {
 
+class ServiceData;
+
+/*
+ * ThreadCachedServiceData buffers stats updates in thread-local objects, and
+ * periodically publishes them to the global ServiceData.
+ *
+ * A TLTimeseries or TLHistogram must only be updated by a single thread.
+ * Updating one is a plain increment of a thread-local value, with no locks
+ * or atomic read-modify-write operations.  publishStats() (usually called
+ * from another thread once a second) reads the accumulated totals and adds
+ * the difference since its last call to the shared stat.
+ */
 class ThreadCachedServiceData {
-public:
+ public:
+  class ThreadLocalStatsMap;
+
+  class TLStatBase {
+   public:
+    virtual ~TLStatBase() {}
+
+   protected:
+    TLStatBase() {}
+
+    // Start and stop publishing this stat.  These must be called by the
+    // most derived class, since publish() may be called in between.
+    void link(ThreadLocalStatsMap* map);
+    void unlink();
+
+    // Add everything since the previous call to the global stat
+    virtual void publish(std::chrono::seconds now) = 0;
+
+    /*
+     * Values are only written by the thread owning the stat, so a relaxed
+     * load followed by a relaxed store is enough.  Unlike fetch_add() this
+     * compiles to plain memory operations, while still letting the
+     * publishing thread read the value safely.
+     */
+    static void increment(std::atomic<int64_t>* value, int64_t amount) {
+      value->store(value->load(std::memory_order_relaxed) + amount,
+                   std::memory_order_relaxed);
+    }
+
+   private:
+    friend class ThreadCachedServiceData;
+
+    TLStatBase(const TLStatBase&) = delete;
+    TLStatBase& operator=(const TLStatBase&) = delete;
+
+    ThreadCachedServiceData* parent_{nullptr};
+  };
+
   class ThreadLocalStatsMap {
+   public:
+    ThreadCachedServiceData* getParent() const {
+      return parent_;
+    }
+
+   private:
+    friend class ThreadCachedServiceData;
+
+    ThreadCachedServiceData* parent_{nullptr};
   };
 
-  class TLTimeseries {
-  public:
-    TLTimeseries(ThreadLocalStatsMap*, folly::StringPiece,
-                 ExportType, ExportType = ExportType()) {}
-    void addValue(int64_t) {}
+  /*
+   * A thread-local ExportedStat.  The export types given are exported
+   * for the stat called name in fbData.
+   */
+  class TLTimeseries : public TLStatBase {
+   public:
+    TLTimeseries(ThreadLocalStatsMap* map, folly::StringPiece name,
+                 ExportType type1, ExportType type2 = NUM_TYPES);
+    ~TLTimeseries() override;
+
+    void addValue(int64_t value) {
+      increment(&sum_, value);
+      increment(&count_, 1);
+    }
+
+   private:
+    void publish(std::chrono::seconds now) override;
+
+    ExportedStatMap::LockAndStatItem stat_;
+    std::atomic<int64_t> sum_{0};
+    std::atomic<int64_t> count_{0};
+    // The totals added to stat_ so far, only used by publish()
+    int64_t publishedSum_{0};
+    int64_t publishedCount_{0};
   };
 
-  class TLHistogram {
-  public:
-    TLHistogram(ThreadLocalStatsMap*, folly::StringPiece, int, int, int) {}
-    void addValue(int64_t) {}
-    void addRepeatedValue(int64_t /*value*/, int64_t /*nsamples*/) {}
+  /*
+   * A thread-local ExportedHistogram, published to the histogram called name
+   * in fbData.
+   */
+  class TLHistogram : public TLStatBase {
+   public:
+    TLHistogram(ThreadLocalStatsMap* map, folly::StringPiece name,
+                int64_t bucketSize, int64_t min, int64_t max);
+    ~TLHistogram() override;
+
+    void addValue(int64_t value) {
+      addRepeatedValue(value, 1);
+    }
+    void addRepeatedValue(int64_t value, int64_t nsamples) {
+      auto& bucket = buckets_[getBucketIdx(value)];
+      increment(&bucket.sum, value * nsamples);
+      increment(&bucket.count, nsamples);
+    }
+
+   private:
+    struct Bucket {
+      std::atomic<int64_t> sum{0};
+      std::atomic<int64_t> count{0};
+      int64_t publishedSum{0};
+      int64_t publishedCount{0};
+    };
+
+    // Same bucketing as folly::Histogram
+    size_t getBucketIdx(int64_t value) const {
+      if (value < min_) {
+        return 0;
+      } else if (value >= max_) {
+        return numBuckets_ - 1;
+      }
+      return (value - min_) / bucketSize_ + 1;
+    }
+
+    void publish(std::chrono::seconds now) override;
+
+    int64_t bucketSize_;
+    int64_t min_;
+    int64_t max_;
+    size_t numBuckets_;
+    std::unique_ptr<Bucket[]> buckets_;
+    ExportedHistogramMap::LockAndHistogram histogram_;
   };
 
-  static ThreadCachedServiceData* get() {
-    static ThreadCachedServiceData it;
-    return &it;
+  explicit ThreadCachedServiceData(ServiceData* serviceData)
+    : serviceData_(serviceData) {}
+
+  static ThreadCachedServiceData* get();
+
+  ServiceData* getServiceData() const {
+    return serviceData_;
   }
+
+  // Return the calling thread's ThreadLocalStatsMap
   ThreadLocalStatsMap* getThreadStats() {
-    static ThreadLocalStatsMap it;
-    return &it;
+    auto map = threadStats_.get();
+    map->parent_ = this;
+    return map;
   }
+
+  /*
+   * There is no background publishing thread; the owner of the process is
+   * expected to call publishStats() periodically.
+   */
   bool publishThreadRunning() const {
     return false;
   }
-  void publishStats() {
-  }
+
+  // Publish all thread-local stats to the global ServiceData
+  void publishStats();
+
+ private:
+  ThreadCachedServiceData(const ThreadCachedServiceData&) = delete;
+  ThreadCachedServiceData& operator=(const ThreadCachedServiceData&) = delete;
+
+  ServiceData* serviceData_;
+  folly::ThreadLocal<ThreadLocalStatsMap> threadStats_;
+
+  // All live thread-local stats.  The lock is only taken to add or remove a
+  // stat, or to publish them, never when updating a stat.
+  std::mutex mutex_;
+  std::unordered_set<TLStatBase*> stats_;
 };
 
 }}
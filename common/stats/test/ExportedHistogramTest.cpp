@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ExportedHistogram.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::stats;
+using std::chrono::seconds;
+
+namespace {
+
+const seconds kNow(1000000);
+
+} // unnamed namespace
+
+TEST(ExportedHistogram, Percentiles) {
+  ExportedHistogramMap histMap;
+  ExportedHistogram templateHist(10, 0, 1000);
+  bool created = false;
+  auto hist = histMap.getOrCreateUnlocked("lat", &templateHist, &created);
+  EXPECT_TRUE(created);
+  histMap.exportPercentile("lat", 90);
+
+  // 0 to 999, once each
+  for (int64_t value = 0; value < 1000; ++value) {
+    hist.second->addValue(kNow - seconds(10), value);
+  }
+
+  std::map<std::string, int64_t> counters;
+  histMap.getCounters(kNow, &counters);
+  // Estimates are interpolated within a bucket
+  for (auto suffix : {".60", ".600", ".3600", ""}) {
+    auto name = [&](const char* stat) {
+      return std::string("lat.") + stat + suffix;
+    };
+    EXPECT_NEAR(500, counters[name("p50")], 10);
+    EXPECT_NEAR(900, counters[name("p90")], 10);
+    EXPECT_NEAR(950, counters[name("p95")], 10);
+    EXPECT_NEAR(990, counters[name("p99")], 10);
+    EXPECT_EQ(499, counters[name("avg")]);
+  }
+  // avg and four percentiles over four levels
+  EXPECT_EQ(20, counters.size());
+}
+
+TEST(ExportedHistogram, Expiry) {
+  ExportedHistogramMap histMap;
+  ExportedHistogram templateHist(10, 0, 100);
+  auto hist = histMap.getOrCreateUnlocked("lat", &templateHist);
+  hist.second->addValue(kNow - seconds(90), 55);
+
+  std::map<std::string, int64_t> counters;
+  histMap.getCounters(kNow, &counters);
+  EXPECT_EQ(0, counters["lat.avg.60"]);
+  EXPECT_EQ(55, counters["lat.avg.600"]);
+  EXPECT_NEAR(55, counters["lat.p50.600"], 10);
+  EXPECT_NEAR(55, counters["lat.p50"], 10);
+}
+
+TEST(ExportedHistogram, GetOrCreate) {
+  ExportedHistogramMap histMap;
+  EXPECT_FALSE(histMap.getLockAndHistogram("lat").second);
+  // Exporting a percentile of a missing histogram does nothing
+  histMap.exportPercentile("lat", 90);
+
+  ExportedHistogram templateHist(10, 0, 100);
+  bool created = false;
+  auto hist1 = histMap.getOrCreateUnlocked("lat", &templateHist, &created);
+  EXPECT_TRUE(created);
+  auto hist2 = histMap.getOrCreateUnlocked("lat", &templateHist, &created);
+  EXPECT_FALSE(created);
+  EXPECT_EQ(hist1.second, hist2.second);
+  EXPECT_EQ(hist1.second, histMap.getLockAndHistogram("lat").second);
+
+  // A copy of the template, not the template itself
+  EXPECT_NE(&templateHist, hist1.second.get());
+  EXPECT_EQ(templateHist.getNumBuckets(), hist1.second->getNumBuckets());
+
+  std::map<std::string, int64_t> counters;
+  histMap.getCounters(kNow, &counters);
+  EXPECT_EQ(0, counters.count("lat.p90.60"));
+  EXPECT_EQ(1, counters.count("lat.p99.60"));
+}
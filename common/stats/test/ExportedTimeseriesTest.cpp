@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ExportedTimeseries.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::stats;
+using std::chrono::seconds;
+
+namespace {
+
+const seconds kNow(1000000);
+
+std::map<std::string, int64_t> getCounters(ExportedStatMap* statMap) {
+  std::map<std::string, int64_t> counters;
+  statMap->getCounters(kNow, &counters);
+  return counters;
+}
+
+} // unnamed namespace
+
+TEST(ExportedTimeseries, CounterNames) {
+  EXPECT_EQ("foo.sum.60", getCounterName("foo", "sum", seconds(60)));
+  EXPECT_EQ("foo.p99.3600", getCounterName("foo", "p99", seconds(3600)));
+  EXPECT_EQ("foo.rate", getCounterName("foo", "rate", seconds(0)));
+}
+
+TEST(ExportedTimeseries, Levels) {
+  ExportedStatMap statMap;
+  auto type = SUM;
+  auto stat = statMap.getLockAndStatItem("foo", &type).second;
+  statMap.exportStat("foo", COUNT);
+  statMap.exportStat("foo", AVG);
+
+  // One value falling into each level, and none of the shorter ones
+  stat->addValue(kNow - seconds(5000), 4000);
+  stat->addValue(kNow - seconds(1800), 400);
+  stat->addValue(kNow - seconds(300), 40);
+  stat->addValue(kNow - seconds(10), 4);
+
+  auto counters = getCounters(&statMap);
+  EXPECT_EQ(4, counters["foo.sum.60"]);
+  EXPECT_EQ(44, counters["foo.sum.600"]);
+  EXPECT_EQ(444, counters["foo.sum.3600"]);
+  EXPECT_EQ(4444, counters["foo.sum"]);
+
+  EXPECT_EQ(1, counters["foo.count.60"]);
+  EXPECT_EQ(2, counters["foo.count.600"]);
+  EXPECT_EQ(3, counters["foo.count.3600"]);
+  EXPECT_EQ(4, counters["foo.count"]);
+
+  EXPECT_EQ(4, counters["foo.avg.60"]);
+  EXPECT_EQ(22, counters["foo.avg.600"]);
+  EXPECT_EQ(148, counters["foo.avg.3600"]);
+  EXPECT_EQ(1111, counters["foo.avg"]);
+
+  // Only the export types asked for are exported
+  EXPECT_EQ(12, counters.size());
+  EXPECT_EQ(0, counters.count("foo.rate.60"));
+}
+
+TEST(ExportedTimeseries, Rate) {
+  ExportedStatMap statMap;
+  auto type = RATE;
+  auto stat = statMap.getLockAndStatItem("foo", &type).second;
+
+  // 600 a second over the last two minutes
+  for (int ago = 119; ago >= 0; --ago) {
+    stat->addValue(kNow - seconds(ago), 600);
+  }
+
+  // Allow for the rounding at either end of the time covered
+  auto counters = getCounters(&statMap);
+  EXPECT_NEAR(600, counters["foo.rate.60"], 10);
+  EXPECT_NEAR(600, counters["foo.rate.600"], 10);
+  EXPECT_NEAR(600, counters["foo.rate.3600"], 10);
+  EXPECT_NEAR(600, counters["foo.rate"], 10);
+}
+
+TEST(ExportedTimeseries, Expiry) {
+  ExportedStatMap statMap;
+  auto type = SUM;
+  auto stat = statMap.getLockAndStatItem("foo", &type).second;
+  stat->addValue(kNow - seconds(90), 5);
+
+  // The minute level is expired when the counters are read, even though
+  // nothing was added since
+  auto counters = getCounters(&statMap);
+  EXPECT_EQ(0, counters["foo.sum.60"]);
+  EXPECT_EQ(5, counters["foo.sum.600"]);
+  EXPECT_EQ(5, counters["foo.sum"]);
+}
+
+TEST(ExportedTimeseries, SameStat) {
+  ExportedStatMap statMap;
+  auto item1 = statMap.getLockAndStatItem("foo");
+  auto item2 = statMap.getLockAndStatItem("foo");
+  EXPECT_EQ(item1.first, item2.first);
+  EXPECT_EQ(item1.second, item2.second);
+  EXPECT_EQ(item1.second, statMap.getStatPtr("foo"));
+  EXPECT_NE(item1.second, statMap.getStatPtr("bar"));
+
+  // Neither is exported yet
+  EXPECT_TRUE(getCounters(&statMap).empty());
+}
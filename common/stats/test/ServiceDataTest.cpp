@@ -0,0 +1,61 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ServiceData.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::stats;
+
+TEST(ServiceData, Counters) {
+  ServiceData data;
+  EXPECT_EQ(0, data.getCounter("foo"));
+  data.setCounter("foo", 5);
+  EXPECT_EQ(7, data.incrementCounter("foo", 2));
+  EXPECT_EQ(1, data.incrementCounter("bar"));
+  EXPECT_EQ(7, data.getCounter("foo"));
+
+  EXPECT_EQ(7, data.clearCounter("foo"));
+  EXPECT_EQ(0, data.getCounter("foo"));
+  EXPECT_EQ(0, data.clearCounter("foo"));
+}
+
+TEST(ServiceData, GetCounters) {
+  ServiceData data;
+  data.setCounter("simple", 3);
+  auto type = SUM;
+  auto stat = data.getStatMap()->getLockAndStatItem("stat", &type);
+  stat.second->addValue(currentTime(), 8);
+  ExportedHistogram templateHist(10, 0, 100);
+  auto hist =
+    data.getHistogramMap()->getOrCreateUnlocked("hist", &templateHist);
+  hist.second->addValue(currentTime(), 20);
+
+  std::map<std::string, int64_t> counters;
+  data.getCounters(counters);
+  EXPECT_EQ(3, counters["simple"]);
+  // Only the all-time level is checked, the others depend on how long
+  // the test took
+  EXPECT_EQ(8, counters["stat.sum"]);
+  EXPECT_EQ(20, counters["hist.avg"]);
+  for (auto name : {"stat.sum.60", "stat.sum.600", "stat.sum.3600",
+                    "hist.avg.60", "hist.p50.600", "hist.p99.3600",
+                    "hist.p95"}) {
+    EXPECT_EQ(1, counters.count(name)) << name;
+  }
+  // A simple counter, 4 levels of a sum, and 4 levels of avg and three
+  // percentiles
+  EXPECT_EQ(21, counters.size());
+
+  // Simple counters win over a stat of the same name
+  data.setCounter("stat.sum", 100);
+  counters.clear();
+  data.getCounters(counters);
+  EXPECT_EQ(100, counters["stat.sum"]);
+}
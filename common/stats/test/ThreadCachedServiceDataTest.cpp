@@ -0,0 +1,130 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ThreadCachedServiceData.h"
+
+#include "common/stats/ServiceData.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace facebook::stats;
+
+namespace {
+
+using TLTimeseries = ThreadCachedServiceData::TLTimeseries;
+using TLHistogram = ThreadCachedServiceData::TLHistogram;
+
+/*
+ * The stats are published at the current time, so only the all-time
+ * counters are checked: the others depend on when the test runs.
+ */
+class ThreadCachedServiceDataTest : public ::testing::Test {
+ protected:
+  int64_t getCounter(const std::string& name) {
+    std::map<std::string, int64_t> counters;
+    serviceData_.getCounters(counters);
+    auto it = counters.find(name);
+    EXPECT_NE(counters.end(), it) << name << " is not exported";
+    return it == counters.end() ? 0 : it->second;
+  }
+
+  int64_t histogramCount(const std::string& name) {
+    auto hist = serviceData_.getHistogramMap()->getLockAndHistogram(name);
+    return hist.second->count(hist.second->numLevels() - 1);
+  }
+
+  ServiceData serviceData_;
+  ThreadCachedServiceData tcData_{&serviceData_};
+};
+
+} // unnamed namespace
+
+TEST_F(ThreadCachedServiceDataTest, TimeseriesPublishesDeltas) {
+  TLTimeseries stat(tcData_.getThreadStats(), "foo", SUM, COUNT);
+  stat.addValue(5);
+  stat.addValue(7);
+  // Nothing is visible before it is published
+  EXPECT_EQ(0, getCounter("foo.sum"));
+
+  tcData_.publishStats();
+  EXPECT_EQ(12, getCounter("foo.sum"));
+  EXPECT_EQ(2, getCounter("foo.count"));
+
+  // Publishing again without new values adds nothing
+  tcData_.publishStats();
+  EXPECT_EQ(12, getCounter("foo.sum"));
+  EXPECT_EQ(2, getCounter("foo.count"));
+
+  stat.addValue(3);
+  tcData_.publishStats();
+  EXPECT_EQ(15, getCounter("foo.sum"));
+  EXPECT_EQ(3, getCounter("foo.count"));
+}
+
+TEST_F(ThreadCachedServiceDataTest, TimeseriesPerThread) {
+  // Each thread has its own stat, and they add up in the shared one
+  TLTimeseries stat(tcData_.getThreadStats(), "foo", SUM);
+  stat.addValue(1);
+  std::thread thread([&] {
+      TLTimeseries threadStat(tcData_.getThreadStats(), "foo", SUM);
+      threadStat.addValue(10);
+      tcData_.publishStats();
+    });
+  thread.join();
+  tcData_.publishStats();
+  EXPECT_EQ(11, getCounter("foo.sum"));
+}
+
+TEST_F(ThreadCachedServiceDataTest, TimeseriesUnlinkKeepsValues) {
+  std::thread thread([&] {
+      TLTimeseries stat(tcData_.getThreadStats(), "foo", SUM, COUNT);
+      stat.addValue(1);
+      tcData_.publishStats();
+      stat.addValue(41);
+      // Never published before the thread exits
+    });
+  thread.join();
+  EXPECT_EQ(42, getCounter("foo.sum"));
+  EXPECT_EQ(2, getCounter("foo.count"));
+
+  // The stat is gone, so this must not touch it
+  tcData_.publishStats();
+  EXPECT_EQ(42, getCounter("foo.sum"));
+}
+
+TEST_F(ThreadCachedServiceDataTest, HistogramPublishesDeltas) {
+  TLHistogram hist(tcData_.getThreadStats(), "lat", 10, 0, 100);
+  hist.addValue(15);
+  hist.addRepeatedValue(55, 3);
+  // Out of range values go to the outer buckets
+  hist.addValue(-5);
+  hist.addValue(500);
+
+  tcData_.publishStats();
+  EXPECT_EQ(6, histogramCount("lat"));
+  tcData_.publishStats();
+  EXPECT_EQ(6, histogramCount("lat"));
+
+  hist.addValue(15);
+  tcData_.publishStats();
+  EXPECT_EQ(7, histogramCount("lat"));
+  EXPECT_NEAR(55, getCounter("lat.p50"), 10);
+}
+
+TEST_F(ThreadCachedServiceDataTest, HistogramUnlinkKeepsValues) {
+  std::thread thread([&] {
+      TLHistogram hist(tcData_.getThreadStats(), "lat", 10, 0, 100);
+      hist.addRepeatedValue(25, 4);
+    });
+  thread.join();
+  EXPECT_EQ(4, histogramCount("lat"));
+  EXPECT_EQ(25, getCounter("lat.avg"));
+}
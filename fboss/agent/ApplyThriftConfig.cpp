@@ -32,6 +32,8 @@
 
 #include <boost/container/flat_set.hpp>
 
+#include <algorithm>
+
 using boost::container::flat_map;
 using boost::container::flat_set;
 using folly::IPAddress;
@@ -124,6 +126,7 @@ class ThriftConfigApplier {
   std::string getInterfaceName(const cfg::Interface* config);
   folly::MacAddress getInterfaceMac(const cfg::Interface* config);
   Interface::Addresses getInterfaceAddresses(const cfg::Interface* config);
+  std::vector<cfg::PacketPolicer> getPacketPolicers();
 
   std::shared_ptr<SwitchState> orig_;
   const cfg::SwitchConfig* cfg_{nullptr};
@@ -264,6 +267,12 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
     changed = true;
   }
 
+  auto packetPolicers = getPacketPolicers();
+  if (orig_->getPacketPolicers() != packetPolicers) {
+    newState->setPacketPolicers(std::move(packetPolicers));
+    changed = true;
+  }
+
 
   if (!changed) {
     return nullptr;
@@ -271,6 +280,28 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
   return newState;
 }
 
+std::vector<cfg::PacketPolicer> ThriftConfigApplier::getPacketPolicers() {
+  auto policers = cfg_->packetPolicers;
+  std::sort(policers.begin(), policers.end(),
+            [](const cfg::PacketPolicer& a, const cfg::PacketPolicer& b) {
+              return a.packetClass < b.packetClass;
+            });
+  for (size_t idx = 0; idx < policers.size(); ++idx) {
+    const auto& policer = policers[idx];
+    if (idx > 0 && policers[idx - 1].packetClass == policer.packetClass) {
+      throw FbossError("Multiple packet policers for class ",
+                       static_cast<int>(policer.packetClass));
+    }
+    if (policer.packetsPerSecond <= 0 || policer.burstSize < 0) {
+      throw FbossError("Invalid packet policer for class ",
+                       static_cast<int>(policer.packetClass), ": ",
+                       policer.packetsPerSecond, " packets per second, burst ",
+                       policer.burstSize);
+    }
+  }
+  return policers;
+}
+
 void ThriftConfigApplier::processVlanPorts() {
   // Build the Port --> Vlan mappings
   //
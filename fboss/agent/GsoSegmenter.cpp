@@ -0,0 +1,191 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/GsoSegmenter.h"
+
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/TxPacket.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/PktUtil.h"
+
+#include <folly/Bits.h>
+#include <folly/io/IOBuf.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+constexpr uint32_t kIPv4MinHdrLen = 20;
+constexpr uint32_t kIPv6HdrLen = 40;
+constexpr uint32_t kTcpMinHdrLen = 20;
+constexpr uint32_t kTcpSeqOffset = 4;
+constexpr uint32_t kTcpFlagsOffset = 13;
+constexpr uint32_t kTcpCsumOffset = 16;
+constexpr uint8_t kTcpFin = 0x01;
+constexpr uint8_t kTcpPsh = 0x08;
+constexpr uint8_t kTcpCwr = 0x80;
+
+uint16_t readBE16(const uint8_t* p) {
+  return folly::Endian::big(folly::loadUnaligned<uint16_t>(p));
+}
+
+uint32_t readBE32(const uint8_t* p) {
+  return folly::Endian::big(folly::loadUnaligned<uint32_t>(p));
+}
+
+void writeBE16(uint8_t* p, uint16_t value) {
+  folly::storeUnaligned<uint16_t>(p, folly::Endian::big(value));
+}
+
+void writeBE32(uint8_t* p, uint32_t value) {
+  folly::storeUnaligned<uint32_t>(p, folly::Endian::big(value));
+}
+
+/*
+ * The TCP/UDP pseudo header sum of the IP packet starting at ip, with its
+ * carries folded.  This is what the kernel leaves in the checksum field of
+ * a packet it wants us to checksum.
+ */
+uint16_t pseudoHeaderSum(const uint8_t* ip, bool v4, uint8_t proto,
+                         uint32_t l4Len) {
+  const uint8_t* addrs = v4 ? ip + 12 : ip + 8;
+  uint32_t addrsLen = v4 ? 8 : 32;
+  uint32_t sum = 0;
+  for (uint32_t idx = 0; idx < addrsLen; idx += 2) {
+    sum += readBE16(addrs + idx);
+  }
+  sum += proto + (l4Len >> 16) + (l4Len & 0xffff);
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return sum;
+}
+
+/*
+ * Checksum data[start, length) and store the result at start + offset.  The
+ * checksum field must already hold the pseudo header sum.
+ */
+void storeChecksum(uint8_t* data, uint32_t start, uint32_t offset,
+                   uint32_t length) {
+  uint16_t csum = PktUtil::internetChecksum(data + start, length - start);
+  // A UDP checksum of 0 means no checksum; 0xffff is the same value in one's
+  // complement arithmetic, and the kernel uses it for TCP too.
+  writeBE16(data + start + offset, csum ? csum : 0xffff);
+}
+
+} // unnamed namespace
+
+uint32_t GsoSegmenter::segment(const VnetHdr& vnetHdr,
+                               const uint8_t* data, uint32_t length,
+                               const AllocFn& alloc, const SendFn& send) {
+  auto gsoType = vnetHdr.gsoType & ~VnetHdr::GSO_ECN;
+  bool v4;
+  uint32_t l4Off;
+  if (gsoType == VnetHdr::GSO_TCPV4) {
+    if (length < kIPv4MinHdrLen || (data[0] >> 4) != 4) {
+      throw FbossError("Malformed IPv4 GSO packet of ", length, " bytes");
+    }
+    v4 = true;
+    l4Off = (data[0] & 0x0f) * 4;
+    if (l4Off < kIPv4MinHdrLen || data[9] != IP_PROTO::IP_PROTO_TCP) {
+      throw FbossError("Unexpected IPv4 header in GSO packet, length ",
+                       l4Off, " protocol ", static_cast<int>(data[9]));
+    }
+  } else if (gsoType == VnetHdr::GSO_TCPV6) {
+    if (length < kIPv6HdrLen || (data[0] >> 4) != 6) {
+      throw FbossError("Malformed IPv6 GSO packet of ", length, " bytes");
+    }
+    v4 = false;
+    l4Off = kIPv6HdrLen;
+    // The kernel does not set extension headers on TCP packets it sends
+    if (data[6] != IP_PROTO::IP_PROTO_TCP) {
+      throw FbossError("Unexpected next header ", static_cast<int>(data[6]),
+                       " in IPv6 GSO packet");
+    }
+  } else {
+    throw FbossError("Unsupported GSO type ",
+                     static_cast<int>(vnetHdr.gsoType));
+  }
+  if (length < l4Off + kTcpMinHdrLen) {
+    throw FbossError("Truncated TCP header in GSO packet of ", length,
+                     " bytes");
+  }
+  const uint8_t* tcp = data + l4Off;
+  uint32_t hdrLen = l4Off + (tcp[12] >> 4) * 4;
+  uint32_t mss = vnetHdr.gsoSize;
+  if (hdrLen < l4Off + kTcpMinHdrLen || hdrLen > length || mss == 0) {
+    throw FbossError("Bad GSO packet: length ", length, " headers ", hdrLen,
+                     " segment size ", mss);
+  }
+
+  uint32_t payloadLen = length - hdrLen;
+  uint32_t seq = readBE32(tcp + kTcpSeqOffset);
+  uint8_t flags = tcp[kTcpFlagsOffset];
+  uint16_t ipId = v4 ? readBE16(data + 4) : 0;
+  uint32_t count = 0;
+  uint32_t offset = 0;
+  do {
+    uint32_t segLen = std::min(mss, payloadLen - offset);
+    uint32_t pktLen = hdrLen + segLen;
+    bool last = offset + segLen == payloadLen;
+
+    auto pkt = alloc(pktLen);
+    auto buf = pkt->buf();
+    uint8_t* out = buf->writableTail();
+    memcpy(out, data, hdrLen);
+    memcpy(out + hdrLen, data + hdrLen + offset, segLen);
+    buf->append(pktLen);
+
+    // FIN and PSH belong to the last segment only, CWR to the first
+    uint8_t* outTcp = out + l4Off;
+    uint8_t segFlags = flags;
+    if (!last) {
+      segFlags &= ~(kTcpFin | kTcpPsh);
+    }
+    if (count > 0) {
+      segFlags &= ~kTcpCwr;
+    }
+    outTcp[kTcpFlagsOffset] = segFlags;
+    writeBE32(outTcp + kTcpSeqOffset, seq + offset);
+
+    uint32_t tcpLen = pktLen - l4Off;
+    if (v4) {
+      writeBE16(out + 2, pktLen);
+      writeBE16(out + 4, ipId + count);
+      writeBE16(out + 10, 0);
+      writeBE16(out + 10, PktUtil::internetChecksum(out, l4Off));
+    } else {
+      writeBE16(out + 4, tcpLen);
+    }
+    writeBE16(outTcp + kTcpCsumOffset,
+              pseudoHeaderSum(out, v4, IP_PROTO::IP_PROTO_TCP, tcpLen));
+    storeChecksum(out, l4Off, kTcpCsumOffset, pktLen);
+
+    send(std::move(pkt));
+    ++count;
+    offset += segLen;
+  } while (offset < payloadLen);
+  return count;
+}
+
+void GsoSegmenter::completeChecksum(const VnetHdr& vnetHdr,
+                                    uint8_t* data, uint32_t length) {
+  uint32_t start = vnetHdr.csumStart;
+  uint32_t offset = vnetHdr.csumOffset;
+  if (start + offset + sizeof(uint16_t) > length) {
+    throw FbossError("Checksum at ", start, "+", offset,
+                     " is beyond the packet of ", length, " bytes");
+  }
+  storeChecksum(data, start, offset, length);
+}
+
+}} // facebook::fboss
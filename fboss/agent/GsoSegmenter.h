@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace facebook { namespace fboss {
+
+class TxPacket;
+
+/*
+ * The header the kernel puts in front of each packet on a TUN device opened
+ * with IFF_VNET_HDR.  This has the layout of struct virtio_net_hdr, which
+ * can't be used directly as <linux/virtio_net.h> doesn't compile as C++ with
+ * recent kernel headers.  Fields are in host byte order.
+ */
+struct VnetHdr {
+  enum : uint8_t {
+    F_NEEDS_CSUM = 1,
+  };
+  enum : uint8_t {
+    GSO_NONE = 0,
+    GSO_TCPV4 = 1,
+    GSO_UDP = 3,
+    GSO_TCPV6 = 4,
+    GSO_ECN = 0x80,
+  };
+
+  uint8_t flags;
+  uint8_t gsoType;
+  uint16_t hdrLen;
+  uint16_t gsoSize;
+  uint16_t csumStart;
+  uint16_t csumOffset;
+};
+static_assert(sizeof(VnetHdr) == 10, "VnetHdr must match virtio_net_hdr");
+
+/*
+ * GsoSegmenter finishes the offloads the kernel left to us on packets read
+ * from a TUN device opened with IFF_VNET_HDR.
+ *
+ * With offloads enabled the kernel may hand us a TCP "super frame" of up to
+ * 64KB, to be cut into segments of at most gsoSize bytes of payload, and
+ * packets whose TCP or UDP checksum only covers the pseudo header.  The ASIC
+ * does neither of these, so they are done here before the packets are sent.
+ *
+ * All packets given to these functions contain an IPv4 or IPv6 header
+ * followed by the payload, with no L2 header.
+ */
+class GsoSegmenter {
+ public:
+  typedef std::function<std::unique_ptr<TxPacket>(uint32_t l3Len)> AllocFn;
+  typedef std::function<void(std::unique_ptr<TxPacket>)> SendFn;
+
+  /*
+   * Cut the TCP packet in data into segments described by vnetHdr.
+   *
+   * Each segment is allocated with alloc(), which must return a packet
+   * whose buffer has at least the requested tailroom, and passed to send().
+   *
+   * Returns the number of segments sent.  Throws an FbossError if the packet
+   * is malformed or not a GSO type we enable, in which case nothing is sent.
+   */
+  static uint32_t segment(const VnetHdr& vnetHdr,
+                          const uint8_t* data, uint32_t length,
+                          const AllocFn& alloc, const SendFn& send);
+
+  /*
+   * Fill in the L4 checksum of a packet read with VnetHdr::F_NEEDS_CSUM
+   * set, in place.
+   */
+  static void completeChecksum(const VnetHdr& vnetHdr,
+                               uint8_t* data, uint32_t length);
+
+  /*
+   * Return true if vnetHdr says the packet needs no work before it is sent.
+   */
+  static bool isPlain(const VnetHdr& vnetHdr) {
+    return vnetHdr.gsoType == VnetHdr::GSO_NONE &&
+      !(vnetHdr.flags & VnetHdr::F_NEEDS_CSUM);
+  }
+
+  static bool isGso(const VnetHdr& vnetHdr) {
+    return vnetHdr.gsoType != VnetHdr::GSO_NONE;
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  GsoSegmenter(GsoSegmenter const &) = delete;
+  GsoSegmenter& operator=(GsoSegmenter const &) = delete;
+};
+
+}} // facebook::fboss
@@ -215,7 +215,7 @@ bool IPv4Handler::resolveMac(SwitchState* state, IPAddressV4 dest) {
     throw FbossError("No routing tables found");
   }
 
-  auto route = routeTable->getRibV4()->longestMatch(dest);
+  auto route = routeTable->getRibV4()->fastLongestMatch(dest);
   if (!route || !route->isResolved()) {
     // No way to reach dest
     return false;
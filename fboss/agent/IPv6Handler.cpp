@@ -578,7 +578,7 @@ void IPv6Handler::sendNeighborSolicitations(
     return;
   }
 
-  auto route = routeTable->getRibV6()->longestMatch(targetIP);
+  auto route = routeTable->getRibV6()->fastLongestMatch(targetIP);
   if (!route || !route->isResolved()) {
     // No way to reach targetIP
     return;
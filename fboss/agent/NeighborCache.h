@@ -12,6 +12,7 @@
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/NeighborCacheImpl-defs.h"
 #include "fboss/agent/NeighborCacheEntry.h"
+#include "fboss/agent/TimerWheel.h"
 
 #include <chrono>
 #include <folly/Memory.h>
@@ -33,14 +34,20 @@ namespace facebook { namespace fboss {
  *
  * This class wraps the common logic for a NeighborCache. It is meant to be
  * extended for ARP/NDP specific caches.
+ *
+ * The entries' timeouts are scheduled in the SwSwitch's neighbor TimerWheel,
+ * which calls back into this class to process them.
  */
 template <typename NTable>
-class NeighborCache {
+class NeighborCache : private TimerWheel::Client {
   friend class NeighborCacheEntry<NTable>;
  public:
   typedef typename NTable::Entry::AddressType AddressType;
 
-  virtual ~NeighborCache() {}
+  virtual ~NeighborCache() {
+    // Wait for any timeout being processed, and make sure no more are
+    sw_->getNeighborTimerWheel()->removeClient(this);
+  }
 
   bool flushEntryBlocking (AddressType ip) {
     std::lock_guard<std::mutex> g(cacheLock_);
@@ -161,9 +168,15 @@ class NeighborCache {
     return impl_->flushEntry(ip);
   }
 
-  void processEntry(AddressType ip) {
+  // Called by a NeighborCacheEntry, which already holds cacheLock_
+  void scheduleEntryUpdate(uint32_t handle, std::chrono::milliseconds delay) {
+    auto token = impl_->newUpdateToken(handle);
+    sw_->getNeighborTimerWheel()->schedule(this, handle, token, delay);
+  }
+
+  void timerExpired(uint32_t handle, uint32_t token) noexcept override {
     std::lock_guard<std::mutex> g(cacheLock_);
-    return impl_->processEntry(ip);
+    impl_->processEntry(handle, token);
   }
 
   // Has the entry corresponding to ip has been hit in hw
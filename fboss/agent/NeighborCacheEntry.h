@@ -55,6 +55,10 @@
  * next update is scheduled. If the entry ever transitions to the EXPIRED state,
  * we do not schedule another update and the cache will flush the entry.
  *
+ * The timeouts live in the SwSwitch's neighbor TimerWheel rather than in the
+ * entry, and refer to it by its handle in the cache.  Scheduling a new update
+ * makes any update already scheduled stale, so it will be ignored.
+ *
  * There is no locking in this class. Instead, the class relies on the
  * synchronization provided by NeighborCache, which should lock around all calls
  * into the cache with a single cache level lock. This class should take care
@@ -77,40 +81,43 @@ enum class NeighborEntryState : uint8_t {
 template <typename NTable> class NeighborCache;
 
 template <typename NTable>
-class NeighborCacheEntry : private folly::AsyncTimeout {
+class NeighborCacheEntry {
  public:
   typedef typename NTable::Entry::AddressType AddressType;
   typedef NeighborCache<NTable> Cache;
   typedef NeighborCacheEntry<NTable> Entry;
   typedef NeighborEntryFields<AddressType> EntryFields;
-  NeighborCacheEntry(EntryFields fields,
+  NeighborCacheEntry(uint32_t handle,
+                     EntryFields fields,
                      folly::EventBase* evb,
                      Cache* cache,
                      NeighborEntryState state)
-      : AsyncTimeout(evb),
-        fields_(fields),
+      : fields_(fields),
         cache_(cache),
         evb_(evb),
+        handle_(handle),
         probesLeft_(cache_->getMaxNeighborProbes()) {
     enter(state);
   }
 
-  NeighborCacheEntry(AddressType ip,
+  NeighborCacheEntry(uint32_t handle,
+                     AddressType ip,
                      folly::MacAddress mac,
                      PortID port,
                      InterfaceID intf,
                      folly::EventBase* evb,
                      Cache* cache,
                      NeighborEntryState state)
-      : NeighborCacheEntry(EntryFields(ip, mac, port, intf),
+      : NeighborCacheEntry(handle, EntryFields(ip, mac, port, intf),
                            evb, cache, state) {}
 
-  NeighborCacheEntry(AddressType ip,
+  NeighborCacheEntry(uint32_t handle,
+                     AddressType ip,
                      InterfaceID intf,
                      NeighborState ignored,
                      folly::EventBase* evb,
                      Cache* cache)
-      : NeighborCacheEntry(EntryFields(ip, intf, ignored),
+      : NeighborCacheEntry(handle, EntryFields(ip, intf, ignored),
                            evb, cache, NeighborEntryState::INCOMPLETE) {}
 
   ~NeighborCacheEntry() {}
@@ -119,29 +126,19 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
    * Main entry point for handling the entries. Since entries may be
    * flushed by higher layers (thrift call etc.), we make sure we both
    * run the state machine and schedule the next update synchronously.
+   *
+   * This is only called for the latest update scheduled.  If an event
+   * restarted the state machine before an older update could be processed,
+   * the cache drops the older one.
    */
   void process() {
     CHECK(evb_->isInEventBaseThread());
-    if (isScheduled()) {
-      // This function should never reschedule a timeout, it should
-      // only create one if one does not already exist.  If a timeout
-      // exists, it is because some event was received that restarted
-      // the state machine before the old timeout could be processed.
-      return;
-    }
-
     runStateMachine();
     if (state_ != NeighborEntryState::EXPIRED) {
       scheduleNextUpdate();
     }
   }
 
-  static void destroy(std::shared_ptr<Entry> entry, folly::EventBase* evb) {
-    evb->runInEventBaseThread([entry]() {
-        entry->cancelTimeout();
-    });
-  }
-
   folly::MacAddress getMac() const {
     return fields_.mac;
   }
@@ -150,6 +147,10 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
     return fields_.ip;
   }
 
+  uint32_t getHandle() const {
+    return handle_;
+  }
+
   PortID getPortID() const {
     return fields_.port;
   }
@@ -212,34 +213,25 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
 
  private:
   /*
-   * We tell the cache that this entry needs to be processed. The cache is
-   * responsible for serializing this with other flush or rx events to prevent
-   * races.
-   */
-  virtual void timeoutExpired() noexcept {
-    cache_->processEntry(getIP());
-  }
-
-  /*
-   * Schedules an update on the evb_. This is done synchronously so that we
-   * can have a destructor guard around both running the state machine and
-   * scheduling the next update in timeoutExpired.
+   * Schedules the next update of this entry.  When it expires the cache
+   * processes the entry, serializing this with other flush or rx events to
+   * prevent races.
    */
   void scheduleNextUpdate() {
-    CHECK(evb_->inRunningEventBaseThread());
     std::chrono::milliseconds lifetime;
     switch (state_) {
       case NeighborEntryState::REACHABLE:
         lifetime = calculateLifetime();
         expireTime_ = std::chrono::steady_clock::now() + lifetime;
-        scheduleTimeout(lifetime);
+        cache_->scheduleEntryUpdate(handle_, lifetime);
         break;
       case NeighborEntryState::STALE:
-        scheduleTimeout(std::chrono::seconds(cache_->getStaleEntryInterval()));
+        cache_->scheduleEntryUpdate(
+            handle_, std::chrono::seconds(cache_->getStaleEntryInterval()));
         break;
       case NeighborEntryState::PROBE:
       case NeighborEntryState::INCOMPLETE:
-        scheduleTimeout(std::chrono::seconds(1));
+        cache_->scheduleEntryUpdate(handle_, std::chrono::seconds(1));
         break;
       case NeighborEntryState::EXPIRED:
         // This entry is expired and is already flushed. Don't schedule a
@@ -299,9 +291,7 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
         // We should never enter in any of these states
         throw FbossError("Tried to create entry with invalid state");
     }
-    evb_->runInEventBaseThread([this]() {
-        scheduleNextUpdate();
-    });
+    scheduleNextUpdate();
   }
 
   void probeIfProbesLeft() {
@@ -389,6 +379,8 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
   // Additional state kept per cache entry.
   Cache* cache_;
   folly::EventBase* evb_;
+  // Our handle in the cache, which identifies our timeouts
+  uint32_t handle_;
   NeighborEntryState state_{NeighborEntryState::UNINITIALIZED};
   uint8_t probesLeft_{0};
   std::chrono::time_point<std::chrono::steady_clock> expireTime_;
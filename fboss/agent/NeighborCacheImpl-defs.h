@@ -20,9 +20,12 @@
 #include "fboss/agent/state/NeighborEntry.h"
 #include <folly/MacAddress.h>
 #include <folly/IPAddress.h>
+#include <folly/Memory.h>
+#include <folly/String.h>
 #include <folly/io/async/EventBase.h>
-#include <folly/futures/Future.h>
 #include <list>
+#include <unordered_set>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
@@ -57,122 +60,227 @@ bool checkVlanAndIntf(
   return true;
 }
 
+/*
+ * Helpers that apply a single change to the neighbor table of a VLAN.  They
+ * return true if they changed the state, cloning it first if needed.
+ */
+template <typename NTable>
+bool programEntry(
+    std::shared_ptr<SwitchState>* state,
+    const typename NeighborCacheEntry<NTable>::EntryFields& fields,
+    VlanID vlanID) {
+  if (!checkVlanAndIntf<NTable>(*state, fields, vlanID)) {
+    // Either the vlan or intf is no longer valid.
+    return false;
+  }
+
+  auto* vlan = (*state)->getVlans()->getVlanIf(vlanID).get();
+  auto* table = vlan->template getNeighborTable<NTable>().get();
+  auto node = table->getNodeIf(fields.ip);
+
+  if (!node) {
+    table = table->modify(&vlan, state);
+    table->addEntry(fields);
+    VLOG(2) << "Adding entry for " << fields.ip << " --> " << fields.mac;
+  } else {
+    if (node->getMac() == fields.mac &&
+        node->getPort() == fields.port &&
+        node->getIntfID() == fields.interfaceID &&
+        node->getState() == fields.state &&
+        !node->isPending()) {
+      // This entry was already updated while we were waiting on the lock.
+      return false;
+    }
+    table = table->modify(&vlan, state);
+    table->updateEntry(fields);
+    VLOG(2) << "Converting pending entry for " << fields.ip << " --> "
+              << fields.mac;
+  }
+  return true;
 }
 
 template <typename NTable>
-void NeighborCacheImpl<NTable>::programEntry(Entry* entry) {
-  CHECK(!entry->isPending());
+bool programPendingEntry(
+    std::shared_ptr<SwitchState>* state,
+    const typename NeighborCacheEntry<NTable>::EntryFields& fields,
+    VlanID vlanID,
+    bool force) {
+  if (!checkVlanAndIntf<NTable>(*state, fields, vlanID)) {
+    // Either the vlan or intf is no longer valid.
+    return false;
+  }
 
-  auto fields = entry->getFields();
-  auto vlanID = vlanID_;
-  auto updateFn = [fields, vlanID](const std::shared_ptr<SwitchState>& state)
-      -> std::shared_ptr<SwitchState> {
-    if (!ncachehelpers::checkVlanAndIntf<NTable>(state, fields, vlanID)) {
-      // Either the vlan or intf is no longer valid.
-      return nullptr;
-    }
+  auto* vlan = (*state)->getVlans()->getVlanIf(vlanID).get();
+  auto* table = vlan->template getNeighborTable<NTable>().get();
+  auto node = table->getNodeIf(fields.ip);
+  if (node && !force) {
+    // don't replace an existing entry with a pending one unless
+    // explicitly allowed
+    return false;
+  }
 
-    auto vlan = state->getVlans()->getVlanIf(vlanID).get();
-    std::shared_ptr<SwitchState> newState{state};
-    auto* table = vlan->template getNeighborTable<NTable>().get();
-    auto node = table->getNodeIf(fields.ip);
-
-    if (!node) {
-      table = table->modify(&vlan, &newState);
-      table->addEntry(fields);
-      VLOG(2) << "Adding entry for " << fields.ip << " --> " << fields.mac;
-    } else {
-      if (node->getMac() == fields.mac &&
-          node->getPort() == fields.port &&
-          node->getIntfID() == fields.interfaceID &&
-          node->getState() == fields.state &&
-          !node->isPending()) {
-        // This entry was already updated while we were waiting on the lock.
-        return nullptr;
-      }
-      table = table->modify(&vlan, &newState);
-      table->updateEntry(fields);
-      VLOG(2) << "Converting pending entry for " << fields.ip << " --> "
-                << fields.mac;
-    }
-    return newState;
-  };
+  table = table->modify(&vlan, state);
+  if (node) {
+    table->removeEntry(fields.ip);
+  }
+  table->addPendingEntry(fields.ip, fields.interfaceID);
+
+  VLOG(4) << "Adding pending entry for " << fields.ip
+          << " on interface " << fields.interfaceID;
+  return true;
+}
+
+template <typename NTable>
+bool flushEntry(std::shared_ptr<SwitchState>* state,
+                typename NTable::Entry::AddressType ip,
+                VlanID vlanID) {
+  auto* vlan = (*state)->getVlans()->getVlanIf(vlanID).get();
+  if (!vlan) {
+    return false;
+  }
+  auto* table = vlan->template getNeighborTable<NTable>().get();
+  const auto& entry = table->getNodeIf(ip);
+  if (!entry) {
+    return false;
+  }
 
-  sw_->updateState(folly::to<std::string>("add neighbor ", fields.ip),
-                   std::move(updateFn));
+  table = table->modify(&vlan, state);
+  table->removeNode(ip);
+  return true;
 }
 
+}
 
 template <typename NTable>
-void NeighborCacheImpl<NTable>::programPendingEntry(Entry* entry, bool force) {
-  CHECK(entry->isPending());
+struct NeighborCacheImpl<NTable>::Batch {
+  struct Change {
+    Change(ChangeOp op, const EntryFields& fields, bool force)
+      : op(op), fields(fields), force(force) {}
+
+    ChangeOp op;
+    EntryFields fields;
+    bool force;
+  };
 
-  auto fields = entry->getFields();
-  auto vlanID = vlanID_;
-  auto updateFn = [fields, vlanID, force](
-    const std::shared_ptr<SwitchState>& state)
-      -> std::shared_ptr<SwitchState> {
-    if (!ncachehelpers::checkVlanAndIntf<NTable>(state, fields, vlanID)) {
-      // Either the vlan or intf is no longer valid.
-      return nullptr;
+  explicit Batch(bool allowCoalesce) : allowCoalesce(allowCoalesce) {}
+
+  // Batches with pending entries must not be coalesced with later updates,
+  // so the pending entries reach the hardware.
+  const bool allowCoalesce;
+  std::mutex mutex;
+  // Set once the update has taken the changes, or when no more changes
+  // should be added.  Later changes need a new batch.
+  bool closed{false};
+  std::vector<Change> changes;
+  // IPs with a pending entry in this batch.  Later changes for them go in
+  // a later batch, so the pending entry isn't overwritten before it is
+  // programmed.
+  std::unordered_set<AddressType> pendingIPs;
+};
+
+template <typename NTable>
+class NeighborCacheImpl<NTable>::BatchUpdate : public StateUpdate {
+ public:
+  BatchUpdate(std::shared_ptr<Batch> batch, VlanID vlanID)
+    : StateUpdate(folly::to<std::string>("neighbor updates for vlan ",
+                                         vlanID),
+                  batch->allowCoalesce),
+      batch_(std::move(batch)),
+      vlanID_(vlanID) {}
+
+  std::shared_ptr<SwitchState> applyUpdate(
+      const std::shared_ptr<SwitchState>& origState) override {
+    std::vector<typename Batch::Change> changes;
+    {
+      std::lock_guard<std::mutex> guard(batch_->mutex);
+      batch_->closed = true;
+      changes.swap(batch_->changes);
     }
 
-    auto vlan = state->getVlans()->getVlanIf(vlanID).get();
-    std::shared_ptr<SwitchState> newState{state};
-    auto* table = vlan->template getNeighborTable<NTable>().get();
-    auto node = table->getNodeIf(fields.ip);
-    table = table->modify(&vlan, &newState);
-
-    if (node) {
-      if (!force) {
-        // don't replace an existing entry with a pending one unless
-        // explicitly allowed
-        return nullptr;
+    std::shared_ptr<SwitchState> newState{origState};
+    bool changed = false;
+    for (const auto& change : changes) {
+      switch (change.op) {
+        case ChangeOp::PROGRAM:
+          changed |= ncachehelpers::programEntry<NTable>(
+            &newState, change.fields, vlanID_);
+          break;
+        case ChangeOp::PROGRAM_PENDING:
+          changed |= ncachehelpers::programPendingEntry<NTable>(
+            &newState, change.fields, vlanID_, change.force);
+          break;
+        case ChangeOp::FLUSH:
+          changed |= ncachehelpers::flushEntry<NTable>(
+            &newState, change.fields.ip, vlanID_);
+          break;
       }
-      table->removeEntry(fields.ip);
     }
-    table->addPendingEntry(fields.ip, fields.interfaceID);
+    VLOG(3) << "applied " << changes.size() << " neighbor changes for vlan "
+            << vlanID_;
+    return changed ? newState : nullptr;
+  }
 
-    VLOG(4) << "Adding pending entry for " << fields.ip
-            << " on interface " << fields.interfaceID;
-    return newState;
-  };
+  void onError(const std::exception& ex) noexcept override {
+    LOG(ERROR) << "failed to apply neighbor updates for vlan " << vlanID_
+               << ": " << folly::exceptionStr(ex);
+  }
+
+  void onSuccess() override {}
+
+ private:
+  std::shared_ptr<Batch> batch_;
+  VlanID vlanID_;
+};
+
+template <typename NTable>
+void NeighborCacheImpl<NTable>::queueChange(ChangeOp op,
+                                            const EntryFields& fields,
+                                            bool force) {
+  bool pending = op == ChangeOp::PROGRAM_PENDING;
+  if (batch_) {
+    std::lock_guard<std::mutex> guard(batch_->mutex);
+    if (!batch_->closed &&
+        (batch_->changes.size() >= kMaxBatchSize ||
+         batch_->pendingIPs.count(fields.ip) ||
+         (pending && batch_->allowCoalesce))) {
+      batch_->closed = true;
+    }
+    if (!batch_->closed) {
+      batch_->changes.emplace_back(op, fields, force);
+      if (pending) {
+        batch_->pendingIPs.insert(fields.ip);
+      }
+      return;
+    }
+  }
 
-  sw_->updateStateNoCoalescing(
-    folly::to<std::string>("add pending entry ", fields.ip),
-    std::move(updateFn));
+  batch_ = std::make_shared<Batch>(!pending);
+  batch_->changes.emplace_back(op, fields, force);
+  if (pending) {
+    batch_->pendingIPs.insert(fields.ip);
+  }
+  sw_->updateState(folly::make_unique<BatchUpdate>(batch_, vlanID_));
 }
 
 template <typename NTable>
-NeighborCacheImpl<NTable>::~NeighborCacheImpl() {
-  /* All the NeighborCacheEntries need to be destroyed on
-   * the background thread. Because we do not want to exit
-   * the destructor until all of the entries have stopped
-   * executing, we use folly futures to wait for all entries
-   * to destroy themselves.
-   */
-  std::vector<folly::Future<folly::Unit>> stopTasks;
-
-  for (auto item : entries_) {
-    auto addr = item.first;
-    auto entry = item.second;
-
-    std::function<void()> stopEntry = [this, entry]() {
-      Entry::destroy(std::move(entry), sw_->getBackgroundEVB());
-    };
-
-    // Run the stop function in the background thread to
-    // ensure it can be safely run
-    auto f = via(sw_->getBackgroundEVB())
-      .then(stopEntry)
-      .onError([=](const std::exception& e) {
-          LOG(FATAL) << "failed to stop NeighborCacheEntry w/ addr " << addr;
-        });
-    stopTasks.push_back(std::move(f));
+void NeighborCacheImpl<NTable>::closeBatch() {
+  if (batch_) {
+    std::lock_guard<std::mutex> guard(batch_->mutex);
+    batch_->closed = true;
   }
+  batch_.reset();
+}
+
+template <typename NTable>
+void NeighborCacheImpl<NTable>::programEntry(Entry* entry) {
+  CHECK(!entry->isPending());
+  queueChange(ChangeOp::PROGRAM, entry->getFields());
+}
 
-  // Ensure that all of the updaters have been stopped before we return
-  folly::collectAll(stopTasks).get();
+template <typename NTable>
+void NeighborCacheImpl<NTable>::programPendingEntry(Entry* entry, bool force) {
+  CHECK(entry->isPending());
+  queueChange(ChangeOp::PROGRAM_PENDING, entry->getFields(), force);
 }
 
 template <typename NTable>
@@ -233,10 +341,8 @@ NeighborCacheEntry<NTable>* NeighborCacheImpl<NTable>::setEntryInternal(
     entry->updateState(state);
     return changed ? entry : nullptr;
   } else if (add) {
-    auto evb = sw_->getBackgroundEVB();
-    auto to_store = std::make_shared<Entry>(fields, evb, cache_, state);
-    entry = to_store.get();
-    setCacheEntry(std::move(to_store));
+    entry = entries_.emplace(fields.ip, fields, sw_->getBackgroundEVB(),
+                             cache_, state);
   }
   return entry;
 }
@@ -259,67 +365,37 @@ void NeighborCacheImpl<NTable>::setPendingEntry(AddressType ip,
 }
 
 template <typename NTable>
-void NeighborCacheImpl<NTable>::processEntry(AddressType ip) {
-  auto entry = getCacheEntry(ip);
-  if (entry) {
-    entry->process();
-    if (entry->getState() == NeighborEntryState::EXPIRED) {
-      flushEntry(ip);
-    }
-  }
+uint32_t NeighborCacheImpl<NTable>::newUpdateToken(uint32_t handle) {
+  // Any update already scheduled for the entry is now stale
+  return entries_.bumpVersion(handle);
 }
 
 template <typename NTable>
-NeighborCacheEntry<NTable>* NeighborCacheImpl<NTable>::getCacheEntry(
-    AddressType ip) const {
-  auto it = entries_.find(ip);
-  if (it != entries_.end()) {
-    return it->second.get();
+void NeighborCacheImpl<NTable>::processEntry(uint32_t handle,
+                                             uint32_t token) {
+  auto entry = entries_.get(handle);
+  if (!entry || entries_.version(handle) != token) {
+    // The entry was flushed, or restarted its state machine, after this
+    // update was scheduled.
+    return;
+  }
+  entry->process();
+  if (entry->getState() == NeighborEntryState::EXPIRED) {
+    flushEntry(entry->getIP());
   }
-  return nullptr;
 }
 
 template <typename NTable>
-void NeighborCacheImpl<NTable>::setCacheEntry(std::shared_ptr<Entry> entry) {
-  entries_[entry->getIP()] = std::move(entry);
+NeighborCacheEntry<NTable>* NeighborCacheImpl<NTable>::getCacheEntry(
+    AddressType ip) {
+  return entries_.find(ip);
 }
 
 template <typename NTable>
 bool NeighborCacheImpl<NTable>::removeEntry(AddressType ip) {
-  auto it = entries_.find(ip);
-  if (it == entries_.end()) {
-    return false;
-  }
-
-  // This asynchronously destroys the entries. This is needed because
-  // entries need to be destroyed on the background thread, but we
-  // likely have the cache level lock here and the background thread could be
-  // waiting for the lock. To avoid this deadlock scenario, we keep the entry
-  // around in a shared_ptr for a bit longer and then destroy it later.
-  Entry::destroy(std::move(it->second), sw_->getBackgroundEVB());
-
-  entries_.erase(it);
-
-  return true;
-}
-
-template <typename NTable>
-bool NeighborCacheImpl<NTable>::flushEntryFromSwitchState(
-    std::shared_ptr<SwitchState>* state, AddressType ip) {
-  // The entry should be removed from the cache before it is
-  // flushed from the SwitchState
-  DCHECK(!getCacheEntry(ip));
-
-  auto* vlan = (*state)->getVlans()->getVlan(vlanID_).get();
-  auto* table = vlan->template getNeighborTable<NTable>().get();
-  const auto& entry = table->getNodeIf(ip);
-  if (!entry) {
-    return false;
-  }
-
-  table = table->modify(&vlan, state);
-  table->removeNode(ip);
-  return true;
+  // Erasing the entry makes any update scheduled for it stale, so there is
+  // no timeout to cancel.
+  return entries_.erase(ip);
 }
 
 template <typename NTable>
@@ -336,27 +412,29 @@ void NeighborCacheImpl<NTable>::flushEntry(AddressType ip, bool* flushed) {
     return;
   }
 
-  // flush from SwitchState
+  if (!flushed) {
+    // flush from SwitchState along with the other changes for this vlan
+    EntryFields fields(ip, intfID_, NeighborState::PENDING);
+    queueChange(ChangeOp::FLUSH, fields);
+    return;
+  }
+
+  // need a blocking state update if the caller wants to know if an entry
+  // was actually flushed.  Changes made after this one must not be applied
+  // before it, so they go in a new batch.
+  closeBatch();
+  auto vlanID = vlanID_;
   auto updateFn =
-    [this, ip, flushed](const std::shared_ptr<SwitchState>& state)
+    [ip, flushed, vlanID](const std::shared_ptr<SwitchState>& state)
         -> std::shared_ptr<SwitchState> {
     std::shared_ptr<SwitchState> newState{state};
-    if (flushEntryFromSwitchState(&newState, ip)) {
-      if (flushed) {
-        *flushed = true;
-      }
+    if (ncachehelpers::flushEntry<NTable>(&newState, ip, vlanID)) {
+      *flushed = true;
       return newState;
     }
     return nullptr;
   };
-
-  if (flushed) {
-    // need a blocking state update if the caller wants to know if an entry
-    // was actually flushed
-    sw_->updateStateBlocking("flush neighbor entry", std::move(updateFn));
-  } else {
-    sw_->updateState("remove neighbor entry", std::move(updateFn));
-  }
+  sw_->updateStateBlocking("flush neighbor entry", std::move(updateFn));
 }
 
 template <typename NTable>
@@ -371,11 +449,15 @@ NeighborCacheImpl<NTable>::cloneEntryFields(AddressType ip) {
 
 template <typename NTable>
 void NeighborCacheImpl<NTable>::portDown(PortID port) {
-  for (auto item : entries_) {
-    if (item.second->getPortID() != port) {
-      continue;
+  // setPendingEntry() may add entries, so find the ones to change first
+  std::vector<AddressType> ips;
+  entries_.forEach([&](const Entry& entry) {
+    if (entry.getPortID() == port) {
+      ips.push_back(entry.getIP());
     }
+  });
 
+  for (const auto& ip : ips) {
     // TODO(aeckert): It would be nicer if we could just mark this
     // entry stale on port down so we don't need to unprogram the
     // entry (for fast port flaps).  However, we have seen packet
@@ -384,7 +466,7 @@ void NeighborCacheImpl<NTable>::portDown(PortID port) {
     // programmed. Also we need to notify the HwSwitch for ECMP expand
     // when the port comes back up and changing an entry from pending
     // to reachable is how we currently do this.
-    setPendingEntry(item.second->getIP(), true);
+    setPendingEntry(ip, true);
   }
 }
 
@@ -392,11 +474,11 @@ template <typename NTable>
 template <typename NeighborEntryThrift>
 std::list<NeighborEntryThrift> NeighborCacheImpl<NTable>::getCacheData() const {
   std::list<NeighborEntryThrift> thriftEntries;
-  for (const auto& item : entries_) {
+  entries_.forEach([&](const Entry& entry) {
     NeighborEntryThrift thriftEntry;
-    item.second->populateThriftEntry(thriftEntry);
+    entry.populateThriftEntry(thriftEntry);
     thriftEntries.push_back(thriftEntry);
-  }
+  });
   return thriftEntries;
 }
 
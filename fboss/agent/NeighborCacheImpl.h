@@ -13,6 +13,7 @@
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/NeighborCacheEntry.h"
+#include "fboss/agent/NeighborEntryStore.h"
 #include "fboss/agent/state/NeighborEntry.h"
 
 #include <chrono>
@@ -20,6 +21,7 @@
 #include <folly/IPAddress.h>
 #include <folly/Random.h>
 #include <list>
+#include <memory>
 #include <string>
 
 namespace facebook { namespace fboss {
@@ -29,7 +31,7 @@ template <typename NTable> class NeighborCache;
 
 /*
  * This class manages the sw state of the neighbor tables. It has
- * a map of NeighborCacheEntries that should each correspond to
+ * a table of NeighborCacheEntries that should each correspond to
  * a NeighborEntry SwitchState node. These NeighborCacheEntries store additional
  * information and manage the logic for NDP-like expiration and unreachable
  * neighbor detection.
@@ -37,6 +39,12 @@ template <typename NTable> class NeighborCache;
  * All calls into this should have acquired a cache level lock through
  * NeighborCache so only one thread should ever be operating on the
  * cache at a given time.
+ *
+ * Changes to the SwitchState are batched: changes made before the update
+ * thread gets to the first one are applied with a single state update, up
+ * to kMaxBatchSize changes.  A pending entry must reach the hardware before
+ * it is replaced, so batches with pending entries are not coalesced with
+ * later updates, and later changes to the same IP go in the next batch.
  */
 template <typename NTable>
 class NeighborCacheImpl {
@@ -46,8 +54,6 @@ class NeighborCacheImpl {
   typedef NeighborCacheEntry<NTable> Entry;
   typedef typename Entry::EntryFields EntryFields;
 
-  ~NeighborCacheImpl();
-
   bool flushEntryBlocking (AddressType ip);
   void repopulate(std::shared_ptr<NTable> table);
 
@@ -114,21 +120,37 @@ class NeighborCacheImpl {
   std::list<NeighborEntryThrift> getCacheData() const;
 
  private:
+  enum class ChangeOp : uint8_t {
+    PROGRAM,
+    PROGRAM_PENDING,
+    FLUSH,
+  };
+  struct Batch;
+  class BatchUpdate;
+
+  static const size_t kMaxBatchSize = 1024;
+
   // These are used to program entries into the SwitchState
   void programEntry(Entry* entry);
   void programPendingEntry(Entry* entry, bool force = false);
 
-  void processEntry(AddressType ip);
+  // Add a change to the open batch, starting a new batch if needed
+  void queueChange(ChangeOp op, const EntryFields& fields,
+                   bool force = false);
+  // Make sure later changes go in a new batch
+  void closeBatch();
+
+  // Returns the token for a new update of the entry with the given handle
+  uint32_t newUpdateToken(uint32_t handle);
+  // Process the entry with the given handle, if token is the latest update
+  // scheduled for it
+  void processEntry(uint32_t handle, uint32_t token);
 
   // Pass in a non-null flushed if you care whether an entry
   // was actually flushed from the switch state
   void flushEntry (AddressType ip, bool* flushed = nullptr);
 
-  bool flushEntryFromSwitchState(std::shared_ptr<SwitchState>* state,
-                                 AddressType ip);
-
-  Entry* getCacheEntry(AddressType ip) const;
-  void setCacheEntry(std::shared_ptr<Entry> entry);
+  Entry* getCacheEntry(AddressType ip);
   bool removeEntry(AddressType ip);
 
   Entry* setEntryInternal(const EntryFields& fields,
@@ -145,8 +167,10 @@ class NeighborCacheImpl {
   std::string vlanName_;
   InterfaceID intfID_;
 
-  // Map of all entries
-  std::unordered_map<AddressType, std::shared_ptr<Entry>> entries_;
+  // All entries
+  NeighborEntryStore<AddressType, Entry> entries_;
+  // The batch of changes new changes are added to, if any
+  std::shared_ptr<Batch> batch_;
 };
 
 }} // facebook::fboss
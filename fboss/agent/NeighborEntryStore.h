@@ -0,0 +1,231 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Optional.h>
+#include <glog/logging.h>
+
+#include <deque>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * Storage for the entries of a neighbor cache.
+ *
+ * Entries are stored by value and identified by a small integer handle, so
+ * timers can refer to them without holding pointers.  Lookups by IP go
+ * through an open addressing (linear probing) index of handles, which is
+ * much denser than a node based hash map.
+ *
+ * Each handle also has a version, which survives the entry being erased and
+ * the handle reused.  It is bumped on erase, and by bumpVersion(), so a
+ * timer holding an old version can tell it is stale.
+ *
+ * EntryT must have a getIP() method returning its key, and is constructed
+ * with its handle as the first argument.  Pointers to entries stay valid
+ * until the entry is erased.
+ *
+ * There is no locking; NeighborCache serializes all access.
+ */
+template <typename AddressType, typename EntryT>
+class NeighborEntryStore {
+ public:
+  NeighborEntryStore() : index_(kMinCapacity, kEmpty) {}
+
+  size_t size() const {
+    return size_;
+  }
+
+  EntryT* find(const AddressType& ip) {
+    auto pos = findPos(ip);
+    if (pos == kNotFound) {
+      return nullptr;
+    }
+    return slots_[index_[pos]].entry.get_pointer();
+  }
+
+  const EntryT* find(const AddressType& ip) const {
+    return const_cast<NeighborEntryStore*>(this)->find(ip);
+  }
+
+  // Returns nullptr if handle doesn't refer to an entry
+  EntryT* get(uint32_t handle) {
+    if (handle >= slots_.size()) {
+      return nullptr;
+    }
+    return slots_[handle].entry.get_pointer();
+  }
+
+  /*
+   * Construct an entry for ip, which must not already be present.
+   */
+  template <typename... Args>
+  EntryT* emplace(const AddressType& ip, Args&&... args) {
+    DCHECK(findPos(ip) == kNotFound);
+    if ((size_ + deleted_ + 1) * 4 > index_.size() * 3) {
+      rehash();
+    }
+
+    uint32_t handle;
+    if (freeHandles_.empty()) {
+      handle = slots_.size();
+      slots_.emplace_back();
+    } else {
+      handle = freeHandles_.back();
+      freeHandles_.pop_back();
+    }
+
+    auto& slot = slots_[handle];
+    try {
+      slot.entry.emplace(handle, std::forward<Args>(args)...);
+    } catch (...) {
+      // The constructor may have scheduled timers for the handle
+      ++slot.version;
+      freeHandles_.push_back(handle);
+      throw;
+    }
+    DCHECK(slot.entry->getIP() == ip);
+
+    auto pos = hash(ip);
+    while (index_[pos] != kEmpty && index_[pos] != kDeleted) {
+      pos = (pos + 1) & mask();
+    }
+    if (index_[pos] == kDeleted) {
+      --deleted_;
+    }
+    index_[pos] = handle;
+    ++size_;
+    return slot.entry.get_pointer();
+  }
+
+  bool erase(const AddressType& ip) {
+    auto pos = findPos(ip);
+    if (pos == kNotFound) {
+      return false;
+    }
+    auto handle = index_[pos];
+    index_[pos] = kDeleted;
+    ++deleted_;
+    --size_;
+
+    auto& slot = slots_[handle];
+    slot.entry.clear();
+    ++slot.version;
+    freeHandles_.push_back(handle);
+    return true;
+  }
+
+  uint32_t version(uint32_t handle) const {
+    return slots_[handle].version;
+  }
+
+  uint32_t bumpVersion(uint32_t handle) {
+    return ++slots_[handle].version;
+  }
+
+  // Call fn(EntryT&) for every entry.  fn must not add or erase entries.
+  template <typename Fn>
+  void forEach(Fn&& fn) {
+    for (auto& slot : slots_) {
+      if (slot.entry) {
+        fn(*slot.entry);
+      }
+    }
+  }
+
+  template <typename Fn>
+  void forEach(Fn&& fn) const {
+    for (const auto& slot : slots_) {
+      if (slot.entry) {
+        fn(*slot.entry);
+      }
+    }
+  }
+
+ private:
+  struct Slot {
+    folly::Optional<EntryT> entry;
+    uint32_t version{0};
+  };
+
+  static constexpr uint32_t kEmpty = std::numeric_limits<uint32_t>::max();
+  static constexpr uint32_t kDeleted = kEmpty - 1;
+  static constexpr size_t kMinCapacity = 16;
+  static constexpr size_t kNotFound = std::numeric_limits<size_t>::max();
+
+  // Forbidden copy constructor and assignment operator
+  NeighborEntryStore(NeighborEntryStore const &) = delete;
+  NeighborEntryStore& operator=(NeighborEntryStore const &) = delete;
+
+  size_t mask() const {
+    return index_.size() - 1;
+  }
+
+  size_t hash(const AddressType& ip) const {
+    return std::hash<AddressType>()(ip) & mask();
+  }
+
+  // The position of ip in index_, or kNotFound
+  size_t findPos(const AddressType& ip) const {
+    auto pos = hash(ip);
+    while (index_[pos] != kEmpty) {
+      auto handle = index_[pos];
+      if (handle != kDeleted && slots_[handle].entry->getIP() == ip) {
+        return pos;
+      }
+      pos = (pos + 1) & mask();
+    }
+    return kNotFound;
+  }
+
+  void rehash() {
+    // Grow if the live entries alone would make the index more than half
+    // full, otherwise just clear out the deleted markers.
+    auto capacity = index_.size();
+    while ((size_ + 1) * 2 > capacity) {
+      capacity *= 2;
+    }
+    index_.assign(capacity, kEmpty);
+    deleted_ = 0;
+    for (uint32_t handle = 0; handle < slots_.size(); ++handle) {
+      if (!slots_[handle].entry) {
+        continue;
+      }
+      auto pos = hash(slots_[handle].entry->getIP());
+      while (index_[pos] != kEmpty) {
+        pos = (pos + 1) & mask();
+      }
+      index_[pos] = handle;
+    }
+  }
+
+  // Entries by handle.  A deque, so entries don't move when it grows.
+  std::deque<Slot> slots_;
+  std::vector<uint32_t> freeHandles_;
+  // Open addressing index of handles, sized to a power of two
+  std::vector<uint32_t> index_;
+  size_t size_{0};
+  size_t deleted_{0};
+};
+
+template <typename AddressType, typename EntryT>
+constexpr uint32_t NeighborEntryStore<AddressType, EntryT>::kEmpty;
+template <typename AddressType, typename EntryT>
+constexpr uint32_t NeighborEntryStore<AddressType, EntryT>::kDeleted;
+template <typename AddressType, typename EntryT>
+constexpr size_t NeighborEntryStore<AddressType, EntryT>::kMinCapacity;
+template <typename AddressType, typename EntryT>
+constexpr size_t NeighborEntryStore<AddressType, EntryT>::kNotFound;
+
+}} // facebook::fboss
@@ -0,0 +1,214 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PacketPolicer.h"
+
+#include "fboss/agent/ArpHandler.h"
+#include "fboss/agent/DHCPv4Handler.h"
+#include "fboss/agent/IPv4Handler.h"
+#include "fboss/agent/IPv6Handler.h"
+#include "fboss/agent/LldpManager.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/packet/DHCPv6Packet.h"
+#include "fboss/agent/packet/ICMPHdr.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/state/PortMap.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/Memory.h>
+#include <folly/io/Cursor.h>
+
+#include <algorithm>
+
+using folly::io::Cursor;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+const uint32_t kIPv4MinHdrLen = 20;
+const uint32_t kIPv6HdrLen = 40;
+
+uint16_t readBE16(const uint8_t* p) {
+  return (p[0] << 8) | p[1];
+}
+
+cfg::PacketPolicerClass classifyIPv4(const uint8_t* data, size_t length) {
+  if (length < kIPv4MinHdrLen) {
+    return cfg::PacketPolicerClass::IPV4;
+  }
+  auto proto = data[9];
+  if (proto == IP_PROTO::IP_PROTO_ICMP) {
+    return cfg::PacketPolicerClass::ICMPV4;
+  } else if (proto == IP_PROTO::IP_PROTO_UDP) {
+    // Same test as DHCPv4Handler::isDHCPv4Packet()
+    size_t l4Off = (data[0] & 0x0f) * 4;
+    if (length >= l4Off + 4) {
+      auto srcPort = readBE16(data + l4Off);
+      auto dstPort = readBE16(data + l4Off + 2);
+      if (srcPort == DHCPv4Handler::kBootPCPort ||
+          srcPort == DHCPv4Handler::kBootPSPort ||
+          dstPort == DHCPv4Handler::kBootPCPort ||
+          dstPort == DHCPv4Handler::kBootPSPort) {
+        return cfg::PacketPolicerClass::DHCPV4;
+      }
+    }
+  }
+  return cfg::PacketPolicerClass::IPV4;
+}
+
+cfg::PacketPolicerClass classifyIPv6(const uint8_t* data, size_t length) {
+  if (length < kIPv6HdrLen) {
+    return cfg::PacketPolicerClass::IPV6;
+  }
+  auto nextHeader = data[6];
+  if (nextHeader == IP_PROTO::IP_PROTO_IPV6_ICMP) {
+    if (length > kIPv6HdrLen) {
+      auto type = data[kIPv6HdrLen];
+      if (type >= ICMPV6_TYPE_NDP_ROUTER_SOLICITATION &&
+          type <= ICMPV6_TYPE_NDP_REDIRECT_MESSAGE) {
+        return cfg::PacketPolicerClass::NDP;
+      }
+    }
+    return cfg::PacketPolicerClass::ICMPV6;
+  } else if (nextHeader == IP_PROTO::IP_PROTO_UDP) {
+    if (length >= kIPv6HdrLen + 4) {
+      auto dstPort = readBE16(data + kIPv6HdrLen + 2);
+      if (dstPort == DHCPv6Packet::DHCP6_CLIENT_UDPPORT ||
+          dstPort == DHCPv6Packet::DHCP6_SERVERAGENT_UDPPORT) {
+        return cfg::PacketPolicerClass::DHCPV6;
+      }
+    }
+  }
+  return cfg::PacketPolicerClass::IPV6;
+}
+
+} // unnamed namespace
+
+PacketPolicer::PacketPolicer(SwSwitch* sw)
+  : AutoRegisterStateObserver(sw, "PacketPolicer") {
+  static_assert(
+      static_cast<uint32_t>(cfg::PacketPolicerClass::OTHER) + 1 == kNumClasses,
+      "kNumClasses must cover every PacketPolicerClass");
+}
+
+PacketPolicer::~PacketPolicer() {
+}
+
+bool PacketPolicer::allow(PortID port, cfg::PacketPolicerClass cls,
+                          uint64_t nowNsecs) {
+  auto idx = static_cast<uint32_t>(cls);
+  const auto& limit = limits_[idx];
+  uint64_t interval = limit.intervalNsecs.load(std::memory_order_relaxed);
+  if (interval == 0) {
+    return true;
+  }
+  auto buckets = buckets_.load(std::memory_order_acquire);
+  if (!buckets || static_cast<uint32_t>(port) >= buckets->numPorts) {
+    // A port we didn't know of when we were configured
+    return true;
+  }
+  uint64_t tolerance = limit.toleranceNsecs.load(std::memory_order_relaxed);
+  auto& tat = buckets->tats[static_cast<uint32_t>(port) * kNumClasses + idx];
+  uint64_t current = tat.load(std::memory_order_relaxed);
+  uint64_t next;
+  do {
+    uint64_t start = std::max(current, nowNsecs);
+    if (start - nowNsecs > tolerance) {
+      // The bucket is empty.  Dropping doesn't touch it, so a storm only
+      // costs each packet a load.
+      return false;
+    }
+    next = start + interval;
+  } while (!tat.compare_exchange_weak(current, next,
+                                      std::memory_order_relaxed));
+  return true;
+}
+
+cfg::PacketPolicerClass PacketPolicer::classify(uint16_t ethertype,
+                                                const Cursor& l3) {
+  switch (ethertype) {
+    case ArpHandler::ETHERTYPE_ARP:
+      return cfg::PacketPolicerClass::ARP;
+    case LldpManager::ETHERTYPE_LLDP:
+      return cfg::PacketPolicerClass::LLDP;
+    case IPv4Handler::ETHERTYPE_IPV4: {
+      auto data = l3.peek();
+      return classifyIPv4(data.first, data.second);
+    }
+    case IPv6Handler::ETHERTYPE_IPV6: {
+      auto data = l3.peek();
+      return classifyIPv6(data.first, data.second);
+    }
+    default:
+      return cfg::PacketPolicerClass::OTHER;
+  }
+}
+
+void PacketPolicer::setPolicers(
+    const std::vector<cfg::PacketPolicer>& policers, PortID maxPort) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  uint32_t numPorts = static_cast<uint32_t>(maxPort) + 1;
+  auto buckets = buckets_.load(std::memory_order_relaxed);
+  if (!policers.empty() && (!buckets || buckets->numPorts < numPorts)) {
+    auto newBuckets = folly::make_unique<Buckets>(numPorts);
+    if (buckets) {
+      // Carry the existing buckets over, so a storm on a port isn't let
+      // through just because another port was added.
+      for (uint32_t idx = 0; idx < buckets->numPorts * kNumClasses; ++idx) {
+        newBuckets->tats[idx].store(
+            buckets->tats[idx].load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+      }
+    }
+    buckets_.store(newBuckets.get(), std::memory_order_release);
+    allBuckets_.push_back(std::move(newBuckets));
+  }
+
+  uint64_t intervals[kNumClasses] = {};
+  uint64_t tolerances[kNumClasses] = {};
+  for (const auto& policer : policers) {
+    auto idx = static_cast<uint32_t>(policer.packetClass);
+    CHECK_LT(idx, kNumClasses);
+    CHECK_GT(policer.packetsPerSecond, 0);
+    uint64_t burst = policer.burstSize > 0 ?
+      policer.burstSize : policer.packetsPerSecond;
+    intervals[idx] = std::max<uint64_t>(
+        1, std::chrono::nanoseconds(std::chrono::seconds(1)).count() /
+           policer.packetsPerSecond);
+    tolerances[idx] = (burst - 1) * intervals[idx];
+  }
+  for (uint32_t idx = 0; idx < kNumClasses; ++idx) {
+    limits_[idx].toleranceNsecs.store(tolerances[idx],
+                                      std::memory_order_relaxed);
+    limits_[idx].intervalNsecs.store(intervals[idx],
+                                     std::memory_order_relaxed);
+  }
+  enabled_.store(!policers.empty(), std::memory_order_relaxed);
+  VLOG(2) << "Configured " << policers.size() << " packet policers for "
+          << numPorts << " ports";
+}
+
+void PacketPolicer::stateUpdated(const StateDelta& delta) {
+  const auto& oldState = delta.oldState();
+  const auto& newState = delta.newState();
+  const auto& policers = newState->getPacketPolicers();
+  if (oldState->getPacketPolicers() == policers &&
+      (policers.empty() || oldState->getPorts() == newState->getPorts())) {
+    return;
+  }
+  PortID maxPort(0);
+  for (const auto& port : *newState->getPorts()) {
+    maxPort = std::max(maxPort, port->getID());
+  }
+  setPolicers(policers, maxPort);
+}
+
+}} // facebook::fboss
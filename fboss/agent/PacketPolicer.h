@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/StateObserver.h"
+#include "fboss/agent/gen-cpp/switch_config_types.h"
+#include "fboss/agent/types.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace folly { namespace io {
+class Cursor;
+}}
+
+namespace facebook { namespace fboss {
+
+class SwSwitch;
+
+/*
+ * PacketPolicer limits the rate at which trapped packets are processed,
+ * per ingress port and per cfg::PacketPolicerClass, as configured by the
+ * packetPolicers in the SwitchState.  It protects the packet processing
+ * threads from packet storms the hardware rate limits don't catch, such as
+ * ARP or NDP floods on a single port.
+ *
+ * Each (port, class) pair has a token bucket, implemented as a generic cell
+ * rate algorithm: the bucket is just the time at which it would be full
+ * again, and is updated with a single compare and swap.  There is no refill
+ * timer and no lock, so allow() may be called from any number of packet
+ * threads.
+ */
+class PacketPolicer : public AutoRegisterStateObserver {
+ public:
+  explicit PacketPolicer(SwSwitch* sw);
+  ~PacketPolicer() override;
+
+  /*
+   * Return true if a packet received on port should be processed, or false
+   * if it should be dropped.
+   *
+   * ethertype is the packet's (inner) ethertype, and l3 points to the data
+   * just after it.
+   */
+  bool allow(PortID port, uint16_t ethertype, const folly::io::Cursor& l3) {
+    if (!enabled_.load(std::memory_order_relaxed)) {
+      return true;
+    }
+    return allow(port, classify(ethertype, l3), nowNsecs());
+  }
+
+  /*
+   * Police one packet of class cls on port, received at nowNsecs on the
+   * steady clock.
+   */
+  bool allow(PortID port, cfg::PacketPolicerClass cls, uint64_t nowNsecs);
+
+  /*
+   * Return the policing class of a packet.  Only the contiguous data l3
+   * points to is looked at, so this never throws; a packet that is too
+   * short to tell gets the class of its ethertype (e.g. IPV4).
+   */
+  static cfg::PacketPolicerClass classify(uint16_t ethertype,
+                                          const folly::io::Cursor& l3);
+
+  /*
+   * Replace the configured policers.  Buckets are allocated for ports
+   * 0 through maxPort.  This is called from the update thread when the
+   * configuration changes, and may run concurrently with allow().
+   */
+  void setPolicers(const std::vector<cfg::PacketPolicer>& policers,
+                   PortID maxPort);
+
+  void stateUpdated(const StateDelta& delta) override;
+
+  static uint64_t nowNsecs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+ private:
+  enum : uint32_t { kNumClasses = 10 };
+
+  // The rate of one class, in the same units as the buckets
+  struct Limit {
+    // Time between packets at the sustained rate, 0 if not policed
+    std::atomic<uint64_t> intervalNsecs{0};
+    // How far ahead of now a bucket may be and still accept a packet
+    std::atomic<uint64_t> toleranceNsecs{0};
+  };
+
+  /*
+   * The buckets of all ports, kNumClasses per port.  Each holds the time at
+   * which the next packet conforms to the sustained rate ("theoretical
+   * arrival time").
+   */
+  struct Buckets {
+    explicit Buckets(uint32_t numPorts)
+      : numPorts(numPorts),
+        tats(new std::atomic<uint64_t>[numPorts * kNumClasses]) {
+      for (uint32_t idx = 0; idx < numPorts * kNumClasses; ++idx) {
+        tats[idx].store(0, std::memory_order_relaxed);
+      }
+    }
+
+    const uint32_t numPorts;
+    std::unique_ptr<std::atomic<uint64_t>[]> tats;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  PacketPolicer(PacketPolicer const &) = delete;
+  PacketPolicer& operator=(PacketPolicer const &) = delete;
+
+  std::atomic<bool> enabled_{false};
+  Limit limits_[kNumClasses];
+  std::atomic<Buckets*> buckets_{nullptr};
+
+  /*
+   * All Buckets ever allocated.  A packet thread may still be using an old
+   * one after it is replaced, and they are only replaced when ports are
+   * added, so they are kept until we are destroyed.
+   */
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Buckets>> allBuckets_;
+};
+
+}} // facebook::fboss
@@ -14,7 +14,7 @@
 #include "fboss/agent/state/SwitchState.h"
 
 DEFINE_string(switch_state_file, "switch_state",
-    "File for dumping switch state JSON in on exit");
+    "File for dumping switch state in on exit");
 DEFINE_string(hw_state_file, "hw_state",
               "File for dumping HW state on crash");
 
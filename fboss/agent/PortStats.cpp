@@ -10,11 +10,22 @@
 
 #include "fboss/agent/SwitchStats.h"
 
+#include <folly/Conv.h>
+
+using facebook::stats::SUM;
+using facebook::stats::RATE;
+
 namespace facebook { namespace fboss {
 
-PortStats::PortStats(PortID portID, SwitchStats *switchStats)
+PortStats::PortStats(PortID portID,
+                     stats::ThreadCachedServiceData::ThreadLocalStatsMap *map,
+                     SwitchStats *switchStats)
   : portID_(portID),
-    switchStats_(switchStats) {
+    switchStats_(switchStats),
+    policerDrops_(map,
+                  folly::to<std::string>(SwitchStats::kCounterPrefix, "port",
+                                         portID, ".trapped.policer_drops"),
+                  SUM, RATE) {
 }
 
 void PortStats::trappedPkt() {
@@ -35,6 +46,10 @@ void PortStats::pktUnhandled() {
 void PortStats::pktToHost(uint32_t bytes) {
   switchStats_->pktToHost(bytes);
 }
+void PortStats::pktPolicerDropped() {
+  policerDrops_.addValue(1);
+  switchStats_->pktPolicerDropped();
+}
 
 void PortStats::arpPkt() {
   switchStats_->arpPkt();
@@ -9,6 +9,7 @@
  */
 #pragma once
 
+#include "common/stats/ThreadCachedServiceData.h"
 #include "fboss/agent/types.h"
 
 namespace facebook { namespace fboss {
@@ -17,7 +18,9 @@ class SwitchStats;
 
 class PortStats {
  public:
-  PortStats(PortID portID, SwitchStats *switchStats);
+  PortStats(PortID portID,
+            stats::ThreadCachedServiceData::ThreadLocalStatsMap *map,
+            SwitchStats *switchStats);
 
   void trappedPkt();
   void pktDropped();
@@ -25,6 +28,7 @@ class PortStats {
   void pktError();
   void pktUnhandled();
   void pktToHost(uint32_t bytes); // number of packets forward to host
+  void pktPolicerDropped(); // dropped by the PacketPolicer
 
   void arpPkt();
   void arpUnsupported();
@@ -69,6 +73,9 @@ class PortStats {
   // Pointer to main SwitchStats object so that we can forward method calls
   // that we do not want to track ourselves.
   SwitchStats *switchStats_;
+
+  // Trapped packets from this port dropped by the PacketPolicer
+  stats::ThreadCachedServiceData::TLTimeseries policerDrops_;
 };
 
 }} // facebook::fboss
@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/RouteUpdateCoalescer.h"
+
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateUpdate.h"
+#include "fboss/agent/state/StateUpdateHelpers.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/Memory.h>
+
+#include <vector>
+
+using folly::Future;
+using folly::Promise;
+using folly::StringPiece;
+using std::shared_ptr;
+
+namespace facebook { namespace fboss {
+
+struct RouteUpdateCoalescer::Batch {
+  struct Change {
+    explicit Change(RouteChange fn) : fn(std::move(fn)) {}
+
+    RouteChange fn;
+    Promise<StateDeltaSummary> promise;
+    // Set if fn threw, in which case the change was left out
+    std::exception_ptr error;
+  };
+
+  std::mutex mutex;
+  // Set once the update has taken the changes.  Later changes need a new batch.
+  bool closed{false};
+  std::vector<Change> changes;
+};
+
+class RouteUpdateCoalescer::BatchUpdate : public StateUpdate {
+ public:
+  explicit BatchUpdate(shared_ptr<Batch> batch)
+    : StateUpdate("coalesced route update"),
+      batch_(std::move(batch)) {}
+
+  shared_ptr<SwitchState> applyUpdate(
+      const shared_ptr<SwitchState>& origState) override {
+    {
+      std::lock_guard<std::mutex> guard(batch_->mutex);
+      batch_->closed = true;
+      changes_.swap(batch_->changes);
+    }
+
+    shared_ptr<RouteTableMap> newTables;
+    bool retry = true;
+    while (retry) {
+      retry = false;
+      RouteUpdater updater(origState->getRouteTables());
+      for (auto& change : changes_) {
+        if (change.error) {
+          continue;
+        }
+        try {
+          change.fn(&updater);
+        } catch (const std::exception& ex) {
+          // The change may have been partially applied, so start over
+          // without it.
+          change.error = std::current_exception();
+          retry = true;
+          break;
+        }
+      }
+      if (!retry) {
+        newTables = updater.updateDone();
+      }
+    }
+
+    summary_.oldGeneration = origState->getGeneration();
+    summary_.newGeneration = summary_.oldGeneration;
+    if (!newTables) {
+      return nullptr;
+    }
+    auto newState = origState->clone();
+    newState->resetRouteTables(std::move(newTables));
+    summary_.newGeneration = newState->getGeneration();
+    return newState;
+  }
+
+  void onError(const std::exception& ex) noexcept override {
+    for (auto& change : changes_) {
+      change.promise.setException(std::current_exception());
+    }
+  }
+
+  void onSuccess() override {
+    for (auto& change : changes_) {
+      if (change.error) {
+        change.promise.setException(change.error);
+      } else {
+        change.promise.setValue(summary_);
+      }
+    }
+  }
+
+ private:
+  shared_ptr<Batch> batch_;
+  std::vector<Batch::Change> changes_;
+  StateDeltaSummary summary_;
+};
+
+RouteUpdateCoalescer::RouteUpdateCoalescer(SwSwitch* sw) : sw_(sw) {}
+
+RouteUpdateCoalescer::~RouteUpdateCoalescer() {}
+
+Future<StateDeltaSummary> RouteUpdateCoalescer::update(RouteChange change) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (open_) {
+    std::lock_guard<std::mutex> batchGuard(open_->mutex);
+    if (!open_->closed) {
+      open_->changes.emplace_back(std::move(change));
+      return open_->changes.back().promise.getFuture();
+    }
+  }
+
+  open_ = std::make_shared<Batch>();
+  open_->changes.emplace_back(std::move(change));
+  auto future = open_->changes.back().promise.getFuture();
+  sw_->updateState(folly::make_unique<BatchUpdate>(open_));
+  return future;
+}
+
+Future<StateDeltaSummary> RouteUpdateCoalescer::updateExclusive(
+    StringPiece name, StateUpdateFn fn) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  // Changes queued from now on must go after this update
+  open_.reset();
+  return sw_->updateStateAsync(name, std::move(fn));
+}
+
+}} // facebook::fboss
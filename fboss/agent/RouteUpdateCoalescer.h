@@ -0,0 +1,86 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/futures/Future.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace facebook { namespace fboss {
+
+class RouteUpdater;
+class SwSwitch;
+class SwitchState;
+struct StateDeltaSummary;
+
+/*
+ * Merges route changes from concurrent callers into a single state update.
+ *
+ * Every route change made through SwSwitch::updateState() builds its own
+ * RouteUpdater, re-resolves the routes and clones the SwitchState, even when
+ * the update thread then coalesces it with other route changes.  With many
+ * routing clients adding routes at once this work is repeated once per
+ * client call.
+ *
+ * RouteUpdateCoalescer queues route changes instead.  The first change
+ * schedules a state update; every change queued before that update runs is
+ * applied with the same RouteUpdater, and resolved and published once.  Each
+ * caller gets its own future, fulfilled once the routes are programmed to the
+ * hardware.  A change that throws fails only its own future; the others are
+ * still applied.
+ */
+class RouteUpdateCoalescer {
+ public:
+  typedef std::function<void(RouteUpdater*)> RouteChange;
+  typedef std::function<
+    std::shared_ptr<SwitchState>(const std::shared_ptr<SwitchState>&)>
+    StateUpdateFn;
+
+  explicit RouteUpdateCoalescer(SwSwitch* sw);
+  ~RouteUpdateCoalescer();
+
+  /*
+   * Apply change, along with any other changes queued at the same time.
+   *
+   * change runs later in the update thread, so anything it captures must
+   * remain valid until then.
+   */
+  folly::Future<StateDeltaSummary> update(RouteChange change);
+
+  /*
+   * Schedule a state update that is not coalesced with other route changes.
+   *
+   * It is applied after every change already queued, and before any change
+   * queued later.  This is meant for updates that replace the whole routing
+   * table, such as a FIB sync.
+   */
+  folly::Future<StateDeltaSummary> updateExclusive(folly::StringPiece name,
+                                                   StateUpdateFn fn);
+
+ private:
+  struct Batch;
+  class BatchUpdate;
+
+  // Forbidden copy constructor and assignment operator
+  RouteUpdateCoalescer(RouteUpdateCoalescer const &) = delete;
+  RouteUpdateCoalescer& operator=(RouteUpdateCoalescer const &) = delete;
+
+  SwSwitch* sw_{nullptr};
+  // Held while scheduling updates, so they are queued in the order
+  // the calls were made.
+  std::mutex mutex_;
+  // The batch waiting for its update to run, if any
+  std::shared_ptr<Batch> open_;
+};
+
+}} // facebook::fboss
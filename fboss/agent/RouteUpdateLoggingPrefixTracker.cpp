@@ -23,7 +23,8 @@ std::string RouteUpdateLoggingInstance::str() const {
       "{} {} {}", prefix.str(), identifier, exact ? "exact" : "longest-match");
 }
 
-void RouteUpdateLoggingPrefixTracker::track(
+template <typename TreeT>
+void RouteUpdateLoggingPrefixTrackerT<TreeT>::track(
     const RouteUpdateLoggingInstance& req) {
   LOG(INFO) << "Tracking " << req.str();
   SYNCHRONIZED(trackedPrefixes_) {
@@ -37,7 +38,8 @@ void RouteUpdateLoggingPrefixTracker::track(
 }
 
 // stop tracking a particular requested prefix
-void RouteUpdateLoggingPrefixTracker::stopTracking(
+template <typename TreeT>
+void RouteUpdateLoggingPrefixTrackerT<TreeT>::stopTracking(
     const RoutePrefix<folly::IPAddress>& prefix,
     const std::string& identifier) {
   LOG(INFO) << "Stop tracking " << prefix.str() << " " << identifier;
@@ -51,13 +53,15 @@ void RouteUpdateLoggingPrefixTracker::stopTracking(
 }
 
 // stop tracking all the routes with the given identifier
-void RouteUpdateLoggingPrefixTracker::stopTracking(
+template <typename TreeT>
+void RouteUpdateLoggingPrefixTrackerT<TreeT>::stopTracking(
     const std::string& identifier) {
   LOG(INFO) << "Stop tracking all prefixes for " << identifier;
   trackedPrefixes_->erase(identifier);
 }
 
-bool RouteUpdateLoggingPrefixTracker::trackingImpl(
+template <typename TreeT>
+bool RouteUpdateLoggingPrefixTrackerT<TreeT>::trackingImpl(
     const RoutePrefix<folly::IPAddress>& prefix,
     std::vector<std::string>& identifiers) const {
   identifiers.clear();
@@ -79,8 +83,9 @@ bool RouteUpdateLoggingPrefixTracker::trackingImpl(
   return (identifiers.size() > 0);
 }
 
+template <typename TreeT>
 std::vector<RouteUpdateLoggingInstance>
-RouteUpdateLoggingPrefixTracker::getTrackedPrefixes() const {
+RouteUpdateLoggingPrefixTrackerT<TreeT>::getTrackedPrefixes() const {
   std::vector<RouteUpdateLoggingInstance> allPrefixes;
   SYNCHRONIZED_CONST(trackedPrefixes_) {
     for (const auto& prefixes : trackedPrefixes_) {
@@ -92,4 +97,9 @@ RouteUpdateLoggingPrefixTracker::getTrackedPrefixes() const {
   return allPrefixes;
 }
 
+template class RouteUpdateLoggingPrefixTrackerT<
+  network::RadixTree<folly::IPAddress, RouteUpdateLoggingInstance>>;
+template class RouteUpdateLoggingPrefixTrackerT<
+  network::MultibitRadixTree<folly::IPAddress, RouteUpdateLoggingInstance>>;
+
 }} // facebook::fboss
@@ -9,6 +9,7 @@
  */
 #pragma once
 
+#include "fboss/lib/MultibitRadixTree.h"
 #include "fboss/lib/RadixTree.h"
 #include "fboss/agent/state/RouteTypes.h"
 #include <folly/Synchronized.h>
@@ -43,10 +44,16 @@ struct RouteUpdateLoggingInstance {
  * log route updates for.
  *
  * All the methods in this class are thread safe.
+ *
+ * TreeT is the radix tree of folly::IPAddress to RouteUpdateLoggingInstance
+ * that holds each identifier's prefixes, so that the RadixTree and
+ * MultibitRadixTree layouts can be swapped and compared.  It is
+ * instantiated for both, see RouteUpdateLoggingPrefixTracker below.
  */
-class RouteUpdateLoggingPrefixTracker {
+template <typename TreeT>
+class RouteUpdateLoggingPrefixTrackerT {
  public:
-  ~RouteUpdateLoggingPrefixTracker() {}
+  ~RouteUpdateLoggingPrefixTrackerT() {}
   /*
    * Start tracking a prefix. Will overwrite existing exact-ness settings.
    * i.e. for a single identifier, if we track expecting exact matches, then
@@ -78,10 +85,21 @@ class RouteUpdateLoggingPrefixTracker {
   bool trackingImpl(
       const RoutePrefix<folly::IPAddress>& prefix,
       std::vector<std::string>& identifiers) const;
-  folly::Synchronized<std::unordered_map<
-      std::string,
-      network::RadixTree<folly::IPAddress, RouteUpdateLoggingInstance>>>
+  folly::Synchronized<std::unordered_map<std::string, TreeT>>
       trackedPrefixes_;
 };
 
+typedef RouteUpdateLoggingPrefixTrackerT<
+  network::RadixTree<folly::IPAddress, RouteUpdateLoggingInstance>>
+  RadixTreePrefixTracker;
+typedef RouteUpdateLoggingPrefixTrackerT<
+  network::MultibitRadixTree<folly::IPAddress, RouteUpdateLoggingInstance>>
+  MultibitRadixTreePrefixTracker;
+typedef MultibitRadixTreePrefixTracker RouteUpdateLoggingPrefixTracker;
+
+extern template class RouteUpdateLoggingPrefixTrackerT<
+  network::RadixTree<folly::IPAddress, RouteUpdateLoggingInstance>>;
+extern template class RouteUpdateLoggingPrefixTrackerT<
+  network::MultibitRadixTree<folly::IPAddress, RouteUpdateLoggingInstance>>;
+
 }} // facebook::fboss
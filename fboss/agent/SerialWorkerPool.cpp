@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/SerialWorkerPool.h"
+
+#include <folly/Conv.h>
+#include <folly/ThreadName.h>
+#include <glog/logging.h>
+
+namespace facebook { namespace fboss {
+
+SerialWorkerPool::SerialWorkerPool(folly::StringPiece name,
+                                   uint32_t numThreads) {
+  CHECK_GT(numThreads, 0);
+  for (uint32_t idx = 0; idx < numThreads; ++idx) {
+    auto threadName = folly::to<std::string>(name, idx);
+    threads_.emplace_back([this, threadName] {
+        folly::setThreadName(pthread_self(), threadName);
+        workerLoop();
+      });
+  }
+}
+
+SerialWorkerPool::~SerialWorkerPool() {
+  stop();
+}
+
+void SerialWorkerPool::add(const std::shared_ptr<Queue>& queue,
+                           std::function<void()> fn) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!stopping_) {
+      queue->fns_.push_back(std::move(fn));
+      if (!queue->active_) {
+        queue->active_ = true;
+        ready_.push_back(queue);
+        readyCV_.notify_one();
+      }
+      return;
+    }
+  }
+  fn();
+}
+
+void SerialWorkerPool::drain(const std::shared_ptr<Queue>& queue) {
+  std::unique_lock<std::mutex> guard(mutex_);
+  idleCV_.wait(guard, [&] { return !queue->active_; });
+}
+
+void SerialWorkerPool::stop() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stopping_ = true;
+  }
+  readyCV_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+void SerialWorkerPool::workerLoop() {
+  std::unique_lock<std::mutex> guard(mutex_);
+  while (true) {
+    readyCV_.wait(guard, [this] { return stopping_ || !ready_.empty(); });
+    if (ready_.empty()) {
+      // Stopping, and everything added has run
+      return;
+    }
+    auto queue = std::move(ready_.front());
+    ready_.pop_front();
+    auto fn = std::move(queue->fns_.front());
+    queue->fns_.pop_front();
+
+    guard.unlock();
+    fn();
+    // Destroy whatever fn holds without the lock held
+    fn = nullptr;
+    guard.lock();
+
+    // Run the rest of this queue's functions after the other ready queues,
+    // so a busy queue can't starve the others.
+    if (queue->fns_.empty()) {
+      queue->active_ = false;
+      idleCV_.notify_all();
+    } else {
+      ready_.push_back(std::move(queue));
+      readyCV_.notify_one();
+    }
+  }
+}
+
+}} // facebook::fboss
@@ -0,0 +1,91 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * A small pool of threads that runs functions added to serial queues.
+ *
+ * Functions added to the same Queue run in the order they were added, one
+ * at a time, though not necessarily on the same thread.  Functions on
+ * different queues may run at the same time.  SwSwitch uses one queue per
+ * state observer, so observers can run in parallel with each other and
+ * with the HwSwitch while each still sees every update in order.
+ */
+class SerialWorkerPool {
+ public:
+  class Queue {
+   public:
+    Queue() {}
+
+   private:
+    // Forbidden copy constructor and assignment operator
+    Queue(Queue const &) = delete;
+    Queue& operator=(Queue const &) = delete;
+
+    // Protected by the pool's mutex_
+    std::deque<std::function<void()>> fns_;
+    bool active_{false};
+
+    friend class SerialWorkerPool;
+  };
+
+  SerialWorkerPool(folly::StringPiece name, uint32_t numThreads);
+  ~SerialWorkerPool();
+
+  /*
+   * Run fn on a worker thread, after everything already added to queue.
+   *
+   * The queue must outlive the functions added to it; see drain().
+   */
+  void add(const std::shared_ptr<Queue>& queue, std::function<void()> fn);
+
+  /*
+   * Wait until everything added to queue has run.
+   *
+   * This must not be called from a function running on the pool.
+   */
+  void drain(const std::shared_ptr<Queue>& queue);
+
+  /*
+   * Run everything already added, then stop the worker threads.  Functions
+   * added after stop() run immediately in the calling thread.
+   */
+  void stop();
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  SerialWorkerPool(SerialWorkerPool const &) = delete;
+  SerialWorkerPool& operator=(SerialWorkerPool const &) = delete;
+
+  void workerLoop();
+
+  std::mutex mutex_;
+  // Signalled when a queue becomes ready, or when stopping
+  std::condition_variable readyCV_;
+  // Signalled when a queue goes idle
+  std::condition_variable idleCV_;
+  std::deque<std::shared_ptr<Queue>> ready_;
+  bool stopping_{false};
+  std::vector<std::thread> threads_;
+};
+
+}} // facebook::fboss
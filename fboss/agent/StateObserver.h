@@ -22,11 +22,15 @@ class StateObserver : public boost::noncopyable {
 
 class AutoRegisterStateObserver : public StateObserver {
  public:
-  AutoRegisterStateObserver(SwSwitch* sw, const std::string name)
+  /*
+   * See SwSwitch::registerStateObserver() for what concurrentWithHw means.
+   */
+  AutoRegisterStateObserver(SwSwitch* sw, const std::string name,
+                            bool concurrentWithHw = false)
       : sw_(sw) {
-    sw_->registerStateObserver(this, name);
+    sw_->registerStateObserver(this, name, concurrentWithHw);
   }
-  ~AutoRegisterStateObserver() override { sw_->unregisterStateObserver(this); }
+  ~AutoRegisterStateObserver() override { stopObserving(); }
 
   // This empty implementation should be overridden by subclasses, but it is
   // needed during destruction in the case that the derived class has been
@@ -35,8 +39,24 @@ class AutoRegisterStateObserver : public StateObserver {
   // during that time if this didn't exist.
   void stateUpdated(const StateDelta& delta) override {}
 
+ protected:
+  /*
+   * Unregister, waiting for any update still being processed.
+   *
+   * A concurrentWithHw observer gets updates on other threads, so it must
+   * call this first thing in its destructor, before its own members are
+   * destroyed underneath an update in progress.
+   */
+  void stopObserving() {
+    if (observing_) {
+      sw_->unregisterStateObserver(this);
+      observing_ = false;
+    }
+  }
+
  private:
   SwSwitch* sw_{nullptr};
+  bool observing_{true};
 };
 
 }} // facebook::fboss
@@ -15,6 +15,7 @@
 #include "fboss/agent/IPv6Handler.h"
 #include "fboss/agent/RouteUpdateLogger.h"
 #include "fboss/agent/NeighborUpdater.h"
+#include "fboss/agent/PacketPolicer.h"
 #include "fboss/agent/UnresolvedNhopsProber.h"
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/HwSwitch.h"
@@ -22,6 +23,7 @@
 #include "fboss/agent/PortStats.h"
 #include "fboss/agent/RxPacket.h"
 #include "fboss/agent/SysError.h"
+#include "fboss/agent/TimerWheel.h"
 #include "fboss/agent/TunManager.h"
 #include "fboss/agent/TxPacket.h"
 #include "fboss/agent/SwitchStats.h"
@@ -29,7 +31,11 @@
 #include "fboss/agent/capture/PktCaptureManager.h"
 #include "fboss/agent/packet/EthHdr.h"
 #include "fboss/agent/packet/PktUtil.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
 #include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/StateSnapshot.h"
 #include "fboss/agent/state/StateUpdateHelpers.h"
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/TransceiverMap.h"
@@ -63,6 +69,16 @@ using std::unique_ptr;
 using namespace std::chrono;
 
 DEFINE_string(config, "", "The path to the local JSON configuration file");
+DEFINE_int32(state_observer_threads, 2,
+             "The number of threads for notifying state observers that may "
+             "run concurrently with hardware programming");
+DEFINE_int32(route_lookup_table_delay_ms, 1000,
+             "How long after the routes change to build the lookup tables "
+             "the packet handlers use for route lookups");
+DEFINE_bool(dump_state_json, false,
+            "Dump the warm boot switch state as JSON rather than as a binary "
+            "snapshot.  This is slower and much larger, and is meant for "
+            "debugging.");
 
 namespace {
 
@@ -137,14 +153,34 @@ inline void updatePortStatusCounters(const facebook::fboss::StateDelta& delta) {
 
 namespace facebook { namespace fboss {
 
+// The update thread may publish a new state while the hardware is still
+// programming the previous one, but waits rather than getting further ahead.
+// This bounds the memory held by states in the pipeline.
+const uint32_t kMaxHwBatchesInFlight = 2;
+
+SwSwitch::UpdateBatch::~UpdateBatch() {
+  // Only left over if we stopped before this batch was finished.  Fail them,
+  // so that nobody waits forever for updateStateBlocking() to return.
+  if (updates.empty()) {
+    return;
+  }
+  FbossError ex("update abandoned: the switch is exiting");
+  updates.clear_and_dispose([&](StateUpdate* update) {
+      update->onError(ex);
+      delete update;
+    });
+}
+
 SwSwitch::SwSwitch(std::unique_ptr<Platform> platform)
   : hw_(platform->getHwSwitch()),
     platform_(std::move(platform)),
+    neighborTimers_(new TimerWheel(&backgroundEventBase_)),
     portRemediator_(new PortRemediator(this)),
     arp_(new ArpHandler(this)),
     ipv4_(new IPv4Handler(this)),
     ipv6_(new IPv6Handler(this)),
     nUpdater_(new NeighborUpdater(this)),
+    policer_(new PacketPolicer(this)),
     pcapMgr_(new PktCaptureManager(this)),
     routeUpdateLogger_(new RouteUpdateLogger(this)),
     transceiverMap_(new TransceiverMap()) {
@@ -183,6 +219,7 @@ void SwSwitch::stop() {
   portRemediator_.reset();
   ipv6_.reset();
   nUpdater_.reset();
+  policer_.reset();
   if (lldpManager_) {
     lldpManager_->stop();
   }
@@ -240,16 +277,22 @@ SwSwitch::SwitchRunState SwSwitch::getSwitchRunState() const {
 
 void SwSwitch::gracefulExit() {
   if (isFullyInitialized()) {
-    folly::dynamic switchState = folly::dynamic::object;
-    switchState[kSwSwitch] =  getState()->toFollyDynamic();
+    auto state = getState();
     ipv6_->floodNeighborAdvertisements();
     arp_->floodGratuituousArp();
     // Stop handlers and threads before uninitializing h/w
     stop();
     // Cleanup if we ever initialized
-    switchState[kHwSwitch] = hw_->gracefulExit();
-    dumpStateToFile(platform_->getWarmBootSwitchStateFile(),
-        switchState);
+    auto hwSwitchState = hw_->gracefulExit();
+    auto file = platform_->getWarmBootSwitchStateFile();
+    if (FLAGS_dump_state_json) {
+      folly::dynamic switchState = folly::dynamic::object;
+      switchState[kSwSwitch] = state->toFollyDynamic();
+      switchState[kHwSwitch] = std::move(hwSwitchState);
+      dumpStateToFile(file, switchState);
+    } else {
+      dumpSnapshotToFile(file, *state, hwSwitchState);
+    }
   }
 }
 
@@ -265,6 +308,24 @@ void SwSwitch::dumpStateToFile(const string& filename,
   }
 }
 
+void SwSwitch::dumpSnapshotToFile(const string& filename,
+    const SwitchState& state, const folly::dynamic& hwSwitchState) const {
+  try {
+    StateSnapshotWriter writer(filename);
+    writer.beginObject(2);
+    writer.key(kSwSwitch);
+    state.writeSnapshot(&writer);
+    writer.key(kHwSwitch);
+    writer.value(hwSwitchState);
+    writer.end();
+    auto bytes = writer.finish();
+    VLOG(1) << "dumped " << bytes << " bytes of switch state to " << filename;
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "Unable to dump switch state to " << filename << ": "
+               << folly::exceptionStr(ex);
+  }
+}
+
 bool SwSwitch::isPortUp(PortID port) const {
    if (getState()->getPort(port)->getState() == cfg::PortState::UP) {
      return hw_->isPortUp(port);
@@ -298,6 +359,7 @@ void SwSwitch::exitFatal() const noexcept {
   folly::dynamic switchState = folly::dynamic::object;
   switchState[kSwSwitch] =  getState()->toFollyDynamic();
   switchState[kHwSwitch] = hw_->toFollyDynamic();
+  // Crash dumps are read by people rather than by warm boot, so keep them JSON
   dumpStateToFile(platform_->getCrashSwitchStateFile(), switchState);
 }
 
@@ -323,6 +385,7 @@ void SwSwitch::init(SwitchFlags flags) {
   // Store the initial state
   initialState->publish();
   setStateInternal(initialState);
+  scheduleRouteLookupTables();
 
   platform_->onHwInitialized(this);
 
@@ -408,14 +471,15 @@ void SwSwitch::fibSynced() {
 }
 
 void SwSwitch::registerStateObserver(StateObserver* observer,
-                                     const string name) {
+                                     const string name,
+                                     bool concurrentWithHw) {
   VLOG(2) << "Registering state observer: " << name;
   if (!updateEventBase_.isInEventBaseThread()) {
     updateEventBase_.runInEventBaseThreadAndWait([=]() {
-        addStateObserver(observer, name);
+        addStateObserver(observer, name, concurrentWithHw);
     });
   } else {
-    addStateObserver(observer, name);
+    addStateObserver(observer, name, concurrentWithHw);
   }
 }
 
@@ -436,39 +500,110 @@ bool SwSwitch::stateObserverRegistered(StateObserver* observer) {
 
 void SwSwitch::removeStateObserver(StateObserver* observer) {
   DCHECK(updateEventBase_.isInEventBaseThread());
-  auto nErased = stateObservers_.erase(observer);
-  if (!nErased) {
+  auto iter = stateObservers_.find(observer);
+  if (iter == stateObservers_.end()) {
     throw FbossError("State observer remove failed: observer does not exist");
   }
+  auto queue = iter->second.queue;
+  stateObservers_.erase(iter);
+  // The observer may be destroyed once we return, so wait for any updates
+  // it is still processing.
+  if (queue && observerPool_) {
+    observerPool_->drain(queue);
+  }
 }
 
-void SwSwitch::addStateObserver(StateObserver* observer, const string& name) {
+void SwSwitch::addStateObserver(StateObserver* observer, const string& name,
+                                bool concurrentWithHw) {
   DCHECK(updateEventBase_.isInEventBaseThread());
   if (stateObserverRegistered(observer)) {
     throw FbossError("State observer add failed: ", name, " already exists");
   }
-  stateObservers_.emplace(observer, name);
+  StateObserverInfo info;
+  info.name = name;
+  info.concurrentWithHw = concurrentWithHw;
+  if (concurrentWithHw) {
+    info.queue = std::make_shared<SerialWorkerPool::Queue>();
+  }
+  stateObservers_.emplace(observer, std::move(info));
 }
 
 void SwSwitch::notifyStateObservers(const StateDelta& delta) {
+  auto batch = std::make_shared<UpdateBatch>();
+  batch->delta = make_unique<StateDelta>(delta);
+  notifyConcurrentObservers(batch);
+  notifyObserversAfterHw(batch);
+}
+
+void SwSwitch::notifyConcurrentObservers(
+    const shared_ptr<UpdateBatch>& batch) {
   CHECK(updateEventBase_.inRunningEventBaseThread());
   if (isExiting()) {
     // Make sure the SwSwitch is not already being destroyed
     return;
   }
-  updatePortStatusCounters(delta);
-  for (auto observerName : stateObservers_) {
-    try {
-      auto observer = observerName.first;
-      observer->stateUpdated(delta);
-    } catch (const std::exception& ex) {
-    // TODO: Figure out the best way to handle errors here.
-      LOG(FATAL) << "error notifying " << observerName.second << " of update: "
-                 << folly::exceptionStr(ex);
+  std::vector<std::pair<StateObserver*, const StateObserverInfo*>> observers;
+  for (const auto& entry : stateObservers_) {
+    if (entry.second.concurrentWithHw) {
+      observers.emplace_back(entry.first, &entry.second);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> guard(batch->mutex);
+    batch->observersRunning += observers.size();
+  }
+  for (const auto& entry : observers) {
+    auto observer = entry.first;
+    auto name = entry.second->name;
+    auto notify = [batch, observer, name]() {
+      try {
+        observer->stateUpdated(*batch->delta);
+      } catch (const std::exception& ex) {
+        LOG(FATAL) << "error notifying " << name << " of update: "
+                   << folly::exceptionStr(ex);
+      }
+      std::lock_guard<std::mutex> guard(batch->mutex);
+      if (--batch->observersRunning == 0) {
+        batch->observersDone.notify_all();
+      }
+    };
+    if (observerPool_) {
+      observerPool_->add(entry.second->queue, std::move(notify));
+    } else {
+      notify();
     }
   }
 }
 
+void SwSwitch::notifyObserversAfterHw(const shared_ptr<UpdateBatch>& batch) {
+  CHECK(updateEventBase_.inRunningEventBaseThread());
+  if (!isExiting()) {
+    // (If we are exiting, make sure the SwSwitch is not already being
+    // destroyed.)
+    const auto& delta = *batch->delta;
+    updatePortStatusCounters(delta);
+    for (const auto& entry : stateObservers_) {
+      if (entry.second.concurrentWithHw) {
+        continue;
+      }
+      try {
+        entry.first->stateUpdated(delta);
+      } catch (const std::exception& ex) {
+      // TODO: Figure out the best way to handle errors here.
+        LOG(FATAL) << "error notifying " << entry.second.name
+                   << " of update: " << folly::exceptionStr(ex);
+      }
+    }
+  }
+
+  // Concurrent observers usually finish while the hardware is programmed,
+  // so this rarely waits.
+  std::unique_lock<std::mutex> guard(batch->mutex);
+  batch->observersDone.wait(guard, [&] {
+      return batch->observersRunning == 0;
+    });
+}
+
 void SwSwitch::updateState(unique_ptr<StateUpdate> update) {
   // Put the update function on the queue.
   {
@@ -503,6 +638,15 @@ void SwSwitch::updateStateBlocking(folly::StringPiece name, StateUpdateFn fn) {
   result->wait();
 }
 
+folly::Future<StateDeltaSummary> SwSwitch::updateStateAsync(
+    StringPiece name, StateUpdateFn fn) {
+  folly::Promise<StateDeltaSummary> promise;
+  auto future = promise.getFuture();
+  updateState(make_unique<AsyncStateUpdate>(name, std::move(fn),
+                                            std::move(promise)));
+  return future;
+}
+
 void SwSwitch::handlePendingUpdatesHelper(SwSwitch* sw) {
   sw->handlePendingUpdates();
 }
@@ -576,16 +720,22 @@ void SwSwitch::handlePendingUpdates() {
   }
 
   // Now apply the update and notify subscribers
+  auto batch = std::make_shared<UpdateBatch>();
+  batch->updates.swap(updates);
   if (state != origState) {
-    applyUpdate(origState, state);
+    applyUpdate(origState, state, batch);
   }
 
-  // Notify all of the updates of success, and delete them
-  while (!updates.empty()) {
-    unique_ptr<StateUpdate> update(&updates.front());
-    updates.pop_front();
-    update->onSuccess();
+  // Program the hardware on the hw update thread, so we can go on to prepare
+  // the next batch meanwhile.  Batches that didn't change the state go this
+  // way too, so that every batch's updates complete in order.
+  {
+    std::lock_guard<std::mutex> guard(hwPipelineMutex_);
+    ++hwBatchesInFlight_;
   }
+  hwUpdateEventBase_.runInEventBaseThread([this, batch]() {
+      programHw(batch);
+    });
 }
 
 int SwSwitch::getHighresSamplers(HighresSamplerList* samplers,
@@ -645,56 +795,117 @@ void SwSwitch::setStateInternal(std::shared_ptr<SwitchState> newState) {
   stateDontUseDirectly_.swap(newState);
 }
 
+void SwSwitch::scheduleRouteLookupTables() {
+  if (routeLookupTablesPending_.exchange(true)) {
+    return;
+  }
+  backgroundEventBase_.runInEventBaseThread([this] {
+    backgroundEventBase_.tryRunAfterDelay([this] {
+      buildRouteLookupTables();
+    }, FLAGS_route_lookup_table_delay_ms);
+  });
+}
+
+void SwSwitch::buildRouteLookupTables() {
+  // Routes published from here on need another build
+  routeLookupTablesPending_ = false;
+  auto state = getState();
+  for (const auto& routeTable : *state->getRouteTables()) {
+    routeTable->getRibV4()->buildLookupTable();
+    routeTable->getRibV6()->buildLookupTable();
+  }
+}
+
 void SwSwitch::applyUpdate(const shared_ptr<SwitchState>& oldState,
-                           const shared_ptr<SwitchState>& newState) {
+                           const shared_ptr<SwitchState>& newState,
+                           const shared_ptr<UpdateBatch>& batch) {
   DCHECK_EQ(oldState, getState());
-  auto start = std::chrono::steady_clock::now();
+  batch->start = std::chrono::steady_clock::now();
   LOG(INFO) << "Updating state: old_gen=" << oldState->getGeneration() <<
     " new_gen=" << newState->getGeneration();
   DCHECK_GT(newState->getGeneration(), oldState->getGeneration());
 
-  StateDelta delta(oldState, newState);
-
   // If we are already exiting, abort the update
   if (isExiting()) {
     return;
   }
 
+  // Don't get too far ahead of the hardware
+  {
+    std::unique_lock<std::mutex> guard(hwPipelineMutex_);
+    hwPipelineCV_.wait(guard, [this] {
+        return hwBatchesInFlight_ < kMaxHwBatchesInFlight;
+      });
+  }
+
   // Publish the configuration as our active state.
   setStateInternal(newState);
+  if (newState->getRouteTables() != oldState->getRouteTables()) {
+    scheduleRouteLookupTables();
+  }
+  batch->delta = make_unique<StateDelta>(oldState, newState);
 
+  // Observers that don't need to wait for the hardware can start right away
+  notifyConcurrentObservers(batch);
+}
+
+void SwSwitch::programHw(const shared_ptr<UpdateBatch>& batch) {
   // Inform the HwSwitch of the change.
   //
   // Note that at this point we have already updated the state pointer and
   // released stateLock_, so the new state is already published and visible to
   // other threads.  This does mean that there is a window where the new state
-  // is visible but the hardware is not using the new configuration yet.
+  // is visible but the hardware is not using the new configuration yet.  The
+  // update thread may even be preparing the next state.
   //
   // We could avoid this by holding a lock and block anyone from reading the
   // state while we update the hardware.  However, updating the hardware may
   // take a non-trivial amount of time, and blocking other users seems
   // undesirable.  So far I don't think this brief discrepancy should cause
   // major issues.
-  try {
-    hw_->stateChanged(delta);
-  } catch (const std::exception& ex) {
-    // Notify the hw_ of the crash so it can execute any device specific
-    // tasks before we fatal. An example would be to dump the current hw state.
-    //
-    // Another thing we could try here is rolling back to the old state.
-    hw_->exitFatal();
-    LOG(FATAL) << "error applying state change to hardware: " <<
-      folly::exceptionStr(ex);
+  if (batch->delta) {
+    try {
+      hw_->stateChanged(*batch->delta);
+    } catch (const std::exception& ex) {
+      // Notify the hw_ of the crash so it can execute any device specific
+      // tasks before we fatal. An example would be to dump the current hw
+      // state.
+      //
+      // Another thing we could try here is rolling back to the old state.
+      hw_->exitFatal();
+      LOG(FATAL) << "error applying state change to hardware: " <<
+        folly::exceptionStr(ex);
+    }
   }
 
-  // Notifies all observers of the current state update.
-  notifyStateObservers(delta);
+  {
+    std::lock_guard<std::mutex> guard(hwPipelineMutex_);
+    --hwBatchesInFlight_;
+  }
+  hwPipelineCV_.notify_all();
 
-  auto end = std::chrono::steady_clock::now();
-  auto duration =
-    std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-  stats()->stateUpdate(duration);
-  VLOG(0) << "Update state took " << duration.count() << "us";
+  updateEventBase_.runInEventBaseThread([this, batch]() {
+      finishUpdate(batch);
+    });
+}
+
+void SwSwitch::finishUpdate(const shared_ptr<UpdateBatch>& batch) {
+  if (batch->delta) {
+    notifyObserversAfterHw(batch);
+
+    auto end = std::chrono::steady_clock::now();
+    auto duration =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - batch->start);
+    stats()->stateUpdate(duration);
+    VLOG(0) << "Update state took " << duration.count() << "us";
+  }
+
+  // Notify all of the updates of success, and delete them
+  while (!batch->updates.empty()) {
+    unique_ptr<StateUpdate> update(&batch->updates.front());
+    batch->updates.pop_front();
+    update->onSuccess();
+  }
 }
 
 PortStats* SwSwitch::portStats(PortID portID) {
@@ -875,6 +1086,11 @@ void SwSwitch::handlePacket(std::unique_ptr<RxPacket> pkt) {
     " ethertype=0x" << std::hex << ethertype <<
     " :: " << pkt->describeDetails();
 
+  if (!policer_->allow(port, ethertype, c)) {
+    stats()->port(port)->pktPolicerDropped();
+    return;
+  }
+
   switch (ethertype) {
   case ArpHandler::ETHERTYPE_ARP:
     arp_->handlePacket(std::move(pkt), dstMac, srcMac, c);
@@ -916,6 +1132,10 @@ void SwSwitch::linkStateChanged(PortID port, bool up) noexcept {
 void SwSwitch::startThreads() {
   backgroundThread_.reset(new std::thread([=] {
       this->threadLoop("fbossBgThread", &backgroundEventBase_); }));
+  observerPool_ = make_unique<SerialWorkerPool>(
+      "fbossObserver", FLAGS_state_observer_threads);
+  hwUpdateThread_.reset(new std::thread([=] {
+      this->threadLoop("fbossHwUpdThread", &hwUpdateEventBase_); }));
   updateThread_.reset(new std::thread([=] {
       this->threadLoop("fbossUpdateThread", &updateEventBase_); }));
 }
@@ -941,6 +1161,18 @@ void SwSwitch::stopThreads() {
   if (updateThread_) {
     updateThread_->join();
   }
+  // The update thread may be waiting for the hw update thread, so stop it
+  // only once the update thread is done.
+  if (hwUpdateThread_) {
+    hwUpdateEventBase_.runInEventBaseThread(
+        [this] { hwUpdateEventBase_.terminateLoopSoon(); });
+    hwUpdateThread_->join();
+    hwUpdateThread_.reset();
+  }
+  if (observerPool_) {
+    observerPool_->stop();
+    observerPool_.reset();
+  }
 }
 
 void SwSwitch::threadLoop(StringPiece name, EventBase* eventBase) {
@@ -11,6 +11,7 @@
 
 #include "fboss/agent/HighresCounterUtil.h"
 #include "fboss/agent/HwSwitch.h"
+#include "fboss/agent/SerialWorkerPool.h"
 #include "fboss/agent/state/StateUpdate.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/Transceiver.h"
@@ -21,9 +22,12 @@
 #include <folly/IntrusiveList.h>
 #include <folly/Range.h>
 #include <folly/ThreadLocal.h>
+#include <folly/futures/Future.h>
 #include <folly/io/async/EventBase.h>
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -46,9 +50,12 @@ class QsfpModule;
 class TransceiverMap;
 class TransceiverImpl;
 class StateDelta;
+struct StateDeltaSummary;
 class NeighborUpdater;
+class PacketPolicer;
 class RouteUpdateLogger;
 class StateObserver;
+class TimerWheel;
 class TunManager;
 class PortRemediator;
 class UnresolvedNhopsProber;
@@ -230,6 +237,18 @@ class SwSwitch : public HwSwitch::Callback {
    */
   void updateStateBlocking(folly::StringPiece name, StateUpdateFn fn);
 
+  /*
+   * A version of updateState() that returns a future, rather than blocking
+   * the calling thread until the update has been applied.
+   *
+   * The future is fulfilled in the update thread once the update has been
+   * programmed to the hardware, or fails with the exception thrown by fn.
+   * As with updateState(), fn runs later in the update thread, so any
+   * arguments it captures must remain valid until then.
+   */
+  folly::Future<StateDeltaSummary> updateStateAsync(
+      folly::StringPiece name, StateUpdateFn fn);
+
   /**
    * Apply config from the config file (specified in 'config' flag).
    *
@@ -264,10 +283,18 @@ class SwSwitch : public HwSwitch::Callback {
    * all state updates that occur and all classes that care about state updates
    * should register using this api.
    *
-   * The only required method for observers is stateUpdated and observers can
-   * count on this always being called from the update thread.
+   * The only required method for observers is stateUpdated.  By default it
+   * is called from the update thread, once the HwSwitch has been programmed
+   * with the delta.
+   *
+   * If concurrentWithHw is true, stateUpdated is instead called on a worker
+   * thread as soon as the new state is published, possibly while the
+   * HwSwitch is still programming it and while other observers run.  Such an
+   * observer still sees every delta in order, one at a time, but must do its
+   * own locking, and must not block waiting for the update thread.
    */
-  void registerStateObserver(StateObserver* observer, const std::string name);
+  void registerStateObserver(StateObserver* observer, const std::string name,
+                             bool concurrentWithHw = false);
   void unregisterStateObserver(StateObserver* observer);
 
   /*
@@ -411,6 +438,14 @@ class SwSwitch : public HwSwitch::Callback {
     return &backgroundEventBase_;
   }
 
+  /*
+   * Get the timer wheel shared by the neighbor caches.  Its timers run in
+   * the background thread.
+   */
+  TimerWheel* getNeighborTimerWheel() {
+    return neighborTimers_.get();
+  }
+
   /*
    * Get the EventBase for the update thread
    */
@@ -568,6 +603,13 @@ class SwSwitch : public HwSwitch::Callback {
    */
   void dumpStateToFile(const std::string& filename,
       const folly::dynamic& switchState) const;
+  /*
+   * Writes the switch as a binary StateSnapshot to the given file.  The sw
+   * state is streamed node by node rather than converted to a
+   * folly::dynamic first.
+   */
+  void dumpSnapshotToFile(const std::string& filename,
+      const SwitchState& state, const folly::dynamic& hwSwitchState) const;
   /*
    * Get combined Sw and Hw switch states
    * as a folly::dynamic object
@@ -603,6 +645,34 @@ class SwSwitch : public HwSwitch::Callback {
   typedef folly::IntrusiveList<StateUpdate, &StateUpdate::listHook_>
     StateUpdateList;
 
+  /*
+   * A batch of StateUpdates on its way through the update pipeline: applied
+   * and published on the update thread, programmed into the hardware on the
+   * hw update thread, then back on the update thread to notify observers and
+   * complete the updates.  Observers that run concurrently with the hardware
+   * are notified from the observer pool as soon as the state is published.
+   */
+  struct UpdateBatch {
+    ~UpdateBatch();
+
+    StateUpdateList updates;
+    // Null if the updates didn't change the state
+    std::unique_ptr<StateDelta> delta;
+    std::chrono::steady_clock::time_point start;
+
+    // The number of concurrent observers still processing delta
+    std::mutex mutex;
+    std::condition_variable observersDone;
+    uint32_t observersRunning{0};
+  };
+
+  struct StateObserverInfo {
+    std::string name;
+    bool concurrentWithHw{false};
+    // Where concurrent observers are notified, to keep them in order
+    std::shared_ptr<SerialWorkerPool::Queue> queue;
+  };
+
   // Forbidden copy constructor and assignment operator
   SwSwitch(SwSwitch const &) = delete;
   SwSwitch& operator=(SwSwitch const &) = delete;
@@ -612,6 +682,15 @@ class SwSwitch : public HwSwitch::Callback {
    */
   void setStateInternal(std::shared_ptr<SwitchState> newState);
 
+  /*
+   * Build the RouteLookupTables used by the packet handlers for the RIBs of
+   * the current state, on the background thread after a delay.  Calls
+   * while a build is already pending are coalesced into it, so during route
+   * churn the tables are built at most once per delay.
+   */
+  void scheduleRouteLookupTables();
+  void buildRouteLookupTables();
+
   /*
    * This function publishes the SFP Dom data (real time values
    * and thresholds to the local in-memory ServiceData Structure
@@ -632,7 +711,10 @@ class SwSwitch : public HwSwitch::Callback {
   static void handlePendingUpdatesHelper(SwSwitch* sw);
   void handlePendingUpdates();
   void applyUpdate(const std::shared_ptr<SwitchState>& oldState,
-                   const std::shared_ptr<SwitchState>& newState);
+                   const std::shared_ptr<SwitchState>& newState,
+                   const std::shared_ptr<UpdateBatch>& batch);
+  void programHw(const std::shared_ptr<UpdateBatch>& batch);
+  void finishUpdate(const std::shared_ptr<UpdateBatch>& batch);
 
   void startThreads();
   void stopThreads();
@@ -645,7 +727,8 @@ class SwSwitch : public HwSwitch::Callback {
    * called from the update thread, if the update thread is running.
    */
   bool stateObserverRegistered(StateObserver* observer);
-  void addStateObserver(StateObserver* observer, const std::string& name);
+  void addStateObserver(StateObserver* observer, const std::string& name,
+                        bool concurrentWithHw);
   void removeStateObserver(StateObserver* observer);
 
   /*
@@ -654,9 +737,20 @@ class SwSwitch : public HwSwitch::Callback {
   std::string getSwitchStateFile() const;
 
   /*
-   * Notifies all the observers that a state update occured.
+   * Notifies all the observers that a state update occured, and waits for
+   * them to finish.
    */
   void notifyStateObservers(const StateDelta& delta);
+  /*
+   * Start notifying the observers that run concurrently with the hardware
+   * of the batch's delta.
+   */
+  void notifyConcurrentObservers(const std::shared_ptr<UpdateBatch>& batch);
+  /*
+   * Notify the other observers of the batch's delta, then wait for the
+   * concurrent ones to finish with it.
+   */
+  void notifyObserversAfterHw(const std::shared_ptr<UpdateBatch>& batch);
 
   void logLinkStateEvent(PortID port, bool up);
 
@@ -702,6 +796,10 @@ class SwSwitch : public HwSwitch::Callback {
    */
   std::unique_ptr<std::thread> backgroundThread_;
   folly::EventBase backgroundEventBase_;
+  // Declared after backgroundEventBase_ so it is destroyed first
+  std::unique_ptr<TimerWheel> neighborTimers_;
+  // Whether a buildRouteLookupTables() is scheduled
+  std::atomic<bool> routeLookupTablesPending_{false};
 
   /*
    * A thread for processing SwitchState updates.
@@ -709,6 +807,25 @@ class SwSwitch : public HwSwitch::Callback {
   std::unique_ptr<std::thread> updateThread_;
   folly::EventBase updateEventBase_;
 
+  /*
+   * A thread for programming SwitchState updates into the HwSwitch, so the
+   * update thread can prepare the next update meanwhile.
+   *
+   * hwBatchesInFlight_ counts the batches handed to this thread that it
+   * hasn't finished with, and is protected by hwPipelineMutex_.
+   */
+  std::unique_ptr<std::thread> hwUpdateThread_;
+  folly::EventBase hwUpdateEventBase_;
+  std::mutex hwPipelineMutex_;
+  std::condition_variable hwPipelineCV_;
+  uint32_t hwBatchesInFlight_{0};
+
+  /*
+   * Threads for notifying state observers that run concurrently with the
+   * hardware.  This exists while the update threads run.
+   */
+  std::unique_ptr<SerialWorkerPool> observerPool_;
+
   /*
    * A callback for listening to neighbors coming and going.
    */
@@ -722,7 +839,7 @@ class SwSwitch : public HwSwitch::Callback {
    * be accessed/modified from the update thread. This removes the need for
    * locking when we access the container during a state update.
    */
-  std::map<StateObserver*, std::string> stateObservers_;
+  std::map<StateObserver*, StateObserverInfo> stateObservers_;
 
   std::unique_ptr<PortRemediator> portRemediator_;
 
@@ -730,6 +847,7 @@ class SwSwitch : public HwSwitch::Callback {
   std::unique_ptr<IPv4Handler> ipv4_;
   std::unique_ptr<IPv6Handler> ipv6_;
   std::unique_ptr<NeighborUpdater> nUpdater_;
+  std::unique_ptr<PacketPolicer> policer_;
   std::unique_ptr<PktCaptureManager> pcapMgr_;
   std::unique_ptr<RouteUpdateLogger> routeUpdateLogger_;
   std::unique_ptr<UnresolvedNhopsProber> unresolvedNhopsProber_;
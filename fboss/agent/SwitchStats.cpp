@@ -26,11 +26,14 @@ SwitchStats::SwitchStats()
 }
 
 SwitchStats::SwitchStats(ThreadLocalStatsMap *map)
-    : trapPkts_(map, kCounterPrefix + "trapped.pkts", SUM, RATE),
+    : map_(map),
+      trapPkts_(map, kCounterPrefix + "trapped.pkts", SUM, RATE),
       trapPktDrops_(map, kCounterPrefix + "trapped.drops", SUM, RATE),
       trapPktBogus_(map, kCounterPrefix + "trapped.bogus", SUM, RATE),
       trapPktErrors_(map, kCounterPrefix + "trapped.error", SUM, RATE),
       trapPktUnhandled_(map, kCounterPrefix + "trapped.unhandled", SUM, RATE),
+      trapPktPolicerDrops_(map, kCounterPrefix + "trapped.policer_drops",
+                           SUM, RATE),
       trapPktToHost_(map, kCounterPrefix + "host.rx", SUM, RATE),
       trapPktToHostBytes_(map, kCounterPrefix + "host.rx.bytes", SUM, RATE),
       pktFromHost_(map, kCounterPrefix + "host.tx", SUM, RATE),
@@ -77,7 +80,8 @@ PortStats* SwitchStats::port(PortID portID) {
 }
 
 PortStats* SwitchStats::createPortStats(PortID portID) {
-  auto rv = ports_.emplace(portID, folly::make_unique<PortStats>(portID, this));
+  auto rv = ports_.emplace(
+      portID, folly::make_unique<PortStats>(portID, map_, this));
   const auto& it = rv.first;
   DCHECK(rv.second);
   return it->second.get();
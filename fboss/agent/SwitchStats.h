@@ -65,6 +65,10 @@ class SwitchStats : public boost::noncopyable {
     trapPktUnhandled_.addValue(1);
     trapPktDrops_.addValue(1);
   }
+  void pktPolicerDropped() {
+    trapPktPolicerDrops_.addValue(1);
+    trapPktDrops_.addValue(1);
+  }
   void pktToHost(uint32_t bytes) {
     trapPktToHost_.addValue(1);
     trapPktToHostBytes_.addValue(bytes);
@@ -207,6 +211,9 @@ class SwitchStats : public boost::noncopyable {
 
   explicit SwitchStats(ThreadLocalStatsMap *map);
 
+  // The map the stats are created in, including those of the ports
+  ThreadLocalStatsMap *map_;
+
   // Total number of trapped packets
   TLTimeseries trapPkts_;
   // Number of trapped packets that were intentionally dropped.
@@ -218,6 +225,8 @@ class SwitchStats : public boost::noncopyable {
   TLTimeseries trapPktErrors_;
   // Trapped packets that the controller didn't know how to handle.
   TLTimeseries trapPktUnhandled_;
+  // Trapped packets dropped by the PacketPolicer
+  TLTimeseries trapPktPolicerDrops_;
   // Trapped packets forwarded to host
   TLTimeseries trapPktToHost_;
   // Trapped packets forwarded to host in bytes
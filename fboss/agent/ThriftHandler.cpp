@@ -38,6 +38,7 @@
 #include "fboss/agent/state/RouteTable.h"
 #include "fboss/agent/state/RouteTableRib.h"
 #include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateUpdateHelpers.h"
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/state/Vlan.h"
 #include "fboss/agent/state/VlanMap.h"
@@ -100,7 +101,58 @@ class RouteUpdateStats {
   std::chrono::time_point<std::chrono::steady_clock> start_;
 };
 
-ThriftHandler::ThriftHandler(SwSwitch* sw) : FacebookBase2("FBOSS"), sw_(sw) {
+namespace {
+
+struct RouteAdd {
+  IPAddress network;
+  uint8_t mask;
+  RouteNextHops nexthops;
+};
+
+// Convert a route from thrift, so the update thread doesn't need to
+RouteAdd toRouteAdd(SwSwitch* sw, const UnicastRoute& route) {
+  RouteAdd add;
+  add.network = toIPAddress(route.dest.ip);
+  add.mask = static_cast<uint8_t>(route.dest.prefixLength);
+  add.nexthops.reserve(route.nextHopAddrs.size());
+  for (const auto& nh : route.nextHopAddrs) {
+    add.nexthops.emplace(toIPAddress(nh));
+  }
+  if (add.network.isV4()) {
+    sw->stats()->addRouteV4();
+  } else {
+    sw->stats()->addRouteV6();
+  }
+  return add;
+}
+
+std::pair<IPAddress, uint8_t> toRouteDelete(SwSwitch* sw,
+                                            const IpPrefix& prefix) {
+  auto network = toIPAddress(prefix.ip);
+  if (network.isV4()) {
+    sw->stats()->delRouteV4();
+  } else {
+    sw->stats()->delRouteV6();
+  }
+  return std::make_pair(network, static_cast<uint8_t>(prefix.prefixLength));
+}
+
+void addRoute(RouteUpdater* updater, const RouteAdd& add) {
+  RouterID routerId = RouterID(0); // TODO, default vrf for now
+  if (add.nexthops.size()) {
+    updater->addRoute(routerId, add.network, add.mask, add.nexthops);
+  } else {
+    updater->addRoute(routerId, add.network, add.mask,
+                      RouteForwardAction::DROP);
+  }
+}
+
+} // unnamed namespace
+
+ThriftHandler::ThriftHandler(SwSwitch* sw)
+  : FacebookBase2("FBOSS"),
+    sw_(sw),
+    routeCoalescer_(sw) {
   sw->registerNeighborListener(
     [=](const std::vector<std::string>& added,
         const std::vector<std::string>& deleted) {
@@ -143,155 +195,97 @@ void ThriftHandler::flushCountersNow() {
   sw_->publishStats();
 }
 
-void ThriftHandler::addUnicastRoute(
-    int16_t client, std::unique_ptr<UnicastRoute> route) {
-  ensureConfigured("addUnicastRoute");
-  ensureFibSynced("addUnicastRoute");
-  RouteUpdateStats stats(sw_, "Add", 1);
-  RouterID routerId = RouterID(0); // TODO, default vrf for now
-  folly::IPAddress network = toIPAddress(route->dest.ip);
-  uint8_t mask = static_cast<uint8_t>(route->dest.prefixLength);
-  RouteNextHops nexthops;
-  nexthops.reserve(route->nextHopAddrs.size());
-  for (const auto& nh : route->nextHopAddrs) {
-    nexthops.emplace(toIPAddress(nh));
-  }
-  if (network.isV4()) {
-    sw_->stats()->addRouteV4();
-  } else {
-    sw_->stats()->addRouteV6();
+void ThriftHandler::getCounters(std::map<std::string, int64_t>& counters) {
+  fbData->getCounters(counters);
+}
+
+folly::Future<folly::Unit> ThriftHandler::updateRoutes(
+    StringPiece function, const string& op, uint32_t numRoutes,
+    std::function<RouteUpdateCoalescer::RouteChange()> prepare) {
+  RouteUpdateCoalescer::RouteChange change;
+  try {
+    ensureConfigured(function);
+    ensureFibSynced(function);
+    change = prepare();
+  } catch (const std::exception& ex) {
+    return folly::makeFuture<folly::Unit>(
+        folly::exception_wrapper(std::current_exception(), ex));
   }
+  auto stats = std::make_shared<RouteUpdateStats>(sw_, op, numRoutes);
+  return routeCoalescer_.update(std::move(change))
+    .then([stats](const StateDeltaSummary&) {});
+}
 
-  // Perform the update
-  auto updateFn = [=](const shared_ptr<SwitchState>& state) {
-    RouteUpdater updater(state->getRouteTables());
-    if (nexthops.size()) {
-      updater.addRoute(routerId, network, mask, std::move(nexthops));
-    } else {
-      updater.addRoute(routerId, network, mask, RouteForwardAction::DROP);
-    }
-    auto newRt = updater.updateDone();
-    if (!newRt) {
-      return shared_ptr<SwitchState>();
-    }
-    auto newState = state->clone();
-    newState->resetRouteTables(std::move(newRt));
-    return newState;
-  };
-  sw_->updateStateBlocking("add unicast route", updateFn);
+folly::Future<folly::Unit> ThriftHandler::future_addUnicastRoute(
+    int16_t client, std::unique_ptr<UnicastRoute> route) {
+  return updateRoutes("addUnicastRoute", "Add", 1, [&] {
+      auto add = toRouteAdd(sw_, *route);
+      return RouteUpdateCoalescer::RouteChange([=](RouteUpdater* updater) {
+          addRoute(updater, add);
+        });
+    });
 }
 
-void ThriftHandler::deleteUnicastRoute(
+folly::Future<folly::Unit> ThriftHandler::future_deleteUnicastRoute(
     int16_t client, std::unique_ptr<IpPrefix> prefix) {
-  ensureConfigured("deleteUnicastRoute");
-  ensureFibSynced("deleteUnicastRoute");
-  RouteUpdateStats stats(sw_, "Delete", 1);
-  RouterID routerId = RouterID(0); // TODO, default vrf for now
-  folly::IPAddress network =  toIPAddress(prefix->ip);
-  uint8_t mask = static_cast<uint8_t>(prefix->prefixLength);
-  if (network.isV4()) {
-    sw_->stats()->delRouteV4();
-  } else {
-    sw_->stats()->delRouteV6();
-  }
-
-  // Perform the update
-  auto updateFn = [=](const shared_ptr<SwitchState>& state) {
-    RouteUpdater updater(state->getRouteTables());
-    updater.delRoute(routerId, network, mask);
-    auto newRt = updater.updateDone();
-    if (!newRt) {
-      return shared_ptr<SwitchState>();
-    }
-    auto newState = state->clone();
-    newState->resetRouteTables(std::move(newRt));
-    return newState;
-  };
-  sw_->updateStateBlocking("delete unicast route", updateFn);
+  return updateRoutes("deleteUnicastRoute", "Delete", 1, [&] {
+      auto del = toRouteDelete(sw_, *prefix);
+      return RouteUpdateCoalescer::RouteChange([=](RouteUpdater* updater) {
+          updater->delRoute(RouterID(0), del.first, del.second);
+        });
+    });
 }
 
-void ThriftHandler::addUnicastRoutes(
+folly::Future<folly::Unit> ThriftHandler::future_addUnicastRoutes(
     int16_t client, std::unique_ptr<std::vector<UnicastRoute>> routes) {
-  ensureConfigured("addUnicastRoutes");
-  ensureFibSynced("addUnicastRoutes");
-  RouteUpdateStats stats(sw_, "Add", routes->size());
-  auto updateFn = [&](const shared_ptr<SwitchState>& state) {
-    RouteUpdater updater(state->getRouteTables());
-    RouterID routerId = RouterID(0); // TODO, default vrf for now
-    for (const auto& route : *routes) {
-      auto network = toIPAddress(route.dest.ip);
-      auto mask = static_cast<uint8_t>(route.dest.prefixLength);
-      RouteNextHops nexthops;
-      nexthops.reserve(route.nextHopAddrs.size());
-      for (const auto& nh : route.nextHopAddrs) {
-        nexthops.emplace(toIPAddress(nh));
-      }
-      if (nexthops.size()) {
-        updater.addRoute(routerId, network, mask, std::move(nexthops));
-      } else {
-        updater.addRoute(routerId, network, mask, RouteForwardAction::DROP);
-      }
-      if (network.isV4()) {
-        sw_->stats()->addRouteV4();
-      } else {
-        sw_->stats()->addRouteV6();
+  return updateRoutes("addUnicastRoutes", "Add", routes->size(), [&] {
+      auto adds = std::make_shared<vector<RouteAdd>>();
+      adds->reserve(routes->size());
+      for (const auto& route : *routes) {
+        adds->push_back(toRouteAdd(sw_, route));
       }
-    }
-    auto newRt = updater.updateDone();
-    if (!newRt) {
-      return shared_ptr<SwitchState>();
-    }
-    auto newState = state->clone();
-    newState->resetRouteTables(std::move(newRt));
-    return newState;
-  };
-  sw_->updateStateBlocking("add unicast route", updateFn);
+      return RouteUpdateCoalescer::RouteChange([=](RouteUpdater* updater) {
+          for (const auto& add : *adds) {
+            addRoute(updater, add);
+          }
+        });
+    });
 }
 
 void ThriftHandler::getProductInfo(ProductInfo& productInfo) {
   sw_->getProductInfo(productInfo);
 }
 
-void ThriftHandler::deleteUnicastRoutes(
+folly::Future<folly::Unit> ThriftHandler::future_deleteUnicastRoutes(
     int16_t client, std::unique_ptr<std::vector<IpPrefix>> prefixes) {
-  ensureConfigured("deleteUnicastRoutes");
-  ensureFibSynced("deleteUnicastRoutes");
-  RouteUpdateStats stats(sw_, "Delete", prefixes->size());
-  // Perform the update
-  auto updateFn = [&](const shared_ptr<SwitchState>& state) {
-    RouteUpdater updater(state->getRouteTables());
-    RouterID routerId = RouterID(0); // TODO, default vrf for now
-    for (const auto& prefix : *prefixes) {
-      auto network = toIPAddress(prefix.ip);
-      auto mask = static_cast<uint8_t>(prefix.prefixLength);
-      if (network.isV4()) {
-        sw_->stats()->delRouteV4();
-      } else {
-        sw_->stats()->delRouteV6();
+  return updateRoutes("deleteUnicastRoutes", "Delete", prefixes->size(), [&] {
+      auto dels = std::make_shared<vector<std::pair<IPAddress, uint8_t>>>();
+      dels->reserve(prefixes->size());
+      for (const auto& prefix : *prefixes) {
+        dels->push_back(toRouteDelete(sw_, prefix));
       }
-      updater.delRoute(routerId, network, mask);
-    }
-    auto newRt = updater.updateDone();
-    if (!newRt) {
-      return shared_ptr<SwitchState>();
-    }
-    auto newState = state->clone();
-    newState->resetRouteTables(std::move(newRt));
-    return newState;
-  };
-  sw_->updateStateBlocking("delete unicast route", updateFn);
+      return RouteUpdateCoalescer::RouteChange([=](RouteUpdater* updater) {
+          for (const auto& del : *dels) {
+            updater->delRoute(RouterID(0), del.first, del.second);
+          }
+        });
+    });
 }
 
-void ThriftHandler::syncFib(
+folly::Future<folly::Unit> ThriftHandler::future_syncFib(
     int16_t client, std::unique_ptr<std::vector<UnicastRoute>> routes) {
-  ensureConfigured("syncFib");
-  RouteUpdateStats stats(sw_, "Sync", routes->size());
-
-  // Note that we capture routes by reference here, since it is a unique_ptr.
-  // This is safe since we use updateStateBlocking(), so routes will still
-  // be valid in our scope when updateFn() is called.
-  // We could use folly::MoveWrapper if we did need to capture routes by value.
-  auto updateFn = [&](const shared_ptr<SwitchState>& state) {
+  try {
+    ensureConfigured("syncFib");
+  } catch (const std::exception& ex) {
+    return folly::makeFuture<folly::Unit>(
+        folly::exception_wrapper(std::current_exception(), ex));
+  }
+  auto stats = std::make_shared<RouteUpdateStats>(sw_, "Sync", routes->size());
+
+  // The update function runs later in the update thread, so it needs to own
+  // the routes.
+  shared_ptr<vector<UnicastRoute>> syncRoutes(std::move(routes));
+  auto updateFn = [=](const shared_ptr<SwitchState>& state) {
     // create an update object starting from empty
     RouteUpdater updater(state->getRouteTables(), true);
     cfg::SwitchConfig emptyPrevConfig;
@@ -300,7 +294,7 @@ void ThriftHandler::syncFib(
     // add all interface routes
     updater.addInterfaceAndLinkLocalRoutes(state->getInterfaces());
     RouterID routerId = RouterID(0); // TODO, default vrf for now
-    for (auto const& route : *routes) {
+    for (auto const& route : *syncRoutes) {
       folly::IPAddress network = toIPAddress(route.dest.ip);
       uint8_t mask = static_cast<uint8_t>(route.dest.prefixLength);
       RouteNextHops nexthops;
@@ -323,10 +317,13 @@ void ThriftHandler::syncFib(
     newState->resetRouteTables(std::move(newRt));
     return newState;
   };
-  sw_->updateStateBlocking("sync fib", updateFn);
-
-  sw_->clearWarmBootCache();
-  sw_->fibSynced();
+  // A sync replaces every route, so it must not be reordered with the
+  // coalesced route changes.
+  return routeCoalescer_.updateExclusive("sync fib", updateFn)
+    .then([this, stats](const StateDeltaSummary&) {
+        sw_->clearWarmBootCache();
+        sw_->fibSynced();
+      });
 }
 
 void ThriftHandler::getAllInterfaces(
@@ -668,6 +665,16 @@ void ThriftHandler::startPktCapture(unique_ptr<CaptureInfo> info) {
   ensureConfigured();
   auto* mgr = sw_->getCaptureMgr();
   auto capture = make_unique<PktCapture>(info->name, info->maxPackets);
+  if (info->maxFileBytes < 0 || info->rotateSeconds < 0 ||
+      info->maxFiles < 0) {
+    throw FbossError("invalid capture rotation: ", info->maxFileBytes,
+                     " bytes, ", info->rotateSeconds, " seconds, ",
+                     info->maxFiles, " files");
+  }
+  capture->setRotation(info->maxFileBytes,
+                       std::chrono::seconds(info->rotateSeconds),
+                       info->maxFiles);
+  capture->setFilter(info->filter);
   mgr->startCapture(std::move(capture));
 }
 
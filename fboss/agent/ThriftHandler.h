@@ -16,6 +16,7 @@
 
 #include "common/fb303/cpp/FacebookBase2.h"
 #include "fboss/agent/FbossError.h"
+#include "fboss/agent/RouteUpdateCoalescer.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/HighresCounterSubscriptionHandler.h"
 #include "fboss/agent/if/gen-cpp2/FbossCtrl.h"
@@ -23,6 +24,7 @@
 
 #include <folly/Synchronized.h>
 #include <folly/String.h>
+#include <folly/futures/Future.h>
 #include <thrift/lib/cpp/server/TServer.h>
 
 namespace facebook { namespace fboss {
@@ -54,16 +56,23 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
 
   void flushCountersNow() override;
 
-  void addUnicastRoute(
+  void getCounters(std::map<std::string, int64_t>& counters) override;
+
+  /*
+   * The route updates don't tie up a thrift thread while the routes are
+   * programmed.  Route changes from concurrent callers are coalesced into a
+   * single state update; see RouteUpdateCoalescer.
+   */
+  folly::Future<folly::Unit> future_addUnicastRoute(
       int16_t client, std::unique_ptr<UnicastRoute> route) override;
-  void deleteUnicastRoute(
+  folly::Future<folly::Unit> future_deleteUnicastRoute(
       int16_t client, std::unique_ptr<IpPrefix> prefix) override;
-  void addUnicastRoutes(
+  folly::Future<folly::Unit> future_addUnicastRoutes(
       int16_t client,
       std::unique_ptr<std::vector<UnicastRoute>> routes) override;
-  void deleteUnicastRoutes(
+  folly::Future<folly::Unit> future_deleteUnicastRoutes(
       int16_t client, std::unique_ptr<std::vector<IpPrefix>> prefixes) override;
-  void syncFib(
+  folly::Future<folly::Unit> future_syncFib(
       int16_t client,
       std::unique_ptr<std::vector<UnicastRoute>> routes) override;
 
@@ -249,6 +258,17 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
     ensureFibSynced(folly::StringPiece(nullptr, nullptr));
   }
 
+  /*
+   * Queue a route change, updating stats once it has been programmed.
+   *
+   * prepare runs in the calling thread and converts the request into the
+   * change to apply.  The returned future fails straight away if the switch
+   * isn't ready for route updates or prepare throws.
+   */
+  folly::Future<folly::Unit> updateRoutes(
+      folly::StringPiece function, const std::string& op, uint32_t numRoutes,
+      std::function<RouteUpdateCoalescer::RouteChange()> prepare);
+
   template<typename Result>
   void fail(const ThriftCallback<Result>& callback,
             const std::exception& ex) {
@@ -263,6 +283,8 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
    */
   SwSwitch* sw_;
 
+  RouteUpdateCoalescer routeCoalescer_;
+
   int thriftIdleTimeout_;
 
   // A thread-safe data structure that helps the thrift handler map connection
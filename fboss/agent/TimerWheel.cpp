@@ -0,0 +1,256 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/TimerWheel.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace facebook { namespace fboss {
+
+constexpr uint32_t TimerWheel::kLevelBits;
+constexpr uint32_t TimerWheel::kSlots;
+constexpr uint32_t TimerWheel::kSlotMask;
+constexpr uint32_t TimerWheel::kLevels;
+constexpr uint64_t TimerWheel::kNever;
+
+TimerWheel::TimerWheel(folly::EventBase* evb, milliseconds tick)
+  : AsyncTimeout(evb),
+    evb_(evb),
+    tick_(tick),
+    start_(steady_clock::now()),
+    self_(std::make_shared<TimerWheel*>(this)) {
+  CHECK_GT(tick_.count(), 0);
+}
+
+TimerWheel::~TimerWheel() {
+  // AsyncTimeout's destructor cancels our timeout.  Any arm() still queued on
+  // the EventBase sees self_ has gone and does nothing.
+}
+
+void TimerWheel::schedule(Client* client, uint32_t handle, uint32_t token,
+                          milliseconds delay) {
+  auto now = nowTick();
+  bool needArm = false;
+  bool queueArm = false;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (count() == 0) {
+      // Nothing to run in between, so there is no need to step through the
+      // ticks we slept through.
+      currentTick_ = std::max(currentTick_, now);
+    }
+    // Round down, so we never fire late because of the tick size.
+    uint64_t ticks = std::max<int64_t>(delay.count() / tick_.count(), 1);
+    Timer timer{client, handle, token,
+                std::max(now + ticks, currentTick_ + 1)};
+    insert(timer);
+
+    if (timer.expiry < wakeTick_) {
+      if (evb_->isInEventBaseThread()) {
+        needArm = true;
+      } else if (!armQueued_) {
+        armQueued_ = true;
+        queueArm = true;
+      }
+    }
+  }
+
+  if (needArm) {
+    arm();
+  } else if (queueArm) {
+    std::weak_ptr<TimerWheel*> weakSelf = self_;
+    evb_->runInEventBaseThread([weakSelf] {
+      auto self = weakSelf.lock();
+      if (self) {
+        (*self)->arm();
+      }
+    });
+  }
+}
+
+void TimerWheel::removeClient(Client* client) {
+  auto purge = [this, client] {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (uint32_t level = 0; level < kLevels; ++level) {
+      for (auto& slot : slots_[level]) {
+        auto end = std::remove_if(slot.begin(), slot.end(),
+                                  [client](const Timer& timer) {
+                                    return timer.client == client;
+                                  });
+        levelSize_[level] -= slot.end() - end;
+        slot.erase(end, slot.end());
+      }
+    }
+    // If we are called from a timerExpired() callback, make sure we don't
+    // run the client's remaining timers.
+    for (auto& timer : firing_) {
+      if (timer.client == client) {
+        timer.client = nullptr;
+      }
+    }
+  };
+
+  if (evb_->isInEventBaseThread()) {
+    purge();
+  } else {
+    evb_->runInEventBaseThreadAndWait(purge);
+  }
+}
+
+size_t TimerWheel::size() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return count();
+}
+
+size_t TimerWheel::count() const {
+  size_t total = 0;
+  for (auto n : levelSize_) {
+    total += n;
+  }
+  return total;
+}
+
+uint64_t TimerWheel::nowTick() const {
+  return duration_cast<milliseconds>(steady_clock::now() - start_).count() /
+    tick_.count();
+}
+
+void TimerWheel::insert(const Timer& timer) {
+  // Timers past the range of the top level are parked in it, and put back
+  // in the right place when that slot is cascaded.
+  uint64_t delta = timer.expiry > currentTick_ ?
+    timer.expiry - currentTick_ : 0;
+  uint32_t level = 0;
+  while (level < kLevels - 1 &&
+         delta >= (uint64_t(1) << (kLevelBits * (level + 1)))) {
+    ++level;
+  }
+  uint64_t expiry = timer.expiry;
+  uint64_t maxExpiry = currentTick_ + (uint64_t(1) << (kLevelBits * kLevels));
+  if (expiry >= maxExpiry) {
+    expiry = maxExpiry - 1;
+  }
+  auto index = (std::max(expiry, currentTick_) >> (kLevelBits * level)) &
+    kSlotMask;
+  slots_[level][index].push_back(timer);
+  ++levelSize_[level];
+}
+
+void TimerWheel::cascade(uint32_t level) {
+  auto& slot = slots_[level][(currentTick_ >> (kLevelBits * level)) &
+                             kSlotMask];
+  std::vector<Timer> timers;
+  timers.swap(slot);
+  levelSize_[level] -= timers.size();
+  for (const auto& timer : timers) {
+    insert(timer);
+  }
+}
+
+void TimerWheel::advance(uint64_t target, std::vector<Timer>* due) {
+  if (count() == 0) {
+    currentTick_ = std::max(currentTick_, target);
+    return;
+  }
+
+  while (currentTick_ < target) {
+    ++currentTick_;
+    // At the start of a new round of a level, move the timers due in this
+    // round down a level.  Higher levels go first, since they may cascade
+    // into the lower ones.
+    uint32_t top = 0;
+    while (top < kLevels - 1 &&
+           (currentTick_ & ((uint64_t(1) << (kLevelBits * (top + 1))) - 1))
+           == 0) {
+      ++top;
+    }
+    for (uint32_t level = top; level > 0; --level) {
+      cascade(level);
+    }
+
+    auto& slot = slots_[0][currentTick_ & kSlotMask];
+    levelSize_[0] -= slot.size();
+    due->insert(due->end(), slot.begin(), slot.end());
+    slot.clear();
+  }
+}
+
+uint64_t TimerWheel::nextWakeTick() const {
+  if (count() == 0) {
+    return kNever;
+  }
+  // Everything beyond level 0 waits for the next cascade at least
+  uint64_t wake = kNever;
+  if (levelSize_[0] < count()) {
+    wake = (currentTick_ | kSlotMask) + 1;
+  }
+  if (levelSize_[0] > 0) {
+    for (uint64_t tick = currentTick_ + 1;
+         tick < currentTick_ + kSlots && tick < wake; ++tick) {
+      if (!slots_[0][tick & kSlotMask].empty()) {
+        return tick;
+      }
+    }
+  }
+  return wake;
+}
+
+void TimerWheel::arm() {
+  uint64_t wake;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    armQueued_ = false;
+    wake = nextWakeTick();
+    wakeTick_ = wake;
+  }
+
+  if (wake == kNever) {
+    cancelTimeout();
+    return;
+  }
+  auto wakeTime = start_ + tick_ * wake;
+  auto now = steady_clock::now();
+  uint32_t timeout = 0;
+  if (wakeTime > now) {
+    // Round up, so we don't wake just before the tick and go back to sleep
+    timeout = (duration_cast<std::chrono::microseconds>(wakeTime - now)
+               .count() + 999) / 1000;
+  }
+  scheduleTimeout(timeout);
+}
+
+void TimerWheel::timeoutExpired() noexcept {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    // Calls to schedule() from the callbacks don't need to arm the timeout,
+    // we do that below.
+    wakeTick_ = 0;
+    advance(nowTick(), &firing_);
+  }
+
+  // firing_ may be modified by removeClient() while we run, so don't hold
+  // references into it across callbacks.
+  for (size_t i = 0; i < firing_.size(); ++i) {
+    auto timer = firing_[i];
+    if (timer.client) {
+      timer.client->timerExpired(timer.handle, timer.token);
+    }
+  }
+  firing_.clear();
+
+  arm();
+}
+
+}} // facebook::fboss
@@ -0,0 +1,132 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * A hierarchical hashed timer wheel, driven by a single AsyncTimeout on an
+ * EventBase.
+ *
+ * This is meant for large numbers of coarse timers, such as one per neighbor
+ * cache entry.  Scheduling a timer is O(1) and doesn't allocate per timer
+ * (beyond amortized vector growth), and the EventBase only ever has one
+ * timeout scheduled for the whole wheel.
+ *
+ * Timers are identified by a (Client, handle, token) triple rather than by
+ * an object, so clients can keep their state in compact tables.  There is no
+ * cancel: a client that wants to cancel or reschedule a timer should change
+ * the token it expects for the handle, and ignore expiries that carry an old
+ * token.  Such stale timers stay in the wheel until their expiry time.
+ *
+ * Timers fire on the EventBase thread, at most one tick early, and as late
+ * as the EventBase gets around to it.  schedule() may be called from any
+ * thread.
+ */
+class TimerWheel : private folly::AsyncTimeout {
+ public:
+  class Client {
+   public:
+    virtual ~Client() {}
+
+    /*
+     * Called in the EventBase thread when a timer expires.  The wheel's lock
+     * is not held, so this may schedule more timers.
+     */
+    virtual void timerExpired(uint32_t handle, uint32_t token) noexcept = 0;
+  };
+
+  explicit TimerWheel(
+      folly::EventBase* evb,
+      std::chrono::milliseconds tick = std::chrono::milliseconds(10));
+  ~TimerWheel() override;
+
+  /*
+   * Call client->timerExpired(handle, token) after delay.
+   */
+  void schedule(Client* client, uint32_t handle, uint32_t token,
+                std::chrono::milliseconds delay);
+
+  /*
+   * Drop all timers for client.  Once this returns client won't be called
+   * again, so it may be destroyed.
+   *
+   * This runs in the EventBase thread, and blocks until it is done if called
+   * from another thread.
+   */
+  void removeClient(Client* client);
+
+  // The number of timers in the wheel, including stale ones
+  size_t size() const;
+
+ private:
+  struct Timer {
+    Client* client;
+    uint32_t handle;
+    uint32_t token;
+    uint64_t expiry;
+  };
+
+  static constexpr uint32_t kLevelBits = 8;
+  static constexpr uint32_t kSlots = 1 << kLevelBits;
+  static constexpr uint32_t kSlotMask = kSlots - 1;
+  static constexpr uint32_t kLevels = 4;
+  static constexpr uint64_t kNever = ~uint64_t(0);
+
+  // Forbidden copy constructor and assignment operator
+  TimerWheel(TimerWheel const &) = delete;
+  TimerWheel& operator=(TimerWheel const &) = delete;
+
+  void timeoutExpired() noexcept override;
+
+  uint64_t nowTick() const;
+
+  // The following must be called with mutex_ held
+  size_t count() const;
+  void insert(const Timer& timer);
+  void advance(uint64_t target, std::vector<Timer>* due);
+  void cascade(uint32_t level);
+  uint64_t nextWakeTick() const;
+
+  // Schedule our timeout for the next tick that needs attention.  Must be
+  // called in the EventBase thread.
+  void arm();
+
+  folly::EventBase* evb_{nullptr};
+  const std::chrono::milliseconds tick_;
+  const std::chrono::steady_clock::time_point start_;
+
+  mutable std::mutex mutex_;
+  std::vector<Timer> slots_[kLevels][kSlots];
+  size_t levelSize_[kLevels] = {};
+  // The last tick processed
+  uint64_t currentTick_{0};
+  // The tick our timeout is scheduled for.  0 while timers are being run,
+  // since we arm the timeout again afterwards anyway.
+  uint64_t wakeTick_{kNever};
+  // Set while a call to arm() is queued on the EventBase
+  bool armQueued_{false};
+
+  // Timers being run.  Only used in the EventBase thread.
+  std::vector<Timer> firing_;
+
+  // Lets functions queued on the EventBase tell if we have been destroyed
+  std::shared_ptr<TimerWheel*> self_;
+};
+
+}} // facebook::fboss
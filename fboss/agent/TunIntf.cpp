@@ -13,12 +13,14 @@ extern "C" {
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <linux/if.h>
 #include <linux/if_tun.h>
 #include <netlink/route/link.h>
 }
 
+#include "fboss/agent/GsoSegmenter.h"
 #include "fboss/agent/RxPacket.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/SysError.h"
@@ -37,29 +39,54 @@ using folly::IPAddress;
 using folly::EventBase;
 using folly::EventHandler;
 
-TunIntf::TunIntf(SwSwitch *sw, EventBase *evb,
-                 const std::string& name, RouterID rid, int idx, int mtu)
-    : EventHandler(evb), sw_(sw), rid_(rid), name_(name), ifIndex_(idx),
-    mtu_(mtu) {
-  openFD();
-  SCOPE_FAIL {
-    closeFD();
-  };
-  LOG(INFO) << "Added interface " << name_ << " with fd " << fd_
-            << " from rid " << rid_ << " @ index " << ifIndex_;
+namespace {
+
+// Packets read from one queue per wakeup, before yielding to other events
+const int kMaxReadsPerWakeup = 64;
+// The smallest L3 buffer allocated for a read. Enough for most control
+// packets (BGP keepalives, ACKs, ARP/NDP driven traffic)
+const uint32_t kMinReadSize = 256;
+// The largest frame the kernel hands us with TCP segmentation offload
+const uint32_t kMaxGsoFrame = 65535;
+const size_t kVnetHdrLen = sizeof(VnetHdr);
+// The offloads enabled with IFF_VNET_HDR; see GsoSegmenter
+const unsigned int kVnetOffloads =
+  TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN;
+
+/*
+ * Run fn in the thread serving evb and wait for it, or just run it if we
+ * are in that thread already (or evb isn't running).
+ */
+void runInThreadAndWait(EventBase* evb, const std::function<void()>& fn) {
+  if (evb->isInEventBaseThread()) {
+    fn();
+  } else {
+    evb->runInEventBaseThreadAndWait(fn);
+  }
 }
 
-TunIntf::TunIntf(SwSwitch *sw, EventBase *evb,
-                 RouterID rid, const Interface::Addresses& addr, int mtu)
-    : EventHandler(evb), sw_(sw), rid_(rid), addrs_(addr), mtu_(mtu) {
+} // unnamed namespace
+
+TunIntf::TunIntf(SwSwitch *sw, const std::vector<EventBase*>& evbs,
+                 const std::string& name, RouterID rid, int idx, int mtu,
+                 bool vnetHdr)
+    : sw_(sw), rid_(rid), name_(name), ifIndex_(idx), vnetHdr_(vnetHdr),
+      mtu_(mtu) {
+  openQueues(evbs);
+  LOG(INFO) << "Added interface " << name_ << " with fd " << fd()
+            << " (" << queues_.size() << " queues) from rid " << rid_
+            << " @ index " << ifIndex_;
+}
+
+TunIntf::TunIntf(SwSwitch *sw, const std::vector<EventBase*>& evbs,
+                 RouterID rid, const Interface::Addresses& addr, int mtu,
+                 bool vnetHdr)
+    : sw_(sw), rid_(rid), addrs_(addr), vnetHdr_(vnetHdr), mtu_(mtu) {
   name_ = folly::to<std::string>(intfPrefix, rid);
-  openFD();
-  SCOPE_FAIL {
-    closeFD();
-  };
+  openQueues(evbs);
   // make the interface persistent, so that the network sessions
   // from the application (i.e. BGP)  will not be reset if controller restarts
-  auto ret = ioctl(fd_, TUNSETPERSIST, 1);
+  auto ret = ioctl(fd(), TUNSETPERSIST, 1);
   sysCheckError(ret, "Failed to set persist interface ", name_);
   // TODO: if needed, we can adjust send buffer size, TUNSETSNDBUF
   auto sock = nl_socket_alloc();
@@ -77,22 +104,68 @@ TunIntf::TunIntf(SwSwitch *sw, EventBase *evb,
     SCOPE_EXIT { nl_cache_free(cache); };
     ifIndex_ = rtnl_link_name2i(cache, name_.c_str());
   }
-  LOG(INFO) << "Created interface " << name_ << " with fd " << fd_
-            << " from router " << rid_ << " @ index " << ifIndex_;
+  LOG(INFO) << "Created interface " << name_ << " with fd " << fd()
+            << " (" << queues_.size() << " queues) from router " << rid_
+            << " @ index " << ifIndex_;
 }
 
 TunIntf::~TunIntf() {
   stop();
-  CHECK_NE(fd_, -1);
+  CHECK(!queues_.empty());
   if (toDelete_) {
-    auto ret = ioctl(fd_, TUNSETPERSIST, 0);
+    auto ret = ioctl(fd(), TUNSETPERSIST, 0);
     sysLogError(ret, "Failed to unset persist interface ", name_);
   }
-  closeFD();
+  queues_.clear();
   LOG(INFO) << ((toDelete_) ? "Delete" : "Detach") << " interface " << name_;
 }
 
-void TunIntf::openFD() {
+void TunIntf::openQueues(const std::vector<EventBase*>& evbs) {
+  CHECK(!evbs.empty());
+  SCOPE_FAIL {
+    queues_.clear();
+  };
+  for (auto evb : evbs) {
+    queues_.push_back(folly::make_unique<Queue>(this, evb));
+  }
+  bool multiQueue = queues_.size() > 1;
+  if (!queues_.front()->openFD(multiQueue)) {
+    // An existing (persistent) interface can only be attached to with the
+    // IFF_MULTI_QUEUE setting it was created with, until it is deleted.
+    multiQueue = !multiQueue;
+    LOG(WARNING) << "Interface " << name_ << " was created "
+                 << (multiQueue ? "with" : "without")
+                 << " IFF_MULTI_QUEUE, using a single queue";
+    queues_.resize(1);
+    if (!queues_.front()->openFD(multiQueue)) {
+      throw FbossError("Failed to attach to interface ", name_);
+    }
+  }
+  for (size_t idx = 1; idx < queues_.size(); ++idx) {
+    queues_[idx]->openFD(multiQueue);
+  }
+
+  // Set configured MTU
+  setMtu(mtu_);
+
+  // The offloads stay set on a persistent interface, so always set them:
+  // without IFF_VNET_HDR there would be no way to tell a GSO frame apart.
+  auto ret = ioctl(fd(), TUNSETOFFLOAD, vnetHdr_ ? kVnetOffloads : 0);
+  sysCheckError(ret, "Failed to set offloads on interface ", name_);
+}
+
+TunIntf::Queue::Queue(TunIntf* intf, EventBase* evb)
+    : EventHandler(evb), intf_(intf), evb_(evb), readSize_(kMinReadSize) {
+}
+
+TunIntf::Queue::~Queue() {
+  if (fd_ != -1) {
+    closeFD();
+  }
+}
+
+bool TunIntf::Queue::openFD(bool multiQueue) {
+  const auto& name = intf_->name_;
   fd_ = open(tunDev, O_RDWR);
   sysCheckError(fd_, "Cannot open ", tunDev);
   SCOPE_FAIL {
@@ -100,17 +173,32 @@ void TunIntf::openFD() {
   };
   struct ifreq ifr;
   memset(&ifr, 0, sizeof(ifr));
-  // Flags: IFF_TUN   - TUN device (no Ethernet headers)
-  //        IFF_NO_PI - Do not provide packet information
+  // Flags: IFF_TUN         - TUN device (no Ethernet headers)
+  //        IFF_NO_PI       - Do not provide packet information
+  //        IFF_MULTI_QUEUE - One of several fds to the same interface
+  //        IFF_VNET_HDR    - Prefix packets with a virtio_net_hdr
   ifr.ifr_flags = IFF_TUN|IFF_NO_PI;
+  if (multiQueue) {
+    ifr.ifr_flags |= IFF_MULTI_QUEUE;
+  }
+  if (intf_->vnetHdr_) {
+    ifr.ifr_flags |= IFF_VNET_HDR;
+  }
   bzero(ifr.ifr_name, sizeof(ifr.ifr_name));
-  size_t len = std::min(name_.size(), sizeof(ifr.ifr_name));
-  memmove(ifr.ifr_name, name_.c_str(), len);
+  size_t len = std::min(name.size(), sizeof(ifr.ifr_name));
+  memmove(ifr.ifr_name, name.c_str(), len);
   auto ret = ioctl(fd_, TUNSETIFF, (void *) &ifr);
-  sysCheckError(ret, "Failed to create/attach interface ", name_);
+  if (ret < 0 && errno == EINVAL) {
+    closeFD();
+    return false;
+  }
+  sysCheckError(ret, "Failed to create/attach interface ", name);
 
-  // Set configured MTU
-  setMtu(mtu_);
+  if (intf_->vnetHdr_) {
+    int hdrLen = kVnetHdrLen;
+    ret = ioctl(fd_, TUNSETVNETHDRSZ, &hdrLen);
+    sysCheckError(ret, "Failed to set vnet header size on fd ", fd_);
+  }
 
   // make fd non-blocking
   auto flags = fcntl(fd_, F_GETFL);
@@ -126,14 +214,16 @@ void TunIntf::openFD() {
   sysCheckError(ret, "Failed to set close-on-exec flags ", flags,
                 " to fd ", fd_);
 
-  LOG(INFO) << "Create/attach to tun interface " << name_ << " @ fd " << fd_;
+  LOG(INFO) << "Create/attach to tun interface " << name << " @ fd " << fd_;
+  return true;
 }
 
-void TunIntf::closeFD() noexcept {
+void TunIntf::Queue::closeFD() noexcept {
   auto ret = close(fd_);
-  sysLogError(ret, "Failed to close fd ", fd_, " for interface ", name_);
+  sysLogError(ret, "Failed to close fd ", fd_, " for interface ",
+              intf_->name_);
   if (ret == 0) {
-    LOG(INFO) << "Closed fd " << fd_ << " for interface " << name_;
+    LOG(INFO) << "Closed fd " << fd_ << " for interface " << intf_->name_;
     fd_ = -1;
   }
 }
@@ -163,27 +253,51 @@ void TunIntf::setMtu(int mtu) {
   auto ret = ioctl(sock, SIOCSIFMTU, (void*)&ifr);
   close(sock);
   sysCheckError(ret, "Failed to set MTU ", ifr.ifr_mtu,
-                " to fd ", fd_, " errno = ", errno);
+                " to fd ", fd(), " errno = ", errno);
   VLOG(3) << "Set tun " << name_ << " MTU to " << mtu;
 }
 
-void TunIntf::handlerReady(uint16_t events) noexcept {
+void TunIntf::Queue::handlerReady(uint16_t /* events */) noexcept {
   CHECK(fd_ != -1);
-  const int MaxSentOneTime = 16;
-  // Since this is L3 packet size, we should also reserve some space for L2
-  // header, which is 18 bytes (including one vlan tag)
+  auto sw = intf_->sw_;
+  auto rid = intf_->rid_;
+  bool vnetHdr = intf_->vnetHdr_;
+  size_t hdrLen = vnetHdr ? kVnetHdrLen : 0;
+  uint32_t mtu = intf_->mtu_;
+  size_t maxFrame = vnetHdr ? kMaxGsoFrame : mtu;
+  // One byte more than a frame may have, to tell a frame that is too large
+  // from one that just fits: readv() silently truncates what doesn't fit.
+  size_t readLen = maxFrame + 1;
+  if (spill_.size() != readLen) {
+    spill_.resize(readLen);
+  }
   int sent = 0;
   int dropped = 0;
   uint64_t bytes = 0;
   bool fdFail = false;
   try {
-    while (sent + dropped < MaxSentOneTime) {
+    while (sent + dropped < kMaxReadsPerWakeup) {
       std::unique_ptr<TxPacket> pkt;
-      pkt = sw_->allocateL3TxPacket(mtu_);
+      pkt = sw->allocateL3TxPacket(std::min(readSize_, mtu));
       auto buf = pkt->buf();
-      int ret = 0;
+      // The packet goes to buf first and continues in spill_ if it doesn't
+      // fit, leaving room in front of it in spill_ to copy the first part
+      // to.  Either way at most readLen bytes are read.
+      size_t head = std::min<size_t>(buf->tailroom(), maxFrame);
+      VnetHdr vnet;
+      struct iovec iov[3];
+      int iovcnt = 0;
+      if (vnetHdr) {
+        iov[iovcnt].iov_base = &vnet;
+        iov[iovcnt++].iov_len = kVnetHdrLen;
+      }
+      iov[iovcnt].iov_base = buf->writableTail();
+      iov[iovcnt++].iov_len = head;
+      iov[iovcnt].iov_base = spill_.data() + head;
+      iov[iovcnt++].iov_len = readLen - head;
+      ssize_t ret = 0;
       do {
-        ret = read(fd_, buf->writableTail(), buf->tailroom());
+        ret = readv(fd_, iov, iovcnt);
       } while (ret == -1 && errno == EINTR);
       if (ret < 0) {
         if (errno != EAGAIN) {
@@ -196,18 +310,69 @@ void TunIntf::handlerReady(uint16_t events) noexcept {
         // Nothing to read. It shall not happen as the fd is non-blocking.
         // Just add this case to be safe.
         break;
-      } else if (ret > buf->tailroom()) {
-        // The pkt is larger than the buffer. We don't have complete packet.
-        // It shall not happen unless the MTU is mis-match. Drop the packet.
-        LOG(ERROR) << "Too large packet (" << ret << " > " << buf->tailroom()
-                   << ") received from host. Drop the packet.";
+      } else if (ret > hdrLen + maxFrame) {
+        // The pkt filled the extra byte, so it was truncated. It shall not
+        // happen unless the MTU is mis-match. Drop the packet.
+        LOG(ERROR) << "Too large packet (more than " << maxFrame
+                   << " bytes) received from host. Drop the packet.";
+        dropped++;
+        continue;
+      } else if (ret <= hdrLen) {
+        LOG(ERROR) << "Too short packet (" << ret << " bytes) received from "
+                   << "host. Drop the packet.";
         dropped++;
-      } else {
-        bytes += ret;
-        buf->append(ret);
-        sw_->sendL3Packet(rid_, std::move(pkt));
-        sent++;
+        continue;
+      }
+
+      uint32_t length = ret - hdrLen;
+      if (vnetHdr && GsoSegmenter::isGso(vnet)) {
+        // The segments are copied out, so just make the frame contiguous
+        const uint8_t* data = buf->tail();
+        if (length > head) {
+          memcpy(spill_.data(), buf->tail(), head);
+          data = spill_.data();
+        }
+        try {
+          sent += GsoSegmenter::segment(
+              vnet, data, length,
+              [sw](uint32_t l3Len) {
+                return sw->allocateL3TxPacket(l3Len);
+              },
+              [sw, rid](std::unique_ptr<TxPacket> segment) {
+                sw->sendL3Packet(rid, std::move(segment));
+              });
+          bytes += length;
+        } catch (const FbossError& ex) {
+          LOG(ERROR) << "Dropping GSO packet from host: " << ex.what();
+          dropped++;
+        }
+        continue;
       }
+
+      if (length > head) {
+        // Didn't fit in the buffer we guessed, move it into one that does
+        auto full = sw->allocateL3TxPacket(length);
+        auto fullBuf = full->buf();
+        memcpy(fullBuf->writableTail(), buf->writableTail(), head);
+        memcpy(fullBuf->writableTail() + head, spill_.data() + head,
+               length - head);
+        pkt = std::move(full);
+        buf = fullBuf;
+      }
+      buf->append(length);
+      updateReadSize(length);
+      if (vnetHdr && !GsoSegmenter::isPlain(vnet)) {
+        try {
+          GsoSegmenter::completeChecksum(vnet, buf->writableData(), length);
+        } catch (const FbossError& ex) {
+          LOG(ERROR) << "Dropping packet from host: " << ex.what();
+          dropped++;
+          continue;
+        }
+      }
+      bytes += length;
+      sw->sendL3Packet(rid, std::move(pkt));
+      sent++;
     }
   } catch (const std::exception& ex) {
     LOG(ERROR) << "Hit some error when forwarding packets :"
@@ -217,12 +382,38 @@ void TunIntf::handlerReady(uint16_t events) noexcept {
     unregisterHandler();
   }
   VLOG(4) << "Forwarded " << sent << " packets (" << bytes
-          << " bytes) from host @ fd " << fd_ << " for router " << rid_
+          << " bytes) from host @ fd " << fd_ << " for router " << rid
           << " dropped:" << dropped;
 }
 
+void TunIntf::Queue::updateReadSize(uint32_t length) {
+  // Grow at once to fit the largest packet seen, and shrink slowly as
+  // smaller packets come in, so that a mix of large and small packets
+  // rarely has to be copied out of spill_.
+  if (length > readSize_) {
+    readSize_ = length;
+  } else {
+    readSize_ -= (readSize_ - std::max(length, kMinReadSize)) / 16;
+  }
+}
+
+void TunIntf::Queue::start() {
+  runInThreadAndWait(evb_, [this] {
+      if (fd_ != -1 && !isHandlerRegistered()) {
+        changeHandlerFD(fd_);
+        registerHandler(EventHandler::READ|EventHandler::PERSIST);
+      }
+    });
+}
+
+void TunIntf::Queue::stop() {
+  runInThreadAndWait(evb_, [this] {
+      unregisterHandler();
+    });
+}
+
 bool TunIntf::sendPacketToHost(std::unique_ptr<RxPacket> pkt) {
-  CHECK(fd_ != -1);
+  CHECK(fd() != -1);
   const int l2Len = EthHdr::SIZE;
   auto buf = pkt->buf();
   if (buf->length() <= l2Len) {
@@ -231,31 +422,45 @@ bool TunIntf::sendPacketToHost(std::unique_ptr<RxPacket> pkt) {
   }
   // skip L2 header
   buf->trimStart(l2Len);
-  int ret = 0;
+  // The ASIC doesn't tell us anything the kernel could use, so with
+  // IFF_VNET_HDR the packet just goes with an empty header.
+  VnetHdr vnet;
+  memset(&vnet, 0, sizeof(vnet));
+  size_t hdrLen = vnetHdr_ ? kVnetHdrLen : 0;
+  struct iovec iov[2];
+  int iovcnt = 0;
+  if (vnetHdr_) {
+    iov[iovcnt].iov_base = &vnet;
+    iov[iovcnt++].iov_len = hdrLen;
+  }
+  iov[iovcnt].iov_base = buf->writableData();
+  iov[iovcnt++].iov_len = buf->length();
+  ssize_t ret = 0;
   do {
-    ret = write(fd_, buf->data(), buf->length());
+    ret = writev(fd(), iov, iovcnt);
   } while (ret == -1 && errno == EINTR);
   if (ret < 0) {
     sysLogError(ret, "Failed to send packet to the host from router ", rid_);
     return false;
-  } else if (ret < buf->length()) {
+  } else if (ret < hdrLen + buf->length()) {
     LOG(ERROR) << "Failed to send full packet to host from router " << rid_
-               << ret << " bytes sent instead of " << buf->length();
+               << ret << " bytes sent instead of " << hdrLen + buf->length();
   } else {
-    VLOG(4) << "Send packet (" << ret << " bytes) to host from router "
-            << rid_;
+    VLOG(4) << "Send packet (" << ret - hdrLen
+            << " bytes) to host from router " << rid_;
   }
   return true;
 }
 
 void TunIntf::stop() {
-  unregisterHandler();
+  for (auto& queue : queues_) {
+    queue->stop();
+  }
 }
 
 void TunIntf::start() {
-  if (fd_ != -1 && !isHandlerRegistered()) {
-    changeHandlerFD(fd_);
-    registerHandler(EventHandler::READ|EventHandler::PERSIST);
+  for (auto& queue : queues_) {
+    queue->start();
   }
 }
 
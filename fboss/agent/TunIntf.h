@@ -14,18 +14,37 @@
 #include <folly/io/async/EventBase.h>
 #include <folly/io/async/EventHandler.h>
 
+#include <atomic>
+#include <vector>
+
 namespace facebook { namespace fboss {
 
 class SwSwitch;
 class RxPacket;
 
-class TunIntf : private folly::EventHandler {
+/*
+ * TunIntf forwards packets between a TUN interface on the host and the
+ * switch.
+ *
+ * One queue (file descriptor) is opened per EventBase given.  With more
+ * than one the interface is created with IFF_MULTI_QUEUE and the kernel
+ * spreads the flows sent by the host across the queues, so forwarding them
+ * scales with the threads serving the EventBases.
+ *
+ * With vnetHdr the interface is opened with IFF_VNET_HDR and TCP
+ * segmentation and checksum offloads are enabled on it, which lets the host
+ * stack send large TCP writes (e.g. BGP table dumps) as one frame.  They are
+ * segmented by GsoSegmenter before being sent to the switch.
+ */
+class TunIntf {
  public:
-  TunIntf(SwSwitch *sw, folly::EventBase *evb,
-          const std::string& name, RouterID rid, int idx, int mtu);
-  TunIntf(SwSwitch *sw, folly::EventBase *evb,
-          RouterID rid, const Interface::Addresses& addrs, int mtu);
-  ~TunIntf() override;
+  TunIntf(SwSwitch *sw, const std::vector<folly::EventBase*>& evbs,
+          const std::string& name, RouterID rid, int idx, int mtu,
+          bool vnetHdr);
+  TunIntf(SwSwitch *sw, const std::vector<folly::EventBase*>& evbs,
+          RouterID rid, const Interface::Addresses& addrs, int mtu,
+          bool vnetHdr);
+  ~TunIntf();
 
   // some utility functions
   static bool isTunIntf(const char *name);
@@ -66,7 +85,6 @@ class TunIntf : private folly::EventHandler {
   void start();
   /// Stop packet forwarding.
   void stop();
-  void handlerReady(uint16_t events) noexcept override;
   /**
    * Send a packet to the interface on host.
    * Unlike other methods, which are called on thread that serves the evb,
@@ -82,7 +100,47 @@ class TunIntf : private folly::EventHandler {
   int getMtu() {
     return mtu_;
   }
+  size_t getNumQueues() const {
+    return queues_.size();
+  }
  private:
+  /**
+   * A queue of the interface, served by one EventBase.
+   *
+   * Each read goes into a packet sized for what this queue has been
+   * receiving recently rather than for the MTU, so that small control
+   * packets don't tie up MTU sized buffers.  Anything that doesn't fit
+   * spills into spill_ and is copied out from there.
+   */
+  class Queue : private folly::EventHandler {
+   public:
+    Queue(TunIntf* intf, folly::EventBase* evb);
+    ~Queue() override;
+
+    int getFD() const {
+      return fd_;
+    }
+    /**
+     * Open the fd and attach it to the interface.  Returns false if the
+     * interface exists with a different IFF_MULTI_QUEUE setting.
+     */
+    bool openFD(bool multiQueue);
+    void closeFD() noexcept;
+    void start();
+    void stop();
+    void handlerReady(uint16_t events) noexcept override;
+
+   private:
+    void updateReadSize(uint32_t length);
+
+    TunIntf* intf_;
+    folly::EventBase* evb_;
+    int fd_{-1};
+    /// The L3 size of the packets allocated for reads
+    uint32_t readSize_{0};
+    std::vector<uint8_t> spill_;
+  };
+
   SwSwitch *sw_;
   RouterID rid_;         ///< The router ID of the interface belonging to
   std::string name_;    ///< The name in the host
@@ -91,15 +149,20 @@ class TunIntf : private folly::EventHandler {
   Interface::Addresses addrs_; ///< The IP addresses assigned to this intf
 
   /**
-   * File descriptor for this interface through which packets can
-   * be received from or sent to.
+   * The queues of this interface.  Packets from the host are read from all
+   * of them, packets to the host are written to the first one.
    */
-  int fd_{-1};
-  int mtu_{-1};
+  std::vector<std::unique_ptr<Queue>> queues_;
+  /// Whether packets are read and written with a virtio_net_hdr
+  bool vnetHdr_{false};
+  std::atomic<int> mtu_{-1};
 
   std::string makeIntfName(RouterID rid);
-  void openFD();
-  void closeFD() noexcept;
+  void openQueues(const std::vector<folly::EventBase*>& evbs);
+  /// The file descriptor of the first queue, used for anything but reading
+  int fd() const {
+    return queues_.front()->getFD();
+  }
 };
 
 }}
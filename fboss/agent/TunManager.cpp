@@ -22,16 +22,33 @@ extern "C" {
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/state/InterfaceMap.h"
 #include "fboss/agent/state/Interface.h"
+#include <folly/Conv.h>
+#include <folly/ThreadName.h>
+#include <gflags/gflags.h>
 #include <folly/io/async/EventBase.h>
 
 #include <boost/container/flat_set.hpp>
 
+DEFINE_int32(tun_queues, 1,
+             "Number of queues to open on each tun interface, each served by "
+             "its own thread. More than one creates the interfaces with "
+             "IFF_MULTI_QUEUE; an existing interface keeps the setting it "
+             "was created with until it is deleted.");
+DEFINE_bool(tun_vnet_hdr, false,
+            "Enable TCP segmentation and checksum offloads on tun interfaces, "
+            "segmenting and checksumming the packets from the host in the "
+            "agent instead");
+
 namespace facebook { namespace fboss {
 
 using folly::IPAddress;
 using folly::EventBase;
 
 TunManager::TunManager(SwSwitch *sw, EventBase *evb) : sw_(sw), evb_(evb) {
+  startQueueThreads();
+  SCOPE_FAIL {
+    stopQueueThreads();
+  };
   sock_ = nl_socket_alloc();
   if (!sock_) {
     throw FbossError("failed to allocate libnl socket");
@@ -46,10 +63,36 @@ TunManager::~TunManager() {
   }
 
   stop();
+  stopQueueThreads();
   nl_close(sock_);
   nl_socket_free(sock_);
 }
 
+void TunManager::startQueueThreads() {
+  queueEvbs_.push_back(evb_);
+  for (int idx = 1; idx < FLAGS_tun_queues; ++idx) {
+    extraEvbs_.push_back(folly::make_unique<EventBase>());
+    auto evb = extraEvbs_.back().get();
+    queueEvbs_.push_back(evb);
+    queueThreads_.push_back(folly::make_unique<std::thread>([evb, idx] {
+        auto name = folly::to<std::string>("fbossTunQueue", idx);
+        folly::setThreadName(pthread_self(), name);
+        evb->loopForever();
+      }));
+  }
+}
+
+void TunManager::stopQueueThreads() {
+  for (auto& evb : extraEvbs_) {
+    auto evbPtr = evb.get();
+    evbPtr->runInEventBaseThread([evbPtr] { evbPtr->terminateLoopSoon(); });
+  }
+  for (auto& thread : queueThreads_) {
+    thread->join();
+  }
+  queueThreads_.clear();
+}
+
 int TunManager::getMinMtu(std::shared_ptr<SwitchState> state) {
   int minMtu = INT_MAX;
   auto intfMap = state->getInterfaces();
@@ -68,7 +111,8 @@ void TunManager::addIntf(RouterID rid, const std::string& name, int ifIdx) {
     intfs_.erase(ret.first);
   };
   ret.first->second.reset(
-      new TunIntf(sw_, evb_, name, rid, ifIdx, getMinMtu(sw_->getState())));
+      new TunIntf(sw_, queueEvbs_, name, rid, ifIdx,
+                  getMinMtu(sw_->getState()), FLAGS_tun_vnet_hdr));
 }
 
 void TunManager::addIntf(RouterID rid, const Interface::Addresses& addrs) {
@@ -80,7 +124,8 @@ void TunManager::addIntf(RouterID rid, const Interface::Addresses& addrs) {
     intfs_.erase(ret.first);
   };
   auto intf = folly::make_unique<TunIntf>(
-      sw_, evb_, rid, addrs, getMinMtu(sw_->getState()));
+      sw_, queueEvbs_, rid, addrs, getMinMtu(sw_->getState()),
+      FLAGS_tun_vnet_hdr);
   SCOPE_FAIL {
     intf->setDelete();
   };
@@ -455,7 +500,9 @@ void TunManager::startProbe() {
 }
 
 void TunManager::startObservingUpdates() {
-  sw_->registerStateObserver(this, "TunManager");
+  // stateUpdated() only hands the new state to our own thread, so it needn't
+  // wait for the hardware.
+  sw_->registerStateObserver(this, "TunManager", true);
   observingState_ = true;
 }
 
@@ -16,6 +16,9 @@
 
 #include <boost/container/flat_map.hpp>
 
+#include <thread>
+#include <vector>
+
 extern "C" {
 #include <netlink/socket.h>
 #include <netlink/object.h>
@@ -40,8 +43,8 @@ class TunManager : public StateObserver {
   void startProbe();
   /**
    * Update the intfs_ map based on the given state update. This
-   * overrides the StateObserver stateUpdated api, which is always
-   * guaranteed to be called from the update thread.
+   * overrides the StateObserver stateUpdated api, and runs on one of the
+   * SwSwitch's observer threads, concurrently with hardware programming.
    */
   void stateUpdated(const StateDelta& delta) override;
 
@@ -69,6 +72,14 @@ class TunManager : public StateObserver {
 
   SwSwitch *sw_;
   folly::EventBase *evb_;
+  /**
+   * The EventBases serving the queues of each TUN interface: evb_ for the
+   * first one, and one of extraEvbs_, each with its own thread, for the rest.
+   * These are declared before intfs_ so that they outlive the interfaces.
+   */
+  std::vector<folly::EventBase*> queueEvbs_;
+  std::vector<std::unique_ptr<folly::EventBase>> extraEvbs_;
+  std::vector<std::unique_ptr<std::thread>> queueThreads_;
   boost::container::flat_map<RouterID, std::unique_ptr<TunIntf>> intfs_;
   nl_sock *sock_;
   /**
@@ -148,6 +159,10 @@ class TunManager : public StateObserver {
   void applyChanges(const MAPNAME& oldMap, const MAPNAME& newMap,
                     CHANGEFN changeFn, ADDFN addFn, REMOVEFN removeFn);
 
+  /// Start/stop the threads serving the TUN queues after the first one
+  void startQueueThreads();
+  void stopQueueThreads();
+
   void probe();
   void doProbe(std::lock_guard<std::mutex>& mutex);
 
@@ -22,7 +22,7 @@ class UnresolvedNhopsProber : private folly::AsyncTimeout,
  public:
   explicit UnresolvedNhopsProber(SwSwitch *sw) :
       AsyncTimeout(sw->getBackgroundEVB()),
-      AutoRegisterStateObserver(sw, "UnresolvedNhopsProber"),
+      AutoRegisterStateObserver(sw, "UnresolvedNhopsProber", true),
       sw_(sw),
       // Probe every 5 secs (make it faster ?)
       interval_(5) {
@@ -30,6 +30,7 @@ class UnresolvedNhopsProber : private folly::AsyncTimeout,
   }
 
   ~UnresolvedNhopsProber() {
+    stopObserving();
     sw_->getBackgroundEVB()->runImmediatelyOrRunInEventBaseThreadAndWait(
       [this]() {
         cancelTimeout();
@@ -50,7 +51,7 @@ class UnresolvedNhopsProber : private folly::AsyncTimeout,
   void timeoutExpired() noexcept override;
 
  private:
-  // Need lock since we may get called from both the update
+  // Need lock since we may get called from both an observer
   // thread (stateChanged) and background thread (timeoutExpired)
   std::mutex lock_;
   SwSwitch* sw_{nullptr};
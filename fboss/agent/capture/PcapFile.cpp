@@ -12,16 +12,23 @@
 #include "fboss/agent/capture/PcapPkt.h"
 
 #include <folly/Exception.h>
-#include <folly/FileUtil.h>
+#include <folly/String.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 using folly::IOBuf;
-using folly::writeFull;
-using folly::writevFull;
 using std::chrono::microseconds;
 using std::chrono::seconds;
 
+DEFINE_int64(fboss_pcap_file_chunk_bytes, 4 * 1024 * 1024,
+             "When taking packet captures, the amount of disk space to "
+             "allocate and map at a time");
+
 namespace facebook { namespace fboss {
 
 PcapFile::PktHeader::PktHeader(const PcapPkt& pkt) {
@@ -42,13 +49,91 @@ PcapFile::PcapFile() {
 PcapFile::PcapFile(folly::StringPiece path,
                    bool overwriteExisting)
   : file_(path.str().c_str(), openFlags(overwriteExisting), 0644) {
+  if (overwriteExisting) {
+    // We may be reusing the name of a longer capture
+    folly::checkUnixError(ftruncate(file_.fd(), 0),
+                          "error truncating pcap file");
+  }
 }
 
 PcapFile::~PcapFile() {
+  try {
+    close();
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "error closing pcap file: " << folly::exceptionStr(ex);
+  }
+}
+
+PcapFile::PcapFile(PcapFile&& other) noexcept
+  : file_(std::move(other.file_)),
+    map_(other.map_),
+    mapOffset_(other.mapOffset_),
+    mapLength_(other.mapLength_),
+    offset_(other.offset_) {
+  other.map_ = nullptr;
+  other.mapOffset_ = 0;
+  other.mapLength_ = 0;
+  other.offset_ = 0;
+}
+
+PcapFile& PcapFile::operator=(PcapFile&& other) noexcept {
+  if (this != &other) {
+    // Close our current file when old goes out of scope
+    PcapFile old(std::move(*this));
+    file_ = std::move(other.file_);
+    std::swap(map_, other.map_);
+    std::swap(mapOffset_, other.mapOffset_);
+    std::swap(mapLength_, other.mapLength_);
+    std::swap(offset_, other.offset_);
+  }
+  return *this;
 }
 
 void PcapFile::close() {
+  if (!file_) {
+    return;
+  }
+  unmap();
+  // Drop the space we preallocated but didn't use
+  folly::checkUnixError(ftruncate(file_.fd(), offset_),
+                        "error truncating pcap file");
   file_.close();
+  offset_ = 0;
+}
+
+void PcapFile::unmap() {
+  if (map_) {
+    munmap(map_, mapLength_);
+    map_ = nullptr;
+    mapOffset_ = 0;
+    mapLength_ = 0;
+  }
+}
+
+uint8_t* PcapFile::reserve(uint64_t length) {
+  uint64_t end = offset_ + length;
+  if (map_ && end <= mapOffset_ + mapLength_) {
+    return map_ + (offset_ - mapOffset_);
+  }
+
+  unmap();
+  uint64_t pageSize = sysconf(_SC_PAGESIZE);
+  uint64_t mapOffset = offset_ & ~(pageSize - 1);
+  uint64_t mapLength = std::max<uint64_t>(FLAGS_fboss_pcap_file_chunk_bytes,
+                                          end - mapOffset);
+  mapLength = (mapLength + pageSize - 1) & ~(pageSize - 1);
+
+  int err = posix_fallocate(file_.fd(), mapOffset, mapLength);
+  folly::checkPosixError(err, "error allocating space for pcap file");
+  void* map = mmap(nullptr, mapLength, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   file_.fd(), mapOffset);
+  if (map == MAP_FAILED) {
+    folly::throwSystemError("error mapping pcap file");
+  }
+  map_ = static_cast<uint8_t*>(map);
+  mapOffset_ = mapOffset;
+  mapLength_ = mapLength;
+  return map_ + (offset_ - mapOffset_);
 }
 
 void PcapFile::writeGlobalHeader() {
@@ -71,33 +156,31 @@ void PcapFile::writeGlobalHeader() {
   // include 113 for linux "cooked" capture format.
   hdr.linkType = 1;
 
-  int ret = writeFull(file_.fd(), &hdr, sizeof(hdr));
-  folly::checkUnixError(ret, "error writing pcap global header");
+  memcpy(reserve(sizeof(hdr)), &hdr, sizeof(hdr));
+  offset_ += sizeof(hdr);
+}
+
+void PcapFile::writePacket(const PcapPkt& pkt) {
+  PktHeader hdr(pkt);
+  uint8_t* out = reserve(sizeof(hdr) + hdr.includedLen);
+  memcpy(out, &hdr, sizeof(hdr));
+  out += sizeof(hdr);
+  for (auto range : *pkt.buf()) {
+    memcpy(out, range.data(), range.size());
+    out += range.size();
+  }
+  offset_ += sizeof(hdr) + hdr.includedLen;
 }
 
 void PcapFile::writePackets(const std::vector<PcapPkt>& pkts) {
-  folly::fbvector<PktHeader> hdrs;
-  hdrs.reserve(pkts.size());
-  folly::fbvector<struct iovec> iov;
-  // Reserve enough space, assuming each packet is in a single IOBuf.
-  // If some packets are split across IOBuf chains then we will end up
-  // allocating more space as needed in the loop below.
-  iov.reserve(pkts.size() * 2);
-
-  // Build iovecs for all of the packet headers and data
   for (const auto& pkt : pkts) {
-    hdrs.emplace_back(pkt);
-    PktHeader* curHdr = &hdrs.back();
-    iov.push_back({(void*)curHdr, sizeof(PktHeader)});
-    pkt.buf()->appendToIov(&iov);
+    writePacket(pkt);
   }
-
-  int ret = writevFull(file_.fd(), iov.data(), iov.size());
-  folly::checkUnixError(ret, "error writing pcap data");
 }
 
 int PcapFile::openFlags(bool overwriteExisting) {
-  int flags = O_CREAT | O_WRONLY;
+  // The mapping needs read access too
+  int flags = O_CREAT | O_RDWR;
   if (!overwriteExisting) {
     flags |= O_EXCL;
   }
@@ -20,6 +20,12 @@ class PcapPkt;
 /*
  * PcapFile supports writing packets to a file in pcap format.
  *
+ * The file is written through a memory mapping: space is preallocated on
+ * disk a chunk at a time (see --fboss_pcap_file_chunk_bytes), so writing a
+ * packet is just a copy into the mapping, and running out of disk space is
+ * reported when a chunk is allocated rather than by a SIGBUS.  The file is
+ * truncated to the data actually written when it is closed.
+ *
  * PcapFile uses blocking I/O.  If you are recording packets from a
  * non-blocking thread, you should use PcapWriter instead of using PcapFile
  * directly.
@@ -33,11 +39,19 @@ class PcapFile {
   void close();
 
   void writeGlobalHeader();
-  void writePackets(const std::vector<PcapPkt>& pkt);
+  void writePacket(const PcapPkt& pkt);
+  void writePackets(const std::vector<PcapPkt>& pkts);
+
+  /*
+   * The number of bytes written to the file so far.
+   */
+  uint64_t size() const {
+    return offset_;
+  }
 
   // Move constructor and assignment operator
-  PcapFile(PcapFile&&) = default;
-  PcapFile& operator=(PcapFile&&) = default;
+  PcapFile(PcapFile&& other) noexcept;
+  PcapFile& operator=(PcapFile&& other) noexcept;
 
  private:
   struct PktHeader {
@@ -55,7 +69,20 @@ class PcapFile {
 
   static int openFlags(bool overwriteExisting);
 
+  /*
+   * Return a pointer to length bytes of mapped file at the current offset,
+   * allocating and mapping more of the file if needed.
+   */
+  uint8_t* reserve(uint64_t length);
+  void unmap();
+
   folly::File file_;
+  // The mapped window of the file, starting at file offset mapOffset_
+  uint8_t* map_{nullptr};
+  uint64_t mapOffset_{0};
+  uint64_t mapLength_{0};
+  // The number of bytes written
+  uint64_t offset_{0};
 };
 
 }} // facebook::fboss
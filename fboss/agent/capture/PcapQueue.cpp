@@ -13,106 +13,177 @@
 #include "fboss/agent/TxPacket.h"
 #include "fboss/agent/capture/PcapPkt.h"
 
+#include <folly/ProducerConsumerQueue.h>
+
+#include <algorithm>
+
 DEFINE_int32(fboss_pcap_queue_depth, 10240,
              "When taking packet captures, the maximum number of packets "
-             "to buffer in memory while waiting them to be written to the "
-             "capture file");
+             "each thread may buffer in memory while waiting them to be "
+             "written to the capture file");
+
+namespace {
+// How long the reader sleeps if it misses a wakeup
+const std::chrono::milliseconds kMaxReaderSleep(100);
+}
 
 namespace facebook { namespace fboss {
 
+class PcapQueue::Ring {
+ public:
+  explicit Ring(uint32_t capacity)
+    // ProducerConsumerQueue holds one less element than its size
+    : queue_(capacity + 1) {}
+
+  bool write(PcapPkt&& pkt) {
+    return queue_.write(std::move(pkt));
+  }
+  bool read(PcapPkt* pkt) {
+    return queue_.read(*pkt);
+  }
+  bool isEmpty() const {
+    return queue_.isEmpty();
+  }
+  bool isFull() const {
+    return queue_.isFull();
+  }
+
+ private:
+  folly::ProducerConsumerQueue<PcapPkt> queue_;
+};
+
 PcapQueue::PcapQueue(uint32_t pktCapacity, uint64_t bytesCapacity)
   : pktCapacity_(pktCapacity == 0 ?
                  FLAGS_fboss_pcap_queue_depth : pktCapacity),
     bytesCapacity_(bytesCapacity) {
-  queue_.reserve(pktCapacity_);
 }
 
 PcapQueue::~PcapQueue() {
 }
 
+PcapQueue::Ring* PcapQueue::getRing() {
+  auto& ring = *localRing_;
+  if (!ring) {
+    ring = std::make_shared<Ring>(pktCapacity_);
+    std::lock_guard<std::mutex> guard(ringsMutex_);
+    rings_.push_back(ring);
+    ringsVersion_.fetch_add(1, std::memory_order_release);
+  }
+  return ring.get();
+}
+
 template<typename PktType>
 void PcapQueue::addPktInternal(const PktType* pkt) {
-  // Check to see if this would exceed the queue capacity.
-  if (queue_.size() >= pktCapacity_) {
-    pktsDropped_ += 1;
-    return;
-  }
-  auto newBytes = bytesInQueue_ + pkt->buf()->computeChainDataLength();
-  if (bytesCapacity_ > 0 && newBytes >= bytesCapacity_) {
-    pktsDropped_ += 1;
+  if (finished_.load(std::memory_order_acquire)) {
     return;
   }
 
-  queue_.emplace_back(pkt);
-}
+  uint64_t len = 0;
+  if (bytesCapacity_ > 0) {
+    len = pkt->buf()->computeChainDataLength();
+    auto prevBytes = bytesInQueue_.fetch_add(len, std::memory_order_relaxed);
+    if (prevBytes + len >= bytesCapacity_) {
+      bytesInQueue_.fetch_sub(len, std::memory_order_relaxed);
+      pktsDropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
 
-void PcapQueue::addPkt(const RxPacket* pkt) {
-  {
-    std::lock_guard<std::mutex> guard(mutex_);
-    addPktInternal(pkt);
+  // Check for space first, so we don't clone packets we are going to drop.
+  // We are this ring's only producer, so the write can't fail after this.
+  auto ring = getRing();
+  if (ring->isFull()) {
+    bytesInQueue_.fetch_sub(len, std::memory_order_relaxed);
+    pktsDropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  ring->write(PcapPkt(pkt));
+
+  // Pairs with the fence in wait(): either the reader sees our packet
+  // before it sleeps, or we see that it is sleeping and wake it up.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (readerSleeping_.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> guard(sleepMutex_);
+    cv_.notify_one();
   }
-  cv_.notify_one();
 }
 
-void PcapQueue::addPktLocked(const RxPacket* pkt) {
+void PcapQueue::addPkt(const RxPacket* pkt) {
   addPktInternal(pkt);
-  // It is preferred not to be holding the lock when we signal cv_,
-  // but it is okay to call it with the lock held anyway.  (Having the lock
-  // held will just prevent the reader thread from being able to acquire it
-  // immediately when the reader wakes.)
-  cv_.notify_one();
 }
 
 void PcapQueue::addPkt(const TxPacket* pkt) {
-  {
-    std::lock_guard<std::mutex> guard(mutex_);
-    addPktInternal(pkt);
-  }
-  cv_.notify_one();
-}
-
-void PcapQueue::addPktLocked(const TxPacket* pkt) {
   addPktInternal(pkt);
-  // It is preferred not to be holding the lock when we signal cv_,
-  // but it is okay to call it with the lock held anyway.  (Having the lock
-  // held will just prevent the reader thread from being able to acquire it
-  // immediately when the reader wakes.)
-  cv_.notify_one();
 }
 
 void PcapQueue::finish() {
-  std::lock_guard<std::mutex> guard(mutex_);
-  finished_ = true;
+  finished_.store(true, std::memory_order_release);
+  std::lock_guard<std::mutex> guard(sleepMutex_);
   cv_.notify_all();
 }
 
-bool PcapQueue::isFinished() const {
-  std::lock_guard<std::mutex> guard(mutex_);
-  return finished_;
+bool PcapQueue::readRings(std::vector<PcapPkt>* pkts) {
+  auto version = ringsVersion_.load(std::memory_order_acquire);
+  if (version != readerRingsVersion_) {
+    std::lock_guard<std::mutex> guard(ringsMutex_);
+    readerRings_ = rings_;
+    readerRingsVersion_ = ringsVersion_.load(std::memory_order_relaxed);
+  }
+
+  size_t nonEmptyRings = 0;
+  PcapPkt pkt;
+  for (const auto& ring : readerRings_) {
+    auto prevSize = pkts->size();
+    while (ring->read(&pkt)) {
+      pkts->push_back(std::move(pkt));
+    }
+    nonEmptyRings += pkts->size() > prevSize;
+  }
+  if (bytesCapacity_ > 0) {
+    uint64_t bytes = 0;
+    for (const auto& queued : *pkts) {
+      bytes += queued.buf()->computeChainDataLength();
+    }
+    bytesInQueue_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+  if (nonEmptyRings > 1) {
+    std::stable_sort(pkts->begin(), pkts->end(),
+                     [](const PcapPkt& a, const PcapPkt& b) {
+                       return a.timestamp() < b.timestamp();
+                     });
+  }
+  return !pkts->empty();
 }
 
-uint64_t PcapQueue::numDropped() const {
-  std::lock_guard<std::mutex> guard(mutex_);
-  return pktsDropped_;
+bool PcapQueue::ringsEmpty() {
+  for (const auto& ring : readerRings_) {
+    if (!ring->isEmpty()) {
+      return false;
+    }
+  }
+  // A thread may have added a ring we haven't seen yet
+  return ringsVersion_.load(std::memory_order_acquire) == readerRingsVersion_;
 }
 
 bool PcapQueue::wait(std::vector<PcapPkt>* swapQueue) {
   swapQueue->clear();
-  swapQueue->reserve(pktCapacity_);
-
-  std::unique_lock<std::mutex> guard(mutex_);
-  while (queue_.empty() && !finished_) {
-    cv_.wait(guard);
+  while (true) {
+    if (readRings(swapQueue)) {
+      return true;
+    }
+    if (finished_.load(std::memory_order_acquire)) {
+      // Pick up anything added just before finish()
+      return readRings(swapQueue);
+    }
+
+    std::unique_lock<std::mutex> guard(sleepMutex_);
+    readerSleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ringsEmpty() && !finished_.load(std::memory_order_acquire)) {
+      cv_.wait_for(guard, kMaxReaderSleep);
+    }
+    readerSleeping_.store(false, std::memory_order_relaxed);
   }
-  if (queue_.empty()) {
-    DCHECK(finished_);
-    queue_.shrink_to_fit();
-    return false;
-  }
-
-  swapQueue->swap(queue_);
-  bytesInQueue_ = 0;
-  return true;
 }
 
 }} // facebook::fboss
@@ -9,7 +9,11 @@
  */
 #pragma once
 
+#include <folly/ThreadLocal.h>
+
+#include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -24,42 +28,44 @@ class PcapPkt;
  * from an asynchronous capture thread to a blocking thread that will process
  * the packets.  (For instance, writing them to disk using blocking I/O.)
  *
- * There can only be a single reader.
+ * Each thread that adds packets gets its own single producer, single
+ * consumer ring, so adding a packet takes no locks: it is a clone of the
+ * packet's IOBuf (a reference count increment, not a copy of the data) and
+ * a store into the ring.  If a ring is full the packet is counted as
+ * dropped instead.
+ *
+ * There can only be a single reader.  It sees the packets of each producer
+ * in order, and packets from different producers in timestamp order within
+ * each batch returned by wait().
  */
 class PcapQueue {
  public:
+  /*
+   * pktCapacity is the number of packets each producing thread may have
+   * buffered, and bytesCapacity (if non-zero) the number of packet bytes
+   * buffered in total.
+   */
   explicit PcapQueue(uint32_t pktCapacity, uint64_t bytesCapacity = 0);
   virtual ~PcapQueue();
 
   uint32_t getPktCapacity() const {
-    // pktCapacity_ is const, so no need for locking
     return pktCapacity_;
   }
 
-  /*
-   * Get the mutex protecting this PcapQueue.
-   *
-   * This is exposed to allow callers to also protect their own data
-   * with the same mutex if desired.  Callers should call addPktLocked()
-   * instead of addPkt() when they are already holding the PcapQueue mutex.
-   */
-  std::mutex& mutex() const {
-    return mutex_;
-  }
-
   void addPkt(const RxPacket* pkt);
-  void addPktLocked(const RxPacket* pkt);
   void addPkt(const TxPacket* pkt);
-  void addPktLocked(const TxPacket* pkt);
 
   /*
    * finish() signals that no more packets will be added to the queue.
    *
    * This causes wait() to return false in the reader thread once the packets
-   * currently in the queue have been read.
+   * currently in the queue have been read.  Packets added after finish()
+   * are ignored.
    */
   void finish();
-  bool isFinished() const;
+  bool isFinished() const {
+    return finished_.load(std::memory_order_acquire);
+  }
 
   /*
    * Return the number of packets dropped.
@@ -68,34 +74,61 @@ class PcapQueue {
    * added, packets will be dropped once the queue reaches its maximum
    * capacity.
    */
-  uint64_t numDropped() const;
+  uint64_t numDropped() const {
+    return pktsDropped_.load(std::memory_order_relaxed);
+  }
 
   /*
    * Wait for new packets from the queue.
    *
-   * Note: for best performance, the writer should re-use the same vector
-   * for multiple wait() calls.  On subsequent calls the queue will already
-   * have the desired capacity, and will not need to reallocate memory.
+   * Note: for best performance, the reader should re-use the same vector
+   * for multiple wait() calls, so it doesn't need to reallocate memory.
    */
   bool wait(std::vector<PcapPkt>* swapQueue);
 
  private:
+  class Ring;
+
   // Forbidden copy constructor and assignment operator
   PcapQueue(PcapQueue const &) = delete;
   PcapQueue& operator=(PcapQueue const &) = delete;
 
   template<typename PktType>
   void addPktInternal(const PktType* pkt);
+  Ring* getRing();
+  bool readRings(std::vector<PcapPkt>* pkts);
+  bool ringsEmpty();
 
-  mutable std::mutex mutex_;
-  std::condition_variable cv_;
-
-  bool finished_{false};
   const uint32_t pktCapacity_{0};
-  uint64_t bytesCapacity_{0};
-  uint64_t bytesInQueue_{0};
-  uint64_t pktsDropped_{0};
-  std::vector<PcapPkt> queue_;
+  const uint64_t bytesCapacity_{0};
+  std::atomic<uint64_t> bytesInQueue_{0};
+  std::atomic<uint64_t> pktsDropped_{0};
+  std::atomic<bool> finished_{false};
+
+  /*
+   * The calling thread's ring.  The rings are also referenced from rings_,
+   * so the reader can drain them after their thread exits.
+   */
+  folly::ThreadLocal<std::shared_ptr<Ring>> localRing_;
+
+  /*
+   * All rings, protected by ringsMutex_.  This is only locked when a thread
+   * adds its first packet, and by the reader when ringsVersion_ changes.
+   */
+  std::mutex ringsMutex_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+  std::atomic<uint64_t> ringsVersion_{0};
+  // The reader's copy of rings_
+  std::vector<std::shared_ptr<Ring>> readerRings_;
+  uint64_t readerRingsVersion_{0};
+
+  /*
+   * Producers only signal cv_ if the reader said it was about to sleep, so
+   * a busy reader costs producers nothing.
+   */
+  std::mutex sleepMutex_;
+  std::condition_variable cv_;
+  std::atomic<bool> readerSleeping_{false};
 };
 
 }} // facebook::fboss
@@ -11,9 +11,14 @@
 
 #include "fboss/agent/capture/PcapPkt.h"
 
+#include <boost/filesystem.hpp>
+#include <folly/Conv.h>
 #include <folly/String.h>
 
+#include <unistd.h>
+
 using folly::StringPiece;
+using std::chrono::steady_clock;
 
 namespace facebook { namespace fboss {
 
@@ -24,9 +29,8 @@ PcapWriter::PcapWriter(uint32_t maxBufferedPkts)
 PcapWriter::PcapWriter(StringPiece path,
                        bool overwriteExisting,
                        uint32_t maxBufferedPkts)
-  : file_(path, overwriteExisting),
-    queue_(maxBufferedPkts),
-    thread_(&PcapWriter::threadMain, this) {
+  : queue_(maxBufferedPkts) {
+  start(path, overwriteExisting);
 }
 
 PcapWriter::~PcapWriter() {
@@ -41,8 +45,25 @@ PcapWriter::~PcapWriter() {
   }
 }
 
+void PcapWriter::setRotation(uint64_t maxFileBytes,
+                             std::chrono::seconds maxFileAge,
+                             uint32_t maxFiles) {
+  CHECK(!thread_.joinable());
+  maxFileBytes_ = maxFileBytes;
+  maxFileAge_ = maxFileAge;
+  maxFiles_ = maxFiles;
+}
+
 void PcapWriter::start(folly::StringPiece path, bool overwriteExisting) {
+  path_ = path.str();
+  overwriteExisting_ = overwriteExisting;
+  if (overwriteExisting) {
+    // Otherwise they would be mistaken for part of this capture
+    removeRotatedFiles();
+  }
   file_ = PcapFile(path, overwriteExisting);
+  fileStart_ = steady_clock::now();
+  numFiles_.store(1, std::memory_order_relaxed);
   thread_ = std::thread(&PcapWriter::threadMain, this);
 }
 
@@ -70,8 +91,68 @@ void PcapWriter::threadMain() {
   }
 }
 
+std::string PcapWriter::filePath(uint32_t n) const {
+  if (n == 0) {
+    return path_;
+  }
+  return folly::to<std::string>(path_, ".", n);
+}
+
+void PcapWriter::removeRotatedFiles() {
+  namespace fs = boost::filesystem;
+  fs::path base(path_);
+  auto dir = base.parent_path();
+  if (dir.empty()) {
+    dir = ".";
+  }
+  auto prefix = base.filename().string() + ".";
+  // Earlier captures may have been limited to their last few files, so
+  // look for any number rather than counting up from 1
+  std::vector<fs::path> stale;
+  boost::system::error_code ec;
+  for (fs::directory_iterator it(dir, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    auto name = it->path().filename().string();
+    if (name.size() > prefix.size() &&
+        name.compare(0, prefix.size(), prefix) == 0 &&
+        name.find_first_not_of("0123456789", prefix.size()) ==
+          std::string::npos) {
+      stale.push_back(it->path());
+    }
+  }
+  if (ec) {
+    LOG(WARNING) << "unable to look for old packet capture files in "
+                 << dir.string() << ": " << ec.message();
+  }
+  for (const auto& path : stale) {
+    if (!fs::remove(path, ec)) {
+      LOG(WARNING) << "unable to remove old packet capture file "
+                   << path.string() << ": " << ec.message();
+    }
+  }
+}
+
+void PcapWriter::rotate() {
+  auto num = numFiles_.load(std::memory_order_relaxed);
+  auto path = filePath(num);
+  VLOG(2) << "rotating packet capture to " << path;
+  file_.close();
+  file_ = PcapFile(path, overwriteExisting_);
+  file_.writeGlobalHeader();
+  fileStart_ = steady_clock::now();
+  numFiles_.store(num + 1, std::memory_order_relaxed);
+
+  if (maxFiles_ > 0 && num >= maxFiles_) {
+    auto oldest = filePath(num - maxFiles_);
+    if (unlink(oldest.c_str()) != 0) {
+      PLOG(WARNING) << "unable to remove old packet capture file " << oldest;
+    }
+  }
+}
+
 void PcapWriter::writeLoop() {
   std::vector<PcapPkt> pkts;
+  uint64_t pktsInFile = 0;
   while (true) {
     pkts.clear();
     if (!queue_.wait(&pkts)) {
@@ -80,7 +161,22 @@ void PcapWriter::writeLoop() {
     }
 
     DCHECK(!pkts.empty());
-    file_.writePackets(pkts);
+    // We never rotate to an empty file, so a file may go one packet over
+    // maxFileBytes_, and an idle capture isn't rotated until it sees traffic.
+    if (maxFileAge_.count() > 0 && pktsInFile > 0 &&
+        steady_clock::now() - fileStart_ >= maxFileAge_) {
+      rotate();
+      pktsInFile = 0;
+    }
+    for (const auto& pkt : pkts) {
+      if (maxFileBytes_ > 0 && pktsInFile > 0 &&
+          file_.size() >= maxFileBytes_) {
+        rotate();
+        pktsInFile = 0;
+      }
+      file_.writePacket(pkt);
+      ++pktsInFile;
+    }
   }
 }
 
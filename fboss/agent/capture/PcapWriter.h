@@ -12,6 +12,9 @@
 #include "fboss/agent/capture/PcapFile.h"
 #include "fboss/agent/capture/PcapQueue.h"
 
+#include <atomic>
+#include <chrono>
+#include <string>
 #include <thread>
 
 namespace facebook { namespace fboss {
@@ -21,6 +24,12 @@ namespace facebook { namespace fboss {
  * to a pcap file.
  *
  * It performs blocking disk I/O, so it performs the writes in its own thread.
+ *
+ * The capture can be rotated across several files, by size or by time:
+ * the first file is written at the path given to start(), and later ones
+ * at path.1, path.2, etc.  Each file is a complete pcap file.  Optionally
+ * only the most recent files are kept, the oldest being deleted as new ones
+ * are started.
  */
 class PcapWriter {
  public:
@@ -30,31 +39,28 @@ class PcapWriter {
                       uint32_t maxBufferedPkts = 0);
   virtual ~PcapWriter();
 
-  void start(folly::StringPiece path, bool overwriteExisting = false);
-
   /*
-   * Get the mutex protecting this PcapWriter.
+   * Start a new file once the current one holds at least maxFileBytes (if
+   * non-zero), or has been open for maxFileAge (if non-zero).  If maxFiles
+   * is non-zero, only that many of the most recent files are kept.
    *
-   * This is exposed to allow callers to also protect their own data
-   * with the same mutex if desired.  Callers should call addPktLocked()
-   * instead of addPkt() when they are already holding the PcapWriter mutex.
+   * This must be called before start().
    */
-  std::mutex& mutex() const {
-    return queue_.mutex();
-  }
+  void setRotation(uint64_t maxFileBytes, std::chrono::seconds maxFileAge,
+                   uint32_t maxFiles = 0);
+
+  /*
+   * Start writing to path.  With overwriteExisting, the rotated files left
+   * at path.1, path.2, etc. by an earlier capture are removed as well.
+   */
+  void start(folly::StringPiece path, bool overwriteExisting = false);
 
   void addPkt(const RxPacket* pkt) {
     queue_.addPkt(pkt);
   }
-  void addPktLocked(const RxPacket* pkt) {
-    queue_.addPktLocked(pkt);
-  }
   void addPkt(const TxPacket* pkt) {
     queue_.addPkt(pkt);
   }
-  void addPktLocked(const TxPacket* pkt) {
-    queue_.addPktLocked(pkt);
-  }
   void finish();
 
   /*
@@ -67,19 +73,37 @@ class PcapWriter {
     return queue_.numDropped();
   }
 
+  /*
+   * Return the number of files written so far, including the current one.
+   */
+  uint32_t numFiles() const {
+    return numFiles_.load(std::memory_order_relaxed);
+  }
+
  private:
   // Forbidden copy constructor and assignment operator
   PcapWriter(PcapWriter const &) = delete;
   PcapWriter& operator=(PcapWriter const &) = delete;
 
   void threadMain();
-  void writeHeader();
   void writeLoop();
+  void rotate();
+  // The path of the nth file of the capture, counting from 0
+  std::string filePath(uint32_t n) const;
+  void removeRotatedFiles();
 
   PcapFile file_;
   PcapQueue queue_;
   std::exception_ptr ex_;
   std::thread thread_;
+
+  std::string path_;
+  bool overwriteExisting_{false};
+  uint64_t maxFileBytes_{0};
+  std::chrono::seconds maxFileAge_{0};
+  uint32_t maxFiles_{0};
+  std::chrono::steady_clock::time_point fileStart_;
+  std::atomic<uint32_t> numFiles_{0};
 };
 
 }} // facebook::fboss
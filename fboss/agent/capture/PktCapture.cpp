@@ -26,20 +26,33 @@ void PktCapture::start(StringPiece path) {
 
 void PktCapture::stop() {
   writer_.finish();
+  if (writer_.numDropped() > 0) {
+    LOG(WARNING) << "packet capture \"" << name_ << "\" dropped " <<
+      writer_.numDropped() << " packets";
+  }
+}
+
+template<typename PktType>
+bool PktCapture::addPkt(const PktType* pkt) {
+  if (!filter_.matches(pkt)) {
+    return true;
+  }
+  // Claim a slot first, so we never write more than maxPackets_ even when
+  // several threads race to add the last one.
+  auto num = numPacketsReceived_.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (num > maxPackets_) {
+    return false;
+  }
+  writer_.addPkt(pkt);
+  return num < maxPackets_;
 }
 
 bool PktCapture::packetReceived(const RxPacket* pkt) {
-  std::lock_guard<std::mutex> guard(writer_.mutex());
-  ++numPacketsReceived_;
-  writer_.addPktLocked(pkt);
-  return numPacketsReceived_ < maxPackets_;
+  return addPkt(pkt);
 }
 
 bool PktCapture::packetSent(const TxPacket* pkt) {
-  std::lock_guard<std::mutex> guard(writer_.mutex());
-  ++numPacketsReceived_;
-  writer_.addPktLocked(pkt);
-  return numPacketsReceived_ < maxPackets_;
+  return addPkt(pkt);
 }
 
 }} // facebook::fboss
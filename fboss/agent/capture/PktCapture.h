@@ -10,8 +10,11 @@
 #pragma once
 
 #include "fboss/agent/capture/PcapWriter.h"
+#include "fboss/agent/capture/PktCaptureFilter.h"
 
 #include <folly/Range.h>
+#include <atomic>
+#include <chrono>
 #include <string>
 
 namespace facebook { namespace fboss {
@@ -30,9 +33,36 @@ class PktCapture {
     return name_;
   }
 
+  /*
+   * Split the capture into several files.  See PcapWriter::setRotation().
+   * This must be called before start().
+   */
+  void setRotation(uint64_t maxFileBytes, std::chrono::seconds maxFileAge,
+                   uint32_t maxFiles = 0) {
+    writer_.setRotation(maxFileBytes, maxFileAge, maxFiles);
+  }
+
+  /*
+   * Only record the packets matching filter.  Packets that don't match
+   * aren't copied and don't count towards maxPackets.
+   *
+   * Throws an FbossError if the filter is invalid.  This must be called
+   * before start().
+   */
+  void setFilter(const CaptureFilter& filter) {
+    filter_ = PktCaptureFilter(filter);
+  }
+
   void start(folly::StringPiece path);
   void stop();
 
+  /*
+   * The number of packets we saw but couldn't buffer for writing.
+   */
+  uint64_t numDropped() const {
+    return writer_.numDropped();
+  }
+
   bool packetReceived(const RxPacket* pkt);
   bool packetSent(const TxPacket* pkt);
 
@@ -41,13 +71,17 @@ class PktCapture {
   PktCapture(PktCapture const &) = delete;
   PktCapture& operator=(PktCapture const &) = delete;
 
+  template<typename PktType>
+  bool addPkt(const PktType* pkt);
+
   const std::string name_;
+  PktCaptureFilter filter_;
 
-  // Note: the rest of the state in this class is protcted by
-  // the PcapWriter's mutex.
+  // packetReceived() and packetSent() may be called from several threads
+  // at once, and only touch writer_ and numPacketsReceived_.
   PcapWriter writer_;
-  uint64_t maxPackets_{0};
-  uint64_t numPacketsReceived_{0};
+  const uint64_t maxPackets_{0};
+  std::atomic<uint64_t> numPacketsReceived_{0};
 };
 
 }} // facebook::fboss
@@ -0,0 +1,286 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/capture/PktCaptureFilter.h"
+
+#include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/RxPacket.h"
+#include "fboss/agent/TxPacket.h"
+#include "fboss/agent/packet/IPProto.h"
+
+#include <folly/Bits.h>
+#include <folly/io/IOBuf.h>
+
+#include <algorithm>
+#include <limits>
+
+using facebook::network::toIPAddress;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+const uint16_t kEthertypeVlan = 0x8100;
+const uint16_t kEthertypeIPv4 = 0x0800;
+const uint16_t kEthertypeIPv6 = 0x86dd;
+const size_t kEthHdrLen = 14;
+const size_t kVlanTagLen = 4;
+const size_t kIPv4MinHdrLen = 20;
+const size_t kIPv6HdrLen = 40;
+
+uint16_t readBE16(const uint8_t* p) {
+  return folly::Endian::big(folly::loadUnaligned<uint16_t>(p));
+}
+
+uint32_t readBE32(const uint8_t* p) {
+  return folly::Endian::big(folly::loadUnaligned<uint32_t>(p));
+}
+
+uint64_t readBE64(const uint8_t* p) {
+  return folly::Endian::big(folly::loadUnaligned<uint64_t>(p));
+}
+
+// The mask of the first len bits of a width bit word, for len <= width
+uint64_t prefixMask(uint32_t len, uint32_t width) {
+  if (len == 0) {
+    return 0;
+  }
+  uint64_t ones = width == 64 ? ~0ULL : (1ULL << width) - 1;
+  return (ones << (width - len)) & ones;
+}
+
+void checkRange(int64_t value, int64_t max, const char* what) {
+  if (value < 0 || value > max) {
+    throw FbossError("invalid ", what, " ", value, " in capture filter");
+  }
+}
+
+} // unnamed namespace
+
+PktCaptureFilter::PktCaptureFilter() {
+}
+
+PktCaptureFilter::PktCaptureFilter(const CaptureFilter& filter) {
+  switch (filter.direction) {
+    case CaptureDirection::CAPTURE_ONLY_RX:
+      tx_ = false;
+      break;
+    case CaptureDirection::CAPTURE_ONLY_TX:
+      rx_ = false;
+      break;
+    case CaptureDirection::CAPTURE_TX_RX:
+      break;
+    default:
+      throw FbossError("invalid capture direction ",
+                       static_cast<int>(filter.direction));
+  }
+
+  for (auto port : filter.ports) {
+    checkRange(port, std::numeric_limits<int32_t>::max(), "port");
+    ports_.insert(port);
+  }
+  for (auto vlan : filter.vlans) {
+    checkRange(vlan, vlans_.size() - 1, "VLAN");
+    vlans_.set(vlan);
+    anyVlan_ = false;
+  }
+  for (auto ethertype : filter.ethertypes) {
+    checkRange(ethertype, 0xffff, "ethertype");
+    ethertypes_.insert(ethertype);
+  }
+  compilePrefixes(filter.prefixes, &prefixes_);
+  compilePrefixes(filter.srcPrefixes, &srcPrefixes_);
+  compilePrefixes(filter.dstPrefixes, &dstPrefixes_);
+  for (auto proto : filter.ipProtocols) {
+    checkRange(proto, protos_.size() - 1, "IP protocol");
+    protos_.set(proto);
+    anyProto_ = false;
+  }
+  for (auto port : filter.l4Ports) {
+    checkRange(port, 0xffff, "L4 port");
+    l4Ports_.insert(port);
+  }
+
+  needL3_ = !prefixes_.empty() || !srcPrefixes_.empty() ||
+    !dstPrefixes_.empty() || !anyProto_ || !l4Ports_.empty();
+  needData_ = needL3_ || !anyVlan_ || !ethertypes_.empty();
+  matchesAll_ = rx_ && tx_ && ports_.empty() && !needData_;
+}
+
+void PktCaptureFilter::compilePrefixes(const std::vector<IpPrefix>& prefixes,
+                                       Prefixes* out) {
+  for (const auto& prefix : prefixes) {
+    auto ip = toIPAddress(prefix.ip);
+    uint32_t len = prefix.prefixLength;
+    if (prefix.prefixLength < 0 || len > ip.bitCount()) {
+      throw FbossError("invalid prefix ", ip, "/", prefix.prefixLength,
+                       " in capture filter");
+    }
+    if (ip.isV4()) {
+      PrefixV4 v4;
+      v4.mask = prefixMask(len, 32);
+      v4.addr = ip.asV4().toLongHBO() & v4.mask;
+      out->v4.push_back(v4);
+    } else {
+      PrefixV6 v6;
+      const uint8_t* bytes = ip.asV6().bytes();
+      v6.mask[0] = prefixMask(std::min(len, 64U), 64);
+      v6.mask[1] = prefixMask(len > 64 ? len - 64 : 0, 64);
+      v6.addr[0] = readBE64(bytes) & v6.mask[0];
+      v6.addr[1] = readBE64(bytes + 8) & v6.mask[1];
+      out->v6.push_back(v6);
+    }
+  }
+}
+
+bool PktCaptureFilter::matchV4(const Prefixes& prefixes, const uint8_t* addr) {
+  uint32_t value = readBE32(addr);
+  for (const auto& prefix : prefixes.v4) {
+    if ((value & prefix.mask) == prefix.addr) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PktCaptureFilter::matchV6(const Prefixes& prefixes, const uint8_t* addr) {
+  uint64_t hi = readBE64(addr);
+  uint64_t lo = readBE64(addr + 8);
+  for (const auto& prefix : prefixes.v6) {
+    if ((hi & prefix.mask[0]) == prefix.addr[0] &&
+        (lo & prefix.mask[1]) == prefix.addr[1]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PktCaptureFilter::matches(const RxPacket* pkt) const {
+  if (matchesAll_) {
+    return true;
+  }
+  if (!rx_) {
+    return false;
+  }
+  if (!ports_.empty() &&
+      ports_.find(static_cast<uint32_t>(pkt->getSrcPort())) == ports_.end()) {
+    return false;
+  }
+  if (!needData_) {
+    return true;
+  }
+  const auto* buf = pkt->buf();
+  return matchesData(buf->data(), buf->length(), pkt->getSrcVlan());
+}
+
+bool PktCaptureFilter::matches(const TxPacket* pkt) const {
+  if (matchesAll_) {
+    return true;
+  }
+  if (!tx_) {
+    return false;
+  }
+  if (!needData_) {
+    return true;
+  }
+  const auto* buf = pkt->buf();
+  return matchesData(buf->data(), buf->length(), 0);
+}
+
+bool PktCaptureFilter::matchesData(const uint8_t* data, size_t length,
+                                   uint16_t vlan) const {
+  if (length < kEthHdrLen) {
+    return false;
+  }
+  uint16_t ethertype = readBE16(data + 12);
+  size_t l3Off = kEthHdrLen;
+  if (ethertype == kEthertypeVlan) {
+    if (length < kEthHdrLen + kVlanTagLen) {
+      return false;
+    }
+    vlan = readBE16(data + 14) & 0xfff;
+    ethertype = readBE16(data + 16);
+    l3Off += kVlanTagLen;
+  }
+  if (!anyVlan_ && !vlans_[vlan & 0xfff]) {
+    return false;
+  }
+  if (!ethertypes_.empty() && ethertypes_.find(ethertype) == ethertypes_.end()) {
+    return false;
+  }
+  if (!needL3_) {
+    return true;
+  }
+  return matchesL3(ethertype, data + l3Off, length - l3Off);
+}
+
+bool PktCaptureFilter::matchesL3(uint16_t ethertype, const uint8_t* data,
+                                 size_t length) const {
+  uint8_t proto;
+  size_t l4Off;
+  if (ethertype == kEthertypeIPv4) {
+    if (length < kIPv4MinHdrLen || (data[0] >> 4) != 4) {
+      return false;
+    }
+    l4Off = (data[0] & 0x0f) * 4;
+    if (l4Off < kIPv4MinHdrLen || l4Off > length) {
+      return false;
+    }
+    const uint8_t* src = data + 12;
+    const uint8_t* dst = data + 16;
+    if ((!prefixes_.empty() &&
+         !matchV4(prefixes_, src) && !matchV4(prefixes_, dst)) ||
+        (!srcPrefixes_.empty() && !matchV4(srcPrefixes_, src)) ||
+        (!dstPrefixes_.empty() && !matchV4(dstPrefixes_, dst))) {
+      return false;
+    }
+    proto = data[9];
+    // Only the first fragment has the L4 header
+    if (readBE16(data + 6) & 0x1fff) {
+      length = l4Off;
+    }
+  } else if (ethertype == kEthertypeIPv6) {
+    if (length < kIPv6HdrLen) {
+      return false;
+    }
+    const uint8_t* src = data + 8;
+    const uint8_t* dst = data + 24;
+    if ((!prefixes_.empty() &&
+         !matchV6(prefixes_, src) && !matchV6(prefixes_, dst)) ||
+        (!srcPrefixes_.empty() && !matchV6(srcPrefixes_, src)) ||
+        (!dstPrefixes_.empty() && !matchV6(dstPrefixes_, dst))) {
+      return false;
+    }
+    proto = data[6];
+    l4Off = kIPv6HdrLen;
+  } else {
+    // Every L3 test fails on non-IP packets
+    return false;
+  }
+  return matchesL4(proto, data + l4Off, length - l4Off);
+}
+
+bool PktCaptureFilter::matchesL4(uint8_t proto, const uint8_t* data,
+                                 size_t length) const {
+  if (!anyProto_ && !protos_[proto]) {
+    return false;
+  }
+  if (l4Ports_.empty()) {
+    return true;
+  }
+  if ((proto != IP_PROTO::IP_PROTO_TCP && proto != IP_PROTO::IP_PROTO_UDP) ||
+      length < 4) {
+    return false;
+  }
+  return l4Ports_.find(readBE16(data)) != l4Ports_.end() ||
+    l4Ports_.find(readBE16(data + 2)) != l4Ports_.end();
+}
+
+}} // facebook::fboss
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+
+#include <boost/container/flat_set.hpp>
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class RxPacket;
+class TxPacket;
+
+/*
+ * PktCaptureFilter decides which packets a PktCapture records.
+ *
+ * The CaptureFilter from the thrift call is compiled once into lookup
+ * tables (bitsets for VLANs and IP protocols, small sorted sets for ports
+ * and ethertypes, masked words for prefixes), and the tests that are set
+ * are run cheapest first: direction and port, then the L2 header, then the
+ * IP and L4 headers.  Only the first IOBuf of a packet is looked at, and
+ * nothing is copied, so a packet the filter rejects costs a few compares.
+ */
+class PktCaptureFilter {
+ public:
+  // A filter that matches every packet
+  PktCaptureFilter();
+  // Throws an FbossError if the filter is invalid
+  explicit PktCaptureFilter(const CaptureFilter& filter);
+
+  bool matches(const RxPacket* pkt) const;
+  bool matches(const TxPacket* pkt) const;
+
+  bool matchesAll() const {
+    return matchesAll_;
+  }
+
+ private:
+  struct PrefixV4 {
+    uint32_t addr;
+    uint32_t mask;
+  };
+  struct PrefixV6 {
+    uint64_t addr[2];
+    uint64_t mask[2];
+  };
+  struct Prefixes {
+    std::vector<PrefixV4> v4;
+    std::vector<PrefixV6> v6;
+
+    bool empty() const {
+      return v4.empty() && v6.empty();
+    }
+  };
+
+  static void compilePrefixes(const std::vector<IpPrefix>& prefixes,
+                              Prefixes* out);
+  static bool matchV4(const Prefixes& prefixes, const uint8_t* addr);
+  static bool matchV6(const Prefixes& prefixes, const uint8_t* addr);
+
+  /*
+   * Test the packet contents.  vlan is the VLAN to use if the packet has no
+   * 802.1Q tag, or 0 if unknown.
+   */
+  bool matchesData(const uint8_t* data, size_t length, uint16_t vlan) const;
+  bool matchesL3(uint16_t ethertype, const uint8_t* data,
+                 size_t length) const;
+  bool matchesL4(uint8_t proto, const uint8_t* data, size_t length) const;
+
+  bool matchesAll_{true};
+  bool rx_{true};
+  bool tx_{true};
+  bool needData_{false};
+  bool needL3_{false};
+
+  boost::container::flat_set<uint32_t> ports_;
+  std::bitset<4096> vlans_;
+  bool anyVlan_{true};
+  boost::container::flat_set<uint16_t> ethertypes_;
+  Prefixes prefixes_;
+  Prefixes srcPrefixes_;
+  Prefixes dstPrefixes_;
+  std::bitset<256> protos_;
+  bool anyProto_{true};
+  boost::container::flat_set<uint16_t> l4Ports_;
+};
+
+}} // facebook::fboss
@@ -18,6 +18,7 @@
 #include <folly/String.h>
 
 using folly::StringPiece;
+using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 
@@ -47,8 +48,8 @@ void PktCaptureManager::startCapture(unique_ptr<PktCapture> capture) {
   }
 
   capture->start(path);
-  capturesRunning_.store(true, std::memory_order_release);
   activeCaptures_[name] = std::move(capture);
+  updateCaptureList();
 }
 
 void PktCaptureManager::stopCapture(StringPiece name) {
@@ -60,29 +61,29 @@ void PktCaptureManager::stopCapture(StringPiece name) {
     throw FbossError("no active capture found with name \"", name, "\"");
   }
   LOG(INFO) << "stopping packet capture \"" << name << "\"";
-  it->second->stop();
-  inactiveCaptures_[nameStr] = std::move(it->second);
+  auto capture = std::move(it->second);
   activeCaptures_.erase(it);
-  capturesRunning_.store(!activeCaptures_.empty(), std::memory_order_release);
+  updateCaptureList();
+  capture->stop();
+  inactiveCaptures_[nameStr] = std::move(capture);
 }
 
-unique_ptr<PktCapture> PktCaptureManager::forgetCapture(StringPiece name) {
+shared_ptr<PktCapture> PktCaptureManager::forgetCapture(StringPiece name) {
   std::lock_guard<std::mutex> g(mutex_);
   auto nameStr = name.str();
   auto activeIt = activeCaptures_.find(nameStr);
   if (activeIt != activeCaptures_.end()) {
     LOG(INFO) << "stopping packet capture \"" << name << "\"";
-    std::unique_ptr<PktCapture> capture = std::move(activeIt->second);
+    auto capture = std::move(activeIt->second);
     activeCaptures_.erase(activeIt);
-    capturesRunning_.store(!activeCaptures_.empty(),
-                           std::memory_order_release);
+    updateCaptureList();
     capture->stop();
     return capture;
   }
 
   auto inactiveIt = inactiveCaptures_.find(nameStr);
   if (inactiveIt != inactiveCaptures_.end()) {
-    std::unique_ptr<PktCapture> capture = std::move(inactiveIt->second);
+    auto capture = std::move(inactiveIt->second);
     inactiveCaptures_.erase(inactiveIt);
     return capture;
   }
@@ -102,43 +103,75 @@ void PktCaptureManager::forgetAllCaptures() {
   // FIXME
 }
 
+void PktCaptureManager::updateCaptureList() {
+  // Must be called with mutex_ held
+  auto captures = std::make_shared<CaptureList>();
+  for (const auto& entry : activeCaptures_) {
+    captures->push_back(entry.second);
+  }
+  capturesRunning_.store(!captures->empty(), std::memory_order_release);
+  captureList_ = std::move(captures);
+  generation_.fetch_add(1, std::memory_order_release);
+}
+
 template<typename Fn>
 void PktCaptureManager::invokeCaptures(const Fn& fn) {
-  std::lock_guard<std::mutex> g(mutex_);
+  auto& local = *localCaptures_;
+  if (local.generation != generation_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> g(mutex_);
+    local.captures = captureList_;
+    local.generation = generation_.load(std::memory_order_relaxed);
+  }
+  if (!local.captures) {
+    return;
+  }
 
-  for (auto it = activeCaptures_.begin();
-       it != activeCaptures_.end();
-       /* increment in loop */) {
-    // Increment the iterator now, in case this capture deactivates itself and
-    // we need to remove it from the active captures.
-    auto thisIt = it;
-    ++it;
-    PktCapture* capture = thisIt->second.get();
+  std::vector<PktCapture*> finished;
+  for (const auto& capture : *local.captures) {
     bool stillActive = false;
     try {
-      stillActive = fn(capture);
+      stillActive = fn(capture.get());
     } catch (const std::exception& ex) {
       LOG(ERROR) << "error when processing packet for capture " <<
         capture->name() << " : " << folly::exceptionStr(ex);
       stillActive = false;
     }
-
     if (!stillActive) {
-      LOG(INFO) << "auto-stopping packet capture \"" <<
-        capture->name() << "\"";
-      try {
-        inactiveCaptures_[capture->name()] = std::move(thisIt->second);
-      } catch (const std::exception& ex) {
-        LOG(ERROR) << "error adding capture " << capture->name() <<
-          " to the inactive list";
-        // Can't do much else here.  Just continue and forget the capture.
-      }
-      activeCaptures_.erase(thisIt);
+      finished.push_back(capture.get());
     }
   }
 
-  bool running = !activeCaptures_.empty();
-  capturesRunning_.store(running, std::memory_order_release);
+  if (!finished.empty()) {
+    deactivateCaptures(finished);
+  }
+}
+
+void PktCaptureManager::deactivateCaptures(
+    const std::vector<PktCapture*>& finished) {
+  std::lock_guard<std::mutex> g(mutex_);
+  bool changed = false;
+  for (auto* capture : finished) {
+    // Other threads may be finishing the same capture, or it may have been
+    // stopped or replaced since this thread copied the capture list.
+    auto it = activeCaptures_.find(capture->name());
+    if (it == activeCaptures_.end() || it->second.get() != capture) {
+      continue;
+    }
+    LOG(INFO) << "auto-stopping packet capture \"" <<
+      capture->name() << "\"";
+    try {
+      inactiveCaptures_[capture->name()] = std::move(it->second);
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "error adding capture " << capture->name() <<
+        " to the inactive list";
+      // Can't do much else here.  Just continue and forget the capture.
+    }
+    activeCaptures_.erase(it);
+    changed = true;
+  }
+  if (changed) {
+    updateCaptureList();
+  }
 }
 
 void PktCaptureManager::packetReceivedImpl(const RxPacket* pkt) {
@@ -10,12 +10,14 @@
 #pragma once
 
 #include <folly/Range.h>
+#include <folly/ThreadLocal.h>
 
 #include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
@@ -37,7 +39,7 @@ class PktCaptureManager {
   void startCapture(std::unique_ptr<PktCapture> capture);
 
   void stopCapture(folly::StringPiece name);
-  std::unique_ptr<PktCapture> forgetCapture(folly::StringPiece name);
+  std::shared_ptr<PktCapture> forgetCapture(folly::StringPiece name);
 
   void stopAllCaptures();
   void forgetAllCaptures();
@@ -98,18 +100,37 @@ class PktCaptureManager {
   PktCaptureManager(PktCaptureManager const &) = delete;
   PktCaptureManager& operator=(PktCaptureManager const &) = delete;
 
+  typedef std::vector<std::shared_ptr<PktCapture>> CaptureList;
+
+  // A packet thread's copy of captureList_
+  struct LocalCaptures {
+    uint64_t generation{0};
+    std::shared_ptr<const CaptureList> captures;
+  };
+
   template<typename Fn>
   void invokeCaptures(const Fn& fn);
+  void deactivateCaptures(const std::vector<PktCapture*>& finished);
+  void updateCaptureList();
   void packetReceivedImpl(const RxPacket* pkt);
   void packetSentImpl(const TxPacket* pkt);
   void packetSentToHostImpl(const RxPacket* pkt);
 
   std::atomic<bool> capturesRunning_{false};
 
+  /*
+   * Packet threads don't lock mutex_ for every packet.  Each keeps its own
+   * reference to the list of active captures, and only locks mutex_ to get
+   * the new list when generation_ changes.
+   */
+  std::atomic<uint64_t> generation_{1};
+  folly::ThreadLocal<LocalCaptures> localCaptures_;
+
   std::mutex mutex_;
   std::string captureDir_;
-  std::map<std::string, std::unique_ptr<PktCapture>> activeCaptures_;
-  std::map<std::string, std::unique_ptr<PktCapture>> inactiveCaptures_;
+  std::shared_ptr<const CaptureList> captureList_;
+  std::map<std::string, std::shared_ptr<PktCapture>> activeCaptures_;
+  std::map<std::string, std::shared_ptr<PktCapture>> inactiveCaptures_;
 };
 
 }} // facebook::fboss
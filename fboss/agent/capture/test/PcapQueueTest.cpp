@@ -31,6 +31,21 @@ void pktWaitThread(PcapQueue* queue, std::vector<PcapPkt>* results) {
   }
 }
 
+std::unique_ptr<MockRxPacket> makePkt(PortID port) {
+  auto pkt = MockRxPacket::fromHex(
+    // dst mac, src mac
+    "02 00 01 00 00 01  02 00 02 01 02 03"
+    // 802.1q, VLAN 1
+    "81 00 00 01"
+    // IPv4
+    "08 00"
+  );
+  pkt->padToLength(68);
+  pkt->setSrcPort(port);
+  pkt->setSrcVlan(VlanID(1));
+  return pkt;
+}
+
 TEST(PcapQueueTest, SimpleAdd) {
   PcapQueue queue(100);
   std::vector<PcapPkt> waitedPkts;
@@ -72,3 +87,68 @@ TEST(PcapQueueTest, SimpleAdd) {
   ByteRange waitedPktData = waitedPktBufClone->coalesce();
   EXPECT_EQ(expectedPktData, waitedPktData);
 }
+
+TEST(PcapQueueTest, MultipleProducers) {
+  // Each producing thread gets its own buffer of this many packets
+  const uint32_t kNumThreads = 4;
+  const uint32_t kPktsPerThread = 1000;
+  PcapQueue queue(kPktsPerThread);
+  std::vector<PcapPkt> waitedPkts;
+  std::thread waiter([&]() { pktWaitThread(&queue, &waitedPkts); });
+
+  std::vector<std::thread> producers;
+  for (uint32_t n = 0; n < kNumThreads; ++n) {
+    producers.emplace_back([&, n]() {
+      auto pkt = makePkt(PortID(n + 1));
+      for (uint32_t idx = 0; idx < kPktsPerThread; ++idx) {
+        queue.addPkt(pkt.get());
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  queue.finish();
+  waiter.join();
+
+  // The reader may have been slow, but every packet is either read or
+  // counted as dropped
+  EXPECT_EQ(kNumThreads * kPktsPerThread,
+            waitedPkts.size() + queue.numDropped());
+  std::vector<uint32_t> perPort(kNumThreads + 1, 0);
+  for (const auto& pkt : waitedPkts) {
+    ASSERT_LE(pkt.port(), kNumThreads);
+    ++perPort[pkt.port()];
+  }
+  for (uint32_t n = 1; n <= kNumThreads; ++n) {
+    EXPECT_GT(perPort[n], 0);
+  }
+
+  // Packets added after finish() are ignored
+  auto pkt = makePkt(PortID(1));
+  queue.addPkt(pkt.get());
+  std::vector<PcapPkt> pkts;
+  EXPECT_FALSE(queue.wait(&pkts));
+}
+
+TEST(PcapQueueTest, Drop) {
+  // With no reader, each thread can only buffer its capacity
+  PcapQueue queue(10);
+  auto pkt = makePkt(PortID(1));
+  for (uint32_t idx = 0; idx < 15; ++idx) {
+    queue.addPkt(pkt.get());
+  }
+  std::thread other([&]() {
+    for (uint32_t idx = 0; idx < 15; ++idx) {
+      queue.addPkt(pkt.get());
+    }
+  });
+  other.join();
+  EXPECT_EQ(10, queue.numDropped());
+
+  queue.finish();
+  std::vector<PcapPkt> pkts;
+  EXPECT_TRUE(queue.wait(&pkts));
+  EXPECT_EQ(20, pkts.size());
+  EXPECT_FALSE(queue.wait(&pkts));
+}
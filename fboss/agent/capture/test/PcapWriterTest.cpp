@@ -11,9 +11,12 @@
 #include "fboss/agent/capture/test/PcapUtil.h"
 #include "fboss/agent/hw/mock/MockRxPacket.h"
 
+#include <folly/Conv.h>
 #include <folly/Exception.h>
 #include <gtest/gtest.h>
 
+#include <fcntl.h>
+
 using namespace facebook::fboss;
 
 void addPackets(PcapWriter* writer, uint32_t count) {
@@ -101,3 +104,110 @@ TEST(PcapWriterTest, Drop) {
     EXPECT_EQ(68, pktInfo.hdr.caplen);
   }
 }
+
+TEST(PcapWriterTest, Rotate) {
+  char tmpPath[] = "fbossPcapTest.XXXXXX";
+  int tmpFD = mkstemp(tmpPath);
+  folly::checkUnixError(tmpFD, "failed to create temporary file");
+  auto rotatedPath = [&](uint32_t n) {
+    return n == 0 ? std::string(tmpPath) : folly::to<std::string>(tmpPath,
+                                                                  ".", n);
+  };
+  PcapWriter writer;
+  SCOPE_EXIT {
+    close(tmpFD);
+    for (uint32_t n = 0; n < writer.numFiles(); ++n) {
+      unlink(rotatedPath(n).c_str());
+    }
+  };
+
+  // A 24 byte file header, then 16 bytes of header for each 68 byte packet.
+  // Ask for a new file every 10 packets.
+  writer.setRotation(24 + 10 * (16 + 68), std::chrono::seconds(0));
+  writer.start(tmpPath, true);
+  addPackets(&writer, 95);
+  writer.finish();
+  EXPECT_EQ(0, writer.numDropped());
+
+  ASSERT_EQ(10, writer.numFiles());
+  size_t total = 0;
+  for (uint32_t n = 0; n < writer.numFiles(); ++n) {
+    auto pcapPkts = readPcapFile(rotatedPath(n).c_str());
+    EXPECT_EQ(n < 9 ? 10 : 5, pcapPkts.size());
+    total += pcapPkts.size();
+  }
+  EXPECT_EQ(95, total);
+}
+
+TEST(PcapWriterTest, RotateMaxFiles) {
+  char tmpPath[] = "fbossPcapTest.XXXXXX";
+  int tmpFD = mkstemp(tmpPath);
+  folly::checkUnixError(tmpFD, "failed to create temporary file");
+  auto rotatedPath = [&](uint32_t n) {
+    return n == 0 ? std::string(tmpPath) : folly::to<std::string>(tmpPath,
+                                                                  ".", n);
+  };
+  PcapWriter writer;
+  SCOPE_EXIT {
+    close(tmpFD);
+    for (uint32_t n = 0; n < writer.numFiles(); ++n) {
+      unlink(rotatedPath(n).c_str());
+    }
+  };
+
+  // A new file every 10 packets as above, keeping the last 3
+  writer.setRotation(24 + 10 * (16 + 68), std::chrono::seconds(0), 3);
+  writer.start(tmpPath, true);
+  addPackets(&writer, 95);
+  writer.finish();
+
+  ASSERT_EQ(10, writer.numFiles());
+  for (uint32_t n = 0; n < 7; ++n) {
+    EXPECT_NE(0, access(rotatedPath(n).c_str(), F_OK)) << rotatedPath(n);
+  }
+  for (uint32_t n = 7; n < 10; ++n) {
+    auto pcapPkts = readPcapFile(rotatedPath(n).c_str());
+    EXPECT_EQ(n < 9 ? 10 : 5, pcapPkts.size());
+  }
+}
+
+TEST(PcapWriterTest, RemoveStaleFiles) {
+  char tmpPath[] = "fbossPcapTest.XXXXXX";
+  int tmpFD = mkstemp(tmpPath);
+  folly::checkUnixError(tmpFD, "failed to create temporary file");
+  auto otherPath = [&](folly::StringPiece suffix) {
+    return folly::to<std::string>(tmpPath, ".", suffix);
+  };
+  SCOPE_EXIT {
+    close(tmpFD);
+    unlink(tmpPath);
+    for (auto suffix : {"1", "12", "keep"}) {
+      unlink(otherPath(suffix).c_str());
+    }
+  };
+  // Left over from an earlier, rotated capture
+  for (auto suffix : {"1", "12", "keep"}) {
+    int fd = open(otherPath(suffix).c_str(), O_CREAT | O_WRONLY, 0644);
+    folly::checkUnixError(fd, "failed to create ", otherPath(suffix));
+    close(fd);
+  }
+
+  {
+    // Without overwriteExisting the file must not exist yet
+    unlink(tmpPath);
+    PcapWriter writer(tmpPath, false);
+    writer.finish();
+  }
+  // Nothing is removed unless the capture overwrites
+  EXPECT_EQ(0, access(otherPath("1").c_str(), F_OK));
+
+  PcapWriter writer(tmpPath, true);
+  addPackets(&writer, 5);
+  writer.finish();
+  EXPECT_EQ(1, writer.numFiles());
+  EXPECT_EQ(5, readPcapFile(tmpPath).size());
+  EXPECT_NE(0, access(otherPath("1").c_str(), F_OK));
+  EXPECT_NE(0, access(otherPath("12").c_str(), F_OK));
+  // Not a rotated file
+  EXPECT_EQ(0, access(otherPath("keep").c_str(), F_OK));
+}
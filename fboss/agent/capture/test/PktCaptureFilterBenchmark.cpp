@@ -0,0 +1,129 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/IPAddress.h>
+#include <folly/Memory.h>
+#include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/capture/PktCaptureFilter.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+
+using namespace facebook::fboss;
+using facebook::network::toBinaryAddress;
+using folly::IPAddress;
+using std::unique_ptr;
+
+/*
+ * The cost of PktCaptureFilter::matches(), which runs for every packet
+ * punted to the CPU while a capture is active.
+ */
+
+namespace {
+
+// Global state used by the benchmarks
+unique_ptr<MockRxPacket> bgpPkt;
+unique_ptr<MockRxPacket> ndpPkt;
+
+IpPrefix makePrefix(const char* ip, int16_t length) {
+  IpPrefix prefix;
+  prefix.ip = toBinaryAddress(IPAddress(ip));
+  prefix.prefixLength = length;
+  return prefix;
+}
+
+void init() {
+  bgpPkt = MockRxPacket::fromHex(
+      // dst mac, src mac, 802.1q VLAN 1, IPv6
+      "02 00 01 00 00 01  02 00 02 01 02 03  81 00 00 01  86 dd"
+      // IPv6, payload length 20, TCP, hop limit 64
+      "60 00 00 00  00 14  06  40"
+      // Source and destination
+      "24 01 db 00 00 00 00 00  00 00 00 00 00 00 00 01"
+      "24 01 db 00 00 00 00 00  00 00 00 00 00 00 00 02"
+      // Source port 40000, destination port 179
+      "9c 40  00 b3  00 00 00 00  00 00 00 00  50 02 ff ff  00 00 00 00"
+      );
+  bgpPkt->setSrcPort(PortID(1));
+  bgpPkt->setSrcVlan(VlanID(1));
+
+  ndpPkt = MockRxPacket::fromHex(
+      // dst mac, src mac, 802.1q VLAN 1, IPv6
+      "33 33 ff 00 00 01  02 00 02 01 02 03  81 00 00 01  86 dd"
+      // IPv6, payload length 32, ICMPv6, hop limit 255
+      "60 00 00 00  00 20  3a  ff"
+      // Source and destination
+      "fe 80 00 00 00 00 00 00  02 02 00 ff fe 01 02 03"
+      "ff 02 00 00 00 00 00 00  00 00 00 01 ff 00 00 01"
+      // Neighbor solicitation
+      "87 00 00 00  00 00 00 00"
+      );
+  ndpPkt->padToLength(86);
+  ndpPkt->setSrcPort(PortID(1));
+  ndpPkt->setSrcVlan(VlanID(1));
+}
+
+CaptureFilter bgpFilter() {
+  CaptureFilter config;
+  config.ports = {1, 2, 3, 4};
+  config.prefixes = {makePrefix("2401:db00::", 64),
+                     makePrefix("10.0.0.0", 8)};
+  config.ipProtocols = {6};
+  config.l4Ports = {179};
+  return config;
+}
+
+void matchPackets(const PktCaptureFilter& filter, const RxPacket* pkt,
+                  size_t numIters) {
+  size_t matched = 0;
+  for (size_t n = 0; n < numIters; ++n) {
+    matched += filter.matches(pkt);
+  }
+  folly::doNotOptimizeAway(matched);
+}
+
+} // unnamed namespace
+
+BENCHMARK(MatchAll, numIters) {
+  PktCaptureFilter filter;
+  matchPackets(filter, bgpPkt.get(), numIters);
+}
+
+BENCHMARK_RELATIVE(PortOnly, numIters) {
+  unique_ptr<PktCaptureFilter> filter;
+  BENCHMARK_SUSPEND {
+    CaptureFilter config;
+    config.ports = {1, 2, 3, 4};
+    filter = folly::make_unique<PktCaptureFilter>(config);
+  }
+  matchPackets(*filter, bgpPkt.get(), numIters);
+}
+
+BENCHMARK_RELATIVE(BgpMatch, numIters) {
+  unique_ptr<PktCaptureFilter> filter;
+  BENCHMARK_SUSPEND {
+    filter = folly::make_unique<PktCaptureFilter>(bgpFilter());
+  }
+  matchPackets(*filter, bgpPkt.get(), numIters);
+}
+
+BENCHMARK_RELATIVE(BgpMiss, numIters) {
+  unique_ptr<PktCaptureFilter> filter;
+  BENCHMARK_SUSPEND {
+    filter = folly::make_unique<PktCaptureFilter>(bgpFilter());
+  }
+  // Rejected on the prefix, the most expensive test
+  matchPackets(*filter, ndpPkt.get(), numIters);
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  init();
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,272 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/capture/PktCaptureFilter.h"
+
+#include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/hw/mock/MockTxPacket.h"
+
+#include <folly/IPAddress.h>
+#include <folly/Memory.h>
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using facebook::network::toBinaryAddress;
+using folly::IPAddress;
+using std::unique_ptr;
+
+namespace {
+
+// A tagged TCP packet on VLAN 1, from 10.0.0.1:179 to 10.1.0.2:40000
+const char* kTcpV4 =
+  // dst mac, src mac
+  "02 00 01 00 00 01  02 00 02 01 02 03"
+  // 802.1q, VLAN 1
+  "81 00 00 01"
+  // IPv4
+  "08 00"
+  // Version(4), IHL(5), DSCP(0), ECN(0), Total Length(40)
+  "45  00  00 28"
+  // Identification(0), Flags(0), Fragment offset(0)
+  "00 00  00 00"
+  // TTL(31), Protocol(6), Checksum (0, fake)
+  "1F  06  00 00"
+  // Source IP (10.0.0.1)
+  "0a 00 00 01"
+  // Destination IP (10.1.0.2)
+  "0a 01 00 02"
+  // Source port(179), destination port(40000)
+  "00 b3  9c 40"
+  // Rest of the TCP header
+  "00 00 00 00  00 00 00 00  50 02 ff ff  00 00 00 00";
+
+// An untagged UDP packet from 2401:db00::1:53 to 2401:db00:1::2:5353
+const char* kUdpV6 =
+  // dst mac, src mac
+  "02 00 01 00 00 01  02 00 02 01 02 03"
+  // IPv6
+  "86 dd"
+  // Version(6), payload length(8), next header(17), hop limit(64)
+  "60 00 00 00  00 08  11  40"
+  // Source IP
+  "24 01 db 00 00 00 00 00  00 00 00 00 00 00 00 01"
+  // Destination IP
+  "24 01 db 00 00 01 00 00  00 00 00 00 00 00 00 02"
+  // Source port(53), destination port(5353), length(8), checksum(0)
+  "00 35  14 e9  00 08  00 00";
+
+// An untagged ARP request
+const char* kArp =
+  // dst mac, src mac
+  "ff ff ff ff ff ff  02 00 02 01 02 03"
+  // ARP
+  "08 06"
+  // Ethernet, IPv4, sizes, request
+  "00 01  08 00  06  04  00 01"
+  // Sender and target addresses
+  "02 00 02 01 02 03  0a 00 00 01"
+  "00 00 00 00 00 00  0a 00 00 02";
+
+unique_ptr<MockRxPacket> makeRx(const char* hex, int port = 1,
+                                int vlan = 1) {
+  auto pkt = MockRxPacket::fromHex(hex);
+  pkt->setSrcPort(PortID(port));
+  pkt->setSrcVlan(VlanID(vlan));
+  return pkt;
+}
+
+unique_ptr<MockTxPacket> makeTx(const char* hex) {
+  auto rx = MockRxPacket::fromHex(hex);
+  auto length = rx->buf()->length();
+  auto pkt = folly::make_unique<MockTxPacket>(length);
+  memcpy(pkt->buf()->writableData(), rx->buf()->data(), length);
+  return pkt;
+}
+
+IpPrefix makePrefix(const char* ip, int16_t length) {
+  IpPrefix prefix;
+  prefix.ip = toBinaryAddress(IPAddress(ip));
+  prefix.prefixLength = length;
+  return prefix;
+}
+
+} // unnamed namespace
+
+TEST(PktCaptureFilterTest, Empty) {
+  PktCaptureFilter filter{CaptureFilter()};
+  EXPECT_TRUE(filter.matchesAll());
+  EXPECT_TRUE(filter.matches(makeRx(kTcpV4).get()));
+  EXPECT_TRUE(filter.matches(makeTx(kArp).get()));
+  EXPECT_TRUE(PktCaptureFilter().matchesAll());
+}
+
+TEST(PktCaptureFilterTest, Direction) {
+  CaptureFilter config;
+  config.direction = CaptureDirection::CAPTURE_ONLY_RX;
+  PktCaptureFilter rxOnly(config);
+  EXPECT_FALSE(rxOnly.matchesAll());
+  EXPECT_TRUE(rxOnly.matches(makeRx(kTcpV4).get()));
+  EXPECT_FALSE(rxOnly.matches(makeTx(kTcpV4).get()));
+
+  config.direction = CaptureDirection::CAPTURE_ONLY_TX;
+  PktCaptureFilter txOnly(config);
+  EXPECT_FALSE(txOnly.matches(makeRx(kTcpV4).get()));
+  EXPECT_TRUE(txOnly.matches(makeTx(kTcpV4).get()));
+}
+
+TEST(PktCaptureFilterTest, Ports) {
+  CaptureFilter config;
+  config.ports = {2, 5};
+  PktCaptureFilter filter(config);
+  EXPECT_FALSE(filter.matches(makeRx(kTcpV4, 1).get()));
+  EXPECT_TRUE(filter.matches(makeRx(kTcpV4, 2).get()));
+  EXPECT_TRUE(filter.matches(makeRx(kArp, 5).get()));
+  // Sent packets aren't tested on ports
+  EXPECT_TRUE(filter.matches(makeTx(kArp).get()));
+}
+
+TEST(PktCaptureFilterTest, Vlans) {
+  CaptureFilter config;
+  config.vlans = {1};
+  PktCaptureFilter filter(config);
+  // The 802.1q tag wins over the VLAN the packet was received on
+  EXPECT_TRUE(filter.matches(makeRx(kTcpV4, 1, 7).get()));
+  EXPECT_TRUE(filter.matches(makeTx(kTcpV4).get()));
+  // Untagged packets use the receive VLAN
+  EXPECT_TRUE(filter.matches(makeRx(kArp, 1, 1).get()));
+  EXPECT_FALSE(filter.matches(makeRx(kArp, 1, 7).get()));
+  // and sent untagged packets have no VLAN
+  EXPECT_FALSE(filter.matches(makeTx(kArp).get()));
+}
+
+TEST(PktCaptureFilterTest, Ethertypes) {
+  CaptureFilter config;
+  config.ethertypes = {0x0806, 0x86dd};
+  PktCaptureFilter filter(config);
+  EXPECT_TRUE(filter.matches(makeRx(kArp).get()));
+  EXPECT_TRUE(filter.matches(makeRx(kUdpV6).get()));
+  // The ethertype after the 802.1q tag is the one tested
+  EXPECT_FALSE(filter.matches(makeRx(kTcpV4).get()));
+}
+
+TEST(PktCaptureFilterTest, Prefixes) {
+  CaptureFilter config;
+  config.prefixes = {makePrefix("10.1.0.0", 16),
+                     makePrefix("2401:db00::", 32)};
+  PktCaptureFilter either(config);
+  EXPECT_TRUE(either.matches(makeRx(kTcpV4).get()));
+  EXPECT_TRUE(either.matches(makeRx(kUdpV6).get()));
+  EXPECT_FALSE(either.matches(makeRx(kArp).get()));
+
+  config.prefixes.clear();
+  config.srcPrefixes = {makePrefix("10.1.0.0", 16),
+                        makePrefix("2401:db00::", 64)};
+  PktCaptureFilter src(config);
+  EXPECT_FALSE(src.matches(makeRx(kTcpV4).get()));
+  EXPECT_TRUE(src.matches(makeRx(kUdpV6).get()));
+
+  config.srcPrefixes.clear();
+  config.dstPrefixes = {makePrefix("10.1.0.2", 32),
+                        makePrefix("2401:db00::", 64)};
+  PktCaptureFilter dst(config);
+  EXPECT_TRUE(dst.matches(makeRx(kTcpV4).get()));
+  EXPECT_FALSE(dst.matches(makeRx(kUdpV6).get()));
+
+  config.dstPrefixes = {makePrefix("2401:db00:1::2", 128)};
+  PktCaptureFilter host(config);
+  EXPECT_FALSE(host.matches(makeRx(kTcpV4).get()));
+  EXPECT_TRUE(host.matches(makeRx(kUdpV6).get()));
+}
+
+TEST(PktCaptureFilterTest, L4) {
+  CaptureFilter config;
+  config.ipProtocols = {6};
+  PktCaptureFilter tcp(config);
+  EXPECT_TRUE(tcp.matches(makeRx(kTcpV4).get()));
+  EXPECT_FALSE(tcp.matches(makeRx(kUdpV6).get()));
+  EXPECT_FALSE(tcp.matches(makeRx(kArp).get()));
+
+  config.ipProtocols.clear();
+  config.l4Ports = {179, 5353};
+  PktCaptureFilter ports(config);
+  EXPECT_TRUE(ports.matches(makeRx(kTcpV4).get()));
+  EXPECT_TRUE(ports.matches(makeRx(kUdpV6).get()));
+
+  config.l4Ports = {40000};
+  config.ipProtocols = {17};
+  PktCaptureFilter both(config);
+  EXPECT_FALSE(both.matches(makeRx(kTcpV4).get()));
+  EXPECT_FALSE(both.matches(makeRx(kUdpV6).get()));
+  config.ipProtocols = {6, 17};
+  EXPECT_TRUE(PktCaptureFilter(config).matches(makeRx(kTcpV4).get()));
+}
+
+TEST(PktCaptureFilterTest, Combined) {
+  // BGP sessions to 10.0.0.0/24 on port 1
+  CaptureFilter config;
+  config.ports = {1};
+  config.prefixes = {makePrefix("10.0.0.0", 24)};
+  config.ipProtocols = {6};
+  config.l4Ports = {179};
+  PktCaptureFilter filter(config);
+  EXPECT_TRUE(filter.matches(makeRx(kTcpV4, 1).get()));
+  EXPECT_FALSE(filter.matches(makeRx(kTcpV4, 2).get()));
+  EXPECT_FALSE(filter.matches(makeRx(kUdpV6, 1).get()));
+  EXPECT_FALSE(filter.matches(makeRx(kArp, 1).get()));
+}
+
+TEST(PktCaptureFilterTest, Truncated) {
+  CaptureFilter config;
+  config.l4Ports = {179};
+  PktCaptureFilter filter(config);
+  // Ethernet and IPv4 headers, but no TCP header
+  auto pkt = MockRxPacket::fromHex(
+    "02 00 01 00 00 01  02 00 02 01 02 03  08 00"
+    "45 00 00 14  00 00 00 00  1F 06 00 00  0a 00 00 01  0a 01 00 02");
+  EXPECT_FALSE(filter.matches(pkt.get()));
+  auto runt = MockRxPacket::fromHex("02 00 01 00 00 01");
+  EXPECT_FALSE(filter.matches(runt.get()));
+}
+
+TEST(PktCaptureFilterTest, Invalid) {
+  CaptureFilter config;
+  config.vlans = {4096};
+  EXPECT_THROW(PktCaptureFilter{config}, FbossError);
+
+  config = CaptureFilter();
+  config.ports = {-1};
+  EXPECT_THROW(PktCaptureFilter{config}, FbossError);
+
+  config = CaptureFilter();
+  config.ethertypes = {0x10000};
+  EXPECT_THROW(PktCaptureFilter{config}, FbossError);
+
+  config = CaptureFilter();
+  config.ipProtocols = {256};
+  EXPECT_THROW(PktCaptureFilter{config}, FbossError);
+
+  config = CaptureFilter();
+  config.l4Ports = {65536};
+  EXPECT_THROW(PktCaptureFilter{config}, FbossError);
+
+  config = CaptureFilter();
+  config.prefixes = {makePrefix("10.0.0.0", 33)};
+  EXPECT_THROW(PktCaptureFilter{config}, FbossError);
+
+  config = CaptureFilter();
+  config.dstPrefixes = {makePrefix("2401:db00::", 129)};
+  EXPECT_THROW(PktCaptureFilter{config}, FbossError);
+
+  config = CaptureFilter();
+  config.direction = static_cast<CaptureDirection>(7);
+  EXPECT_THROW(PktCaptureFilter{config}, FbossError);
+}
@@ -236,12 +236,16 @@ void BcmEcmpEgress::program() {
           << n_path << " paths";
   }
   CHECK_NE(id_, INVALID);
+  hw_->writableHostTable()->ecmpEgressProgrammed(this);
 }
 
 BcmEcmpEgress::~BcmEcmpEgress() {
   if (id_ == INVALID) {
     return;
   }
+  // Make sure link down handling is done with this group, and won't touch
+  // it again, before it goes away
+  hw_->writableHostTable()->ecmpEgressDestroyed(this);
   opennsl_l3_egress_ecmp_t obj;
   opennsl_l3_egress_ecmp_t_init(&obj);
   obj.ecmp_intf = id_;
@@ -9,6 +9,8 @@
  */
 #include "BcmHost.h"
 
+#include <folly/Hash.h>
+
 #include "fboss/agent/Constants.h"
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/hw/bcm/BcmError.h"
@@ -212,6 +214,18 @@ BcmEcmpHost::~BcmEcmpHost() {
   }
 }
 
+BcmHostTable::EcmpKey::EcmpKey(opennsl_vrf_t vrf,
+                               const RouteForwardNexthops& fwd)
+    : std::pair<opennsl_vrf_t, RouteForwardNexthops>(vrf, fwd),
+      hash(folly::hash::hash_combine(
+          vrf, folly::hash::hash_range(fwd.begin(), fwd.end(), fwd.size(),
+                                       RouteForwardInfo::NexthopHash()))) {
+}
+
+size_t BcmHostTable::HostKeyHash::operator()(const Key& key) const {
+  return folly::hash::hash_combine(key.first, key.second);
+}
+
 BcmHostTable::BcmHostTable(const BcmSwitch *hw) : hw_(hw) {
   auto port2EgressIds = std::make_shared<PortAndEgressIdsMap>();
   port2EgressIds->publish();
@@ -219,6 +233,9 @@ BcmHostTable::BcmHostTable(const BcmSwitch *hw) : hw_(hw) {
 }
 
 BcmHostTable::~BcmHostTable() {
+  // Hosts update the port -> egress mappings as they go away, and those are
+  // declared after the hosts, so release the hosts while they are all here
+  releaseHosts();
 }
 
 template<typename KeyT, typename HostT, typename... Args>
@@ -252,7 +269,7 @@ BcmHost* BcmHostTable::incRefOrCreateBcmHost(
 
 BcmEcmpHost* BcmHostTable::incRefOrCreateBcmEcmpHost(
     opennsl_vrf_t vrf, const RouteForwardNexthops& fwd) {
-  return incRefOrCreateBcmHost(&ecmpHosts_, std::make_pair(vrf, fwd));
+  return incRefOrCreateBcmHost(&ecmpHosts_, EcmpKey(vrf, fwd));
 }
 
 template<typename KeyT, typename HostT, typename... Args>
@@ -385,6 +402,19 @@ void BcmHostTable::updatePortEgressMapping(opennsl_if_t egressId,
   // Publish and replace with the updated mapping
   newMapping->publish();
   setPort2EgressIdsInternal(newMapping);
+  // Move the egress ID's ECMP memberships over to the new port
+  auto ecmps = egressId2Ecmps_.find(egressId);
+  if (ecmps != egressId2Ecmps_.end() && oldPort != newPort) {
+    std::lock_guard<std::mutex> g(ecmpMembersLock_);
+    for (auto ecmp : ecmps->second) {
+      if (oldPort) {
+        removeEcmpMember(oldPort, ecmp, egressId);
+      }
+      if (newPort) {
+        addEcmpMember(newPort, ecmp, egressId);
+      }
+    }
+  }
   // Note that we notify the ecmp group of the paths whenever we get
   // to this point with a nonzero port to associate with an egress
   // mapping. This handles the case where we hit the ecmp shrink code
@@ -516,6 +546,71 @@ folly::dynamic BcmHostTable::toFollyDynamic() const {
   return hostTable;
 }
 
+void BcmHostTable::ecmpEgressProgrammed(BcmEcmpEgress* ecmp) {
+  std::lock_guard<std::mutex> g(ecmpMembersLock_);
+  for (auto path : ecmp->paths()) {
+    egressId2Ecmps_[path].insert(ecmp);
+    auto port = egressIdPort(path);
+    if (port) {
+      addEcmpMember(port, ecmp, path);
+    }
+  }
+}
+
+void BcmHostTable::ecmpEgressDestroyed(BcmEcmpEgress* ecmp) {
+  std::lock_guard<std::mutex> g(ecmpMembersLock_);
+  for (auto path : ecmp->paths()) {
+    auto ecmps = egressId2Ecmps_.find(path);
+    CHECK(ecmps != egressId2Ecmps_.end());
+    ecmps->second.erase(ecmp);
+    if (ecmps->second.empty()) {
+      egressId2Ecmps_.erase(ecmps);
+    }
+    auto port = egressIdPort(path);
+    if (port) {
+      removeEcmpMember(port, ecmp, path);
+    }
+  }
+}
+
+void BcmHostTable::addEcmpMember(opennsl_port_t port, BcmEcmpEgress* ecmp,
+    opennsl_if_t egressId) {
+  ecmpMembersByPort_[port].emplace(ecmp, egressId);
+}
+
+void BcmHostTable::removeEcmpMember(opennsl_port_t port, BcmEcmpEgress* ecmp,
+    opennsl_if_t egressId) {
+  auto members = ecmpMembersByPort_.find(port);
+  CHECK(members != ecmpMembersByPort_.end());
+  members->second.erase(std::make_pair(ecmp, egressId));
+  if (members->second.empty()) {
+    ecmpMembersByPort_.erase(members);
+  }
+}
+
+void BcmHostTable::linkDownHwNotLocked(opennsl_port_t port) {
+  {
+    std::lock_guard<std::mutex> g(ecmpMembersLock_);
+    auto members = ecmpMembersByPort_.find(port);
+    if (members != ecmpMembersByPort_.end()) {
+      for (const auto& member : members->second) {
+        member.first->pathUnreachableHwNotLocked(member.second);
+      }
+    }
+  }
+  // ECMP groups left from before a warm boot aren't indexed, they are only
+  // known to the warm boot cache until the FIB sync takes them over
+  if (hw_->getWarmBootCache()->ecmp2EgressIds().empty()) {
+    return;
+  }
+  auto portAndEgressIds = getPortAndEgressIdsMap()->getPortAndEgressIdsIf(
+      port);
+  if (portAndEgressIds) {
+    warmBootEcmpResolutionChanged(portAndEgressIds->getEgressIds(),
+        false /*down*/, false /*not locked*/);
+  }
+}
+
 void BcmHostTable::linkStateChangedMaybeLocked(opennsl_port_t port, bool up,
     bool locked) {
   auto portAndEgressIdMapping = getPortAndEgressIdsMap();
@@ -530,27 +625,27 @@ void BcmHostTable::linkStateChangedMaybeLocked(opennsl_port_t port, bool up,
 
 void BcmHostTable::egressResolutionChangedMaybeLocked(
     const Paths& affectedPaths, bool up, bool locked) {
-  for (const auto& nextHopsAndEcmpHostInfo : ecmpHosts_) {
-    auto ecmpId = nextHopsAndEcmpHostInfo.second.first->getEcmpEgressId();
-    if (ecmpId == BcmEgressBase::INVALID) {
+  for (auto path : affectedPaths) {
+    auto ecmps = egressId2Ecmps_.find(path);
+    if (ecmps == egressId2Ecmps_.end()) {
       continue;
     }
-    auto ecmpEgress = static_cast<BcmEcmpEgress*>(getEgressObjectIf(ecmpId));
-    // Must find the egress object, we could have done a slower
-    // dynamic cast check to ensure that this is the right type
-    // our map should be pointing to valid Ecmp egress object for
-    // a ecmp egress Id anyways
-    CHECK(ecmpEgress);
-    for (auto path: affectedPaths) {
+    for (auto ecmpEgress : ecmps->second) {
       if (up) {
         CHECK(locked);
         ecmpEgress->pathReachableHwLocked(path);
+      } else if (locked) {
+        ecmpEgress->pathUnreachableHwLocked(path);
       } else {
-        auto updated = locked ? ecmpEgress->pathUnreachableHwLocked(path) :
-          ecmpEgress->pathUnreachableHwNotLocked(path);
+        ecmpEgress->pathUnreachableHwNotLocked(path);
       }
     }
   }
+  warmBootEcmpResolutionChanged(affectedPaths, up, locked);
+}
+
+void BcmHostTable::warmBootEcmpResolutionChanged(
+    const Paths& affectedPaths, bool up, bool locked) {
   /*
    * We may not have done a FIB sync before ports start coming
    * up or ARP/NDP start getting resolved/unresolved. In this case
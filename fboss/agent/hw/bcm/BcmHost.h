@@ -24,8 +24,9 @@ extern "C" {
 #include "fboss/agent/state/RouteForwardInfo.h"
 #include "fboss/agent/state/NeighborEntry.h"
 
-#include <boost/container/flat_map.hpp>
 #include <boost/container/flat_set.hpp>
+#include <mutex>
+#include <unordered_map>
 
 namespace facebook { namespace fboss {
 
@@ -195,16 +196,15 @@ class BcmHostTable {
 
   /*
    * Port down handling
-   * Look up egress entries going over this port and
-   * then remove these from ecmp entries.
+   * Remove the members going over this port from every
+   * ECMP group that has them, in one pass over the groups
+   * indexed under the port.
    * This is called from the linkscan callback and
    * we don't acquire BcmSwitch::lock_ here. See note above
    * declaration of BcmSwitch::linkStateChangedHwNotLocked which
    * explains why we can't hold this lock here.
    */
-  void linkDownHwNotLocked(opennsl_port_t port) {
-    linkStateChangedMaybeLocked(port, false /*down*/, false /*not locked*/);
-  }
+  void linkDownHwNotLocked(opennsl_port_t port);
   void linkDownHwLocked(opennsl_port_t port) {
     // Just call the non locked counterpart here.
     // We don't really need the lock for link down
@@ -223,6 +223,14 @@ class BcmHostTable {
    */
   void updatePortEgressMapping(opennsl_if_t egressId, opennsl_port_t oldPort,
       opennsl_port_t newPort);
+  /*
+   * Keep track of which ECMP groups go over which ports, so that link down
+   * handling finds the groups to prune without looking at all of them.
+   * Called by BcmEcmpEgress once it is programmed, and before it is
+   * destroyed.
+   */
+  void ecmpEgressProgrammed(BcmEcmpEgress* ecmp);
+  void ecmpEgressDestroyed(BcmEcmpEgress* ecmp);
   /*
    * Get port -> egressIds map
    */
@@ -258,19 +266,73 @@ class BcmHostTable {
       bool locked);
   void egressResolutionChangedMaybeLocked(const Paths& affectedPaths, bool up,
       bool locked);
+  void warmBootEcmpResolutionChanged(const Paths& affectedPaths, bool up,
+      bool locked);
+  // Both need ecmpMembersLock_ held
+  void addEcmpMember(opennsl_port_t port, BcmEcmpEgress* ecmp,
+      opennsl_if_t egressId);
+  void removeEcmpMember(opennsl_port_t port, BcmEcmpEgress* ecmp,
+      opennsl_if_t egressId);
   void setPort2EgressIdsInternal(std::shared_ptr<PortAndEgressIdsMap> newMap);
   const BcmSwitch* hw_;
 
+  typedef std::pair<opennsl_vrf_t, folly::IPAddress> Key;
+  /*
+   * The key of an ECMP host carries the hash of its nexthops, computed once
+   * when the key is built.  Hashing a set of nexthops is much more expensive
+   * than hashing a host address, and this way it is neither redone when the
+   * table grows nor needed to tell most unequal keys apart.
+   */
+  struct EcmpKey : public std::pair<opennsl_vrf_t, RouteForwardNexthops> {
+    EcmpKey(opennsl_vrf_t vrf, const RouteForwardNexthops& fwd);
+    bool operator==(const EcmpKey& other) const {
+      return hash == other.hash && first == other.first &&
+        second == other.second;
+    }
+    size_t hash;
+  };
+  struct HostKeyHash {
+    size_t operator()(const Key& key) const;
+    size_t operator()(const EcmpKey& key) const {
+      return key.hash;
+    }
+  };
+
+  // A cold boot creates every host and egress one at a time, which would
+  // make a sorted vector quadratic in the number of entries.
   template<typename KeyT, typename HostT>
-  using HostMap = boost::container::flat_map<
-    KeyT, std::pair<std::unique_ptr<HostT>, uint32_t>>;
+  using HostMap = std::unordered_map<
+    KeyT, std::pair<std::unique_ptr<HostT>, uint32_t>, HostKeyHash>;
 
-  boost::container::flat_map<opennsl_if_t,
+  /*
+   * port -> (ECMP group, member) for every member of every ECMP group that
+   * goes over the port, and egress ID -> the ECMP groups it is a member of.
+   * Kept up to date as ECMP groups come and go and as egress objects move
+   * between ports.
+   *
+   * Link down handling prunes the groups while holding ecmpMembersLock_,
+   * and a group takes itself out of here before it is destroyed, so the
+   * linkscan thread never sees a group that is gone.  The lock is never
+   * held while programming anything else, so taking it in the linkscan
+   * thread can't deadlock with the SDK the way BcmSwitch::lock_ could.
+   *
+   * Declared before egressMap_, along with egressId2Port_ which an ECMP
+   * egress reads to find its members' ports, so that both outlive the ECMP
+   * egress objects.
+   */
+  using EcmpMembers =
+    boost::container::flat_set<std::pair<BcmEcmpEgress*, opennsl_if_t>>;
+  std::unordered_map<opennsl_port_t, EcmpMembers> ecmpMembersByPort_;
+  std::unordered_map<opennsl_if_t,
+    boost::container::flat_set<BcmEcmpEgress*>> egressId2Ecmps_;
+  std::mutex ecmpMembersLock_;
+  // egressId -> port
+  std::unordered_map<opennsl_if_t, opennsl_port_t> egressId2Port_;
+
+  std::unordered_map<opennsl_if_t,
     std::pair<std::unique_ptr<BcmEgressBase>, uint32_t>> egressMap_;
 
-  typedef std::pair<opennsl_vrf_t, folly::IPAddress> Key;
   HostMap<Key, BcmHost> hosts_;
-  typedef std::pair<opennsl_vrf_t, RouteForwardNexthops> EcmpKey;
   HostMap<EcmpKey, BcmEcmpHost> ecmpHosts_;
 
   template<typename KeyT, typename HostT, typename... Args>
@@ -295,8 +357,6 @@ class BcmHostTable {
    */
   std::shared_ptr<PortAndEgressIdsMap> portAndEgressIdsDontUseDirectly_;
   mutable folly::SpinLock portAndEgressIdsLock_;
-  // egressId -> port
-  boost::container::flat_map<opennsl_if_t, opennsl_port_t> egressId2Port_;
 };
 
 }}
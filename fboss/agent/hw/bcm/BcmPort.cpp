@@ -9,6 +9,7 @@
  */
 #include "fboss/agent/hw/bcm/BcmPort.h"
 
+#include <array>
 #include <cstdlib>
 #include <cstring>
 
@@ -39,6 +40,21 @@ using std::shared_ptr;
 
 namespace facebook { namespace fboss {
 
+static const std::vector<opennsl_stat_val_t> kTrafficStats = {
+  opennsl_spl_snmpIfHCInOctets,
+  opennsl_spl_snmpIfHCInUcastPkts,
+  opennsl_spl_snmpIfHCInMulticastPkts,
+  opennsl_spl_snmpIfHCInBroadcastPkts,
+  opennsl_spl_snmpIfInDiscards,
+  opennsl_spl_snmpIfInErrors,
+  opennsl_spl_snmpIfHCOutOctets,
+  opennsl_spl_snmpIfHCOutUcastPkts,
+  opennsl_spl_snmpIfHCOutMulticastPkts,
+  opennsl_spl_snmpIfHCOutBroadcastPckts,
+  opennsl_spl_snmpIfOutDiscards,
+  opennsl_spl_snmpIfOutErrors,
+};
+static const size_t kNumPktLengthBuckets = 10;
 static const std::vector<opennsl_stat_val_t> kInPktLengthStats = {
   snmpOpenNSLReceivedPkts64Octets,
   snmpOpenNSLReceivedPkts65to127Octets,
@@ -63,6 +79,13 @@ static const std::vector<opennsl_stat_val_t> kOutPktLengthStats = {
   snmpOpenNSLTransmittedPkts4095to9216Octets,
   snmpOpenNSLTransmittedPkts9217to16383Octets,
 };
+// Both of the above, to read with one call
+static const std::vector<opennsl_stat_val_t> kPktLengthStats = [] {
+  auto stats = kInPktLengthStats;
+  stats.insert(stats.end(), kOutPktLengthStats.begin(),
+               kOutPktLengthStats.end());
+  return stats;
+}();
 
 BcmPort::BcmPort(BcmSwitch* hw, opennsl_port_t port,
                  BcmPlatformPort* platformPort)
@@ -82,7 +105,7 @@ BcmPort::BcmPort(BcmSwitch* hw, opennsl_port_t port,
   outQueueLen_ = statMap->getLockAndStatItem(statName("out_queue_length"),
                                              &expType);
   auto histMap = fbData->getHistogramMap();
-  stats::ExportedHistogram pktLenHist(1, 0, kInPktLengthStats.size());
+  stats::ExportedHistogram pktLenHist(1, 0, kNumPktLengthBuckets);
   inPktLengths_ = histMap->getOrCreateUnlocked(statName("in_pkt_lengths"),
                                                &pktLenHist);
   outPktLengths_ = histMap->getOrCreateUnlocked(statName("out_pkt_lengths"),
@@ -382,86 +405,99 @@ std::string BcmPort::statName(folly::StringPiece name) const {
   return folly::to<string>("port", platformPort_->getPortID(), ".", name);
 }
 
-void BcmPort::updateStats() {
+void BcmPort::updateStats(StatClass statClass) {
   // TODO: It would be nicer to use a monotonic clock, but unfortunately
   // the ServiceData code currently expects everyone to use system time.
   auto now = duration_cast<seconds>(system_clock::now().time_since_epoch());
 
-  updateStat(now, &inBytes_, opennsl_spl_snmpIfHCInOctets);
-  updateStat(now, &inUnicastPkts_, opennsl_spl_snmpIfHCInUcastPkts);
-  updateStat(now, &inMulticastPkts_, opennsl_spl_snmpIfHCInMulticastPkts);
-  updateStat(now, &inBroadcastPkts_, opennsl_spl_snmpIfHCInBroadcastPkts);
-  updateStat(now, &inDiscards_, opennsl_spl_snmpIfInDiscards);
-  updateStat(now, &inErrors_, opennsl_spl_snmpIfInErrors);
+  switch (statClass) {
+    case StatClass::TRAFFIC:
+      updateTrafficStats(now);
+      setAdditionalStats(now);
+      break;
+    case StatClass::PKT_LENGTHS:
+      updatePktLenStats(now);
+      break;
+    case StatClass::QUEUE_LENGTH:
+      updateQueueLength(now);
+      break;
+  }
+}
+
+void BcmPort::updateTrafficStats(std::chrono::seconds now) {
+  std::array<uint64_t, NUM_TRAFFIC_STATS> values;
+  if (!getStats(kTrafficStats, values.data())) {
+    return;
+  }
+
+  MonotonicCounter* monotonicCounters[] = {
+    &inBytes_, &inUnicastPkts_, &inMulticastPkts_, &inBroadcastPkts_,
+    &inDiscards_, &inErrors_,
+    &outBytes_, &outUnicastPkts_, &outMulticastPkts_, &outBroadcastPkts_,
+    &outDiscards_, &outErrors_,
+  };
+  static_assert(sizeof(monotonicCounters) / sizeof(monotonicCounters[0]) ==
+                NUM_TRAFFIC_STATS, "a traffic stat is missing its counter");
+  for (int idx = 0; idx < NUM_TRAFFIC_STATS; ++idx) {
+    monotonicCounters[idx]->updateValue(now, values[idx]);
+  }
+}
 
-  updateStat(now, &outBytes_, opennsl_spl_snmpIfHCOutOctets);
-  updateStat(now, &outUnicastPkts_, opennsl_spl_snmpIfHCOutUcastPkts);
-  updateStat(now, &outMulticastPkts_, opennsl_spl_snmpIfHCOutMulticastPkts);
-  updateStat(now, &outBroadcastPkts_, opennsl_spl_snmpIfHCOutBroadcastPckts);
-  updateStat(now, &outDiscards_, opennsl_spl_snmpIfOutDiscards);
-  updateStat(now, &outErrors_, opennsl_spl_snmpIfOutErrors);
+void BcmPort::updatePktLenStats(std::chrono::seconds now) {
+  std::array<uint64_t, 2 * kNumPktLengthBuckets> counters;
+  DCHECK_EQ(counters.size(), kPktLengthStats.size());
+  if (!getStats(kPktLengthStats, counters.data())) {
+    return;
+  }
 
-  setAdditionalStats(now);
+  // Update the histograms
+  {
+    SpinLockHolder guard(inPktLengths_.first.get());
+    for (size_t idx = 0; idx < kNumPktLengthBuckets; ++idx) {
+      inPktLengths_.second->addValue(now, idx, counters[idx]);
+    }
+  }
+  SpinLockHolder guard(outPktLengths_.first.get());
+  for (size_t idx = 0; idx < kNumPktLengthBuckets; ++idx) {
+    outPktLengths_.second->addValue(
+        now, idx, counters[kNumPktLengthBuckets + idx]);
+  }
+}
 
-  // Update the queue length stat
+void BcmPort::updateQueueLength(std::chrono::seconds now) {
   uint32_t qlength;
   auto ret = opennsl_port_queued_count_get(unit_, port_, &qlength);
   if (OPENNSL_FAILURE(ret)) {
     LOG(ERROR) << "Failed to get queue length for port " << port_
                << " :" << opennsl_errmsg(ret);
-  } else {
-    SpinLockHolder guard(outQueueLen_.first.get());
-    outQueueLen_.second->addValue(now, qlength);
-    // TODO: outQueueLen_ only exports the average queue length over the last
-    // 60 seconds, 10 minutes, etc.
-    // We should also export the current value.  We could use a simple counter
-    // or a dynamic counter for this.
+    return;
   }
+  SpinLockHolder guard(outQueueLen_.first.get());
+  outQueueLen_.second->addValue(now, qlength);
+  // TODO: outQueueLen_ only exports the average queue length over the last
+  // 60 seconds, 10 minutes, etc.
+  // We should also export the current value.  We could use a simple counter
+  // or a dynamic counter for this.
+}
 
-  // Update the packet length histograms
-  updatePktLenHist(now, &inPktLengths_, kInPktLengthStats);
-  updatePktLenHist(now, &outPktLengths_, kOutPktLengthStats);
-};
-
-void BcmPort::updateStat(std::chrono::seconds now,
-                         stats::MonotonicCounter* stat,
-                         opennsl_stat_val_t type) {
+bool BcmPort::getStats(const std::vector<opennsl_stat_val_t>& stats,
+                       uint64_t* values) {
   // Use the non-sync API to just get the values accumulated in software.
   // The Broadom SDK's counter thread syncs the HW counters to software every
   // 500000us (defined in config.bcm).
-  uint64_t value;
-  auto ret = opennsl_stat_get(unit_, port_, type, &value);
-  if (OPENNSL_FAILURE(ret)) {
-    LOG(ERROR) << "Failed to get stat " << type << " for port " << port_
-               << " :" << opennsl_errmsg(ret);
-    return;
-  }
-  stat->updateValue(now, value);
-}
-
-void BcmPort::updatePktLenHist(
-    std::chrono::seconds now,
-    stats::ExportedHistogramMap::LockAndHistogram* hist,
-    const std::vector<opennsl_stat_val_t>& stats) {
-  // Get the counter values
-  uint64_t counters[10];
+  //
   // opennsl_stat_multi_get() unfortunately doesn't correctly const qualify
   // it's stats arguments right now.
   opennsl_stat_val_t* statsArg =
       const_cast<opennsl_stat_val_t*>(&stats.front());
   auto ret = opennsl_stat_multi_get(unit_, port_,
-                                stats.size(), statsArg, counters);
+                                stats.size(), statsArg, values);
   if (OPENNSL_FAILURE(ret)) {
-    LOG(ERROR) << "Failed to get packet length stats for port " << port_
-               << " :" << opennsl_errmsg(ret);
-    return;
-  }
-
-  // Update the histogram
-  SpinLockHolder guard(hist->first.get());
-  for (int idx = 0; idx < stats.size(); ++idx) {
-    hist->second->addValue(now, idx, counters[idx]);
+    LOG(ERROR) << "Failed to get " << stats.size() << " stats for port "
+               << port_ << " :" << opennsl_errmsg(ret);
+    return false;
   }
+  return true;
 }
 
 cfg::PortState BcmPort::getState() {
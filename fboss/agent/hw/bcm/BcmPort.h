@@ -20,7 +20,9 @@ extern "C" {
 #include "fboss/agent/types.h"
 #include "fboss/agent/gen-cpp/switch_config_types.h"
 
+#include <chrono>
 #include <mutex>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
@@ -35,6 +37,34 @@ class Port;
  */
 class BcmPort {
  public:
+  /*
+   * The classes of port statistics, each polled on its own interval.
+   */
+  enum class StatClass {
+    TRAFFIC,          // byte, packet, discard and error counters
+    PKT_LENGTHS,      // the packet length histograms
+    QUEUE_LENGTH,
+  };
+
+  /*
+   * The traffic counters, in the order they are read in one multi-get.
+   */
+  enum TrafficStat {
+    IN_BYTES,
+    IN_UNICAST_PKTS,
+    IN_MULTICAST_PKTS,
+    IN_BROADCAST_PKTS,
+    IN_DISCARDS,
+    IN_ERRORS,
+    OUT_BYTES,
+    OUT_UNICAST_PKTS,
+    OUT_MULTICAST_PKTS,
+    OUT_BROADCAST_PKTS,
+    OUT_DISCARDS,
+    OUT_ERRORS,
+    NUM_TRAFFIC_STATS
+  };
+
   /*
    * Construct the BcmPort object.
    *
@@ -93,9 +123,12 @@ class BcmPort {
   void setSpeed(const std::shared_ptr<Port>& swPort);
 
   /*
-   * Update this port's statistics.
+   * Update one class of this port's statistics.
+   *
+   * Only one thread may update a port's statistics, which is the
+   * BcmPortStatsCollector thread once it is running.
    */
-  void updateStats();
+  void updateStats(StatClass statClass);
 
   /**
    * Get the state of the port. If there is an error in finding the port state,
@@ -129,12 +162,12 @@ class BcmPort {
   BcmPort(BcmPort const &) = delete;
   BcmPort& operator=(BcmPort const &) = delete;
 
-  void updateStat(std::chrono::seconds now,
-                  stats::MonotonicCounter* stat,
-                  opennsl_stat_val_t type);
-  void updatePktLenHist(std::chrono::seconds now,
-                        stats::ExportedHistogramMap::LockAndHistogram* hist,
-                        const std::vector<opennsl_stat_val_t>& stats);
+  void updateTrafficStats(std::chrono::seconds now);
+  void updatePktLenStats(std::chrono::seconds now);
+  void updateQueueLength(std::chrono::seconds now);
+  // Read stats with a single opennsl_stat_multi_get() call
+  bool getStats(const std::vector<opennsl_stat_val_t>& stats,
+                uint64_t* values);
   std::string statName(folly::StringPiece name) const;
 
   void disablePause();
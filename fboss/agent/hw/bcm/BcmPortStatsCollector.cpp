@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmPortStatsCollector.h"
+
+#include "fboss/agent/hw/bcm/BcmPortTable.h"
+#include "fboss/agent/hw/bcm/BcmStats.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <chrono>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+DEFINE_int32(port_traffic_stats_interval_ms, 1000,
+             "How often to collect the port byte, packet, discard and error "
+             "counters");
+DEFINE_int32(port_pkt_length_stats_interval_ms, 1000,
+             "How often to collect the port packet length histograms");
+DEFINE_int32(port_queue_length_stats_interval_ms, 1000,
+             "How often to collect the port output queue lengths");
+
+namespace facebook { namespace fboss {
+
+BcmPortStatsCollector::BcmPortStatsCollector(BcmPortTable* portTable)
+  : portTable_(portTable) {
+  scheduler_.setThreadName("PortStatsThread");
+  addClass(BcmPort::StatClass::TRAFFIC,
+           FLAGS_port_traffic_stats_interval_ms, "portTrafficStats");
+  addClass(BcmPort::StatClass::PKT_LENGTHS,
+           FLAGS_port_pkt_length_stats_interval_ms, "portPktLengthStats");
+  addClass(BcmPort::StatClass::QUEUE_LENGTH,
+           FLAGS_port_queue_length_stats_interval_ms, "portQueueLengthStats");
+}
+
+BcmPortStatsCollector::~BcmPortStatsCollector() {
+  stop();
+}
+
+void BcmPortStatsCollector::addClass(BcmPort::StatClass statClass,
+                                     int intervalMs,
+                                     const std::string& name) {
+  if (intervalMs <= 0) {
+    VLOG(1) << "Not collecting " << name;
+    return;
+  }
+  scheduler_.addFunction([this, statClass] { collect(statClass); },
+                         milliseconds(intervalMs), name);
+}
+
+void BcmPortStatsCollector::start() {
+  if (running_) {
+    return;
+  }
+  scheduler_.start();
+  running_ = true;
+}
+
+void BcmPortStatsCollector::stop() {
+  if (!running_) {
+    return;
+  }
+  scheduler_.shutdown();
+  running_ = false;
+}
+
+void BcmPortStatsCollector::collect(BcmPort::StatClass statClass) {
+  auto begin = steady_clock::now();
+  portTable_->updatePortStats(statClass);
+  auto us = duration_cast<microseconds>(steady_clock::now() - begin).count();
+  switch (statClass) {
+    case BcmPort::StatClass::TRAFFIC:
+      BcmStats::get()->portTrafficStatsCollected(us);
+      break;
+    case BcmPort::StatClass::PKT_LENGTHS:
+      BcmStats::get()->portPktLengthStatsCollected(us);
+      break;
+    case BcmPort::StatClass::QUEUE_LENGTH:
+      BcmStats::get()->portQueueLengthCollected(us);
+      break;
+  }
+}
+
+}} // facebook::fboss
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/hw/bcm/BcmPort.h"
+
+#include <folly/experimental/FunctionScheduler.h>
+
+namespace facebook { namespace fboss {
+
+class BcmPortTable;
+
+/**
+ * BcmPortStatsCollector polls the port statistics on a thread of its own,
+ * so that a slow pass over the ports doesn't delay the rest of the agent's
+ * stats.  Each class of stats is polled on its own interval, but all of
+ * them share the one thread: a slow pass over one class pushes back the
+ * others that come due during it.  The time each class takes is exported
+ * separately, as bcm.port_stats.<class>.collect_us.
+ *
+ * The values read go straight into each port's MonotonicCounters, which
+ * take a spin lock on every sample and compute the rates at export time.
+ * Readers (fb303, and thrift through fillPortStats()) only see the counters
+ * through ServiceData, so there is no lock-free snapshot of them here.  A
+ * double-buffered one was tried, but had no reader and was removed.
+ */
+class BcmPortStatsCollector {
+ public:
+  explicit BcmPortStatsCollector(BcmPortTable* portTable);
+  ~BcmPortStatsCollector();
+
+  void start();
+  void stop();
+
+  /*
+   * Collect one class of stats from all of the ports, in the calling thread.
+   *
+   * This must not be called while the collector is running.
+   */
+  void collect(BcmPort::StatClass statClass);
+
+ private:
+  // no copy or assignment
+  BcmPortStatsCollector(BcmPortStatsCollector const &) = delete;
+  BcmPortStatsCollector& operator=(BcmPortStatsCollector const &) = delete;
+
+  void addClass(BcmPort::StatClass statClass, int intervalMs,
+                const std::string& name);
+
+  BcmPortTable* const portTable_{nullptr};
+  folly::FunctionScheduler scheduler_;
+  bool running_{false};
+};
+
+}} // facebook::fboss
@@ -110,11 +110,13 @@ void BcmPortTable::setPortStatus(opennsl_port_t id, int status) {
   port->setPortStatus(status);
 }
 
-void BcmPortTable::updatePortStats() {
- for (const auto& entry : bcmPhysicalPorts_) {
-   BcmPort* bcmPort = entry.second.get();
-   bcmPort->updateStats();
- }
+void BcmPortTable::updatePortStats(BcmPort::StatClass statClass) {
+  // In port number order, so that the ports of a port group are read one
+  // after the other
+  for (const auto& entry : bcmPhysicalPorts_) {
+    BcmPort* bcmPort = entry.second.get();
+    bcmPort->updateStats(statClass);
+  }
 }
 
 }} // namespace facebook::fboss
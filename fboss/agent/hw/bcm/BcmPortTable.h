@@ -62,9 +62,9 @@ class BcmPortTable {
   void setPortStatus(opennsl_port_t id, int status);
 
   /*
-   * Update all ports' statistics.
+   * Update one class of statistics for all of the ports.
    */
-  void updatePortStats();
+  void updatePortStats(BcmPort::StatClass statClass);
 
   bool portExists(PortID port) const {
     return getBcmPortIf(port) != nullptr;
@@ -13,6 +13,7 @@ extern "C" {
 #include <opennsl/l3.h>
 }
 
+#include <folly/Hash.h>
 #include <folly/IPAddress.h>
 #include <folly/IPAddressV4.h>
 #include <folly/IPAddressV6.h>
@@ -66,19 +67,23 @@ bool BcmRoute::canUseHostTable() const {
 }
 
 void BcmRoute::program(const RouteForwardInfo& fwd) {
+  if (!resolve(fwd)) {
+    return;
+  }
+  SCOPE_FAIL {
+    release();
+  };
+  write();
+}
+
+bool BcmRoute::resolve(const RouteForwardInfo& fwd) {
+  CHECK(!resolved_);
   // if the route has been programmed to the HW, check if the forward info is
   // changed or not. If not, nothing to do.
   if (added_ && fwd == fwd_) {
-    return;
+    return false;
   }
 
-  // function to clean up the host reference
-  auto cleanupHost = [&] (const RouteForwardNexthops& nhopsClean) noexcept {
-    if (nhopsClean.size()) {
-      hw_->writableHostTable()->derefBcmEcmpHost(vrf_, nhopsClean);
-    }
-  };
-
   auto action = fwd.getAction();
   // find out the egress object ID
   opennsl_if_t egressId;
@@ -95,14 +100,28 @@ void BcmRoute::program(const RouteForwardInfo& fwd) {
         vrf_, nhops);
     egressId = host->getEgressId();
   }
+  resolvedFwd_ = fwd;
+  resolvedEgressId_ = egressId;
+  resolved_ = true;
+  return true;
+}
+
+void BcmRoute::release() {
+  CHECK(resolved_);
+  const auto& nhops = resolvedFwd_.getNexthops();
+  if (nhops.size()) {
+    hw_->writableHostTable()->derefBcmEcmpHost(vrf_, nhops);
+  }
+  resolvedFwd_ = RouteForwardInfo();
+  resolved_ = false;
+}
 
+void BcmRoute::write() {
+  CHECK(resolved_);
   // At this point host and egress objects for next hops have been
   // created, what remains to be done is to program route into the
   // route table or host table (if this is a host route and use of
   // host table for host routes is allowed by the chip).
-  SCOPE_FAIL {
-    cleanupHost(fwd.getNexthops());
-  };
   if (canUseHostTable()) {
     if (added_) {
       // Delete the already existing host table entry, because we cannot change
@@ -118,7 +137,7 @@ void BcmRoute::program(const RouteForwardInfo& fwd) {
         warmBootCache->findHostRouteFromRouteTable(vrf_, prefix_);
     bool entryExistsInRouteTable =
         vrfAndIP2RouteCitr != warmBootCache->vrfAndIP2Route_end();
-    programHostRoute(egressId, fwd, entryExistsInRouteTable);
+    programHostRoute(resolvedEgressId_, resolvedFwd_, entryExistsInRouteTable);
     if (entryExistsInRouteTable) {
       // If the entry already exists in the route table, programHostRoute()
       // removes it as well.
@@ -126,13 +145,18 @@ void BcmRoute::program(const RouteForwardInfo& fwd) {
       warmBootCache->programmed(vrfAndIP2RouteCitr);
     }
   } else {
-    programLpmRoute(egressId, fwd);
+    programLpmRoute(resolvedEgressId_, resolvedFwd_);
   }
   if (added_) {
     // the route was added before, need to free the old nexthop(s)
-    cleanupHost(fwd_.getNexthops());
+    const auto& nhops = fwd_.getNexthops();
+    if (nhops.size()) {
+      hw_->writableHostTable()->derefBcmEcmpHost(vrf_, nhops);
+    }
   }
-  fwd_ = fwd;
+  fwd_ = std::move(resolvedFwd_);
+  resolvedFwd_ = RouteForwardInfo();
+  resolved_ = false;
   // new nexthop has been stored in fwd_. From now on, it is up to
   // ~BcmRoute() to clean up such nexthop.
   added_ = true;
@@ -227,6 +251,9 @@ bool BcmRoute::deleteLpmRoute(int unitNumber,
 }
 
 BcmRoute::~BcmRoute() {
+  if (resolved_) {
+    release();
+  }
   if (!added_) {
     return;
   }
@@ -246,18 +273,12 @@ BcmRoute::~BcmRoute() {
   }
 }
 
-bool BcmRouteTable::Key::operator<(const Key& k2) const {
-  if (vrf < k2.vrf) {
-    return true;
-  } else if (vrf > k2.vrf) {
-    return false;
-  }
-  if (mask < k2.mask) {
-    return true;
-  } else if (mask > k2.mask) {
-    return false;
-  }
-  return network < k2.network;
+bool BcmRouteTable::Key::operator==(const Key& k2) const {
+  return vrf == k2.vrf && mask == k2.mask && network == k2.network;
+}
+
+size_t BcmRouteTable::KeyHash::operator()(const Key& k) const {
+  return folly::hash::hash_combine(k.vrf, k.mask, k.network);
 }
 
 BcmRouteTable::BcmRouteTable(const BcmSwitch* hw) : hw_(hw) {
@@ -286,20 +307,51 @@ BcmRoute* BcmRouteTable::getBcmRoute(
   return rt;
 }
 
-template<typename RouteT>
-void BcmRouteTable::addRoute(opennsl_vrf_t vrf, const RouteT *route) {
-  const auto& prefix = route->prefix();
-  Key key{folly::IPAddress(prefix.network), prefix.mask, vrf};
+BcmRoute* BcmRouteTable::getOrCreateBcmRoute(
+    opennsl_vrf_t vrf, const folly::IPAddress& network, uint8_t mask) {
+  Key key{network, mask, vrf};
   auto ret = fib_.emplace(key, nullptr);
   if (ret.second) {
     SCOPE_FAIL {
       fib_.erase(ret.first);
     };
-    ret.first->second.reset(new BcmRoute(hw_, vrf,
-                                        folly::IPAddress(prefix.network),
-                                        prefix.mask));
+    ret.first->second.reset(new BcmRoute(hw_, vrf, network, mask));
+  }
+  return ret.first->second.get();
+}
+
+template<typename RouteT>
+void BcmRouteTable::addRoute(opennsl_vrf_t vrf, const RouteT *route) {
+  const auto& prefix = route->prefix();
+  auto bcmRoute = getOrCreateBcmRoute(
+      vrf, folly::IPAddress(prefix.network), prefix.mask);
+  bcmRoute->program(route->getForwardInfo());
+}
+
+template<typename RouteT>
+void BcmRouteTable::addRoutes(
+    opennsl_vrf_t vrf, const std::vector<std::shared_ptr<RouteT>>& routes) {
+  std::vector<BcmRoute*> resolved;
+  resolved.reserve(routes.size());
+  size_t written = 0;
+  // Whatever was resolved but not written must give its egress objects back
+  SCOPE_FAIL {
+    for (auto i = written; i < resolved.size(); ++i) {
+      resolved[i]->release();
+    }
+  };
+  for (const auto& route : routes) {
+    const auto& prefix = route->prefix();
+    auto bcmRoute = getOrCreateBcmRoute(
+        vrf, folly::IPAddress(prefix.network), prefix.mask);
+    if (bcmRoute->resolve(route->getForwardInfo())) {
+      resolved.push_back(bcmRoute);
+    }
+  }
+  for (auto bcmRoute : resolved) {
+    bcmRoute->write();
+    ++written;
   }
-  ret.first->second->program(route->getForwardInfo());
 }
 
 template<typename RouteT>
@@ -315,6 +367,10 @@ void BcmRouteTable::deleteRoute(opennsl_vrf_t vrf, const RouteT *route) {
 
 template void BcmRouteTable::addRoute(opennsl_vrf_t, const RouteV4 *);
 template void BcmRouteTable::addRoute(opennsl_vrf_t, const RouteV6 *);
+template void BcmRouteTable::addRoutes(
+    opennsl_vrf_t, const std::vector<std::shared_ptr<RouteV4>>&);
+template void BcmRouteTable::addRoutes(
+    opennsl_vrf_t, const std::vector<std::shared_ptr<RouteV6>>&);
 template void BcmRouteTable::deleteRoute(opennsl_vrf_t, const RouteV4 *);
 template void BcmRouteTable::deleteRoute(opennsl_vrf_t, const RouteV6 *);
 
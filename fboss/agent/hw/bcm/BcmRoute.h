@@ -18,7 +18,9 @@ extern "C" {
 #include "fboss/agent/types.h"
 #include "fboss/agent/state/RouteForwardInfo.h"
 
-#include <boost/container/flat_map.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
@@ -34,6 +36,21 @@ class BcmRoute {
            const folly::IPAddress& addr, uint8_t len);
   ~BcmRoute();
   void program(const RouteForwardInfo& fwd);
+
+  /*
+   * program() in two steps, so that a batch of routes can have the egress
+   * objects for all of its nexthops created before any route is written.
+   *
+   * resolve() takes a reference to the egress object for fwd, creating it
+   * if needed.  It returns false, and does nothing, if the route is already
+   * programmed with fwd.  After it returns true, either write() programs the
+   * route and drops the reference to the old egress object, or release()
+   * drops the new one.  A failed write() leaves the route resolved.
+   */
+  bool resolve(const RouteForwardInfo& fwd);
+  void write();
+  void release();
+
   static bool deleteLpmRoute(int unit,
                              opennsl_vrf_t vrf,
                              const folly::IPAddress& prefix,
@@ -63,6 +80,10 @@ class BcmRoute {
   uint8_t len_;
   RouteForwardInfo fwd_;
   bool added_{false};           // if the route added to HW or not
+  // what resolve() found for the route, until write() or release()
+  RouteForwardInfo resolvedFwd_;
+  opennsl_if_t resolvedEgressId_{0};
+  bool resolved_{false};
   void initL3RouteT(opennsl_l3_route_t* rt) const;
 };
 
@@ -83,6 +104,14 @@ class BcmRouteTable {
    */
   template<typename RouteT>
   void addRoute(opennsl_vrf_t vrf, const RouteT *route);
+  /*
+   * Add or change a batch of routes in one VRF.  The egress and ECMP objects
+   * for all of the routes are looked up or created first, and the routes are
+   * then written back to back.
+   */
+  template<typename RouteT>
+  void addRoutes(opennsl_vrf_t vrf,
+                 const std::vector<std::shared_ptr<RouteT>>& routes);
   template<typename RouteT>
   void deleteRoute(opennsl_vrf_t vrf, const RouteT *route);
  private:
@@ -90,10 +119,18 @@ class BcmRouteTable {
     folly::IPAddress network;
     uint8_t mask;
     opennsl_vrf_t vrf;
-    bool operator<(const Key& k2) const;
+    bool operator==(const Key& k2) const;
   };
+  struct KeyHash {
+    size_t operator()(const Key& k) const;
+  };
+  BcmRoute* getOrCreateBcmRoute(opennsl_vrf_t vrf,
+                                const folly::IPAddress& network, uint8_t mask);
+
   const BcmSwitch *hw_;
-  boost::container::flat_map<Key, std::unique_ptr<BcmRoute>> fib_;
+  // Hashed rather than sorted, so that programming a full table from scratch
+  // does not shift the entries already there on every insert.
+  std::unordered_map<Key, std::unique_ptr<BcmRoute>, KeyHash> fib_;
 };
 
 }}
@@ -37,7 +37,15 @@ BcmStats::BcmStats(ThreadLocalStatsMap *map)
       txPktAllocErrors_(map, SwitchStats::kCounterPrefix +
           "bcm.tx.pkt.allocation.errors", SUM, RATE),
       txQueued_(map, SwitchStats::kCounterPrefix + "bcm.tx.pkt.queued_us",
-                100, 0, 1000) {
+                100, 0, 1000),
+      linkDownEcmpPrune_(map, SwitchStats::kCounterPrefix +
+          "bcm.link_down.ecmp_prune_us", 1000, 0, 100000),
+      portTrafficStatsCollect_(map, SwitchStats::kCounterPrefix +
+          "bcm.port_stats.traffic.collect_us", 1000, 0, 100000),
+      portPktLengthStatsCollect_(map, SwitchStats::kCounterPrefix +
+          "bcm.port_stats.pkt_lengths.collect_us", 1000, 0, 100000),
+      portQueueLengthCollect_(map, SwitchStats::kCounterPrefix +
+          "bcm.port_stats.queue_length.collect_us", 1000, 0, 100000) {
 }
 
 BcmStats* BcmStats::createThreadStats() {
@@ -52,6 +52,18 @@ class BcmStats {
     txErrors_.addValue(1);
     txPktAllocErrors_.addValue(1);
   }
+  void linkDownEcmpPruned(uint64_t us) {
+    linkDownEcmpPrune_.addValue(us);
+  }
+  void portTrafficStatsCollected(uint64_t us) {
+    portTrafficStatsCollect_.addValue(us);
+  }
+  void portPktLengthStatsCollected(uint64_t us) {
+    portPktLengthStatsCollect_.addValue(us);
+  }
+  void portQueueLengthCollected(uint64_t us) {
+    portQueueLengthCollect_.addValue(us);
+  }
 
  private:
   // Forbidden copy constructor and assignment operator
@@ -80,6 +92,15 @@ class BcmStats {
   // Time spent for each Tx packet queued in HW
   TLHistogram txQueued_;
 
+  // Time from a link down event to the last ECMP group going over the
+  // port being pruned
+  TLHistogram linkDownEcmpPrune_;
+
+  // Time to collect each class of stats from all of the ports
+  TLHistogram portTrafficStatsCollect_;
+  TLHistogram portPktLengthStatsCollect_;
+  TLHistogram portQueueLengthCollect_;
+
   static folly::ThreadLocalPtr<BcmStats> stats_;
 };
 
@@ -12,6 +12,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <ctime>
+#include <thread>
+#include <vector>
 
 #include <boost/cast.hpp>
 
@@ -31,10 +33,12 @@
 #include "fboss/agent/hw/bcm/BcmPlatform.h"
 #include "fboss/agent/hw/bcm/BcmPort.h"
 #include "fboss/agent/hw/bcm/BcmPortGroup.h"
+#include "fboss/agent/hw/bcm/BcmPortStatsCollector.h"
 #include "fboss/agent/hw/bcm/BcmPortTable.h"
 #include "fboss/agent/hw/bcm/BcmHost.h"
 #include "fboss/agent/hw/bcm/BcmRoute.h"
 #include "fboss/agent/hw/bcm/BcmRxPacket.h"
+#include "fboss/agent/hw/bcm/BcmStats.h"
 #include "fboss/agent/hw/bcm/BcmSwitchEventManager.h"
 #include "fboss/agent/hw/bcm/BcmSwitchEventCallback.h"
 #include "fboss/agent/hw/bcm/BcmTxPacket.h"
@@ -89,6 +93,11 @@ DEFINE_int32(linkscan_interval_us, 250000,
              "The Broadcom linkscan interval");
 DEFINE_bool(flexports, false,
             "Load the agent with flexport support enabled");
+DEFINE_int32(route_batch_size, 4096,
+             "The number of routes programmed in one batch.  The switch lock "
+             "is released between batches, so that a large route update "
+             "does not hold off everything else that needs it.  0 programs "
+             "each route table in one batch");
 
 enum : uint8_t {
   kRxCallbackPriority = 1,
@@ -173,6 +182,7 @@ unique_ptr<BcmUnit> BcmSwitch::releaseUnit() {
   // Destroy all of our member variables that track state,
   // to make sure they clean up their state now before we reset unit_.
   switchEventManager_.reset();
+  portStatsCollector_.reset();
   warmBootCache_.reset();
   routeTable_.reset();
   // Release host entries before reseting switch's host table
@@ -335,8 +345,11 @@ folly::dynamic BcmSwitch::gracefulExit() {
   // SwSwitch, but it does not really matter at the graceful exit time. If
   // this is a concern, this can be moved to the updateEventBase_ of SwSwitch.
   portTable_->preparePortsForGracefulExit();
+  // Stop reading from the unit before it is detached
+  portStatsCollector_->stop();
 
-  std::lock_guard<std::mutex> g(lock_);
+  std::unique_lock<std::mutex> g(lock_);
+  waitForDelta(&g);
   folly::dynamic hwSwitch = toFollyDynamic();
   unitObject_->detach();
   unitObject_.reset();
@@ -352,7 +365,9 @@ folly::dynamic BcmSwitch::toFollyDynamic() const {
 }
 
 void BcmSwitch::clearWarmBootCache() {
-  std::lock_guard<std::mutex> g(lock_);
+  std::unique_lock<std::mutex> g(lock_);
+  // Entries still in the cache may be claimed by the rest of the delta
+  waitForDelta(&g);
   warmBootCache_->clear();
 }
 
@@ -410,7 +425,7 @@ std::shared_ptr<SwitchState> BcmSwitch::getWarmBootSwitchState() const {
 HwInitResult BcmSwitch::init(Callback* callback) {
   HwInitResult ret;
 
-  std::lock_guard<std::mutex> g(lock_);
+  std::unique_lock<std::mutex> g(lock_);
 
   // Create unitObject_ before doing anything else.
   if (!unitObject_) {
@@ -512,6 +527,7 @@ HwInitResult BcmSwitch::init(Callback* callback) {
   toCPUEgress_->programToCPU();
 
   portTable_->initPorts(&pcfg, warmBoot);
+  portStatsCollector_ = make_unique<BcmPortStatsCollector>(portTable_.get());
 
   bcmCheckError(rv, "failed to set linkscan ports");
   rv = opennsl_linkscan_register(unit_, linkscanCallback);
@@ -536,7 +552,8 @@ HwInitResult BcmSwitch::init(Callback* callback) {
 
   if (warmBoot) {
     auto warmBootState = getWarmBootSwitchState();
-    stateChangedImpl(StateDelta(make_shared<SwitchState>(), warmBootState));
+    stateChangedImpl(StateDelta(make_shared<SwitchState>(), warmBootState),
+                     &g);
     hostTable_->warmBootHostEntriesSynced();
     ret.switchState = warmBootState;
   } else {
@@ -569,26 +586,36 @@ void BcmSwitch::initialConfigApplied() {
     rv = opennsl_rx_start(unit_, nullptr);
   }
   bcmCheckError(rv, "failed to start broadcom packet rx API");
+
+  portStatsCollector_->start();
 }
 
 void BcmSwitch::stateChanged(const StateDelta& delta) {
   // Take the lock before modifying any objects
-  std::lock_guard<std::mutex> g(lock_);
-  stateChangedImpl(delta);
+  std::unique_lock<std::mutex> g(lock_);
+  stateChangedImpl(delta, &g);
 }
 
-void BcmSwitch::stateChangedImpl(const StateDelta& delta) {
+void BcmSwitch::stateChangedImpl(const StateDelta& delta,
+                                 std::unique_lock<std::mutex>* lock) {
   // TODO: This function contains high-level logic for how to apply the
   // StateDelta, and isn't particularly hardware-specific.  I plan to refactor
   // it, and move it out into a common helper class that can be shared by
   // many different HwSwitch implementations.
 
+  // The route batches give up the lock, see waitForDelta()
+  deltaInProgress_ = true;
+  SCOPE_EXIT {
+    deltaInProgress_ = false;
+    deltaDone_.notify_all();
+  };
+
   // As the first step, disable ports that are now disabled.
   // This ensures that we immediately stop forwarding traffic on these ports.
   processDisabledPorts(delta);
 
   // remove all routes to be deleted
-  processRemovedRoutes(delta);
+  processRemovedRoutes(delta, lock);
 
   // delete all interface not existing anymore. that should stop
   // all traffic on that interface now
@@ -634,7 +661,7 @@ void BcmSwitch::stateChangedImpl(const StateDelta& delta) {
   processAclChanges(delta);
 
   // Process any new routes or route changes
-  processAddedChangedRoutes(delta);
+  processAddedChangedRoutes(delta, lock);
 
   // Reconfigure port groups in case we are changing between using a port as
   // 1, 2 or 4 ports. Only do this if flexports are enabled
@@ -966,33 +993,6 @@ void BcmSwitch::processArpChanges(const StateDelta& delta) {
   }
 }
 
-template <typename RouteT>
-void BcmSwitch::processChangedRoute(const RouterID id,
-                                    const shared_ptr<RouteT>& oldRoute,
-                                    const shared_ptr<RouteT>& newRoute) {
-  VLOG(3) << "changing to route entry @ vrf " << id << " from old: "
-    << oldRoute->str() << "to new: " << newRoute->str();
-  // if the new route is not resolved, delete it instead of changing it
-  if (!newRoute->isResolved()) {
-    VLOG(1) << "Non-resolved route HW programming is skipped";
-    processRemovedRoute(id, oldRoute);
-  } else {
-    routeTable_->addRoute(getBcmVrfId(id), newRoute.get());
-  }
-}
-
-template <typename RouteT>
-void BcmSwitch::processAddedRoute(const RouterID id,
-                                  const shared_ptr<RouteT>& route) {
-  VLOG(3) << "adding route entry @ vrf " << id << " " << route->str();
-  // if the new route is not resolved, ignore it
-  if (!route->isResolved()) {
-    VLOG(1) << "Non-resolved route HW programming is skipped";
-    return;
-  }
-  routeTable_->addRoute(getBcmVrfId(id), route.get());
-}
-
 template <typename RouteT>
 void BcmSwitch::processRemovedRoute(const RouterID id,
                                     const shared_ptr<RouteT>& route) {
@@ -1004,47 +1004,104 @@ void BcmSwitch::processRemovedRoute(const RouterID id,
   routeTable_->deleteRoute(getBcmVrfId(id), route.get());
 }
 
-void BcmSwitch::processRemovedRoutes(const StateDelta& delta) {
+void BcmSwitch::waitForDelta(std::unique_lock<std::mutex>* lock) {
+  deltaDone_.wait(*lock, [this] { return !deltaInProgress_; });
+}
+
+bool BcmSwitch::routeBatchDone(uint32_t numRoutes) const {
+  return FLAGS_route_batch_size > 0 &&
+    numRoutes >= static_cast<uint32_t>(FLAGS_route_batch_size);
+}
+
+void BcmSwitch::yieldLock(std::unique_lock<std::mutex>* lock) {
+  // Whoever takes the lock now sees the routes of the delta only partly
+  // programmed.  That is fine for the readers (neighbor hit polling, stats),
+  // while clearWarmBootCache() and gracefulExit() wait for the delta to
+  // finish.
+  lock->unlock();
+  std::this_thread::yield();
+  lock->lock();
+}
+
+template <typename RibDeltaT>
+void BcmSwitch::processRemovedRoutes(const RouterID id,
+                                     const RibDeltaT& ribDelta,
+                                     std::unique_lock<std::mutex>* lock) {
+  uint32_t numRoutes = 0;
+  for (const auto& routeDelta : ribDelta) {
+    const auto& oldRoute = routeDelta.getOld();
+    if (!oldRoute || routeDelta.getNew()) {
+      continue;
+    }
+    processRemovedRoute(id, oldRoute);
+    if (routeBatchDone(++numRoutes)) {
+      yieldLock(lock);
+      numRoutes = 0;
+    }
+  }
+}
+
+template <typename RouteT, typename RibDeltaT>
+void BcmSwitch::processAddedChangedRoutes(const RouterID id,
+                                          const RibDeltaT& ribDelta,
+                                          std::unique_lock<std::mutex>* lock) {
+  auto vrf = getBcmVrfId(id);
+  std::vector<shared_ptr<RouteT>> batch;
+  if (FLAGS_route_batch_size > 0) {
+    batch.reserve(FLAGS_route_batch_size);
+  }
+  for (const auto& routeDelta : ribDelta) {
+    const auto& newRoute = routeDelta.getNew();
+    if (!newRoute) {
+      // Removed routes are taken care of by processRemovedRoutes()
+      continue;
+    }
+    const auto& oldRoute = routeDelta.getOld();
+    VLOG(3) << (oldRoute ? "changing" : "adding") << " route entry @ vrf "
+            << id << " " << newRoute->str();
+    if (!newRoute->isResolved()) {
+      // if the new route is not resolved, delete it instead of changing it
+      VLOG(1) << "Non-resolved route HW programming is skipped";
+      if (oldRoute) {
+        processRemovedRoute(id, oldRoute);
+      }
+      continue;
+    }
+    batch.push_back(newRoute);
+    if (routeBatchDone(batch.size())) {
+      routeTable_->addRoutes(vrf, batch);
+      batch.clear();
+      yieldLock(lock);
+    }
+  }
+  if (!batch.empty()) {
+    routeTable_->addRoutes(vrf, batch);
+  }
+}
+
+void BcmSwitch::processRemovedRoutes(const StateDelta& delta,
+                                     std::unique_lock<std::mutex>* lock) {
   for (auto const& rtDelta : delta.getRouteTablesDelta()) {
     if (!rtDelta.getOld()) {
       // no old route table, must not removed route, skip
       continue;
     }
     RouterID id = rtDelta.getOld()->getID();
-    forEachRemoved(
-        rtDelta.getRoutesV4Delta(),
-        &BcmSwitch::processRemovedRoute<RouteV4>,
-        this,
-        id);
-    forEachRemoved(
-        rtDelta.getRoutesV6Delta(),
-        &BcmSwitch::processRemovedRoute<RouteV6>,
-        this,
-        id);
+    processRemovedRoutes(id, rtDelta.getRoutesV4Delta(), lock);
+    processRemovedRoutes(id, rtDelta.getRoutesV6Delta(), lock);
   }
 }
 
-void BcmSwitch::processAddedChangedRoutes(const StateDelta& delta) {
+void BcmSwitch::processAddedChangedRoutes(const StateDelta& delta,
+                                          std::unique_lock<std::mutex>* lock) {
   for (auto const& rtDelta : delta.getRouteTablesDelta()) {
     if (!rtDelta.getNew()) {
       // no new route table, must not added or changed route, skip
       continue;
     }
     RouterID id = rtDelta.getNew()->getID();
-    forEachChanged(
-        rtDelta.getRoutesV4Delta(),
-        &BcmSwitch::processChangedRoute<RouteV4>,
-        &BcmSwitch::processAddedRoute<RouteV4>,
-        [&](BcmSwitch *, RouterID, const shared_ptr<RouteV4>&) {},
-        this,
-        id);
-    forEachChanged(
-        rtDelta.getRoutesV6Delta(),
-        &BcmSwitch::processChangedRoute<RouteV6>,
-        &BcmSwitch::processAddedRoute<RouteV6>,
-        [&](BcmSwitch *, RouterID, const shared_ptr<RouteV6>&) {},
-        this,
-        id);
+    processAddedChangedRoutes<RouteV4>(id, rtDelta.getRoutesV4Delta(), lock);
+    processAddedChangedRoutes<RouteV6>(id, rtDelta.getRoutesV6Delta(), lock);
   }
 }
 
@@ -1064,6 +1121,7 @@ void BcmSwitch::linkscanCallback(int unit,
 
 void BcmSwitch::linkStateChangedHwNotLocked(opennsl_port_t bcmPortId,
     opennsl_port_info_t* info) {
+  auto begin = steady_clock::now();
   portTable_->setPortStatus(bcmPortId, info->linkstatus);
   // TODO: We should eventually define a more robust hardware independent
   // LinkStatus enum, so we can expose more detailed information to to the
@@ -1074,6 +1132,8 @@ void BcmSwitch::linkStateChangedHwNotLocked(opennsl_port_t bcmPortId,
     // are re resolved after port up before adding them
     // back. Adding them earlier leads to packet loss.
     hostTable_->linkDownHwNotLocked(bcmPortId);
+    BcmStats::get()->linkDownEcmpPruned(
+        duration_cast<microseconds>(steady_clock::now() - begin).count());
   }
   callback_->linkStateChanged(portTable_->getPortId(bcmPortId), up);
 }
@@ -1142,7 +1202,8 @@ void BcmSwitch::updateThreadLocalPortStats(PortID portID,
 }
 
 void BcmSwitch::updateGlobalStats() {
-  portTable_->updatePortStats();
+  // The port stats are collected by portStatsCollector_, on their own
+  // intervals
 }
 
 opennsl_if_t BcmSwitch::getDropEgressId() const {
@@ -14,6 +14,7 @@
 #include "fboss/agent/gen-cpp/switch_config_types.h"
 #include <folly/dynamic.h>
 
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <boost/container/flat_map.hpp>
@@ -33,6 +34,7 @@ class BcmEgress;
 class BcmHostTable;
 class BcmIntfTable;
 class BcmPlatform;
+class BcmPortStatsCollector;
 class BcmPortTable;
 class BcmRouteTable;
 class BcmRxPacket;
@@ -134,6 +136,9 @@ class BcmSwitch : public HwSwitch {
   const BcmPortTable* getPortTable() const {
     return portTable_.get();
   }
+  BcmPortStatsCollector* getPortStatsCollector() const {
+    return portStatsCollector_.get();
+  }
   const BcmIntfTable* getIntfTable() const {
     return intfTable_.get();
   }
@@ -272,18 +277,36 @@ class BcmSwitch : public HwSwitch {
   void processChangedPorts(const StateDelta& delta);
   void reconfigurePortGroups(const StateDelta& delta);
 
-  template <typename RouteT>
-  void processChangedRoute(
-      const RouterID id, const std::shared_ptr<RouteT>& oldRoute,
-      const std::shared_ptr<RouteT>& newRoute);
-  template <typename RouteT>
-  void processAddedRoute(
-      const RouterID id, const std::shared_ptr<RouteT>& route);
   template <typename RouteT>
   void processRemovedRoute(
       const RouterID id, const std::shared_ptr<RouteT>& route);
-  void processRemovedRoutes(const StateDelta& delta);
-  void processAddedChangedRoutes(const StateDelta& delta);
+  template <typename RibDeltaT>
+  void processRemovedRoutes(const RouterID id, const RibDeltaT& ribDelta,
+                            std::unique_lock<std::mutex>* lock);
+  template <typename RouteT, typename RibDeltaT>
+  void processAddedChangedRoutes(const RouterID id, const RibDeltaT& ribDelta,
+                                 std::unique_lock<std::mutex>* lock);
+  /*
+   * Routes are programmed in batches of FLAGS_route_batch_size, and the lock
+   * is given up for a moment after each batch, so that the other users of
+   * lock_ don't wait for the whole of a large route update.
+   *
+   * This means holding lock_ does not guarantee that no delta is half
+   * applied.  Code that only reads the hardware tables may run between
+   * batches.  Code that removes entries the delta may still claim (the warm
+   * boot cache) or that dumps the state for warm boot must call
+   * waitForDelta() first.
+   */
+  void processRemovedRoutes(const StateDelta& delta,
+                            std::unique_lock<std::mutex>* lock);
+  void processAddedChangedRoutes(const StateDelta& delta,
+                                 std::unique_lock<std::mutex>* lock);
+  bool routeBatchDone(uint32_t numRoutes) const;
+  void yieldLock(std::unique_lock<std::mutex>* lock);
+  /*
+   * Wait, with lock_ held, until no delta is being applied
+   */
+  void waitForDelta(std::unique_lock<std::mutex>* lock);
 
   void processAclChanges(const StateDelta& delta);
   void processChangedAcl(const std::shared_ptr<AclEntry>& oldAcl,
@@ -291,7 +314,8 @@ class BcmSwitch : public HwSwitch {
   void processAddedAcl(const std::shared_ptr<AclEntry>& acl);
   void processRemovedAcl(const std::shared_ptr<AclEntry>& acl);
 
-  void stateChangedImpl(const StateDelta& delta);
+  void stateChangedImpl(const StateDelta& delta,
+                        std::unique_lock<std::mutex>* lock);
 
   /*
    * Calls linkStateChanged below
@@ -435,6 +459,8 @@ class BcmSwitch : public HwSwitch {
   uint32_t flags_{0};
   HashMode hashMode_;
   std::unique_ptr<BcmPortTable> portTable_;
+  // Polls the port stats on its own thread, from initialConfigApplied() on
+  std::unique_ptr<BcmPortStatsCollector> portStatsCollector_;
   std::unique_ptr<BcmEgress> toCPUEgress_;
   std::unique_ptr<BcmIntfTable> intfTable_;
   std::unique_ptr<BcmHostTable> hostTable_;
@@ -446,6 +472,11 @@ class BcmSwitch : public HwSwitch {
    * Lock to synchronize access to all BCM* data structures
    */
   std::mutex lock_;
+  /*
+   * Set under lock_ while stateChangedImpl() runs, see waitForDelta()
+   */
+  bool deltaInProgress_{false};
+  std::condition_variable deltaDone_;
 };
 
 }} // facebook::fboss
@@ -32,6 +32,7 @@
 #include "fboss/agent/SysError.h"
 #include "fboss/agent/state/Vlan.h"
 #include "fboss/agent/state/VlanMap.h"
+#include "fboss/agent/state/StateSnapshot.h"
 #include "fboss/agent/state/SwitchState.h"
 
 using std::make_pair;
@@ -226,23 +227,37 @@ folly::dynamic BcmWarmBootCache::toFollyDynamic() const {
 }
 
 void BcmWarmBootCache::populateStateFromWarmbootFile() {
-  string warmBootJson;
   const auto& warmBootFile = hw_->getPlatform()->getWarmBootSwitchStateFile();
-  auto ret = folly::readFile(warmBootFile.c_str(), warmBootJson);
-  sysCheckError(ret, "Unable to read switch state from : ", warmBootFile);
-  auto switchStateJson = folly::parseJson(warmBootJson);
-  if (switchStateJson.find(kSwSwitch) != switchStateJson.items().end()) {
-    dumpedSwSwitchState_ =
-        SwitchState::uniquePtrFromFollyDynamic(switchStateJson[kSwSwitch]);
+  folly::dynamic swSwitchJson = nullptr;
+  folly::dynamic hwSwitchJson = nullptr;
+  if (StateSnapshotReader::isSnapshot(warmBootFile)) {
+    StateSnapshotReader snapshot(warmBootFile);
+    swSwitchJson = snapshot.get(kSwSwitch);
+    hwSwitchJson = snapshot.get(kHwSwitch);
   } else {
+    // Written by an older agent, or with --dump_state_json
+    string warmBootJson;
+    auto ret = folly::readFile(warmBootFile.c_str(), warmBootJson);
+    sysCheckError(ret, "Unable to read switch state from : ", warmBootFile);
+    auto switchStateJson = folly::parseJson(warmBootJson);
+    if (switchStateJson.find(kSwSwitch) != switchStateJson.items().end()) {
+      swSwitchJson = std::move(switchStateJson[kSwSwitch]);
+      if (switchStateJson.find(kHwSwitch) != switchStateJson.items().end()) {
+        hwSwitchJson = std::move(switchStateJson[kHwSwitch]);
+      }
+    } else {
+      swSwitchJson = std::move(switchStateJson);
+    }
+  }
+  if (!swSwitchJson.isNull()) {
     dumpedSwSwitchState_ =
-        SwitchState::uniquePtrFromFollyDynamic(switchStateJson);
+        SwitchState::uniquePtrFromFollyDynamic(swSwitchJson);
   }
   CHECK(dumpedSwSwitchState_)
       << "Was not able to recover software state after warmboot from state "
          "file: " << hw_->getPlatform()->getWarmBootSwitchStateFile();
 
-  if (switchStateJson.find(kHwSwitch) == switchStateJson.items().end()) {
+  if (hwSwitchJson.isNull()) {
     // hwSwitch state does not exist no need to reconstruct
     // ecmp -> egressId map. We only started dumping this
     // when we added fast handling of updating ecmp entries
@@ -255,7 +270,7 @@ void BcmWarmBootCache::populateStateFromWarmbootFile() {
   }
   hwSwitchEcmp2EgressIdsPopulated_ = true;
   // Extract ecmps for dumped host table
-  auto hostTable = switchStateJson[kHwSwitch][kHostTable];
+  auto hostTable = hwSwitchJson[kHostTable];
   for (const auto& ecmpEntry : hostTable[kEcmpHosts]) {
     auto ecmpEgressId = ecmpEntry[kEcmpEgressId].asInt();
     if (ecmpEgressId == BcmEgressBase::INVALID) {
@@ -268,7 +283,7 @@ void BcmWarmBootCache::populateStateFromWarmbootFile() {
   }
   // Extract ecmps from dumped warm boot cache. We
   // may have shut down before a FIB sync
-  auto ecmpObjects = switchStateJson[kHwSwitch][kWarmBootCache][kEcmpObjects];
+  auto ecmpObjects = hwSwitchJson[kWarmBootCache][kEcmpObjects];
   for (const auto& ecmpEntry : ecmpObjects) {
     auto ecmpEgressId = ecmpEntry[kEcmpEgressId].asInt();
     CHECK(ecmpEgressId != BcmEgressBase::INVALID);
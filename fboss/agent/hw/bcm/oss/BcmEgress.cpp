@@ -9,16 +9,56 @@
  */
 #include "fboss/agent/hw/bcm/BcmEgress.h"
 
+#include "fboss/agent/hw/bcm/BcmError.h"
+
+extern "C" {
+#include <opennsl/l3.h>
+}
+
 namespace facebook { namespace fboss {
 
 bool BcmEcmpEgress::removeEgressIdHwNotLocked(int unit, opennsl_if_t ecmpId,
     const Paths& egressIdInSw, opennsl_if_t toRemove) {
-  return false; // Not supported in opennsl;
+  if (egressIdInSw.find(toRemove) == egressIdInSw.end()) {
+    return false;
+  }
+  opennsl_l3_egress_ecmp_t obj;
+  opennsl_l3_egress_ecmp_t_init(&obj);
+  obj.ecmp_intf = ecmpId;
+  auto rv = opennsl_l3_egress_ecmp_delete(unit, &obj, toRemove);
+  if (rv == OPENNSL_E_NOT_FOUND) {
+    // Already taken out, e.g. on link down before the neighbor entry for
+    // it went away as well
+    return false;
+  }
+  // Don't throw, this is called from the linkscan thread for every group
+  // going over a port that just went down, and the rest still need pruning
+  bcmLogError(rv, "failed to remove egress ", toRemove,
+      " from ECMP egress object ", ecmpId);
+  if (OPENNSL_FAILURE(rv)) {
+    return false;
+  }
+  VLOG(1) << "Removed egress " << toRemove << " from ECMP egress object "
+    << ecmpId;
+  return true;
 }
 
 bool BcmEcmpEgress::addEgressIdHwLocked(int unit, opennsl_if_t ecmpId,
       const Paths& egressIdInSw, opennsl_if_t toAdd) {
-  return false; // Not supported in opennsl
+  if (egressIdInSw.find(toAdd) == egressIdInSw.end()) {
+    return false;
+  }
+  opennsl_l3_egress_ecmp_t obj;
+  opennsl_l3_egress_ecmp_t_init(&obj);
+  obj.ecmp_intf = ecmpId;
+  auto rv = opennsl_l3_egress_ecmp_add(unit, &obj, toAdd);
+  if (rv == OPENNSL_E_EXISTS) {
+    return false;
+  }
+  bcmCheckError(rv, "failed to add egress ", toAdd,
+      " to ECMP egress object ", ecmpId);
+  VLOG(1) << "Added egress " << toAdd << " to ECMP egress object " << ecmpId;
+  return true;
 }
 
 }}
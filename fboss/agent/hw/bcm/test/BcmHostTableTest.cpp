@@ -0,0 +1,198 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/ApplyThriftConfig.h"
+#include "fboss/agent/RxPacket.h"
+#include "fboss/agent/gen-cpp/switch_config_types.h"
+#include "fboss/agent/hw/bcm/BcmHost.h"
+#include "fboss/agent/hw/bcm/BcmSwitch.h"
+#include "fboss/agent/hw/bcm/test/FakeBcmPlatform.h"
+#include "fboss/agent/hw/bcm/test/FakeOpenNSL.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+#include <folly/Conv.h>
+#include <folly/Exception.h>
+#include <folly/Memory.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::MacAddress;
+using std::shared_ptr;
+using std::unique_ptr;
+
+DECLARE_bool(can_warm_boot);
+
+/*
+ * ECMP pruning on link down, run through BcmSwitch on FakeOpenNSL.
+ *
+ * There are two ECMP groups: 10.0.0.0/24 over the nexthops on ports 1, 2
+ * and 3, and 10.0.1.0/24 over the ones on ports 1 and 2.
+ */
+
+namespace {
+
+const RouterID kRid(0);
+const InterfaceID kIntf(1);
+const VlanID kVlan(1);
+const MacAddress kNexthopMac("02:00:00:00:00:02");
+const IPAddressV4 kNexthop1("1.0.0.11");
+const IPAddressV4 kNexthop2("1.0.0.12");
+const IPAddressV4 kNexthop3("1.0.0.13");
+
+class TestCallback : public HwSwitch::Callback {
+ public:
+  void packetReceived(unique_ptr<RxPacket> pkt) noexcept override {}
+  void linkStateChanged(PortID port, bool up) noexcept override {}
+  void exitFatal() const noexcept override {}
+};
+
+class BcmHostTableTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    FakeOpenNSL::setLimits(FakeOpenNSL::Limits());
+    FLAGS_can_warm_boot = false;
+    char dir[] = "/tmp/fbossBcmHostTableTest.XXXXXX";
+    folly::checkUnixError(mkdtemp(dir) ? 0 : -1,
+                          "failed to create state directory");
+    platform_ = folly::make_unique<FakeBcmPlatform>(dir);
+    hw_ = folly::make_unique<BcmSwitch>(platform_.get());
+    auto bootState = hw_->init(&callback_).switchState;
+    for (int port = 1; port <= 4; ++port) {
+      FakeOpenNSL::setLinkState(port, true);
+    }
+
+    RouteNextHops group1;
+    RouteNextHops group2;
+    for (auto nexthop : {kNexthop1, kNexthop2, kNexthop3}) {
+      group1.emplace(IPAddress(nexthop));
+      if (nexthop != kNexthop3) {
+        group2.emplace(IPAddress(nexthop));
+      }
+    }
+    auto state = configure(bootState);
+    programmed_ = bootState;
+    setNeighbor(&state, kNexthop1, PortID(1));
+    setNeighbor(&state, kNexthop2, PortID(2));
+    setNeighbor(&state, kNexthop3, PortID(3));
+    RouteUpdater updater(state->getRouteTables());
+    updater.addRoute(kRid, IPAddress("10.0.0.0"), 24, group1);
+    updater.addRoute(kRid, IPAddress("10.0.1.0"), 24, group2);
+    state->resetRouteTables(updater.updateDone());
+    apply(state);
+    ASSERT_EQ(2, FakeOpenNSL::numEcmpGroups());
+    ASSERT_EQ(5, FakeOpenNSL::numEcmpPaths());
+  }
+
+  void TearDown() override {
+    hw_.reset();
+  }
+
+ protected:
+  shared_ptr<SwitchState> configure(
+      const shared_ptr<SwitchState>& bootState) {
+    auto numPorts = FakeOpenNSL::getLimits().numPorts;
+    cfg::SwitchConfig config;
+    config.ports.resize(numPorts);
+    config.vlanPorts.resize(numPorts);
+    for (uint32_t i = 0; i < numPorts; ++i) {
+      config.ports[i].logicalID = i + 1;
+      config.ports[i].name = folly::to<std::string>("port", i + 1);
+      config.ports[i].state = cfg::PortState::UP;
+      config.vlanPorts[i].logicalPort = i + 1;
+      config.vlanPorts[i].vlanID = kVlan;
+      config.vlanPorts[i].emitTags = false;
+    }
+    config.vlans.resize(1);
+    config.vlans[0].id = kVlan;
+    config.vlans[0].name = "Vlan1";
+    config.interfaces.resize(1);
+    config.interfaces[0].intfID = kIntf;
+    config.interfaces[0].vlanID = kVlan;
+    config.interfaces[0].routerID = kRid;
+    config.interfaces[0].__isset.mac = true;
+    config.interfaces[0].mac = "02:00:00:00:00:01";
+    config.interfaces[0].ipAddresses.push_back("1.0.0.1/16");
+
+    bootState->publish();
+    auto state = applyThriftConfig(bootState, &config, platform_.get());
+    CHECK(state);
+    return state;
+  }
+
+  // Resolve the neighbor on the given port, or move it there
+  void setNeighbor(shared_ptr<SwitchState>* state, IPAddressV4 ip,
+                   PortID port) {
+    Vlan* vlan = (*state)->getVlans()->getVlan(kVlan).get();
+    auto arpTable = vlan->getArpTable()->modify(&vlan, state);
+    if (arpTable->getEntryIf(ip)) {
+      arpTable->updateEntry(ip, kNexthopMac, port, kIntf);
+    } else {
+      arpTable->addEntry(ip, kNexthopMac, port, kIntf);
+    }
+  }
+
+  void apply(shared_ptr<SwitchState> state) {
+    state->publish();
+    hw_->stateChanged(StateDelta(programmed_, state));
+    programmed_ = state;
+  }
+
+  opennsl_port_t egressPort(IPAddressV4 ip) const {
+    auto host = hw_->getHostTable()->getBcmHost(
+        BcmSwitch::getBcmVrfId(kRid), IPAddress(ip));
+    return hw_->getHostTable()->egressIdPort(host->getEgressId());
+  }
+
+  TestCallback callback_;
+  unique_ptr<FakeBcmPlatform> platform_;
+  unique_ptr<BcmSwitch> hw_;
+  shared_ptr<SwitchState> programmed_;
+};
+
+} // unnamed namespace
+
+TEST_F(BcmHostTableTest, LinkDownPrunesOnlyThatPort) {
+  // Both groups go over port 1
+  FakeOpenNSL::setLinkState(1, false);
+  EXPECT_EQ(3, FakeOpenNSL::numEcmpPaths());
+  // Nothing else goes over port 4
+  FakeOpenNSL::setLinkState(4, false);
+  EXPECT_EQ(3, FakeOpenNSL::numEcmpPaths());
+  // Only the first group goes over port 3
+  FakeOpenNSL::setLinkState(3, false);
+  EXPECT_EQ(2, FakeOpenNSL::numEcmpPaths());
+  EXPECT_EQ(2, FakeOpenNSL::numEcmpGroups());
+}
+
+TEST_F(BcmHostTableTest, LinkDownFollowsNeighborMove) {
+  EXPECT_EQ(2, egressPort(kNexthop2));
+  auto state = programmed_;
+  SwitchState::modify(&state);
+  setNeighbor(&state, kNexthop2, PortID(4));
+  apply(state);
+  EXPECT_EQ(4, egressPort(kNexthop2));
+  EXPECT_EQ(5, FakeOpenNSL::numEcmpPaths());
+
+  // The nexthop has left port 2, so its members stay
+  FakeOpenNSL::setLinkState(2, false);
+  EXPECT_EQ(5, FakeOpenNSL::numEcmpPaths());
+  // and are pruned from both groups when its new port goes down
+  FakeOpenNSL::setLinkState(4, false);
+  EXPECT_EQ(3, FakeOpenNSL::numEcmpPaths());
+}
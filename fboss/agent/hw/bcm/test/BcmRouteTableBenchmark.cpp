@@ -0,0 +1,124 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Memory.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include "fboss/agent/hw/bcm/BcmHost.h"
+#include "fboss/agent/hw/bcm/BcmRoute.h"
+#include "fboss/agent/hw/bcm/BcmSwitch.h"
+#include "fboss/agent/hw/bcm/test/FakeBcmPlatform.h"
+#include "fboss/agent/hw/bcm/test/FakeOpenNSL.h"
+#include "fboss/agent/state/Route.h"
+
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::MacAddress;
+using std::shared_ptr;
+using std::unique_ptr;
+
+DEFINE_int32(num_routes, 1000000, "The number of routes to program");
+DEFINE_int32(num_ecmp_groups, 300,
+             "The number of distinct nexthop sets used by the routes");
+DEFINE_int32(ecmp_width, 8, "The number of nexthops in each set");
+
+/*
+ * Program a full table from scratch into BcmRouteTable, as a cold boot does,
+ * with the SDK replaced by FakeOpenNSL.  The routes share a few hundred ECMP
+ * groups, whose nexthops are all resolved beforehand.
+ */
+
+namespace {
+
+const opennsl_vrf_t kVrf = 0;
+const InterfaceID kIntf(1);
+const opennsl_if_t kBcmIntf = 1;
+const MacAddress kNexthopMac("02:00:00:00:00:01");
+
+unique_ptr<FakeBcmPlatform> platform;
+unique_ptr<BcmSwitch> hw;
+std::vector<shared_ptr<RouteV4>> routes;
+
+IPAddress nexthopAddr(uint32_t group, uint32_t member) {
+  // Spread the groups' members over the connected subnet 1.0.0.0/16
+  return IPAddressV4::fromLongHBO((1 << 24) +
+                                  (group * 7 + member * 13) % 65000 + 2);
+}
+
+void init() {
+  platform = folly::make_unique<FakeBcmPlatform>("/tmp/fake_bcm");
+  hw = folly::make_unique<BcmSwitch>(platform.get());
+
+  // Resolve every nexthop, as neighbor discovery would have before the
+  // routes are programmed
+  auto hostTable = hw->writableHostTable();
+  std::vector<std::pair<RouteNextHops, RouteForwardNexthops>> ecmpGroups;
+  for (uint32_t i = 0; i < FLAGS_num_ecmp_groups; ++i) {
+    RouteNextHops nexthops;
+    RouteForwardNexthops fwd;
+    for (uint32_t j = 0; j < FLAGS_ecmp_width; ++j) {
+      auto addr = nexthopAddr(i, j);
+      nexthops.emplace(addr);
+      fwd.emplace(kIntf, addr);
+      if (!hostTable->getBcmHostIf(kVrf, addr)) {
+        auto host = hostTable->incRefOrCreateBcmHost(kVrf, addr);
+        host->program(kBcmIntf, kNexthopMac, j + 1);
+      }
+    }
+    ecmpGroups.emplace_back(std::move(nexthops), std::move(fwd));
+  }
+
+  routes.reserve(FLAGS_num_routes);
+  for (uint32_t i = 0; i < FLAGS_num_routes; ++i) {
+    // Consecutive /24s from 10.0.0.0 up
+    auto network = IPAddressV4::fromLongHBO((10 << 24) + (i << 8));
+    const auto& group = ecmpGroups[i % ecmpGroups.size()];
+    auto route = std::make_shared<RouteV4>(RouteV4::Prefix{network, 24},
+                                           group.first);
+    route->setResolved(group.second);
+    routes.push_back(std::move(route));
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK(BcmRouteTableAddRoutes, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    unique_ptr<BcmRouteTable> table;
+    BENCHMARK_SUSPEND {
+      table = folly::make_unique<BcmRouteTable>(hw.get());
+      FakeOpenNSL::resetCalls();
+    }
+    for (const auto& route : routes) {
+      table->addRoute(kVrf, route.get());
+    }
+    BENCHMARK_SUSPEND {
+      LOG(INFO) << routes.size() << " routes programmed with "
+                << FakeOpenNSL::numCalls("opennsl_l3_route_add")
+                << " route adds, "
+                << FakeOpenNSL::numCalls("opennsl_l3_egress_ecmp_create")
+                << " ECMP group creates and "
+                << FakeOpenNSL::totalCalls() << " SDK calls in all";
+      table.reset();
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  init();
+
+  folly::runBenchmarks();
+  return 0;
+}
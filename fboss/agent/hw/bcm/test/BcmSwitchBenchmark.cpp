@@ -0,0 +1,376 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Memory.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include "fboss/agent/ApplyThriftConfig.h"
+#include "fboss/agent/Constants.h"
+#include "fboss/agent/RxPacket.h"
+#include "fboss/agent/gen-cpp/switch_config_types.h"
+#include "fboss/agent/hw/bcm/BcmPortStatsCollector.h"
+#include "fboss/agent/hw/bcm/BcmSwitch.h"
+#include "fboss/agent/hw/bcm/test/FakeBcmPlatform.h"
+#include "fboss/agent/hw/bcm/test/FakeOpenNSL.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/StateSnapshot.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::MacAddress;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+using std::shared_ptr;
+using std::unique_ptr;
+
+DECLARE_bool(can_warm_boot);
+DECLARE_int32(route_batch_size);
+
+DEFINE_int32(num_routes, 100000, "The number of routes to program");
+DEFINE_int32(num_ecmp_groups, 300,
+             "The number of distinct nexthop sets used by the routes");
+DEFINE_int32(ecmp_width, 8, "The number of nexthops in each set");
+DEFINE_int32(churn_percent, 10,
+             "The percentage of routes whose nexthops change in each update "
+             "of the route churn benchmark");
+DEFINE_int32(sdk_call_latency_ns, 0,
+             "How long each SDK call takes, standing in for the SDK and PCIe "
+             "costs of a real ASIC");
+DEFINE_string(fake_bcm_state_dir, "/tmp/fake_bcm",
+              "Where the fake platform keeps its warm boot state");
+
+/*
+ * Run the real BcmSwitch code on top of FakeOpenNSL: cold boot into a full
+ * table, warm boot back into it, and churn the nexthops of some of the
+ * routes.
+ *
+ * The switch has one VLAN with all the ports in it, and one interface with
+ * every nexthop resolved, as ARP would have them shortly after boot.
+ */
+
+namespace {
+
+const RouterID kRid(0);
+const InterfaceID kIntf(1);
+const VlanID kVlan(1);
+const MacAddress kNexthopMac("02:00:00:00:00:02");
+
+class BenchmarkCallback : public HwSwitch::Callback {
+ public:
+  void packetReceived(unique_ptr<RxPacket> pkt) noexcept override {}
+  void linkStateChanged(PortID port, bool up) noexcept override {}
+  void exitFatal() const noexcept override {}
+};
+
+BenchmarkCallback callback;
+unique_ptr<FakeBcmPlatform> platform;
+unique_ptr<BcmSwitch> hw;
+// The full table, and the same table with some of the routes' nexthops
+// changed
+shared_ptr<SwitchState> stateA;
+shared_ptr<SwitchState> stateB;
+shared_ptr<SwitchState> programmed;
+
+IPAddressV4 nexthopAddr(uint32_t group, uint32_t member) {
+  // Spread the groups' members over the connected subnet 1.0.0.0/16
+  return IPAddressV4::fromLongHBO((1 << 24) +
+                                  (group * 7 + member * 13) % 65000 + 2);
+}
+
+RouteNextHops makeGroup(uint32_t group) {
+  RouteNextHops nexthops;
+  for (uint32_t i = 0; i < FLAGS_ecmp_width; ++i) {
+    nexthops.emplace(nexthopAddr(group, i));
+  }
+  return nexthops;
+}
+
+shared_ptr<SwitchState> configure(const shared_ptr<SwitchState>& bootState) {
+  auto numPorts = FakeOpenNSL::getLimits().numPorts;
+  cfg::SwitchConfig config;
+  config.ports.resize(numPorts);
+  config.vlanPorts.resize(numPorts);
+  for (uint32_t i = 0; i < numPorts; ++i) {
+    config.ports[i].logicalID = i + 1;
+    config.ports[i].name = folly::to<std::string>("port", i + 1);
+    config.ports[i].state = cfg::PortState::UP;
+    config.vlanPorts[i].logicalPort = i + 1;
+    config.vlanPorts[i].vlanID = kVlan;
+    config.vlanPorts[i].emitTags = false;
+  }
+  config.vlans.resize(1);
+  config.vlans[0].id = kVlan;
+  config.vlans[0].name = "Vlan1";
+  config.interfaces.resize(1);
+  config.interfaces[0].intfID = kIntf;
+  config.interfaces[0].vlanID = kVlan;
+  config.interfaces[0].routerID = kRid;
+  config.interfaces[0].__isset.mac = true;
+  config.interfaces[0].mac = "02:00:00:00:00:01";
+  config.interfaces[0].ipAddresses.push_back("1.0.0.1/16");
+
+  bootState->publish();
+  auto state = applyThriftConfig(bootState, &config, platform.get());
+  CHECK(state);
+  state->publish();
+
+  // Resolve every nexthop
+  Vlan* vlan = state->getVlans()->getVlan(kVlan).get();
+  auto arpTable = vlan->getArpTable()->modify(&vlan, &state);
+  for (uint32_t i = 0; i < FLAGS_num_ecmp_groups; ++i) {
+    for (uint32_t j = 0; j < FLAGS_ecmp_width; ++j) {
+      auto addr = nexthopAddr(i, j);
+      if (!arpTable->getEntryIf(addr)) {
+        arpTable->addEntry(addr, kNexthopMac, PortID(j % numPorts + 1), kIntf);
+      }
+    }
+  }
+
+  // Consecutive /24s from 10.0.0.0 up, sharing the ECMP groups
+  RouteUpdater updater(state->getRouteTables());
+  for (uint32_t i = 0; i < FLAGS_num_routes; ++i) {
+    auto network = IPAddressV4::fromLongHBO((10 << 24) + (i << 8));
+    updater.addRoute(kRid, IPAddress(network), 24,
+                     makeGroup(i % FLAGS_num_ecmp_groups));
+  }
+  state->resetRouteTables(updater.updateDone());
+  state->publish();
+  return state;
+}
+
+shared_ptr<SwitchState> churn(const shared_ptr<SwitchState>& state) {
+  RouteUpdater updater(state->getRouteTables());
+  for (uint32_t i = 0; i < FLAGS_num_routes; ++i) {
+    if (i % 100 >= FLAGS_churn_percent) {
+      continue;
+    }
+    auto network = IPAddressV4::fromLongHBO((10 << 24) + (i << 8));
+    updater.addRoute(kRid, IPAddress(network), 24,
+                     makeGroup((i + 1) % FLAGS_num_ecmp_groups));
+  }
+  auto newState = state;
+  SwitchState::modify(&newState);
+  newState->resetRouteTables(updater.updateDone());
+  newState->publish();
+  return newState;
+}
+
+shared_ptr<SwitchState> initSwitch() {
+  hw = folly::make_unique<BcmSwitch>(platform.get());
+  return hw->init(&callback).switchState;
+}
+
+void logTables(folly::StringPiece what) {
+  LOG(INFO) << what << ": " << FakeOpenNSL::totalCalls() << " SDK calls, "
+            << FakeOpenNSL::numRoutes() << " routes, "
+            << FakeOpenNSL::numHosts() << " hosts, "
+            << FakeOpenNSL::numEgresses() << " egresses and "
+            << FakeOpenNSL::numEcmpGroups() << " ECMP groups in the ASIC";
+}
+
+void logRate(folly::StringPiece what, uint32_t numRoutes,
+             steady_clock::duration elapsed) {
+  auto us = duration_cast<microseconds>(elapsed).count();
+  LOG(INFO) << what << ": " << numRoutes << " routes in " << us << "us, "
+            << (us ? numRoutes * 1000000ULL / us : 0) << " routes/s";
+}
+
+void coldBoot() {
+  FLAGS_can_warm_boot = false;
+  hw.reset();
+  auto bootState = initSwitch();
+  hw->stateChanged(StateDelta(bootState, stateA));
+  programmed = stateA;
+}
+
+void init() {
+  FakeOpenNSL::setCallLatency(
+      std::chrono::nanoseconds(FLAGS_sdk_call_latency_ns));
+  platform = folly::make_unique<FakeBcmPlatform>(FLAGS_fake_bcm_state_dir);
+
+  // Boot once just to get the ports the state is configured on
+  FLAGS_can_warm_boot = false;
+  stateA = configure(initSwitch());
+  stateB = churn(stateA);
+  hw.reset();
+}
+
+} // unnamed namespace
+
+BENCHMARK(BcmSwitchColdBoot, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    shared_ptr<SwitchState> bootState;
+    BENCHMARK_SUSPEND {
+      FLAGS_can_warm_boot = false;
+      hw.reset();
+      FakeOpenNSL::resetCalls();
+    }
+    bootState = initSwitch();
+    auto begin = steady_clock::now();
+    hw->stateChanged(StateDelta(bootState, stateA));
+    auto elapsed = steady_clock::now() - begin;
+    BENCHMARK_SUSPEND {
+      programmed = stateA;
+      logTables("Cold boot");
+      logRate("Cold boot", FLAGS_num_routes, elapsed);
+    }
+  }
+}
+
+/*
+ * The cold boot again, with another thread taking the switch lock every
+ * millisecond as the neighbor hit polling would, to see how long it waits
+ * for the lock at worst while the routes are programmed.
+ */
+BENCHMARK(BcmSwitchColdBootLockWait, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    shared_ptr<SwitchState> bootState;
+    std::atomic<bool> done{false};
+    steady_clock::duration maxWait{0};
+    std::thread poller;
+    BENCHMARK_SUSPEND {
+      FLAGS_can_warm_boot = false;
+      hw.reset();
+      bootState = initSwitch();
+      poller = std::thread([&] {
+        IPAddress addr("2.0.0.1");
+        while (!done) {
+          auto begin = steady_clock::now();
+          hw->getAndClearNeighborHit(kRid, addr);
+          maxWait = std::max(maxWait, steady_clock::now() - begin);
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      });
+    }
+    hw->stateChanged(StateDelta(bootState, stateA));
+    BENCHMARK_SUSPEND {
+      done = true;
+      poller.join();
+      programmed = stateA;
+      LOG(INFO) << "Cold boot with batches of " << FLAGS_route_batch_size
+                << " routes: waited at most "
+                << duration_cast<microseconds>(maxWait).count()
+                << "us for the lock";
+    }
+  }
+}
+
+BENCHMARK(BcmSwitchWarmBoot, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    shared_ptr<SwitchState> bootState;
+    BENCHMARK_SUSPEND {
+      if (!hw) {
+        coldBoot();
+      }
+      folly::dynamic switchState = folly::dynamic::object;
+      switchState[kSwSwitch] = programmed->toFollyDynamic();
+      switchState[kHwSwitch] = hw->gracefulExit();
+      writeStateSnapshot(platform->getWarmBootSwitchStateFile(), switchState);
+      hw.reset();
+      FLAGS_can_warm_boot = true;
+      FakeOpenNSL::resetCalls();
+    }
+    bootState = initSwitch();
+    hw->stateChanged(StateDelta(bootState, programmed));
+    hw->clearWarmBootCache();
+    BENCHMARK_SUSPEND {
+      logTables("Warm boot");
+    }
+  }
+}
+
+BENCHMARK(BcmSwitchRouteChurn, numIters) {
+  BENCHMARK_SUSPEND {
+    if (!hw) {
+      coldBoot();
+    }
+    FakeOpenNSL::resetCalls();
+  }
+  auto begin = steady_clock::now();
+  for (size_t n = 0; n < numIters; ++n) {
+    auto next = programmed == stateA ? stateB : stateA;
+    hw->stateChanged(StateDelta(programmed, next));
+    programmed = next;
+  }
+  auto elapsed = steady_clock::now() - begin;
+  BENCHMARK_SUSPEND {
+    logTables("Route churn");
+    logRate("Route churn",
+            numIters * (FLAGS_num_routes * FLAGS_churn_percent / 100),
+            elapsed);
+  }
+}
+
+/*
+ * Take a port down, as the linkscan thread would see it, which prunes the
+ * port's nexthops out of every ECMP group.
+ */
+BENCHMARK(BcmSwitchLinkDown, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    size_t paths;
+    BENCHMARK_SUSPEND {
+      // Start over with every group whole
+      coldBoot();
+      FakeOpenNSL::setLinkState(1, true);
+      FakeOpenNSL::resetCalls();
+      paths = FakeOpenNSL::numEcmpPaths();
+    }
+    FakeOpenNSL::setLinkState(1, false);
+    BENCHMARK_SUSPEND {
+      LOG(INFO) << "Link down: pruned " << paths - FakeOpenNSL::numEcmpPaths()
+                << " ECMP paths with " << FakeOpenNSL::totalCalls()
+                << " SDK calls";
+    }
+  }
+}
+
+/*
+ * One pass of the port stats collector over every port, for each class of
+ * stats.
+ */
+BENCHMARK(BcmSwitchPortStats, numIters) {
+  BENCHMARK_SUSPEND {
+    if (!hw) {
+      coldBoot();
+    }
+    FakeOpenNSL::resetCalls();
+  }
+  auto collector = hw->getPortStatsCollector();
+  for (size_t n = 0; n < numIters; ++n) {
+    collector->collect(BcmPort::StatClass::TRAFFIC);
+    collector->collect(BcmPort::StatClass::PKT_LENGTHS);
+    collector->collect(BcmPort::StatClass::QUEUE_LENGTH);
+  }
+  BENCHMARK_SUSPEND {
+    LOG(INFO) << "Port stats: " << FakeOpenNSL::totalCalls() / numIters
+              << " SDK calls per pass over the ports";
+  }
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  init();
+
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/test/FakeBcmPlatform.h"
+
+#include "fboss/agent/ThriftHandler.h"
+#include "fboss/agent/hw/bcm/test/FakeOpenNSL.h"
+
+#include <folly/Memory.h>
+
+using folly::MacAddress;
+using std::string;
+using std::unique_ptr;
+
+namespace facebook { namespace fboss {
+
+FakeBcmPlatform::FakeBcmPlatform(string stateDir)
+  : stateDir_(std::move(stateDir)) {
+}
+
+unique_ptr<ThriftHandler> FakeBcmPlatform::createHandler(SwSwitch* sw) {
+  return folly::make_unique<ThriftHandler>(sw);
+}
+
+MacAddress FakeBcmPlatform::getLocalMac() const {
+  return MacAddress("02:00:00:00:00:01");
+}
+
+BcmPlatform::InitPortMap FakeBcmPlatform::initPorts() {
+  InitPortMap ports;
+  auto numPorts = FakeOpenNSL::getLimits().numPorts;
+  for (opennsl_port_t port = 1; port <= numPorts; ++port) {
+    auto& platformPort = ports_[port];
+    if (!platformPort) {
+      platformPort = folly::make_unique<FakeBcmPlatformPort>(PortID(port));
+    }
+    ports.emplace(port, platformPort.get());
+  }
+  return ports;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/hw/bcm/BcmPlatform.h"
+#include "fboss/agent/hw/bcm/BcmPlatformPort.h"
+#include "fboss/agent/types.h"
+
+#include <folly/MacAddress.h>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace facebook { namespace fboss {
+
+class FakeBcmPlatformPort : public BcmPlatformPort {
+ public:
+  explicit FakeBcmPlatformPort(PortID id) : id_(id) {}
+
+  PortID getPortID() const override { return id_; }
+
+  void setBcmPort(BcmPort* port) override {
+    bcmPort_ = port;
+  }
+  BcmPort* getBcmPort() const override {
+    return bcmPort_;
+  }
+
+  cfg::PortSpeed maxLaneSpeed() const override {
+    return cfg::PortSpeed::XG;
+  }
+
+  void preDisable(bool temporary) override {}
+  void postDisable(bool temporary) override {}
+  void preEnable() override {}
+  void postEnable() override {}
+  bool isMediaPresent() override {
+    return true;
+  }
+  void linkStatusChanged(bool up, bool adminUp) override {}
+  void statusIndication(bool enabled, bool link,
+                        bool ingress, bool egress,
+                        bool discards, bool errors) override {}
+  void remedy() override {}
+  void prepareForGracefulExit() override {}
+
+ private:
+  PortID id_{0};
+  BcmPort* bcmPort_{nullptr};
+};
+
+/*
+ * A platform for running BcmSwitch on top of FakeOpenNSL.
+ *
+ * There is one port for each front panel port of the fake ASIC, and all
+ * state files are kept under stateDir, so that a BcmSwitch created after
+ * another one's gracefulExit() warm boots.  The BcmSwitch is owned by the
+ * caller, and getHwSwitch() returns null.
+ */
+class FakeBcmPlatform : public BcmPlatform {
+ public:
+  explicit FakeBcmPlatform(std::string stateDir);
+
+  HwSwitch* getHwSwitch() const override {
+    return nullptr;
+  }
+  void onHwInitialized(SwSwitch* sw) override {}
+  std::unique_ptr<ThriftHandler> createHandler(SwSwitch* sw) override;
+
+  folly::MacAddress getLocalMac() const override;
+  std::string getVolatileStateDir() const override {
+    return stateDir_ + "/volatile";
+  }
+  std::string getPersistentStateDir() const override {
+    return stateDir_ + "/persistent";
+  }
+  void getProductInfo(ProductInfo& info) override {}
+
+  void onUnitAttach() override {}
+  InitPortMap initPorts() override;
+  bool canUseHostTableForHostRoutes() const override {
+    return false;
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  FakeBcmPlatform(FakeBcmPlatform const &) = delete;
+  FakeBcmPlatform& operator=(FakeBcmPlatform const &) = delete;
+
+  const std::string stateDir_;
+  std::map<opennsl_port_t, std::unique_ptr<FakeBcmPlatformPort>> ports_;
+};
+
+}} // facebook::fboss
@@ -0,0 +1,1308 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/test/FakeOpenNSL.h"
+
+#include <glog/logging.h>
+
+extern "C" {
+#include <opennsl/error.h>
+#include <opennsl/init.h>
+#include <opennsl/l2.h>
+#include <opennsl/l3.h>
+#include <opennsl/link.h>
+#include <opennsl/pkt.h>
+#include <opennsl/port.h>
+#include <opennsl/rx.h>
+#include <opennsl/stat.h>
+#include <opennsl/stg.h>
+#include <opennsl/switch.h>
+#include <opennsl/tx.h>
+#include <opennsl/vlan.h>
+#include <sal/driver.h>
+}
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::string;
+
+namespace {
+
+// The drop egress object, see BcmEgress::getDropEgressId()
+constexpr opennsl_if_t kDropEgressId = 100000;
+constexpr opennsl_if_t kFirstEcmpId = 200000;
+constexpr opennsl_if_t kLastEcmpId = 300000;
+constexpr opennsl_port_t kCpuPort = 0;
+constexpr opennsl_vlan_t kDefaultVlan = 1;
+// In Mbps, as in cfg::PortSpeed
+constexpr int kPortSpeed = 10000;
+// The SOC_BOOT_FLAGS bit BcmUnit::attach() sets to warm boot
+constexpr unsigned long kWarmBootFlag = 0x200000;
+
+struct Calls {
+  std::mutex lock;
+  std::map<string, uint64_t> counts;
+  nanoseconds latency{0};
+  std::map<string, nanoseconds> latencies;
+};
+
+Calls& calls() {
+  static auto c = new Calls();
+  return *c;
+}
+
+struct Port {
+  bool enabled{false};
+  bool linkUp{false};
+  int speed{kPortSpeed};
+  opennsl_port_if_t intf{OPENNSL_PORT_IF_SFI};
+  opennsl_vlan_t untaggedVlan{kDefaultVlan};
+  int linkscanMode{OPENNSL_LINKSCAN_MODE_NONE};
+  std::map<int, uint64_t> stats;
+};
+
+struct Ecmp {
+  opennsl_l3_egress_ecmp_t ecmp;
+  std::vector<opennsl_if_t> paths;
+};
+
+/*
+ * The contents of the ASIC, which survive a warm boot, and the SDK's
+ * callbacks, which don't.
+ */
+struct Asic {
+  std::mutex lock;
+
+  FakeOpenNSL::Limits limits;
+  std::map<opennsl_port_t, Port> ports;
+  std::map<opennsl_vlan_t, opennsl_vlan_data_t> vlans;
+  opennsl_vlan_t defaultVlan{kDefaultVlan};
+  std::map<int, opennsl_l2_station_t> stations;
+  std::map<opennsl_if_t, opennsl_l3_intf_t> intfs;
+  std::map<opennsl_if_t, opennsl_l3_egress_t> egresses;
+  std::map<opennsl_if_t, Ecmp> ecmps;
+  std::unordered_map<string, opennsl_l3_host_t> hosts;
+  std::unordered_map<string, opennsl_l3_route_t> routes;
+  opennsl_if_t nextEgressId{kDropEgressId + 1};
+  opennsl_if_t nextEcmpId{kFirstEcmpId};
+  opennsl_if_t nextIntfId{1};
+
+  opennsl_linkscan_handler_t linkscanHandler{nullptr};
+  int linkscanInterval{0};
+  opennsl_rx_cb_f rxCallback{nullptr};
+
+  bool validPort(opennsl_port_t port) const {
+    return ports.find(port) != ports.end();
+  }
+  bool validEgress(opennsl_if_t id) const {
+    return egresses.find(id) != egresses.end() ||
+      ecmps.find(id) != ecmps.end();
+  }
+
+  void coldBoot() {
+    ports.clear();
+    vlans.clear();
+    stations.clear();
+    intfs.clear();
+    egresses.clear();
+    ecmps.clear();
+    hosts.clear();
+    routes.clear();
+    nextEgressId = kDropEgressId + 1;
+    nextEcmpId = kFirstEcmpId;
+    nextIntfId = 1;
+
+    opennsl_vlan_data_t vlan;
+    memset(&vlan, 0, sizeof(vlan));
+    vlan.vlan_tag = kDefaultVlan;
+    for (opennsl_port_t port = kCpuPort; port <= limits.numPorts; ++port) {
+      ports[port];
+      OPENNSL_PBMP_PORT_ADD(vlan.port_bitmap, port);
+      OPENNSL_PBMP_PORT_ADD(vlan.ut_port_bitmap, port);
+    }
+    vlans[kDefaultVlan] = vlan;
+    defaultVlan = kDefaultVlan;
+
+    opennsl_l3_egress_t drop;
+    memset(&drop, 0, sizeof(drop));
+    drop.flags = OPENNSL_L3_DST_DISCARD;
+    egresses[kDropEgressId] = drop;
+  }
+
+  void shutdown() {
+    linkscanHandler = nullptr;
+    linkscanInterval = 0;
+    rxCallback = nullptr;
+  }
+};
+
+Asic& asic() {
+  static auto a = new Asic();
+  return *a;
+}
+
+void spin(nanoseconds latency) {
+  if (latency.count() == 0) {
+    return;
+  }
+  auto end = steady_clock::now() + latency;
+  while (steady_clock::now() < end) {
+  }
+}
+
+// The lowest unused ID from *next up, wrapping around from last to first
+template<typename Map>
+int allocateId(const Map& used, int first, int last, int* next) {
+  for (int i = first; i < last; ++i) {
+    auto id = *next;
+    *next = id + 1 < last ? id + 1 : first;
+    if (used.find(id) == used.end()) {
+      return id;
+    }
+  }
+  return -1;
+}
+
+template<typename T>
+void appendBytes(string* key, const T& value) {
+  key->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+string hostKey(const opennsl_l3_host_t* host) {
+  string key;
+  appendBytes(&key, host->l3a_vrf);
+  if (host->l3a_flags & OPENNSL_L3_IP6) {
+    appendBytes(&key, host->l3a_ip6_addr);
+  } else {
+    appendBytes(&key, host->l3a_ip_addr);
+  }
+  return key;
+}
+
+string routeKey(const opennsl_l3_route_t* route) {
+  string key;
+  appendBytes(&key, route->l3a_vrf);
+  if (route->l3a_flags & OPENNSL_L3_IP6) {
+    appendBytes(&key, route->l3a_ip6_net);
+    appendBytes(&key, route->l3a_ip6_mask);
+  } else {
+    appendBytes(&key, route->l3a_subnet);
+    appendBytes(&key, route->l3a_ip_mask);
+  }
+  return key;
+}
+
+// Flags which only say how to add an entry, and aren't part of it
+constexpr uint32 kAddFlags = OPENNSL_L3_REPLACE | OPENNSL_L3_WITH_ID;
+
+// Add or replace an entry keyed by what it matches, as hosts and routes are
+template<typename Map, typename Entry>
+int addEntry(Map* table, string key, const Entry* entry, uint32_t limit) {
+  auto it = table->find(key);
+  if (it == table->end()) {
+    if (table->size() >= limit) {
+      return OPENNSL_E_FULL;
+    }
+  } else if (!(entry->l3a_flags & OPENNSL_L3_REPLACE)) {
+    return OPENNSL_E_EXISTS;
+  }
+  auto& stored = (*table)[std::move(key)];
+  stored = *entry;
+  stored.l3a_flags &= ~kAddFlags;
+  return OPENNSL_E_NONE;
+}
+
+/*
+ * Call cb on each entry for the address family flags asks for, with
+ * index in [start, end].  The entries are copied out first, so that the
+ * callbacks may call back into the SDK.
+ */
+template<typename Map, typename Entry, typename Callback>
+int traverse(const Map& table, uint32 flags, uint32 start, uint32 end,
+             Callback cb, void* userData) {
+  std::vector<Entry> entries;
+  {
+    std::lock_guard<std::mutex> g(asic().lock);
+    for (const auto& entry : table) {
+      if ((entry.second.l3a_flags & OPENNSL_L3_IP6) ==
+          (flags & OPENNSL_L3_IP6)) {
+        entries.push_back(entry.second);
+      }
+    }
+  }
+  for (uint32 index = start; index < entries.size() && index <= end;
+       ++index) {
+    auto rv = cb(0, index, &entries[index], userData);
+    if (OPENNSL_FAILURE(rv)) {
+      return rv;
+    }
+  }
+  return OPENNSL_E_NONE;
+}
+
+} // unnamed namespace
+
+namespace facebook { namespace fboss {
+
+void FakeOpenNSL::setLimits(const Limits& limits) {
+  std::lock_guard<std::mutex> g(asic().lock);
+  asic().limits = limits;
+}
+
+FakeOpenNSL::Limits FakeOpenNSL::getLimits() {
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().limits;
+}
+
+void FakeOpenNSL::setCallLatency(nanoseconds latency) {
+  std::lock_guard<std::mutex> g(calls().lock);
+  calls().latency = latency;
+}
+
+void FakeOpenNSL::setCallLatency(folly::StringPiece function,
+                                 nanoseconds latency) {
+  std::lock_guard<std::mutex> g(calls().lock);
+  calls().latencies[function.str()] = latency;
+}
+
+uint64_t FakeOpenNSL::numCalls(folly::StringPiece function) {
+  std::lock_guard<std::mutex> g(calls().lock);
+  auto it = calls().counts.find(function.str());
+  return it == calls().counts.end() ? 0 : it->second;
+}
+
+uint64_t FakeOpenNSL::totalCalls() {
+  std::lock_guard<std::mutex> g(calls().lock);
+  uint64_t total = 0;
+  for (const auto& call : calls().counts) {
+    total += call.second;
+  }
+  return total;
+}
+
+void FakeOpenNSL::resetCalls() {
+  std::lock_guard<std::mutex> g(calls().lock);
+  calls().counts.clear();
+}
+
+size_t FakeOpenNSL::numRoutes() {
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().routes.size();
+}
+
+size_t FakeOpenNSL::numHosts() {
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().hosts.size();
+}
+
+size_t FakeOpenNSL::numEgresses() {
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().egresses.size() - asic().egresses.count(kDropEgressId);
+}
+
+size_t FakeOpenNSL::numEcmpGroups() {
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().ecmps.size();
+}
+
+size_t FakeOpenNSL::numEcmpPaths() {
+  std::lock_guard<std::mutex> g(asic().lock);
+  size_t paths = 0;
+  for (const auto& ecmp : asic().ecmps) {
+    paths += ecmp.second.paths.size();
+  }
+  return paths;
+}
+
+size_t FakeOpenNSL::numL3Intfs() {
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().intfs.size();
+}
+
+size_t FakeOpenNSL::numVlans() {
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().vlans.size();
+}
+
+void FakeOpenNSL::setLinkState(int port, bool up) {
+  opennsl_linkscan_handler_t handler;
+  opennsl_port_info_t info;
+  memset(&info, 0, sizeof(info));
+  {
+    auto& a = asic();
+    std::lock_guard<std::mutex> g(a.lock);
+    CHECK(a.validPort(port) && port != kCpuPort) << "no port " << port;
+    auto& p = a.ports[port];
+    if (p.linkUp == up) {
+      return;
+    }
+    p.linkUp = up;
+    if (!p.enabled || p.linkscanMode == OPENNSL_LINKSCAN_MODE_NONE ||
+        a.linkscanInterval <= 0) {
+      return;
+    }
+    handler = a.linkscanHandler;
+    info.linkstatus = up ? OPENNSL_PORT_LINK_STATUS_UP :
+      OPENNSL_PORT_LINK_STATUS_DOWN;
+  }
+  if (handler) {
+    handler(0, port, &info);
+  }
+}
+
+void FakeOpenNSL::setPortStat(int port, int stat, uint64_t value) {
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  CHECK(a.validPort(port)) << "no port " << port;
+  a.ports[port].stats[stat] = value;
+}
+
+void FakeOpenNSL::recordCall(const char* function) {
+  nanoseconds latency;
+  {
+    auto& c = calls();
+    std::lock_guard<std::mutex> g(c.lock);
+    ++c.counts[function];
+    auto it = c.latencies.find(function);
+    latency = it == c.latencies.end() ? c.latency : it->second;
+  }
+  spin(latency);
+}
+
+}} // facebook::fboss
+
+using facebook::fboss::FakeOpenNSL;
+
+extern "C" {
+
+char* _shr_errmsg[] = {
+  const_cast<char*>("Ok"),
+  const_cast<char*>("Internal error"),
+  const_cast<char*>("Out of memory"),
+  const_cast<char*>("Invalid unit"),
+  const_cast<char*>("Invalid parameter"),
+  const_cast<char*>("Table empty"),
+  const_cast<char*>("Table full"),
+  const_cast<char*>("Entry not found"),
+  const_cast<char*>("Entry exists"),
+  const_cast<char*>("Operation timed out"),
+  const_cast<char*>("Operation still running"),
+  const_cast<char*>("Operation failed"),
+  const_cast<char*>("Operation disabled"),
+  const_cast<char*>("Invalid identifier"),
+  const_cast<char*>("No resources for operation"),
+  const_cast<char*>("Invalid configuration"),
+  const_cast<char*>("Feature unavailable"),
+  const_cast<char*>("Feature not initialized"),
+  const_cast<char*>("Invalid port"),
+  const_cast<char*>("Unknown error"),
+};
+
+/*
+ * Initialization
+ */
+
+int opennsl_driver_init() {
+  FakeOpenNSL::recordCall(__func__);
+  auto bootFlags = getenv("SOC_BOOT_FLAGS");
+  bool warmBoot = bootFlags && (strtoul(bootFlags, nullptr, 0) & kWarmBootFlag);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  a.shutdown();
+  if (!warmBoot) {
+    a.coldBoot();
+  }
+  return OPENNSL_E_NONE;
+}
+
+int _opennsl_shutdown(int unit) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  asic().shutdown();
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_detach(int unit) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  asic().shutdown();
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_switch_event_register(int unit, opennsl_switch_event_cb_t cb,
+                                  void* userdata) {
+  FakeOpenNSL::recordCall(__func__);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_switch_control_set(int unit, opennsl_switch_control_t type,
+                               int arg) {
+  FakeOpenNSL::recordCall(__func__);
+  return OPENNSL_E_NONE;
+}
+
+/*
+ * Ports
+ */
+
+int opennsl_port_config_get(int unit, opennsl_port_config_t* config) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  memset(config, 0, sizeof(*config));
+  for (const auto& port : a.ports) {
+    OPENNSL_PBMP_PORT_ADD(config->all, port.first);
+    if (port.first == kCpuPort) {
+      OPENNSL_PBMP_PORT_ADD(config->cpu, port.first);
+    } else {
+      OPENNSL_PBMP_PORT_ADD(config->port, port.first);
+      OPENNSL_PBMP_PORT_ADD(config->e, port.first);
+      OPENNSL_PBMP_PORT_ADD(config->xe, port.first);
+    }
+  }
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_control_set(int unit, opennsl_port_t port,
+                             opennsl_port_control_t type, int value) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().validPort(port) ? OPENNSL_E_NONE : OPENNSL_E_PORT;
+}
+
+int opennsl_port_gport_get(int unit, opennsl_port_t port,
+                           opennsl_gport_t* gport) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  if (!asic().validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  *gport = port;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_enable_get(int unit, opennsl_port_t port, int* enable) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  *enable = a.ports[port].enabled;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_enable_set(int unit, opennsl_port_t port, int enable) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  a.ports[port].enabled = enable;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_link_status_get(int unit, opennsl_port_t port, int* status) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  const auto& p = a.ports[port];
+  *status = p.enabled && p.linkUp ? OPENNSL_PORT_LINK_STATUS_UP :
+    OPENNSL_PORT_LINK_STATUS_DOWN;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_speed_get(int unit, opennsl_port_t port, int* speed) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  *speed = a.ports[port].speed;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_speed_max(int unit, opennsl_port_t port, int* speed) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  if (!asic().validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  *speed = kPortSpeed;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_speed_set(int unit, opennsl_port_t port, int speed) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  if (speed <= 0 || speed > kPortSpeed) {
+    return OPENNSL_E_PARAM;
+  }
+  a.ports[port].speed = speed;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_interface_get(int unit, opennsl_port_t port,
+                               opennsl_port_if_t* intf) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  *intf = a.ports[port].intf;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_interface_set(int unit, opennsl_port_t port,
+                               opennsl_port_if_t intf) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  a.ports[port].intf = intf;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_untagged_vlan_get(int unit, opennsl_port_t port,
+                                   opennsl_vlan_t* vid) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  *vid = a.ports[port].untaggedVlan;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_untagged_vlan_set(int unit, opennsl_port_t port,
+                                   opennsl_vlan_t vid) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  if (a.vlans.find(vid) == a.vlans.end()) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  a.ports[port].untaggedVlan = vid;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_port_vlan_member_set(int unit, opennsl_port_t port, uint32 flags) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().validPort(port) ? OPENNSL_E_NONE : OPENNSL_E_PORT;
+}
+
+int opennsl_port_stat_enable_set(int unit, opennsl_gport_t port, int enable) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().validPort(port) ? OPENNSL_E_NONE : OPENNSL_E_PORT;
+}
+
+int opennsl_port_queued_count_get(int unit, opennsl_port_t port,
+                                  uint32* count) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  if (!asic().validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  *count = 0;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_stat_get(int unit, opennsl_port_t port, opennsl_stat_val_t type,
+                     uint64* value) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  *value = a.ports[port].stats[type];
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_stat_multi_get(int unit, opennsl_port_t port, int nstat,
+                           opennsl_stat_val_t* stat_arr, uint64* value_arr) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  auto& stats = a.ports[port].stats;
+  for (int i = 0; i < nstat; ++i) {
+    value_arr[i] = stats[stat_arr[i]];
+  }
+  return OPENNSL_E_NONE;
+}
+
+/*
+ * Linkscan and spanning tree
+ */
+
+int opennsl_linkscan_register(int unit, opennsl_linkscan_handler_t f) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (a.linkscanHandler) {
+    return OPENNSL_E_EXISTS;
+  }
+  a.linkscanHandler = f;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_linkscan_unregister(int unit, opennsl_linkscan_handler_t f) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (a.linkscanHandler != f) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  a.linkscanHandler = nullptr;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_linkscan_enable_set(int unit, int us) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  asic().linkscanInterval = us;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_linkscan_mode_set(int unit, opennsl_port_t port, int mode) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validPort(port)) {
+    return OPENNSL_E_PORT;
+  }
+  a.ports[port].linkscanMode = mode;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_linkscan_detach(int unit) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  a.linkscanHandler = nullptr;
+  a.linkscanInterval = 0;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_stg_stp_set(int unit, opennsl_stg_t stg, opennsl_port_t port,
+                        int stp_state) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().validPort(port) ? OPENNSL_E_NONE : OPENNSL_E_PORT;
+}
+
+/*
+ * VLANs
+ */
+
+int opennsl_vlan_create(int unit, opennsl_vlan_t vid) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (a.vlans.find(vid) != a.vlans.end()) {
+    return OPENNSL_E_EXISTS;
+  }
+  if (a.vlans.size() >= a.limits.maxVlans) {
+    return OPENNSL_E_FULL;
+  }
+  auto& vlan = a.vlans[vid];
+  memset(&vlan, 0, sizeof(vlan));
+  vlan.vlan_tag = vid;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_vlan_destroy(int unit, opennsl_vlan_t vid) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (vid == a.defaultVlan) {
+    return OPENNSL_E_BADID;
+  }
+  return a.vlans.erase(vid) ? OPENNSL_E_NONE : OPENNSL_E_NOT_FOUND;
+}
+
+int opennsl_vlan_port_add(int unit, opennsl_vlan_t vid, opennsl_pbmp_t pbmp,
+                          opennsl_pbmp_t ubmp) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  auto it = a.vlans.find(vid);
+  if (it == a.vlans.end()) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  auto& vlan = it->second;
+  opennsl_pbmp_t untagged;
+  OPENNSL_PBMP_ASSIGN(untagged, pbmp);
+  OPENNSL_PBMP_AND(untagged, ubmp);
+  OPENNSL_PBMP_OR(vlan.port_bitmap, pbmp);
+  OPENNSL_PBMP_REMOVE(vlan.ut_port_bitmap, pbmp);
+  OPENNSL_PBMP_OR(vlan.ut_port_bitmap, untagged);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_vlan_port_remove(int unit, opennsl_vlan_t vid,
+                             opennsl_pbmp_t pbmp) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  auto it = a.vlans.find(vid);
+  if (it == a.vlans.end()) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  OPENNSL_PBMP_REMOVE(it->second.port_bitmap, pbmp);
+  OPENNSL_PBMP_REMOVE(it->second.ut_port_bitmap, pbmp);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_vlan_gport_delete_all(int unit, opennsl_vlan_t vlan) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  auto it = a.vlans.find(vlan);
+  if (it == a.vlans.end()) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  OPENNSL_PBMP_CLEAR(it->second.port_bitmap);
+  OPENNSL_PBMP_CLEAR(it->second.ut_port_bitmap);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_vlan_default_get(int unit, opennsl_vlan_t* vid) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  *vid = asic().defaultVlan;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_vlan_default_set(int unit, opennsl_vlan_t vid) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (a.vlans.find(vid) == a.vlans.end()) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  a.defaultVlan = vid;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_vlan_list(int unit, opennsl_vlan_data_t** listp, int* countp) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  *countp = a.vlans.size();
+  *listp = nullptr;
+  if (a.vlans.empty()) {
+    return OPENNSL_E_NONE;
+  }
+  *listp = new opennsl_vlan_data_t[a.vlans.size()];
+  int i = 0;
+  for (const auto& vlan : a.vlans) {
+    (*listp)[i++] = vlan.second;
+  }
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_vlan_list_destroy(int unit, opennsl_vlan_data_t* list,
+                              int count) {
+  FakeOpenNSL::recordCall(__func__);
+  delete[] list;
+  return OPENNSL_E_NONE;
+}
+
+/*
+ * L2 stations
+ */
+
+void opennsl_l2_station_t_init(opennsl_l2_station_t* addr) {
+  memset(addr, 0, sizeof(*addr));
+}
+
+int opennsl_l2_station_add(int unit, int* station_id,
+                           opennsl_l2_station_t* station) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (station->flags & OPENNSL_L2_STATION_WITH_ID) {
+    if (a.stations.find(*station_id) != a.stations.end()) {
+      return OPENNSL_E_EXISTS;
+    }
+  }
+  if (a.stations.size() >= a.limits.maxStations) {
+    return OPENNSL_E_FULL;
+  }
+  if (!(station->flags & OPENNSL_L2_STATION_WITH_ID)) {
+    // Above the IDs BcmIntf uses, which are VLAN IDs
+    int next = 1 << 12;
+    *station_id = allocateId(a.stations, next, 1 << 16, &next);
+  }
+  auto& stored = a.stations[*station_id];
+  stored = *station;
+  stored.flags &= ~OPENNSL_L2_STATION_WITH_ID;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_l2_station_delete(int unit, int station_id) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().stations.erase(station_id) ?
+    OPENNSL_E_NONE : OPENNSL_E_NOT_FOUND;
+}
+
+int opennsl_l2_station_get(int unit, int station_id,
+                           opennsl_l2_station_t* station) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  auto it = a.stations.find(station_id);
+  if (it == a.stations.end()) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  *station = it->second;
+  return OPENNSL_E_NONE;
+}
+
+/*
+ * L3 interfaces
+ */
+
+void opennsl_l3_intf_t_init(opennsl_l3_intf_t* intf) {
+  memset(intf, 0, sizeof(*intf));
+}
+
+int opennsl_l3_intf_create(int unit, opennsl_l3_intf_t* intf) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (intf->l3a_flags & OPENNSL_L3_WITH_ID) {
+    auto it = a.intfs.find(intf->l3a_intf_id);
+    if (it != a.intfs.end()) {
+      if (!(intf->l3a_flags & OPENNSL_L3_REPLACE)) {
+        return OPENNSL_E_EXISTS;
+      }
+      it->second = *intf;
+      it->second.l3a_flags &= ~kAddFlags;
+      return OPENNSL_E_NONE;
+    }
+  } else if (intf->l3a_flags & OPENNSL_L3_REPLACE) {
+    return OPENNSL_E_PARAM;
+  }
+  if (a.intfs.size() >= a.limits.maxL3Intfs) {
+    return OPENNSL_E_FULL;
+  }
+  if (!(intf->l3a_flags & OPENNSL_L3_WITH_ID)) {
+    intf->l3a_intf_id = allocateId(a.intfs, 1, a.limits.maxL3Intfs + 1,
+                                   &a.nextIntfId);
+  }
+  auto& stored = a.intfs[intf->l3a_intf_id];
+  stored = *intf;
+  stored.l3a_flags &= ~kAddFlags;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_l3_intf_delete(int unit, opennsl_l3_intf_t* intf) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().intfs.erase(intf->l3a_intf_id) ?
+    OPENNSL_E_NONE : OPENNSL_E_NOT_FOUND;
+}
+
+int opennsl_l3_intf_find_vlan(int unit, opennsl_l3_intf_t* intf) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  for (const auto& entry : a.intfs) {
+    if (entry.second.l3a_vid == intf->l3a_vid) {
+      *intf = entry.second;
+      return OPENNSL_E_NONE;
+    }
+  }
+  return OPENNSL_E_NOT_FOUND;
+}
+
+void opennsl_l3_info_t_init(opennsl_l3_info_t* info) {
+  memset(info, 0, sizeof(*info));
+}
+
+int opennsl_l3_info(int unit, opennsl_l3_info_t* l3info) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  constexpr uint32_t kMax = std::numeric_limits<int>::max();
+  l3info->l3info_max_host = std::min(a.limits.maxHosts, kMax);
+  l3info->l3info_max_route = std::min(a.limits.maxRoutes, kMax);
+  return OPENNSL_E_NONE;
+}
+
+/*
+ * Egress and ECMP egress objects
+ */
+
+void opennsl_l3_egress_t_init(opennsl_l3_egress_t* egr) {
+  memset(egr, 0, sizeof(*egr));
+}
+
+int opennsl_l3_egress_create(int unit, uint32 flags, opennsl_l3_egress_t* egr,
+                             opennsl_if_t* if_id) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (flags & OPENNSL_L3_WITH_ID) {
+    auto it = a.egresses.find(*if_id);
+    if (it != a.egresses.end()) {
+      if (!(flags & OPENNSL_L3_REPLACE)) {
+        return OPENNSL_E_EXISTS;
+      }
+      it->second = *egr;
+      return OPENNSL_E_NONE;
+    }
+    if (*if_id <= kDropEgressId || *if_id >= kFirstEcmpId) {
+      return OPENNSL_E_BADID;
+    }
+  } else if (flags & OPENNSL_L3_REPLACE) {
+    return OPENNSL_E_PARAM;
+  }
+  // The drop egress doesn't take up an entry
+  if (a.egresses.size() > a.limits.maxEgresses) {
+    return OPENNSL_E_FULL;
+  }
+  if (!(flags & OPENNSL_L3_WITH_ID)) {
+    *if_id = allocateId(a.egresses, kDropEgressId + 1, kFirstEcmpId,
+                        &a.nextEgressId);
+    if (*if_id < 0) {
+      return OPENNSL_E_RESOURCE;
+    }
+  }
+  a.egresses[*if_id] = *egr;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_l3_egress_destroy(int unit, opennsl_if_t intf) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (intf == kDropEgressId) {
+    return OPENNSL_E_BADID;
+  }
+  return a.egresses.erase(intf) ? OPENNSL_E_NONE : OPENNSL_E_NOT_FOUND;
+}
+
+int opennsl_l3_egress_get(int unit, opennsl_if_t intf,
+                          opennsl_l3_egress_t* egr) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  auto it = a.egresses.find(intf);
+  if (it == a.egresses.end()) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  *egr = it->second;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_l3_egress_traverse(int unit,
+                               opennsl_l3_egress_traverse_cb trav_fn,
+                               void* user_data) {
+  FakeOpenNSL::recordCall(__func__);
+  std::vector<std::pair<opennsl_if_t, opennsl_l3_egress_t>> egresses;
+  {
+    std::lock_guard<std::mutex> g(asic().lock);
+    egresses.assign(asic().egresses.begin(), asic().egresses.end());
+  }
+  for (auto& egress : egresses) {
+    auto rv = trav_fn(unit, egress.first, &egress.second, user_data);
+    if (OPENNSL_FAILURE(rv)) {
+      return rv;
+    }
+  }
+  return OPENNSL_E_NONE;
+}
+
+void opennsl_l3_egress_ecmp_t_init(opennsl_l3_egress_ecmp_t* ecmp) {
+  memset(ecmp, 0, sizeof(*ecmp));
+}
+
+int opennsl_l3_egress_ecmp_create(int unit, opennsl_l3_egress_ecmp_t* ecmp,
+                                  int intf_count, opennsl_if_t* intf_array) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (intf_count < 0 || intf_count > a.limits.maxEcmpPaths) {
+    return OPENNSL_E_PARAM;
+  }
+  for (int i = 0; i < intf_count; ++i) {
+    if (a.egresses.find(intf_array[i]) == a.egresses.end()) {
+      return OPENNSL_E_NOT_FOUND;
+    }
+  }
+  opennsl_if_t id = ecmp->ecmp_intf;
+  if (ecmp->flags & OPENNSL_L3_WITH_ID) {
+    auto it = a.ecmps.find(id);
+    if (it != a.ecmps.end() && !(ecmp->flags & OPENNSL_L3_REPLACE)) {
+      return OPENNSL_E_EXISTS;
+    } else if (it == a.ecmps.end() &&
+               (id < kFirstEcmpId || id >= kLastEcmpId)) {
+      return OPENNSL_E_BADID;
+    }
+  } else if (ecmp->flags & OPENNSL_L3_REPLACE) {
+    return OPENNSL_E_PARAM;
+  }
+  if (a.ecmps.find(id) == a.ecmps.end()) {
+    if (a.ecmps.size() >= a.limits.maxEcmpGroups) {
+      return OPENNSL_E_FULL;
+    }
+    if (!(ecmp->flags & OPENNSL_L3_WITH_ID)) {
+      id = allocateId(a.ecmps, kFirstEcmpId, kLastEcmpId, &a.nextEcmpId);
+      ecmp->ecmp_intf = id;
+    }
+  }
+  auto& stored = a.ecmps[id];
+  stored.ecmp = *ecmp;
+  stored.ecmp.flags &= ~kAddFlags;
+  stored.paths.assign(intf_array, intf_array + intf_count);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_l3_egress_ecmp_destroy(int unit, opennsl_l3_egress_ecmp_t* ecmp) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().ecmps.erase(ecmp->ecmp_intf) ?
+    OPENNSL_E_NONE : OPENNSL_E_NOT_FOUND;
+}
+
+int opennsl_l3_egress_ecmp_add(int unit, opennsl_l3_egress_ecmp_t* ecmp,
+                               opennsl_if_t intf) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  auto it = a.ecmps.find(ecmp->ecmp_intf);
+  if (it == a.ecmps.end() || a.egresses.find(intf) == a.egresses.end()) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  auto& paths = it->second.paths;
+  if (std::find(paths.begin(), paths.end(), intf) != paths.end()) {
+    return OPENNSL_E_EXISTS;
+  }
+  auto maxPaths = it->second.ecmp.max_paths ?
+    it->second.ecmp.max_paths : a.limits.maxEcmpPaths;
+  if (paths.size() >= static_cast<size_t>(maxPaths)) {
+    return OPENNSL_E_FULL;
+  }
+  paths.push_back(intf);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_l3_egress_ecmp_delete(int unit, opennsl_l3_egress_ecmp_t* ecmp,
+                                  opennsl_if_t intf) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  auto it = a.ecmps.find(ecmp->ecmp_intf);
+  if (it == a.ecmps.end()) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  auto& paths = it->second.paths;
+  auto path = std::find(paths.begin(), paths.end(), intf);
+  if (path == paths.end()) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  paths.erase(path);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_l3_egress_ecmp_traverse(
+    int unit,
+    opennsl_l3_egress_ecmp_traverse_cb trav_fn,
+    void* user_data) {
+  FakeOpenNSL::recordCall(__func__);
+  std::vector<Ecmp> ecmps;
+  {
+    std::lock_guard<std::mutex> g(asic().lock);
+    for (const auto& ecmp : asic().ecmps) {
+      ecmps.push_back(ecmp.second);
+    }
+  }
+  for (auto& ecmp : ecmps) {
+    auto rv = trav_fn(unit, &ecmp.ecmp, ecmp.paths.size(), ecmp.paths.data(),
+                      user_data);
+    if (OPENNSL_FAILURE(rv)) {
+      return rv;
+    }
+  }
+  return OPENNSL_E_NONE;
+}
+
+/*
+ * Hosts and routes
+ */
+
+void opennsl_l3_host_t_init(opennsl_l3_host_t* ip) {
+  memset(ip, 0, sizeof(*ip));
+}
+
+int opennsl_l3_host_add(int unit, opennsl_l3_host_t* info) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validEgress(info->l3a_intf)) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  return addEntry(&a.hosts, hostKey(info), info, a.limits.maxHosts);
+}
+
+int opennsl_l3_host_delete(int unit, opennsl_l3_host_t* ip_addr) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().hosts.erase(hostKey(ip_addr)) ?
+    OPENNSL_E_NONE : OPENNSL_E_NOT_FOUND;
+}
+
+int opennsl_l3_host_traverse(int unit, uint32 flags, uint32 start, uint32 end,
+                             opennsl_l3_host_traverse_cb cb,
+                             void* user_data) {
+  FakeOpenNSL::recordCall(__func__);
+  return traverse<decltype(asic().hosts), opennsl_l3_host_t>(
+      asic().hosts, flags, start, end, cb, user_data);
+}
+
+void opennsl_l3_route_t_init(opennsl_l3_route_t* info) {
+  memset(info, 0, sizeof(*info));
+}
+
+int opennsl_l3_route_add(int unit, opennsl_l3_route_t* info) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (!a.validEgress(info->l3a_intf)) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  return addEntry(&a.routes, routeKey(info), info, a.limits.maxRoutes);
+}
+
+int opennsl_l3_route_delete(int unit, opennsl_l3_route_t* info) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  return asic().routes.erase(routeKey(info)) ?
+    OPENNSL_E_NONE : OPENNSL_E_NOT_FOUND;
+}
+
+int opennsl_l3_route_traverse(int unit, uint32 flags, uint32 start,
+                              uint32 end, opennsl_l3_route_traverse_cb trav_fn,
+                              void* user_data) {
+  FakeOpenNSL::recordCall(__func__);
+  return traverse<decltype(asic().routes), opennsl_l3_route_t>(
+      asic().routes, flags, start, end, trav_fn, user_data);
+}
+
+/*
+ * Packet I/O.  Nothing is ever received, and sent packets are completed
+ * and dropped straight away.
+ */
+
+int opennsl_rx_register(int unit, const char* name, opennsl_rx_cb_f callback,
+                        uint8 priority, void* cookie, uint32 flags) {
+  FakeOpenNSL::recordCall(__func__);
+  std::lock_guard<std::mutex> g(asic().lock);
+  asic().rxCallback = callback;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_rx_unregister(int unit, opennsl_rx_cb_f callback,
+                          uint8 priority) {
+  FakeOpenNSL::recordCall(__func__);
+  auto& a = asic();
+  std::lock_guard<std::mutex> g(a.lock);
+  if (a.rxCallback != callback) {
+    return OPENNSL_E_NOT_FOUND;
+  }
+  a.rxCallback = nullptr;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_rx_start(int unit, opennsl_rx_cfg_t* cfg) {
+  FakeOpenNSL::recordCall(__func__);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_rx_stop(int unit, opennsl_rx_cfg_t* cfg) {
+  FakeOpenNSL::recordCall(__func__);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_rx_free(int unit, void* pkt_data) {
+  free(pkt_data);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_pkt_alloc(int unit, int size, uint32 flags,
+                      opennsl_pkt_t** pkt_buf) {
+  FakeOpenNSL::recordCall(__func__);
+  auto pkt = static_cast<opennsl_pkt_t*>(calloc(1, sizeof(opennsl_pkt_t)));
+  auto data = static_cast<uint8*>(malloc(size));
+  if (!pkt || !data) {
+    free(pkt);
+    free(data);
+    return OPENNSL_E_MEMORY;
+  }
+  pkt->unit = unit;
+  pkt->flags = flags;
+  pkt->_pkt_data.data = data;
+  pkt->_pkt_data.len = size;
+  pkt->pkt_data = &pkt->_pkt_data;
+  pkt->blk_count = 1;
+  *pkt_buf = pkt;
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_pkt_free(int unit, opennsl_pkt_t* pkt) {
+  FakeOpenNSL::recordCall(__func__);
+  free(pkt->_pkt_data.data);
+  free(pkt);
+  return OPENNSL_E_NONE;
+}
+
+int opennsl_tx(int unit, opennsl_pkt_t* tx_pkt, void* cookie) {
+  FakeOpenNSL::recordCall(__func__);
+  if (tx_pkt->call_back) {
+    tx_pkt->call_back(unit, tx_pkt, cookie);
+  }
+  return OPENNSL_E_NONE;
+}
+
+} // extern "C"
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+
+#include <chrono>
+#include <cstdint>
+
+namespace facebook { namespace fboss {
+
+/*
+ * A stand-in for the OpenNSL SDK, to run BcmSwitch without a switch ASIC.
+ *
+ * FakeOpenNSL.cpp is linked in place of libopennsl, and implements the
+ * opennsl_* functions the agent calls.  The ASIC's tables (routes, hosts,
+ * egress and ECMP objects, L3 interfaces, stations, VLANs and ports) are
+ * kept in memory, and the calls check and update them the way the SDK
+ * does: adding an existing entry without OPENNSL_L3_REPLACE fails with
+ * OPENNSL_E_EXISTS, adding to a full table fails with OPENNSL_E_FULL, and
+ * so on.
+ *
+ * As with the real SDK, opennsl_driver_init() wipes the tables unless
+ * SOC_BOOT_FLAGS asks for a warm boot, so a BcmSwitch warm booting after
+ * gracefulExit() finds what the previous one programmed.
+ *
+ * There is only one ASIC, and unit numbers are ignored.  Callbacks
+ * (linkscan, packet tx completion) are run synchronously in the calling
+ * thread, rather than from SDK threads.
+ */
+class FakeOpenNSL {
+ public:
+  /*
+   * The sizes of the ASIC's tables.  The defaults leave room for a full
+   * Internet table; lower them to see how the agent copes with a full
+   * table.  Only read on cold boot.
+   */
+  struct Limits {
+    // Front panel ports are numbered from 1, the CPU port is 0
+    uint32_t numPorts{32};
+    uint32_t maxRoutes{2000000};
+    uint32_t maxHosts{1000000};
+    uint32_t maxEgresses{32768};
+    uint32_t maxEcmpGroups{1024};
+    uint32_t maxEcmpPaths{128};
+    uint32_t maxL3Intfs{4096};
+    uint32_t maxStations{1024};
+    uint32_t maxVlans{4094};
+  };
+  static void setLimits(const Limits& limits);
+  static Limits getLimits();
+
+  /*
+   * Spin for this long in each SDK call that would access the ASIC, to
+   * stand in for the cost of the SDK and PCIe.  A per-function latency
+   * overrides the default one.
+   */
+  static void setCallLatency(std::chrono::nanoseconds latency);
+  static void setCallLatency(folly::StringPiece function,
+                             std::chrono::nanoseconds latency);
+
+  // The number of calls made to the given opennsl_* function
+  static uint64_t numCalls(folly::StringPiece function);
+  // The number of calls made to all of the opennsl_* functions
+  static uint64_t totalCalls();
+  // Forget all calls made so far
+  static void resetCalls();
+
+  // The number of entries in each table
+  static size_t numRoutes();
+  static size_t numHosts();
+  // Not counting the drop egress, which always exists
+  static size_t numEgresses();
+  static size_t numEcmpGroups();
+  // The number of paths in all of the ECMP groups together
+  static size_t numEcmpPaths();
+  static size_t numL3Intfs();
+  static size_t numVlans();
+
+  /*
+   * Bring the link of a front panel port up or down, and report it to the
+   * linkscan handler if linkscan is enabled on the port.
+   */
+  static void setLinkState(int port, bool up);
+
+  // Set a counter read by opennsl_stat_get() and opennsl_stat_multi_get()
+  static void setPortStat(int port, int stat, uint64_t value);
+
+  static void recordCall(const char* function);
+};
+
+}} // facebook::fboss
@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/test/FakeOpenNSL.h"
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <opennsl/error.h>
+#include <opennsl/l3.h>
+#include <opennsl/link.h>
+#include <opennsl/port.h>
+#include <sal/driver.h>
+}
+
+#include <stdlib.h>
+#include <vector>
+
+using namespace facebook::fboss;
+
+namespace {
+
+const int kUnit = 0;
+
+void boot(bool warm) {
+  if (warm) {
+    setenv("SOC_BOOT_FLAGS", "0x200000", 1);
+  } else {
+    unsetenv("SOC_BOOT_FLAGS");
+  }
+  ASSERT_EQ(OPENNSL_E_NONE, opennsl_driver_init());
+}
+
+opennsl_if_t createEgress() {
+  opennsl_l3_egress_t egress;
+  opennsl_l3_egress_t_init(&egress);
+  opennsl_if_t id;
+  EXPECT_EQ(OPENNSL_E_NONE,
+            opennsl_l3_egress_create(kUnit, 0, &egress, &id));
+  return id;
+}
+
+int addRoute(uint32_t subnet, opennsl_if_t egress, uint32_t flags = 0) {
+  opennsl_l3_route_t route;
+  opennsl_l3_route_t_init(&route);
+  route.l3a_subnet = subnet;
+  route.l3a_ip_mask = 0xffffff00;
+  route.l3a_intf = egress;
+  route.l3a_flags = flags;
+  return opennsl_l3_route_add(kUnit, &route);
+}
+
+opennsl_if_t createEcmp(std::vector<opennsl_if_t> paths) {
+  opennsl_l3_egress_ecmp_t ecmp;
+  opennsl_l3_egress_ecmp_t_init(&ecmp);
+  ecmp.max_paths = 4;
+  EXPECT_EQ(OPENNSL_E_NONE,
+            opennsl_l3_egress_ecmp_create(kUnit, &ecmp, paths.size(),
+                                          paths.data()));
+  return ecmp.ecmp_intf;
+}
+
+int linkUpdates = 0;
+int lastLinkStatus = -1;
+
+void linkscanHandler(int unit, opennsl_port_t port,
+                     opennsl_port_info_t* info) {
+  ++linkUpdates;
+  lastLinkStatus = info->linkstatus;
+}
+
+} // unnamed namespace
+
+TEST(FakeOpenNSL, ColdBootWipesTables) {
+  FakeOpenNSL::setLimits(FakeOpenNSL::Limits());
+  boot(false);
+  auto egress = createEgress();
+  EXPECT_EQ(OPENNSL_E_NONE, addRoute(0x0a000000, egress));
+  EXPECT_EQ(1, FakeOpenNSL::numRoutes());
+
+  boot(true);
+  EXPECT_EQ(1, FakeOpenNSL::numRoutes());
+  EXPECT_EQ(1, FakeOpenNSL::numEgresses());
+
+  boot(false);
+  EXPECT_EQ(0, FakeOpenNSL::numRoutes());
+  EXPECT_EQ(0, FakeOpenNSL::numEgresses());
+  // The drop egress is always there
+  opennsl_l3_egress_t drop;
+  ASSERT_EQ(OPENNSL_E_NONE, opennsl_l3_egress_get(kUnit, 100000, &drop));
+  EXPECT_TRUE(drop.flags & OPENNSL_L3_DST_DISCARD);
+}
+
+TEST(FakeOpenNSL, AddExistingEntry) {
+  FakeOpenNSL::setLimits(FakeOpenNSL::Limits());
+  boot(false);
+  auto egress = createEgress();
+  EXPECT_EQ(OPENNSL_E_NONE, addRoute(0x0a000000, egress));
+  EXPECT_EQ(OPENNSL_E_EXISTS, addRoute(0x0a000000, egress));
+  EXPECT_EQ(OPENNSL_E_NONE,
+            addRoute(0x0a000000, egress, OPENNSL_L3_REPLACE));
+  EXPECT_EQ(1, FakeOpenNSL::numRoutes());
+  // Routes must point at an existing egress object
+  EXPECT_EQ(OPENNSL_E_NOT_FOUND, addRoute(0x0a000100, egress + 1));
+}
+
+TEST(FakeOpenNSL, TableFull) {
+  FakeOpenNSL::Limits limits;
+  limits.maxRoutes = 2;
+  FakeOpenNSL::setLimits(limits);
+  boot(false);
+  auto egress = createEgress();
+  EXPECT_EQ(OPENNSL_E_NONE, addRoute(0x0a000000, egress));
+  EXPECT_EQ(OPENNSL_E_NONE, addRoute(0x0a000100, egress));
+  EXPECT_EQ(OPENNSL_E_FULL, addRoute(0x0a000200, egress));
+  // Replacing an entry doesn't need a free one
+  EXPECT_EQ(OPENNSL_E_NONE,
+            addRoute(0x0a000100, egress, OPENNSL_L3_REPLACE));
+  FakeOpenNSL::setLimits(FakeOpenNSL::Limits());
+}
+
+TEST(FakeOpenNSL, CallCounts) {
+  FakeOpenNSL::setLimits(FakeOpenNSL::Limits());
+  boot(false);
+  FakeOpenNSL::resetCalls();
+  auto egress = createEgress();
+  addRoute(0x0a000000, egress);
+  addRoute(0x0a000100, egress);
+  EXPECT_EQ(1, FakeOpenNSL::numCalls("opennsl_l3_egress_create"));
+  EXPECT_EQ(2, FakeOpenNSL::numCalls("opennsl_l3_route_add"));
+  EXPECT_EQ(3, FakeOpenNSL::totalCalls());
+}
+
+TEST(FakeOpenNSL, LinkState) {
+  FakeOpenNSL::setLimits(FakeOpenNSL::Limits());
+  boot(false);
+  linkUpdates = 0;
+  ASSERT_EQ(OPENNSL_E_NONE, opennsl_linkscan_register(kUnit, linkscanHandler));
+  ASSERT_EQ(OPENNSL_E_NONE, opennsl_linkscan_enable_set(kUnit, 250000));
+  ASSERT_EQ(OPENNSL_E_NONE, opennsl_port_enable_set(kUnit, 1, 1));
+
+  // Not reported until linkscan is enabled on the port
+  FakeOpenNSL::setLinkState(1, true);
+  EXPECT_EQ(0, linkUpdates);
+  int status;
+  ASSERT_EQ(OPENNSL_E_NONE, opennsl_port_link_status_get(kUnit, 1, &status));
+  EXPECT_EQ(OPENNSL_PORT_LINK_STATUS_UP, status);
+
+  ASSERT_EQ(OPENNSL_E_NONE,
+            opennsl_linkscan_mode_set(kUnit, 1, OPENNSL_LINKSCAN_MODE_SW));
+  FakeOpenNSL::setLinkState(1, false);
+  EXPECT_EQ(1, linkUpdates);
+  EXPECT_EQ(OPENNSL_PORT_LINK_STATUS_DOWN, lastLinkStatus);
+
+  EXPECT_EQ(OPENNSL_E_NONE,
+            opennsl_linkscan_unregister(kUnit, linkscanHandler));
+}
+
+TEST(FakeOpenNSL, EcmpMembers) {
+  FakeOpenNSL::setLimits(FakeOpenNSL::Limits());
+  boot(false);
+  auto egress1 = createEgress();
+  auto egress2 = createEgress();
+  opennsl_l3_egress_ecmp_t ecmp;
+  opennsl_l3_egress_ecmp_t_init(&ecmp);
+  ecmp.ecmp_intf = createEcmp({egress1, egress2});
+  EXPECT_EQ(2, FakeOpenNSL::numEcmpPaths());
+
+  EXPECT_EQ(OPENNSL_E_NONE,
+            opennsl_l3_egress_ecmp_delete(kUnit, &ecmp, egress1));
+  EXPECT_EQ(OPENNSL_E_NOT_FOUND,
+            opennsl_l3_egress_ecmp_delete(kUnit, &ecmp, egress1));
+  EXPECT_EQ(1, FakeOpenNSL::numEcmpPaths());
+
+  EXPECT_EQ(OPENNSL_E_NONE,
+            opennsl_l3_egress_ecmp_add(kUnit, &ecmp, egress1));
+  EXPECT_EQ(OPENNSL_E_EXISTS,
+            opennsl_l3_egress_ecmp_add(kUnit, &ecmp, egress1));
+  EXPECT_EQ(2, FakeOpenNSL::numEcmpPaths());
+
+  // Members must be existing egress objects, and fit in max_paths
+  EXPECT_EQ(OPENNSL_E_NOT_FOUND,
+            opennsl_l3_egress_ecmp_add(kUnit, &ecmp, egress2 + 1));
+  EXPECT_EQ(OPENNSL_E_NONE,
+            opennsl_l3_egress_ecmp_add(kUnit, &ecmp, createEgress()));
+  EXPECT_EQ(OPENNSL_E_NONE,
+            opennsl_l3_egress_ecmp_add(kUnit, &ecmp, createEgress()));
+  EXPECT_EQ(OPENNSL_E_FULL,
+            opennsl_l3_egress_ecmp_add(kUnit, &ecmp, createEgress()));
+}
@@ -149,6 +149,36 @@ struct PortStatus {
   5: i64 speedMbps,
 }
 
+enum CaptureDirection {
+  CAPTURE_ONLY_RX = 0,
+  CAPTURE_ONLY_TX = 1,
+  CAPTURE_TX_RX = 2,
+}
+
+/*
+ * Select the packets a capture records.  A packet must pass every test that
+ * is set: an empty list matches anything, and a non-empty list matches if
+ * any of its entries does.
+ */
+struct CaptureFilter {
+  // Ports packets were received on.  Sent packets don't record their
+  // egress port, so are not tested against this.
+  1: list<i32> ports = []
+  // VLANs, from the 802.1Q tag or for received packets the ingress VLAN
+  2: list<i32> vlans = []
+  // Ethertypes, after any 802.1Q tag
+  3: list<i32> ethertypes = []
+  // IPv4 or IPv6 prefixes matching the source or destination address
+  4: list<IpPrefix> prefixes = []
+  5: list<IpPrefix> srcPrefixes = []
+  6: list<IpPrefix> dstPrefixes = []
+  // IP protocols (the IPv6 next header, extension headers aren't followed)
+  7: list<i32> ipProtocols = []
+  // TCP or UDP ports matching the source or destination port
+  8: list<i32> l4Ports = []
+  9: CaptureDirection direction = CAPTURE_TX_RX
+}
+
 struct CaptureInfo {
   // A name identifying the packet capture
   1: string name
@@ -161,6 +191,17 @@ struct CaptureInfo {
    * large number of packets.
    */
   2: i32 maxPackets
+  /*
+   * Split the capture into several files, starting a new one once the
+   * current file reaches maxFileBytes, or is rotateSeconds old.  0 disables
+   * either limit.  Files after the first are named <name>.pcap.1, .2, etc.
+   */
+  3: i64 maxFileBytes = 0
+  4: i32 rotateSeconds = 0
+  // Only capture the packets this selects.  The default captures everything.
+  5: CaptureFilter filter
+  // Only keep this many of the most recent files.  0 keeps all of them.
+  6: i32 maxFiles = 0
 }
 
 struct RouteUpdateLoggingInfo {
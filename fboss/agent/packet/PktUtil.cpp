@@ -9,12 +9,18 @@
  */
 #include "fboss/agent/packet/PktUtil.h"
 
+#include <folly/Bits.h>
 #include <folly/IPAddressV4.h>
 #include <folly/IPAddressV6.h>
 #include <folly/MacAddress.h>
 #include <folly/io/Cursor.h>
 #include "fboss/agent/FbossError.h"
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define FBOSS_CHECKSUM_X86 1
+#endif
+
 using folly::IPAddressV4;
 using folly::IPAddressV6;
 using folly::MacAddress;
@@ -25,6 +31,125 @@ using folly::IOBuf;
 using folly::StringPiece;
 using std::string;
 
+namespace {
+
+/*
+ * Checksum kernels.
+ *
+ * Each of these returns the sum of the bytes in [data, data + length),
+ * taken as native byte order words and accumulated in 64 bits.  The one's
+ * complement sum doesn't depend on the word size or byte order, as long as
+ * the result is folded down to 16 bits and then converted from host to
+ * network byte order (RFC 1071, section 2).  A trailing odd byte is summed
+ * as if followed by a zero byte.
+ */
+uint64_t checksumPortable(const uint8_t* data, size_t length) {
+  uint64_t sum = 0;
+  // Adding 32 bit words to a 64 bit accumulator can't overflow for any
+  // realistic length, and avoids having to handle carries.
+  while (length >= 16) {
+    sum += folly::loadUnaligned<uint32_t>(data);
+    sum += folly::loadUnaligned<uint32_t>(data + 4);
+    sum += folly::loadUnaligned<uint32_t>(data + 8);
+    sum += folly::loadUnaligned<uint32_t>(data + 12);
+    data += 16;
+    length -= 16;
+  }
+  while (length >= 4) {
+    sum += folly::loadUnaligned<uint32_t>(data);
+    data += 4;
+    length -= 4;
+  }
+  if (length >= 2) {
+    sum += folly::loadUnaligned<uint16_t>(data);
+    data += 2;
+    length -= 2;
+  }
+  if (length) {
+    uint8_t last[2] = {*data, 0};
+    sum += folly::loadUnaligned<uint16_t>(last);
+  }
+  return sum;
+}
+
+#ifdef FBOSS_CHECKSUM_X86
+uint64_t checksumSSE2(const uint8_t* data, size_t length) {
+  // Zero extend each 32 bit lane into a 64 bit lane and add those, so the
+  // accumulators never overflow.
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc0 = _mm_setzero_si128();
+  __m128i acc1 = _mm_setzero_si128();
+  while (length >= 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v, zero));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v, zero));
+    data += 16;
+    length -= 16;
+  }
+  acc0 = _mm_add_epi64(acc0, acc1);
+  uint64_t lanes[2];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc0);
+  return lanes[0] + lanes[1] + checksumPortable(data, length);
+}
+
+__attribute__((__target__("avx2")))
+uint64_t checksumAVX2(const uint8_t* data, size_t length) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i acc0 = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  while (length >= 32) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v, zero));
+    data += 32;
+    length -= 32;
+  }
+  acc0 = _mm256_add_epi64(acc0, acc1);
+  uint64_t lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc0);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+    checksumSSE2(data, length);
+}
+#endif
+
+typedef uint64_t (*ChecksumFn)(const uint8_t* data, size_t length);
+
+ChecksumFn selectChecksumFn() {
+#ifdef FBOSS_CHECKSUM_X86
+  if (__builtin_cpu_supports("avx2")) {
+    return checksumAVX2;
+  }
+  return checksumSSE2;
+#else
+  return checksumPortable;
+#endif
+}
+
+// Short buffers aren't worth the vector setup
+constexpr size_t kMinVectorLength = 64;
+
+/*
+ * Return the one's complement sum of a contiguous buffer, folded to 16 bits
+ * and in network byte order.
+ */
+uint16_t checksumSegment(const uint8_t* data, size_t length) {
+  static const ChecksumFn checksumFn = selectChecksumFn();
+  uint64_t sum = length < kMinVectorLength ?
+    checksumPortable(data, length) : checksumFn(data, length);
+  sum = (sum & 0xffffffff) + (sum >> 32);
+  sum = (sum & 0xffffffff) + (sum >> 32);
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  return folly::Endian::big(static_cast<uint16_t>(sum));
+}
+
+// Swap the bytes of a 16 bit one's complement sum
+uint16_t swapSum(uint16_t sum) {
+  return (sum << 8) | (sum >> 8);
+}
+
+} // unnamed namespace
+
 namespace facebook { namespace fboss {
 
 MacAddress PktUtil::readMac(Cursor* cursor) {
@@ -67,8 +192,7 @@ uint16_t PktUtil::internetChecksum(folly::io::Cursor start, uint64_t length) {
 }
 
 uint16_t PktUtil::internetChecksum(const uint8_t* buffer, uint32_t size) {
-  auto buf = IOBuf(IOBuf::WRAP_BUFFER, buffer, size);
-  return finalizeChecksum(Cursor(&buf), size, 0);
+  return finalizeChecksum(checksumSegment(buffer, size));
 }
 
 uint16_t PktUtil::internetChecksum(const IOBuf* buf) {
@@ -78,20 +202,29 @@ uint16_t PktUtil::internetChecksum(const IOBuf* buf) {
 uint32_t PktUtil::partialChecksumImpl(folly::io::Cursor cursor,
                                       uint64_t length,
                                       uint32_t value) {
-  // Checksum all the pairs of bytes first
-  while  (length > 1) {
-    value += cursor.readBE<uint16_t>();
-    length -= 2;
+  // Checksum each contiguous piece of the chain.  A piece starting at an odd
+  // offset has its bytes in the opposite halves of the 16 bit words, which
+  // is handled by swapping the bytes of its sum.
+  uint64_t sum = value;
+  bool odd = false;
+  while (length > 0) {
+    auto piece = cursor.peek();
+    if (piece.second == 0) {
+      throw std::out_of_range("underflow");
+    }
+    auto pieceLength = std::min<uint64_t>(piece.second, length);
+    auto pieceSum = checksumSegment(piece.first, pieceLength);
+    sum += odd ? swapSum(pieceSum) : pieceSum;
+    odd ^= (pieceLength & 1);
+    cursor.skip(pieceLength);
+    length -= pieceLength;
   }
-  if (length) {
-    // Bytes are interpreted in n/w byte order
-    // so this last octet represents the 8 MSbits
-    // of the last 16 bit number in this buffer.
-    uint16_t last = cursor.read<uint8_t>();
-    value += (last << 8);
-    --length;
+  // Fold the carries back in, so that partial sums can be chained without
+  // overflowing
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
   }
-  return value;
+  return sum;
 }
 
 uint32_t PktUtil::partialChecksum(folly::io::Cursor cursor,
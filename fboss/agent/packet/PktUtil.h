@@ -53,9 +53,9 @@ class PktUtil {
 
   /*
    * Compute internet checksum (as defined in RFC 1071) over a sequence
-   * of bytes. Code is as given in RFC 1071 section 4.1, with some
-   * modifications to handle odd number of bytes regardless of
-   * host m/c byte order.
+   * of bytes.  Each contiguous buffer is summed a word at a time (using
+   * SSE2/AVX2 when available), and odd numbers of bytes are handled
+   * regardless of host m/c byte order and of where the IOBuf chain is split.
    * Checksum is returned in host byte order. Make sure to convert it
    * to n/w byte order if before sending it out on a wire.
    */
@@ -72,7 +72,8 @@ class PktUtil {
    * used to compute the checksum over the final odd-length piece.
    *
    * value specifies the initial partial checksum value.  This is normally the
-   * value returned by a previous call to partialChecksum().
+   * value returned by a previous call to partialChecksum().  The returned
+   * value has its carries folded in, so it is at most 0xffff.
    *
    * Once all of the data has been passed to partialChecksum(),
    * finalizeChecksum() should be called to get the final checksum value.
@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/packet/PktUtil.h"
+
+#include <folly/Benchmark.h>
+#include <folly/Random.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <gflags/gflags.h>
+
+using namespace facebook::fboss;
+using folly::IOBuf;
+using folly::io::Cursor;
+using std::unique_ptr;
+
+namespace {
+
+// The former implementation, one 16 bit word at a time through a Cursor
+uint16_t cursorChecksum(Cursor cursor, uint64_t length) {
+  uint32_t sum = 0;
+  while (length > 1) {
+    sum += cursor.readBE<uint16_t>();
+    length -= 2;
+  }
+  if (length) {
+    sum += cursor.read<uint8_t>() << 8;
+  }
+  return PktUtil::finalizeChecksum(sum);
+}
+
+unique_ptr<IOBuf> randomBuf(size_t length) {
+  auto buf = IOBuf::create(length);
+  buf->append(length);
+  for (size_t idx = 0; idx < length; ++idx) {
+    buf->writableData()[idx] = folly::Random::rand32(256);
+  }
+  return buf;
+}
+
+// The same data split into 3 odd length buffers, like a header, payload and
+// trailer that were built separately
+unique_ptr<IOBuf> randomChain(size_t length) {
+  auto head = randomBuf(13);
+  head->prependChain(randomBuf(length - 26));
+  head->prependChain(randomBuf(13));
+  return head;
+}
+
+void cursorChecksum(size_t iters, size_t length) {
+  unique_ptr<IOBuf> buf;
+  BENCHMARK_SUSPEND {
+    buf = randomBuf(length);
+  }
+  for (size_t n = 0; n < iters; ++n) {
+    folly::doNotOptimizeAway(cursorChecksum(Cursor(buf.get()), length));
+  }
+}
+
+void internetChecksum(size_t iters, size_t length) {
+  unique_ptr<IOBuf> buf;
+  BENCHMARK_SUSPEND {
+    buf = randomBuf(length);
+  }
+  for (size_t n = 0; n < iters; ++n) {
+    folly::doNotOptimizeAway(PktUtil::internetChecksum(buf.get()));
+  }
+}
+
+void cursorChecksumChain(size_t iters, size_t length) {
+  unique_ptr<IOBuf> buf;
+  BENCHMARK_SUSPEND {
+    buf = randomChain(length);
+  }
+  for (size_t n = 0; n < iters; ++n) {
+    folly::doNotOptimizeAway(cursorChecksum(Cursor(buf.get()), length));
+  }
+}
+
+void internetChecksumChain(size_t iters, size_t length) {
+  unique_ptr<IOBuf> buf;
+  BENCHMARK_SUSPEND {
+    buf = randomChain(length);
+  }
+  for (size_t n = 0; n < iters; ++n) {
+    folly::doNotOptimizeAway(PktUtil::internetChecksum(buf.get()));
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK_PARAM(cursorChecksum, 64);
+BENCHMARK_RELATIVE_PARAM(internetChecksum, 64);
+BENCHMARK_PARAM(cursorChecksum, 576);
+BENCHMARK_RELATIVE_PARAM(internetChecksum, 576);
+BENCHMARK_PARAM(cursorChecksum, 1500);
+BENCHMARK_RELATIVE_PARAM(internetChecksum, 1500);
+BENCHMARK_PARAM(cursorChecksum, 9000);
+BENCHMARK_RELATIVE_PARAM(internetChecksum, 9000);
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_PARAM(cursorChecksumChain, 64);
+BENCHMARK_RELATIVE_PARAM(internetChecksumChain, 64);
+BENCHMARK_PARAM(cursorChecksumChain, 1500);
+BENCHMARK_RELATIVE_PARAM(internetChecksumChain, 1500);
+BENCHMARK_PARAM(cursorChecksumChain, 9000);
+BENCHMARK_RELATIVE_PARAM(internetChecksumChain, 9000);
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -9,6 +9,7 @@
  */
 #include "fboss/agent/packet/PktUtil.h"
 
+#include <folly/Conv.h>
 #include <folly/IPAddressV4.h>
 #include <folly/IPAddressV6.h>
 #include <folly/MacAddress.h>
@@ -212,3 +213,93 @@ TEST(Checksum, TestKnownOdd) {
   expected = ~expected;
   EXPECT_EQ(expected, PktUtil::internetChecksum(bytes, 9));
 }
+
+namespace {
+
+// The straightforward RFC 1071 implementation, one 16 bit word at a time
+uint16_t referenceChecksum(Cursor cursor, uint64_t length) {
+  uint32_t sum = 0;
+  while (length > 1) {
+    sum += cursor.readBE<uint16_t>();
+    length -= 2;
+  }
+  if (length) {
+    sum += cursor.read<uint8_t>() << 8;
+  }
+  return PktUtil::finalizeChecksum(sum);
+}
+
+// Split length random bytes into a chain of randomly sized buffers,
+// including empty ones
+std::unique_ptr<IOBuf> randomChain(size_t length) {
+  std::unique_ptr<IOBuf> head;
+  do {
+    auto pieceLength = std::min<size_t>(length, Random::rand32(200));
+    // Leave some headroom so the data isn't always aligned
+    auto headroom = Random::rand32(16);
+    auto piece = IOBuf::create(headroom + pieceLength);
+    piece->advance(headroom);
+    piece->append(pieceLength);
+    for (size_t idx = 0; idx < pieceLength; ++idx) {
+      piece->writableData()[idx] = Random::rand32(256);
+    }
+    if (head) {
+      head->prependChain(std::move(piece));
+    } else {
+      head = std::move(piece);
+    }
+    length -= pieceLength;
+  } while (length > 0);
+  return head;
+}
+
+} // unnamed namespace
+
+TEST(Checksum, CompareWithReference) {
+  for (int iter = 0; iter < 2000; ++iter) {
+    auto length = Random::rand32(3000);
+    auto buf = randomChain(length);
+    SCOPED_TRACE(folly::to<std::string>("length ", length, ", ",
+                                        buf->countChainElements(), " bufs"));
+    EXPECT_EQ(referenceChecksum(Cursor(buf.get()), length),
+              PktUtil::internetChecksum(buf.get()));
+
+    // Checksum a random range of the chain
+    auto start = length ? Random::rand32(length) : 0;
+    auto rangeLength = Random::rand32(length - start + 1);
+    EXPECT_EQ(referenceChecksum(Cursor(buf.get()) + start, rangeLength),
+              PktUtil::internetChecksum(Cursor(buf.get()) + start,
+                                        rangeLength));
+
+    // Checksum it in two even-length parts
+    auto firstLength = Random::rand32(length + 1) & ~1;
+    auto partial = PktUtil::partialChecksum(Cursor(buf.get()), firstLength);
+    EXPECT_EQ(referenceChecksum(Cursor(buf.get()), length),
+              PktUtil::finalizeChecksum(Cursor(buf.get()) + firstLength,
+                                        length - firstLength, partial));
+
+    // And as a single contiguous buffer
+    auto coalesced = buf->clone();
+    coalesced->coalesce();
+    EXPECT_EQ(referenceChecksum(Cursor(coalesced.get()), length),
+              PktUtil::internetChecksum(coalesced->data(), length));
+  }
+}
+
+TEST(Checksum, AllOnes) {
+  // Buffers of 0xff bytes generate the most carries.  Larger ones would
+  // overflow the reference implementation.
+  for (size_t length : {65536, 65537, 131073}) {
+    IOBuf buf(IOBuf::CREATE, length);
+    buf.append(length);
+    memset(buf.writableData(), 0xff, length);
+    EXPECT_EQ(referenceChecksum(Cursor(&buf), length),
+              PktUtil::internetChecksum(&buf));
+  }
+}
+
+TEST(Checksum, Truncated) {
+  auto buf = randomChain(100);
+  EXPECT_THROW(PktUtil::internetChecksum(Cursor(buf.get()), 101),
+               std::out_of_range);
+}
@@ -9,43 +9,104 @@
  */
 #include "fboss/agent/state/InterfaceMap.h"
 #include <string>
+#include <unordered_map>
 #include <folly/Conv.h>
+#include <folly/Memory.h>
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/state/NodeMap-defs.h"
+#include "fboss/lib/RadixTree.h"
 
 using std::string;
 using folly::IPAddress;
 
 namespace facebook { namespace fboss {
 
+struct InterfaceMap::Index {
+  // Interfaces with each address, in map order
+  std::unordered_map<IPAddress, Interfaces> byAddress;
+  // The first interface in each VLAN
+  std::unordered_map<uint16_t, std::shared_ptr<Interface>> byVlan;
+  // Connected subnets in each router
+  std::unordered_map<uint32_t,
+                     network::RadixTree<IPAddress, IntfAddrToReach>> subnets;
+};
+
+namespace {
+const std::shared_ptr<Interface> kNoInterface;
+}
+
 InterfaceMap::InterfaceMap() {
 }
 
 InterfaceMap::~InterfaceMap() {
 }
 
+const InterfaceMap::Index* InterfaceMap::getIndex() const {
+  if (!this->isPublished()) {
+    return nullptr;
+  }
+  std::call_once(indexOnce_, [this] {
+    auto index = folly::make_unique<Index>();
+    for (const auto& intf : *this) {
+      index->byVlan.emplace(static_cast<uint16_t>(intf->getVlanID()), intf);
+      auto& subnets = index->subnets[static_cast<uint32_t>(
+          intf->getRouterID())];
+      for (const auto& addr : intf->getAddresses()) {
+        index->byAddress[addr.first].push_back(intf);
+        // Keep the first interface on a subnet, as a linear search would
+        subnets.insert(addr.first.mask(addr.second), addr.second,
+                       IntfAddrToReach(intf.get(), &addr.first, addr.second));
+      }
+    }
+    index_ = std::move(index);
+  });
+  return index_.get();
+}
+
 std::shared_ptr<Interface>
 InterfaceMap::getInterfaceIf(RouterID router, const IPAddress& ip) const {
-  for (auto itr = begin(); itr != end(); ++itr) {
-    if ((*itr)->getRouterID() == router && (*itr)->hasAddress(ip)) {
-      return *itr;
-    }
-  }
-  return nullptr;
+  return findInterface(router, ip);
 }
 
 const std::shared_ptr<Interface>&
 InterfaceMap::getInterface(RouterID router, const IPAddress& ip) const {
-  for (auto itr = begin(); itr != end(); ++itr) {
-    if ((*itr)->getRouterID() == router && (*itr)->hasAddress(ip)) {
-      return *itr;
+  const auto& intf = findInterface(router, ip);
+  if (!intf) {
+    throw FbossError("No interface with ip : ", ip);
+  }
+  return intf;
+}
+
+const std::shared_ptr<Interface>& InterfaceMap::findInterface(
+    RouterID router, const IPAddress& ip) const {
+  auto index = getIndex();
+  if (!index) {
+    for (auto itr = begin(); itr != end(); ++itr) {
+      if ((*itr)->getRouterID() == router && (*itr)->hasAddress(ip)) {
+        return *itr;
+      }
+    }
+    return kNoInterface;
+  }
+
+  auto it = index->byAddress.find(ip);
+  if (it != index->byAddress.end()) {
+    for (const auto& intf : it->second) {
+      if (intf->getRouterID() == router) {
+        return intf;
+      }
     }
   }
-  throw FbossError("No interface with ip : ", ip);
+  return kNoInterface;
 }
 
 std::shared_ptr<Interface>
 InterfaceMap::getInterfaceInVlanIf(VlanID vlan) const {
+  auto index = getIndex();
+  if (index) {
+    auto it = index->byVlan.find(static_cast<uint16_t>(vlan));
+    return it == index->byVlan.end() ? nullptr : it->second;
+  }
   for (auto itr = begin(); itr != end(); ++itr) {
     if ((*itr)->getVlanID() == vlan ) {
       return *itr;
@@ -65,16 +126,32 @@ InterfaceMap::getInterfaceInVlan(VlanID vlan) const {
 
 InterfaceMap::IntfAddrToReach InterfaceMap::getIntfAddrToReach(
     RouterID router, const folly::IPAddress& dest) const {
+  auto index = getIndex();
+  if (index) {
+    auto subnets = index->subnets.find(static_cast<uint32_t>(router));
+    if (subnets != index->subnets.end()) {
+      auto match = subnets->second.longestMatch(dest, dest.bitCount());
+      if (match != subnets->second.end()) {
+        return match.value();
+      }
+    }
+    return IntfAddrToReach(nullptr, nullptr, 0);
+  }
+
+  IntfAddrToReach best(nullptr, nullptr, 0);
   for (auto iter = begin(); iter != end(); iter++) {
     const auto& intf = *iter;
-    if (intf->getRouterID() == router) {
-      auto addrIter = intf->getAddressToReach(dest);
-      if (addrIter != intf->getAddresses().end()) {
-        return IntfAddrToReach(intf.get(), &addrIter->first, addrIter->second);
+    if (intf->getRouterID() != router) {
+      continue;
+    }
+    for (const auto& addr : intf->getAddresses()) {
+      if ((!best.intf || addr.second > best.mask) &&
+          dest.inSubnet(addr.first, addr.second)) {
+        best = IntfAddrToReach(intf.get(), &addr.first, addr.second);
       }
     }
   }
-  return IntfAddrToReach(nullptr, nullptr, 0);
+  return best;
 }
 
 folly::dynamic InterfaceMap::toFollyDynamic() const {
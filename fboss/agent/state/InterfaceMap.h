@@ -8,6 +8,8 @@
  *
  */
 #pragma once
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <folly/IPAddress.h>
 #include "fboss/agent/types.h"
@@ -15,10 +17,15 @@
 namespace facebook { namespace fboss {
 
 class Interface;
-typedef NodeMapTraits<InterfaceID, Interface> InterfaceMapTraits;
+typedef NodeMapTraits<InterfaceID, Interface, NodeMapNoExtraFields,
+    PersistentNodeContainer<InterfaceID, Interface>> InterfaceMapTraits;
 
 /*
  * A container for the set of INTERFACEs.
+ *
+ * Once published, lookups by address, VLAN and subnet go through indices
+ * built on first use, since the map can no longer change.  Unpublished maps
+ * are searched linearly.
  */
 class InterfaceMap : public NodeMapT<InterfaceMap, InterfaceMapTraits> {
  public:
@@ -83,7 +90,10 @@ class InterfaceMap : public NodeMapT<InterfaceMap, InterfaceMapTraits> {
   };
 
   /*
-   * Find an interface with its address to reach the given destination
+   * Find an interface with its address to reach the given destination.
+   *
+   * If several connected subnets contain dest, the most specific one is
+   * returned.
    */
   IntfAddrToReach getIntfAddrToReach(
       RouterID router, const folly::IPAddress& dest) const;
@@ -115,9 +125,21 @@ class InterfaceMap : public NodeMapT<InterfaceMap, InterfaceMapTraits> {
   }
 
  private:
+  struct Index;
+
   // Inherit the constructors required for clone()
   using NodeMapT::NodeMapT;
   friend class CloneAllocator;
+
+  // Returns null if we aren't published yet
+  const Index* getIndex() const;
+  const std::shared_ptr<Interface>& findInterface(
+      RouterID router, const folly::IPAddress& ip) const;
+
+  // Built by the first lookup after we are published.  Clones start without
+  // an index.
+  mutable std::once_flag indexOnce_;
+  mutable std::unique_ptr<Index> index_;
 };
 
 }} // facebook::fboss
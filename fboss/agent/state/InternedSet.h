@@ -0,0 +1,149 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Hash.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace facebook { namespace fboss {
+
+/*
+ * An immutable set, shared by everything holding an equal set.
+ *
+ * Most routes in a full table use one of a few hundred ECMP groups, so
+ * rather than each route holding its own copy of its nexthops, they all
+ * refer to one interned copy of each distinct set.  Copying an InternedSet
+ * (as cloning a Route does) only takes a reference, and since equal sets
+ * are the same object, comparing two of them compares pointers.
+ *
+ * A set leaves the pool when the last InternedSet referring to it goes
+ * away, which can happen in any thread, so the pool is locked.  Only
+ * interning a set and releasing the last reference take the lock.
+ *
+ * ElemHash hashes the elements of the set.
+ */
+template<typename SetT, typename ElemHash>
+class InternedSet {
+ public:
+  typedef typename SetT::value_type value_type;
+  typedef typename SetT::const_iterator const_iterator;
+
+  InternedSet() {}
+  /* implicit */ InternedSet(const SetT& set) : set_(intern(set)) {}
+  /* implicit */ InternedSet(SetT&& set) : set_(intern(std::move(set))) {}
+
+  const SetT& get() const {
+    return set_ ? *set_ : emptySet();
+  }
+  /* implicit */ operator const SetT&() const {
+    return get();
+  }
+
+  const_iterator begin() const {
+    return get().begin();
+  }
+  const_iterator end() const {
+    return get().end();
+  }
+  size_t size() const {
+    return set_ ? set_->size() : 0;
+  }
+  bool empty() const {
+    return !set_;
+  }
+  void clear() {
+    set_.reset();
+  }
+
+  bool operator==(const InternedSet& other) const {
+    return set_ == other.set_;
+  }
+  bool operator!=(const InternedSet& other) const {
+    return set_ != other.set_;
+  }
+
+  // The number of distinct non-empty sets currently interned
+  static size_t numInterned() {
+    auto& p = pool();
+    std::lock_guard<std::mutex> guard(p.lock);
+    return p.sets.size();
+  }
+
+ private:
+  struct Entry {
+    const SetT* set;
+    std::weak_ptr<const SetT> ref;
+  };
+  struct Pool {
+    std::mutex lock;
+    std::unordered_multimap<size_t, Entry> sets;
+  };
+
+  static Pool& pool() {
+    // Never destroyed, sets may still be released during static destruction
+    static auto p = new Pool();
+    return *p;
+  }
+
+  static const SetT& emptySet() {
+    static const SetT kEmpty;
+    return kEmpty;
+  }
+
+  static size_t hash(const SetT& set) {
+    return folly::hash::hash_range(set.begin(), set.end(), set.size(),
+                                   ElemHash());
+  }
+
+  // Only copies or moves set if there is no equal set in the pool yet
+  template<typename S>
+  static std::shared_ptr<const SetT> intern(S&& set) {
+    if (set.empty()) {
+      return nullptr;
+    }
+    auto h = hash(set);
+    auto& p = pool();
+    std::lock_guard<std::mutex> guard(p.lock);
+    auto range = p.sets.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it) {
+      // The set may be on its way out, waiting for the lock to leave
+      auto existing = it->second.ref.lock();
+      if (existing && *existing == set) {
+        return existing;
+      }
+    }
+    std::shared_ptr<const SetT> interned(new SetT(std::forward<S>(set)),
+                                         [h](const SetT* s) { release(h, s); });
+    p.sets.emplace(h, Entry{interned.get(), interned});
+    return interned;
+  }
+
+  static void release(size_t h, const SetT* set) {
+    {
+      auto& p = pool();
+      std::lock_guard<std::mutex> guard(p.lock);
+      auto range = p.sets.equal_range(h);
+      for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.set == set) {
+          p.sets.erase(it);
+          break;
+        }
+      }
+    }
+    delete set;
+  }
+
+  std::shared_ptr<const SetT> set_;
+};
+
+}} // facebook::fboss
@@ -77,7 +77,7 @@ void NeighborTable<IPADDR, ENTRY, SUBCLASS>::updateEntry(
   entry->setPort(port);
   entry->setIntfID(intfID);
   entry->setState(NeighborState::REACHABLE);
-  it->second = entry;
+  nodes[ip] = entry;
 }
 
 template<typename IPADDR, typename ENTRY, typename SUBCLASS>
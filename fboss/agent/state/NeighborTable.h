@@ -29,6 +29,7 @@ struct NeighborTableTraits {
   typedef IPADDR KeyType;
   typedef ENTRY Node;
   typedef NodeMapNoExtraFields ExtraFields;
+  typedef PersistentNodeContainer<KeyType, Node> NodeContainer;
 
   static KeyType getKey(const std::shared_ptr<Node>& entry) {
     return entry->getIP();
@@ -38,12 +39,9 @@ struct NeighborTableTraits {
 /*
  * A map of IP --> MAC for the IP addresses of other nodes on a VLAN.
  *
- * TODO: We should switch from NodeMap to PrefixMap when the new PrefixMap
- * implementation is ready.
- *
- * Any change to a NodeMap is O(N), so it is really only suitable for small
- * maps that do not change frequently.  Our new PrefixMap implementation will
- * allow us to perform cheaper copy-on-write updates.
+ * Neighbor tables can hold tens of thousands of entries and change on every
+ * ARP/NDP response, so they use a PersistentNodeContainer: a clone and
+ * single entry update is O(log N) rather than copying the whole table.
  */
 template<typename IPADDR, typename ENTRY, typename SUBCLASS>
 class NeighborTable
@@ -19,6 +19,7 @@
 #include "fboss/agent/state/InterfaceMap.h"
 #include "fboss/agent/state/RouteTable.h"
 #include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/StateSnapshot.h"
 
 namespace facebook { namespace fboss {
 
@@ -32,10 +33,20 @@ void NodeBaseT<NodeT, FieldsT>::publish() {
   if (isPublished()) {
     return;
   }
+  // Children that are already published were carried over unchanged from
+  // an earlier state, and so is everything below them.
   writableFields()->forEachChild([](NodeBase* child) {
-    child->publish();
+    if (!child->isPublished()) {
+      child->publish();
+    }
   });
   NodeBase::publish();
 }
 
+template<typename NodeT, typename FieldsT>
+void NodeBaseT<NodeT, FieldsT>::writeSnapshot(
+    StateSnapshotWriter* writer) const {
+  writer->value(toFollyDynamic());
+}
+
 }} // facebook::fboss
@@ -23,6 +23,8 @@
 
 namespace facebook { namespace fboss {
 
+class StateSnapshotWriter;
+
 /*
  * NodeBase is the base class for all nodes in our SwitchState tree.
  *
@@ -224,6 +226,16 @@ class NodeBaseT : public NodeBase {
     return folly::toJson(toFollyDynamic());
   }
 
+  /*
+   * Write the node to a state snapshot, in the same form as
+   * toFollyDynamic().
+   *
+   * The default writes toFollyDynamic() as a single value.  Nodes with many
+   * children override this to write the children one at a time, so that
+   * saving the state never has to hold a dynamic copy of all of it.
+   */
+  virtual void writeSnapshot(StateSnapshotWriter* writer) const;
+
   template<typename... Args>
   explicit NodeBaseT(Args&&... args) : fields_(std::forward<Args>(args)...) {}
 
@@ -64,11 +64,11 @@ template <typename MapTypeT, typename TraitsT>
 void
 NodeMapT<MapTypeT, TraitsT>::updateNode(const std::shared_ptr<Node>& node) {
   auto& nodes = writableNodes();
-  auto it = nodes.find(TraitsT::getKey(node));
-  if (it == nodes.end()) {
-    throw FbossError("node ID ", TraitsT::getKey(node), " does not exist");
+  auto key = TraitsT::getKey(node);
+  if (nodes.find(key) == nodes.end()) {
+    throw FbossError("node ID ", key, " does not exist");
   }
-  it->second = node;
+  nodes[key] = node;
 }
 
 template <typename MapTypeT, typename TraitsT>
@@ -117,6 +117,21 @@ folly::dynamic NodeMapT<MapTypeT, TraitsT>::toFollyDynamic() const {
   return json;
 }
 
+template <typename MapTypeT, typename TraitsT>
+void NodeMapT<MapTypeT, TraitsT>::writeSnapshot(
+    StateSnapshotWriter* writer) const {
+  writer->beginObject(2);
+  writer->key(kEntries);
+  writer->beginArray(size());
+  for (const auto& node: *this) {
+    node->writeSnapshot(writer);
+  }
+  writer->end();
+  writer->key(kExtraFields);
+  writer->value(getExtraFields().toFollyDynamic());
+  writer->end();
+}
+
 template <typename MapTypeT, typename TraitsT>
 std::shared_ptr<MapTypeT>
 NodeMapT<MapTypeT, TraitsT>::fromFollyDynamic(const folly::dynamic& nodesJson) {
@@ -13,6 +13,7 @@
 
 #include "fboss/agent/state/NodeBase.h"
 #include "fboss/agent/state/NodeMapIterator.h"
+#include "fboss/agent/state/PersistentNodeContainer.h"
 
 namespace facebook { namespace fboss {
 
@@ -24,8 +25,7 @@ struct NodeMapFields {
   typedef typename TraitsT::KeyType KeyType;
   typedef typename TraitsT::Node Node;
   typedef typename TraitsT::ExtraFields ExtraFields;
-  typedef boost::container::flat_map<KeyType, std::shared_ptr<Node>>
-    NodeContainer;
+  typedef typename TraitsT::NodeContainer NodeContainer;
 
   NodeMapFields() {}
   NodeMapFields(const NodeMapFields& other, NodeContainer nodes)
@@ -57,11 +57,20 @@ struct NodeMapNoExtraFields {
   }
 };
 
-template<typename KeyT, typename NodeT, typename ExtraT = NodeMapNoExtraFields>
+/*
+ * The default NodeContainer is a flat_map: it is the cheapest to look up and
+ * iterate, but clone() copies every entry.  Maps which are large or updated
+ * often should use a PersistentNodeContainer instead, which shares its
+ * storage between clones.
+ */
+template<typename KeyT, typename NodeT, typename ExtraT = NodeMapNoExtraFields,
+         typename ContainerT =
+           boost::container::flat_map<KeyT, std::shared_ptr<NodeT>>>
 struct NodeMapTraits {
   typedef KeyT KeyType;
   typedef NodeT Node;
   typedef ExtraT ExtraFields;
+  typedef ContainerT NodeContainer;
 
   static KeyType getKey(const std::shared_ptr<Node>& node) {
     return node->getID();
@@ -141,6 +150,11 @@ class NodeMapT : public NodeBaseT<MapTypeT,
    */
   folly::dynamic toFollyDynamic() const override;
 
+  /*
+   * Write to a state snapshot entry by entry, in the toFollyDynamic() form
+   */
+  void writeSnapshot(StateSnapshotWriter* writer) const override;
+
   /*
    * Serialize to json string
    */
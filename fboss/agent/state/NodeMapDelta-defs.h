@@ -32,8 +32,7 @@ NodeMapDelta<MAP, VALUE, MAPPOINTERTRAITS>::Iterator::Iterator(
   while (oldIt_ != oldMap_->end() &&
          newIt_ != newMap_->end() &&
          *oldIt_ == *newIt_) {
-    ++oldIt_;
-    ++newIt_;
+    InnerIter::skipShared(&oldIt_, &newIt_);
   }
   updateValue();
 }
@@ -105,8 +104,7 @@ void NodeMapDelta<MAP, VALUE, MAPPOINTERTRAITS>::Iterator::advance() {
   while (oldIt_ != oldMap_->end() &&
          newIt_ != newMap_->end() &&
          *oldIt_ == *newIt_) {
-    ++oldIt_;
-    ++newIt_;
+    InnerIter::skipShared(&oldIt_, &newIt_);
   }
   updateValue();
 }
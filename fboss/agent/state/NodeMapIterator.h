@@ -11,6 +11,20 @@
 
 #include <boost/container/flat_map.hpp>
 
+/*
+ * Advance two iterators which point to the same entry past the entries
+ * the two containers have in common.
+ *
+ * This generic version can't tell which entries are shared, so it just
+ * increments both iterators.  Containers that share storage between copies
+ * (like PersistentNodeContainer) provide a better overload.
+ */
+template <typename _Iterator>
+void skipSharedEntries(_Iterator* a, _Iterator* b) {
+  ++*a;
+  ++*b;
+}
+
 /*
  * NodeMapIterator is a very small wrapper around flat_map::const_iterator.
  *
@@ -53,6 +67,14 @@ class NodeMapIterator : public std::iterator<std::forward_iterator_tag,
     return it_ != other.it_;
   }
 
+  /*
+   * Advance a and b, which must point to the same node, past the run of
+   * nodes their maps are known to share.  Always advances at least once.
+   */
+  static void skipShared(NodeMapIterator* a, NodeMapIterator* b) {
+    skipSharedEntries(&a->it_, &b->it_);
+  }
+
  private:
   typename NodeContainer::const_iterator it_;
 };
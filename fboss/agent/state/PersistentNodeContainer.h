@@ -0,0 +1,495 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace facebook { namespace fboss {
+
+/*
+ * PersistentNodeContainer is a sorted map from KeyT to shared_ptr<NodeT>,
+ * implemented as a copy-on-write B+tree.
+ *
+ * It provides the subset of the boost::container::flat_map API used by
+ * NodeMapT, and can be selected as the NodeContainer of a NodeMapT through
+ * its NodeMapTraits.
+ *
+ * Copying the container only copies a pointer to the root of the tree.  The
+ * tree nodes are shared between the copies, and a modification copies only
+ * the nodes on the path from the root to the modified entry.  A NodeMap
+ * clone() followed by a single addNode()/updateNode()/removeNode() is
+ * therefore O(log N), instead of copying all N entries like a flat_map does.
+ * Nodes which are not shared with another container are modified in place.
+ *
+ * Since unchanged subtrees are shared, NodeMapDelta can also skip over them
+ * without visiting their entries; see skipSharedEntries().
+ *
+ * Like the other SwitchState structures, a container must not be modified
+ * once it is visible to other threads.  Iterators don't hold references on
+ * the tree, and are invalidated by any modification of the container.
+ */
+template<typename KeyT, typename NodeT>
+class PersistentNodeContainer {
+ private:
+  struct TreeNode;
+
+ public:
+  typedef KeyT key_type;
+  typedef std::shared_ptr<NodeT> mapped_type;
+  typedef std::pair<KeyT, std::shared_ptr<NodeT>> value_type;
+  typedef size_t size_type;
+  class const_iterator;
+  typedef const_iterator iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+  typedef const_reverse_iterator reverse_iterator;
+
+  PersistentNodeContainer() {}
+
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  const_iterator begin() const {
+    const_iterator it;
+    if (root_) {
+      it.push(root_.get(), 0);
+      it.descendLeftmost();
+    }
+    return it;
+  }
+  const_iterator end() const {
+    return const_iterator(root_.get());
+  }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  const_iterator find(const KeyT& key) const {
+    auto it = lower_bound(key);
+    if (it != end() && !(key < it->first)) {
+      return it;
+    }
+    return end();
+  }
+
+  // Return an iterator to the first entry whose key is not less than key
+  const_iterator lower_bound(const KeyT& key) const {
+    const_iterator it(root_.get());
+    if (!root_) {
+      return it;
+    }
+    const TreeNode* node = root_.get();
+    while (!node->isLeaf()) {
+      auto idx = node->childIndex(key);
+      it.push(node, idx);
+      node = node->children[idx].get();
+    }
+    auto idx = node->entryIndex(key);
+    it.push(node, idx);
+    if (idx == node->entries.size()) {
+      // Every entry in this leaf is smaller than key.  The first entry of the
+      // next leaf (if any) is the one we want.
+      it.advanceFrom(it.depth_ - 1);
+    }
+    return it;
+  }
+
+  std::pair<const_iterator, bool> insert(value_type value) {
+    auto it = find(value.first);
+    if (it != end()) {
+      return std::make_pair(it, false);
+    }
+    auto key = value.first;
+    if (!root_) {
+      root_ = std::make_shared<TreeNode>();
+    }
+    auto sibling = insertImpl(&root_, std::move(value));
+    if (sibling) {
+      auto newRoot = std::make_shared<TreeNode>();
+      newRoot->addChild(std::move(root_));
+      newRoot->addChild(std::move(sibling));
+      root_ = std::move(newRoot);
+    }
+    ++size_;
+    return std::make_pair(find(key), true);
+  }
+
+  /*
+   * Return a writable reference to the value for key, inserting a null
+   * value if there is no entry for key yet.
+   *
+   * The nodes on the path to the entry are unshared first, so assigning
+   * through the reference does not affect any other container.
+   */
+  mapped_type& operator[](const KeyT& key) {
+    if (find(key) == end()) {
+      insert(value_type(key, nullptr));
+    }
+    TreeNode* node = writable(&root_);
+    while (!node->isLeaf()) {
+      node = writable(&node->children[node->childIndex(key)]);
+    }
+    auto idx = node->entryIndex(key);
+    DCHECK(idx < node->entries.size() && !(key < node->entries[idx].first));
+    return node->entries[idx].second;
+  }
+
+  // Erase the entry at it, returning an iterator to the entry following it
+  const_iterator erase(const_iterator it) {
+    auto key = it->first;
+    erase(key);
+    return lower_bound(key);
+  }
+
+  size_t erase(const KeyT& key) {
+    if (find(key) == end()) {
+      return 0;
+    }
+    eraseImpl(&root_, key);
+    if (root_->isLeaf()) {
+      if (root_->entries.empty()) {
+        root_.reset();
+      }
+    } else if (root_->children.size() == 1) {
+      auto child = std::move(root_->children.front());
+      root_ = std::move(child);
+    }
+    --size_;
+    return 1;
+  }
+
+  void clear() {
+    root_.reset();
+    size_ = 0;
+  }
+
+ private:
+  // Maximum number of entries in a leaf and children of an internal node
+  enum : size_t {
+    kMaxEntries = 64,
+    kMaxChildren = 32,
+    // Nodes shrinking below this size are merged with a neighbour if the
+    // result fits in one node.
+    kMergeEntries = kMaxEntries / 4,
+    kMergeChildren = kMaxChildren / 4,
+    // Depth of a tree with 2 * 64 * 16^7 (~34 billion) entries
+    kMaxDepth = 9,
+  };
+
+  struct TreeNode {
+    bool isLeaf() const {
+      return children.empty();
+    }
+    size_t numSlots() const {
+      return isLeaf() ? entries.size() : children.size();
+    }
+    const KeyT& firstKey() const {
+      return isLeaf() ? entries.front().first : keys.front();
+    }
+
+    // Index of the child subtree that would contain key
+    size_t childIndex(const KeyT& key) const {
+      auto it = std::upper_bound(keys.begin(), keys.end(), key);
+      return it == keys.begin() ? 0 : (it - keys.begin()) - 1;
+    }
+    // Index of the first entry of this leaf whose key is not less than key
+    size_t entryIndex(const KeyT& key) const {
+      auto it = std::lower_bound(entries.begin(), entries.end(), key,
+          [](const value_type& entry, const KeyT& k) {
+            return entry.first < k;
+          });
+      return it - entries.begin();
+    }
+
+    void addChild(std::shared_ptr<TreeNode> child) {
+      keys.push_back(child->firstKey());
+      children.push_back(std::move(child));
+    }
+
+    // Leaves only use entries, internal nodes only use keys and children.
+    // keys[i] is the smallest key stored under children[i].
+    std::vector<value_type> entries;
+    std::vector<KeyT> keys;
+    std::vector<std::shared_ptr<TreeNode>> children;
+  };
+
+  // Return a modifiable node, copying it first if it is shared
+  static TreeNode* writable(std::shared_ptr<TreeNode>* node) {
+    if (node->use_count() > 1) {
+      *node = std::make_shared<TreeNode>(**node);
+    }
+    return node->get();
+  }
+
+  // Insert value, which must not be in the subtree yet.  Returns the new
+  // right sibling if the node had to be split.
+  static std::shared_ptr<TreeNode> insertImpl(
+      std::shared_ptr<TreeNode>* nodePtr, value_type&& value) {
+    TreeNode* node = writable(nodePtr);
+    if (node->isLeaf()) {
+      auto idx = node->entryIndex(value.first);
+      node->entries.insert(node->entries.begin() + idx, std::move(value));
+      if (node->entries.size() <= kMaxEntries) {
+        return nullptr;
+      }
+      auto sibling = std::make_shared<TreeNode>();
+      auto mid = node->entries.begin() + node->entries.size() / 2;
+      sibling->entries.assign(std::make_move_iterator(mid),
+                              std::make_move_iterator(node->entries.end()));
+      node->entries.erase(mid, node->entries.end());
+      return sibling;
+    }
+
+    auto idx = node->childIndex(value.first);
+    if (value.first < node->keys[idx]) {
+      node->keys[idx] = value.first;
+    }
+    auto childSibling = insertImpl(&node->children[idx], std::move(value));
+    if (!childSibling) {
+      return nullptr;
+    }
+    node->keys.insert(node->keys.begin() + idx + 1, childSibling->firstKey());
+    node->children.insert(node->children.begin() + idx + 1,
+                          std::move(childSibling));
+    if (node->children.size() <= kMaxChildren) {
+      return nullptr;
+    }
+    auto sibling = std::make_shared<TreeNode>();
+    auto half = node->children.size() / 2;
+    sibling->keys.assign(node->keys.begin() + half, node->keys.end());
+    sibling->children.assign(
+        std::make_move_iterator(node->children.begin() + half),
+        std::make_move_iterator(node->children.end()));
+    node->keys.resize(half);
+    node->children.resize(half);
+    return sibling;
+  }
+
+  // Erase key, which must be in the subtree.  Children left empty are
+  // removed, and small children are merged with a neighbour, so every leaf
+  // stays at the same depth.
+  static void eraseImpl(std::shared_ptr<TreeNode>* nodePtr, const KeyT& key) {
+    TreeNode* node = writable(nodePtr);
+    if (node->isLeaf()) {
+      auto idx = node->entryIndex(key);
+      DCHECK(idx < node->entries.size());
+      node->entries.erase(node->entries.begin() + idx);
+      return;
+    }
+
+    auto idx = node->childIndex(key);
+    eraseImpl(&node->children[idx], key);
+    const auto& child = node->children[idx];
+    if (child->numSlots() == 0) {
+      node->keys.erase(node->keys.begin() + idx);
+      node->children.erase(node->children.begin() + idx);
+      return;
+    }
+    node->keys[idx] = child->firstKey();
+
+    auto mergeSize = child->isLeaf() ? kMergeEntries : kMergeChildren;
+    auto maxSize = child->isLeaf() ? kMaxEntries : kMaxChildren;
+    if (child->numSlots() >= mergeSize || node->children.size() < 2) {
+      return;
+    }
+    // Merge with the right neighbour, or the left one for the last child
+    auto left = idx + 1 < node->children.size() ? idx : idx - 1;
+    const auto& right = node->children[left + 1];
+    if (node->children[left]->numSlots() + right->numSlots() > maxSize) {
+      return;
+    }
+    TreeNode* merged = writable(&node->children[left]);
+    if (merged->isLeaf()) {
+      merged->entries.insert(merged->entries.end(),
+                             right->entries.begin(), right->entries.end());
+    } else {
+      merged->keys.insert(merged->keys.end(),
+                          right->keys.begin(), right->keys.end());
+      merged->children.insert(merged->children.end(),
+                              right->children.begin(), right->children.end());
+    }
+    node->keys.erase(node->keys.begin() + left + 1);
+    node->children.erase(node->children.begin() + left + 1);
+  }
+
+  std::shared_ptr<TreeNode> root_;
+  size_t size_{0};
+};
+
+/*
+ * A bidirectional iterator over the entries of a PersistentNodeContainer.
+ *
+ * It stores the path from the root to the current leaf, so that it can move
+ * to the neighbouring leaf without the leaves being linked together (linking
+ * them would prevent sharing the leaves between containers).
+ */
+template<typename KeyT, typename NodeT>
+class PersistentNodeContainer<KeyT, NodeT>::const_iterator
+  : public std::iterator<std::bidirectional_iterator_tag, const value_type> {
+ public:
+  const_iterator() {}
+
+  const value_type& operator*() const {
+    const auto& leaf = path_[depth_ - 1];
+    return leaf.node->entries[leaf.index];
+  }
+  const value_type* operator->() const {
+    return &operator*();
+  }
+
+  const_iterator& operator++() {
+    advanceFrom(depth_ - 1);
+    return *this;
+  }
+  const_iterator operator++(int) {
+    const_iterator tmp(*this);
+    ++*this;
+    return tmp;
+  }
+  const_iterator& operator--() {
+    if (depth_ == 0) {
+      // Move from end() to the last entry
+      push(root_, root_->numSlots() - 1);
+      descendRightmost();
+      return *this;
+    }
+    auto level = depth_ - 1;
+    while (path_[level].index == 0) {
+      DCHECK_GT(level, 0) << "decrementing begin()";
+      --level;
+    }
+    --path_[level].index;
+    depth_ = level + 1;
+    descendRightmost();
+    return *this;
+  }
+  const_iterator operator--(int) {
+    const_iterator tmp(*this);
+    --*this;
+    return tmp;
+  }
+
+  bool operator==(const const_iterator& other) const {
+    if (depth_ == 0 || other.depth_ == 0) {
+      return depth_ == other.depth_;
+    }
+    const auto& leaf = path_[depth_ - 1];
+    const auto& otherLeaf = other.path_[other.depth_ - 1];
+    return leaf.node == otherLeaf.node && leaf.index == otherLeaf.index;
+  }
+  bool operator!=(const const_iterator& other) const {
+    return !operator==(other);
+  }
+
+  /*
+   * Advance both iterators past the entries they have in common.
+   *
+   * The iterators must point to the same entry.  If they are in the same
+   * tree node (shared between the two containers), the remainder of the
+   * largest such node is identical on both sides and both iterators are
+   * moved past it.  Otherwise they are just incremented.
+   */
+  friend void skipSharedEntries(const_iterator* a, const_iterator* b) {
+    DCHECK(a->depth_ > 0 && b->depth_ > 0);
+    size_t shared = 0;
+    while (shared < a->depth_ && shared < b->depth_) {
+      const auto& levelA = a->path_[a->depth_ - 1 - shared];
+      const auto& levelB = b->path_[b->depth_ - 1 - shared];
+      if (levelA.node != levelB.node || levelA.index != levelB.index) {
+        break;
+      }
+      ++shared;
+    }
+    if (shared == 0) {
+      ++*a;
+      ++*b;
+      return;
+    }
+    a->skipSubtree(a->depth_ - shared);
+    b->skipSubtree(b->depth_ - shared);
+  }
+
+ private:
+  friend class PersistentNodeContainer;
+
+  explicit const_iterator(const TreeNode* root) : root_(root) {}
+
+  struct Level {
+    const TreeNode* node;
+    size_t index;
+  };
+
+  void push(const TreeNode* node, size_t index) {
+    CHECK_LT(depth_, kMaxDepth);
+    if (depth_ == 0) {
+      root_ = node;
+    }
+    path_[depth_++] = Level{node, index};
+  }
+
+  void descendLeftmost() {
+    for (auto node = path_[depth_ - 1].node; !node->isLeaf();) {
+      node = node->children[path_[depth_ - 1].index].get();
+      push(node, 0);
+    }
+  }
+  void descendRightmost() {
+    for (auto node = path_[depth_ - 1].node; !node->isLeaf();) {
+      node = node->children[path_[depth_ - 1].index].get();
+      push(node, node->numSlots() - 1);
+    }
+  }
+
+  // Move to the next slot at path_[level], going up when it is exhausted
+  void advanceFrom(size_t level) {
+    while (true) {
+      auto& current = path_[level];
+      if (++current.index < current.node->numSlots()) {
+        depth_ = level + 1;
+        descendLeftmost();
+        return;
+      }
+      if (level == 0) {
+        depth_ = 0;
+        return;
+      }
+      --level;
+    }
+  }
+
+  // Move past the subtree rooted at path_[level]
+  void skipSubtree(size_t level) {
+    if (level == 0) {
+      depth_ = 0;
+      return;
+    }
+    advanceFrom(level - 1);
+  }
+
+  // Needed to step back from end()
+  const TreeNode* root_{nullptr};
+  std::array<Level, kMaxDepth> path_ = {{}};
+  size_t depth_{0};
+};
+
+}} // facebook::fboss
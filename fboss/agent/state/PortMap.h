@@ -16,7 +16,8 @@ namespace facebook { namespace fboss {
 
 class SwitchState;
 class Port;
-typedef NodeMapTraits<PortID, Port> PortMapTraits;
+typedef NodeMapTraits<PortID, Port, NodeMapNoExtraFields,
+                      PersistentNodeContainer<PortID, Port>> PortMapTraits;
 
 /*
  * A container for the set of ports.
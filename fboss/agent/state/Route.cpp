@@ -69,9 +69,11 @@ template<typename AddrT>
 RouteFields<AddrT>
 RouteFields<AddrT>::fromFollyDynamic(const folly::dynamic& routeJson) {
   RouteFields rt(Prefix::fromFollyDynamic(routeJson[kPrefix]));
+  RouteNextHops nexthops;
   for (const auto& nhop: routeJson[kNextHops]) {
-    rt.nexthops.emplace(nhop.stringPiece());
+    nexthops.emplace(nhop.stringPiece());
   }
+  rt.nexthops = std::move(nexthops);
   rt.fwd = RouteForwardInfo::fromFollyDynamic(routeJson[kFwdInfo]);
   rt.flags = routeJson[kFlags].asInt();
   return rt;
@@ -149,7 +151,7 @@ bool Route<AddrT>::isSame(InterfaceID intf, const IPAddress& addr) const {
 
 template<typename AddrT>
 bool Route<AddrT>::isSame(const RouteNextHops& nhs) const {
-  return RouteBase::getFields()->nexthops == nhs;
+  return RouteBase::getFields()->nexthops.get() == nhs;
 }
 
 template<typename AddrT>
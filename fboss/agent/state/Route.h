@@ -12,6 +12,7 @@
 
 #include "fboss/agent/types.h"
 #include <folly/IPAddress.h>
+#include "fboss/agent/state/InternedSet.h"
 #include "fboss/agent/state/NodeBase.h"
 #include "fboss/agent/state/RouteForwardInfo.h"
 #include "fboss/agent/state/RouteTypes.h"
@@ -51,9 +52,10 @@ struct RouteFields {
   // The following fields will not be copied during clone()
   /*
    * All next hops of the routes. This set could be empty if and only if
-   * the route is directly connected
+   * the route is directly connected. Routes with the same next hops share
+   * one interned copy of the set.
    */
-  RouteNextHops nexthops;
+  InternedSet<RouteNextHops, std::hash<folly::IPAddress>> nexthops;
   RouteForwardInfo fwd;
   uint32_t flags{0};
 };
@@ -131,7 +133,7 @@ class Route : public NodeBaseT<Route<AddrT>, RouteFields<AddrT>> {
     return RouteBase::getFields()->fwd;
   }
   const RouteNextHops& nexthops() const {
-    return RouteBase::getFields()->nexthops;
+    return RouteBase::getFields()->nexthops.get();
   }
   bool isSame(InterfaceID intf, const folly::IPAddress& addr) const;
   bool isSame(const RouteNextHops& nhs) const;
@@ -17,42 +17,108 @@
 
 namespace facebook { namespace fboss {
 
+/*
+ * Delta between two versions of a RouteTableRib.
+ *
+ * Walks the two radix trees in lockstep and skips subtrees shared between
+ * the old and new RIB, so the cost is proportional to the number of changed
+ * routes rather than the size of the RIB. Iterating yields
+ * DeltaValue<Route<AddrT>> like NodeMapDelta, so it can be used with the
+ * DeltaFunctions helpers.
+ */
+template<typename AddrT>
+class RouteTableRibDelta {
+ public:
+  using Node = Route<AddrT>;
+  using Rib = RouteTableRib<AddrT>;
+  using TreeDelta = facebook::network::PersistentRadixTreeDelta<AddrT,
+        std::shared_ptr<Node>>;
+  class Iterator;
+
+  RouteTableRibDelta(const Rib* oldRib, const Rib* newRib)
+    : delta_(oldRib ? &oldRib->routes() : nullptr,
+        newRib ? &newRib->routes() : nullptr) {}
+
+  Iterator begin() const {
+    return Iterator(delta_.begin());
+  }
+  Iterator end() const {
+    return Iterator(delta_.end());
+  }
+
+ private:
+  TreeDelta delta_;
+};
+
+template<typename AddrT>
+class RouteTableRibDelta<AddrT>::Iterator {
+ public:
+  // Iterator properties
+  typedef std::forward_iterator_tag iterator_category;
+  typedef DeltaValue<Node> value_type;
+  typedef ptrdiff_t difference_type;
+  typedef value_type* pointer;
+  typedef value_type& reference;
+
+  explicit Iterator(typename TreeDelta::Iterator itr)
+    : itr_(std::move(itr)),
+      value_(nullptr, nullptr) {
+    updateValue();
+  }
+
+  const value_type& operator*() const {
+    return value_;
+  }
+  const value_type* operator->() const {
+    return &value_;
+  }
+
+  Iterator& operator++() {
+    ++itr_;
+    updateValue();
+    return *this;
+  }
+  Iterator operator++(int) {
+    Iterator tmp(*this);
+    ++(*this);
+    return tmp;
+  }
+
+  bool operator==(const Iterator& other) const {
+    return itr_ == other.itr_;
+  }
+  bool operator!=(const Iterator& other) const {
+    return !operator==(other);
+  }
+
+ private:
+  void updateValue() {
+    if (itr_.atEnd()) {
+      value_.reset(nullptr, nullptr);
+      return;
+    }
+    value_.reset(itr_.oldNode() ? itr_.oldNode()->value() : nullptr,
+        itr_.newNode() ? itr_.newNode()->value() : nullptr);
+  }
+
+  typename TreeDelta::Iterator itr_;
+  value_type value_;
+};
+
 class RouteTablesDelta : public DeltaValue<RouteTable> {
  public:
-  using NodeMapRibV4 = RouteTableRibNodeMap<folly::IPAddressV4>;
-  using NodeMapRibV6 = RouteTableRibNodeMap<folly::IPAddressV6>;
-  using RoutesV4Delta = NodeMapDelta<NodeMapRibV4,
-        DeltaValue<NodeMapRibV4::Node>,
-        MapUniquePointerTraits<NodeMapRibV4>>;
-  using RoutesV6Delta = NodeMapDelta<NodeMapRibV6,
-        DeltaValue<NodeMapRibV6::Node>,
-        MapUniquePointerTraits<NodeMapRibV6>>;
+  using RoutesV4Delta = RouteTableRibDelta<folly::IPAddressV4>;
+  using RoutesV6Delta = RouteTableRibDelta<folly::IPAddressV6>;
 
   using DeltaValue<RouteTable>::DeltaValue;
 
   RoutesV4Delta getRoutesV4Delta() const {
-    std::unique_ptr<NodeMapRibV4> oldRib, newRib;
-    if (getOld()) {
-      oldRib.reset(new NodeMapRibV4());
-      oldRib->addRoutes(*(getOld()->getRibV4()));
-    }
-    if (getNew()) {
-      newRib.reset(new NodeMapRibV4());
-      newRib->addRoutes(*(getNew()->getRibV4()));
-    }
-    return RoutesV4Delta(std::move(oldRib), std::move(newRib));
+    return RoutesV4Delta(getOld() ? getOld()->getRibV4().get() : nullptr,
+        getNew() ? getNew()->getRibV4().get() : nullptr);
   }
   RoutesV6Delta getRoutesV6Delta()  const {
-    std::unique_ptr<NodeMapRibV6> oldRib, newRib;
-    if (getOld()) {
-      oldRib.reset(new NodeMapRibV6());
-      oldRib->addRoutes(*(getOld()->getRibV6()));
-    }
-    if (getNew()) {
-      newRib.reset(new NodeMapRibV6());
-      newRib->addRoutes(*(getNew()->getRibV6()));
-    }
-    return RoutesV6Delta(std::move(oldRib), std::move(newRib));
+    return RoutesV6Delta(getOld() ? getOld()->getRibV6().get() : nullptr,
+        getNew() ? getNew()->getRibV6().get() : nullptr);
   }
 };
 
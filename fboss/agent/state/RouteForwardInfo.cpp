@@ -41,6 +41,11 @@ bool RouteForwardInfo::Nexthop::operator==(const Nexthop& fwd) const {
   return intf == fwd.intf && nexthop == fwd.nexthop;
 }
 
+size_t RouteForwardInfo::NexthopHash::operator()(const Nexthop& nhop) const {
+  return folly::hash::hash_combine(static_cast<uint32_t>(nhop.intf),
+                                   nhop.nexthop);
+}
+
 // RouteForwardInfo class
 std::string RouteForwardInfo::str() const {
   std::string result;
@@ -75,9 +80,11 @@ folly::dynamic RouteForwardInfo::toFollyDynamic() const {
 RouteForwardInfo
 RouteForwardInfo::fromFollyDynamic(const folly::dynamic& fwdInfoJson) {
   RouteForwardInfo fwdInfo;
+  Nexthops nexthops;
   for (const auto& nhop: fwdInfoJson[kNexthops]) {
-    fwdInfo.nexthops_.insert(Nexthop::fromFollyDynamic(nhop));
+    nexthops.insert(Nexthop::fromFollyDynamic(nhop));
   }
+  fwdInfo.nexthops_ = std::move(nexthops);
   fwdInfo.action_ = str2ForwardAction(fwdInfoJson[kAction].asString());
   return fwdInfo;
 }
@@ -13,6 +13,7 @@
 #include <folly/dynamic.h>
 #include <folly/IPAddress.h>
 #include "fboss/agent/types.h"
+#include "fboss/agent/state/InternedSet.h"
 #include "fboss/agent/state/RouteTypes.h"
 
 #include <boost/container/flat_set.hpp>
@@ -37,8 +38,12 @@ class RouteForwardInfo {
    *
    * It includes a set of nexthops on where the route shall forward the packet.
    * In the case if action_ is not Action::NEXTHOPS, the set shall be empty.
+   * Routes with the same nexthops share one interned copy of the set.
    */
   struct Nexthop;
+  struct NexthopHash {
+    size_t operator()(const Nexthop& nhop) const;
+  };
   typedef boost::container::flat_set<Nexthop> Nexthops;
 
   explicit RouteForwardInfo(Action action = Action::DROP)
@@ -52,7 +57,7 @@ class RouteForwardInfo {
   }
 
   const Nexthops& getNexthops() const {
-    return nexthops_;
+    return nexthops_.get();
   }
 
   std::string str() const;
@@ -96,8 +101,9 @@ class RouteForwardInfo {
 
   // Set one nexthop, a simple version for non-ECMP case
   void setNexthops(InterfaceID intf, const folly::IPAddress& nhop) {
-    nexthops_.clear();
-    nexthops_.emplace(intf, nhop);
+    Nexthops nexthops;
+    nexthops.emplace(intf, nhop);
+    nexthops_ = std::move(nexthops);
     action_ = Action::NEXTHOPS;
   }
   // Set one or multiple nexthops
@@ -117,7 +123,7 @@ class RouteForwardInfo {
   }
 
  private:
-  Nexthops nexthops_;
+  InternedSet<Nexthops, NexthopHash> nexthops_;
   Action action_;
 };
 
@@ -0,0 +1,134 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/RouteLookupTable.h"
+
+#include "fboss/agent/state/Route.h"
+
+#include <algorithm>
+#include <glog/logging.h>
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+// The bits bitsBefore to bitsBefore + bits of addr, which are byte aligned
+template<typename AddrT>
+uint32_t slotIndex(const AddrT& addr, uint32_t bitsBefore, uint32_t bits) {
+  const uint8_t* bytes = addr.bytes();
+  uint32_t index = 0;
+  for (uint32_t i = bitsBefore / 8; i < (bitsBefore + bits) / 8; ++i) {
+    index = (index << 8) | bytes[i];
+  }
+  return index;
+}
+
+} // unnamed namespace
+
+template<typename AddrT>
+struct RouteLookupTable<AddrT>::Prefix {
+  AddrT network;
+  uint8_t len;
+  uint32_t route;
+};
+
+template<typename AddrT>
+constexpr uint32_t RouteLookupTable<AddrT>::kLevelFlag;
+template<typename AddrT>
+constexpr uint32_t RouteLookupTable<AddrT>::kRootBits;
+template<typename AddrT>
+constexpr uint32_t RouteLookupTable<AddrT>::kLevelBits;
+
+template<typename AddrT>
+RouteLookupTable<AddrT>::RouteLookupTable(const Routes& routes)
+    : root_(1 << kRootBits, 0) {
+  std::vector<Prefix> prefixes;
+  prefixes.reserve(routes.size());
+  routes_.reserve(routes.size() + 1);
+  routes_.emplace_back();
+  for (const auto& route : routes) {
+    prefixes.push_back({route.ipAddress(), route.masklen(),
+                        static_cast<uint32_t>(routes_.size())});
+    routes_.push_back(route.value());
+  }
+  CHECK_LT(routes_.size(), kLevelFlag);
+
+  // Shorter prefixes first, so that longer ones overwrite them
+  std::stable_sort(prefixes.begin(), prefixes.end(),
+                   [](const Prefix& a, const Prefix& b) {
+                     return a.len < b.len;
+                   });
+  build(prefixes.data(), prefixes.data() + prefixes.size(), 0, kRootBits,
+        root_.data());
+}
+
+template<typename AddrT>
+void RouteLookupTable<AddrT>::build(Prefix* begin, Prefix* end,
+                                    uint32_t bitsBefore, uint32_t bits,
+                                    uint32_t* slots) {
+  // All the prefixes are longer than bitsBefore, sorted by length, and slots
+  // already hold the longest match among shorter prefixes.
+  uint32_t bitsAfter = bitsBefore + bits;
+  auto longer = std::stable_partition(begin, end, [=](const Prefix& p) {
+    return p.len <= bitsAfter;
+  });
+  for (auto prefix = begin; prefix != longer; ++prefix) {
+    auto first = slots + slotIndex(prefix->network, bitsBefore, bits);
+    std::fill(first, first + (1U << (bitsAfter - prefix->len)),
+              prefix->route);
+  }
+
+  // Group the longer prefixes by their slot, keeping them sorted by length
+  std::stable_sort(longer, end, [=](const Prefix& a, const Prefix& b) {
+    return slotIndex(a.network, bitsBefore, bits) <
+      slotIndex(b.network, bitsBefore, bits);
+  });
+  while (longer != end) {
+    auto index = slotIndex(longer->network, bitsBefore, bits);
+    auto groupEnd = std::find_if(longer, end, [=](const Prefix& p) {
+      return slotIndex(p.network, bitsBefore, bits) != index;
+    });
+
+    uint32_t levelSlots[1 << kLevelBits];
+    std::fill(levelSlots, levelSlots + (1 << kLevelBits), slots[index]);
+    build(longer, groupEnd, bitsAfter, kLevelBits, levelSlots);
+
+    Level level{};
+    level.base = runs_.size();
+    uint32_t numRuns = 0;
+    for (uint32_t i = 0; i < (1 << kLevelBits); ++i) {
+      if (i % 64 == 0) {
+        level.runsBefore[i / 64] = numRuns;
+      }
+      if (i == 0 || levelSlots[i] != levelSlots[i - 1]) {
+        level.runs[i / 64] |= 1ULL << (i % 64);
+        runs_.push_back(levelSlots[i]);
+        ++numRuns;
+      }
+    }
+    CHECK_LT(levels_.size(), kLevelFlag);
+    slots[index] = kLevelFlag | levels_.size();
+    levels_.push_back(level);
+
+    longer = groupEnd;
+  }
+}
+
+template<typename AddrT>
+size_t RouteLookupTable<AddrT>::memoryUsage() const {
+  return root_.capacity() * sizeof(uint32_t) +
+    levels_.capacity() * sizeof(Level) +
+    runs_.capacity() * sizeof(uint32_t) +
+    routes_.capacity() * sizeof(std::shared_ptr<Route<AddrT>>);
+}
+
+template class RouteLookupTable<folly::IPAddressV4>;
+template class RouteLookupTable<folly::IPAddressV6>;
+
+}} // facebook::fboss
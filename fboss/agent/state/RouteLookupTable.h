@@ -0,0 +1,103 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/lib/PersistentRadixTree.h"
+
+#include <folly/Bits.h>
+#include <memory>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+template<typename AddrT>
+class Route;
+
+/*
+ * A read-only multibit trie for longest prefix match over the routes in a
+ * RIB, built once from a published RouteTableRib.
+ *
+ * The first level is indexed by the top 16 bits of the address, and each
+ * further level by the next 8 bits, with every prefix expanded to the
+ * strides it covers (so each slot holds the longest match for all addresses
+ * under it).  A lookup is one read in the first level and two in each
+ * further level the address needs, rather than one per bit of the address
+ * in the RadixTree.
+ *
+ * Below the first level, a level holds runs of equal slots: a 256 bit
+ * bitmap marks where each run starts, and a slot's value is found by
+ * counting the bits before it.  Most levels only hold a few runs, which
+ * keeps the IPv6 table from growing with the full 256 slots for each level
+ * of each prefix.
+ */
+template<typename AddrT>
+class RouteLookupTable {
+ public:
+  using Routes = facebook::network::PersistentRadixTree<AddrT,
+        std::shared_ptr<Route<AddrT>>>;
+
+  explicit RouteLookupTable(const Routes& routes);
+
+  const std::shared_ptr<Route<AddrT>>& longestMatch(const AddrT& addr) const {
+    const uint8_t* bytes = addr.bytes();
+    uint32_t slot = root_[(uint32_t(bytes[0]) << 8) | bytes[1]];
+    for (size_t i = 2; slot & kLevelFlag; ++i) {
+      const auto& level = levels_[slot & ~kLevelFlag];
+      uint8_t index = bytes[i];
+      uint8_t word = index >> 6;
+      uint64_t bits = level.runs[word] & (~0ULL >> (63 - (index & 63)));
+      slot = runs_[level.base + level.runsBefore[word] +
+                   folly::popcount(bits) - 1];
+    }
+    return routes_[slot];
+  }
+
+  // The number of levels below the first one
+  size_t numLevels() const {
+    return levels_.size();
+  }
+
+  // The memory used by the table, not counting the routes themselves
+  size_t memoryUsage() const;
+
+ private:
+  struct Prefix;
+
+  // A level below the first one
+  struct Level {
+    // Bit i is set if a run starts at slot i
+    uint64_t runs[4];
+    // The index in runs_ of the first run
+    uint32_t base;
+    // The number of runs starting in each earlier word of runs
+    uint8_t runsBefore[4];
+  };
+
+  // Slots holding this flag are the index of a Level, and others the index
+  // of a route in routes_
+  static constexpr uint32_t kLevelFlag = 1U << 31;
+  static constexpr uint32_t kRootBits = 16;
+  static constexpr uint32_t kLevelBits = 8;
+
+  // Fill in the slots for the bits after bitsBefore from the given
+  // prefixes, adding a Level for each slot with longer prefixes
+  void build(Prefix* begin, Prefix* end, uint32_t bitsBefore, uint32_t bits,
+             uint32_t* slots);
+
+  // Slots of the first level
+  std::vector<uint32_t> root_;
+  std::vector<Level> levels_;
+  // The slot values of the runs in levels_
+  std::vector<uint32_t> runs_;
+  // routes_[0] is null, for addresses without a route
+  std::vector<std::shared_ptr<Route<AddrT>>> routes_;
+};
+
+}} // facebook::fboss
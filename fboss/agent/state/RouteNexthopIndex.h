@@ -0,0 +1,158 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/state/RouteTypes.h"
+#include "fboss/lib/PersistentRadixTree.h"
+
+#include <folly/IPAddress.h>
+#include <glog/logging.h>
+#include <memory>
+
+namespace facebook { namespace fboss {
+
+/*
+ * Reverse index from nexthop addresses to the prefixes of the routes
+ * (in one RouteTableRib) that use them.
+ *
+ * A route is resolved through the longest match for each of its nexthops.
+ * So when a prefix is added, removed or its forwarding info changes, only
+ * the routes with a nexthop within that prefix may resolve differently.
+ * RouteUpdater uses this index to find them, instead of resolving the whole
+ * RIB again.
+ *
+ * Both levels of the index (nexthop -> routes, and the set of routes for a
+ * nexthop) are PersistentRadixTrees, so clone() is O(1) and adding or
+ * removing a route only copies O(number of nexthops * address length)
+ * nodes, even for nexthops shared by every route in the table.
+ *
+ * The index is not updated by RouteTableRib::addRoute() and friends, since
+ * route objects are modified in place while unpublished. RouteUpdater keeps
+ * it in sync.
+ */
+template<typename AddrT>
+class RouteNexthopIndex {
+ public:
+  using Prefix = RoutePrefix<AddrT>;
+
+  RouteNexthopIndex() {}
+  RouteNexthopIndex(RouteNexthopIndex&&) = default;
+  RouteNexthopIndex& operator=(RouteNexthopIndex&&) = default;
+
+  RouteNexthopIndex clone() const {
+    RouteNexthopIndex copy;
+    copy.v4Nexthops_ = v4Nexthops_.clone();
+    copy.v6Nexthops_ = v6Nexthops_.clone();
+    return copy;
+  }
+
+  // Record that the route for prefix uses nexthops
+  void addRoute(const Prefix& prefix, const RouteNextHops& nexthops) {
+    for (const auto& nh : nexthops) {
+      if (nh.isV4()) {
+        addRoute(&v4Nexthops_, nh.asV4(), prefix);
+      } else {
+        addRoute(&v6Nexthops_, nh.asV6(), prefix);
+      }
+    }
+  }
+
+  // Undo addRoute(), nexthops must be the ones that were added
+  void removeRoute(const Prefix& prefix, const RouteNextHops& nexthops) {
+    for (const auto& nh : nexthops) {
+      if (nh.isV4()) {
+        removeRoute(&v4Nexthops_, nh.asV4(), prefix);
+      } else {
+        removeRoute(&v6Nexthops_, nh.asV6(), prefix);
+      }
+    }
+  }
+
+  /*
+   * Invoke fn(const Prefix&) for each route that has a nexthop within
+   * network/mask. A route with several nexthops in the range is visited
+   * once per nexthop.
+   */
+  template<typename Fn>
+  void forEachDependentRoute(const folly::IPAddressV4& network, uint8_t mask,
+                             Fn fn) const {
+    forEachDependentRoute(v4Nexthops_, network, mask, fn);
+  }
+  template<typename Fn>
+  void forEachDependentRoute(const folly::IPAddressV6& network, uint8_t mask,
+                             Fn fn) const {
+    forEachDependentRoute(v6Nexthops_, network, mask, fn);
+  }
+
+  size_t numNexthops() const {
+    return v4Nexthops_.size() + v6Nexthops_.size();
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator, use clone()
+  RouteNexthopIndex(RouteNexthopIndex const &) = delete;
+  RouteNexthopIndex& operator=(RouteNexthopIndex const &) = delete;
+
+  // Set of route prefixes, the value is unused
+  using Routes = facebook::network::PersistentRadixTree<AddrT, bool>;
+  template<typename NhAddrT>
+  using Nexthops = facebook::network::PersistentRadixTree<NhAddrT,
+        std::shared_ptr<const Routes>>;
+
+  template<typename NhAddrT>
+  static void addRoute(Nexthops<NhAddrT>* nexthops, const NhAddrT& nh,
+                       const Prefix& prefix) {
+    auto node = nexthops->exactMatchNode(nh, NhAddrT::bitCount());
+    auto routes = std::make_shared<Routes>(
+        node ? node->value()->clone() : Routes());
+    routes->insert(prefix.network, prefix.mask, true);
+    std::shared_ptr<const Routes> value = std::move(routes);
+    if (node) {
+      nexthops->update(nh, NhAddrT::bitCount(), std::move(value));
+    } else {
+      nexthops->insert(nh, NhAddrT::bitCount(), std::move(value));
+    }
+  }
+
+  template<typename NhAddrT>
+  static void removeRoute(Nexthops<NhAddrT>* nexthops, const NhAddrT& nh,
+                          const Prefix& prefix) {
+    auto node = nexthops->exactMatchNode(nh, NhAddrT::bitCount());
+    CHECK(node) << "No routes indexed for nexthop " << nh;
+    auto routes = std::make_shared<Routes>(node->value()->clone());
+    auto erased = routes->erase(prefix.network, prefix.mask);
+    CHECK(erased) << "Route " << prefix.str() << " not indexed for nexthop "
+                  << nh;
+    if (routes->size() == 0) {
+      nexthops->erase(nh, NhAddrT::bitCount());
+      return;
+    }
+    std::shared_ptr<const Routes> value = std::move(routes);
+    nexthops->update(nh, NhAddrT::bitCount(), std::move(value));
+  }
+
+  template<typename NhAddrT, typename Fn>
+  static void forEachDependentRoute(const Nexthops<NhAddrT>& nexthops,
+                                    const NhAddrT& network, uint8_t mask,
+                                    Fn& fn) {
+    typename Nexthops<NhAddrT>::ConstIterator nhItr(
+        nexthops.subTreeNode(network, mask));
+    for (; !nhItr.atEnd(); ++nhItr) {
+      for (const auto& route : *nhItr.value()) {
+        fn(Prefix{route.ipAddress(), static_cast<uint8_t>(route.masklen())});
+      }
+    }
+  }
+
+  Nexthops<folly::IPAddressV4> v4Nexthops_;
+  Nexthops<folly::IPAddressV6> v6Nexthops_;
+};
+
+}}
@@ -13,6 +13,7 @@
 #include "fboss/agent/state/Route.h"
 #include "fboss/agent/state/RouteTableRib.h"
 #include "fboss/agent/state/NodeBase-defs.h"
+#include "fboss/agent/state/StateSnapshot.h"
 #include "fboss/agent/FbossError.h"
 
 namespace {
@@ -37,6 +38,17 @@ folly::dynamic RouteTableFields::toFollyDynamic() const {
   return rtable;
 }
 
+void RouteTableFields::writeSnapshot(StateSnapshotWriter* writer) const {
+  writer->beginObject(3);
+  writer->key(kRouterId);
+  writer->value(static_cast<uint32_t>(id));
+  writer->key(kRibV4);
+  ribV4->writeSnapshot(writer);
+  writer->key(kRibV6);
+  ribV6->writeSnapshot(writer);
+  writer->end();
+}
+
 RouteTableFields
 RouteTableFields::fromFollyDynamic(const folly::dynamic& rtableJson) {
   RouteTableFields rtable(RouterID(rtableJson[kRouterId].asInt()));
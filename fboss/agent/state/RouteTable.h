@@ -29,6 +29,10 @@ struct RouteTableFields {
    * Serialize to folly::dynamic
    */
   folly::dynamic toFollyDynamic() const;
+  /*
+   * Write to a state snapshot, streaming the routes in each rib
+   */
+  void writeSnapshot(StateSnapshotWriter* writer) const;
   /*
    * Deserialize from folly::dynamic
    */
@@ -64,6 +68,10 @@ class RouteTable : public NodeBaseT<RouteTable, RouteTableFields> {
     return this->getFields()->toFollyDynamic();
   }
 
+  void writeSnapshot(StateSnapshotWriter* writer) const override {
+    this->getFields()->writeSnapshot(writer);
+  }
+
   RouterID getID() const {
     return getFields()->id;
   }
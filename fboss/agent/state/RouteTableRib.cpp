@@ -9,8 +9,8 @@
  */
 #include "RouteTableRib.h"
 
-#include "fboss/agent/state/NodeMap-defs.h"
 #include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/StateSnapshot.h"
 
 namespace {
 constexpr auto kRoutes = "routes";
@@ -18,11 +18,6 @@ constexpr auto kRoutes = "routes";
 
 namespace facebook { namespace fboss {
 
-FBOSS_INSTANTIATE_NODE_MAP(RouteTableRibNodeMap<folly::IPAddressV4>,
-                           RouteTableRibNodeMapTraits<folly::IPAddressV4>);
-FBOSS_INSTANTIATE_NODE_MAP(RouteTableRibNodeMap<folly::IPAddressV6>,
-                           RouteTableRibNodeMapTraits<folly::IPAddressV6>);
-
 template<typename AddrT>
 folly::dynamic RouteTableRib<AddrT>::toFollyDynamic() const {
   std::vector<folly::dynamic> routesJson;
@@ -34,13 +29,27 @@ folly::dynamic RouteTableRib<AddrT>::toFollyDynamic() const {
   return routes;
 }
 
+template<typename AddrT>
+void RouteTableRib<AddrT>::writeSnapshot(StateSnapshotWriter* writer) const {
+  writer->beginObject(1);
+  writer->key(kRoutes);
+  writer->beginArray(rib_.size());
+  for (const auto& route: rib_) {
+    route->value()->writeSnapshot(writer);
+  }
+  writer->end();
+  writer->end();
+}
+
 template<typename AddrT>
 std::shared_ptr<RouteTableRib<AddrT>>
 RouteTableRib<AddrT>::fromFollyDynamic(const folly::dynamic& routes) {
   auto rib = std::make_shared<RouteTableRib<AddrT>>();
   auto routesJson = routes[kRoutes];
   for (const auto& routeJson: routesJson) {
-    rib->addRoute(Route<AddrT>::fromFollyDynamic(routeJson));
+    auto route = Route<AddrT>::fromFollyDynamic(routeJson);
+    rib->addRoute(route);
+    rib->nexthopIndex_.addRoute(route->prefix(), route->nexthops());
   }
   return rib;
 }
@@ -12,56 +12,21 @@
 
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/types.h"
-#include "fboss/agent/state/NodeMap.h"
+#include "fboss/agent/state/NodeBase.h"
+#include "fboss/agent/state/RouteLookupTable.h"
+#include "fboss/agent/state/RouteNexthopIndex.h"
 #include "fboss/agent/state/RouteTypes.h"
-#include "fboss/lib/RadixTree.h"
+#include "fboss/lib/PersistentRadixTree.h"
+
+#include <atomic>
+#include <folly/Memory.h>
+#include <mutex>
 
 namespace facebook { namespace fboss {
 
 template<typename AddrT>
 class Route;
 
-template <typename AddrT>
-class RouteTableRib;
-
-template<typename AddrT> using RouteTableRibNodeMapTraits
-  = NodeMapTraits<RoutePrefix<AddrT>, Route<AddrT>>;
-
-template<typename AddrT>
-class RouteTableRibNodeMap
-    : public NodeMapT<RouteTableRibNodeMap<AddrT>,
-    RouteTableRibNodeMapTraits<AddrT>> {
- public:
-  explicit RouteTableRibNodeMap() {}
-  ~RouteTableRibNodeMap() override {}
-
-  using Base =  NodeMapT<RouteTableRibNodeMap<AddrT>,
-        RouteTableRibNodeMapTraits<AddrT>>;
-  using Prefix = RoutePrefix<AddrT>;
-  using RouteType = typename Base::Node;
-
-  bool empty() const {
-    return Base::getAllNodes().size() == 0;
-  }
-
-  uint64_t size() const {
-    return this->getAllNodes().size();
-  }
-
-  void addRoutes(const RouteTableRib<AddrT>& rib) {
-    for(const auto& routeItr: rib.routes()) {
-      addRoute(routeItr->value());
-    }
-  }
- private:
-  void addRoute(const std::shared_ptr<Route<AddrT>>& rt) {
-    Base::addNode(rt);
-  }
-  // Inherit the constructors required for clone()
-  using Base::Base;
-  friend class CloneAllocator;
-};
-
 template<typename AddrT>
 class RouteTableRib : public NodeBase {
  public:
@@ -72,7 +37,7 @@ class RouteTableRib : public NodeBase {
 
   using Prefix =  RoutePrefix<AddrT>;
   using RouteType = Route<AddrT>;
-  using Routes = facebook::network::RadixTree<AddrT,
+  using Routes = facebook::network::PersistentRadixTree<AddrT,
         std::shared_ptr<Route<AddrT>>>;
 
   bool empty() const {
@@ -89,32 +54,79 @@ class RouteTableRib : public NodeBase {
     return rib_;
   }
 
-  void publish() override {
+  /*
+   * Nexthop -> routes index, used to find the routes to resolve again
+   * when a prefix changes. Maintained by RouteUpdater.
+   */
+  const RouteNexthopIndex<AddrT>& nexthopIndex() const {
+    return nexthopIndex_;
+  }
+  RouteNexthopIndex<AddrT>& writableNexthopIndex() {
+    CHECK(!isPublished());
+    return nexthopIndex_;
+  }
+
+  /*
+   * Publish the RIB, and the routes added or changed since it was last
+   * published.  Unchanged routes sit in frozen subtrees of rib_, which are
+   * skipped, so this doesn't walk the whole table.
+   *
+   * Returns the number of tree nodes visited.
+   */
+  size_t publishRoutes() {
     NodeBase::publish();
-    for (auto routeIter: rib_) {
-      routeIter->value()->publish();
-    }
+    return rib_.freeze([](const std::shared_ptr<Route<AddrT>>& route) {
+        route->publish();
+      });
+  }
+  void publish() override {
+    publishRoutes();
   }
   std::shared_ptr<Route<AddrT>> exactMatch(const Prefix& prefix) const {
-    auto citr = rib_.exactMatch(prefix.network, prefix.mask);
-    return citr != rib_.end() ? citr->value() : nullptr;
+    auto node = rib_.exactMatchNode(prefix.network, prefix.mask);
+    return node ? node->value() : nullptr;
   }
   std::shared_ptr<Route<AddrT>> longestMatch(const AddrT& nexthop) const {
-    auto citr = rib_.longestMatch(nexthop, nexthop.bitCount());
-    return citr != rib_.end() ? citr->value() : nullptr;
+    auto node = rib_.longestMatchNode(nexthop, nexthop.bitCount());
+    return node ? node->value() : nullptr;
+  }
+  /*
+   * Same as longestMatch(), for the packet handling threads.
+   *
+   * This uses the RouteLookupTable once buildLookupTable() has made one, and
+   * the tree until then.  It never builds the table itself.
+   */
+  std::shared_ptr<Route<AddrT>> fastLongestMatch(const AddrT& addr) const {
+    auto table = lookupTable_.load(std::memory_order_acquire);
+    return table ? table->longestMatch(addr) : longestMatch(addr);
+  }
+  /*
+   * Build the RouteLookupTable for fastLongestMatch(), if there isn't one
+   * yet.  This takes much longer than a lookup in the tree, so SwSwitch does
+   * it on the background thread, once a published RIB has stayed current
+   * for a while.
+   */
+  void buildLookupTable() const {
+    CHECK(isPublished());
+    std::call_once(lookupTableOnce_, [this] {
+      lookupTableStorage_ = folly::make_unique<RouteLookupTable<AddrT>>(rib_);
+      lookupTable_.store(lookupTableStorage_.get(), std::memory_order_release);
+    });
+  }
+  bool hasLookupTable() const {
+    return lookupTable_.load(std::memory_order_acquire) != nullptr;
   }
 
   std::shared_ptr<RouteTableRib> clone() const {
     auto routeTableRib = std::make_shared<RouteTableRib>(getNodeID(),
         getGeneration() + 1);
-    for (auto& routeItr: rib_) {
-      /* Explicitly insert cloned routes rather than calling
-       * rib_.clone(), which will just use the shared_ptr copy
-       * constructor
-       */
-      routeTableRib->rib_.insert(routeItr->ipAddress(),
-          routeItr->masklen(), routeItr->value()->clone());
-    }
+    /* The clone shares all tree nodes, and hence all (published) routes,
+     * with this RIB. Modifying the clone only copies the path to the
+     * modified prefix, and callers that want to change a route must
+     * clone the route and call updateRoute().
+     */
+    routeTableRib->rib_ = rib_.clone();
+    routeTableRib->nexthopIndex_ = nexthopIndex_.clone();
     return routeTableRib;
   }
   /*
@@ -122,6 +134,11 @@ class RouteTableRib : public NodeBase {
    */
   folly::dynamic toFollyDynamic() const;
 
+  /*
+   * Write to a state snapshot route by route, in the toFollyDynamic() form
+   */
+  void writeSnapshot(StateSnapshotWriter* writer) const;
+
    /*
     * Deserialize from folly::dynamic
     */
@@ -148,12 +165,11 @@ class RouteTableRib : public NodeBase {
     }
   }
   void updateRoute(const std::shared_ptr<Route<AddrT>>& rt) {
-    auto itr = rib_.exactMatch(rt->prefix().network, rt->prefix().mask);
-    if (itr == rib_.end()) {
+    auto updated = rib_.update(rt->prefix().network, rt->prefix().mask, rt);
+    if (!updated) {
       throw FbossError("Update failed, prefix for: ", rt->str(),
           " not present");
     }
-    itr->value() = rt;
   }
   void removeRoute(const std::shared_ptr<Route<AddrT>>& rt) {
     auto erased = rib_.erase(rt->prefix().network, rt->prefix().mask);
@@ -166,6 +182,11 @@ class RouteTableRib : public NodeBase {
 
  private:
   Routes rib_;
+  RouteNexthopIndex<AddrT> nexthopIndex_;
+  // Built by buildLookupTable() once we are published.  Clones start over.
+  mutable std::once_flag lookupTableOnce_;
+  mutable std::unique_ptr<RouteLookupTable<AddrT>> lookupTableStorage_;
+  mutable std::atomic<const RouteLookupTable<AddrT>*> lookupTable_{nullptr};
 };
 
 }}
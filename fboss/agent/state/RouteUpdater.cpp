@@ -15,6 +15,7 @@
 #include "fboss/agent/state/NodeBase.h"
 #include "fboss/agent/state/NodeBase-defs.h"
 #include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteDelta.h"
 #include "fboss/agent/state/RouteTable.h"
 #include "fboss/agent/state/RouteTableMap.h"
 #include "fboss/agent/state/RouteTableRib.h"
@@ -100,7 +101,10 @@ void RouteUpdater::addRoute(const PrefixT& prefix, RibT *ribCloned,
       return;
   }
   rib = makeClone(ribCloned);
+  auto& nexthopIndex = rib->writableNexthopIndex();
+  ribCloned->changed.push_back(prefix);
   if (old) {
+    nexthopIndex.removeRoute(prefix, old->nexthops());
     std::shared_ptr<RouteT> newRoute;
     // If the node is not published yet, we assume this thread has exclusive
     // access to the node. Therefore, we can do the modification in-place
@@ -113,10 +117,12 @@ void RouteUpdater::addRoute(const PrefixT& prefix, RibT *ribCloned,
       newRoute = old;
     }
     newRoute->update(std::forward<Args>(args)...);
+    nexthopIndex.addRoute(prefix, newRoute->nexthops());
     VLOG(3) << "Updated route " << newRoute->str();
   } else {
     auto newRoute = make_shared<RouteT>(prefix, std::forward<Args>(args)...);
     rib->addRoute(newRoute);
+    nexthopIndex.addRoute(prefix, newRoute->nexthops());
     VLOG(3) << "Added route " << newRoute->str();
   }
   CHECK(ribCloned->cloned);
@@ -219,6 +225,8 @@ void RouteUpdater::delRoute(const PrefixT& prefix, RibT *ribCloned) {
   }
   rib = makeClone(ribCloned);
   rib->removeRoute(old);
+  rib->writableNexthopIndex().removeRoute(prefix, old->nexthops());
+  ribCloned->changed.push_back(prefix);
   VLOG(3) << "Deleted route " << prefix.str();
   CHECK(ribCloned->cloned);
 }
@@ -275,18 +283,11 @@ void RouteUpdater::resolve(RouteT* route, RtRibT* rib, ClonedRib* ribCloned) {
     // copy the nexthop
     newRoute->update(route->nexthops());
     // insert the cloned route back to the RIB
-    // Note: resolve() is called in a loop over 'rib'. But we are modifying
-    // the rib here. Fortunately, updateRoute() here does not actually
-    // invalidate the existing iterator, it just replace the value pointed by
-    // an existing iterator.
-    // It might be nice to change resolve() to accept a RouteTableRib::iterator
-    // as a first argument. This way it could just modify iter.second, instead
-    // of having to call updateRoute(). This way it would be very clear that
-    // this can't invalidate the iterator. (It would also avoid having to
-    // re-lookup the node in updateRoute().)
-    // The current API for the temporary RouteTableRib solution does not return
-    // any iterator. Once we switch to the RadixTree() solution, we should make
-    // this change.
+    // Note: updateRoute() copies the tree path to this prefix if it is
+    // still shared with the original RIB, so an iterator over 'rib' taken
+    // before this call would keep walking the old nodes. Callers iterating
+    // over 'rib' must therefore make sure that all routes they may resolve
+    // are already unpublished (see setRoutesForResolution()).
     rib->updateRoute(newRoute);
     route = newRoute.get();
     CHECK(!route->isPublished());
@@ -327,18 +328,75 @@ void RouteUpdater::resolve(RouteT* route, RtRibT* rib, ClonedRib* ribCloned) {
 }
 
 
-template<typename RibT>
-void RouteUpdater::setRoutesWithNhopsForResolution(RibT* rib) {
-  for (auto& rt : rib->routes()) {
-    auto route = rt.value().get();
-    if (route->isWithNexthops()) {
-      if (route->isPublished()) {
-        auto newRoute = route->clone(RibT::RouteType::Fields::COPY_ONLY_PREFIX);
-        newRoute->update(route->nexthops());
-        rib->updateRoute(newRoute);
-        route = newRoute.get();
-      }
-      route->clearFlags();
+void RouteUpdater::getRoutesToResolve(const ClonedRib* ribCloned,
+    std::set<PrefixV4>* toResolveV4, std::set<PrefixV6>* toResolveV6) {
+  // Prefixes whose forwarding info may have changed, and so may change the
+  // resolution of routes with nexthops within them. Each prefix is queued
+  // only once, which also ends the walk on dependency loops.
+  std::vector<PrefixV4> toVisitV4;
+  std::vector<PrefixV6> toVisitV6;
+  auto addV4 = [&](const PrefixV4& prefix) {
+    if (toResolveV4->insert(prefix).second) {
+      toVisitV4.push_back(prefix);
+    }
+  };
+  auto addV6 = [&](const PrefixV6& prefix) {
+    if (toResolveV6->insert(prefix).second) {
+      toVisitV6.push_back(prefix);
+    }
+  };
+  for (const auto& prefix : ribCloned->v4.changed) {
+    addV4(prefix);
+  }
+  for (const auto& prefix : ribCloned->v6.changed) {
+    addV6(prefix);
+  }
+  // Routes in either RIB may have nexthops of either address family
+  const auto& v4Index = ribCloned->v4.rib->nexthopIndex();
+  const auto& v6Index = ribCloned->v6.rib->nexthopIndex();
+  while (!toVisitV4.empty() || !toVisitV6.empty()) {
+    if (!toVisitV4.empty()) {
+      auto prefix = toVisitV4.back();
+      toVisitV4.pop_back();
+      v4Index.forEachDependentRoute(prefix.network, prefix.mask, addV4);
+      v6Index.forEachDependentRoute(prefix.network, prefix.mask, addV6);
+    } else {
+      auto prefix = toVisitV6.back();
+      toVisitV6.pop_back();
+      v4Index.forEachDependentRoute(prefix.network, prefix.mask, addV4);
+      v6Index.forEachDependentRoute(prefix.network, prefix.mask, addV6);
+    }
+  }
+}
+
+template<typename RibT, typename PrefixT>
+void RouteUpdater::setRoutesForResolution(RibT* ribCloned,
+    const std::set<PrefixT>& toResolve) {
+  for (const auto& prefix : toResolve) {
+    auto route = ribCloned->rib->exactMatch(prefix);
+    if (!route || !route->isWithNexthops()) {
+      // Removed, or a route that doesn't need resolution
+      continue;
+    }
+    auto rib = makeClone(ribCloned);
+    if (route->isPublished()) {
+      auto newRoute = route->clone(
+          RouteFields<typename PrefixT::AddressT>::COPY_ONLY_PREFIX);
+      newRoute->update(route->nexthops());
+      rib->updateRoute(newRoute);
+      route = std::move(newRoute);
+    }
+    route->clearFlags();
+  }
+}
+
+template<typename RibT, typename PrefixT>
+void RouteUpdater::resolve(RibT* ribCloned,
+    const std::set<PrefixT>& toResolve, ClonedRib* clonedRib) {
+  for (const auto& prefix : toResolve) {
+    auto route = ribCloned->rib->exactMatch(prefix);
+    if (route && route->needResolve()) {
+      resolve(route.get(), ribCloned->rib.get(), clonedRib);
     }
   }
 }
@@ -357,45 +415,38 @@ bool allRouteFlagsCleared(const RibT* rib) {
 }
 
 void RouteUpdater::resolve() {
-  // Ideally, just need to resolve the routes that is changed or impacted by
-  // the changed routes.
-  // However, Without copy-on-write RadixTree, it is O(n) to find out the
-  // routes that are changed. In this case, we just simply loop through all
-  // routes and resolve those that are not resolved yet.
-
   for (auto& ribCloned : clonedRibs_) {
-    if (ribCloned.second.v4.cloned) {
-      auto rib = ribCloned.second.v4.rib.get();
-      if (!sync_) {
-        // While synching FIB all routes are new and
-        // already have their flags not set, so no need
-        // to clear flags
-        setRoutesWithNhopsForResolution(rib);
-      } else {
-        DCHECK(allRouteFlagsCleared(rib));
-      }
-      for (auto& rt : rib->routes()) {
+    if (sync_) {
+      // While synching FIB all routes are new and already have their
+      // flags cleared, so resolve all of them.
+      auto ribV4 = ribCloned.second.v4.rib.get();
+      DCHECK(allRouteFlagsCleared(ribV4));
+      for (auto& rt : ribV4->routes()) {
         if (rt.value()->needResolve()) {
-          resolve(rt.value().get(), rib, &ribCloned.second);
+          resolve(rt.value().get(), ribV4, &ribCloned.second);
         }
       }
-    }
-    if (ribCloned.second.v6.cloned) {
-      auto rib = ribCloned.second.v6.rib.get();
-      if (!sync_) {
-        // While synching FIB all routes are new and
-        // already have their flags not set, so no need
-        // to clear flags
-        setRoutesWithNhopsForResolution(rib);
-      } else {
-        DCHECK(allRouteFlagsCleared(rib));
-      }
-      for (auto& rt : rib->routes()) {
+      auto ribV6 = ribCloned.second.v6.rib.get();
+      DCHECK(allRouteFlagsCleared(ribV6));
+      for (auto& rt : ribV6->routes()) {
         if (rt.value()->needResolve()) {
-          resolve(rt.value().get(), rib, &ribCloned.second);
+          resolve(rt.value().get(), ribV6, &ribCloned.second);
         }
       }
+      continue;
     }
+    // Only resolve the routes that may be impacted by the changed prefixes,
+    // i.e. the changed routes themselves and, transitively, the routes with
+    // nexthops within changed prefixes.
+    std::set<PrefixV4> toResolveV4;
+    std::set<PrefixV6> toResolveV6;
+    getRoutesToResolve(&ribCloned.second, &toResolveV4, &toResolveV6);
+    // Clear the flags on all of them before resolving any, so that no route
+    // is resolved through the stale forwarding info of another one.
+    setRoutesForResolution(&ribCloned.second.v4, toResolveV4);
+    setRoutesForResolution(&ribCloned.second.v6, toResolveV6);
+    resolve(&ribCloned.second.v4, toResolveV4, &ribCloned.second);
+    resolve(&ribCloned.second.v6, toResolveV6, &ribCloned.second);
   }
 }
 
@@ -543,35 +594,31 @@ bool RouteUpdater::dedupRoutes(const RibT* oldRib, RibT* newRib) {
   if (oldRib == newRib) {
     return isSame;
   }
-  const auto& oldRoutes = oldRib->routes();
-  auto& newRoutes = newRib->writableRoutes();
-  // Copy routes from old route table if they are
-  // same. For matching prefixes, which don't have
-  // same attributes inherit the generation number
-  for (auto oldIter : oldRoutes) {
-    const auto& oldRt = oldIter->value();
-    auto newIter = newRoutes.exactMatch(oldIter->ipAddress(),
-        oldIter->masklen());
-    if (newIter == newRoutes.end()) {
+  // Only prefixes that differ between the two RIBs need to be looked at,
+  // the delta skips the parts of the trees they share. Routes that are
+  // completely same are re-used from the old RIB. For matching prefixes,
+  // which don't have same attributes inherit the generation number.
+  // Collect the routes to re-use first, since updating the new RIB
+  // while walking the delta would modify the tree being walked.
+  std::vector<std::shared_ptr<typename RibT::RouteType>> toReuse;
+  RouteTableRibDelta<typename RibT::Prefix::AddressT> delta(oldRib, newRib);
+  for (const auto& entry : delta) {
+    const auto& oldRt = entry.getOld();
+    const auto& newRt = entry.getNew();
+    if (!oldRt || !newRt) {
+      // Added or removed prefix
       isSame = false;
       continue;
     }
-    auto& newRt = newIter->value();
     if (oldRt->isSame(newRt.get())) {
-      // both routes are completely same, instead of using the new route,
-      // we re-use the old route.
-      newIter->value() = oldRt;
+      toReuse.push_back(oldRt);
     } else {
       isSame = false;
       newRt->inheritGeneration(*oldRt);
     }
   }
-  if (newRoutes.size() != oldRoutes.size()) {
-    isSame = false;
-  } else {
-    // If sizes are same we would have already caught any
-    // difference while looking up all routes from oldRoutes
-    // in newRoutes, so do nothing
+  for (const auto& oldRt : toReuse) {
+    newRib->updateRoute(oldRt);
   }
   return isSame;
 }
@@ -18,6 +18,8 @@
 
 #include <boost/container/flat_map.hpp>
 #include <boost/container/flat_set.hpp>
+#include <set>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
@@ -101,10 +103,13 @@ class RouteUpdater {
     struct RibV4 {
       std::shared_ptr<RouteTableRibV4> rib;
       bool cloned{false};
+      // Prefixes added, removed or modified by this update
+      std::vector<PrefixV4> changed;
     } v4;
     struct RibV6 {
       std::shared_ptr<RouteTableRibV6> rib;
       bool cloned{false};
+      std::vector<PrefixV6> changed;
     } v6;
   };
   boost::container::flat_map<RouterID, ClonedRib> clonedRibs_;
@@ -118,8 +123,12 @@ class RouteUpdater {
   template<typename RibT>
   auto makeClone(RibT* rib) -> decltype(rib->rib.get());
 
-  template<typename RibT>
-  void setRoutesWithNhopsForResolution(RibT* rib);
+  // Find the routes which may resolve differently due to the changed prefixes
+  void getRoutesToResolve(const ClonedRib* ribCloned,
+      std::set<PrefixV4>* toResolveV4, std::set<PrefixV6>* toResolveV6);
+  template<typename RibT, typename PrefixT>
+  void setRoutesForResolution(RibT* ribCloned,
+      const std::set<PrefixT>& toResolve);
   // Helper functions to add or delete a route
   template<typename PrefixT, typename RibT, typename... Args>
   void addRoute(const PrefixT& prefix, RibT *rib, Args&&... args);
@@ -128,6 +137,9 @@ class RouteUpdater {
 
   // resolve all routes that are not resolved yet
   void resolve();
+  template<typename RibT, typename PrefixT>
+  void resolve(RibT* ribCloned, const std::set<PrefixT>& toResolve,
+      ClonedRib* clonedRib);
   template<typename RouteT, typename RtRibT>
   void resolve(RouteT* rt, RtRibT* rib, ClonedRib* clonedRib);
   template<typename RtRibT, typename AddrT>
@@ -65,7 +65,5 @@ template class NodeMapDelta<InterfaceMap>;
 template class NodeMapDelta<PortMap>;
 template class NodeMapDelta<RouteTableMap>;
 template class NodeMapDelta<AclMap>;
-template class NodeMapDelta<RouteTableRibNodeMap<folly::IPAddressV4>>;
-template class NodeMapDelta<RouteTableRibNodeMap<folly::IPAddressV6>>;
 
 }} // facebook::fboss
@@ -0,0 +1,547 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/StateSnapshot.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/Bits.h>
+#include <folly/Exception.h>
+#include <folly/File.h>
+#include <folly/FileUtil.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <unistd.h>
+
+using folly::ByteRange;
+using folly::StringPiece;
+using folly::dynamic;
+using std::string;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+const char kMagic[4] = {'F', 'B', 'S', 'S'};
+const char kTrailerMagic[4] = {'F', 'B', 'S', 'E'};
+const uint32_t kVersion = 1;
+const size_t kHeaderLen = 12;
+const size_t kTrailerLen = 16;
+// How much encoded data to buffer before writing it to the file
+const size_t kWriteBufferBytes = 1024 * 1024;
+
+enum Tag : uint8_t {
+  TAG_NULL = 0,
+  TAG_FALSE = 1,
+  TAG_TRUE = 2,
+  TAG_INT = 3,
+  TAG_DOUBLE = 4,
+  TAG_STRING = 5,
+  TAG_ARRAY = 6,
+  TAG_OBJECT = 7,
+  // An object key, as an index into the key table
+  TAG_KEY = 8,
+};
+
+uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ (value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+class Decoder {
+ public:
+  Decoder(ByteRange data, const std::vector<StringPiece>& keys)
+    : data_(data),
+      keys_(keys) {}
+
+  bool done() const {
+    return data_.empty();
+  }
+
+  dynamic decode() {
+    auto tag = getByte();
+    switch (tag) {
+      case TAG_NULL:
+        return nullptr;
+      case TAG_FALSE:
+        return false;
+      case TAG_TRUE:
+        return true;
+      case TAG_INT:
+        return static_cast<int64_t>(unzigzag(getVarint()));
+      case TAG_DOUBLE: {
+        uint64_t bits = getFixed64();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        return d;
+      }
+      case TAG_STRING:
+        return dynamic(getString());
+      case TAG_KEY:
+        return dynamic(getKey());
+      case TAG_ARRAY: {
+        getFixed32();
+        auto count = getVarint();
+        std::vector<dynamic> items;
+        // Every item takes at least a byte, so don't trust a larger count
+        items.reserve(std::min<uint64_t>(count, data_.size()));
+        for (uint64_t n = 0; n < count; ++n) {
+          items.push_back(decode());
+        }
+        return dynamic(items.begin(), items.end());
+      }
+      case TAG_OBJECT: {
+        getFixed32();
+        auto count = getVarint();
+        dynamic object = dynamic::object;
+        for (uint64_t n = 0; n < count; ++n) {
+          auto key = decode();
+          object.insert(std::move(key), decode());
+        }
+        return object;
+      }
+    }
+    throw FbossError("corrupt state snapshot: unknown tag ",
+                     static_cast<int>(tag));
+  }
+
+  /*
+   * Decode the value of the given member of the object that comes next,
+   * without decoding any other members.
+   */
+  dynamic decodeMember(StringPiece key) {
+    if (getByte() != TAG_OBJECT) {
+      throw FbossError("state snapshot does not hold an object");
+    }
+    getFixed32();
+    auto count = getVarint();
+    for (uint64_t n = 0; n < count; ++n) {
+      bool match = false;
+      if (!data_.empty() && data_[0] == TAG_KEY) {
+        data_.advance(1);
+        match = getKey() == key;
+      } else {
+        skip();
+      }
+      if (match) {
+        return decode();
+      }
+      skip();
+    }
+    return nullptr;
+  }
+
+ private:
+  [[noreturn]] void truncated() {
+    throw FbossError("corrupt state snapshot: truncated value");
+  }
+
+  void skip() {
+    auto tag = getByte();
+    switch (tag) {
+      case TAG_NULL:
+      case TAG_FALSE:
+      case TAG_TRUE:
+        return;
+      case TAG_INT:
+      case TAG_KEY:
+        getVarint();
+        return;
+      case TAG_DOUBLE:
+        getFixed64();
+        return;
+      case TAG_STRING:
+        getBytes(getVarint());
+        return;
+      case TAG_ARRAY:
+      case TAG_OBJECT:
+        getBytes(getFixed32());
+        return;
+    }
+    throw FbossError("corrupt state snapshot: unknown tag ",
+                     static_cast<int>(tag));
+  }
+
+  uint8_t getByte() {
+    if (data_.empty()) {
+      truncated();
+    }
+    uint8_t value = data_[0];
+    data_.advance(1);
+    return value;
+  }
+
+  const uint8_t* getBytes(uint64_t length) {
+    if (length > data_.size()) {
+      truncated();
+    }
+    auto ptr = data_.data();
+    data_.advance(length);
+    return ptr;
+  }
+
+  uint64_t getVarint() {
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+      auto byte = getByte();
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    throw FbossError("corrupt state snapshot: varint too long");
+  }
+
+  uint32_t getFixed32() {
+    return folly::Endian::little(
+        folly::loadUnaligned<uint32_t>(getBytes(sizeof(uint32_t))));
+  }
+
+  uint64_t getFixed64() {
+    return folly::Endian::little(
+        folly::loadUnaligned<uint64_t>(getBytes(sizeof(uint64_t))));
+  }
+
+  StringPiece getString() {
+    auto length = getVarint();
+    return StringPiece(reinterpret_cast<const char*>(getBytes(length)),
+                       length);
+  }
+
+  StringPiece getKey() {
+    auto id = getVarint();
+    if (id >= keys_.size()) {
+      throw FbossError("corrupt state snapshot: unknown key ", id);
+    }
+    return keys_[id];
+  }
+
+  ByteRange data_;
+  const std::vector<StringPiece>& keys_;
+};
+
+} // unnamed namespace
+
+StateSnapshotWriter::StateSnapshotWriter(StringPiece path)
+  : path_(path.str()),
+    tmpPath_(path_ + ".tmp"),
+    file_(tmpPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644) {
+  buf_.reserve(kWriteBufferBytes + 4096);
+  putBytes(kMagic, sizeof(kMagic));
+  putFixed32(kVersion);
+  putFixed32(0);
+}
+
+StateSnapshotWriter::~StateSnapshotWriter() {
+  if (!finished_) {
+    // Never leave a partial snapshot behind
+    unlink(tmpPath_.c_str());
+  }
+}
+
+void StateSnapshotWriter::beginObject(size_t numMembers) {
+  startValue();
+  auto start = beginContainer(TAG_OBJECT, numMembers);
+  open_.push_back({start, numMembers, true, false});
+}
+
+void StateSnapshotWriter::beginArray(size_t numItems) {
+  startValue();
+  auto start = beginContainer(TAG_ARRAY, numItems);
+  open_.push_back({start, numItems, false, false});
+}
+
+void StateSnapshotWriter::key(StringPiece key) {
+  if (open_.empty() || !open_.back().isObject || open_.back().haveKey) {
+    throw FbossError("state snapshot key ", key, " is not expected here");
+  }
+  encodeKey(key);
+  open_.back().haveKey = true;
+}
+
+void StateSnapshotWriter::value(const dynamic& value) {
+  startValue();
+  encode(value);
+  maybeFlush();
+}
+
+void StateSnapshotWriter::end() {
+  if (open_.empty()) {
+    throw FbossError("no state snapshot container to end");
+  }
+  if (open_.back().remaining != 0 || open_.back().haveKey) {
+    throw FbossError("state snapshot container ended with ",
+                     open_.back().remaining, " values still to write");
+  }
+  endContainer(open_.back().start);
+  open_.pop_back();
+  maybeFlush();
+}
+
+uint64_t StateSnapshotWriter::finish() {
+  if (!open_.empty()) {
+    throw FbossError("state snapshot finished with ", open_.size(),
+                     " containers still open");
+  }
+  uint64_t keysOffset = offset();
+  for (const auto& key : keyList_) {
+    putString(key);
+  }
+  putFixed64(keysOffset);
+  putFixed32(keyList_.size());
+  putBytes(kTrailerMagic, sizeof(kTrailerMagic));
+  flush();
+  // The rename must not reach the disk before the data does
+  folly::checkUnixError(fsync(file_.fd()), "error syncing ", tmpPath_);
+  file_.close();
+  folly::checkUnixError(rename(tmpPath_.c_str(), path_.c_str()),
+                        "error renaming ", tmpPath_, " to ", path_);
+  finished_ = true;
+  return flushed_;
+}
+
+void StateSnapshotWriter::startValue() {
+  if (open_.empty()) {
+    return;
+  }
+  auto& container = open_.back();
+  if (container.remaining == 0) {
+    throw FbossError("state snapshot container has more values than the ",
+                     "size it was begun with");
+  }
+  if (container.isObject) {
+    if (!container.haveKey) {
+      throw FbossError("state snapshot object member written without a key");
+    }
+    container.haveKey = false;
+  }
+  --container.remaining;
+}
+
+void StateSnapshotWriter::encode(const dynamic& value) {
+  switch (value.type()) {
+    case dynamic::NULLT:
+      putByte(TAG_NULL);
+      break;
+    case dynamic::BOOL:
+      putByte(value.asBool() ? TAG_TRUE : TAG_FALSE);
+      break;
+    case dynamic::INT64:
+      putByte(TAG_INT);
+      putVarint(zigzag(value.asInt()));
+      break;
+    case dynamic::DOUBLE: {
+      putByte(TAG_DOUBLE);
+      double d = value.asDouble();
+      uint64_t bits;
+      memcpy(&bits, &d, sizeof(bits));
+      putFixed64(bits);
+      break;
+    }
+    case dynamic::STRING:
+      putByte(TAG_STRING);
+      putString(StringPiece(value.c_str(), value.size()));
+      break;
+    case dynamic::ARRAY: {
+      auto start = beginContainer(TAG_ARRAY, value.size());
+      for (const auto& item : value) {
+        encode(item);
+      }
+      endContainer(start);
+      break;
+    }
+    case dynamic::OBJECT: {
+      auto start = beginContainer(TAG_OBJECT, value.size());
+      for (const auto& item : value.items()) {
+        encodeKey(item.first);
+        encode(item.second);
+      }
+      endContainer(start);
+      break;
+    }
+    default:
+      throw FbossError("cannot encode dynamic of type ", value.typeName(),
+                       " in a state snapshot");
+  }
+  maybeFlush();
+}
+
+void StateSnapshotWriter::encodeKey(const dynamic& key) {
+  if (!key.isString()) {
+    encode(key);
+    return;
+  }
+  encodeKey(StringPiece(key.c_str(), key.size()));
+}
+
+void StateSnapshotWriter::encodeKey(StringPiece key) {
+  auto ret = keyIds_.emplace(key.str(), keyList_.size());
+  if (ret.second) {
+    keyList_.push_back(key.str());
+  }
+  putByte(TAG_KEY);
+  putVarint(ret.first->second);
+}
+
+uint64_t StateSnapshotWriter::beginContainer(uint8_t tag, size_t count) {
+  putByte(tag);
+  auto start = offset();
+  // The length of the contents, filled in by endContainer()
+  putFixed32(0);
+  putVarint(count);
+  return start;
+}
+
+void StateSnapshotWriter::endContainer(uint64_t start) {
+  uint64_t length = offset() - start - sizeof(uint32_t);
+  if (length > std::numeric_limits<uint32_t>::max()) {
+    throw FbossError("state snapshot container too large: ", length,
+                     " bytes");
+  }
+  uint32_t value = folly::Endian::little(static_cast<uint32_t>(length));
+  if (start >= flushed_) {
+    memcpy(&buf_[start - flushed_], &value, sizeof(value));
+    return;
+  }
+  // Only containers larger than the buffer get here, so this is rare
+  auto ret = folly::pwriteFull(file_.fd(), &value, sizeof(value), start);
+  folly::checkUnixError(ret, "error writing state snapshot");
+}
+
+void StateSnapshotWriter::putByte(uint8_t value) {
+  buf_.push_back(static_cast<char>(value));
+}
+
+void StateSnapshotWriter::putBytes(const void* data, size_t length) {
+  buf_.append(static_cast<const char*>(data), length);
+}
+
+void StateSnapshotWriter::putVarint(uint64_t value) {
+  while (value >= 0x80) {
+    putByte(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  putByte(static_cast<uint8_t>(value));
+}
+
+void StateSnapshotWriter::putFixed32(uint32_t value) {
+  value = folly::Endian::little(value);
+  putBytes(&value, sizeof(value));
+}
+
+void StateSnapshotWriter::putFixed64(uint64_t value) {
+  value = folly::Endian::little(value);
+  putBytes(&value, sizeof(value));
+}
+
+void StateSnapshotWriter::putString(StringPiece str) {
+  putVarint(str.size());
+  putBytes(str.data(), str.size());
+}
+
+void StateSnapshotWriter::maybeFlush() {
+  if (buf_.size() >= kWriteBufferBytes) {
+    flush();
+  }
+}
+
+void StateSnapshotWriter::flush() {
+  auto ret = folly::writeFull(file_.fd(), buf_.data(), buf_.size());
+  folly::checkUnixError(ret, "error writing state snapshot");
+  flushed_ += buf_.size();
+  buf_.clear();
+}
+
+uint64_t writeStateSnapshot(StringPiece path, const dynamic& value) {
+  StateSnapshotWriter writer(path);
+  writer.value(value);
+  return writer.finish();
+}
+
+StateSnapshotReader::StateSnapshotReader(StringPiece path)
+  : map_(path.str().c_str()) {
+  auto data = map_.range();
+  if (data.size() < kHeaderLen + kTrailerLen ||
+      memcmp(data.data(), kMagic, sizeof(kMagic)) != 0 ||
+      memcmp(data.end() - sizeof(kTrailerMagic), kTrailerMagic,
+             sizeof(kTrailerMagic)) != 0) {
+    throw FbossError(path, " is not a complete state snapshot");
+  }
+  version_ = folly::Endian::little(
+      folly::loadUnaligned<uint32_t>(data.data() + sizeof(kMagic)));
+  if (version_ == 0 || version_ > kVersion) {
+    throw FbossError("unsupported state snapshot version ", version_,
+                     " in ", path);
+  }
+
+  auto trailer = data.end() - kTrailerLen;
+  auto keysOffset = folly::Endian::little(
+      folly::loadUnaligned<uint64_t>(trailer));
+  auto numKeys = folly::Endian::little(
+      folly::loadUnaligned<uint32_t>(trailer + sizeof(uint64_t)));
+  if (keysOffset < kHeaderLen || keysOffset > data.size() - kTrailerLen) {
+    throw FbossError("corrupt state snapshot ", path, ": bad key table");
+  }
+  body_ = ByteRange(data.data() + kHeaderLen, data.data() + keysOffset);
+
+  ByteRange keyData(data.data() + keysOffset, trailer);
+  keys_.reserve(numKeys);
+  for (uint32_t n = 0; n < numKeys; ++n) {
+    uint64_t length = 0;
+    for (uint32_t shift = 0; ; shift += 7) {
+      if (keyData.empty() || shift >= 64) {
+        throw FbossError("corrupt state snapshot ", path, ": bad key table");
+      }
+      auto byte = keyData[0];
+      keyData.advance(1);
+      length |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        break;
+      }
+    }
+    if (length > keyData.size()) {
+      throw FbossError("corrupt state snapshot ", path, ": bad key table");
+    }
+    keys_.emplace_back(reinterpret_cast<const char*>(keyData.data()), length);
+    keyData.advance(length);
+  }
+}
+
+bool StateSnapshotReader::isSnapshot(StringPiece path) {
+  folly::File file(path.str().c_str());
+  char magic[sizeof(kMagic)];
+  auto ret = folly::readFull(file.fd(), magic, sizeof(magic));
+  folly::checkUnixError(ret, "error reading ", path);
+  return ret == sizeof(magic) && memcmp(magic, kMagic, sizeof(magic)) == 0;
+}
+
+dynamic StateSnapshotReader::get() const {
+  Decoder decoder(body_, keys_);
+  auto value = decoder.decode();
+  if (!decoder.done()) {
+    throw FbossError("corrupt state snapshot: trailing data");
+  }
+  return value;
+}
+
+dynamic StateSnapshotReader::get(StringPiece key) const {
+  Decoder decoder(body_, keys_);
+  return decoder.decodeMember(key);
+}
+
+}} // facebook::fboss
@@ -0,0 +1,181 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/File.h>
+#include <folly/MemoryMapping.h>
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * A compact binary encoding of the folly::dynamic trees that SwitchState
+ * and HwSwitch serialize themselves to, used for the warm boot state file.
+ *
+ * The encoding follows the folly::dynamic that each node converts itself
+ * to, so a snapshot decodes back into the same dynamic and is restored with
+ * the usual fromFollyDynamic() calls.  Nodes are written with
+ * NodeBaseT::writeSnapshot(), which the large maps override to stream their
+ * entries one at a time instead of converting the whole map.
+ *
+ * Compared with JSON it avoids printing and parsing numbers and addresses
+ * as text, and it stores each distinct object key once, in a key table at
+ * the end of the file, rather than once per node.
+ *
+ * The layout of a snapshot file is:
+ *
+ *   header:   "FBSS", u32 format version, u32 reserved
+ *   body:     one encoded value
+ *   keys:     the object keys, as varint length + bytes
+ *   trailer:  u64 key table offset, u32 number of keys, "FBSE"
+ *
+ * Values are a tag byte followed by the payload.  Arrays and objects start
+ * with the byte length of their contents, so a reader can skip a subtree
+ * without decoding it.  All fixed width integers are little endian.
+ */
+
+/*
+ * Writes a snapshot file, one value at a time.
+ *
+ * The file is written as it is encoded, through a small buffer, rather than
+ * encoded to memory first.  Objects and arrays are written by announcing
+ * their size with beginObject() or beginArray(), writing that many members
+ * (key() then a value) or items, and calling end().  The values inside can
+ * themselves be containers written this way, so a caller can stream a large
+ * tree, such as a SwitchState with its routes and neighbor entries, without
+ * first converting all of it to a folly::dynamic.
+ *
+ * The snapshot is written to path.tmp and only renamed over path by
+ * finish(), so a crash while writing leaves any previous file at path
+ * intact.  A writer destroyed before finish() removes path.tmp.
+ *
+ * Throws on error.
+ */
+class StateSnapshotWriter {
+ public:
+  explicit StateSnapshotWriter(folly::StringPiece path);
+  ~StateSnapshotWriter();
+
+  void beginObject(size_t numMembers);
+  void beginArray(size_t numItems);
+  void key(folly::StringPiece key);
+  void value(const folly::dynamic& value);
+  void end();
+
+  /*
+   * Write the key table and trailer, close the file and move it into place.
+   * Returns the size of the file.
+   */
+  uint64_t finish();
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  StateSnapshotWriter(StateSnapshotWriter const &) = delete;
+  StateSnapshotWriter& operator=(StateSnapshotWriter const &) = delete;
+
+  struct Container {
+    uint64_t start;
+    // Members or items still to be written
+    size_t remaining;
+    bool isObject;
+    bool haveKey;
+  };
+
+  uint64_t offset() const {
+    return flushed_ + buf_.size();
+  }
+
+  void encode(const folly::dynamic& value);
+  void encodeKey(const folly::dynamic& key);
+  void encodeKey(folly::StringPiece key);
+  uint64_t beginContainer(uint8_t tag, size_t count);
+  void endContainer(uint64_t start);
+  void startValue();
+  void putByte(uint8_t value);
+  void putBytes(const void* data, size_t length);
+  void putVarint(uint64_t value);
+  void putFixed32(uint32_t value);
+  void putFixed64(uint64_t value);
+  void putString(folly::StringPiece str);
+  void maybeFlush();
+  void flush();
+
+  std::string path_;
+  std::string tmpPath_;
+  folly::File file_;
+  bool finished_{false};
+  std::string buf_;
+  uint64_t flushed_{0};
+  // The containers begun but not yet ended, innermost last
+  std::vector<Container> open_;
+  std::unordered_map<std::string, uint32_t> keyIds_;
+  std::vector<std::string> keyList_;
+};
+
+/*
+ * Encode the value and write it to path, replacing any existing file once
+ * the new one is complete.
+ *
+ * Returns the size of the file.  Throws on error.
+ */
+uint64_t writeStateSnapshot(folly::StringPiece path,
+                            const folly::dynamic& value);
+
+/*
+ * Reads a snapshot file.
+ *
+ * The file is mapped rather than read, and values are only decoded when
+ * asked for, so fetching one member of the top level object doesn't pay
+ * for the others.  Throws an FbossError if the file is not a valid
+ * snapshot.
+ */
+class StateSnapshotReader {
+ public:
+  explicit StateSnapshotReader(folly::StringPiece path);
+
+  /*
+   * Return true if the file at path looks like a snapshot, as opposed to a
+   * JSON state file.
+   */
+  static bool isSnapshot(folly::StringPiece path);
+
+  uint32_t version() const {
+    return version_;
+  }
+
+  /*
+   * Decode the whole snapshot.
+   */
+  folly::dynamic get() const;
+
+  /*
+   * Decode one member of the top level object, skipping the others.
+   * Returns null if the top level object has no such member.
+   */
+  folly::dynamic get(folly::StringPiece key) const;
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  StateSnapshotReader(StateSnapshotReader const &) = delete;
+  StateSnapshotReader& operator=(StateSnapshotReader const &) = delete;
+
+  folly::MemoryMapping map_;
+  folly::ByteRange body_;
+  std::vector<folly::StringPiece> keys_;
+  uint32_t version_{0};
+};
+
+}} // facebook::fboss
@@ -18,7 +18,9 @@
 
 #include <folly/Range.h>
 #include <folly/String.h>
+#include <folly/futures/Promise.h>
 #include "fboss/agent/state/StateUpdate.h"
+#include "fboss/agent/state/SwitchState.h"
 
 namespace facebook { namespace fboss {
 
@@ -129,4 +131,65 @@ class BlockingStateUpdate : public StateUpdate {
   std::shared_ptr<BlockingUpdateResult> result_;
 };
 
+/*
+ * What an asynchronous update did to the SwitchState.
+ *
+ * The generations are those of the state the update function was given and
+ * of the state it returned.  They are equal if the update made no changes.
+ */
+struct StateDeltaSummary {
+  uint32_t oldGeneration{0};
+  uint32_t newGeneration{0};
+
+  bool changed() const {
+    return oldGeneration != newGeneration;
+  }
+};
+
+/*
+ * A StateUpdate that fulfills a promise once the update has been applied to
+ * the hardware, instead of blocking the caller.
+ *
+ * If the update is dropped without being applied (e.g., because the switch is
+ * exiting) the promise is broken.
+ */
+class AsyncStateUpdate : public StateUpdate {
+ public:
+  typedef std::function<
+    std::shared_ptr<SwitchState>(const std::shared_ptr<SwitchState>&)>
+    StateUpdateFn;
+
+  AsyncStateUpdate(folly::StringPiece name,
+                   StateUpdateFn fn,
+                   folly::Promise<StateDeltaSummary> promise,
+                   bool allowCoalesce = true)
+    : StateUpdate(name, allowCoalesce),
+      function_(fn),
+      promise_(std::move(promise)) {}
+
+  std::shared_ptr<SwitchState> applyUpdate(
+      const std::shared_ptr<SwitchState>& origState) override {
+    auto newState = function_(origState);
+    summary_.oldGeneration = origState->getGeneration();
+    summary_.newGeneration =
+      newState ? newState->getGeneration() : summary_.oldGeneration;
+    return newState;
+  }
+
+  void onError(const std::exception& ex) noexcept override {
+    // As in BlockingStateUpdate, std::current_exception() keeps the original
+    // exception type.
+    promise_.setException(std::current_exception());
+  }
+
+  void onSuccess() override {
+    promise_.setValue(summary_);
+  }
+
+ private:
+  StateUpdateFn function_;
+  folly::Promise<StateDeltaSummary> promise_;
+  StateDeltaSummary summary_;
+};
+
 }} // facebook::fboss
@@ -20,6 +20,7 @@
 #include "fboss/agent/state/RouteTableMap.h"
 #include "fboss/agent/state/AclEntry.h"
 #include "fboss/agent/state/AclMap.h"
+#include "fboss/agent/state/StateSnapshot.h"
 
 #include "fboss/agent/state/NodeBase-defs.h"
 
@@ -39,10 +40,52 @@ constexpr auto kNdpTimeout = "ndpTimeout";
 constexpr auto kArpAgerInterval = "arpAgerInterval";
 constexpr auto kMaxNeighborProbes = "maxNeighborProbes";
 constexpr auto kStaleEntryInterval = "staleEntryInterval";
+constexpr auto kPacketPolicers = "packetPolicers";
+constexpr auto kPacketClass = "packetClass";
+constexpr auto kPacketsPerSecond = "packetsPerSecond";
+constexpr auto kBurstSize = "burstSize";
 }
 
 namespace facebook { namespace fboss {
 
+namespace {
+
+folly::dynamic packetPolicersToFollyDynamic(
+    const std::vector<cfg::PacketPolicer>& policers) {
+  folly::dynamic policersJson = folly::dynamic::array;
+  for (const auto& policer : policers) {
+    auto itr_class =
+      cfg::_PacketPolicerClass_VALUES_TO_NAMES.find(policer.packetClass);
+    CHECK(itr_class != cfg::_PacketPolicerClass_VALUES_TO_NAMES.end());
+    folly::dynamic policerJson = folly::dynamic::object;
+    policerJson[kPacketClass] = itr_class->second;
+    policerJson[kPacketsPerSecond] = policer.packetsPerSecond;
+    policerJson[kBurstSize] = policer.burstSize;
+    policersJson.push_back(policerJson);
+  }
+  return policersJson;
+}
+
+std::vector<cfg::PacketPolicer>
+packetPolicersFromFollyDynamic(const folly::dynamic& policersJson) {
+  std::vector<cfg::PacketPolicer> policers;
+  for (const auto& policerJson : policersJson) {
+    cfg::PacketPolicer policer;
+    auto itr_class = cfg::_PacketPolicerClass_NAMES_TO_VALUES.find(
+      policerJson[kPacketClass].asString().c_str());
+    if (itr_class == cfg::_PacketPolicerClass_NAMES_TO_VALUES.end()) {
+      throw FbossError("Unsupported packet policer class ",
+                       policerJson[kPacketClass].asString());
+    }
+    policer.packetClass = cfg::PacketPolicerClass(itr_class->second);
+    policer.packetsPerSecond = policerJson[kPacketsPerSecond].asInt();
+    policer.burstSize = policerJson[kBurstSize].asInt();
+    policers.push_back(policer);
+  }
+  return policers;
+}
+}
+
 SwitchStateFields::SwitchStateFields()
   : ports(make_shared<PortMap>()),
     vlans(make_shared<VlanMap>()),
@@ -59,9 +102,29 @@ folly::dynamic SwitchStateFields::toFollyDynamic() const {
   switchState[kRouteTables] = routeTables->toFollyDynamic();
   switchState[kAcls] = acls->toFollyDynamic();
   switchState[kDefaultVlan] = static_cast<uint32_t>(defaultVlan);
+  switchState[kPacketPolicers] = packetPolicersToFollyDynamic(packetPolicers);
   return switchState;
 }
 
+void SwitchStateFields::writeSnapshot(StateSnapshotWriter* writer) const {
+  writer->beginObject(7);
+  writer->key(kInterfaces);
+  interfaces->writeSnapshot(writer);
+  writer->key(kPorts);
+  ports->writeSnapshot(writer);
+  writer->key(kVlans);
+  vlans->writeSnapshot(writer);
+  writer->key(kRouteTables);
+  routeTables->writeSnapshot(writer);
+  writer->key(kAcls);
+  acls->writeSnapshot(writer);
+  writer->key(kDefaultVlan);
+  writer->value(static_cast<uint32_t>(defaultVlan));
+  writer->key(kPacketPolicers);
+  writer->value(packetPolicersToFollyDynamic(packetPolicers));
+  writer->end();
+}
+
 SwitchStateFields
 SwitchStateFields::fromFollyDynamic(const folly::dynamic& swJson) {
   SwitchStateFields switchState;
@@ -73,6 +136,11 @@ SwitchStateFields::fromFollyDynamic(const folly::dynamic& swJson) {
       swJson[kRouteTables]);
   switchState.acls = AclMap::fromFollyDynamic(swJson[kAcls]);
   switchState.defaultVlan = VlanID(swJson[kDefaultVlan].asInt());
+  // Not in the state saved by older versions
+  if (swJson.find(kPacketPolicers) != swJson.items().end()) {
+    switchState.packetPolicers =
+      packetPolicersFromFollyDynamic(swJson[kPacketPolicers]);
+  }
   //TODO verify that created state here is internally consistent t4155406
   return switchState;
 }
@@ -140,6 +208,10 @@ void SwitchState::setStaleEntryInterval(seconds interval) {
   writableFields()->staleEntryInterval = interval;
 }
 
+void SwitchState::setPacketPolicers(std::vector<cfg::PacketPolicer> policers) {
+  writableFields()->packetPolicers.swap(policers);
+}
+
 void SwitchState::addIntf(const std::shared_ptr<Interface>& intf) {
   auto* fields = writableFields();
   // For ease-of-use, automatically clone the InterfaceMap if we are still
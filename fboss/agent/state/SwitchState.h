@@ -11,11 +11,13 @@
 
 #include <chrono>
 #include <memory>
+#include <vector>
 
 #include <folly/FBString.h>
 #include <folly/dynamic.h>
 #include <folly/Memory.h>
 
+#include "fboss/agent/gen-cpp/switch_config_types.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/state/NodeBase.h"
 
@@ -47,6 +49,11 @@ struct SwitchStateFields {
    * Serialize to folly::dynamic
    */
   folly::dynamic toFollyDynamic() const;
+  /*
+   * Write to a state snapshot in the toFollyDynamic() form, one map entry
+   * at a time
+   */
+  void writeSnapshot(StateSnapshotWriter* writer) const;
   /*
    * Reconstruct object from folly::dynamic
    */
@@ -69,6 +76,9 @@ struct SwitchStateFields {
   // NeighborCache configuration values
   uint32_t maxNeighborProbes{3};
   std::chrono::seconds staleEntryInterval{10};
+
+  // Software policers for trapped packets, sorted by class
+  std::vector<cfg::PacketPolicer> packetPolicers;
 };
 
 /*
@@ -137,6 +147,10 @@ class SwitchState : public NodeBaseT<SwitchState, SwitchStateFields> {
     return getFields()->toFollyDynamic();
   }
 
+  void writeSnapshot(StateSnapshotWriter* writer) const override {
+    getFields()->writeSnapshot(writer);
+  }
+
   static void modify(std::shared_ptr<SwitchState>* state);
 
   const std::shared_ptr<PortMap>& getPorts() const {
@@ -195,6 +209,10 @@ class SwitchState : public NodeBaseT<SwitchState, SwitchStateFields> {
 
   void setStaleEntryInterval(std::chrono::seconds interval);
 
+  const std::vector<cfg::PacketPolicer>& getPacketPolicers() const {
+    return getFields()->packetPolicers;
+  }
+  void setPacketPolicers(std::vector<cfg::PacketPolicer> policers);
 
   /*
    * The following functions modify the static state.
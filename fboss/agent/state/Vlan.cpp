@@ -15,6 +15,7 @@
 #include "fboss/agent/state/ArpTable.h"
 #include "fboss/agent/state/NdpResponseTable.h"
 #include "fboss/agent/state/NdpTable.h"
+#include "fboss/agent/state/StateSnapshot.h"
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/state/VlanMap.h"
 
@@ -89,28 +90,35 @@ VlanFields::VlanFields(VlanID _id,
     ndpResponseTable(new NdpResponseTable) {
 }
 
-folly::dynamic VlanFields::toFollyDynamic() const {
+namespace {
+// Everything but the neighbor and response tables
+folly::dynamic vlanAttrsToFollyDynamic(const VlanFields& fields) {
   folly::dynamic vlan = folly::dynamic::object;
-  vlan[kVlanId] = static_cast<uint16_t>(id);
-  vlan[kVlanName] = name;
-  vlan[kIntfID] = static_cast<uint32_t>(intfID);
-  vlan[kDhcpV4Relay] = dhcpV4Relay.str();
-  vlan[kDhcpV6Relay] = dhcpV6Relay.str();
+  vlan[kVlanId] = static_cast<uint16_t>(fields.id);
+  vlan[kVlanName] = fields.name;
+  vlan[kIntfID] = static_cast<uint32_t>(fields.intfID);
+  vlan[kDhcpV4Relay] = fields.dhcpV4Relay.str();
+  vlan[kDhcpV6Relay] = fields.dhcpV6Relay.str();
   vlan[kDhcpV4RelayOverrides] = folly::dynamic::object;
-  for (const auto& o: dhcpRelayOverridesV4) {
+  for (const auto& o: fields.dhcpRelayOverridesV4) {
     vlan[kDhcpV4RelayOverrides][o.first.toString()] = o.second.str();
   }
   vlan[kDhcpV6RelayOverrides] = folly::dynamic::object;
-  for (const auto& o: dhcpRelayOverridesV6) {
+  for (const auto& o: fields.dhcpRelayOverridesV6) {
     vlan[kDhcpV6RelayOverrides][o.first.toString()] = o.second.str();
   }
   folly::dynamic memberPorts = folly::dynamic::object;
-  for (const auto& port: ports) {
-    folly::dynamic portInfo = folly::dynamic::object;
+  for (const auto& port: fields.ports) {
     memberPorts[to<string>(static_cast<uint16_t>(port.first))] =
         port.second.toFollyDynamic();
   }
   vlan[kMemberPorts] = memberPorts;
+  return vlan;
+}
+} // unnamed namespace
+
+folly::dynamic VlanFields::toFollyDynamic() const {
+  auto vlan = vlanAttrsToFollyDynamic(*this);
   vlan[kArpTable] = arpTable->toFollyDynamic();
   vlan[kNdpTable] = ndpTable->toFollyDynamic();
   vlan[kArpResponseTable] = arpResponseTable->toFollyDynamic();
@@ -118,6 +126,24 @@ folly::dynamic VlanFields::toFollyDynamic() const {
   return vlan;
 }
 
+void VlanFields::writeSnapshot(StateSnapshotWriter* writer) const {
+  auto vlan = vlanAttrsToFollyDynamic(*this);
+  writer->beginObject(vlan.size() + 4);
+  for (const auto& item: vlan.items()) {
+    writer->key(item.first.stringPiece());
+    writer->value(item.second);
+  }
+  writer->key(kArpTable);
+  arpTable->writeSnapshot(writer);
+  writer->key(kNdpTable);
+  ndpTable->writeSnapshot(writer);
+  writer->key(kArpResponseTable);
+  arpResponseTable->writeSnapshot(writer);
+  writer->key(kNdpResponseTable);
+  ndpResponseTable->writeSnapshot(writer);
+  writer->end();
+}
+
 VlanFields VlanFields::fromFollyDynamic(const folly::dynamic& vlanJson) {
   VlanFields vlan(VlanID(vlanJson[kVlanId].asInt()),
       vlanJson[kVlanName].asString());
@@ -69,6 +69,8 @@ struct VlanFields {
   }
 
   folly::dynamic toFollyDynamic() const;
+  // Streams the neighbor tables rather than converting them whole
+  void writeSnapshot(StateSnapshotWriter* writer) const;
   static VlanFields fromFollyDynamic(const folly::dynamic& vlanJson);
 
   const VlanID id{0};
@@ -116,6 +118,10 @@ class Vlan : public NodeBaseT<Vlan, VlanFields> {
     return getFields()->toFollyDynamic();
   }
 
+  void writeSnapshot(StateSnapshotWriter* writer) const override {
+    getFields()->writeSnapshot(writer);
+  }
+
   VlanID getID() const {
     return getFields()->id;
   }
@@ -88,6 +88,87 @@ TEST(Interface, addrToReach) {
   EXPECT_EQ(0, ret.mask);
 }
 
+TEST(InterfaceMap, publishedLookups) {
+  MockPlatform platform;
+  cfg::SwitchConfig config;
+  config.vlans.resize(2);
+  config.vlans[0].id = 1;
+  config.vlans[1].id = 2;
+  config.interfaces.resize(2);
+  auto* intfConfig = &config.interfaces[0];
+  intfConfig->intfID = 1;
+  intfConfig->vlanID = 1;
+  intfConfig->routerID = 0;
+  intfConfig->mac = "00:02:00:11:22:33";
+  intfConfig->__isset.mac = true;
+  intfConfig->ipAddresses.resize(2);
+  intfConfig->ipAddresses[0] = "10.0.0.1/8";
+  intfConfig->ipAddresses[1] = "2401:db00::1/32";
+
+  intfConfig = &config.interfaces[1];
+  intfConfig->intfID = 2;
+  intfConfig->vlanID = 2;
+  intfConfig->routerID = 0;
+  intfConfig->mac = "00:02:00:11:22:44";
+  intfConfig->__isset.mac = true;
+  intfConfig->ipAddresses.resize(2);
+  intfConfig->ipAddresses[0] = "10.1.1.1/24";
+  intfConfig->ipAddresses[1] = "2401:db00:1::1/64";
+
+  shared_ptr<SwitchState> oldState = make_shared<SwitchState>();
+  auto state = publishAndApplyConfig(oldState, &config, &platform);
+  ASSERT_NE(nullptr, state);
+  auto intfs = state->getInterfaces();
+
+  auto check = [&]() {
+    auto intf1 = intfs->getInterface(InterfaceID(1));
+    auto intf2 = intfs->getInterface(InterfaceID(2));
+
+    EXPECT_EQ(intf1, intfs->getInterfaceIf(RouterID(0), IPAddress("10.0.0.1")));
+    EXPECT_EQ(intf2, intfs->getInterface(RouterID(0),
+                                         IPAddress("2401:db00:1::1")));
+    EXPECT_EQ(nullptr, intfs->getInterfaceIf(RouterID(1),
+                                             IPAddress("10.0.0.1")));
+    EXPECT_EQ(nullptr, intfs->getInterfaceIf(RouterID(0),
+                                             IPAddress("10.0.0.2")));
+    EXPECT_THROW(intfs->getInterface(RouterID(0), IPAddress("10.0.0.2")),
+                 FbossError);
+
+    EXPECT_EQ(intf1, intfs->getInterfaceInVlanIf(VlanID(1)));
+    EXPECT_EQ(intf2, intfs->getInterfaceInVlan(VlanID(2)));
+    EXPECT_EQ(nullptr, intfs->getInterfaceInVlanIf(VlanID(3)));
+    EXPECT_THROW(intfs->getInterfaceInVlan(VlanID(3)), FbossError);
+
+    // The most specific subnet wins, even though intf1's subnets contain
+    // intf2's
+    auto ret = intfs->getIntfAddrToReach(RouterID(0), IPAddress("10.1.1.9"));
+    EXPECT_EQ(intf2.get(), ret.intf);
+    EXPECT_EQ(IPAddress("10.1.1.1"), *ret.addr);
+    EXPECT_EQ(24, ret.mask);
+    ret = intfs->getIntfAddrToReach(RouterID(0), IPAddress("10.1.2.9"));
+    EXPECT_EQ(intf1.get(), ret.intf);
+    EXPECT_EQ(IPAddress("10.0.0.1"), *ret.addr);
+    EXPECT_EQ(8, ret.mask);
+    ret = intfs->getIntfAddrToReach(RouterID(0),
+                                    IPAddress("2401:db00:1::99"));
+    EXPECT_EQ(intf2.get(), ret.intf);
+    EXPECT_EQ(64, ret.mask);
+    ret = intfs->getIntfAddrToReach(RouterID(0), IPAddress("2401:db00:2::1"));
+    EXPECT_EQ(intf1.get(), ret.intf);
+    EXPECT_EQ(32, ret.mask);
+    ret = intfs->getIntfAddrToReach(RouterID(0), IPAddress("11.0.0.1"));
+    EXPECT_EQ(nullptr, ret.intf);
+    EXPECT_EQ(nullptr, ret.addr);
+    EXPECT_EQ(0, ret.mask);
+  };
+
+  // The linear search and the indices must agree
+  check();
+  state->publish();
+  ASSERT_TRUE(intfs->isPublished());
+  check();
+}
+
 TEST(Interface, applyConfig) {
   MockPlatform platform;
   cfg::SwitchConfig config;
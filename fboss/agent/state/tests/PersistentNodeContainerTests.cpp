@@ -0,0 +1,207 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/NodeMapDelta.h"
+#include "fboss/agent/state/NodeMapDelta-defs.h"
+#include "fboss/agent/state/NodeMapIterator.h"
+#include "fboss/agent/state/PersistentNodeContainer.h"
+
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+using namespace facebook::fboss;
+using std::make_pair;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+struct TestNode {
+  explicit TestNode(uint32_t id) : id(id) {}
+  uint32_t getID() const {
+    return id;
+  }
+  uint32_t id;
+};
+
+typedef PersistentNodeContainer<uint32_t, TestNode> Container;
+typedef std::map<uint32_t, shared_ptr<TestNode>> RefMap;
+
+// Just enough of a NodeMapT for NodeMapDelta
+struct TestMap {
+  struct Traits {
+    static uint32_t getKey(const shared_ptr<TestNode>& node) {
+      return node->getID();
+    }
+  };
+  typedef TestNode Node;
+  typedef NodeMapIterator<TestNode, Container> Iterator;
+
+  Iterator begin() const {
+    return Iterator(nodes.begin());
+  }
+  Iterator end() const {
+    return Iterator(nodes.end());
+  }
+
+  Container nodes;
+};
+
+void checkEqual(const RefMap& expected, const Container& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  auto it = actual.begin();
+  for (const auto& entry : expected) {
+    ASSERT_TRUE(it != actual.end());
+    EXPECT_EQ(entry.first, it->first);
+    EXPECT_EQ(entry.second, it->second);
+    ++it;
+  }
+  EXPECT_TRUE(it == actual.end());
+
+  auto rit = actual.rbegin();
+  for (auto expectedIt = expected.rbegin(); expectedIt != expected.rend();
+       ++expectedIt) {
+    ASSERT_TRUE(rit != actual.rend());
+    EXPECT_EQ(expectedIt->first, rit->first);
+    ++rit;
+  }
+  EXPECT_TRUE(rit == actual.rend());
+}
+
+Container makeContainer(uint32_t numNodes) {
+  Container nodes;
+  for (uint32_t i = 0; i < numNodes; ++i) {
+    nodes.insert(make_pair(i * 2, make_shared<TestNode>(i * 2)));
+  }
+  return nodes;
+}
+
+} // unnamed namespace
+
+TEST(PersistentNodeContainer, CompareWithMap) {
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<uint32_t> keyDist(0, 4000);
+  std::uniform_int_distribution<int> opDist(0, 9);
+
+  RefMap expected;
+  Container actual;
+  std::vector<std::pair<RefMap, Container>> snapshots;
+  for (int n = 0; n < 20000; ++n) {
+    auto key = keyDist(gen);
+    auto op = opDist(gen);
+    auto node = make_shared<TestNode>(key);
+    if (op < 5) {
+      auto ret = actual.insert(make_pair(key, node));
+      auto expectedRet = expected.insert(make_pair(key, node));
+      EXPECT_EQ(expectedRet.second, ret.second);
+      EXPECT_EQ(key, ret.first->first);
+    } else if (op < 7) {
+      actual[key] = node;
+      expected[key] = node;
+    } else {
+      EXPECT_EQ(expected.erase(key), actual.erase(key));
+    }
+
+    auto it = actual.lower_bound(key);
+    auto expectedIt = expected.lower_bound(key);
+    if (expectedIt == expected.end()) {
+      EXPECT_TRUE(it == actual.end());
+    } else {
+      ASSERT_TRUE(it != actual.end());
+      EXPECT_EQ(expectedIt->first, it->first);
+    }
+
+    if (n % 500 == 0) {
+      checkEqual(expected, actual);
+      snapshots.emplace_back(expected, actual);
+    }
+  }
+  checkEqual(expected, actual);
+
+  // Copies taken along the way must not have been affected by later changes
+  for (const auto& snapshot : snapshots) {
+    checkEqual(snapshot.first, snapshot.second);
+  }
+
+  // Erase everything through iterators
+  auto it = actual.begin();
+  while (it != actual.end()) {
+    auto key = it->first;
+    it = actual.erase(it);
+    if (it != actual.end()) {
+      EXPECT_LT(key, it->first);
+    }
+  }
+  EXPECT_TRUE(actual.empty());
+  checkEqual(snapshots.back().first, snapshots.back().second);
+}
+
+TEST(PersistentNodeContainer, CopySharesNodes) {
+  auto orig = makeContainer(20000);
+  auto copy = orig;
+  auto node = make_shared<TestNode>(5000);
+  copy[5000] = node;
+  EXPECT_EQ(node, copy.find(5000)->second);
+  EXPECT_NE(node, orig.find(5000)->second);
+
+  // Only the leaf holding the modified entry differs, so walking both
+  // containers side by side needs a handful of steps rather than 20000.
+  auto oldIt = orig.begin();
+  auto newIt = copy.begin();
+  int steps = 0;
+  int changed = 0;
+  while (oldIt != orig.end()) {
+    ASSERT_TRUE(newIt != copy.end());
+    ASSERT_EQ(oldIt->first, newIt->first);
+    if (oldIt->second == newIt->second) {
+      skipSharedEntries(&oldIt, &newIt);
+    } else {
+      ++changed;
+      ++oldIt;
+      ++newIt;
+    }
+    ++steps;
+  }
+  EXPECT_TRUE(newIt == copy.end());
+  EXPECT_EQ(1, changed);
+  EXPECT_LT(steps, 200);
+}
+
+TEST(PersistentNodeContainer, Delta) {
+  TestMap oldMap;
+  oldMap.nodes = makeContainer(20000);
+  TestMap newMap;
+  newMap.nodes = oldMap.nodes;
+
+  std::map<uint32_t, std::pair<bool, bool>> expected;
+  auto changed = make_shared<TestNode>(100);
+  newMap.nodes[100] = changed;
+  expected[100] = make_pair(true, true);
+  newMap.nodes.insert(make_pair(20001, make_shared<TestNode>(20001)));
+  expected[20001] = make_pair(false, true);
+  newMap.nodes.erase(30000);
+  expected[30000] = make_pair(true, false);
+
+  std::map<uint32_t, std::pair<bool, bool>> actual;
+  for (const auto& delta :
+       NodeMapDelta<TestMap>(&oldMap, &newMap)) {
+    auto node = delta.getOld() ? delta.getOld() : delta.getNew();
+    actual[node->getID()] = make_pair(bool(delta.getOld()),
+                                      bool(delta.getNew()));
+  }
+  EXPECT_EQ(expected, actual);
+
+  int numChanges = 0;
+  for (const auto& delta : NodeMapDelta<TestMap>(&oldMap, &oldMap)) {
+    (void)delta;
+    ++numChanges;
+  }
+  EXPECT_EQ(0, numChanges);
+}
@@ -0,0 +1,213 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Memory.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteLookupTable.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/lib/RadixTree.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace facebook::fboss;
+using facebook::network::RadixTree;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+using std::make_shared;
+using std::shared_ptr;
+
+DEFINE_int32(num_v4_routes, 600000, "The number of IPv4 routes");
+DEFINE_int32(num_v6_routes, 150000, "The number of IPv6 routes");
+DEFINE_int32(num_lookups, 100000,
+             "The number of addresses looked up in each iteration");
+
+/*
+ * Longest prefix match in a full table, with the RadixTree, the RIB's
+ * PersistentRadixTree and the RouteLookupTable built from the RIB.
+ *
+ * The prefix lengths roughly follow those in the global BGP tables, and most
+ * looked up addresses are within one of the prefixes.
+ */
+
+namespace {
+
+template<typename AddrT>
+struct Table {
+  shared_ptr<RouteTableRib<AddrT>> rib;
+  RadixTree<AddrT, shared_ptr<Route<AddrT>>> tree;
+  std::unique_ptr<RouteLookupTable<AddrT>> lookupTable;
+  std::vector<AddrT> addrs;
+};
+
+Table<IPAddressV4> v4;
+Table<IPAddressV6> v6;
+
+// Prefix lengths and their weights
+const std::vector<std::pair<uint8_t, uint32_t>> kV4Lengths = {
+  {8, 1}, {12, 2}, {14, 5}, {16, 25}, {17, 10}, {18, 15}, {19, 30},
+  {20, 50}, {21, 50}, {22, 120}, {23, 90}, {24, 600},
+};
+const std::vector<std::pair<uint8_t, uint32_t>> kV6Lengths = {
+  {19, 1}, {28, 5}, {29, 40}, {32, 150}, {36, 40}, {40, 60}, {44, 80},
+  {46, 20}, {47, 20}, {48, 550}, {56, 15}, {64, 20},
+};
+
+IPAddressV4 randomAddr(std::mt19937* gen, const IPAddressV4*) {
+  return IPAddressV4::fromLongHBO((*gen)());
+}
+
+IPAddressV6 randomAddr(std::mt19937* gen, const IPAddressV6*) {
+  folly::ByteArray16 bytes;
+  for (auto& byte : bytes) {
+    byte = (*gen)();
+  }
+  // Global unicast, like the routed address space
+  bytes[0] = 0x20 | (bytes[0] & 0x0f);
+  return IPAddressV6(bytes);
+}
+
+template<typename AddrT>
+void initTable(Table<AddrT>* table, uint32_t numRoutes,
+               const std::vector<std::pair<uint8_t, uint32_t>>& lengths) {
+  std::mt19937 gen(numRoutes);
+  std::vector<uint32_t> weights;
+  for (const auto& length : lengths) {
+    weights.push_back(length.second);
+  }
+  std::discrete_distribution<size_t> pickLength(weights.begin(),
+                                                weights.end());
+  const AddrT* tag = nullptr;
+
+  table->rib = make_shared<RouteTableRib<AddrT>>();
+  while (table->rib->size() < numRoutes) {
+    auto addr = randomAddr(&gen, tag);
+    auto mask = lengths[pickLength(gen)].first;
+    RoutePrefix<AddrT> prefix{addr.mask(mask), mask};
+    if (table->rib->exactMatch(prefix)) {
+      continue;
+    }
+    auto route = make_shared<Route<AddrT>>(prefix, DROP);
+    table->rib->addRoute(route);
+    table->tree.insert(prefix.network, prefix.mask, route);
+    // Look up addresses within a prefix 9 times out of 10
+    if (gen() % 10) {
+      table->addrs.push_back(addr);
+    } else {
+      table->addrs.push_back(randomAddr(&gen, tag));
+    }
+  }
+  table->rib->publish();
+  table->lookupTable = folly::make_unique<RouteLookupTable<AddrT>>(
+      table->rib->routes());
+  std::shuffle(table->addrs.begin(), table->addrs.end(), gen);
+  table->addrs.resize(
+      std::min<size_t>(table->addrs.size(), FLAGS_num_lookups));
+
+  LOG(INFO) << table->rib->size() << " routes: lookup table uses "
+            << table->lookupTable->memoryUsage() << " bytes in "
+            << table->lookupTable->numLevels() << " levels";
+}
+
+template<typename AddrT>
+void radixTreeLookups(const Table<AddrT>& table) {
+  for (const auto& addr : table.addrs) {
+    auto match = table.tree.longestMatch(addr, addr.bitCount());
+    folly::doNotOptimizeAway(match);
+  }
+}
+
+template<typename AddrT>
+void ribLookups(const Table<AddrT>& table) {
+  for (const auto& addr : table.addrs) {
+    auto route = table.rib->longestMatch(addr);
+    folly::doNotOptimizeAway(route);
+  }
+}
+
+template<typename AddrT>
+void lookupTableLookups(const Table<AddrT>& table) {
+  for (const auto& addr : table.addrs) {
+    const auto& route = table.lookupTable->longestMatch(addr);
+    folly::doNotOptimizeAway(route);
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK(RadixTreeLongestMatchV4, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    radixTreeLookups(v4);
+  }
+}
+
+BENCHMARK_RELATIVE(RibLongestMatchV4, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    ribLookups(v4);
+  }
+}
+
+BENCHMARK_RELATIVE(LookupTableLongestMatchV4, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    lookupTableLookups(v4);
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(RadixTreeLongestMatchV6, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    radixTreeLookups(v6);
+  }
+}
+
+BENCHMARK_RELATIVE(RibLongestMatchV6, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    ribLookups(v6);
+  }
+}
+
+BENCHMARK_RELATIVE(LookupTableLongestMatchV6, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    lookupTableLookups(v6);
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+// Building the table, which happens once per published RIB
+BENCHMARK(LookupTableBuildV4, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    RouteLookupTable<IPAddressV4> table(v4.rib->routes());
+    folly::doNotOptimizeAway(table.numLevels());
+  }
+}
+
+BENCHMARK(LookupTableBuildV6, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    RouteLookupTable<IPAddressV6> table(v6.rib->routes());
+    folly::doNotOptimizeAway(table.numLevels());
+  }
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  // Building the tables is far more expensive than the lookups being
+  // measured, so do it once up front.
+  initTable(&v4, FLAGS_num_v4_routes, kV4Lengths);
+  initTable(&v6, FLAGS_num_v6_routes, kV6Lengths);
+
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/RouteUpdater.h"
+
+#include <malloc.h>
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using std::make_shared;
+using std::shared_ptr;
+
+DEFINE_int32(num_routes, 500000, "The number of BGP routes in the RIB");
+DEFINE_int32(num_ecmp_groups, 300,
+             "The number of distinct nexthop sets used by the routes");
+DEFINE_int32(ecmp_width, 8, "The number of nexthops in each set");
+
+/*
+ * Memory used per route for a full table learnt over BGP, where the routes
+ * share a few hundred ECMP groups, and the cost of cloning and destroying
+ * routes.
+ */
+
+namespace {
+
+const RouterID kRid(0);
+
+shared_ptr<RouteTableMap> tables;
+std::vector<RouteNextHops> ecmpGroups;
+
+size_t heapInUse() {
+  return mallinfo().uordblks;
+}
+
+RouteNextHops makeGroup(uint32_t group) {
+  RouteNextHops nexthops;
+  for (uint32_t i = 0; i < FLAGS_ecmp_width; ++i) {
+    // Spread the groups' members over the connected subnet 1.0.0.0/16
+    auto member = (group * 7 + i * 13) % 65000 + 2;
+    nexthops.emplace(IPAddressV4::fromLongHBO((1 << 24) + member));
+  }
+  return nexthops;
+}
+
+void init() {
+  for (uint32_t i = 0; i < FLAGS_num_ecmp_groups; ++i) {
+    ecmpGroups.push_back(makeGroup(i));
+  }
+
+  auto before = heapInUse();
+  auto emptyTables = make_shared<RouteTableMap>();
+  RouteUpdater updater(emptyTables);
+  updater.addRoute(kRid, InterfaceID(1), IPAddress("1.0.0.1"), 16);
+  for (uint32_t i = 0; i < FLAGS_num_routes; ++i) {
+    auto network = IPAddressV4::fromLongHBO((10 << 24) + (i << 8));
+    updater.addRoute(kRid, IPAddress(network), 24,
+                     ecmpGroups[i % ecmpGroups.size()]);
+  }
+  tables = updater.updateDone();
+  CHECK(tables);
+  tables->publish();
+  auto ribBytes = heapInUse() - before;
+
+  // What the nexthops cost when each route holds its own copy of them
+  auto rib = tables->getRouteTable(kRid)->getRibV4();
+  before = heapInUse();
+  std::vector<std::pair<RouteNextHops, RouteForwardNexthops>> copies;
+  copies.reserve(rib->size());
+  for (const auto& itr : rib->routes()) {
+    const auto& route = itr.value();
+    copies.emplace_back(route->nexthops(),
+                        route->getForwardInfo().getNexthops());
+  }
+  auto copyBytes = heapInUse() - before;
+
+  LOG(INFO) << rib->size() << " routes, " << ribBytes / rib->size()
+            << " bytes per route with shared nexthops, "
+            << (ribBytes + copyBytes) / rib->size()
+            << " bytes per route with a copy of the nexthops in each route";
+}
+
+} // unnamed namespace
+
+// Clone a route, as RouteUpdater does for each changed route
+BENCHMARK(RouteClone, numIters) {
+  shared_ptr<RouteV4> route;
+  BENCHMARK_SUSPEND {
+    route = tables->getRouteTable(kRid)->getRibV4()->exactMatch(
+        RouteV4::Prefix{IPAddressV4("10.0.0.0"), 24});
+    CHECK(route);
+  }
+  for (size_t n = 0; n < numIters; ++n) {
+    auto clone = route->clone();
+    folly::doNotOptimizeAway(clone);
+  }
+}
+
+// Add a route with nexthops shared with other routes
+BENCHMARK(RouteCreateWithSharedNexthops, numIters) {
+  RouteV4::Prefix prefix{IPAddressV4("9.0.0.0"), 24};
+  for (size_t n = 0; n < numIters; ++n) {
+    const auto& nexthops = ecmpGroups[n % ecmpGroups.size()];
+    auto route = make_shared<RouteV4>(prefix, nexthops);
+    folly::doNotOptimizeAway(route);
+  }
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  init();
+
+  folly::runBenchmarks();
+  return 0;
+}
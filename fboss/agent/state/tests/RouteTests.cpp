@@ -27,6 +27,7 @@
 #include "fboss/agent/gen-cpp/switch_config_types.h"
 
 #include <gtest/gtest.h>
+#include <random>
 
 using namespace facebook::fboss;
 using folly::IPAddress;
@@ -320,6 +321,134 @@ TEST(Route, resolve) {
   }
 }
 
+// Changes to a prefix re-resolve the routes depending on it, transitively
+TEST(Route, resolveDependentRoutes) {
+  MockPlatform platform;
+  auto stateV0 = make_shared<SwitchState>();
+
+  cfg::SwitchConfig config;
+  config.vlans.resize(2);
+  config.vlans[0].id = 1;
+  config.vlans[1].id = 2;
+
+  config.interfaces.resize(2);
+  config.interfaces[0].intfID = 1;
+  config.interfaces[0].vlanID = 1;
+  config.interfaces[0].routerID = 0;
+  config.interfaces[0].__isset.mac = true;
+  config.interfaces[0].mac = "00:00:00:00:00:11";
+  config.interfaces[0].ipAddresses.resize(2);
+  config.interfaces[0].ipAddresses[0] = "1.1.1.1/24";
+  config.interfaces[0].ipAddresses[1] = "1::1/48";
+  config.interfaces[1].intfID = 2;
+  config.interfaces[1].vlanID = 2;
+  config.interfaces[1].routerID = 0;
+  config.interfaces[1].__isset.mac = true;
+  config.interfaces[1].mac = "00:00:00:00:00:22";
+  config.interfaces[1].ipAddresses.resize(2);
+  config.interfaces[1].ipAddresses[0] = "2.2.2.2/24";
+  config.interfaces[1].ipAddresses[1] = "2::1/48";
+
+  auto stateV1 = publishAndApplyConfig(stateV0, &config, &platform);
+  ASSERT_NE(nullptr, stateV1);
+  stateV1->publish();
+
+  auto rid = RouterID(0);
+  auto getRouteV4 = [&](const shared_ptr<RouteTableMap>& tables,
+                        const std::string& network, uint8_t mask) {
+    RouteV4::Prefix prefix{IPAddressV4(network), mask};
+    return tables->getRouteTableIf(rid)->getRibV4()->exactMatch(prefix);
+  };
+  auto getRouteV6 = [&](const shared_ptr<RouteTableMap>& tables,
+                        const std::string& network, uint8_t mask) {
+    RouteV6::Prefix prefix{IPAddressV6(network), mask};
+    return tables->getRouteTableIf(rid)->getRibV6()->exactMatch(prefix);
+  };
+
+  // 10/8 -> 1.1.1.10 (intf 1)
+  // 20/8 -> 10.1.1.1 (10/8)
+  // 3000::/64 -> 20.1.1.1 (20/8)
+  // 40/8 -> 2.2.2.10 (intf 2)
+  RouteUpdater u1(stateV1->getRouteTables());
+  RouteNextHops nexthops1;
+  nexthops1.emplace(IPAddress("1.1.1.10"));
+  u1.addRoute(rid, IPAddress("10.0.0.0"), 8, nexthops1);
+  RouteNextHops nexthops2;
+  nexthops2.emplace(IPAddress("10.1.1.1"));
+  u1.addRoute(rid, IPAddress("20.0.0.0"), 8, nexthops2);
+  RouteNextHops nexthops3;
+  nexthops3.emplace(IPAddress("20.1.1.1"));
+  u1.addRoute(rid, IPAddress("3000::"), 64, nexthops3);
+  RouteNextHops nexthops4;
+  nexthops4.emplace(IPAddress("2.2.2.10"));
+  u1.addRoute(rid, IPAddress("40.0.0.0"), 8, nexthops4);
+  auto tables2 = u1.updateDone();
+  ASSERT_NE(nullptr, tables2);
+  tables2->publish();
+  RouteForwardNexthops expFwd2;
+  expFwd2.emplace(InterfaceID(1), IPAddress("1.1.1.10"));
+  EXPECT_EQ(expFwd2,
+      getRouteV4(tables2, "20.0.0.0", 8)->getForwardInfo().getNexthops());
+  EXPECT_EQ(expFwd2,
+      getRouteV6(tables2, "3000::", 64)->getForwardInfo().getNexthops());
+
+  // Move 10/8 to intf 2, 20/8 and 3000::/64 follow. 40/8 is not touched.
+  RouteUpdater u2(tables2);
+  RouteNextHops nexthops5;
+  nexthops5.emplace(IPAddress("2.2.2.11"));
+  u2.addRoute(rid, IPAddress("10.0.0.0"), 8, nexthops5);
+  auto tables3 = u2.updateDone();
+  ASSERT_NE(nullptr, tables3);
+  tables3->publish();
+  RouteForwardNexthops expFwd3;
+  expFwd3.emplace(InterfaceID(2), IPAddress("2.2.2.11"));
+  EXPECT_EQ(expFwd3,
+      getRouteV4(tables3, "20.0.0.0", 8)->getForwardInfo().getNexthops());
+  EXPECT_EQ(expFwd3,
+      getRouteV6(tables3, "3000::", 64)->getForwardInfo().getNexthops());
+  EXPECT_EQ(getRouteV4(tables2, "40.0.0.0", 8),
+      getRouteV4(tables3, "40.0.0.0", 8));
+
+  // A more specific route for the nexthop of 20/8 takes over
+  RouteUpdater u3(tables3);
+  RouteNextHops nexthops6;
+  nexthops6.emplace(IPAddress("1.1.1.20"));
+  u3.addRoute(rid, IPAddress("10.1.1.0"), 24, nexthops6);
+  auto tables4 = u3.updateDone();
+  ASSERT_NE(nullptr, tables4);
+  tables4->publish();
+  RouteForwardNexthops expFwd4;
+  expFwd4.emplace(InterfaceID(1), IPAddress("1.1.1.20"));
+  EXPECT_EQ(expFwd4,
+      getRouteV4(tables4, "20.0.0.0", 8)->getForwardInfo().getNexthops());
+  EXPECT_EQ(expFwd4,
+      getRouteV6(tables4, "3000::", 64)->getForwardInfo().getNexthops());
+  EXPECT_EQ(getRouteV4(tables3, "10.0.0.0", 8),
+      getRouteV4(tables4, "10.0.0.0", 8));
+
+  // Removing it falls back to 10/8
+  RouteUpdater u4(tables4);
+  u4.delRoute(rid, IPAddress("10.1.1.0"), 24);
+  auto tables5 = u4.updateDone();
+  ASSERT_NE(nullptr, tables5);
+  tables5->publish();
+  EXPECT_EQ(expFwd3,
+      getRouteV4(tables5, "20.0.0.0", 8)->getForwardInfo().getNexthops());
+  EXPECT_EQ(expFwd3,
+      getRouteV6(tables5, "3000::", 64)->getForwardInfo().getNexthops());
+
+  // Without 10/8, 20/8 and 3000::/64 can't be resolved
+  RouteUpdater u5(tables5);
+  u5.delRoute(rid, IPAddress("10.0.0.0"), 8);
+  auto tables6 = u5.updateDone();
+  ASSERT_NE(nullptr, tables6);
+  tables6->publish();
+  EXPECT_TRUE(getRouteV4(tables6, "20.0.0.0", 8)->isUnresolvable());
+  EXPECT_TRUE(getRouteV6(tables6, "3000::", 64)->isUnresolvable());
+  EXPECT_EQ(getRouteV4(tables2, "40.0.0.0", 8),
+      getRouteV4(tables6, "40.0.0.0", 8));
+}
+
 // Testing add and delete ECMP routes
 TEST(Route, addDel) {
   MockPlatform platform;
@@ -1143,3 +1272,179 @@ TEST(Route, toCPURoutes) {
   EXPECT_FALSE(r5->needResolve());
   EXPECT_TRUE(r5->isSame(TO_CPU));
 }
+
+TEST(Route, publishOnlyChanged) {
+  auto tables1 = make_shared<RouteTableMap>();
+  RouteUpdater u1(tables1);
+  u1.addRoute(RouterID(0), InterfaceID(1), IPAddress("1.1.1.1"), 24);
+  RouteNextHops nhops;
+  nhops.emplace(IPAddress("1.1.1.10"));
+  for (uint32_t i = 0; i < 1000; ++i) {
+    auto network = IPAddressV4::fromLongHBO((10 << 24) + (i << 8));
+    u1.addRoute(RouterID(0), IPAddress(network), 24, nhops);
+  }
+  auto tables2 = u1.updateDone();
+  ASSERT_NE(nullptr, tables2);
+  auto rib2 = tables2->getRouteTable(RouterID(0))->getRibV4();
+  // The first publish visits the whole tree
+  EXPECT_LE(1001, rib2->publishRoutes());
+  tables2->publish();
+
+  RouteUpdater u2(tables2);
+  u2.addRoute(RouterID(0), IPAddress("20.0.0.0"), 24, nhops);
+  auto tables3 = u2.updateDone();
+  ASSERT_NE(nullptr, tables3);
+  auto rib3 = tables3->getRouteTable(RouterID(0))->getRibV4();
+  RouteV4::Prefix added{IPAddressV4("20.0.0.0"), 24};
+  auto route = rib3->exactMatch(added);
+  ASSERT_NE(nullptr, route);
+  EXPECT_FALSE(route->isPublished());
+
+  // Only the path to the new route is visited
+  EXPECT_GE(2 * 32, rib3->publishRoutes());
+  EXPECT_TRUE(route->isPublished());
+  for (const auto& iter : rib3->routes()) {
+    EXPECT_TRUE(iter->value()->isPublished());
+  }
+
+  // The published tree is copied, not modified, by the next change
+  tables3->publish();
+  RouteUpdater u3(tables3);
+  u3.delRoute(RouterID(0), IPAddress("20.0.0.0"), 24);
+  auto tables4 = u3.updateDone();
+  ASSERT_NE(nullptr, tables4);
+  EXPECT_EQ(route, rib3->exactMatch(added));
+}
+
+TEST(Route, sharedNexthops) {
+  typedef InternedSet<RouteNextHops, std::hash<IPAddress>> NextHopSet;
+  auto numSets = NextHopSet::numInterned();
+  RouteNextHops nhops1;
+  nhops1.emplace(IPAddress("1.1.1.10"));
+  nhops1.emplace(IPAddress("2.2.2.10"));
+  RouteNextHops nhops2;
+  nhops2.emplace(IPAddress("1.1.1.10"));
+  shared_ptr<RouteTableMap> tables2;
+  {
+    auto tables1 = make_shared<RouteTableMap>();
+    RouteUpdater u1(tables1);
+    u1.addRoute(RouterID(0), InterfaceID(1), IPAddress("1.1.1.1"), 24);
+    u1.addRoute(RouterID(0), InterfaceID(2), IPAddress("2.2.2.2"), 24);
+    for (uint32_t i = 0; i < 100; ++i) {
+      auto network = IPAddressV4::fromLongHBO((10 << 24) + (i << 8));
+      u1.addRoute(RouterID(0), IPAddress(network), 24,
+                  i % 2 ? nhops1 : nhops2);
+    }
+    tables2 = u1.updateDone();
+  }
+  ASSERT_NE(nullptr, tables2);
+  EXPECT_EQ(numSets + 2, NextHopSet::numInterned());
+
+  // Routes with equal nexthops share the same sets
+  auto rib = tables2->getRouteTable(RouterID(0))->getRibV4();
+  auto r1 = rib->exactMatch(RouteV4::Prefix{IPAddressV4("10.0.1.0"), 24});
+  auto r3 = rib->exactMatch(RouteV4::Prefix{IPAddressV4("10.0.3.0"), 24});
+  auto r2 = rib->exactMatch(RouteV4::Prefix{IPAddressV4("10.0.2.0"), 24});
+  ASSERT_NE(nullptr, r1);
+  ASSERT_NE(nullptr, r2);
+  ASSERT_NE(nullptr, r3);
+  EXPECT_EQ(nhops1, r1->nexthops());
+  EXPECT_EQ(&r1->nexthops(), &r3->nexthops());
+  EXPECT_EQ(&r1->getForwardInfo().getNexthops(),
+            &r3->getForwardInfo().getNexthops());
+  EXPECT_NE(&r1->nexthops(), &r2->nexthops());
+  EXPECT_EQ(2, r1->getForwardInfo().getNexthops().size());
+  EXPECT_EQ(1, r2->getForwardInfo().getNexthops().size());
+  EXPECT_TRUE(r1->isSame(nhops1));
+  EXPECT_FALSE(r1->isSame(nhops2));
+
+  // A serialized route reads back with the same sets
+  auto fromJson = RouteV4::fromFollyDynamic(r1->toFollyDynamic());
+  EXPECT_EQ(&r1->nexthops(), &fromJson->nexthops());
+  EXPECT_TRUE(fromJson->isSame(r1.get()));
+
+  // The sets go away with the last route using them
+  r1.reset();
+  r2.reset();
+  r3.reset();
+  rib.reset();
+  fromJson.reset();
+  tables2.reset();
+  EXPECT_EQ(numSets, NextHopSet::numInterned());
+}
+
+namespace {
+
+IPAddressV4 randomAddr(std::mt19937* gen, const IPAddressV4*) {
+  return IPAddressV4::fromLongHBO((*gen)());
+}
+
+IPAddressV6 randomAddr(std::mt19937* gen, const IPAddressV6*) {
+  folly::ByteArray16 bytes;
+  for (auto& byte : bytes) {
+    byte = (*gen)();
+  }
+  // Keep most addresses in 2401:db00::/32, so prefixes nest
+  if ((*gen)() % 4) {
+    bytes[0] = 0x24;
+    bytes[1] = 0x01;
+    bytes[2] = 0xdb;
+    bytes[3] = 0x00;
+  }
+  return IPAddressV6(bytes);
+}
+
+template<typename AddrT>
+void checkLookupTable(uint32_t numRoutes) {
+  std::mt19937 gen(numRoutes);
+  const AddrT* tag = nullptr;
+  auto rib = make_shared<RouteTableRib<AddrT>>();
+  std::vector<AddrT> addrs;
+  for (uint32_t i = 0; i < numRoutes; ++i) {
+    auto addr = randomAddr(&gen, tag);
+    uint8_t mask = gen() % (addr.bitCount() + 1);
+    RoutePrefix<AddrT> prefix{addr.mask(mask), mask};
+    if (!rib->exactMatch(prefix)) {
+      rib->addRoute(make_shared<Route<AddrT>>(prefix, DROP));
+    }
+    addrs.push_back(addr);
+    addrs.push_back(randomAddr(&gen, tag));
+  }
+  rib->publish();
+
+  RouteLookupTable<AddrT> table(rib->routes());
+  for (const auto& addr : addrs) {
+    EXPECT_EQ(rib->longestMatch(addr), table.longestMatch(addr))
+      << "lookup of " << addr;
+  }
+}
+
+} // unnamed namespace
+
+TEST(RouteLookupTable, matchesRib) {
+  checkLookupTable<IPAddressV4>(0);
+  checkLookupTable<IPAddressV4>(1);
+  checkLookupTable<IPAddressV4>(5000);
+  checkLookupTable<IPAddressV6>(0);
+  checkLookupTable<IPAddressV6>(1);
+  checkLookupTable<IPAddressV6>(5000);
+}
+
+TEST(RouteLookupTable, fastLongestMatch) {
+  auto rib = make_shared<RouteTableRib<IPAddressV4>>();
+  RouteV4::Prefix prefix{IPAddressV4("10.0.0.0"), 8};
+  rib->addRoute(make_shared<RouteV4>(prefix, DROP));
+  rib->publish();
+  auto route = rib->exactMatch(prefix);
+  // Lookups don't build the table themselves
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(route, rib->fastLongestMatch(IPAddressV4("10.1.2.3")));
+    EXPECT_EQ(nullptr, rib->fastLongestMatch(IPAddressV4("11.1.2.3")));
+  }
+  EXPECT_FALSE(rib->hasLookupTable());
+  // and agree with the table once it is built
+  rib->buildLookupTable();
+  EXPECT_TRUE(rib->hasLookupTable());
+  EXPECT_EQ(route, rib->fastLongestMatch(IPAddressV4("10.1.2.3")));
+  EXPECT_EQ(nullptr, rib->fastLongestMatch(IPAddressV4("11.1.2.3")));
+}
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <gflags/gflags.h>
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/RouteUpdater.h"
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using std::make_shared;
+using std::shared_ptr;
+
+DEFINE_int32(num_routes, 500000,
+             "The number of routes in the RIB being updated");
+
+namespace {
+
+const RouterID kRid(0);
+
+// Global state used by the benchmarks
+shared_ptr<RouteTableMap> tables;
+RouteNextHops bgpNexthops;
+
+// Connected subnets plus FLAGS_num_routes /24s resolved via 2 ECMP nexthops,
+// like a full table learnt over BGP.
+void init() {
+  auto emptyTables = make_shared<RouteTableMap>();
+  RouteUpdater updater(emptyTables);
+  updater.addRoute(kRid, InterfaceID(1), IPAddress("1.1.1.1"), 24);
+  updater.addRoute(kRid, InterfaceID(2), IPAddress("2.2.2.2"), 24);
+  bgpNexthops.emplace(IPAddress("1.1.1.10"));
+  bgpNexthops.emplace(IPAddress("2.2.2.10"));
+  for (uint32_t i = 0; i < FLAGS_num_routes; ++i) {
+    auto network = IPAddressV4::fromLongHBO((10 << 24) + (i << 8));
+    updater.addRoute(kRid, IPAddress(network), 24, bgpNexthops);
+  }
+  tables = updater.updateDone();
+  CHECK(tables);
+  tables->publish();
+}
+
+} // unnamed namespace
+
+// Add a single BGP prefix to the RIB
+BENCHMARK(RouteUpdaterAddOnePrefix, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    RouteUpdater updater(tables);
+    updater.addRoute(kRid, IPAddress("9.0.0.0"), 24, bgpNexthops);
+    auto newTables = updater.updateDone();
+    CHECK(newTables);
+  }
+}
+
+// Change the nexthops of a single BGP prefix
+BENCHMARK(RouteUpdaterChangeOnePrefix, numIters) {
+  RouteNextHops nexthops;
+  nexthops.emplace(IPAddress("1.1.1.10"));
+  for (size_t n = 0; n < numIters; ++n) {
+    RouteUpdater updater(tables);
+    updater.addRoute(kRid, IPAddress("10.0.0.0"), 24, nexthops);
+    auto newTables = updater.updateDone();
+    CHECK(newTables);
+  }
+}
+
+// Delete a single BGP prefix
+BENCHMARK(RouteUpdaterDelOnePrefix, numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    RouteUpdater updater(tables);
+    updater.delRoute(kRid, IPAddress("10.0.0.0"), 24);
+    auto newTables = updater.updateDone();
+    CHECK(newTables);
+  }
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  // Building the RIB is far more expensive than the updates being measured,
+  // so do it once up front.
+  init();
+
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <gflags/gflags.h>
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <cstdio>
+#include <map>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using std::make_shared;
+using std::shared_ptr;
+
+/*
+ * Cost of publishing a SwitchState after a single route change, against
+ * walking every route as publish() used to.  The number of RIB tree nodes
+ * visited is printed after the timings.
+ */
+
+namespace {
+
+const RouterID kRid(0);
+
+RouteNextHops bgpNexthops() {
+  RouteNextHops nexthops;
+  nexthops.emplace(IPAddress("1.1.1.10"));
+  nexthops.emplace(IPAddress("2.2.2.10"));
+  return nexthops;
+}
+
+// Published switch states with the given number of routes, built on first use
+std::map<uint32_t, shared_ptr<SwitchState>> states;
+
+shared_ptr<SwitchState> getState(uint32_t numRoutes) {
+  auto& state = states[numRoutes];
+  if (state) {
+    return state;
+  }
+  RouteUpdater updater(make_shared<RouteTableMap>());
+  updater.addRoute(kRid, InterfaceID(1), IPAddress("1.1.1.1"), 24);
+  updater.addRoute(kRid, InterfaceID(2), IPAddress("2.2.2.2"), 24);
+  auto nexthops = bgpNexthops();
+  for (uint32_t i = 0; i < numRoutes; ++i) {
+    auto network = IPAddressV4::fromLongHBO((10 << 24) + (i << 8));
+    updater.addRoute(kRid, IPAddress(network), 24, nexthops);
+  }
+  auto tables = updater.updateDone();
+  CHECK(tables);
+  state = make_shared<SwitchState>();
+  state->resetRouteTables(tables);
+  state->publish();
+  return state;
+}
+
+// An unpublished state with one more route than getState(numRoutes)
+shared_ptr<SwitchState> addOneRoute(uint32_t numRoutes) {
+  auto state = getState(numRoutes);
+  RouteUpdater updater(state->getRouteTables());
+  updater.addRoute(kRid, IPAddress("9.0.0.0"), 24, bgpNexthops());
+  auto tables = updater.updateDone();
+  CHECK(tables);
+  auto newState = state->clone();
+  newState->resetRouteTables(tables);
+  return newState;
+}
+
+shared_ptr<RouteTableRib<IPAddressV4>> ribV4(
+    const shared_ptr<SwitchState>& state) {
+  return state->getRouteTables()->getRouteTable(kRid)->getRibV4();
+}
+
+// What publish() used to do: visit every route in the table
+void publishAllRoutes(uint32_t numIters, uint32_t numRoutes) {
+  for (uint32_t n = 0; n < numIters; ++n) {
+    shared_ptr<SwitchState> state;
+    BENCHMARK_SUSPEND {
+      state = addOneRoute(numRoutes);
+    }
+    for (const auto& route : ribV4(state)->routes()) {
+      route->value()->publish();
+    }
+    state->publish();
+    BENCHMARK_SUSPEND {
+      state.reset();
+    }
+  }
+}
+
+void publish(uint32_t numIters, uint32_t numRoutes) {
+  for (uint32_t n = 0; n < numIters; ++n) {
+    shared_ptr<SwitchState> state;
+    BENCHMARK_SUSPEND {
+      state = addOneRoute(numRoutes);
+    }
+    state->publish();
+    BENCHMARK_SUSPEND {
+      state.reset();
+    }
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK_PARAM(publishAllRoutes, 10000)
+BENCHMARK_RELATIVE_PARAM(publish, 10000)
+BENCHMARK_DRAW_LINE()
+BENCHMARK_PARAM(publishAllRoutes, 100000)
+BENCHMARK_RELATIVE_PARAM(publish, 100000)
+BENCHMARK_DRAW_LINE()
+BENCHMARK_PARAM(publishAllRoutes, 1000000)
+BENCHMARK_RELATIVE_PARAM(publish, 1000000)
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+
+  printf("%10s %16s %16s\n", "routes", "rib nodes", "nodes visited");
+  for (uint32_t numRoutes : {10000, 100000, 1000000}) {
+    auto state = addOneRoute(numRoutes);
+    auto rib = ribV4(state);
+    size_t ribNodes = 0;
+    RouteTableRib<IPAddressV4>::Routes::ConstIterator iter(
+        rib->routes().root(), true);
+    for (; !iter.atEnd(); ++iter) {
+      ++ribNodes;
+    }
+    auto visited = rib->publishRoutes();
+    printf("%10u %16zu %16zu\n", numRoutes, ribNodes, visited);
+  }
+  return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/json.h>
+#include <gflags/gflags.h>
+#include "fboss/agent/Constants.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateSnapshot.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <cstdio>
+#include <map>
+#include <unistd.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::dynamic;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+
+DEFINE_string(snapshot_dir, "/tmp",
+              "Where to write the state files being benchmarked");
+
+/*
+ * Warm boot state dump and load times, as JSON and as a binary snapshot.
+ * The JSON dump converts the SwitchState to folly::dynamic first, while
+ * the snapshot is streamed from the state as SwSwitch does.  Both loads
+ * go through folly::dynamic.  The file sizes are printed after the
+ * timings.
+ */
+
+namespace {
+
+const RouterID kRid(0);
+
+// Switch states with the given number of routes, built on first use
+std::map<uint32_t, shared_ptr<SwitchState>> states;
+
+shared_ptr<SwitchState> getState(uint32_t numRoutes) {
+  auto& state = states[numRoutes];
+  if (state) {
+    return state;
+  }
+  RouteUpdater updater(make_shared<RouteTableMap>());
+  updater.addRoute(kRid, InterfaceID(1), IPAddress("1.1.1.1"), 24);
+  updater.addRoute(kRid, InterfaceID(2), IPAddress("2.2.2.2"), 24);
+  RouteNextHops nexthops;
+  nexthops.emplace(IPAddress("1.1.1.10"));
+  nexthops.emplace(IPAddress("2.2.2.10"));
+  for (uint32_t i = 0; i < numRoutes; ++i) {
+    auto network = IPAddressV4::fromLongHBO((10 << 24) + (i << 8));
+    updater.addRoute(kRid, IPAddress(network), 24, nexthops);
+  }
+  auto tables = updater.updateDone();
+  CHECK(tables);
+  state = make_shared<SwitchState>();
+  state->resetRouteTables(tables);
+  state->publish();
+  return state;
+}
+
+dynamic dumpedState(uint32_t numRoutes) {
+  dynamic dumped = dynamic::object;
+  dumped[kSwSwitch] = getState(numRoutes)->toFollyDynamic();
+  return dumped;
+}
+
+string jsonPath(uint32_t numRoutes) {
+  return folly::to<string>(FLAGS_snapshot_dir, "/fboss_state_", numRoutes,
+                           ".json");
+}
+
+string snapshotPath(uint32_t numRoutes) {
+  return folly::to<string>(FLAGS_snapshot_dir, "/fboss_state_", numRoutes,
+                           ".snapshot");
+}
+
+uint64_t writeSnapshot(uint32_t numRoutes) {
+  StateSnapshotWriter writer(snapshotPath(numRoutes));
+  writer.beginObject(1);
+  writer.key(kSwSwitch);
+  getState(numRoutes)->writeSnapshot(&writer);
+  writer.end();
+  return writer.finish();
+}
+
+void writeJson(uint32_t numRoutes) {
+  auto path = jsonPath(numRoutes);
+  CHECK(folly::writeFile(folly::toPrettyJson(dumpedState(numRoutes)),
+                         path.c_str()));
+}
+
+void dumpJson(uint32_t numIters, uint32_t numRoutes) {
+  BENCHMARK_SUSPEND {
+    getState(numRoutes);
+  }
+  for (uint32_t n = 0; n < numIters; ++n) {
+    writeJson(numRoutes);
+  }
+}
+
+void loadJson(uint32_t numIters, uint32_t numRoutes) {
+  BENCHMARK_SUSPEND {
+    writeJson(numRoutes);
+  }
+  for (uint32_t n = 0; n < numIters; ++n) {
+    string contents;
+    CHECK(folly::readFile(jsonPath(numRoutes).c_str(), contents));
+    auto json = folly::parseJson(contents);
+    auto state = SwitchState::fromFollyDynamic(json[kSwSwitch]);
+    folly::doNotOptimizeAway(state);
+  }
+}
+
+void dumpSnapshot(uint32_t numIters, uint32_t numRoutes) {
+  BENCHMARK_SUSPEND {
+    getState(numRoutes);
+  }
+  for (uint32_t n = 0; n < numIters; ++n) {
+    writeSnapshot(numRoutes);
+  }
+}
+
+void loadSnapshot(uint32_t numIters, uint32_t numRoutes) {
+  BENCHMARK_SUSPEND {
+    writeSnapshot(numRoutes);
+  }
+  for (uint32_t n = 0; n < numIters; ++n) {
+    StateSnapshotReader reader(snapshotPath(numRoutes));
+    auto state = SwitchState::fromFollyDynamic(reader.get(kSwSwitch));
+    folly::doNotOptimizeAway(state);
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK_PARAM(dumpJson, 10000)
+BENCHMARK_RELATIVE_PARAM(dumpSnapshot, 10000)
+BENCHMARK_PARAM(loadJson, 10000)
+BENCHMARK_RELATIVE_PARAM(loadSnapshot, 10000)
+BENCHMARK_DRAW_LINE()
+BENCHMARK_PARAM(dumpJson, 100000)
+BENCHMARK_RELATIVE_PARAM(dumpSnapshot, 100000)
+BENCHMARK_PARAM(loadJson, 100000)
+BENCHMARK_RELATIVE_PARAM(loadSnapshot, 100000)
+BENCHMARK_DRAW_LINE()
+BENCHMARK_PARAM(dumpJson, 1000000)
+BENCHMARK_RELATIVE_PARAM(dumpSnapshot, 1000000)
+BENCHMARK_PARAM(loadJson, 1000000)
+BENCHMARK_RELATIVE_PARAM(loadSnapshot, 1000000)
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+
+  printf("%10s %16s %16s\n", "routes", "json bytes", "snapshot bytes");
+  for (uint32_t numRoutes : {10000, 100000, 1000000}) {
+    writeJson(numRoutes);
+    auto snapshotBytes = writeSnapshot(numRoutes);
+    string json;
+    CHECK(folly::readFile(jsonPath(numRoutes).c_str(), json));
+    printf("%10u %16zu %16lu\n", numRoutes, json.size(),
+           static_cast<unsigned long>(snapshotBytes));
+    unlink(jsonPath(numRoutes).c_str());
+    unlink(snapshotPath(numRoutes).c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/Constants.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/test/TestUtils.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/NdpTable.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateSnapshot.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+#include <folly/Exception.h>
+#include <folly/FileUtil.h>
+#include <folly/json.h>
+#include <gtest/gtest.h>
+
+#include <limits>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+using folly::MacAddress;
+using folly::dynamic;
+using std::string;
+
+namespace {
+
+class TempFile {
+ public:
+  TempFile() {
+    int fd = mkstemp(path_);
+    folly::checkUnixError(fd, "failed to create temporary file");
+    close(fd);
+  }
+  ~TempFile() {
+    unlink(path_);
+  }
+  const char* path() const {
+    return path_;
+  }
+
+ private:
+  char path_[32] = "fbossSnapshotTest.XXXXXX";
+};
+
+std::shared_ptr<SwitchState> stateWithRoutes() {
+  auto state = testStateA();
+  RouteUpdater updater(state->getRouteTables());
+  RouteNextHops nexthops;
+  nexthops.emplace(IPAddress("10.0.0.22"));
+  nexthops.emplace(IPAddress("10.0.55.22"));
+  for (uint32_t i = 0; i < 100; ++i) {
+    auto network = folly::IPAddressV4::fromLongHBO((20 << 24) + (i << 8));
+    updater.addRoute(RouterID(0), IPAddress(network), 24, nexthops);
+  }
+  updater.addRoute(RouterID(0), IPAddress("2401:db00::"), 64, nexthops);
+  auto tables = updater.updateDone();
+  CHECK(tables);
+  state->resetRouteTables(tables);
+
+  auto vlan = state->getVlans()->getVlan(VlanID(1));
+  for (uint32_t i = 0; i < 10; ++i) {
+    vlan->getArpTable()->addEntry(
+        IPAddressV4::fromLongHBO((10 << 24) + 100 + i),
+        MacAddress::fromHBO(0x0200000000 + i), PortID(1 + i), InterfaceID(1));
+  }
+  vlan->getNdpTable()->addEntry(IPAddressV6("2401:db00:2110:3001::22"),
+                                MacAddress("02:00:00:00:00:22"), PortID(2),
+                                InterfaceID(1));
+  return state;
+}
+
+} // unnamed namespace
+
+TEST(StateSnapshot, Values) {
+  dynamic value = dynamic::object
+    ("null", nullptr)
+    ("true", true)
+    ("false", false)
+    ("zero", 0)
+    ("small", -3)
+    ("min", std::numeric_limits<int64_t>::min())
+    ("max", std::numeric_limits<int64_t>::max())
+    ("double", 2.5)
+    ("empty", "")
+    ("string", "fboss")
+    ("emptyObject", dynamic::object)
+    ("nested", dynamic::object("string", dynamic::object("x", 1)));
+  value[5] = "non-string key";
+  std::vector<dynamic> items{1, "two", dynamic::object("string", 3)};
+  value["array"] = dynamic(items.begin(), items.end());
+  value["emptyArray"] = dynamic(items.begin(), items.begin());
+
+  TempFile file;
+  writeStateSnapshot(file.path(), value);
+  EXPECT_TRUE(StateSnapshotReader::isSnapshot(file.path()));
+  StateSnapshotReader reader(file.path());
+  EXPECT_EQ(1, reader.version());
+  EXPECT_EQ(value, reader.get());
+  EXPECT_EQ(value["nested"], reader.get("nested"));
+  EXPECT_EQ(value["array"], reader.get("array"));
+  EXPECT_TRUE(reader.get("missing").isNull());
+}
+
+TEST(StateSnapshot, SwitchState) {
+  auto state = stateWithRoutes();
+  dynamic dumped = dynamic::object;
+  dumped[kSwSwitch] = state->toFollyDynamic();
+  dumped[kHwSwitch] = dynamic::object("hostTable", dynamic::object);
+
+  TempFile file;
+  auto size = writeStateSnapshot(file.path(), dumped);
+  auto json = folly::toPrettyJson(dumped);
+  EXPECT_LT(size, json.size());
+
+  StateSnapshotReader reader(file.path());
+  auto restored = SwitchState::fromFollyDynamic(reader.get(kSwSwitch));
+  EXPECT_EQ(dumped[kSwSwitch], restored->toFollyDynamic());
+  EXPECT_EQ(dumped[kHwSwitch], reader.get(kHwSwitch));
+}
+
+TEST(StateSnapshot, StreamedSwitchState) {
+  auto state = stateWithRoutes();
+  auto hwSwitch = dynamic::object("hostTable", dynamic::object);
+
+  // Written as SwSwitch does on graceful exit, without converting the
+  // state to a dynamic
+  TempFile file;
+  StateSnapshotWriter writer(file.path());
+  writer.beginObject(2);
+  writer.key(kSwSwitch);
+  state->writeSnapshot(&writer);
+  writer.key(kHwSwitch);
+  writer.value(hwSwitch);
+  writer.end();
+  writer.finish();
+
+  StateSnapshotReader reader(file.path());
+  auto swSwitch = reader.get(kSwSwitch);
+  EXPECT_EQ(state->toFollyDynamic(), swSwitch);
+  EXPECT_EQ(hwSwitch, reader.get(kHwSwitch));
+
+  auto restored = SwitchState::fromFollyDynamic(swSwitch);
+  auto vlan = restored->getVlans()->getVlan(VlanID(1));
+  EXPECT_EQ(10, vlan->getArpTable()->size());
+  EXPECT_EQ(1, vlan->getNdpTable()->size());
+  auto table = state->getRouteTables()->getRouteTable(RouterID(0));
+  auto restoredTable =
+    restored->getRouteTables()->getRouteTable(RouterID(0));
+  EXPECT_EQ(table->getRibV4()->size(), restoredTable->getRibV4()->size());
+  EXPECT_EQ(table->getRibV6()->size(), restoredTable->getRibV6()->size());
+}
+
+TEST(StateSnapshot, WriterMisuse) {
+  TempFile file;
+  {
+    StateSnapshotWriter writer(file.path());
+    writer.beginObject(1);
+    // A value without its key
+    EXPECT_THROW(writer.value(1), FbossError);
+  }
+  {
+    StateSnapshotWriter writer(file.path());
+    writer.beginArray(1);
+    // Fewer items than announced
+    EXPECT_THROW(writer.end(), FbossError);
+    writer.value(1);
+    // More items than announced
+    EXPECT_THROW(writer.value(2), FbossError);
+    writer.end();
+    EXPECT_NO_THROW(writer.finish());
+  }
+  {
+    StateSnapshotWriter writer(file.path());
+    writer.beginObject(0);
+    EXPECT_THROW(writer.finish(), FbossError);
+  }
+}
+
+TEST(StateSnapshot, UnfinishedKeepsOldFile) {
+  TempFile file;
+  auto tmpPath = string(file.path()) + ".tmp";
+  writeStateSnapshot(file.path(), dynamic::object("old", 1));
+  EXPECT_NE(0, access(tmpPath.c_str(), F_OK));
+  {
+    // As if we died while writing a new snapshot
+    StateSnapshotWriter writer(file.path());
+    writer.beginObject(1);
+    writer.key("new");
+    EXPECT_EQ(0, access(tmpPath.c_str(), F_OK));
+  }
+  EXPECT_NE(0, access(tmpPath.c_str(), F_OK));
+  StateSnapshotReader reader(file.path());
+  EXPECT_EQ(dynamic(1), reader.get("old"));
+}
+
+TEST(StateSnapshot, NotSnapshot) {
+  TempFile file;
+  ASSERT_TRUE(folly::writeFile(string("{\"swSwitch\": {}}"), file.path()));
+  EXPECT_FALSE(StateSnapshotReader::isSnapshot(file.path()));
+  EXPECT_THROW(StateSnapshotReader{file.path()}, FbossError);
+
+  ASSERT_TRUE(folly::writeFile(string(), file.path()));
+  EXPECT_FALSE(StateSnapshotReader::isSnapshot(file.path()));
+}
+
+TEST(StateSnapshot, Corrupt) {
+  TempFile file;
+  dynamic value = dynamic::object("a", "aaaaaaaa")("b", 1);
+  writeStateSnapshot(file.path(), value);
+  string data;
+  ASSERT_TRUE(folly::readFile(file.path(), data));
+
+  // Truncated, as if we crashed while writing it
+  ASSERT_TRUE(folly::writeFile(data.substr(0, data.size() - 3),
+                               file.path()));
+  EXPECT_THROW(StateSnapshotReader{file.path()}, FbossError);
+
+  // From a newer agent
+  string newer = data;
+  newer[4] = 2;
+  ASSERT_TRUE(folly::writeFile(newer, file.path()));
+  EXPECT_THROW(StateSnapshotReader{file.path()}, FbossError);
+
+  // A string that runs past the end of the body
+  string bad = data;
+  auto pos = bad.find("aaaaaaaa");
+  ASSERT_NE(string::npos, pos);
+  bad[pos - 1] = 100;
+  ASSERT_TRUE(folly::writeFile(bad, file.path()));
+  StateSnapshotReader reader(file.path());
+  EXPECT_THROW(reader.get(), FbossError);
+}
@@ -325,6 +325,45 @@ struct AclEntry {
   11: optional i16 dstPort
 }
 
+/**
+ * Classes of packets trapped to the CPU, for software policing.
+ * Packets are classified from their ethertype and, for IP, their protocol
+ * and UDP ports, ignoring IPv4 options and IPv6 extension headers.
+ */
+enum PacketPolicerClass {
+  ARP = 0,
+  // ICMPv6 router and neighbor solicitations/advertisements, redirects
+  NDP = 1,
+  LLDP = 2,
+  DHCPV4 = 3,
+  DHCPV6 = 4,
+  ICMPV4 = 5,
+  // ICMPv6 other than NDP
+  ICMPV6 = 6,
+  // IPv4 and IPv6 packets not in any of the classes above
+  IPV4 = 7,
+  IPV6 = 8,
+  // Everything else
+  OTHER = 9,
+}
+
+/**
+ * A software policer for trapped packets.
+ *
+ * Every port has its own token bucket for each policed class, so a storm on
+ * one port can't starve the others.  Packets over the limit are dropped
+ * before any processing, and counted in the trapped.policer_drops counters
+ * of the port and the switch.
+ */
+struct PacketPolicer {
+  1: PacketPolicerClass packetClass
+  // The sustained rate allowed per port
+  2: i32 packetsPerSecond
+  // The number of packets allowed back to back after an idle period.
+  // 0 means packetsPerSecond, i.e. one second worth of packets.
+  3: i32 burstSize = 0
+}
+
 /**
  * The configuration for a switch.
  *
@@ -362,4 +401,7 @@ struct SwitchConfig {
   15: optional list<AclEntry> acls = []
   16: i32 maxNeighborProbes = 3
   17: i32 staleEntryInterval = 10
+  // Software policers for packets trapped to the CPU. Classes without a
+  // policer are not limited.
+  18: list<PacketPolicer> packetPolicers = []
 }
@@ -8,6 +8,7 @@
  *
  */
 #include "common/stats/ServiceData.h"
+#include <folly/Baton.h>
 #include <folly/Memory.h>
 #include <folly/io/Cursor.h>
 #include <folly/io/IOBuf.h>
@@ -1022,6 +1023,48 @@ TEST(ArpTest, PendingArp) {
   EXPECT_EQ(entry->isPending(), false);
 };
 
+TEST(ArpTest, BatchedUpdates) {
+  auto sw = setupSwitch();
+  VlanID vlanID(1);
+
+  // Keep the update thread busy, so the neighbor changes queue up behind it
+  auto blockUpdates = [&](folly::Baton<>* release) {
+    sw->getUpdateEVB()->runInEventBaseThread([release] { release->wait(); });
+  };
+
+  // Replies for several new neighbors are programmed with one state update
+  folly::Baton<> release1;
+  blockUpdates(&release1);
+  EXPECT_HW_CALL(sw, stateChanged(_)).Times(1);
+  for (int i = 20; i < 40; ++i) {
+    sendArpReply(sw.get(), folly::to<string>("10.0.0.", i),
+                 "02:10:20:30:40:22", 1);
+  }
+  release1.post();
+  waitForStateUpdates(sw.get());
+  auto arpTable = sw->getState()->getVlans()->getVlan(vlanID)->getArpTable();
+  for (int i = 20; i < 40; ++i) {
+    auto entry = arpTable->getEntryIf(
+        IPAddressV4(folly::to<string>("10.0.0.", i)));
+    ASSERT_NE(nullptr, entry);
+    EXPECT_FALSE(entry->isPending());
+  }
+
+  // A pending entry still reaches the hardware before it is resolved, even
+  // if the reply arrives before the pending entry was programmed.
+  folly::Baton<> release2;
+  blockUpdates(&release2);
+  EXPECT_HW_CALL(sw, stateChanged(_)).Times(2);
+  sw->getNeighborUpdater()->sentArpRequest(vlanID, IPAddressV4("10.0.0.50"));
+  sendArpReply(sw.get(), "10.0.0.50", "02:10:20:30:40:50", 1);
+  release2.post();
+  waitForStateUpdates(sw.get());
+  auto entry = sw->getState()->getVlans()->getVlan(vlanID)->getArpTable()
+    ->getEntryIf(IPAddressV4("10.0.0.50"));
+  ASSERT_NE(nullptr, entry);
+  EXPECT_FALSE(entry->isPending());
+}
+
 TEST(ArpTest, PendingArpCleanup) {
   std::chrono::seconds arpTimeout(1);
   auto sw = setupSwitch(arpTimeout);
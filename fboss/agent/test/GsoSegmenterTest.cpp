@@ -0,0 +1,270 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/GsoSegmenter.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/hw/mock/MockTxPacket.h"
+#include "fboss/agent/packet/PktUtil.h"
+
+#include <folly/Memory.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::IOBuf;
+using folly::io::Cursor;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+const uint8_t kTcpFin = 0x01;
+const uint8_t kTcpPsh = 0x08;
+const uint8_t kTcpAck = 0x10;
+
+void putBE16(vector<uint8_t>* pkt, size_t offset, uint16_t value) {
+  (*pkt)[offset] = value >> 8;
+  (*pkt)[offset + 1] = value & 0xff;
+}
+
+void putBE32(vector<uint8_t>* pkt, size_t offset, uint32_t value) {
+  putBE16(pkt, offset, value >> 16);
+  putBE16(pkt, offset + 2, value & 0xffff);
+}
+
+uint16_t getBE16(const IOBuf* buf, size_t offset) {
+  Cursor cursor(buf);
+  cursor.skip(offset);
+  return cursor.readBE<uint16_t>();
+}
+
+uint32_t getBE32(const IOBuf* buf, size_t offset) {
+  Cursor cursor(buf);
+  cursor.skip(offset);
+  return cursor.readBE<uint32_t>();
+}
+
+/*
+ * A TCP packet with a 20 byte header (plus 12 bytes of options) and payload
+ * bytes counting up from 0, as the kernel would send it with TSO: the IP
+ * length covers the whole frame and the TCP checksum is not filled in.
+ */
+vector<uint8_t> makeTcpPacket(bool v4, uint32_t payloadLen) {
+  uint32_t l4Off = v4 ? 20 : 40;
+  uint32_t tcpHdrLen = 32;
+  vector<uint8_t> pkt(l4Off + tcpHdrLen + payloadLen, 0);
+  if (v4) {
+    pkt[0] = 0x45;
+    putBE16(&pkt, 2, pkt.size());
+    putBE16(&pkt, 4, 0x1234);
+    pkt[8] = 64;
+    pkt[9] = 6;
+    putBE32(&pkt, 12, 0x0a000001);
+    putBE32(&pkt, 16, 0x0a000002);
+  } else {
+    pkt[0] = 0x60;
+    putBE16(&pkt, 4, tcpHdrLen + payloadLen);
+    pkt[6] = 6;
+    pkt[7] = 64;
+    pkt[8] = 0x20;
+    pkt[9] = 0x01;
+    pkt[23] = 1;
+    pkt[24] = 0x20;
+    pkt[25] = 0x01;
+    pkt[39] = 2;
+  }
+  putBE16(&pkt, l4Off, 179);
+  putBE16(&pkt, l4Off + 2, 40000);
+  putBE32(&pkt, l4Off + 4, 0xfffff000);
+  putBE32(&pkt, l4Off + 8, 0x11111111);
+  pkt[l4Off + 12] = (tcpHdrLen / 4) << 4;
+  pkt[l4Off + 13] = kTcpAck | kTcpPsh | kTcpFin;
+  putBE16(&pkt, l4Off + 14, 0xffff);
+  for (uint32_t idx = 0; idx < payloadLen; ++idx) {
+    pkt[l4Off + tcpHdrLen + idx] = idx;
+  }
+  return pkt;
+}
+
+// Verify the L4 checksum of the packet in buf, including its pseudo header
+void checkL4Checksum(const IOBuf* buf, bool v4, uint8_t proto,
+                     uint32_t l4Off) {
+  uint32_t l4Len = buf->length() - l4Off;
+  vector<uint8_t> pseudo;
+  if (v4) {
+    pseudo.assign(buf->data() + 12, buf->data() + 20);
+  } else {
+    pseudo.assign(buf->data() + 8, buf->data() + 40);
+  }
+  pseudo.insert(pseudo.end(), {0, 0, 0, proto});
+  pseudo.push_back(l4Len >> 8);
+  pseudo.push_back(l4Len & 0xff);
+  IOBuf all(IOBuf::COPY_BUFFER, pseudo.data(), pseudo.size());
+  all.prependChain(IOBuf::copyBuffer(buf->data() + l4Off, l4Len));
+  EXPECT_EQ(0, PktUtil::internetChecksum(&all));
+}
+
+vector<unique_ptr<TxPacket>> segment(const VnetHdr& vnetHdr,
+                                     const vector<uint8_t>& pkt) {
+  vector<unique_ptr<TxPacket>> segments;
+  auto count = GsoSegmenter::segment(
+      vnetHdr, pkt.data(), pkt.size(),
+      [](uint32_t l3Len) {
+        unique_ptr<TxPacket> seg = folly::make_unique<MockTxPacket>(l3Len);
+        seg->buf()->clear();
+        return seg;
+      },
+      [&](unique_ptr<TxPacket> seg) {
+        segments.push_back(std::move(seg));
+      });
+  EXPECT_EQ(segments.size(), count);
+  return segments;
+}
+
+void checkSegments(bool v4) {
+  const uint32_t l4Off = v4 ? 20 : 40;
+  const uint32_t hdrLen = l4Off + 32;
+  const uint32_t mss = 1000;
+  const uint32_t payloadLen = 2500;
+  auto pkt = makeTcpPacket(v4, payloadLen);
+
+  VnetHdr vnetHdr;
+  memset(&vnetHdr, 0, sizeof(vnetHdr));
+  vnetHdr.flags = VnetHdr::F_NEEDS_CSUM;
+  vnetHdr.gsoType =
+    v4 ? VnetHdr::GSO_TCPV4 : VnetHdr::GSO_TCPV6;
+  vnetHdr.hdrLen = hdrLen;
+  vnetHdr.gsoSize = mss;
+  vnetHdr.csumStart = l4Off;
+  vnetHdr.csumOffset = 16;
+
+  auto segments = segment(vnetHdr, pkt);
+  ASSERT_EQ(3, segments.size());
+  uint32_t offset = 0;
+  for (size_t idx = 0; idx < segments.size(); ++idx) {
+    auto buf = segments[idx]->buf();
+    uint32_t segLen = std::min(mss, payloadLen - offset);
+    bool last = idx == segments.size() - 1;
+    ASSERT_EQ(hdrLen + segLen, buf->length());
+    if (v4) {
+      EXPECT_EQ(buf->length(), getBE16(buf, 2));
+      EXPECT_EQ(0x1234 + idx, getBE16(buf, 4));
+      EXPECT_EQ(0, PktUtil::internetChecksum(buf->data(), l4Off));
+    } else {
+      EXPECT_EQ(buf->length() - l4Off, getBE16(buf, 4));
+    }
+    // The sequence number wraps around in the middle segment
+    EXPECT_EQ(static_cast<uint32_t>(0xfffff000 + offset),
+              getBE32(buf, l4Off + 4));
+    uint8_t flags = buf->data()[l4Off + 13];
+    EXPECT_EQ(last ? (kTcpAck | kTcpPsh | kTcpFin) : kTcpAck, flags);
+    // Options and payload are carried over
+    EXPECT_EQ(0, memcmp(buf->data() + l4Off + 20, pkt.data() + l4Off + 20,
+                        12));
+    EXPECT_EQ(0, memcmp(buf->data() + hdrLen, pkt.data() + hdrLen + offset,
+                        segLen));
+    checkL4Checksum(buf, v4, 6, l4Off);
+    offset += segLen;
+  }
+}
+
+} // unnamed namespace
+
+TEST(GsoSegmenter, SegmentTcpV4) {
+  checkSegments(true);
+}
+
+TEST(GsoSegmenter, SegmentTcpV6) {
+  checkSegments(false);
+}
+
+TEST(GsoSegmenter, SmallerThanSegment) {
+  auto pkt = makeTcpPacket(true, 100);
+  VnetHdr vnetHdr;
+  memset(&vnetHdr, 0, sizeof(vnetHdr));
+  vnetHdr.gsoType = VnetHdr::GSO_TCPV4 | VnetHdr::GSO_ECN;
+  vnetHdr.gsoSize = 1448;
+  auto segments = segment(vnetHdr, pkt);
+  ASSERT_EQ(1, segments.size());
+  EXPECT_EQ(pkt.size(), segments[0]->buf()->length());
+  checkL4Checksum(segments[0]->buf(), true, 6, 20);
+}
+
+TEST(GsoSegmenter, Malformed) {
+  VnetHdr vnetHdr;
+  memset(&vnetHdr, 0, sizeof(vnetHdr));
+  vnetHdr.gsoType = VnetHdr::GSO_TCPV4;
+  vnetHdr.gsoSize = 1000;
+
+  // Truncated TCP header
+  auto pkt = makeTcpPacket(true, 0);
+  pkt.resize(30);
+  EXPECT_THROW(segment(vnetHdr, pkt), FbossError);
+  // Not TCP
+  pkt = makeTcpPacket(true, 2000);
+  pkt[9] = 17;
+  EXPECT_THROW(segment(vnetHdr, pkt), FbossError);
+  // IPv6 packet with a v4 GSO type
+  pkt = makeTcpPacket(false, 2000);
+  EXPECT_THROW(segment(vnetHdr, pkt), FbossError);
+  // No segment size
+  vnetHdr.gsoType = VnetHdr::GSO_TCPV6;
+  vnetHdr.gsoSize = 0;
+  EXPECT_THROW(segment(vnetHdr, pkt), FbossError);
+  // UFO is never enabled
+  vnetHdr.gsoType = VnetHdr::GSO_UDP;
+  vnetHdr.gsoSize = 1000;
+  EXPECT_THROW(segment(vnetHdr, pkt), FbossError);
+}
+
+TEST(GsoSegmenter, CompleteChecksum) {
+  // A UDP packet with the pseudo header sum in the checksum field, the way
+  // the kernel leaves it with checksum offload
+  const uint32_t l4Off = 40;
+  vector<uint8_t> pkt(l4Off + 8 + 101, 0);
+  pkt[0] = 0x60;
+  putBE16(&pkt, 4, pkt.size() - l4Off);
+  pkt[6] = 17;
+  for (uint32_t idx = 8; idx < l4Off; ++idx) {
+    pkt[idx] = idx * 7;
+  }
+  putBE16(&pkt, l4Off, 546);
+  putBE16(&pkt, l4Off + 2, 547);
+  putBE16(&pkt, l4Off + 4, pkt.size() - l4Off);
+  for (uint32_t idx = l4Off + 8; idx < pkt.size(); ++idx) {
+    pkt[idx] = idx;
+  }
+  uint32_t sum = 17 + pkt.size() - l4Off;
+  for (uint32_t idx = 8; idx < l4Off; idx += 2) {
+    sum += (pkt[idx] << 8) | pkt[idx + 1];
+  }
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  putBE16(&pkt, l4Off + 6, sum);
+
+  VnetHdr vnetHdr;
+  memset(&vnetHdr, 0, sizeof(vnetHdr));
+  vnetHdr.flags = VnetHdr::F_NEEDS_CSUM;
+  vnetHdr.csumStart = l4Off;
+  vnetHdr.csumOffset = 6;
+  EXPECT_FALSE(GsoSegmenter::isPlain(vnetHdr));
+  EXPECT_FALSE(GsoSegmenter::isGso(vnetHdr));
+  GsoSegmenter::completeChecksum(vnetHdr, pkt.data(), pkt.size());
+  auto buf = IOBuf::wrapBuffer(pkt.data(), pkt.size());
+  checkL4Checksum(buf.get(), false, 17, l4Off);
+
+  vnetHdr.csumOffset = pkt.size();
+  EXPECT_THROW(GsoSegmenter::completeChecksum(vnetHdr, pkt.data(),
+                                              pkt.size()),
+               FbossError);
+}
@@ -0,0 +1,192 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/IPAddressV4.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+#include <gflags/gflags.h>
+#include "fboss/agent/NeighborEntryStore.h"
+#include "fboss/agent/TimerWheel.h"
+
+#include <memory>
+#include <unordered_map>
+
+using namespace facebook::fboss;
+using folly::EventBase;
+using folly::IPAddressV4;
+using std::chrono::milliseconds;
+using std::make_shared;
+using std::shared_ptr;
+
+/*
+ * Neighbor cache entries cycling through their probe states: each entry is
+ * created INCOMPLETE, times out and probes until it has no probes left, and
+ * is then flushed.
+ *
+ * This compares a timeout per entry and an unordered_map of shared_ptrs,
+ * which is how the neighbor caches used to work, with the shared TimerWheel
+ * and NeighborEntryStore.  The timeouts are 1ms rather than 1s, so the
+ * benchmark measures the bookkeeping rather than the waiting.
+ */
+
+namespace {
+
+const uint32_t kProbes = 3;
+const milliseconds kProbeInterval(1);
+
+IPAddressV4 entryIP(uint32_t n) {
+  return IPAddressV4::fromLongHBO((10 << 24) + n);
+}
+
+class TimeoutCache;
+
+class TimeoutEntry : private folly::AsyncTimeout {
+ public:
+  TimeoutEntry(IPAddressV4 ip, EventBase* evb, TimeoutCache* cache)
+    : AsyncTimeout(evb), ip_(ip), cache_(cache) {
+    scheduleTimeout(kProbeInterval);
+  }
+
+  // Returns false once there are no probes left
+  bool process() {
+    if (probesLeft_ == 0) {
+      return false;
+    }
+    --probesLeft_;
+    scheduleTimeout(kProbeInterval);
+    return true;
+  }
+
+  void cancel() {
+    cancelTimeout();
+  }
+
+ private:
+  void timeoutExpired() noexcept override;
+
+  IPAddressV4 ip_;
+  TimeoutCache* cache_;
+  uint32_t probesLeft_{kProbes};
+};
+
+class TimeoutCache {
+ public:
+  explicit TimeoutCache(EventBase* evb) : evb_(evb) {}
+
+  void add(IPAddressV4 ip) {
+    entries_[ip] = make_shared<TimeoutEntry>(ip, evb_, this);
+  }
+
+  void process(IPAddressV4 ip) {
+    auto it = entries_.find(ip);
+    if (it == entries_.end() || it->second->process()) {
+      return;
+    }
+    // Entries can't be destroyed from their own callback, so keep the
+    // entry alive until later.
+    auto entry = std::move(it->second);
+    entries_.erase(it);
+    evb_->runInEventBaseThread([entry] { entry->cancel(); });
+  }
+
+ private:
+  EventBase* evb_;
+  std::unordered_map<IPAddressV4, shared_ptr<TimeoutEntry>> entries_;
+};
+
+void TimeoutEntry::timeoutExpired() noexcept {
+  cache_->process(ip_);
+}
+
+class WheelCache : private TimerWheel::Client {
+ public:
+  explicit WheelCache(TimerWheel* wheel) : wheel_(wheel) {}
+
+  void add(IPAddressV4 ip) {
+    auto entry = entries_.emplace(ip, ip);
+    schedule(entry->getHandle());
+  }
+
+ private:
+  struct Entry {
+    Entry(uint32_t handle, IPAddressV4 ip) : handle(handle), ip(ip) {}
+    uint32_t getHandle() const {
+      return handle;
+    }
+    IPAddressV4 getIP() const {
+      return ip;
+    }
+
+    uint32_t handle;
+    IPAddressV4 ip;
+    uint32_t probesLeft{kProbes};
+  };
+
+  void schedule(uint32_t handle) {
+    wheel_->schedule(this, handle, entries_.bumpVersion(handle),
+                     kProbeInterval);
+  }
+
+  void timerExpired(uint32_t handle, uint32_t token) noexcept override {
+    auto entry = entries_.get(handle);
+    if (!entry || entries_.version(handle) != token) {
+      return;
+    }
+    if (entry->probesLeft == 0) {
+      entries_.erase(entry->getIP());
+      return;
+    }
+    --entry->probesLeft;
+    schedule(handle);
+  }
+
+  TimerWheel* wheel_;
+  NeighborEntryStore<IPAddressV4, Entry> entries_;
+};
+
+void perEntryTimeouts(uint32_t numIters, uint32_t numEntries) {
+  EventBase evb;
+  TimeoutCache cache(&evb);
+  for (uint32_t n = 0; n < numIters; ++n) {
+    for (uint32_t i = 0; i < numEntries; ++i) {
+      cache.add(entryIP(i));
+    }
+    evb.loop();
+  }
+}
+
+void timerWheel(uint32_t numIters, uint32_t numEntries) {
+  EventBase evb;
+  TimerWheel wheel(&evb, milliseconds(1));
+  WheelCache cache(&wheel);
+  for (uint32_t n = 0; n < numIters; ++n) {
+    for (uint32_t i = 0; i < numEntries; ++i) {
+      cache.add(entryIP(i));
+    }
+    evb.loop();
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK_PARAM(perEntryTimeouts, 1000)
+BENCHMARK_RELATIVE_PARAM(timerWheel, 1000)
+BENCHMARK_DRAW_LINE()
+BENCHMARK_PARAM(perEntryTimeouts, 10000)
+BENCHMARK_RELATIVE_PARAM(timerWheel, 10000)
+BENCHMARK_DRAW_LINE()
+BENCHMARK_PARAM(perEntryTimeouts, 100000)
+BENCHMARK_RELATIVE_PARAM(timerWheel, 100000)
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Memory.h>
+#include <folly/io/Cursor.h>
+#include "fboss/agent/PacketPolicer.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+
+using namespace facebook::fboss;
+using folly::MacAddress;
+using folly::io::Cursor;
+using folly::make_unique;
+using std::unique_ptr;
+
+/*
+ * The cost of PacketPolicer::allow() on the packet path: classifying the
+ * packet, reading the clock and updating the bucket.
+ */
+
+namespace {
+
+// Global state used by the benchmarks
+unique_ptr<SwSwitch> sw;
+unique_ptr<PacketPolicer> policer;
+unique_ptr<MockRxPacket> ndpSolicitation;
+
+cfg::PacketPolicer makePolicer(cfg::PacketPolicerClass cls, int32_t pps) {
+  cfg::PacketPolicer config;
+  config.packetClass = cls;
+  config.packetsPerSecond = pps;
+  return config;
+}
+
+void init() {
+  MacAddress localMac("02:00:01:00:00:01");
+  sw = make_unique<SwSwitch>(make_unique<SimPlatform>(localMac, 10));
+  sw->init();
+  policer = make_unique<PacketPolicer>(sw.get());
+
+  // An IPv6 neighbor solicitation, which is the deepest classify() looks
+  ndpSolicitation = MockRxPacket::fromHex(
+      // IPv6, payload length 32, ICMPv6, hop limit 255
+      "60 00 00 00  00 20  3a  ff"
+      // Source and destination
+      "fe 80 00 00 00 00 00 00  02 02 00 ff fe 01 02 03"
+      "ff 02 00 00 00 00 00 00  00 00 00 01 ff 00 00 01"
+      // Neighbor solicitation
+      "87 00 00 00  00 00 00 00"
+      );
+  ndpSolicitation->padToLength(72);
+}
+
+void policePackets(size_t numIters) {
+  const auto* buf = ndpSolicitation->buf();
+  size_t allowed = 0;
+  for (size_t n = 0; n < numIters; ++n) {
+    Cursor c(buf);
+    allowed += policer->allow(PortID(1), 0x86dd, c);
+  }
+  folly::doNotOptimizeAway(allowed);
+}
+
+} // unnamed namespace
+
+BENCHMARK(NotPoliced, numIters) {
+  BENCHMARK_SUSPEND {
+    policer->setPolicers({}, PortID(10));
+  }
+  policePackets(numIters);
+}
+
+BENCHMARK_RELATIVE(Conforming, numIters) {
+  BENCHMARK_SUSPEND {
+    // Fast enough that every packet conforms
+    policer->setPolicers(
+        {makePolicer(cfg::PacketPolicerClass::NDP, 1000000000)}, PortID(10));
+  }
+  policePackets(numIters);
+}
+
+BENCHMARK_RELATIVE(Storm, numIters) {
+  BENCHMARK_SUSPEND {
+    // Nearly every packet is dropped
+    policer->setPolicers(
+        {makePolicer(cfg::PacketPolicerClass::NDP, 1)}, PortID(10));
+  }
+  policePackets(numIters);
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  init();
+  folly::runBenchmarks();
+  policer.reset();
+  sw.reset();
+  return 0;
+}
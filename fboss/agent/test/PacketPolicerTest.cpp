@@ -0,0 +1,228 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PacketPolicer.h"
+#include "fboss/agent/ApplyThriftConfig.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
+#include "fboss/agent/hw/mock/MockPlatform.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/test/CounterCache.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <folly/String.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IOBuf;
+using folly::io::Cursor;
+using std::make_shared;
+using std::string;
+using std::unique_ptr;
+
+namespace {
+
+const uint64_t kSecond = 1000000000;
+
+cfg::PacketPolicer makePolicer(cfg::PacketPolicerClass cls,
+                               int32_t pps, int32_t burst) {
+  cfg::PacketPolicer policer;
+  policer.packetClass = cls;
+  policer.packetsPerSecond = pps;
+  policer.burstSize = burst;
+  return policer;
+}
+
+cfg::PacketPolicerClass classifyHex(uint16_t ethertype, const string& hex) {
+  auto buf = IOBuf::copyBuffer(folly::unhexlify(hex));
+  return PacketPolicer::classify(ethertype, Cursor(buf.get()));
+}
+
+cfg::SwitchConfig createSwitchConfig() {
+  cfg::SwitchConfig config;
+  config.ports.resize(2);
+  for (int n = 0; n < 2; ++n) {
+    config.ports[n].logicalID = n + 1;
+    config.ports[n].state = cfg::PortState::UP;
+  }
+  config.packetPolicers.push_back(
+      makePolicer(cfg::PacketPolicerClass::OTHER, 1, 3));
+  return config;
+}
+
+} // unnamed namespace
+
+TEST(PacketPolicer, Classify) {
+  EXPECT_EQ(cfg::PacketPolicerClass::ARP, classifyHex(0x0806, ""));
+  EXPECT_EQ(cfg::PacketPolicerClass::LLDP, classifyHex(0x88cc, ""));
+  EXPECT_EQ(cfg::PacketPolicerClass::OTHER, classifyHex(0x1234, "00"));
+
+  // IPv4 ICMP, UDP to the DHCP server port, and TCP
+  string v4 = "4500001c000000004001000001020304" "0a00000a";
+  EXPECT_EQ(cfg::PacketPolicerClass::ICMPV4, classifyHex(0x0800, v4));
+  string udp4 = v4;
+  udp4[19] = '1';
+  EXPECT_EQ(cfg::PacketPolicerClass::IPV4, classifyHex(0x0800, udp4));
+  EXPECT_EQ(cfg::PacketPolicerClass::DHCPV4,
+            classifyHex(0x0800, udp4 + "00440043"));
+  EXPECT_EQ(cfg::PacketPolicerClass::IPV4,
+            classifyHex(0x0800, udp4 + "30393039"));
+  string tcp4 = v4;
+  tcp4[19] = '6';
+  EXPECT_EQ(cfg::PacketPolicerClass::IPV4, classifyHex(0x0800, tcp4));
+  // Too short to tell
+  EXPECT_EQ(cfg::PacketPolicerClass::IPV4, classifyHex(0x0800, "4500"));
+
+  // IPv6 NDP neighbor solicitation, echo request, DHCPv6 and TCP
+  string v6 = "60000000000000ff" + string(64, '0');
+  string icmp6 = v6;
+  icmp6.replace(12, 2, "3a");
+  EXPECT_EQ(cfg::PacketPolicerClass::NDP, classifyHex(0x86dd, icmp6 + "87"));
+  EXPECT_EQ(cfg::PacketPolicerClass::ICMPV6,
+            classifyHex(0x86dd, icmp6 + "80"));
+  EXPECT_EQ(cfg::PacketPolicerClass::ICMPV6, classifyHex(0x86dd, icmp6));
+  string udp6 = v6;
+  udp6.replace(12, 2, "11");
+  EXPECT_EQ(cfg::PacketPolicerClass::DHCPV6,
+            classifyHex(0x86dd, udp6 + "02220223"));
+  EXPECT_EQ(cfg::PacketPolicerClass::IPV6,
+            classifyHex(0x86dd, udp6 + "30393039"));
+  string tcp6 = v6;
+  tcp6.replace(12, 2, "06");
+  EXPECT_EQ(cfg::PacketPolicerClass::IPV6, classifyHex(0x86dd, tcp6));
+}
+
+TEST(PacketPolicer, Rate) {
+  auto state = make_shared<SwitchState>();
+  state->registerPort(PortID(1), "port1");
+  auto sw = createMockSw(state);
+  PacketPolicer policer(sw.get());
+
+  // 10 packets per second with a burst of 4
+  policer.setPolicers({makePolicer(cfg::PacketPolicerClass::ARP, 10, 4)},
+                      PortID(2));
+  const auto arp = cfg::PacketPolicerClass::ARP;
+  const auto ndp = cfg::PacketPolicerClass::NDP;
+  uint64_t now = 100 * kSecond;
+  for (int n = 0; n < 4; ++n) {
+    EXPECT_TRUE(policer.allow(PortID(1), arp, now));
+  }
+  EXPECT_FALSE(policer.allow(PortID(1), arp, now));
+  // Other ports and classes have their own buckets
+  EXPECT_TRUE(policer.allow(PortID(2), arp, now));
+  for (int n = 0; n < 100; ++n) {
+    EXPECT_TRUE(policer.allow(PortID(1), ndp, now));
+  }
+  // So do ports we haven't been told about
+  EXPECT_TRUE(policer.allow(PortID(3), arp, now));
+
+  // One packet every 100ms
+  EXPECT_FALSE(policer.allow(PortID(1), arp, now + kSecond / 10 - 1));
+  EXPECT_TRUE(policer.allow(PortID(1), arp, now + kSecond / 10));
+  EXPECT_FALSE(policer.allow(PortID(1), arp, now + kSecond / 10));
+  // The bucket doesn't fill beyond the burst
+  now += 10 * kSecond;
+  for (int n = 0; n < 4; ++n) {
+    EXPECT_TRUE(policer.allow(PortID(1), arp, now));
+  }
+  EXPECT_FALSE(policer.allow(PortID(1), arp, now));
+
+  // A burst of 0 is one second's worth.  Adding ports keeps the state of
+  // the existing buckets.
+  policer.setPolicers({makePolicer(cfg::PacketPolicerClass::ARP, 10, 0)},
+                      PortID(5));
+  for (int n = 0; n < 6; ++n) {
+    EXPECT_TRUE(policer.allow(PortID(1), arp, now));
+  }
+  EXPECT_FALSE(policer.allow(PortID(1), arp, now));
+  for (int n = 0; n < 10; ++n) {
+    EXPECT_TRUE(policer.allow(PortID(5), arp, now));
+  }
+  EXPECT_FALSE(policer.allow(PortID(5), arp, now));
+
+  // No policers, no policing
+  policer.setPolicers({}, PortID(5));
+  EXPECT_TRUE(policer.allow(PortID(1), arp, now));
+}
+
+TEST(PacketPolicer, Config) {
+  auto config = createSwitchConfig();
+  MockPlatform platform;
+  auto state = make_shared<SwitchState>();
+  state->registerPort(PortID(1), "port1");
+  state->registerPort(PortID(2), "port2");
+  auto newState = publishAndApplyConfig(state, &config, &platform);
+  ASSERT_EQ(1, newState->getPacketPolicers().size());
+  EXPECT_EQ(3, newState->getPacketPolicers()[0].burstSize);
+
+  // The policers survive a warm boot
+  auto restored = SwitchState::fromFollyDynamic(newState->toFollyDynamic());
+  ASSERT_EQ(1, restored->getPacketPolicers().size());
+  const auto& policer = restored->getPacketPolicers()[0];
+  EXPECT_EQ(cfg::PacketPolicerClass::OTHER, policer.packetClass);
+  EXPECT_EQ(1, policer.packetsPerSecond);
+  EXPECT_EQ(3, policer.burstSize);
+
+  // Applying the same config again is a no-op
+  EXPECT_EQ(nullptr, publishAndApplyConfig(newState, &config,
+                                           &platform));
+
+  config.packetPolicers.push_back(
+      makePolicer(cfg::PacketPolicerClass::OTHER, 10, 0));
+  EXPECT_THROW(publishAndApplyConfig(newState, &config, &platform),
+               FbossError);
+  config.packetPolicers.pop_back();
+  config.packetPolicers[0].packetsPerSecond = 0;
+  EXPECT_THROW(publishAndApplyConfig(newState, &config, &platform),
+               FbossError);
+}
+
+TEST(PacketPolicer, Storm) {
+  auto config = createSwitchConfig();
+  auto sw = createMockSw(&config);
+  sw->initialConfigApplied(std::chrono::steady_clock::now());
+  waitForStateUpdates(sw.get());
+
+  CounterCache counters(sw.get());
+
+  // A storm of packets no handler wants on port 1 and a few on port 2.  The
+  // policer allows 1pps with a burst of 3, so we can't refill in time.
+  auto pkt = MockRxPacket::fromHex(
+    // dst mac, src mac
+    "ff ff ff ff ff ff  02 00 02 01 02 03"
+    // ethertype
+    "12 34"
+  );
+  pkt->padToLength(68);
+  for (int n = 0; n < 20; ++n) {
+    pkt->setSrcPort(PortID(1));
+    sw->packetReceived(pkt->clone());
+  }
+  for (int n = 0; n < 3; ++n) {
+    pkt->setSrcPort(PortID(2));
+    sw->packetReceived(pkt->clone());
+  }
+
+  counters.update();
+  counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.pkts.sum", 23);
+  counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.unhandled.sum",
+                      6);
+  counters.checkDelta(
+      SwitchStats::kCounterPrefix + "trapped.policer_drops.sum", 17);
+  counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.drops.sum", 23);
+  counters.checkDelta(
+      SwitchStats::kCounterPrefix + "port1.trapped.policer_drops.sum", 17);
+  counters.checkDelta(
+      SwitchStats::kCounterPrefix + "port2.trapped.policer_drops.sum", 0);
+}
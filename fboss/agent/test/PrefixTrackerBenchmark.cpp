@@ -0,0 +1,124 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/IPAddress.h>
+#include <gflags/gflags.h>
+#include "fboss/agent/RouteUpdateLoggingPrefixTracker.h"
+#include "fboss/agent/state/RouteTypes.h"
+
+#include <array>
+#include <random>
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+
+DEFINE_int32(num_tracked, 1000,
+             "The number of prefixes tracked, for each identifier");
+DEFINE_int32(num_identifiers, 4, "The number of identifiers tracking");
+DEFINE_int32(num_checked, 10000, "The number of route prefixes checked");
+
+/*
+ * RouteUpdateLoggingPrefixTracker with each of its tree layouts: tracking
+ * prefixes for several identifiers, and checking route prefixes against
+ * them as RouteUpdateLogger does for every changed route.
+ */
+
+namespace {
+
+std::vector<RoutePrefix<IPAddress>> tracked;
+std::vector<RoutePrefix<IPAddress>> checked;
+
+RoutePrefix<IPAddress> randomPrefix(std::mt19937& gen) {
+  if (gen() % 2) {
+    uint8_t mask = 8 + gen() % 25;
+    return {IPAddress(IPAddressV4::fromLongHBO(gen()).mask(mask)), mask};
+  }
+  std::array<uint8_t, 16> bytes{};
+  for (auto& byte : bytes) {
+    byte = gen();
+  }
+  uint8_t mask = 16 + gen() % 113;
+  return {IPAddress(IPAddressV6(bytes).mask(mask)), mask};
+}
+
+void init() {
+  std::mt19937 gen(1);
+  for (int i = 0; i < FLAGS_num_tracked; ++i) {
+    tracked.push_back(randomPrefix(gen));
+  }
+  for (int i = 0; i < FLAGS_num_checked; ++i) {
+    checked.push_back(randomPrefix(gen));
+  }
+}
+
+template<typename TrackerT>
+void trackPrefixes(TrackerT* tracker) {
+  for (int id = 0; id < FLAGS_num_identifiers; ++id) {
+    auto identifier = folly::to<std::string>("id", id);
+    for (const auto& prefix : tracked) {
+      tracker->track(RouteUpdateLoggingInstance(prefix, identifier, id % 2));
+    }
+  }
+}
+
+template<typename TrackerT>
+void track(size_t numIters) {
+  for (size_t n = 0; n < numIters; ++n) {
+    TrackerT tracker;
+    trackPrefixes(&tracker);
+  }
+}
+
+template<typename TrackerT>
+void check(size_t numIters) {
+  TrackerT tracker;
+  BENCHMARK_SUSPEND {
+    trackPrefixes(&tracker);
+  }
+  std::vector<std::string> identifiers;
+  size_t matched = 0;
+  for (size_t n = 0; n < numIters; ++n) {
+    for (const auto& prefix : checked) {
+      matched += tracker.tracking(prefix, identifiers);
+    }
+  }
+  folly::doNotOptimizeAway(matched);
+}
+
+} // unnamed namespace
+
+BENCHMARK(RadixTreeTrack, numIters) {
+  track<RadixTreePrefixTracker>(numIters);
+}
+
+BENCHMARK_RELATIVE(MultibitRadixTreeTrack, numIters) {
+  track<MultibitRadixTreePrefixTracker>(numIters);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(RadixTreeCheck, numIters) {
+  check<RadixTreePrefixTracker>(numIters);
+}
+
+BENCHMARK_RELATIVE(MultibitRadixTreeCheck, numIters) {
+  check<MultibitRadixTreePrefixTracker>(numIters);
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  init();
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/RouteUpdateCoalescer.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateUpdateHelpers.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <folly/Baton.h>
+#include <folly/IPAddress.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace {
+
+const RouterID kRid(0);
+
+unique_ptr<SwSwitch> setupSwitch() {
+  auto sw = createMockSw(testStateA());
+  sw->initialConfigApplied(std::chrono::steady_clock::now());
+  return sw;
+}
+
+RouteUpdateCoalescer::RouteChange addRoute(const std::string& network) {
+  return [=](RouteUpdater* updater) {
+    RouteNextHops nexthops;
+    nexthops.emplace(IPAddress("10.0.0.22"));
+    updater->addRoute(kRid, IPAddress(network), 24, nexthops);
+  };
+}
+
+bool hasRoute(SwSwitch* sw, const std::string& network) {
+  auto table = sw->getState()->getRouteTables()->getRouteTableIf(kRid);
+  return table &&
+    table->getRibV4()->exactMatch({IPAddressV4(network), 24}) != nullptr;
+}
+
+// Keeps the update thread busy, so updates queue up behind it
+class UpdateThreadBlocker {
+ public:
+  explicit UpdateThreadBlocker(SwSwitch* sw) {
+    sw->getUpdateEVB()->runInEventBaseThread([this] { release_.wait(); });
+  }
+  ~UpdateThreadBlocker() {
+    release();
+  }
+  void release() {
+    if (!released_) {
+      released_ = true;
+      release_.post();
+    }
+  }
+
+ private:
+  folly::Baton<> release_;
+  bool released_{false};
+};
+
+} // unnamed namespace
+
+TEST(RouteUpdateCoalescer, Coalesce) {
+  auto sw = setupSwitch();
+  RouteUpdateCoalescer coalescer(sw.get());
+
+  UpdateThreadBlocker blocker(sw.get());
+  auto f1 = coalescer.update(addRoute("20.0.1.0"));
+  auto f2 = coalescer.update(addRoute("20.0.2.0"));
+  auto f3 = coalescer.update(addRoute("20.0.3.0"));
+  blocker.release();
+
+  auto s1 = f1.get();
+  auto s2 = f2.get();
+  auto s3 = f3.get();
+  // All three were applied in a single state update
+  EXPECT_TRUE(s1.changed());
+  EXPECT_EQ(s1.oldGeneration, s2.oldGeneration);
+  EXPECT_EQ(s1.newGeneration, s2.newGeneration);
+  EXPECT_EQ(s1.newGeneration, s3.newGeneration);
+  EXPECT_TRUE(hasRoute(sw.get(), "20.0.1.0"));
+  EXPECT_TRUE(hasRoute(sw.get(), "20.0.2.0"));
+  EXPECT_TRUE(hasRoute(sw.get(), "20.0.3.0"));
+
+  // Re-adding the same route doesn't change anything
+  auto s4 = coalescer.update(addRoute("20.0.1.0")).get();
+  EXPECT_FALSE(s4.changed());
+}
+
+TEST(RouteUpdateCoalescer, FailedChange) {
+  auto sw = setupSwitch();
+  RouteUpdateCoalescer coalescer(sw.get());
+
+  UpdateThreadBlocker blocker(sw.get());
+  auto f1 = coalescer.update(addRoute("20.0.1.0"));
+  auto f2 = coalescer.update([](RouteUpdater* updater) {
+      // Partially applied before failing
+      RouteNextHops nexthops;
+      nexthops.emplace(IPAddress("10.0.0.22"));
+      updater->addRoute(kRid, IPAddress("20.0.2.0"), 24, nexthops);
+      throw FbossError("bad route");
+    });
+  auto f3 = coalescer.update(addRoute("20.0.3.0"));
+  blocker.release();
+
+  EXPECT_TRUE(f1.get().changed());
+  EXPECT_THROW(f2.get(), FbossError);
+  EXPECT_TRUE(f3.get().changed());
+  EXPECT_TRUE(hasRoute(sw.get(), "20.0.1.0"));
+  EXPECT_FALSE(hasRoute(sw.get(), "20.0.2.0"));
+  EXPECT_TRUE(hasRoute(sw.get(), "20.0.3.0"));
+}
+
+TEST(RouteUpdateCoalescer, Exclusive) {
+  auto sw = setupSwitch();
+  RouteUpdateCoalescer coalescer(sw.get());
+
+  UpdateThreadBlocker blocker(sw.get());
+  auto f1 = coalescer.update(addRoute("20.0.1.0"));
+  bool sawFirst = false;
+  bool sawSecond = false;
+  auto f2 = coalescer.updateExclusive(
+      "check order", [&](const shared_ptr<SwitchState>& state) {
+        auto table = state->getRouteTables()->getRouteTableIf(kRid);
+        auto rib = table->getRibV4();
+        sawFirst = rib->exactMatch({IPAddressV4("20.0.1.0"), 24}) != nullptr;
+        sawSecond = rib->exactMatch({IPAddressV4("20.0.2.0"), 24}) != nullptr;
+        return shared_ptr<SwitchState>();
+      });
+  // Queued after the exclusive update, so it must not join the first batch
+  auto f3 = coalescer.update(addRoute("20.0.2.0"));
+  blocker.release();
+
+  auto s1 = f1.get();
+  EXPECT_FALSE(f2.get().changed());
+  auto s3 = f3.get();
+  EXPECT_TRUE(sawFirst);
+  EXPECT_FALSE(sawSecond);
+  EXPECT_LT(s1.newGeneration, s3.newGeneration);
+}
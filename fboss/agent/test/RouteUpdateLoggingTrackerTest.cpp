@@ -18,6 +18,7 @@ using namespace facebook::fboss;
 namespace {
 // Test some plausible sequences of tracking, checking, and stopping tracking
 
+template <typename TrackerT>
 class PrefixTrackerTest : public ::testing::Test {
  public:
   void startTracking(
@@ -50,109 +51,114 @@ class PrefixTrackerTest : public ::testing::Test {
     EXPECT_FALSE(tracker.tracking(prefix, ids));
   }
 
-  RouteUpdateLoggingPrefixTracker tracker;
+  TrackerT tracker;
   RoutePrefix<folly::IPAddressV6> p1{folly::IPAddressV6{"1:1:1:1::"}, 64};
   RoutePrefix<folly::IPAddressV6> p2{folly::IPAddressV6{"1:1::"}, 32};
   RoutePrefix<folly::IPAddressV6> pFull{folly::IPAddressV6{"::1:1:1:1"}, 128};
   RoutePrefix<folly::IPAddressV6> pZero{folly::IPAddressV6{"::"}, 0};
 };
 
+// Run every test with each tree layout
+typedef ::testing::Types<RadixTreePrefixTracker,
+                         MultibitRadixTreePrefixTracker> TrackerTypes;
+TYPED_TEST_CASE(PrefixTrackerTest, TrackerTypes);
+
 // Track any prefix. Check a couple arbitrary ones
-TEST_F(PrefixTrackerTest, TrackAny) {
-  checkNotTracking(p1);
-  checkNotTracking(pFull);
-  checkNotTracking(pZero);
-  startTracking("::", 0, "", false);
-  checkTracking(p1);
-  checkTracking(pFull);
-  checkTracking(pZero);
+TYPED_TEST(PrefixTrackerTest, TrackAny) {
+  this->checkNotTracking(this->p1);
+  this->checkNotTracking(this->pFull);
+  this->checkNotTracking(this->pZero);
+  this->startTracking("::", 0, "", false);
+  this->checkTracking(this->p1);
+  this->checkTracking(this->pFull);
+  this->checkTracking(this->pZero);
 }
 
 // Checking a prefix shouldn't affect future checks
-TEST_F(PrefixTrackerTest, IdempotentTrackingCheck) {
-  checkNotTracking(p1);
-  checkNotTracking(p1);
+TYPED_TEST(PrefixTrackerTest, IdempotentTrackingCheck) {
+  this->checkNotTracking(this->p1);
+  this->checkNotTracking(this->p1);
 }
 
 // We don't implicitly track the all zeros address
-TEST_F(PrefixTrackerTest, AllZeroUntracked) {
+TYPED_TEST(PrefixTrackerTest, AllZeroUntracked) {
   RoutePrefix<folly::IPAddressV6> z{folly::IPAddressV6{"1::1"}, 0};
-  checkNotTracking(pZero);
-  checkNotTracking(z);
+  this->checkNotTracking(this->pZero);
+  this->checkNotTracking(z);
 }
 
 // Exact network/mask match
-TEST_F(PrefixTrackerTest, ExactMatch) {
-  checkNotTracking(p1);
-  startTracking("1:1:1:1::", 64, "", false);
-  checkTracking(p1);
+TYPED_TEST(PrefixTrackerTest, ExactMatch) {
+  this->checkNotTracking(this->p1);
+  this->startTracking("1:1:1:1::", 64, "", false);
+  this->checkTracking(this->p1);
 }
 
 // Track a less specific prefix than what we check
-TEST_F(PrefixTrackerTest, PartialMatch) {
-  checkNotTracking(p1);
-  startTracking("1:1::", 32, "", false);
-  checkTracking(p1);
+TYPED_TEST(PrefixTrackerTest, PartialMatch) {
+  this->checkNotTracking(this->p1);
+  this->startTracking("1:1::", 32, "", false);
+  this->checkTracking(this->p1);
 }
 
 // Track a less specific prefix than what we check in exact mode
-TEST_F(PrefixTrackerTest, PartialMatchTrackExact) {
-  checkNotTracking(p1);
-  startTracking("1:1::", 32, "", true);
-  checkNotTracking(p1);
+TYPED_TEST(PrefixTrackerTest, PartialMatchTrackExact) {
+  this->checkNotTracking(this->p1);
+  this->startTracking("1:1::", 32, "", true);
+  this->checkNotTracking(this->p1);
 }
 
 // Track a more specific prefix than what we check
-TEST_F(PrefixTrackerTest, TrackedTooSpecific) {
-  checkNotTracking(p1);
-  startTracking("1:1:2:2::", 64, "", false);
-  checkNotTracking(p1);
+TYPED_TEST(PrefixTrackerTest, TrackedTooSpecific) {
+  this->checkNotTracking(this->p1);
+  this->startTracking("1:1:2:2::", 64, "", false);
+  this->checkNotTracking(this->p1);
 }
 
 // Stop tracking a tracked prefix.
-TEST_F(PrefixTrackerTest, DeleteTracked) {
-  checkNotTracking(p1);
-  startTracking("::", 0, "", false);
-  checkTracking(p1);
-  stopTracking("::", 0, "");
-  checkNotTracking(p1);
+TYPED_TEST(PrefixTrackerTest, DeleteTracked) {
+  this->checkNotTracking(this->p1);
+  this->startTracking("::", 0, "", false);
+  this->checkTracking(this->p1);
+  this->stopTracking("::", 0, "");
+  this->checkNotTracking(this->p1);
 }
 
 // Try to stop tracking a prefix that we weren't tracking
-TEST_F(PrefixTrackerTest, DeleteUntracked) {
-  checkNotTracking(p1);
-  startTracking("1:1::", 32, "", false);
-  checkTracking(p1);
-  stopTracking("1:1:1:1::", 64, "");
-  checkTracking(p1);
+TYPED_TEST(PrefixTrackerTest, DeleteUntracked) {
+  this->checkNotTracking(this->p1);
+  this->startTracking("1:1::", 32, "", false);
+  this->checkTracking(this->p1);
+  this->stopTracking("1:1:1:1::", 64, "");
+  this->checkTracking(this->p1);
 }
 
 // Track two prefixes with one being more specific than the other.
 // Stop tracking the less specific prefix, but the more specific prefix
 // should still be tracked
-TEST_F(PrefixTrackerTest, DeleteLessSpecificTracked) {
-  checkNotTracking(p1);
-  checkNotTracking(p2);
-  startTracking("1:1::", 32, "", false);
-  startTracking("1:1:1:1::", 64, "", false);
-  checkTracking(p1);
-  checkTracking(p2);
-  stopTracking("1:1::", 32, "");
-  checkTracking(p1);
-  checkNotTracking(p2);
+TYPED_TEST(PrefixTrackerTest, DeleteLessSpecificTracked) {
+  this->checkNotTracking(this->p1);
+  this->checkNotTracking(this->p2);
+  this->startTracking("1:1::", 32, "", false);
+  this->startTracking("1:1:1:1::", 64, "", false);
+  this->checkTracking(this->p1);
+  this->checkTracking(this->p2);
+  this->stopTracking("1:1::", 32, "");
+  this->checkTracking(this->p1);
+  this->checkNotTracking(this->p2);
 }
 
 // Try to stop tracking a less specific (but untracked) prefix than one we are
 // actually tracking. The more specific prefix should still be tracked
-TEST_F(PrefixTrackerTest, DeleteLessSpecificUntracked) {
-  checkNotTracking(p1);
-  checkNotTracking(p2);
-  startTracking("1:1:1:1::", 64, "", false);
-  checkTracking(p1);
-  checkNotTracking(p2);
-  stopTracking("1:1::", 32, "");
-  checkTracking(p1);
-  checkNotTracking(p2);
+TYPED_TEST(PrefixTrackerTest, DeleteLessSpecificUntracked) {
+  this->checkNotTracking(this->p1);
+  this->checkNotTracking(this->p2);
+  this->startTracking("1:1:1:1::", 64, "", false);
+  this->checkTracking(this->p1);
+  this->checkNotTracking(this->p2);
+  this->stopTracking("1:1::", 32, "");
+  this->checkTracking(this->p1);
+  this->checkNotTracking(this->p2);
 }
 
 }
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/SerialWorkerPool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+using namespace facebook::fboss;
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+TEST(SerialWorkerPool, PerQueueOrder) {
+  const uint32_t kNumQueues = 8;
+  const uint32_t kNumFns = 1000;
+  SerialWorkerPool pool("test", 4);
+
+  vector<shared_ptr<SerialWorkerPool::Queue>> queues;
+  // Only touched by functions on the matching queue, which never overlap
+  vector<vector<uint32_t>> seen(kNumQueues);
+  vector<std::atomic<uint32_t>> running(kNumQueues);
+  std::atomic<bool> overlapped{false};
+  for (uint32_t q = 0; q < kNumQueues; ++q) {
+    queues.push_back(make_shared<SerialWorkerPool::Queue>());
+    running[q] = 0;
+  }
+  for (uint32_t n = 0; n < kNumFns; ++n) {
+    for (uint32_t q = 0; q < kNumQueues; ++q) {
+      pool.add(queues[q], [&, q, n] {
+          if (running[q]++ != 0) {
+            overlapped = true;
+          }
+          seen[q].push_back(n);
+          --running[q];
+        });
+    }
+  }
+  for (uint32_t q = 0; q < kNumQueues; ++q) {
+    pool.drain(queues[q]);
+    ASSERT_EQ(kNumFns, seen[q].size());
+    for (uint32_t n = 0; n < kNumFns; ++n) {
+      EXPECT_EQ(n, seen[q][n]);
+    }
+  }
+  EXPECT_FALSE(overlapped);
+}
+
+TEST(SerialWorkerPool, DrainWaits) {
+  SerialWorkerPool pool("test", 2);
+  auto queue = make_shared<SerialWorkerPool::Queue>();
+  std::atomic<bool> done{false};
+  pool.add(queue, [&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      done = true;
+    });
+  pool.drain(queue);
+  EXPECT_TRUE(done);
+
+  // Draining an idle queue returns straight away
+  pool.drain(queue);
+  pool.drain(make_shared<SerialWorkerPool::Queue>());
+}
+
+TEST(SerialWorkerPool, Stop) {
+  SerialWorkerPool pool("test", 2);
+  auto queue = make_shared<SerialWorkerPool::Queue>();
+  std::atomic<uint32_t> count{0};
+  for (uint32_t n = 0; n < 100; ++n) {
+    pool.add(queue, [&] { ++count; });
+  }
+  // Everything added before stop() still runs
+  pool.stop();
+  EXPECT_EQ(100, count);
+
+  auto caller = std::this_thread::get_id();
+  std::thread::id ranOn;
+  pool.add(queue, [&] { ranOn = std::this_thread::get_id(); });
+  EXPECT_EQ(caller, ranOn);
+}
@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/StateObserver.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/state/StateUpdateHelpers.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <folly/Memory.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace facebook::fboss;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace {
+
+// Updates still running, updates started after the observer began to be
+// destroyed, and updates done
+std::atomic<int> updatesRunning{0};
+std::atomic<int> updatesAfterDestroy{0};
+std::atomic<int> updatesSeen{0};
+
+// Takes its time with each update, under a lock of its own, as
+// UnresolvedNhopsProber does
+class SlowConcurrentObserver : public AutoRegisterStateObserver {
+ public:
+  explicit SlowConcurrentObserver(SwSwitch* sw)
+    : AutoRegisterStateObserver(sw, "SlowConcurrentObserver", true) {}
+
+  ~SlowConcurrentObserver() override {
+    stopObserving();
+    // No update may still be running once the members start going away
+    EXPECT_EQ(0, updatesRunning.load());
+    destroyed_ = true;
+  }
+
+  void stateUpdated(const StateDelta& delta) override {
+    ++updatesRunning;
+    if (destroyed_) {
+      ++updatesAfterDestroy;
+    }
+    {
+      std::lock_guard<std::mutex> g(lock_);
+      std::this_thread::sleep_for(milliseconds(1));
+      ++updatesSeen;
+    }
+    --updatesRunning;
+  }
+
+ private:
+  std::mutex lock_;
+  std::atomic<bool> destroyed_{false};
+};
+
+void setArpTimeout(SwSwitch* sw, int timeout) {
+  auto fn = [=](const shared_ptr<SwitchState>& state) {
+    auto newState = state->clone();
+    newState->setArpTimeout(seconds(timeout));
+    return newState;
+  };
+  // Not coalesced, so the observer gets one delta per update
+  sw->updateState(folly::make_unique<FunctionStateUpdate>(
+      "set ARP timeout", fn, false));
+}
+
+} // unnamed namespace
+
+TEST(StateObserver, DestroyConcurrentObserverDuringUpdates) {
+  auto sw = createMockSw(testStateA());
+  sw->initialConfigApplied(std::chrono::steady_clock::now());
+
+  updatesSeen = 0;
+  auto observer = folly::make_unique<SlowConcurrentObserver>(sw.get());
+  // Queue up more updates than the observer can keep up with, then destroy
+  // it while they are still being delivered
+  for (int i = 1; i <= 100; ++i) {
+    setArpTimeout(sw.get(), 1000 + i);
+  }
+  while (updatesSeen == 0) {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  observer.reset();
+
+  EXPECT_EQ(0, updatesRunning.load());
+  EXPECT_EQ(0, updatesAfterDestroy.load());
+  waitForStateUpdates(sw.get());
+}
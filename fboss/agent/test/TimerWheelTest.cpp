@@ -0,0 +1,171 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/TimerWheel.h"
+
+#include <folly/Baton.h>
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace facebook::fboss;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+// Runs an EventBase in its own thread until stopped
+class EventBaseThread {
+ public:
+  EventBaseThread() : thread_([this] { evb_.loopForever(); }) {
+    evb_.waitUntilRunning();
+  }
+  ~EventBaseThread() {
+    stop();
+  }
+  folly::EventBase* getEventBase() {
+    return &evb_;
+  }
+  // Must be called before destroying anything the thread may be using
+  void stop() {
+    if (thread_.joinable()) {
+      evb_.terminateLoopSoon();
+      thread_.join();
+    }
+  }
+
+ private:
+  folly::EventBase evb_;
+  std::thread thread_;
+};
+
+class RecordingClient : public TimerWheel::Client {
+ public:
+  struct Expiry {
+    uint32_t handle;
+    uint32_t token;
+    steady_clock::time_point time;
+  };
+
+  explicit RecordingClient(size_t expected) : expected_(expected) {}
+
+  void timerExpired(uint32_t handle, uint32_t token) noexcept override {
+    size_t count;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      expiries_.push_back({handle, token, steady_clock::now()});
+      count = expiries_.size();
+    }
+    if (count == expected_) {
+      done_.post();
+    }
+  }
+
+  bool wait(milliseconds timeout) {
+    return done_.timed_wait(steady_clock::now() + timeout);
+  }
+
+  std::vector<Expiry> expiries() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return expiries_;
+  }
+
+ private:
+  const size_t expected_;
+  std::mutex mutex_;
+  std::vector<Expiry> expiries_;
+  folly::Baton<> done_;
+};
+
+// Reschedules its timer from the callback until it has fired kRounds times
+class RepeatingClient : public TimerWheel::Client {
+ public:
+  static const uint32_t kRounds = 50;
+
+  explicit RepeatingClient(TimerWheel* wheel) : wheel_(wheel) {}
+
+  void timerExpired(uint32_t handle, uint32_t token) noexcept override {
+    if (token + 1 == kRounds) {
+      done.post();
+    } else {
+      wheel_->schedule(this, handle, token + 1, milliseconds(2));
+    }
+  }
+
+  folly::Baton<> done;
+
+ private:
+  TimerWheel* wheel_;
+};
+
+} // unnamed namespace
+
+TEST(TimerWheel, FireInOrder) {
+  EventBaseThread thread;
+  // A 1ms tick, so timers of a few hundred ms go through the second level
+  TimerWheel wheel(thread.getEventBase(), milliseconds(1));
+  const std::vector<uint32_t> delays{700, 5, 300, 60, 0, 260};
+  RecordingClient client(delays.size());
+
+  auto start = steady_clock::now();
+  for (uint32_t i = 0; i < delays.size(); ++i) {
+    wheel.schedule(&client, delays[i], i, milliseconds(delays[i]));
+  }
+  ASSERT_TRUE(client.wait(milliseconds(5000)));
+
+  auto expiries = client.expiries();
+  ASSERT_EQ(delays.size(), expiries.size());
+  uint32_t lastDelay = 0;
+  for (const auto& expiry : expiries) {
+    // We scheduled each timer with its delay as the handle
+    EXPECT_LE(lastDelay, expiry.handle);
+    EXPECT_EQ(delays[expiry.token], expiry.handle);
+    lastDelay = expiry.handle;
+    // Timers may fire up to a tick early, measured from when they were
+    // scheduled
+    EXPECT_GE(expiry.time - start, milliseconds(expiry.handle) -
+              milliseconds(2));
+  }
+  EXPECT_EQ(0, wheel.size());
+  thread.stop();
+}
+
+TEST(TimerWheel, RemoveClient) {
+  EventBaseThread thread;
+  TimerWheel wheel(thread.getEventBase(), milliseconds(1));
+  RecordingClient removed(1);
+  RecordingClient kept(2);
+
+  wheel.schedule(&removed, 1, 0, milliseconds(20));
+  wheel.schedule(&kept, 1, 0, milliseconds(20));
+  wheel.schedule(&removed, 2, 0, milliseconds(40));
+  wheel.schedule(&kept, 2, 0, milliseconds(40));
+  EXPECT_EQ(4, wheel.size());
+  wheel.removeClient(&removed);
+  EXPECT_EQ(2, wheel.size());
+
+  ASSERT_TRUE(kept.wait(milliseconds(5000)));
+  EXPECT_EQ(2, kept.expiries().size());
+  EXPECT_TRUE(removed.expiries().empty());
+  thread.stop();
+}
+
+TEST(TimerWheel, ScheduleFromCallback) {
+  EventBaseThread thread;
+  TimerWheel wheel(thread.getEventBase(), milliseconds(1));
+  RepeatingClient client(&wheel);
+  wheel.schedule(&client, 7, 0, milliseconds(2));
+  EXPECT_TRUE(client.done.timed_wait(steady_clock::now() +
+                                     milliseconds(5000)));
+  thread.stop();
+  EXPECT_EQ(0, wheel.size());
+}
@@ -0,0 +1,303 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#ifndef MULTIBIT_RADIX_TREE_H
+#error "This should only be included by MultibitRadixTree.h"
+#endif
+
+namespace facebook { namespace network {
+
+template<typename TREE, typename VALUE>
+void MultibitRadixTreeIterator<TREE, VALUE>::seek(bool visited) {
+  while (!path_.empty()) {
+    auto& position = path_.back();
+    if (!visited) {
+      if (position.pos >= Tree::kFanout) {
+        // Go down to the child node
+        auto child = tree_->childIndex(position.node,
+            position.pos - Tree::kFanout);
+        path_.push_back({child, 1});
+        continue;
+      }
+      if (tree_->hasPrefix(position)) {
+        settle();
+        return;
+      }
+    }
+    visited = false;
+    position.pos = tree_->nextPosition(position.node, position.pos);
+    if (!position.pos) {
+      // Done with this node, carry on after it in its parent
+      path_.pop_back();
+      visited = true;
+    }
+  }
+  reset();
+}
+
+template<typename TREE, typename VALUE>
+void MultibitRadixTreeIterator<TREE, VALUE>::settle() {
+  uint8_t bytes[16] = {0};
+  uint32_t masklen = 0;
+  for (size_t i = 0; i + 1 < path_.size(); ++i) {
+    Tree::setBits(bytes, masklen, path_[i].pos - Tree::kFanout, Tree::kStride);
+    masklen += Tree::kStride;
+  }
+  auto pos = path_.back().pos;
+  uint32_t bits = folly::findLastSet(pos) - 1;
+  Tree::setBits(bytes, masklen, pos - (1 << bits), bits);
+  masklen += bits;
+  ipAddress_ = IPAddressType::fromBinary(
+      folly::ByteRange(bytes, IPAddressType::byteCount()));
+  masklen_ = masklen;
+}
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+constexpr uint32_t MultibitRadixTree<IPADDRTYPE, T, STRIDE>::kFanout;
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+constexpr uint32_t MultibitRadixTree<IPADDRTYPE, T, STRIDE>::kStride;
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+constexpr uint32_t MultibitRadixTree<IPADDRTYPE, T, STRIDE>::kNoNode;
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+template<typename VALUE>
+std::pair<typename MultibitRadixTree<IPADDRTYPE, T, STRIDE>::Iterator, bool>
+MultibitRadixTree<IPADDRTYPE, T, STRIDE>::insert(const IPADDRTYPE& ipaddr,
+    uint8_t masklen, VALUE&& value) {
+  CHECK_LE(masklen, IPADDRTYPE::bitCount());
+  // Can't trust the clients to have 0s in all bits after mask length
+  auto toAdd = ipaddr.mask(masklen);
+  if (root_ == kNoNode) {
+    root_ = nodes_.allocate(1);
+    nodes_[root_] = Node();
+  }
+  std::vector<Position> path;
+  auto node = root_;
+  for (uint32_t depth = 0; (depth + 1) * STRIDE <= masklen; ++depth) {
+    auto child = chunk(toAdd, depth);
+    path.push_back({node, kFanout + child});
+    node = nodes_[node].children.test(child) ? childIndex(node, child) :
+      addChild(node, child);
+  }
+  auto pos = position(toAdd, masklen);
+  path.push_back({node, pos});
+  if (nodes_[node].prefixes.test(pos)) {
+    // Prefix already exists in the tree
+    return std::make_pair(Iterator(this, std::move(path), true), false);
+  }
+  addValue(node, pos, std::forward<VALUE>(value));
+  ++size_;
+  return std::make_pair(Iterator(this, std::move(path), true), true);
+}
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+bool MultibitRadixTree<IPADDRTYPE, T, STRIDE>::erase(
+    const IPADDRTYPE& ipaddr, uint8_t masklen) {
+  if (root_ == kNoNode || masklen > IPADDRTYPE::bitCount()) {
+    return false;
+  }
+  auto toErase = ipaddr.mask(masklen);
+  std::vector<Position> path;
+  auto node = root_;
+  for (uint32_t depth = 0; (depth + 1) * STRIDE <= masklen; ++depth) {
+    auto child = chunk(toErase, depth);
+    if (!nodes_[node].children.test(child)) {
+      return false;
+    }
+    path.push_back({node, kFanout + child});
+    node = childIndex(node, child);
+  }
+  auto pos = position(toErase, masklen);
+  if (!nodes_[node].prefixes.test(pos)) {
+    return false;
+  }
+  removeValue(node, pos);
+  --size_;
+  if (size_ == 0) {
+    clear();
+    return true;
+  }
+  // Remove the nodes left empty, from the bottom up
+  while (!path.empty() && nodes_[node].prefixes.none() &&
+         nodes_[node].children.none()) {
+    auto parent = path.back();
+    path.pop_back();
+    removeChild(parent.node, parent.pos - kFanout);
+    node = parent.node;
+  }
+  return true;
+}
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+std::vector<typename MultibitRadixTree<IPADDRTYPE, T, STRIDE>::Position>
+MultibitRadixTree<IPADDRTYPE, T, STRIDE>::matchImpl(const IPADDRTYPE& ipaddr,
+    uint8_t masklen, bool& foundExact, VecConstIterators* trail) const {
+  std::vector<Position> match;
+  if (root_ == kNoNode) {
+    return match;
+  }
+  auto toMatch = ipaddr.mask(masklen);
+  std::vector<Position> path;
+  auto node = root_;
+  for (uint32_t depth = 0; ; ++depth) {
+    const auto& n = nodes_[node];
+    uint32_t bitsLeft = masklen - depth * STRIDE;
+    uint32_t bits = bitsLeft ? chunk(toMatch, depth) : 0;
+    // Prefixes in this node, shortest first
+    for (uint32_t k = 0; k < STRIDE && k <= bitsLeft; ++k) {
+      uint32_t pos = (1 << k) | (bits >> (STRIDE - k));
+      if (n.prefixes.test(pos)) {
+        match = path;
+        match.push_back({node, pos});
+        foundExact = k == bitsLeft;
+        if (trail) {
+          trail->push_back(ConstIterator(this, match, true));
+        }
+      }
+    }
+    if (bitsLeft < STRIDE || !n.children.test(bits)) {
+      break;
+    }
+    path.push_back({node, kFanout + bits});
+    node = childIndex(node, bits);
+  }
+  return match;
+}
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+uint32_t MultibitRadixTree<IPADDRTYPE, T, STRIDE>::nextPosition(
+    uint32_t node, uint32_t pos) const {
+  const auto& n = nodes_[node];
+  // The first position after the subtree under pos, or 0 if there is none
+  auto after = [](uint32_t pos) -> uint32_t {
+    while (pos & 1) {
+      pos >>= 1;
+    }
+    return pos ? pos + 1 : 0;
+  };
+  auto next = pos < kFanout ? 2 * pos : after(pos);
+  while (next && !nonEmpty(n, next)) {
+    next = after(next);
+  }
+  return next;
+}
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+bool MultibitRadixTree<IPADDRTYPE, T, STRIDE>::nonEmpty(const Node& node,
+    uint32_t pos) const {
+  if (pos >= kFanout) {
+    return node.children.test(pos - kFanout);
+  }
+  // The positions under pos at each level are [begin, end)
+  auto begin = pos;
+  auto end = pos + 1;
+  while (begin < kFanout) {
+    if (node.prefixes.any(begin, end)) {
+      return true;
+    }
+    begin <<= 1;
+    end <<= 1;
+  }
+  return node.children.any(begin - kFanout, end - kFanout);
+}
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+uint32_t MultibitRadixTree<IPADDRTYPE, T, STRIDE>::addChild(uint32_t node,
+    uint32_t child) {
+  auto numChildren = nodes_[node].children.count();
+  auto rank = nodes_[node].children.rank(child);
+  // Note that allocating may move the nodes
+  auto first = nodes_.allocate(numChildren + 1);
+  auto oldFirst = nodes_[node].firstChild;
+  for (uint32_t i = 0; i < rank; ++i) {
+    nodes_[first + i] = nodes_[oldFirst + i];
+  }
+  nodes_[first + rank] = Node();
+  for (uint32_t i = rank; i < numChildren; ++i) {
+    nodes_[first + i + 1] = nodes_[oldFirst + i];
+  }
+  if (numChildren) {
+    nodes_.free(oldFirst, numChildren);
+  }
+  nodes_[node].firstChild = first;
+  nodes_[node].children.set(child);
+  return first + rank;
+}
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+void MultibitRadixTree<IPADDRTYPE, T, STRIDE>::removeChild(uint32_t node,
+    uint32_t child) {
+  auto numChildren = nodes_[node].children.count();
+  auto rank = nodes_[node].children.rank(child);
+  auto oldFirst = nodes_[node].firstChild;
+  uint32_t first = 0;
+  if (numChildren > 1) {
+    first = nodes_.allocate(numChildren - 1);
+    for (uint32_t i = 0; i < numChildren; ++i) {
+      if (i != rank) {
+        nodes_[first + i - (i > rank)] = nodes_[oldFirst + i];
+      }
+    }
+  }
+  nodes_.free(oldFirst, numChildren);
+  nodes_[node].firstChild = first;
+  nodes_[node].children.reset(child);
+}
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+template<typename VALUE>
+void MultibitRadixTree<IPADDRTYPE, T, STRIDE>::addValue(uint32_t node,
+    uint32_t pos, VALUE&& value) {
+  auto& n = nodes_[node];
+  auto numValues = n.prefixes.count();
+  auto rank = n.prefixes.rank(pos);
+  auto first = values_.allocate(numValues + 1);
+  for (uint32_t i = 0; i < numValues; ++i) {
+    auto& from = values_[n.firstValue + i];
+    values_[first + i + (i >= rank)] = std::move(from);
+    from.clear();
+  }
+  values_[first + rank] = T(std::forward<VALUE>(value));
+  if (numValues) {
+    values_.free(n.firstValue, numValues);
+  }
+  n.firstValue = first;
+  n.prefixes.set(pos);
+}
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+void MultibitRadixTree<IPADDRTYPE, T, STRIDE>::removeValue(uint32_t node,
+    uint32_t pos) {
+  auto& n = nodes_[node];
+  auto numValues = n.prefixes.count();
+  auto rank = n.prefixes.rank(pos);
+  uint32_t first = 0;
+  if (numValues > 1) {
+    first = values_.allocate(numValues - 1);
+  }
+  for (uint32_t i = 0; i < numValues; ++i) {
+    auto& from = values_[n.firstValue + i];
+    if (i != rank) {
+      values_[first + i - (i > rank)] = std::move(from);
+    }
+    from.clear();
+  }
+  values_.free(n.firstValue, numValues);
+  n.firstValue = first;
+  n.prefixes.reset(pos);
+}
+
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE>
+bool MultibitRadixTree<IPADDRTYPE, T, STRIDE>::operator==(
+    const MultibitRadixTree& r) const {
+  if (size_ != r.size_) {
+    return false;
+  }
+  for (auto a = begin(), b = r.begin(); a != end(); ++a, ++b) {
+    if (a.ipAddress() != b.ipAddress() || a.masklen() != b.masklen() ||
+        !(a.value() == b.value())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}} // facebook::network
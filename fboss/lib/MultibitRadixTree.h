@@ -0,0 +1,894 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#ifndef MULTIBIT_RADIX_TREE_H
+#define MULTIBIT_RADIX_TREE_H
+
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <glog/logging.h>
+#include <folly/Bits.h>
+#include <folly/Conv.h>
+#include <folly/IPAddress.h>
+#include <folly/IPAddressV4.h>
+#include <folly/IPAddressV6.h>
+#include <folly/Optional.h>
+#include <folly/Range.h>
+
+namespace facebook { namespace network {
+
+/*
+ * Fixed size bitmap, which can count the bits set before a given bit.
+ */
+template<uint32_t BITS>
+class MultibitBitmap {
+ public:
+  bool test(uint32_t i) const {
+    return words_[i / 64] & (1ULL << (i % 64));
+  }
+  void set(uint32_t i) {
+    words_[i / 64] |= 1ULL << (i % 64);
+  }
+  void reset(uint32_t i) {
+    words_[i / 64] &= ~(1ULL << (i % 64));
+  }
+  // Number of bits set before bit i
+  uint32_t rank(uint32_t i) const {
+    uint32_t count = 0;
+    for (uint32_t word = 0; word < i / 64; ++word) {
+      count += folly::popcount(words_[word]);
+    }
+    if (i % 64) {
+      count += folly::popcount(words_[i / 64] & ((1ULL << (i % 64)) - 1));
+    }
+    return count;
+  }
+  uint32_t count() const {
+    return rank(BITS);
+  }
+  // Whether any bit in [begin, end) is set
+  bool any(uint32_t begin, uint32_t end) const {
+    return rank(end) != rank(begin);
+  }
+  bool none() const {
+    return count() == 0;
+  }
+
+ private:
+  uint64_t words_[(BITS + 63) / 64]{};
+};
+
+/*
+ * Contiguous storage for blocks of 1 to MAXBLOCK elements, each identified
+ * by the index of its first element. Freed blocks are reused for later
+ * blocks of the same size.
+ */
+template<typename E, uint32_t MAXBLOCK>
+class MultibitArena {
+ public:
+  uint32_t allocate(uint32_t n) {
+    DCHECK(n > 0 && n <= MAXBLOCK);
+    auto& freeBlocks = freeBlocks_[n - 1];
+    if (!freeBlocks.empty()) {
+      auto first = freeBlocks.back();
+      freeBlocks.pop_back();
+      return first;
+    }
+    uint32_t first = elements_.size();
+    elements_.resize(elements_.size() + n);
+    return first;
+  }
+  void free(uint32_t first, uint32_t n) {
+    freeBlocks_[n - 1].push_back(first);
+  }
+  E& operator[](uint32_t i) {
+    return elements_[i];
+  }
+  const E& operator[](uint32_t i) const {
+    return elements_[i];
+  }
+  void clear() {
+    std::vector<E>().swap(elements_);
+    for (auto& freeBlocks : freeBlocks_) {
+      std::vector<uint32_t>().swap(freeBlocks);
+    }
+  }
+  size_t memoryUsage() const {
+    auto bytes = elements_.capacity() * sizeof(E);
+    for (const auto& freeBlocks : freeBlocks_) {
+      bytes += freeBlocks.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+  }
+
+ private:
+  std::vector<E> elements_;
+  std::vector<uint32_t> freeBlocks_[MAXBLOCK];
+};
+
+// A position in a node of a MultibitRadixTree, see below
+struct MultibitRadixTreePosition {
+  uint32_t node;
+  uint32_t pos;
+  bool operator==(const MultibitRadixTreePosition& r) const {
+    return node == r.node && pos == r.pos;
+  }
+};
+
+/*
+ * Forward Iterator over a MultibitRadixTree, visiting prefixes in the same
+ * (DFS/preorder) order as RadixTreeIterator.
+ *
+ * An iterator holds the path from the root to its prefix, so unlike
+ * RadixTree iterators these are invalidated by insert() and erase().
+ */
+template<typename TREE, typename VALUE>
+class MultibitRadixTreeIterator : public std::iterator<
+  std::forward_iterator_tag, MultibitRadixTreeIterator<TREE, VALUE>> {
+ public:
+  typedef typename std::remove_const<TREE>::type Tree;
+  typedef typename Tree::IPAddressType IPAddressType;
+
+  MultibitRadixTreeIterator() {}
+  // Make a const iterator from an iterator
+  template<typename OTHERTREE, typename OTHERVALUE>
+  explicit MultibitRadixTreeIterator(
+      const MultibitRadixTreeIterator<OTHERTREE, OTHERVALUE>& itr)
+    : tree_(itr.tree_), path_(itr.path_), ipAddress_(itr.ipAddress_),
+      masklen_(itr.masklen_) {}
+
+  MultibitRadixTreeIterator& operator++() {
+    checkDereference();
+    seek(true);
+    return *this;
+  }
+
+  MultibitRadixTreeIterator operator++(int) {
+    MultibitRadixTreeIterator tmp(*this);
+    ++(*this);
+    return tmp;
+  }
+
+  bool operator==(const MultibitRadixTreeIterator& r) const {
+    return path_ == r.path_;
+  }
+
+  bool operator!=(const MultibitRadixTreeIterator& r) const {
+    return !(*this == r);
+  }
+
+  const MultibitRadixTreeIterator& operator*() const {
+    checkDereference();
+    return *this;
+  }
+
+  const MultibitRadixTreeIterator* operator->() const {
+    checkDereference();
+    return this;
+  }
+
+  bool atEnd() const { return path_.empty(); }
+
+  VALUE& value() const {
+    checkDereference();
+    return tree_->valueAt(path_.back());
+  }
+
+  template<typename V>
+  void setValue(V&& newValue) const {
+    value() = std::forward<V>(newValue);
+  }
+
+  const IPAddressType& ipAddress() const {
+    checkDereference();
+    return ipAddress_;
+  }
+
+  uint8_t masklen() const {
+    checkDereference();
+    return masklen_;
+  }
+
+  std::string str(bool printValue = true) const {
+    auto nodeStr = folly::to<std::string>(ipAddress().str(), "/", masklen_);
+    if (printValue) {
+      nodeStr += folly::to<std::string>("(", value(), ")");
+    }
+    return nodeStr;
+  }
+
+  // Nodes without a prefix of their own are never visited, see
+  // MultibitRadixTree
+  bool includeNonValueNodes() const { return false; }
+
+  void reset() {
+    tree_ = nullptr;
+    path_.clear();
+  }
+
+ private:
+  friend Tree;
+  template<typename OTHERTREE, typename OTHERVALUE>
+  friend class MultibitRadixTreeIterator;
+
+  /*
+   * If atPrefix, path leads to a prefix in tree, otherwise the iterator
+   * moves to the first prefix at or after path in preorder.
+   */
+  MultibitRadixTreeIterator(TREE* tree,
+      std::vector<MultibitRadixTreePosition> path, bool atPrefix)
+    : tree_(tree), path_(std::move(path)) {
+    if (path_.empty()) {
+      return;
+    } else if (atPrefix) {
+      settle();
+    } else {
+      seek(false);
+    }
+  }
+
+  void checkDereference() const {
+    CHECK(!atEnd());
+  }
+  // Move to the next prefix, skipping the current position if visited
+  void seek(bool visited);
+  // Work out the address and mask of the prefix at path_
+  void settle();
+
+  TREE* tree_{nullptr};
+  std::vector<MultibitRadixTreePosition> path_;
+  IPAddressType ipAddress_;
+  uint8_t masklen_{0};
+};
+
+/*
+ * Radix tree with nodes of several bits, and the same API as RadixTree.
+ *
+ * Each node covers STRIDE bits of the address. It holds the prefixes whose
+ * length ends within those bits, and has up to 2^STRIDE children for the
+ * values of the bits. Within a node, the prefix with k of its bits
+ * (0 <= k < STRIDE) is at heap position (1 << k) | bits, so a lookup checks
+ * at most STRIDE positions per node, and goes down a node per STRIDE bits
+ * instead of a node per bit.
+ *
+ * Nodes store bitmaps of their prefixes and children, with the children
+ * kept together in one block of an arena and the values in another, as in
+ * a tree bitmap. A node is 24 bytes for a stride of 4, so the tree uses
+ * less memory per prefix than RadixTree, and far fewer heap allocations.
+ *
+ * Nodes with children but no prefixes are not prefixes of their own, and
+ * aren't visited by iterators. Where RadixTree's API mentions non value
+ * nodes (includeNonValueNodes in the lookups with trails), it is accepted
+ * and ignored.
+ *
+ * There is no path-compressed mode. A sparse prefix does leave a chain of
+ * such nodes with a single child each, e.g. eight of them above a lone /32
+ * at a stride of 4, and compression would fold each chain into one node.
+ * But every node would then have to store the bits it skips, up to 124 for
+ * a V6 prefix, which more than doubles the node, and lookups and updates
+ * would compare and split those bits at every node. Route tables are dense
+ * in their leading bits, where the chains are short, so this would cost
+ * more memory than it saves there. A larger STRIDE is the cheaper way to
+ * shorten the chains of a sparse table.
+ */
+template<typename IPADDRTYPE, typename T, uint32_t STRIDE = 4>
+class MultibitRadixTree {
+  static_assert(STRIDE == 1 || STRIDE == 2 || STRIDE == 4 || STRIDE == 8,
+      "The stride must divide 8");
+ public:
+  typedef IPADDRTYPE IPAddressType;
+  typedef MultibitRadixTreeIterator<MultibitRadixTree, T> Iterator;
+  typedef MultibitRadixTreeIterator<const MultibitRadixTree, const T>
+    ConstIterator;
+  typedef std::vector<ConstIterator> VecConstIterators;
+
+  MultibitRadixTree() {}
+  MultibitRadixTree(const MultibitRadixTree& r) = delete;
+  MultibitRadixTree& operator=(const MultibitRadixTree& r) = delete;
+  MultibitRadixTree(MultibitRadixTree&& r) noexcept {
+    *this = std::move(r);
+  }
+  MultibitRadixTree& operator=(MultibitRadixTree&& r) noexcept {
+    nodes_ = std::move(r.nodes_);
+    values_ = std::move(r.values_);
+    root_ = r.root_;
+    size_ = r.size_;
+    r.clear();
+    return *this;
+  }
+
+  Iterator begin() { return Iterator(this, rootPath(), false); }
+  Iterator end() { return Iterator(); }
+  ConstIterator begin() const { return ConstIterator(this, rootPath(), false); }
+  ConstIterator end() const { return ConstIterator(); }
+
+  // Free all nodes and clear the tree.
+  void clear() {
+    nodes_.clear();
+    values_.clear();
+    root_ = kNoNode;
+    size_ = 0;
+  }
+
+  // Clone this radix tree onto another
+  template <typename U = T>
+  typename std::enable_if<std::is_copy_constructible<U>::value,
+                          MultibitRadixTree>::type
+    clone() const {
+    static_assert(std::is_same<T, U>::value,
+        "clone template type must be the same as Radix tree value type");
+    MultibitRadixTree copy;
+    copy.nodes_ = nodes_;
+    copy.values_ = values_;
+    copy.root_ = root_;
+    copy.size_ = size_;
+    return copy;
+  }
+
+  /*
+   * Insert a IP, mask, value in tree. Returns inserted node, true
+   * if a node was inserted. If a node for IP, mask already existed
+   * in the tree we return that node, false.
+   */
+  template <typename VALUE>
+  std::pair<Iterator, bool> insert(const IPADDRTYPE& ipaddr,
+      uint8_t masklen, VALUE&& value);
+
+  // Erase a IP, mask
+  bool erase(const IPADDRTYPE& ipaddr, uint8_t masklen);
+
+  // Erase the prefix pointed to by an iterator
+  bool erase(const Iterator& itr) {
+    return !itr.atEnd() && erase(itr.ipAddress(), itr.masklen());
+  }
+
+  // Given a IP, mask return the longest prefix containing it
+  // NOTE: masklen is unsigned and must be <= ipaddr.bitCount()
+  ConstIterator longestMatch(const IPADDRTYPE& ipaddr,
+      uint8_t masklen) const {
+    auto foundExact = false;
+    return ConstIterator(this, matchImpl(ipaddr, masklen, foundExact), true);
+  }
+
+  Iterator longestMatch(const IPADDRTYPE& ipaddr, uint8_t masklen) {
+    auto foundExact = false;
+    return Iterator(this, matchImpl(ipaddr, masklen, foundExact), true);
+  }
+
+  // Given a IP, mask return the prefix matching it exactly
+  ConstIterator exactMatch(const IPADDRTYPE& ipaddr, uint8_t masklen) const {
+    auto foundExact = false;
+    auto path = matchImpl(ipaddr, masklen, foundExact);
+    return foundExact ? ConstIterator(this, std::move(path), true) : end();
+  }
+
+  Iterator exactMatch(const IPADDRTYPE& ipaddr, uint8_t masklen) {
+    auto foundExact = false;
+    auto path = matchImpl(ipaddr, masklen, foundExact);
+    return foundExact ? Iterator(this, std::move(path), true) : end();
+  }
+
+  /*
+   * Get longest match as with the longestMatch api, but in addition record
+   * all the prefixes containing IP, mask from the shortest to the match.
+   * The trail is modified only on a successful match.
+   */
+  ConstIterator longestMatchWithTrail(const IPADDRTYPE& ipaddr,
+      uint8_t masklen, VecConstIterators& trail,
+      bool /*includeNonValueNodes*/ = false) const {
+    auto foundExact = false;
+    VecConstIterators trailInternal;
+    auto path = matchImpl(ipaddr, masklen, foundExact, &trailInternal);
+    if (!path.empty()) {
+      trail.swap(trailInternal);
+    }
+    return ConstIterator(this, std::move(path), true);
+  }
+
+  Iterator longestMatchWithTrail(const IPADDRTYPE& ipaddr,
+      uint8_t masklen, VecConstIterators& trail,
+      bool /*includeNonValueNodes*/ = false) {
+    auto foundExact = false;
+    VecConstIterators trailInternal;
+    auto path = matchImpl(ipaddr, masklen, foundExact, &trailInternal);
+    if (!path.empty()) {
+      trail.swap(trailInternal);
+    }
+    return Iterator(this, std::move(path), true);
+  }
+
+  // Same as longestMatchWithTrail, but only if there is an exact match
+  ConstIterator exactMatchWithTrail(const IPADDRTYPE& ipaddr,
+      uint8_t masklen, VecConstIterators& trail,
+      bool /*includeNonValueNodes*/ = false) const {
+    auto foundExact = false;
+    VecConstIterators trailInternal;
+    auto path = matchImpl(ipaddr, masklen, foundExact, &trailInternal);
+    if (!foundExact) {
+      return end();
+    }
+    trail.swap(trailInternal);
+    return ConstIterator(this, std::move(path), true);
+  }
+
+  Iterator exactMatchWithTrail(const IPADDRTYPE& ipaddr,
+      uint8_t masklen, VecConstIterators& trail,
+      bool /*includeNonValueNodes*/ = false) {
+    auto foundExact = false;
+    VecConstIterators trailInternal;
+    auto path = matchImpl(ipaddr, masklen, foundExact, &trailInternal);
+    if (!foundExact) {
+      return end();
+    }
+    trail.swap(trailInternal);
+    return Iterator(this, std::move(path), true);
+  }
+
+  // Equality
+  bool operator==(const MultibitRadixTree& r) const;
+
+  // Inequality
+  bool operator!=(const MultibitRadixTree& r) const {
+    return !(*this == r);
+  }
+
+  size_t size() const { return size_; }
+
+  // Bytes used by the tree's nodes and values
+  size_t memoryUsage() const {
+    return nodes_.memoryUsage() + values_.memoryUsage();
+  }
+
+ private:
+  friend Iterator;
+  friend ConstIterator;
+  typedef MultibitRadixTreePosition Position;
+
+  static constexpr uint32_t kStride = STRIDE;
+  static constexpr uint32_t kFanout = 1 << STRIDE;
+  static constexpr uint32_t kNoNode = ~0U;
+
+  struct Node {
+    // Prefixes at each heap position, bit 0 is unused
+    MultibitBitmap<kFanout> prefixes;
+    // Children for each value of the node's bits
+    MultibitBitmap<kFanout> children;
+    // Index of the block of children in nodes_, in order of their bits
+    uint32_t firstChild{0};
+    // Index of the block of values in values_, in order of their position
+    uint32_t firstValue{0};
+  };
+
+  // The STRIDE bits of addr after the first depth * STRIDE bits
+  static uint32_t chunk(const IPADDRTYPE& addr, uint32_t depth) {
+    uint32_t bit = depth * STRIDE;
+    return (addr.bytes()[bit / 8] >> (8 - STRIDE - bit % 8)) & (kFanout - 1);
+  }
+  // Heap position of addr/masklen in the node at depth masklen / STRIDE
+  static uint32_t position(const IPADDRTYPE& addr, uint32_t masklen) {
+    uint32_t bits = masklen % STRIDE;
+    if (!bits) {
+      return 1;
+    }
+    return (1 << bits) |
+      (chunk(addr, masklen / STRIDE) >> (STRIDE - bits));
+  }
+  // Set the n bits at offset in bytes to value
+  static void setBits(uint8_t* bytes, uint32_t offset, uint32_t value,
+      uint32_t n) {
+    if (n) {
+      bytes[offset / 8] |= value << (8 - offset % 8 - n);
+    }
+  }
+
+  std::vector<Position> rootPath() const {
+    std::vector<Position> path;
+    if (root_ != kNoNode) {
+      path.push_back({root_, 1});
+    }
+    return path;
+  }
+
+  uint32_t childIndex(uint32_t node, uint32_t child) const {
+    const auto& n = nodes_[node];
+    return n.firstChild + n.children.rank(child);
+  }
+  bool hasPrefix(const Position& position) const {
+    return position.pos < kFanout &&
+      nodes_[position.node].prefixes.test(position.pos);
+  }
+  const T& valueAt(const Position& position) const {
+    const auto& n = nodes_[position.node];
+    return values_[n.firstValue + n.prefixes.rank(position.pos)].value();
+  }
+  T& valueAt(const Position& position) {
+    const auto& n = nodes_[position.node];
+    return values_[n.firstValue + n.prefixes.rank(position.pos)].value();
+  }
+
+  /*
+   * Positions in a node form a binary tree: 1 is the root, 2 * pos and
+   * 2 * pos + 1 are the children of pos, and positions from kFanout up are
+   * the node's child nodes. Returns the next position after pos in
+   * preorder with anything under it, or 0 if there is none.
+   */
+  uint32_t nextPosition(uint32_t node, uint32_t pos) const;
+  // Whether there are any prefixes or children under pos
+  bool nonEmpty(const Node& node, uint32_t pos) const;
+
+  /*
+   * Returns the path to the longest prefix containing ipaddr/masklen, or
+   * an empty path if there is none. Also record all the prefixes containing
+   * ipaddr/masklen in trail, if given.
+   */
+  std::vector<Position> matchImpl(const IPADDRTYPE& ipaddr, uint8_t masklen,
+      bool& foundExact, VecConstIterators* trail = nullptr) const;
+
+  // Add a child for the given bits to node, returning the child's index
+  uint32_t addChild(uint32_t node, uint32_t child);
+  void removeChild(uint32_t node, uint32_t child);
+  template <typename VALUE>
+  void addValue(uint32_t node, uint32_t pos, VALUE&& value);
+  void removeValue(uint32_t node, uint32_t pos);
+
+  MultibitArena<Node, kFanout> nodes_;
+  MultibitArena<folly::Optional<T>, kFanout - 1> values_;
+  uint32_t root_{kNoNode};
+  size_t size_{0};
+};
+
+/*
+ * Iterator over a composite MultibitRadixTree of folly::IPAddress, which
+ * visits the V4 prefixes and then the V6 ones.
+ */
+template<typename ITERATOR4, typename ITERATOR6, typename VALUE>
+class MultibitIPAddressRadixTreeIterator : public std::iterator<
+  std::forward_iterator_tag,
+  MultibitIPAddressRadixTreeIterator<ITERATOR4, ITERATOR6, VALUE>> {
+ public:
+  typedef ITERATOR4 Iterator4;
+  typedef ITERATOR6 Iterator6;
+
+  MultibitIPAddressRadixTreeIterator() {}
+  MultibitIPAddressRadixTreeIterator(ITERATOR4 iterator4,
+      ITERATOR6 iterator6)
+    : iterator4_(std::move(iterator4)), iterator6_(std::move(iterator6)) {}
+  // Make a const iterator from an iterator
+  template<typename OTHER4, typename OTHER6, typename OTHERVALUE>
+  explicit MultibitIPAddressRadixTreeIterator(
+      const MultibitIPAddressRadixTreeIterator<OTHER4, OTHER6, OTHERVALUE>&
+      itr)
+    : iterator4_(itr.iterator4()), iterator6_(itr.iterator6()) {}
+
+  MultibitIPAddressRadixTreeIterator& operator++() {
+    checkDereference();
+    if (!iterator4_.atEnd()) {
+      ++iterator4_;
+    } else {
+      ++iterator6_;
+    }
+    return *this;
+  }
+
+  MultibitIPAddressRadixTreeIterator operator++(int) {
+    MultibitIPAddressRadixTreeIterator tmp(*this);
+    ++(*this);
+    return tmp;
+  }
+
+  bool operator==(const MultibitIPAddressRadixTreeIterator& r) const {
+    return iterator4_ == r.iterator4_ && iterator6_ == r.iterator6_;
+  }
+
+  bool operator!=(const MultibitIPAddressRadixTreeIterator& r) const {
+    return !(*this == r);
+  }
+
+  const MultibitIPAddressRadixTreeIterator& operator*() const {
+    checkDereference();
+    return *this;
+  }
+
+  const MultibitIPAddressRadixTreeIterator* operator->() const {
+    checkDereference();
+    return this;
+  }
+
+  bool atEnd() const { return iterator4_.atEnd() && iterator6_.atEnd(); }
+
+  VALUE& value() const {
+    checkDereference();
+    return !iterator4_.atEnd() ? iterator4_.value() : iterator6_.value();
+  }
+
+  template<typename V>
+  void setValue(V&& newValue) const {
+    value() = std::forward<V>(newValue);
+  }
+
+  folly::IPAddress ipAddress() const {
+    checkDereference();
+    if (!iterator4_.atEnd()) {
+      return folly::IPAddress(iterator4_.ipAddress());
+    }
+    return folly::IPAddress(iterator6_.ipAddress());
+  }
+
+  uint8_t masklen() const {
+    checkDereference();
+    return !iterator4_.atEnd() ? iterator4_.masklen() : iterator6_.masklen();
+  }
+
+  std::string str(bool printValue = true) const {
+    checkDereference();
+    return !iterator4_.atEnd() ? iterator4_.str(printValue) :
+      iterator6_.str(printValue);
+  }
+
+  bool includeNonValueNodes() const { return false; }
+
+  void reset() {
+    iterator4_.reset();
+    iterator6_.reset();
+  }
+
+  const ITERATOR4& iterator4() const { return iterator4_; }
+  const ITERATOR6& iterator6() const { return iterator6_; }
+
+ private:
+  void checkDereference() const {
+    CHECK(!atEnd());
+  }
+
+  ITERATOR4 iterator4_;
+  ITERATOR6 iterator6_;
+};
+
+// Template specialization for MultibitRadixTree of folly::IPAddress
+template<typename T, uint32_t STRIDE>
+class MultibitRadixTree<folly::IPAddress, T, STRIDE> {
+ public:
+  typedef MultibitRadixTree<folly::IPAddressV4, T, STRIDE> Tree4;
+  typedef MultibitRadixTree<folly::IPAddressV6, T, STRIDE> Tree6;
+  typedef MultibitIPAddressRadixTreeIterator<typename Tree4::Iterator,
+          typename Tree6::Iterator, T> Iterator;
+  typedef MultibitIPAddressRadixTreeIterator<typename Tree4::ConstIterator,
+          typename Tree6::ConstIterator, const T> ConstIterator;
+  typedef std::vector<ConstIterator> VecConstIterators;
+
+  MultibitRadixTree() {}
+  MultibitRadixTree(MultibitRadixTree&& r) noexcept = default;
+  MultibitRadixTree& operator=(MultibitRadixTree&& r) noexcept = default;
+  MultibitRadixTree(const MultibitRadixTree& r) = delete;
+  MultibitRadixTree& operator=(const MultibitRadixTree& r) = delete;
+
+  bool operator==(const MultibitRadixTree& r) const {
+    return ipv4Tree_ == r.ipv4Tree_ && ipv6Tree_ == r.ipv6Tree_;
+  }
+
+  bool operator!=(const MultibitRadixTree& r) const {
+    return !(*this == r);
+  }
+
+  template <typename U = T>
+  typename std::enable_if<std::is_copy_constructible<U>::value,
+                          MultibitRadixTree>::type
+    clone() const {
+    static_assert(std::is_same<T, U>::value,
+        "clone template type must be the same as Radix tree value type");
+    MultibitRadixTree r;
+    r.ipv4Tree_ = ipv4Tree_.clone();
+    r.ipv6Tree_ = ipv6Tree_.clone();
+    return r;
+  }
+
+  /*
+   * Iteration for the combined tree begins at V4 tree and then
+   * rolls on to V6 tree.
+   */
+  Iterator begin() {
+    return Iterator(ipv4Tree_.begin(), ipv6Tree_.begin());
+  }
+  Iterator end() {
+    return Iterator(ipv4Tree_.end(), ipv6Tree_.end());
+  }
+  ConstIterator begin() const {
+    return ConstIterator(ipv4Tree_.begin(), ipv6Tree_.begin());
+  }
+  ConstIterator end() const {
+    return ConstIterator(ipv4Tree_.end(), ipv6Tree_.end());
+  }
+
+  // Free all nodes and clear the tree.
+  void clear() {
+    ipv4Tree_.clear();
+    ipv6Tree_.clear();
+  }
+
+  size_t size() const { return ipv4Tree_.size() + ipv6Tree_.size(); }
+  size_t size4() const { return ipv4Tree_.size(); }
+  size_t size6() const { return ipv6Tree_.size(); }
+  size_t memoryUsage() const {
+    return ipv4Tree_.memoryUsage() + ipv6Tree_.memoryUsage();
+  }
+
+  template <typename VALUE>
+  std::pair<Iterator, bool> insert(const folly::IPAddress& ipaddr,
+      uint8_t masklen, VALUE&& value) {
+    if (ipaddr.isV4()) {
+      auto inserted = ipv4Tree_.insert(ipaddr.asV4(), masklen,
+          std::forward<VALUE>(value));
+      return std::make_pair(make4(std::move(inserted.first)),
+          inserted.second);
+    }
+    auto inserted = ipv6Tree_.insert(ipaddr.asV6(), masklen,
+        std::forward<VALUE>(value));
+    return std::make_pair(make6(std::move(inserted.first)), inserted.second);
+  }
+
+  bool erase(const folly::IPAddress& ipaddr, uint8_t masklen) {
+    if (ipaddr.isV4()) {
+      return ipv4Tree_.erase(ipaddr.asV4(), masklen);
+    }
+    return ipv6Tree_.erase(ipaddr.asV6(), masklen);
+  }
+
+  bool erase(const Iterator& itr) {
+    return !itr.atEnd() && erase(itr.ipAddress(), itr.masklen());
+  }
+
+  ConstIterator longestMatch(const folly::IPAddress& ipaddr,
+      uint8_t masklen) const {
+    if (ipaddr.isV4()) {
+      return make4(ipv4Tree_.longestMatch(ipaddr.asV4(), masklen));
+    }
+    return make6(ipv6Tree_.longestMatch(ipaddr.asV6(), masklen));
+  }
+
+  Iterator longestMatch(const folly::IPAddress& ipaddr, uint8_t masklen) {
+    if (ipaddr.isV4()) {
+      return make4(ipv4Tree_.longestMatch(ipaddr.asV4(), masklen));
+    }
+    return make6(ipv6Tree_.longestMatch(ipaddr.asV6(), masklen));
+  }
+
+  ConstIterator exactMatch(const folly::IPAddress& ipaddr,
+      uint8_t masklen) const {
+    if (ipaddr.isV4()) {
+      return make4(ipv4Tree_.exactMatch(ipaddr.asV4(), masklen));
+    }
+    return make6(ipv6Tree_.exactMatch(ipaddr.asV6(), masklen));
+  }
+
+  Iterator exactMatch(const folly::IPAddress& ipaddr, uint8_t masklen) {
+    if (ipaddr.isV4()) {
+      return make4(ipv4Tree_.exactMatch(ipaddr.asV4(), masklen));
+    }
+    return make6(ipv6Tree_.exactMatch(ipaddr.asV6(), masklen));
+  }
+
+  ConstIterator longestMatchWithTrail(const folly::IPAddress& ipaddr,
+      uint8_t masklen, VecConstIterators& trail,
+      bool includeNonValueNodes = false) const {
+    if (ipaddr.isV4()) {
+      typename Tree4::VecConstIterators trail4;
+      auto match = make4(ipv4Tree_.longestMatchWithTrail(ipaddr.asV4(),
+            masklen, trail4, includeNonValueNodes));
+      setTrail(trail4, &trail);
+      return match;
+    }
+    typename Tree6::VecConstIterators trail6;
+    auto match = make6(ipv6Tree_.longestMatchWithTrail(ipaddr.asV6(),
+          masklen, trail6, includeNonValueNodes));
+    setTrail(trail6, &trail);
+    return match;
+  }
+
+  Iterator longestMatchWithTrail(const folly::IPAddress& ipaddr,
+      uint8_t masklen, VecConstIterators& trail,
+      bool includeNonValueNodes = false) {
+    if (ipaddr.isV4()) {
+      typename Tree4::VecConstIterators trail4;
+      auto match = make4(ipv4Tree_.longestMatchWithTrail(ipaddr.asV4(),
+            masklen, trail4, includeNonValueNodes));
+      setTrail(trail4, &trail);
+      return match;
+    }
+    typename Tree6::VecConstIterators trail6;
+    auto match = make6(ipv6Tree_.longestMatchWithTrail(ipaddr.asV6(),
+          masklen, trail6, includeNonValueNodes));
+    setTrail(trail6, &trail);
+    return match;
+  }
+
+  ConstIterator exactMatchWithTrail(const folly::IPAddress& ipaddr,
+      uint8_t masklen, VecConstIterators& trail,
+      bool includeNonValueNodes = false) const {
+    if (ipaddr.isV4()) {
+      typename Tree4::VecConstIterators trail4;
+      auto match = make4(ipv4Tree_.exactMatchWithTrail(ipaddr.asV4(),
+            masklen, trail4, includeNonValueNodes));
+      setTrail(trail4, &trail);
+      return match;
+    }
+    typename Tree6::VecConstIterators trail6;
+    auto match = make6(ipv6Tree_.exactMatchWithTrail(ipaddr.asV6(),
+          masklen, trail6, includeNonValueNodes));
+    setTrail(trail6, &trail);
+    return match;
+  }
+
+  Iterator exactMatchWithTrail(const folly::IPAddress& ipaddr,
+      uint8_t masklen, VecConstIterators& trail,
+      bool includeNonValueNodes = false) {
+    if (ipaddr.isV4()) {
+      typename Tree4::VecConstIterators trail4;
+      auto match = make4(ipv4Tree_.exactMatchWithTrail(ipaddr.asV4(),
+            masklen, trail4, includeNonValueNodes));
+      setTrail(trail4, &trail);
+      return match;
+    }
+    typename Tree6::VecConstIterators trail6;
+    auto match = make6(ipv6Tree_.exactMatchWithTrail(ipaddr.asV6(),
+          masklen, trail6, includeNonValueNodes));
+    setTrail(trail6, &trail);
+    return match;
+  }
+
+  const Tree4& ipv4Tree() const { return ipv4Tree_; }
+  const Tree6& ipv6Tree() const { return ipv6Tree_; }
+
+ private:
+  /*
+   * A V4 result continues into the V6 tree when incremented, as with
+   * RadixTree. Results not found are end().
+   */
+  ConstIterator make4(typename Tree4::ConstIterator itr) const {
+    if (itr.atEnd()) {
+      return end();
+    }
+    return ConstIterator(std::move(itr), ipv6Tree_.begin());
+  }
+  Iterator make4(typename Tree4::Iterator itr) {
+    if (itr.atEnd()) {
+      return end();
+    }
+    return Iterator(std::move(itr), ipv6Tree_.begin());
+  }
+  ConstIterator make6(typename Tree6::ConstIterator itr) const {
+    return ConstIterator(ipv4Tree_.end(), std::move(itr));
+  }
+  Iterator make6(typename Tree6::Iterator itr) {
+    return Iterator(ipv4Tree_.end(), std::move(itr));
+  }
+
+  void setTrail(const typename Tree4::VecConstIterators& from,
+      VecConstIterators* to) const {
+    if (!from.empty()) {
+      to->clear();
+      for (const auto& itr : from) {
+        to->push_back(ConstIterator(itr, ipv6Tree_.begin()));
+      }
+    }
+  }
+  void setTrail(const typename Tree6::VecConstIterators& from,
+      VecConstIterators* to) const {
+    if (!from.empty()) {
+      to->clear();
+      for (const auto& itr : from) {
+        to->push_back(ConstIterator(ipv4Tree_.end(), itr));
+      }
+    }
+  }
+
+  Tree4 ipv4Tree_;
+  Tree6 ipv6Tree_;
+};
+
+}} // facebook::network
+
+#include "MultibitRadixTree-inl.h"
+
+#endif // MULTIBIT_RADIX_TREE_H
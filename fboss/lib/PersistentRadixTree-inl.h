@@ -0,0 +1,469 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#ifndef PERSISTENT_RADIX_TREE_H
+#error "This should only be included by PersistentRadixTree.h"
+#endif
+
+namespace facebook { namespace network {
+
+template<typename IPADDRTYPE, typename T>
+typename PersistentRadixTreeNode<IPADDRTYPE, T>::TreeDirection
+PersistentRadixTreeNode<IPADDRTYPE, T>::searchDirection(
+    const IPADDRTYPE& toSearch, uint8_t toSearchMasklen) const {
+  if (masklen_ < toSearchMasklen) {
+    // My masklen is less than what is being searched, we are searching
+    // a more specific address.
+    if (toSearch.mask(masklen_) == ipAddress_) {
+      // All the bits up to my bit length match, check the next bit
+      // Note that bit lookup is 0 indexed.
+      return toSearch.getNthMSBit(masklen_) == 1 ? TreeDirection::RIGHT :
+        TreeDirection::LEFT;
+    }
+    // Bits upto my mask len don't match.
+    return TreeDirection::PARENT;
+  }
+  if (masklen_ == toSearchMasklen && ipAddress_ == toSearch) {
+    return TreeDirection::THIS_NODE;
+  }
+  // Either masklen were equal but the addresses did not match or my
+  // mask len was greater than to be searched prefix.
+  return TreeDirection::PARENT;
+}
+
+template<typename IPADDRTYPE, typename T>
+void PersistentRadixTreeIterator<IPADDRTYPE, T>::increment() {
+  do {
+    auto cursor = path_.back();
+    if (cursor->left()) {
+      // Going down the tree
+      path_.push_back(cursor->left());
+    } else if (cursor->right()) {
+      path_.push_back(cursor->right());
+    } else {
+      // Leaf, go up till we find a ancestor whose right subtree
+      // we have not visited yet.
+      path_.pop_back();
+      while (!path_.empty()) {
+        auto parent = path_.back();
+        if (parent->left() == cursor && parent->right()) {
+          path_.push_back(parent->right());
+          break;
+        }
+        cursor = parent;
+        path_.pop_back();
+      }
+    }
+  } while (!path_.empty() && !includeNonValueNodes_ &&
+      path_.back()->isNonValueNode());
+}
+
+template<typename IPADDRTYPE, typename T>
+const typename PersistentRadixTree<IPADDRTYPE, T>::TreeNode*
+PersistentRadixTree<IPADDRTYPE, T>::longestMatchImpl(const IPADDRTYPE& ipaddr,
+    uint8_t masklen, bool& foundExact,
+    std::vector<const TreeNode*>* path) const {
+  const TreeNode* lastValueNodeSeen = nullptr;
+  size_t lastValueNodeDepth = 0;
+  auto curNode = root_.get();
+  while (curNode) {
+    auto searchDirection = curNode->searchDirection(ipaddr, masklen);
+    if (searchDirection == TreeDirection::PARENT) {
+      // We took one extra step in the hope of getting a better
+      // match but this didn't succeed.
+      break;
+    }
+    if (path) {
+      path->push_back(curNode);
+    }
+    if (curNode->isValueNode()) {
+      lastValueNodeSeen = curNode;
+      lastValueNodeDepth = path ? path->size() : 0;
+    }
+    if (searchDirection == TreeDirection::THIS_NODE) {
+      foundExact = curNode->isValueNode();
+      break;
+    }
+    curNode = curNode->child(searchDirection).get();
+  }
+  if (path) {
+    // Trim the path so that it ends at the match
+    path->resize(lastValueNodeDepth);
+  }
+  return lastValueNodeSeen;
+}
+
+template<typename IPADDRTYPE, typename T>
+typename PersistentRadixTree<IPADDRTYPE, T>::ConstIterator
+PersistentRadixTree<IPADDRTYPE, T>::lookup(const IPADDRTYPE& ipaddr,
+    uint8_t masklen, bool& foundExact) const {
+  std::vector<const TreeNode*> path;
+  path.reserve(IPADDRTYPE::bitCount() + 1);
+  if (!longestMatchImpl(ipaddr, masklen, foundExact, &path)) {
+    return end();
+  }
+  return ConstIterator(std::move(path), false);
+}
+
+template<typename IPADDRTYPE, typename T>
+const typename PersistentRadixTree<IPADDRTYPE, T>::TreeNode*
+PersistentRadixTree<IPADDRTYPE, T>::subTreeNode(const IPADDRTYPE& ipaddr,
+    uint8_t masklen) const {
+  auto toSearch = ipaddr.mask(masklen);
+  auto curNode = root_.get();
+  while (curNode) {
+    auto searchDirection = curNode->searchDirection(toSearch, masklen);
+    if (searchDirection == TreeDirection::THIS_NODE) {
+      return curNode;
+    }
+    if (searchDirection == TreeDirection::PARENT) {
+      // Either curNode is more specific than what we are looking for, and
+      // so is everything below it, or the two don't overlap at all.
+      if (curNode->masklen() > masklen &&
+          curNode->ipAddress().mask(masklen) == toSearch) {
+        return curNode;
+      }
+      return nullptr;
+    }
+    curNode = curNode->child(searchDirection).get();
+  }
+  return nullptr;
+}
+
+template<typename IPADDRTYPE, typename T>
+typename PersistentRadixTree<IPADDRTYPE, T>::NodePtr
+PersistentRadixTree<IPADDRTYPE, T>::joinSubTrees(NodePtr existing,
+    NodePtr newNode) const {
+  auto prefix = IPADDRTYPE::longestCommonPrefix(
+      {existing->ipAddress(), existing->masklen()},
+      {newNode->ipAddress(), newNode->masklen()});
+  NodePtr parent;
+  if (prefix.first == newNode->ipAddress() &&
+      prefix.second == newNode->masklen()) {
+    // New node is less specific than existing, it becomes the parent
+    parent = std::move(newNode);
+  } else {
+    // Add a non value internal node as parent of both
+    parent = std::make_shared<TreeNode>(prefix.first, prefix.second);
+    auto newNodeDirection = parent->searchDirection(newNode.get());
+    CHECK(newNodeDirection == TreeDirection::LEFT ||
+        newNodeDirection == TreeDirection::RIGHT);
+    parent->child(newNodeDirection) = std::move(newNode);
+  }
+  auto existingDirection = parent->searchDirection(existing.get());
+  CHECK(existingDirection == TreeDirection::LEFT ||
+      existingDirection == TreeDirection::RIGHT);
+  DCHECK(!parent->child(existingDirection));
+  parent->child(existingDirection) = std::move(existing);
+  return parent;
+}
+
+/*
+ * Insert below node, node's prefix must cover ipaddr/masklen.
+ * Returns the node to use in place of node, which is node itself if
+ * nothing changed or if node was modified in place.
+ */
+template<typename IPADDRTYPE, typename T>
+template<typename VALUE>
+typename PersistentRadixTree<IPADDRTYPE, T>::NodePtr
+PersistentRadixTree<IPADDRTYPE, T>::insertImpl(const NodePtr& node,
+    bool exclusive, const IPADDRTYPE& ipaddr, uint8_t masklen, VALUE&& value,
+    const TreeNode** inserted, bool* added) {
+  auto direction = node->searchDirection(ipaddr, masklen);
+  DCHECK(direction != TreeDirection::PARENT);
+  if (direction == TreeDirection::THIS_NODE) {
+    if (node->isValueNode()) {
+      // Prefix already exists in the tree
+      *inserted = node.get();
+      return node;
+    }
+    auto newNode = writable(node, exclusive);
+    newNode->value_ = std::forward<VALUE>(value);
+    *inserted = newNode.get();
+    *added = true;
+    return newNode;
+  }
+  const auto& child = node->child(direction);
+  NodePtr newChild;
+  if (!child) {
+    newChild = std::make_shared<TreeNode>(ipaddr, masklen,
+        std::forward<VALUE>(value));
+    *inserted = newChild.get();
+    *added = true;
+  } else if (child->searchDirection(ipaddr, masklen) !=
+      TreeDirection::PARENT) {
+    newChild = insertImpl(child, exclusiveChild(exclusive, child), ipaddr,
+        masklen, std::forward<VALUE>(value), inserted, added);
+  } else {
+    // New prefix does not fall under child, so we need to either
+    // put the new node b/w node and child, or add a internal node
+    // as the parent of both.
+    auto newNode = std::make_shared<TreeNode>(ipaddr, masklen,
+        std::forward<VALUE>(value));
+    *inserted = newNode.get();
+    *added = true;
+    newChild = joinSubTrees(child, std::move(newNode));
+  }
+  if (newChild == child) {
+    return node;
+  }
+  auto newNode = writable(node, exclusive);
+  newNode->child(direction) = std::move(newChild);
+  return newNode;
+}
+
+template<typename IPADDRTYPE, typename T>
+template<typename VALUE>
+std::pair<typename PersistentRadixTree<IPADDRTYPE, T>::ConstIterator, bool>
+PersistentRadixTree<IPADDRTYPE, T>::insert(const IPADDRTYPE& ipaddr,
+    uint8_t masklen, VALUE&& value) {
+  // Can't trust the clients to have 0s in all bits after mask length
+  auto toAdd = ipaddr.mask(masklen);
+  const TreeNode* inserted = nullptr;
+  bool added = false;
+  if (!root_) {
+    root_ = std::make_shared<TreeNode>(toAdd, masklen,
+        std::forward<VALUE>(value));
+    added = true;
+  } else if (root_->searchDirection(toAdd, masklen) ==
+      TreeDirection::PARENT) {
+    // The root exists but this ipaddr, mask failed to match even the
+    // root->ipaddr/mask. We need a less specific root.
+    root_ = joinSubTrees(root_, std::make_shared<TreeNode>(toAdd, masklen,
+          std::forward<VALUE>(value)));
+    added = true;
+  } else {
+    root_ = insertImpl(root_, exclusiveRoot(), toAdd, masklen,
+        std::forward<VALUE>(value), &inserted, &added);
+  }
+  if (added) {
+    ++size_;
+  }
+  return std::make_pair(exactMatch(toAdd, masklen), added);
+}
+
+template<typename IPADDRTYPE, typename T>
+template<typename VALUE>
+typename PersistentRadixTree<IPADDRTYPE, T>::NodePtr
+PersistentRadixTree<IPADDRTYPE, T>::updateImpl(const NodePtr& node,
+    bool exclusive, const IPADDRTYPE& ipaddr, uint8_t masklen, VALUE&& value,
+    bool* updated) {
+  if (!node) {
+    return node;
+  }
+  auto direction = node->searchDirection(ipaddr, masklen);
+  if (direction == TreeDirection::PARENT) {
+    return node;
+  }
+  if (direction == TreeDirection::THIS_NODE) {
+    if (node->isNonValueNode()) {
+      return node;
+    }
+    auto newNode = writable(node, exclusive);
+    newNode->value_ = std::forward<VALUE>(value);
+    *updated = true;
+    return newNode;
+  }
+  const auto& child = node->child(direction);
+  auto newChild = updateImpl(child, exclusiveChild(exclusive, child), ipaddr,
+      masklen, std::forward<VALUE>(value), updated);
+  if (newChild == child) {
+    return node;
+  }
+  auto newNode = writable(node, exclusive);
+  newNode->child(direction) = std::move(newChild);
+  return newNode;
+}
+
+template<typename IPADDRTYPE, typename T>
+template<typename VALUE>
+bool PersistentRadixTree<IPADDRTYPE, T>::update(const IPADDRTYPE& ipaddr,
+    uint8_t masklen, VALUE&& value) {
+  bool updated = false;
+  root_ = updateImpl(root_, exclusiveRoot(), ipaddr.mask(masklen),
+      masklen, std::forward<VALUE>(value), &updated);
+  return updated;
+}
+
+/*
+ * As with RadixTree, all non value nodes must have 2 children before and
+ * after erase. Erasing a value node with 2 children turns it into a non
+ * value node, erasing one with a single child replaces it with that child
+ * and erasing a leaf may leave its non value parent with a single child,
+ * in which case the parent is replaced by the leaf's sibling.
+ */
+template<typename IPADDRTYPE, typename T>
+typename PersistentRadixTree<IPADDRTYPE, T>::NodePtr
+PersistentRadixTree<IPADDRTYPE, T>::eraseImpl(const NodePtr& node,
+    bool exclusive, const IPADDRTYPE& ipaddr, uint8_t masklen, bool* erased) {
+  if (!node) {
+    return node;
+  }
+  auto direction = node->searchDirection(ipaddr, masklen);
+  if (direction == TreeDirection::PARENT) {
+    return node;
+  }
+  if (direction == TreeDirection::THIS_NODE) {
+    if (node->isNonValueNode()) {
+      return node;
+    }
+    *erased = true;
+    if (node->left_ && node->right_) {
+      auto newNode = writable(node, exclusive);
+      newNode->value_.clear();
+      return newNode;
+    }
+    return node->left_ ? node->left_ : node->right_;
+  }
+  const auto& child = node->child(direction);
+  auto newChild = eraseImpl(child, exclusiveChild(exclusive, child), ipaddr,
+      masklen, erased);
+  if (!*erased) {
+    return node;
+  }
+  if (!newChild && node->isNonValueNode()) {
+    // node would be left with a single child, let node's parent
+    // adopt the remaining child instead.
+    return node->child(direction == TreeDirection::LEFT ?
+        TreeDirection::RIGHT : TreeDirection::LEFT);
+  }
+  if (newChild == child) {
+    return node;
+  }
+  auto newNode = writable(node, exclusive);
+  newNode->child(direction) = std::move(newChild);
+  return newNode;
+}
+
+template<typename IPADDRTYPE, typename T>
+bool PersistentRadixTree<IPADDRTYPE, T>::erase(const IPADDRTYPE& ipaddr,
+    uint8_t masklen) {
+  bool erased = false;
+  root_ = eraseImpl(root_, exclusiveRoot(), ipaddr.mask(masklen),
+      masklen, &erased);
+  if (erased) {
+    --size_;
+  }
+  return erased;
+}
+
+template<typename IPADDRTYPE, typename T>
+template<typename Fn>
+size_t PersistentRadixTree<IPADDRTYPE, T>::freeze(Fn&& fn) {
+  size_t visited = 0;
+  std::vector<TreeNode*> toVisit;
+  if (root_ && !root_->frozen_) {
+    toVisit.push_back(root_.get());
+  }
+  while (!toVisit.empty()) {
+    auto node = toVisit.back();
+    toVisit.pop_back();
+    ++visited;
+    node->frozen_ = true;
+    if (node->isValueNode()) {
+      fn(node->value());
+    }
+    for (auto child : {node->left_.get(), node->right_.get()}) {
+      if (child && !child->frozen_) {
+        toVisit.push_back(child);
+      }
+    }
+  }
+  return visited;
+}
+
+template<typename IPADDRTYPE, typename T>
+bool PersistentRadixTree<IPADDRTYPE, T>::radixSubTreesEqual(
+    const TreeNode* nodeA, const TreeNode* nodeB) {
+  if (nodeA == nodeB) {
+    // Shared (or both empty) sub trees
+    return true;
+  }
+  if (nodeA && nodeB) {
+    if (nodeA->equalSansLinks(*nodeB)) {
+      return radixSubTreesEqual(nodeA->left(), nodeB->left()) &&
+        radixSubTreesEqual(nodeA->right(), nodeB->right());
+    }
+  }
+  return false;
+}
+
+template<typename IPADDRTYPE, typename T>
+void PersistentRadixTreeDelta<IPADDRTYPE, T>::Iterator::visitChildren(
+    const TreeNode* parent, TreeDirection direction,
+    const TreeNode* subTree, bool parentIsOld) {
+  // Push right before left so that we walk in the same order as
+  // PersistentRadixTreeIterator
+  auto right = direction == TreeDirection::RIGHT ? subTree : nullptr;
+  auto left = direction == TreeDirection::LEFT ? subTree : nullptr;
+  if (parentIsOld) {
+    visit(parent->right(), right);
+    visit(parent->left(), left);
+  } else {
+    visit(right, parent->right());
+    visit(left, parent->left());
+  }
+}
+
+template<typename IPADDRTYPE, typename T>
+void PersistentRadixTreeDelta<IPADDRTYPE, T>::Iterator::increment() {
+  oldNode_ = newNode_ = nullptr;
+  while (!toVisit_.empty()) {
+    auto oldSubTree = toVisit_.back().first;
+    auto newSubTree = toVisit_.back().second;
+    toVisit_.pop_back();
+    if (oldSubTree == newSubTree) {
+      // Shared by both trees (or both empty), nothing changed below here
+      continue;
+    }
+    if (!oldSubTree || !newSubTree) {
+      // Whole subtree was added or removed
+      auto subTree = oldSubTree ? oldSubTree : newSubTree;
+      visitChildren(subTree, TreeDirection::PARENT, nullptr, oldSubTree);
+      if (subTree->isValueNode()) {
+        oldNode_ = oldSubTree;
+        newNode_ = newSubTree;
+        return;
+      }
+      continue;
+    }
+    auto direction = oldSubTree->searchDirection(newSubTree);
+    if (direction == TreeDirection::THIS_NODE) {
+      // Same prefix in both trees, compare values and then the children
+      visit(oldSubTree->right(), newSubTree->right());
+      visit(oldSubTree->left(), newSubTree->left());
+      if (oldSubTree->isNonValueNode() && newSubTree->isNonValueNode()) {
+        continue;
+      }
+      if (oldSubTree->isValueNode() && newSubTree->isValueNode() &&
+          oldSubTree->value() == newSubTree->value()) {
+        continue;
+      }
+      oldNode_ = oldSubTree->isValueNode() ? oldSubTree : nullptr;
+      newNode_ = newSubTree->isValueNode() ? newSubTree : nullptr;
+      return;
+    }
+    if (direction != TreeDirection::PARENT) {
+      // New subtree lies under the old subtree root, which is gone
+      visitChildren(oldSubTree, direction, newSubTree, true);
+      if (oldSubTree->isValueNode()) {
+        oldNode_ = oldSubTree;
+        return;
+      }
+      continue;
+    }
+    direction = newSubTree->searchDirection(oldSubTree);
+    if (direction != TreeDirection::PARENT) {
+      // Old subtree lies under the new subtree root, which was added
+      visitChildren(newSubTree, direction, oldSubTree, false);
+      if (newSubTree->isValueNode()) {
+        newNode_ = newSubTree;
+        return;
+      }
+      continue;
+    }
+    // Disjoint subtrees
+    visit(nullptr, newSubTree);
+    visit(oldSubTree, nullptr);
+  }
+}
+
+}} //facebook::network
@@ -0,0 +1,519 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#ifndef PERSISTENT_RADIX_TREE_H
+#define PERSISTENT_RADIX_TREE_H
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glog/logging.h>
+#include <folly/Conv.h>
+#include <folly/Optional.h>
+#include <folly/IPAddressV4.h>
+#include <folly/IPAddressV6.h>
+
+namespace facebook { namespace network {
+
+template<typename IPADDRTYPE, typename T>
+class PersistentRadixTree;
+
+/*
+ * Node in a PersistentRadixTree. Same shape as RadixTreeNode (IP, mask,
+ * optional value, all non value nodes have 2 children), but children are
+ * held by shared_ptr and there is no parent pointer, so that a node
+ * can be shared between many versions of the tree.
+ *
+ * Nodes reachable from more than one tree are immutable. Only the owning
+ * PersistentRadixTree may modify a node, and it does so only when it can
+ * prove that the node is not reachable from any other tree.
+ */
+template<typename IPADDRTYPE, typename T>
+class PersistentRadixTreeNode {
+ public:
+  typedef std::shared_ptr<PersistentRadixTreeNode> NodePtr;
+  enum class TreeDirection { LEFT, RIGHT, PARENT, THIS_NODE};
+
+  PersistentRadixTreeNode(const IPADDRTYPE& ipAddr, uint8_t mlen):
+    ipAddress_(ipAddr), masklen_(mlen) {}
+
+  template<typename VALUE>
+  PersistentRadixTreeNode(const IPADDRTYPE& ipAddr, uint8_t mlen,
+      VALUE&& val): ipAddress_(ipAddr), masklen_(mlen),
+  value_(std::forward<VALUE>(val)) {}
+
+  // Shallow copy, children are shared with the original node. The copy is
+  // not frozen, whether or not the original is.
+  PersistentRadixTreeNode(const PersistentRadixTreeNode& r):
+    ipAddress_(r.ipAddress_), masklen_(r.masklen_), value_(r.value_),
+    left_(r.left_), right_(r.right_) {}
+  PersistentRadixTreeNode& operator=(const PersistentRadixTreeNode&) = delete;
+
+  const IPADDRTYPE& ipAddress() const { return ipAddress_;  }
+  bool  isNonValueNode() const { return !isValueNode(); }
+  bool  isValueNode()   const  { return value_.hasValue(); }
+  uint32_t masklen() const { return masklen_; }
+  const PersistentRadixTreeNode* left() const { return left_.get(); }
+  const PersistentRadixTreeNode* right() const { return right_.get();  }
+  bool    isLeaf()  const { return left_ == nullptr && right_ == nullptr; }
+  // See PersistentRadixTree::freeze()
+  bool    isFrozen() const { return frozen_; }
+  const T& value() const { return value_.value();  }
+  std::string str(bool printValue = true) const {
+    auto nodeStr = folly::to<std::string>(ipAddress_.str(), "/", masklen_);
+    if (printValue) {
+      nodeStr += isNonValueNode() ?  "(*)" :
+        folly::to<std::string>("(",this->value(), ")");
+    }
+    return nodeStr;
+  }
+
+  // Given a IP, mask pair determine where that might lie w.r.t. this node
+  TreeDirection  searchDirection(const IPADDRTYPE& toSearch,
+      uint8_t masklen) const;
+
+  TreeDirection searchDirection(const PersistentRadixTreeNode* node) const {
+    return searchDirection(node->ipAddress_, node->masklen_);
+  }
+
+  // Comparison with links (left, right) ignored
+  bool equalSansLinks(const PersistentRadixTreeNode& r) const {
+    return ipAddress_ == r.ipAddress_ && masklen_ == r.masklen_ &&
+      isValueNode() == r.isValueNode() && (!isValueNode() ||
+          this->value() == r.value());
+  }
+
+ private:
+  friend class PersistentRadixTree<IPADDRTYPE, T>;
+
+  NodePtr& child(TreeDirection direction) {
+    return direction == TreeDirection::LEFT ? left_ : right_;
+  }
+  const NodePtr& child(TreeDirection direction) const {
+    return direction == TreeDirection::LEFT ? left_ : right_;
+  }
+
+  IPADDRTYPE ipAddress_;
+  uint32_t masklen_{0}; // Number of bits to match.
+  folly::Optional<T> value_;
+  NodePtr left_{nullptr};
+  NodePtr right_{nullptr};
+  bool frozen_{false};
+};
+
+/*
+ * Forward iterator over a PersistentRadixTree. Traverses the tree in
+ * DFS/preorder fashion, same as RadixTreeIterator.
+ *
+ * Since nodes have no parent pointers, the iterator carries the path
+ * from the root to the current node. Iterators are always const, values
+ * in the tree can only be changed through the tree (see
+ * PersistentRadixTree::update()), since the node may be shared with
+ * other trees.
+ */
+template <typename IPADDRTYPE, typename T>
+class PersistentRadixTreeIterator :
+  public std::iterator<std::forward_iterator_tag,
+                       PersistentRadixTreeIterator<IPADDRTYPE, T>> {
+ public:
+  typedef PersistentRadixTreeNode<IPADDRTYPE, T> TreeNode;
+
+  PersistentRadixTreeIterator() {}
+  explicit PersistentRadixTreeIterator(const TreeNode* root,
+      bool includeNonValNodes = false):
+    includeNonValueNodes_(includeNonValNodes) {
+    if (root) {
+      path_.push_back(root);
+      if (!includeNonValueNodes_ && root->isNonValueNode()) {
+        increment();
+      }
+    }
+  }
+  // Iterator positioned at the last node of path
+  PersistentRadixTreeIterator(std::vector<const TreeNode*>&& path,
+      bool includeNonValNodes):
+    path_(std::move(path)), includeNonValueNodes_(includeNonValNodes) {}
+
+  PersistentRadixTreeIterator& operator++() {
+    checkDereference(); // check if we are already at end
+    increment();
+    return *this;
+  }
+
+  PersistentRadixTreeIterator operator++(int) {
+    PersistentRadixTreeIterator tmp(*this);
+    ++(*this);
+    return tmp;
+  }
+
+  bool operator==(const PersistentRadixTreeIterator& r) const {
+    return node() == r.node();
+  }
+
+  bool operator!=(const PersistentRadixTreeIterator& r) const {
+    return node() != r.node();
+  }
+
+  const PersistentRadixTreeIterator& operator*() const {
+    checkDereference();
+    return *this;
+  }
+
+  const PersistentRadixTreeIterator* operator->() const {
+    checkDereference();
+    return this;
+  }
+
+  bool atEnd() const { return path_.empty(); }
+
+  const T& value() const {
+    checkDereference();
+    CHECK(node()->isValueNode());
+    return node()->value();
+  }
+
+  const IPADDRTYPE& ipAddress() const {
+    checkDereference();
+    return node()->ipAddress();
+  }
+
+  uint8_t masklen() const {
+    checkDereference();
+    return node()->masklen();
+  }
+
+  // Node at this cursor location
+  const TreeNode* node() const {
+    return path_.empty() ? nullptr : path_.back();
+  }
+  std::string str(bool printValue = true) const {
+    checkDereference();
+    return node()->str(printValue);
+  }
+  bool includeNonValueNodes() const { return includeNonValueNodes_; }
+
+ private:
+  void increment();
+  void checkDereference() const {
+    CHECK(!atEnd());
+  }
+  std::vector<const TreeNode*> path_;
+  bool includeNonValueNodes_{false};
+};
+
+/*
+ * A radix tree with structural sharing between versions.
+ *
+ * clone() is O(1): the clone points at the same root as the original.
+ * insert(), erase() and update() copy only the nodes on the path from the
+ * root to the modified prefix (path copying), all other nodes stay shared
+ * with the trees they came from. So a single prefix change to a cloned
+ * tree costs O(prefix length) in both time and memory, regardless of the
+ * size of the tree.
+ *
+ * A node is modified in place, rather than copied, when this tree is its
+ * only owner, i.e. the node and every node above it have a use count of 1,
+ * and it has not been frozen. This means that a batch of changes applied
+ * to one clone only copies a given path once.
+ *
+ * freeze() marks every node in the tree as immutable, visiting only the
+ * nodes created since the last freeze(). Owners that need to do something
+ * for each new value when they publish a tree (e.g. RouteTableRib
+ * publishing its routes) can use it to skip the unchanged part of the tree.
+ *
+ * The API mirrors the relevant subset of RadixTree. Unlike RadixTree, all
+ * iterators are const.
+ */
+template<typename IPADDRTYPE, typename T>
+class PersistentRadixTree {
+ public:
+  typedef PersistentRadixTreeNode<IPADDRTYPE, T>       TreeNode;
+  typedef typename TreeNode::NodePtr                   NodePtr;
+  typedef typename TreeNode::TreeDirection             TreeDirection;
+  typedef PersistentRadixTreeIterator<IPADDRTYPE, T>   Iterator;
+  typedef PersistentRadixTreeIterator<IPADDRTYPE, T>   ConstIterator;
+
+  PersistentRadixTree() {}
+  PersistentRadixTree(PersistentRadixTree&& r) noexcept
+    : root_(std::move(r.root_)), size_(r.size_) {
+    r.size_ = 0;
+  }
+  PersistentRadixTree& operator=(PersistentRadixTree&& r) noexcept {
+    root_ = std::move(r.root_);
+    size_ = r.size_;
+    r.size_ = 0;
+    return *this;
+  }
+  // Use clone() to make the (cheap) copy explicit
+  PersistentRadixTree(const PersistentRadixTree& r) = delete;
+  PersistentRadixTree& operator=(const PersistentRadixTree& r) = delete;
+
+  ConstIterator begin() const { return ConstIterator(root_.get()); }
+  ConstIterator end()   const { return ConstIterator();  }
+
+  // Drop all nodes (nodes shared with other trees stay alive there)
+  void clear() {
+    root_.reset();
+    size_ = 0;
+  }
+
+  // Clone this tree. O(1), all nodes are shared with the clone.
+  PersistentRadixTree clone() const {
+    PersistentRadixTree copy;
+    copy.root_ = root_;
+    copy.size_ = size_;
+    return copy;
+  }
+
+  /*
+   * Insert a IP, mask, value in tree. Returns inserted node, true
+   * if a node was inserted. If a node for IP, mask already existed
+   * in the tree we return that node, false.
+   */
+  template <typename VALUE>
+  std::pair<ConstIterator, bool> insert(const IPADDRTYPE& ipaddr,
+      uint8_t masklen, VALUE&& value);
+
+  /*
+   * Replace the value for an existing IP, mask. Returns false if the
+   * prefix is not in the tree.
+   */
+  template <typename VALUE>
+  bool update(const IPADDRTYPE& ipaddr, uint8_t masklen, VALUE&& value);
+
+  // Erase a IP, mask
+  bool erase(const IPADDRTYPE& ipaddr, uint8_t masklen);
+
+  // Erase node pointed to be iterator
+  bool erase(const ConstIterator& itr) {
+    return erase(itr->ipAddress(), itr->masklen());
+  }
+
+  // Given a IP, mask return the node with longest match for it
+  ConstIterator longestMatch(const IPADDRTYPE& ipaddr,
+      uint8_t masklen) const {
+    bool foundExact = false;
+    return lookup(ipaddr, masklen, foundExact);
+  }
+
+  // Given a IP, mask return the node whose IP, mask matches exactly
+  ConstIterator exactMatch(const IPADDRTYPE& ipaddr, uint8_t masklen) const {
+    bool foundExact = false;
+    auto itr = lookup(ipaddr, masklen, foundExact);
+    return foundExact ? itr : end();
+  }
+
+  /*
+   * Same as longestMatch()/exactMatch() but return the matching node rather
+   * than an iterator. Saves building the path for callers which only need
+   * the value (e.g. on the packet path).
+   */
+  const TreeNode* longestMatchNode(const IPADDRTYPE& ipaddr,
+      uint8_t masklen) const {
+    bool foundExact = false;
+    return longestMatchImpl(ipaddr, masklen, foundExact);
+  }
+  const TreeNode* exactMatchNode(const IPADDRTYPE& ipaddr,
+      uint8_t masklen) const {
+    bool foundExact = false;
+    auto match = longestMatchImpl(ipaddr, masklen, foundExact);
+    return foundExact ? match : nullptr;
+  }
+
+  /*
+   * Return the root of the subtree holding all prefixes covered by
+   * ipaddr/masklen (including ipaddr/masklen itself), null if there are
+   * none. Iterate the subtree with ConstIterator(subTreeNode(...)).
+   */
+  const TreeNode* subTreeNode(const IPADDRTYPE& ipaddr,
+      uint8_t masklen) const;
+
+  // Compare 2 radix (sub) trees. Shared subtrees compare equal trivially.
+  static bool radixSubTreesEqual(const TreeNode* nodeA,
+      const TreeNode* nodeB);
+
+  bool operator==(const PersistentRadixTree& r) const {
+    return size_ == r.size_ && radixSubTreesEqual(root(), r.root());
+  }
+  bool operator!=(const PersistentRadixTree& r) const {
+    return !(*this == r);
+  }
+
+  size_t size()  const { return size_; }
+  const TreeNode* root() const { return root_.get(); }
+
+  /*
+   * Freeze every node in the tree, so that it is never modified in place
+   * again, calling fn(value) for each value node that wasn't frozen yet.
+   *
+   * All nodes below a frozen node are frozen, so frozen subtrees are skipped
+   * without being entered. Since only the paths to modified prefixes are
+   * copied, this is O(number of changes * prefix length) after the first
+   * call. Returns the number of nodes visited.
+   */
+  template <typename Fn>
+  size_t freeze(Fn&& fn);
+
+ private:
+  // Worker function to do the actual longest match lookup.
+  const TreeNode* longestMatchImpl(const IPADDRTYPE& ipaddr,
+      uint8_t masklen, bool& foundExact,
+      std::vector<const TreeNode*>* path = nullptr) const;
+
+  ConstIterator lookup(const IPADDRTYPE& ipaddr, uint8_t masklen,
+      bool& foundExact) const;
+
+  /*
+   * Return a node that is safe to modify in place of node. That is node
+   * itself if this tree is its sole owner, a shallow copy otherwise.
+   */
+  static NodePtr writable(const NodePtr& node, bool exclusive) {
+    return exclusive ? node : std::make_shared<TreeNode>(*node);
+  }
+  static bool exclusiveChild(bool parentExclusive, const NodePtr& child) {
+    return parentExclusive && child.use_count() == 1 && !child->frozen_;
+  }
+  bool exclusiveRoot() const {
+    return root_.use_count() == 1 && !root_->frozen_;
+  }
+
+  // Make a parent for 2 disjoint subtrees
+  NodePtr joinSubTrees(NodePtr a, NodePtr b) const;
+
+  template <typename VALUE>
+  NodePtr insertImpl(const NodePtr& node, bool exclusive,
+      const IPADDRTYPE& ipaddr, uint8_t masklen, VALUE&& value,
+      const TreeNode** inserted, bool* added);
+
+  template <typename VALUE>
+  NodePtr updateImpl(const NodePtr& node, bool exclusive,
+      const IPADDRTYPE& ipaddr, uint8_t masklen, VALUE&& value,
+      bool* updated);
+
+  NodePtr eraseImpl(const NodePtr& node, bool exclusive,
+      const IPADDRTYPE& ipaddr, uint8_t masklen, bool* erased);
+
+  NodePtr root_{nullptr};
+  size_t  size_{0};
+};
+
+/*
+ * Differences between two versions of a PersistentRadixTree.
+ *
+ * Iterating a PersistentRadixTreeDelta visits every prefix that was added,
+ * removed or whose value changed between the old and the new tree. Both
+ * trees are walked in lockstep and any subtree that is shared by both
+ * trees (same node pointer) is skipped without being looked at. Since
+ * modifications to a cloned tree only copy the paths to the modified
+ * prefixes, the cost of walking the delta is proportional to the number
+ * of changed prefixes (times the prefix length) rather than the size of
+ * the trees.
+ *
+ * Values are compared with operator==, so for trees of shared_ptrs a
+ * prefix is reported as changed when its pointer changed.
+ *
+ * Either tree may be null, to represent a tree that was added or removed.
+ * The delta does not own the trees, they must outlive it.
+ */
+template<typename IPADDRTYPE, typename T>
+class PersistentRadixTreeDelta {
+ public:
+  typedef PersistentRadixTree<IPADDRTYPE, T>  Tree;
+  typedef typename Tree::TreeNode             TreeNode;
+  class Iterator;
+
+  PersistentRadixTreeDelta(const Tree* oldTree, const Tree* newTree):
+    old_(oldTree), new_(newTree) {}
+
+  const Tree* getOld() const { return old_; }
+  const Tree* getNew() const { return new_; }
+
+  Iterator begin() const {
+    return Iterator(old_ ? old_->root() : nullptr,
+        new_ ? new_->root() : nullptr);
+  }
+  Iterator end() const { return Iterator(); }
+
+ private:
+  const Tree* old_{nullptr};
+  const Tree* new_{nullptr};
+};
+
+/*
+ * Forward iterator over a PersistentRadixTreeDelta. At each position at
+ * least one of oldNode(), newNode() is set:
+ *  - both set: the value for the prefix changed
+ *  - only newNode(): prefix was added
+ *  - only oldNode(): prefix was removed
+ */
+template<typename IPADDRTYPE, typename T>
+class PersistentRadixTreeDelta<IPADDRTYPE, T>::Iterator :
+  public std::iterator<std::forward_iterator_tag, Iterator> {
+ public:
+  Iterator() {}
+  Iterator(const TreeNode* oldRoot, const TreeNode* newRoot) {
+    toVisit_.emplace_back(oldRoot, newRoot);
+    increment();
+  }
+
+  Iterator& operator++() {
+    CHECK(!atEnd());
+    increment();
+    return *this;
+  }
+
+  Iterator operator++(int) {
+    Iterator tmp(*this);
+    ++(*this);
+    return tmp;
+  }
+
+  // Each node is visited at most once, so the nodes identify the position
+  bool operator==(const Iterator& r) const {
+    return oldNode_ == r.oldNode_ && newNode_ == r.newNode_;
+  }
+  bool operator!=(const Iterator& r) const {
+    return !(*this == r);
+  }
+
+  const Iterator& operator*() const {
+    CHECK(!atEnd());
+    return *this;
+  }
+  const Iterator* operator->() const {
+    CHECK(!atEnd());
+    return this;
+  }
+
+  bool atEnd() const { return !oldNode_ && !newNode_; }
+
+  // Value node for the prefix in the old tree, null if it was added
+  const TreeNode* oldNode() const { return oldNode_; }
+  // Value node for the prefix in the new tree, null if it was removed
+  const TreeNode* newNode() const { return newNode_; }
+
+ private:
+  typedef typename Tree::TreeDirection TreeDirection;
+
+  void increment();
+  // Queue comparison of the old and new subtrees
+  void visit(const TreeNode* oldSubTree, const TreeNode* newSubTree) {
+    toVisit_.emplace_back(oldSubTree, newSubTree);
+  }
+  // Queue comparison of the children of parent with subTree, which lies
+  // in direction under parent, and an empty tree for the other child.
+  void visitChildren(const TreeNode* parent, TreeDirection direction,
+      const TreeNode* subTree, bool parentIsOld);
+
+  // Stack of (old, new) subtree pairs still to be compared
+  std::vector<std::pair<const TreeNode*, const TreeNode*>> toVisit_;
+  const TreeNode* oldNode_{nullptr};
+  const TreeNode* newNode_{nullptr};
+};
+
+}} // facebook::network
+
+#include "PersistentRadixTree-inl.h"
+
+#endif //PERSISTENT_RADIX_TREE_H
@@ -0,0 +1,218 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <set>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common/base/Random.h"
+#include <folly/IPAddress.h>
+#include <folly/IPAddressV4.h>
+#include <folly/IPAddressV6.h>
+
+#include "fboss/lib/MultibitRadixTree.h"
+#include "fboss/lib/RadixTree.h"
+#include "Utils.h"
+
+using namespace facebook;
+using namespace facebook::network;
+using namespace std;
+
+namespace {
+using IPAddress = folly::IPAddress;
+using IPAddressV4 = folly::IPAddressV4;
+using IPAddressV6 = folly::IPAddressV6;
+
+vector<Prefix4> randomPrefixes4(size_t count) {
+  set<Prefix4> seen;
+  vector<Prefix4> prefixes;
+  while (prefixes.size() < count) {
+    auto mask = random32(32);
+    auto ip = IPAddressV4::fromLongHBO(random32()).mask(mask);
+    if (seen.insert(Prefix4(ip, mask)).second) {
+      prefixes.push_back(Prefix4(ip, mask));
+    }
+  }
+  return prefixes;
+}
+
+vector<Prefix6> randomPrefixes6(size_t count) {
+  set<Prefix6> seen;
+  vector<Prefix6> prefixes;
+  while (prefixes.size() < count) {
+    auto mask = random32(128);
+    folly::ByteArray16 ba;
+    *(uint64_t*)(&ba[0]) = random64();
+    *(uint64_t*)(&ba[8]) = random64();
+    // Share the first bits, so the prefixes nest
+    ba[0] &= 0x0f;
+    auto ip = IPAddressV6(ba).mask(mask);
+    if (seen.insert(Prefix6(ip, mask)).second) {
+      prefixes.push_back(Prefix6(ip, mask));
+    }
+  }
+  return prefixes;
+}
+
+// Check that iteration and lookups match those of a RadixTree
+template<typename MTREE, typename RTREE, typename PREFIX>
+void expectSameTrees(const MTREE& mtree, const RTREE& rtree,
+    const vector<PREFIX>& prefixes) {
+  ASSERT_EQ(rtree.size(), mtree.size());
+  auto ritr = rtree.begin();
+  for (const auto& mitr : mtree) {
+    ASSERT_NE(rtree.end(), ritr);
+    EXPECT_EQ(ritr->ipAddress(), mitr.ipAddress());
+    EXPECT_EQ(ritr->masklen(), mitr.masklen());
+    EXPECT_EQ(ritr->value(), mitr.value());
+    ++ritr;
+  }
+  EXPECT_EQ(rtree.end(), ritr);
+
+  for (const auto& pfx : prefixes) {
+    auto bitCount = pfx.ip.bitCount();
+    auto mitr = mtree.longestMatch(pfx.ip, bitCount);
+    auto ritr = rtree.longestMatch(pfx.ip, bitCount);
+    ASSERT_EQ(ritr == rtree.end(), mitr == mtree.end());
+    if (mitr != mtree.end()) {
+      EXPECT_EQ(ritr->ipAddress(), mitr->ipAddress());
+      EXPECT_EQ(ritr->masklen(), mitr->masklen());
+      EXPECT_EQ(ritr->value(), mitr->value());
+    }
+    EXPECT_EQ(rtree.exactMatch(pfx.ip, pfx.mask) == rtree.end(),
+        mtree.exactMatch(pfx.ip, pfx.mask) == mtree.end());
+
+    typename RTREE::VecConstIterators rtrail;
+    typename MTREE::VecConstIterators mtrail;
+    rtree.longestMatchWithTrail(pfx.ip, pfx.mask, rtrail);
+    mtree.longestMatchWithTrail(pfx.ip, pfx.mask, mtrail);
+    ASSERT_EQ(rtrail.size(), mtrail.size());
+    for (auto i = 0; i < rtrail.size(); ++i) {
+      EXPECT_EQ(rtrail[i]->ipAddress(), mtrail[i]->ipAddress());
+      EXPECT_EQ(rtrail[i]->masklen(), mtrail[i]->masklen());
+    }
+  }
+}
+
+/*
+ * Insert and erase the prefixes in both a RadixTree and a
+ * MultibitRadixTree, and make sure they hold the same prefixes.
+ */
+template<typename MTREE, typename RTREE, typename PREFIX>
+void compareWithRadixTree(const vector<PREFIX>& prefixes) {
+  MTREE mtree;
+  RTREE rtree;
+  for (auto i = 0; i < prefixes.size(); ++i) {
+    auto inserted = mtree.insert(prefixes[i].ip, prefixes[i].mask, i);
+    EXPECT_TRUE(inserted.second);
+    EXPECT_EQ(prefixes[i].ip, inserted.first->ipAddress());
+    EXPECT_EQ(prefixes[i].mask, inserted.first->masklen());
+    rtree.insert(prefixes[i].ip, prefixes[i].mask, i);
+  }
+  auto existing = mtree.insert(prefixes[0].ip, prefixes[0].mask, 42);
+  EXPECT_FALSE(existing.second);
+  EXPECT_EQ(0, existing.first->value());
+  expectSameTrees(mtree, rtree, prefixes);
+
+  for (auto i = 0; i < prefixes.size(); i += 3) {
+    EXPECT_TRUE(mtree.erase(prefixes[i].ip, prefixes[i].mask));
+    EXPECT_FALSE(mtree.erase(prefixes[i].ip, prefixes[i].mask));
+    rtree.erase(prefixes[i].ip, prefixes[i].mask);
+  }
+  expectSameTrees(mtree, rtree, prefixes);
+
+  auto copy = mtree.clone();
+  EXPECT_TRUE(copy == mtree);
+  copy.exactMatch(prefixes[1].ip, prefixes[1].mask)->setValue(-1);
+  EXPECT_FALSE(copy == mtree);
+
+  // Erasing everything frees all the nodes
+  while (mtree.begin() != mtree.end()) {
+    EXPECT_TRUE(mtree.erase(mtree.begin()));
+  }
+  EXPECT_EQ(0, mtree.size());
+  EXPECT_EQ(0, mtree.memoryUsage());
+}
+}
+
+TEST(MultibitRadixTree, CompareWithRadixTree4) {
+  auto prefixes = randomPrefixes4(2000);
+  compareWithRadixTree<MultibitRadixTree<IPAddressV4, int>,
+    RadixTree<IPAddressV4, int>>(prefixes);
+  compareWithRadixTree<MultibitRadixTree<IPAddressV4, int, 1>,
+    RadixTree<IPAddressV4, int>>(prefixes);
+  compareWithRadixTree<MultibitRadixTree<IPAddressV4, int, 8>,
+    RadixTree<IPAddressV4, int>>(prefixes);
+}
+
+TEST(MultibitRadixTree, CompareWithRadixTree6) {
+  auto prefixes = randomPrefixes6(2000);
+  compareWithRadixTree<MultibitRadixTree<IPAddressV6, int>,
+    RadixTree<IPAddressV6, int>>(prefixes);
+  compareWithRadixTree<MultibitRadixTree<IPAddressV6, int, 8>,
+    RadixTree<IPAddressV6, int>>(prefixes);
+}
+
+TEST(MultibitRadixTree, DefaultRoute) {
+  MultibitRadixTree<IPAddressV4, int> tree;
+  EXPECT_EQ(tree.end(), tree.begin());
+  EXPECT_EQ(tree.end(), tree.longestMatch(IPAddressV4("10.0.0.1"), 32));
+  tree.insert(IPAddressV4("0.0.0.0"), 0, 1);
+  tree.insert(IPAddressV4("10.0.0.0"), 8, 2);
+  tree.insert(IPAddressV4("10.1.2.3"), 32, 3);
+  EXPECT_EQ(1, tree.longestMatch(IPAddressV4("11.0.0.1"), 32)->value());
+  EXPECT_EQ(2, tree.longestMatch(IPAddressV4("10.1.2.4"), 32)->value());
+  EXPECT_EQ(3, tree.longestMatch(IPAddressV4("10.1.2.3"), 32)->value());
+  // Bits after the mask length are ignored
+  EXPECT_EQ(2, tree.exactMatch(IPAddressV4("10.1.1.1"), 8)->value());
+  EXPECT_EQ(tree.end(), tree.exactMatch(IPAddressV4("10.0.0.0"), 9));
+
+  MultibitRadixTree<IPAddressV4, int>::VecConstIterators trail;
+  auto match = tree.exactMatchWithTrail(IPAddressV4("10.1.2.3"), 32, trail);
+  EXPECT_EQ(3, match->value());
+  ASSERT_EQ(3, trail.size());
+  EXPECT_EQ(0, trail[0]->masklen());
+  EXPECT_EQ(8, trail[1]->masklen());
+  EXPECT_EQ(32, trail[2]->masklen());
+
+  EXPECT_TRUE(tree.erase(IPAddressV4("0.0.0.0"), 0));
+  EXPECT_EQ(tree.end(), tree.longestMatch(IPAddressV4("11.0.0.1"), 32));
+  EXPECT_EQ("10.0.0.0/8(2)", tree.begin()->str());
+}
+
+TEST(MultibitRadixTree, CombinedV4AndV6) {
+  MultibitRadixTree<IPAddress, int> tree;
+  EXPECT_EQ(tree.end(), tree.begin());
+  tree.insert(IPAddress("2401:db00::"), 32, 1);
+  tree.insert(IPAddress("10.0.0.0"), 8, 2);
+  tree.insert(IPAddress("10.1.0.0"), 16, 3);
+  EXPECT_EQ(3, tree.size());
+  EXPECT_EQ(2, tree.size4());
+  EXPECT_EQ(1, tree.size6());
+
+  // V4 prefixes first
+  vector<int> values;
+  for (const auto& itr : tree) {
+    values.push_back(itr.value());
+  }
+  EXPECT_EQ(vector<int>({2, 3, 1}), values);
+
+  // Iteration from a V4 match continues into the V6 prefixes
+  auto itr = tree.longestMatch(IPAddress("10.1.1.1"), 32);
+  EXPECT_EQ(3, itr->value());
+  EXPECT_EQ(1, (++itr)->value());
+  EXPECT_EQ(tree.end(), ++itr);
+
+  MultibitRadixTree<IPAddress, int>::VecConstIterators trail;
+  auto match = tree.longestMatchWithTrail(IPAddress("2401:db00::1"), 128,
+      trail);
+  EXPECT_EQ(1, match->value());
+  ASSERT_EQ(1, trail.size());
+  EXPECT_EQ(IPAddress("2401:db00::"), trail[0]->ipAddress());
+  EXPECT_EQ(tree.end(), tree.longestMatch(IPAddress("2402::"), 128));
+
+  EXPECT_TRUE(tree.erase(IPAddress("10.0.0.0"), 8));
+  EXPECT_FALSE(tree.erase(IPAddress("10.0.0.0"), 8));
+  auto moved = std::move(tree);
+  EXPECT_EQ(2, moved.size());
+  EXPECT_EQ(0, tree.size());
+}
@@ -0,0 +1,377 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <set>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common/base/Random.h"
+#include <folly/IPAddressV4.h>
+#include <folly/IPAddressV6.h>
+
+#include "fboss/lib/PersistentRadixTree.h"
+#include "fboss/lib/RadixTree.h"
+#include "Utils.h"
+
+using namespace facebook;
+using namespace facebook::network;
+using namespace std;
+
+namespace {
+using IPAddressV4 = folly::IPAddressV4;
+using IPAddressV6 = folly::IPAddressV6;
+
+// Compare a persistent radix (sub) tree with a regular radix (sub) tree
+template<typename IPAddrType, typename T>
+bool treesEqual(const PersistentRadixTreeNode<IPAddrType, T>* nodeA,
+    const RadixTreeNode<IPAddrType, T>* nodeB) {
+  if (nodeA && nodeB) {
+    if (nodeA->ipAddress() != nodeB->ipAddress() ||
+        nodeA->masklen() != nodeB->masklen() ||
+        nodeA->isValueNode() != nodeB->isValueNode() ||
+        (nodeA->isValueNode() && nodeA->value() != nodeB->value())) {
+      return false;
+    }
+    return treesEqual(nodeA->left(), nodeB->left()) &&
+      treesEqual(nodeA->right(), nodeB->right());
+  }
+  return !nodeA && !nodeB;
+}
+
+// Count nodes of tree which are not present (shared) in other
+template<typename NodeT>
+void collectNodes(const NodeT* node, set<const NodeT*>& nodes) {
+  if (node) {
+    nodes.insert(node);
+    collectNodes(node->left(), nodes);
+    collectNodes(node->right(), nodes);
+  }
+}
+
+template<typename TreeT>
+size_t unsharedNodes(const TreeT& tree, const TreeT& other) {
+  set<const typename TreeT::TreeNode*> nodes, otherNodes;
+  collectNodes(tree.root(), nodes);
+  collectNodes(other.root(), otherNodes);
+  size_t count = 0;
+  for (auto node : nodes) {
+    count += otherNodes.count(node) ? 0 : 1;
+  }
+  return count;
+}
+
+vector<Prefix4> randomPrefixes4(int count) {
+  set<Prefix4> seen;
+  vector<Prefix4> prefixes;
+  while (prefixes.size() < count) {
+    auto mask = random32(32);
+    auto ip = IPAddressV4::fromLongHBO(random32()).mask(mask);
+    if (seen.insert(Prefix4(ip, mask)).second) {
+      prefixes.push_back(Prefix4(ip, mask));
+    }
+  }
+  return prefixes;
+}
+}
+
+/*
+ * Insert and erase random prefixes in both a RadixTree and a
+ * PersistentRadixTree and make sure that both trees have the
+ * same shape.
+ */
+TEST(PersistentRadixTree, CompareWithRadixTree) {
+  PersistentRadixTree<IPAddressV4, int> ptree;
+  RadixTree<IPAddressV4, int> rtree;
+  auto prefixes = randomPrefixes4(1000);
+  for (auto i = 0; i < prefixes.size(); ++i) {
+    EXPECT_TRUE(ptree.insert(prefixes[i].ip, prefixes[i].mask, i).second);
+    rtree.insert(prefixes[i].ip, prefixes[i].mask, i);
+  }
+  EXPECT_FALSE(ptree.insert(prefixes[0].ip, prefixes[0].mask, 42).second);
+  EXPECT_EQ(rtree.size(), ptree.size());
+  EXPECT_TRUE(treesEqual(ptree.root(), rtree.root()));
+
+  for (auto i = 0; i < prefixes.size(); i += 3) {
+    EXPECT_TRUE(ptree.erase(prefixes[i].ip, prefixes[i].mask));
+    EXPECT_FALSE(ptree.erase(prefixes[i].ip, prefixes[i].mask));
+    rtree.erase(prefixes[i].ip, prefixes[i].mask);
+  }
+  EXPECT_EQ(rtree.size(), ptree.size());
+  EXPECT_TRUE(treesEqual(ptree.root(), rtree.root()));
+
+  // Lookups and iteration
+  for (auto i = 0; i < prefixes.size(); ++i) {
+    auto pitr = ptree.longestMatch(prefixes[i].ip, 32);
+    auto ritr = rtree.longestMatch(prefixes[i].ip, 32);
+    ASSERT_EQ(ritr == rtree.end(), pitr == ptree.end());
+    if (pitr != ptree.end()) {
+      EXPECT_EQ(ritr->value(), pitr->value());
+    }
+    EXPECT_EQ(rtree.exactMatch(prefixes[i].ip, prefixes[i].mask) ==
+        rtree.end(), ptree.exactMatch(prefixes[i].ip, prefixes[i].mask) ==
+        ptree.end());
+  }
+  auto ritr = rtree.begin();
+  for (const auto& pitr : ptree) {
+    ASSERT_NE(rtree.end(), ritr);
+    EXPECT_EQ(ritr->value(), pitr.value());
+    ++ritr;
+  }
+  EXPECT_EQ(rtree.end(), ritr);
+}
+
+/*
+ * Iteration started from a lookup result should continue in the same
+ * order as iteration from begin()
+ */
+TEST(PersistentRadixTree, IterateFromMatch) {
+  PersistentRadixTree<IPAddressV4, int> ptree;
+  auto prefixes = randomPrefixes4(100);
+  for (auto i = 0; i < prefixes.size(); ++i) {
+    ptree.insert(prefixes[i].ip, prefixes[i].mask, i);
+  }
+  for (auto i = 0; i < prefixes.size(); i += 10) {
+    auto itr = ptree.exactMatch(prefixes[i].ip, prefixes[i].mask);
+    auto fromBegin = ptree.begin();
+    while (fromBegin != itr) {
+      ++fromBegin;
+    }
+    for (; itr != ptree.end(); ++itr, ++fromBegin) {
+      EXPECT_EQ(fromBegin->value(), itr->value());
+    }
+    EXPECT_EQ(ptree.end(), fromBegin);
+  }
+}
+
+/*
+ * Modifying a clone must not change the original, and must only
+ * copy the nodes on the path to the modified prefix.
+ */
+TEST(PersistentRadixTree, CloneSharesStructure) {
+  PersistentRadixTree<IPAddressV4, int> orig;
+  auto prefixes = randomPrefixes4(1001);
+  for (auto i = 0; i < prefixes.size() - 1; ++i) {
+    orig.insert(prefixes[i].ip, prefixes[i].mask, i);
+  }
+  RadixTree<IPAddressV4, int> expected;
+  for (const auto& itr : orig) {
+    expected.insert(itr.ipAddress(), itr.masklen(), itr.value());
+  }
+
+  auto copy = orig.clone();
+  EXPECT_TRUE(copy == orig);
+  EXPECT_EQ(0, unsharedNodes(copy, orig));
+
+  // Insert, the path to the new prefix plus maybe a internal node is copied
+  const auto& added = prefixes.back();
+  EXPECT_TRUE(copy.insert(added.ip, added.mask, 1000).second);
+  EXPECT_GE(added.mask + 2, unsharedNodes(copy, orig));
+  EXPECT_TRUE(treesEqual(orig.root(), expected.root()));
+  EXPECT_EQ(prefixes.size() - 1, orig.size());
+  EXPECT_EQ(prefixes.size(), copy.size());
+
+  // Update, further changes to the clone only touch its own nodes
+  auto copy2 = copy.clone();
+  EXPECT_TRUE(copy2.update(prefixes[0].ip, prefixes[0].mask, -1));
+  EXPECT_TRUE(copy2.update(prefixes[0].ip, prefixes[0].mask, -2));
+  EXPECT_GE(prefixes[0].mask + 1, unsharedNodes(copy2, copy));
+  EXPECT_EQ(0, copy.exactMatch(prefixes[0].ip, prefixes[0].mask)->value());
+  EXPECT_EQ(-2, copy2.exactMatch(prefixes[0].ip, prefixes[0].mask)->value());
+  EXPECT_FALSE(copy2 == copy);
+
+  // Erase
+  auto copy3 = orig.clone();
+  EXPECT_TRUE(copy3.erase(prefixes[1].ip, prefixes[1].mask));
+  EXPECT_GE(prefixes[1].mask + 1, unsharedNodes(copy3, orig));
+  EXPECT_EQ(orig.end(), copy3.exactMatch(prefixes[1].ip, prefixes[1].mask));
+  EXPECT_NE(orig.end(), orig.exactMatch(prefixes[1].ip, prefixes[1].mask));
+  EXPECT_TRUE(treesEqual(orig.root(), expected.root()));
+}
+
+TEST(PersistentRadixTree, Freeze) {
+  PersistentRadixTree<IPAddressV4, int> tree;
+  auto prefixes = randomPrefixes4(1001);
+  for (auto i = 0; i < prefixes.size() - 1; ++i) {
+    tree.insert(prefixes[i].ip, prefixes[i].mask, i);
+  }
+  set<const PersistentRadixTreeNode<IPAddressV4, int>*> allNodes;
+  collectNodes(tree.root(), allNodes);
+
+  // The first freeze visits everything
+  set<int> values;
+  EXPECT_EQ(allNodes.size(), tree.freeze([&](int v) { values.insert(v); }));
+  EXPECT_EQ(prefixes.size() - 1, values.size());
+  for (auto node : allNodes) {
+    EXPECT_TRUE(node->isFrozen());
+  }
+  EXPECT_EQ(0, tree.freeze([](int) { ADD_FAILURE(); }));
+
+  // Frozen nodes are copied rather than modified in place, even though
+  // this tree is their only owner
+  const auto& added = prefixes.back();
+  EXPECT_TRUE(tree.insert(added.ip, added.mask, 1000).second);
+  EXPECT_TRUE(tree.update(prefixes[0].ip, prefixes[0].mask, -1));
+  set<const PersistentRadixTreeNode<IPAddressV4, int>*> nodes;
+  collectNodes(tree.root(), nodes);
+  size_t unfrozen = 0;
+  for (auto node : nodes) {
+    if (!node->isFrozen()) {
+      ++unfrozen;
+    }
+  }
+  EXPECT_GE(added.mask + prefixes[0].mask + 3, unfrozen);
+
+  // Only the new nodes are visited
+  values.clear();
+  EXPECT_EQ(unfrozen, tree.freeze([&](int v) { values.insert(v); }));
+  EXPECT_EQ(1, values.count(1000));
+  EXPECT_EQ(1, values.count(-1));
+  EXPECT_GE(values.size(), 2);
+  EXPECT_EQ(0, tree.freeze([](int) { ADD_FAILURE(); }));
+}
+
+TEST(PersistentRadixTree, V6) {
+  PersistentRadixTree<IPAddressV6, int> ptree;
+  RadixTree<IPAddressV6, int> rtree;
+  vector<Prefix6> prefixes;
+  set<Prefix6> seen;
+  while (prefixes.size() < 1000) {
+    auto mask = random32(128);
+    folly::ByteArray16 ba;
+    *(uint64_t*)(&ba[0]) = random64();
+    *(uint64_t*)(&ba[8]) = random64();
+    auto ip = IPAddressV6(ba).mask(mask);
+    if (seen.insert(Prefix6(ip, mask)).second) {
+      prefixes.push_back(Prefix6(ip, mask));
+    }
+  }
+  for (auto i = 0; i < prefixes.size(); ++i) {
+    ptree.insert(prefixes[i].ip, prefixes[i].mask, i);
+    rtree.insert(prefixes[i].ip, prefixes[i].mask, i);
+  }
+  auto copy = ptree.clone();
+  for (auto i = 0; i < prefixes.size(); i += 2) {
+    copy.erase(prefixes[i].ip, prefixes[i].mask);
+  }
+  EXPECT_TRUE(treesEqual(ptree.root(), rtree.root()));
+  for (auto i = 0; i < prefixes.size(); i += 2) {
+    rtree.erase(prefixes[i].ip, prefixes[i].mask);
+  }
+  EXPECT_TRUE(treesEqual(copy.root(), rtree.root()));
+}
+
+namespace {
+struct DeltaResult {
+  set<pair<Prefix4, int>> changed;
+  set<Prefix4> added;
+  set<Prefix4> removed;
+};
+
+DeltaResult getDelta(const PersistentRadixTree<IPAddressV4, int>* oldTree,
+    const PersistentRadixTree<IPAddressV4, int>* newTree) {
+  DeltaResult result;
+  PersistentRadixTreeDelta<IPAddressV4, int> delta(oldTree, newTree);
+  for (const auto& entry : delta) {
+    if (entry.oldNode() && entry.newNode()) {
+      EXPECT_EQ(entry.oldNode()->ipAddress(), entry.newNode()->ipAddress());
+      EXPECT_EQ(entry.oldNode()->masklen(), entry.newNode()->masklen());
+      EXPECT_NE(entry.oldNode()->value(), entry.newNode()->value());
+      auto pfx = Prefix4(entry.newNode()->ipAddress(),
+          entry.newNode()->masklen());
+      EXPECT_TRUE(result.changed.insert(
+            make_pair(pfx, entry.newNode()->value())).second);
+    } else if (entry.newNode()) {
+      EXPECT_TRUE(result.added.insert(Prefix4(entry.newNode()->ipAddress(),
+              entry.newNode()->masklen())).second);
+    } else {
+      EXPECT_TRUE(result.removed.insert(Prefix4(entry.oldNode()->ipAddress(),
+              entry.oldNode()->masklen())).second);
+    }
+  }
+  return result;
+}
+}
+
+TEST(PersistentRadixTree, Delta) {
+  PersistentRadixTree<IPAddressV4, int> orig;
+  auto prefixes = randomPrefixes4(2000);
+  for (auto i = 0; i < 1000; ++i) {
+    orig.insert(prefixes[i].ip, prefixes[i].mask, i);
+  }
+  // No changes
+  auto copy = orig.clone();
+  PersistentRadixTreeDelta<IPAddressV4, int> noDelta(&orig, &copy);
+  EXPECT_EQ(noDelta.end(), noDelta.begin());
+
+  // Add, remove and change some prefixes
+  DeltaResult expected;
+  for (auto i = 1000; i < 1100; ++i) {
+    copy.insert(prefixes[i].ip, prefixes[i].mask, i);
+    expected.added.insert(prefixes[i]);
+  }
+  for (auto i = 0; i < 100; ++i) {
+    copy.erase(prefixes[i].ip, prefixes[i].mask);
+    expected.removed.insert(prefixes[i]);
+  }
+  for (auto i = 100; i < 200; ++i) {
+    copy.update(prefixes[i].ip, prefixes[i].mask, -i);
+    expected.changed.insert(make_pair(prefixes[i], -i));
+  }
+  // Updating to the same value is not a change
+  for (auto i = 200; i < 300; ++i) {
+    copy.update(prefixes[i].ip, prefixes[i].mask, i);
+  }
+  auto result = getDelta(&orig, &copy);
+  EXPECT_EQ(expected.changed, result.changed);
+  EXPECT_EQ(expected.added, result.added);
+  EXPECT_EQ(expected.removed, result.removed);
+
+  // The reverse delta
+  auto reverse = getDelta(&copy, &orig);
+  EXPECT_EQ(expected.added, reverse.removed);
+  EXPECT_EQ(expected.removed, reverse.added);
+  EXPECT_EQ(expected.changed.size(), reverse.changed.size());
+
+  // Trees built independently share no nodes, but have the same content
+  PersistentRadixTree<IPAddressV4, int> rebuilt;
+  for (const auto& itr : orig) {
+    rebuilt.insert(itr.ipAddress(), itr.masklen(), itr.value());
+  }
+  result = getDelta(&orig, &rebuilt);
+  EXPECT_TRUE(result.changed.empty());
+  EXPECT_TRUE(result.added.empty());
+  EXPECT_TRUE(result.removed.empty());
+
+  // Added and removed trees
+  result = getDelta(nullptr, &orig);
+  EXPECT_EQ(orig.size(), result.added.size());
+  result = getDelta(&orig, nullptr);
+  EXPECT_EQ(orig.size(), result.removed.size());
+}
+
+TEST(PersistentRadixTree, SubTree) {
+  PersistentRadixTree<IPAddressV4, int> ptree;
+  auto prefixes = randomPrefixes4(1000);
+  for (auto i = 0; i < prefixes.size(); ++i) {
+    ptree.insert(prefixes[i].ip, prefixes[i].mask, i);
+  }
+  for (auto i = 0; i < prefixes.size(); i += 10) {
+    // Look up both prefixes in the tree and less specific ones
+    auto mask = prefixes[i].mask / (i % 20 ? 1 : 2);
+    auto ip = prefixes[i].ip.mask(mask);
+    set<Prefix4> expected, found;
+    for (const auto& itr : ptree) {
+      if (itr.masklen() >= mask && itr.ipAddress().mask(mask) == ip) {
+        expected.insert(Prefix4(itr.ipAddress(), itr.masklen()));
+      }
+    }
+    PersistentRadixTree<IPAddressV4, int>::ConstIterator itr(
+        ptree.subTreeNode(ip, mask));
+    for (; !itr.atEnd(); ++itr) {
+      EXPECT_TRUE(found.insert(Prefix4(itr.ipAddress(), itr.masklen())).second);
+    }
+    EXPECT_EQ(expected, found);
+  }
+  EXPECT_EQ(ptree.root(), ptree.subTreeNode(IPAddressV4("0.0.0.0"), 0));
+  PersistentRadixTree<IPAddressV4, int> empty;
+  EXPECT_EQ(nullptr, empty.subTreeNode(IPAddressV4("0.0.0.0"), 0));
+}
@@ -1,5 +1,6 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
+#include <map>
 #include <set>
 #include <vector>
 #include "common/init/Init.h"
@@ -7,6 +8,8 @@
 #include <folly/IPAddressV4.h>
 #include <folly/IPAddressV6.h>
 #include <folly/Benchmark.h>
+#include "fboss/lib/MultibitRadixTree.h"
+#include "fboss/lib/PersistentRadixTree.h"
 #include "fboss/lib/RadixTree.h"
 #include "PyRadixWrapper.h"
 
@@ -51,6 +54,11 @@ BENCHMARK_RELATIVE(RadixTreeInsert4) {
   setupTree4(rtree);
 }
 
+BENCHMARK_RELATIVE(MultibitRadixTreeInsert4) {
+  MultibitRadixTree<IPAddressV4, int> mtree;
+  setupTree4(mtree);
+}
+
 BENCHMARK(PyRadixErase4) {
   PyRadixWrapper<IPAddressV4, int> pyrtree;
   BENCHMARK_SUSPEND {
@@ -71,6 +79,16 @@ BENCHMARK_RELATIVE(RadixTreeErase4) {
   }
 }
 
+BENCHMARK_RELATIVE(MultibitRadixTreeErase4) {
+  MultibitRadixTree<IPAddressV4, int> mtree;
+  BENCHMARK_SUSPEND {
+    setupTree4(mtree);
+  }
+  for (auto pfx: eraseSet4) {
+    mtree.erase(pfx.ip, pfx.mask);
+  }
+}
+
 BENCHMARK(PyRadixExactMatch4) {
   PyRadixWrapper<IPAddressV4, int> pyrtree;
   BENCHMARK_SUSPEND {
@@ -91,6 +109,16 @@ BENCHMARK_RELATIVE(RadixTreeExactMatch4) {
   }
 }
 
+BENCHMARK_RELATIVE(MultibitRadixTreeExactMatch4) {
+  MultibitRadixTree<IPAddressV4, int> mtree;
+  BENCHMARK_SUSPEND {
+    setupTree4(mtree);
+  }
+  for (auto pfx: exactMatchSet4) {
+    mtree.exactMatch(pfx.ip, pfx.mask);
+  }
+}
+
 BENCHMARK(PyRadixLongestMatch4) {
   PyRadixWrapper<IPAddressV4, int> pyrtree;
   BENCHMARK_SUSPEND {
@@ -111,6 +139,16 @@ BENCHMARK_RELATIVE(RadixTreeLongestMatch4) {
   }
 }
 
+BENCHMARK_RELATIVE(MultibitRadixTreeLongestMatch4) {
+  MultibitRadixTree<IPAddressV4, int> mtree;
+  BENCHMARK_SUSPEND {
+    setupTree4(mtree);
+  }
+  for (auto pfx: longestMatchSet4) {
+    mtree.longestMatch(pfx.ip, pfx.mask);
+  }
+}
+
 // V6 benchmarks
 
 template<typename TREE>
@@ -131,6 +169,11 @@ BENCHMARK_RELATIVE(RadixTreeInsert6) {
   setupTree6(rtree);
 }
 
+BENCHMARK_RELATIVE(MultibitRadixTreeInsert6) {
+  MultibitRadixTree<IPAddressV6, int> mtree;
+  setupTree6(mtree);
+}
+
 BENCHMARK(PyRadixErase6) {
   PyRadixWrapper<IPAddressV6, int> pyrtree;
   BENCHMARK_SUSPEND {
@@ -151,6 +194,16 @@ BENCHMARK_RELATIVE(RadixTreeErase6) {
   }
 }
 
+BENCHMARK_RELATIVE(MultibitRadixTreeErase6) {
+  MultibitRadixTree<IPAddressV6, int> mtree;
+  BENCHMARK_SUSPEND {
+    setupTree6(mtree);
+  }
+  for (auto pfx: eraseSet6) {
+    mtree.erase(pfx.ip, pfx.mask);
+  }
+}
+
 BENCHMARK(PyRadixExactMatch6) {
   PyRadixWrapper<IPAddressV6, int> pyrtree;
   BENCHMARK_SUSPEND {
@@ -171,6 +224,16 @@ BENCHMARK_RELATIVE(RadixTreeExactMatch6) {
   }
 }
 
+BENCHMARK_RELATIVE(MultibitRadixTreeExactMatch6) {
+  MultibitRadixTree<IPAddressV6, int> mtree;
+  BENCHMARK_SUSPEND {
+    setupTree6(mtree);
+  }
+  for (auto pfx: exactMatchSet6) {
+    mtree.exactMatch(pfx.ip, pfx.mask);
+  }
+}
+
 BENCHMARK(PyRadixLongestMatch6) {
   PyRadixWrapper<IPAddressV6, int> pyrtree;
   BENCHMARK_SUSPEND {
@@ -191,6 +254,61 @@ BENCHMARK_RELATIVE(RadixTreeLongestMatch6) {
   }
 }
 
+BENCHMARK_RELATIVE(MultibitRadixTreeLongestMatch6) {
+  MultibitRadixTree<IPAddressV6, int> mtree;
+  BENCHMARK_SUSPEND {
+    setupTree6(mtree);
+  }
+  for (auto pfx: longestMatchSet6) {
+    mtree.longestMatch(pfx.ip, pfx.mask);
+  }
+}
+
+
+// Clone + insert benchmarks. This is what RouteUpdater does for every
+// route change: clone the published tree and add a prefix to the clone.
+vector<Prefix4> clonePrefixes4;
+
+template<typename TREE>
+const TREE& cloneBaseTree4(size_t size) {
+  static map<size_t, TREE> trees;
+  auto itr = trees.find(size);
+  if (itr == trees.end()) {
+    itr = trees.emplace(size, TREE()).first;
+    for (size_t i = 0; i < size; ++i) {
+      itr->second.insert(clonePrefixes4[i].ip, clonePrefixes4[i].mask, i);
+    }
+  }
+  return itr->second;
+}
+
+template<typename TREE>
+void cloneInsert4(unsigned int iters, size_t size) {
+  const TREE* base;
+  BENCHMARK_SUSPEND {
+    base = &cloneBaseTree4<TREE>(size);
+  }
+  const auto& pfx = clonePrefixes4[size];
+  for (uint32_t i = 0; i < iters; ++i) {
+    auto tree = base->clone();
+    tree.insert(pfx.ip, pfx.mask, i);
+  }
+}
+
+void RadixTreeCloneInsert4(unsigned int iters, size_t size) {
+  cloneInsert4<RadixTree<IPAddressV4, int>>(iters, size);
+}
+
+void PersistentRadixTreeCloneInsert4(unsigned int iters, size_t size) {
+  cloneInsert4<PersistentRadixTree<IPAddressV4, int>>(iters, size);
+}
+
+BENCHMARK_PARAM(RadixTreeCloneInsert4, 1000);
+BENCHMARK_RELATIVE_PARAM(PersistentRadixTreeCloneInsert4, 1000);
+BENCHMARK_PARAM(RadixTreeCloneInsert4, 100000);
+BENCHMARK_RELATIVE_PARAM(PersistentRadixTreeCloneInsert4, 100000);
+BENCHMARK_PARAM(RadixTreeCloneInsert4, 1000000);
+BENCHMARK_RELATIVE_PARAM(PersistentRadixTreeCloneInsert4, 1000000);
 }
 
 int main (int argc, char *argv[]) {
@@ -246,6 +364,29 @@ int main (int argc, char *argv[]) {
     auto newIp = pfx.ip.mask(newMask);
     longestMatchSet6.insert(Prefix6(newIp, newMask));
   }
+
+  // Prefixes for the clone benchmarks, one more than the largest tree
+  set<Prefix4> clonePrefixSet4;
+  while (clonePrefixes4.size() <= 1000000) {
+    auto mask = 8 + random32(24);
+    auto ip = IPAddressV4::fromLongHBO(random32()).mask(mask);
+    if (clonePrefixSet4.insert(Prefix4(ip, mask)).second) {
+      clonePrefixes4.push_back(Prefix4(ip, mask));
+    }
+  }
   runBenchmarks();
+
+  // Memory per prefix. A RadixTree has a node per prefix, plus the non
+  // value nodes where prefixes branch.
+  MultibitRadixTree<IPAddressV4, int> mtree4;
+  setupTree4(mtree4);
+  MultibitRadixTree<IPAddressV6, int> mtree6;
+  setupTree6(mtree6);
+  LOG(INFO) << "RadixTree node bytes: V4 "
+            << sizeof(RadixTreeNode<IPAddressV4, int>) << ", V6 "
+            << sizeof(RadixTreeNode<IPAddressV6, int>);
+  LOG(INFO) << "MultibitRadixTree bytes per prefix: V4 "
+            << mtree4.memoryUsage() / mtree4.size() << ", V6 "
+            << mtree6.memoryUsage() / mtree6.size();
 }
 
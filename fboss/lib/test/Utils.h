@@ -10,6 +10,9 @@ struct Prefix4 {
   bool operator<(const Prefix4& r) const {
     return ip < r.ip || (ip == r.ip && mask < r.mask);
   }
+  bool operator==(const Prefix4& r) const {
+    return ip == r.ip && mask == r.mask;
+  }
   facebook::network::IPAddressV4 ip;
   uint8_t mask;
 };
@@ -20,6 +23,9 @@ struct Prefix6 {
   bool operator<(const Prefix6& r) const {
     return ip < r.ip || (ip == r.ip && mask < r.mask);
   }
+  bool operator==(const Prefix6& r) const {
+    return ip == r.ip && mask == r.mask;
+  }
   facebook::network::IPAddressV6 ip;
   uint8_t mask;
 };